@@ -138,7 +138,7 @@ function _atk_g_ranged_strafe( target, dist )
    range = math.min ( range - dist * radial_vel / ( ai.getweapspeed( 4 ) - radial_vel ), range )
 
    local goal = ai.follow_accurate(target, range * 0.8, 0, 10, 20, "keepangle")
-   local mod = vec2.mod(goal - p:pos())
+   local mod = fast.dist( p, goal )
 
    --Must approach or stabilize
    if mod > 3000 then
@@ -193,10 +193,10 @@ function _atk_g_ranged_kite( target, dist )
    local range = ai.getweaprange( 4 )
 
    -- Try to keep velocity vector away from enemy
-   local targetpos = target:pos()
-   local selfpos = p:pos()
-   local unused, targetdir = (selfpos-targetpos):polar()
-   local velmod, veldir = p:vel():polar()
+   local unused, targetdir = fast.polar( target, p )
+   local vx, vy = fast.vel( p )
+   local velmod = math.sqrt( vx*vx + vy*vy )
+   local veldir = math.deg( math.atan2( vy, vx ) )
    if velmod < 0.8*p:stats().speed or math.abs(targetdir-veldir) > 30 then
       local dir = ai.face( target, true )
       if math.abs(180-dir) < 30 then
@@ -234,9 +234,9 @@ function _atk_g_ranged( target, dist )
          or range < ai.getweaprange(1)*1.5 then
       _atk_g_ranged_dogfight( target, dist )
    elseif target:target()==ai.pilot() and dist < 1.3*range then
-      local tvel = target:vel()
-      local pvel = ai.pilot():vel()
-      local vel = (tvel-pvel):polar()
+      local tvx, tvy = fast.vel( target )
+      local pvx, pvy = fast.vel( ai.pilot() )
+      local vel = math.sqrt( (tvx-pvx)^2 + (tvy-pvy)^2 )
       -- If will make contact soon, try to engage
       if dist < wrange+8*vel then
          _atk_g_ranged_dogfight( target, dist )
@@ -274,18 +274,14 @@ end
 -- Melees the target
 --]]
 function _atk_g_melee( target, dist )
-   local dir   = ai.aim(target) -- We aim instead of face
    local range = ai.getweaprange( 3 )
    ai.weapset( 3 ) -- Set turret/forward weaponset.
+   -- We aim instead of face, shooting if should be shooting
+   local dir   = ai.aimshoot( target )
 
    -- Drifting away we'll want to get closer
    if dir < 10 and dist > 0.5*range and ai.relvel(target) > -10 then
       ai.accel()
    end
-
-   -- Shoot if should be shooting.
-   if dir < 10 then
-      ai.shoot()
-   end
    ai.shoot(true)
 end
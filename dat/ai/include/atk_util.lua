@@ -71,8 +71,9 @@ function _atk_decide_zz()
    local dir = ai.idir(target)
    local dist  = ai.dist( target )
 
-   local m, d1 = vec2.polar( pilot:vel() )
-   local m, d2 = vec2.polar( target:pos() - pilot:pos() )
+   local vx, vy = fast.vel( pilot )
+   local d1 = math.deg( math.atan2( vy, vx ) )
+   local m, d2 = fast.polar( pilot, target )
    local d = d1-d2
 
    return ( (dist > (1.1*range)) and (ai.hasprojectile())
@@ -81,8 +81,7 @@ end
 --]]
 function __moveto_nobrake ()
    local target   = ai.taskdata()
-   local dir      = ai.face( target, nil, true )
-   __moveto_generic( target, dir, false )
+   __moveto_generic( target, true, false )
 end
 
 
@@ -91,8 +90,7 @@ end
 --]]
 function __moveto_nobrake_raw ()
    local target   = ai.taskdata()
-   local dir      = ai.face( target )
-   __moveto_generic( target, dir, false )
+   __moveto_generic( target, false, false )
 end
 
 
@@ -130,8 +128,7 @@ end
 --]]
 function moveto ()
    local target   = ai.taskdata()
-   local dir      = ai.face( target, nil, true )
-   __moveto_generic( target, dir, true )
+   __moveto_generic( target, true, true )
 end
 
 
@@ -148,29 +145,25 @@ end
 --]]
 function moveto_raw ()
    local target   = ai.taskdata()
-   local dir      = ai.face( target )
-   __moveto_generic( target, dir, true )
+   __moveto_generic( target, false, true )
 end
 
 
 --[[
 -- Generic moveto function.
 --]]
-function __moveto_generic( target, dir, brake, subtask )
-   local dist     = ai.dist( target )
+function __moveto_generic( target, compensate, brake )
    local bdist
-   if brake then
-      bdist    = ai.minbrakedist()
-   else
+   if not brake then
       bdist    = 50
    end
 
-   -- Need to get closer
-   if dir < 10 and dist > bdist then
-      ai.accel()
+   -- Get closer, defaults to stopping at the minimum braking distance
+   local _dir, dist
+   _dir, dist, bdist = ai.approach( target, compensate, bdist )
 
    -- Need to start braking
-   elseif dist < bdist then
+   if dist < bdist then
       ai.poptask()
       if brake then
          ai.pushtask("brake")
@@ -213,7 +206,7 @@ function follow_accurate ()
    local goal = ai.follow_accurate(target, mem.radius, 
          mem.angle, mem.Kp, mem.Kd)
 
-   local mod = vec2.mod(goal - p:pos())
+   local mod = fast.dist( p, goal )
 
    --  Always face the goal
    local dir   = ai.face(goal)
@@ -226,65 +219,9 @@ end
 
 -- Default action for non-leader pilot in fleet
 function follow_fleet ()
-   local plt    = ai.pilot()
-   local leader = plt:leader()
- 
-   if leader == nil or not leader:exists() then
+   -- Position in formation is followed natively
+   if not ai.follow_fleet( mem.Kp, mem.Kd ) then
       ai.poptask()
-      return
-   end
-
-   if mem.form_pos == nil then -- Simply follow unaccurately
-      local dir  = ai.face(leader)
-      local dist = ai.dist(leader)
-      if dist > 300 and dir < 10 then -- Must approach
-         ai.accel()
-      end
-
-   else -- Ship has a precise position in formation
-      if mem.app == nil then
-         mem.app = 2
-      end
-
-      local angle, radius, method = table.unpack(mem.form_pos)
-      local goal  = ai.follow_accurate(leader, radius, angle, mem.Kp, mem.Kd, method) -- Standard controller
-      local dist  = ai.dist(goal)
-
-      if mem.app == 2 then
-         local dir   = ai.face(goal)
-         if dist > 300 then
-            if dir < 10 then  -- Must approach
-               ai.accel()
-            end
-         else  -- Toggle precise positioning controller
-            mem.app = 1
-         end
-
-      elseif mem.app == 1 then -- only small corrections to do
-         if dist > 300 then -- We're much too far away, we need to toggle large correction
-            mem.app = 2
-         else  -- Derivative-augmented controller
-            local goal0 = ai.follow_accurate(leader, radius, angle, 2*mem.Kp, 10*mem.Kd, method)
-            local dist0 = ai.dist(goal0)
-            local dir = ai.face(goal0)
-            if dist0 > 300 then
-               if dir < 10 then  -- Must approach
-                  ai.accel()
-               end
-            else  -- No need to approach anymore
-               mem.app = 0
-            end
-         end
-
-      else
-         local dir   = ai.face(goal)
-         if dist > 300 then   -- Must approach
-            mem.app = 1
-         else   -- Face forward
-            goal = plt:pos() + leader:vel()
-            ai.face(goal)
-         end
-      end
    end
 end
 
@@ -686,8 +623,7 @@ function __hyp_brake ()
 end
 function __hyp_jump ()
    if ai.hyperspace() == nil then
-      local p = ai.pilot()
-      p:msg(p:followers(), "hyperspace", ai.nearhyptarget())
+      ai.setorder("hyperspace", ai.nearhyptarget())
    end
    ai.popsubtask() -- Keep the task even if succeeding in case pilot gets pushed away.
 end
@@ -867,7 +803,7 @@ function mine ()
 
    local target, vel = system.asteroidPos( field, ast )
 
-   local dist, angle = vec2.polar( p:pos() - target )
+   local dist, angle = fast.polar( target, p )
 
    -- First task : place the ship close to the asteroid
    local goal = ai.face_accurate( target, vel, trange, angle, mem.Kp, mem.Kd )
@@ -879,8 +815,10 @@ function mine ()
       ai.accel()
    end
    
-   local relpos = vec2.add( p:pos(), vec2.mul(target,-1) ):mod()
-   local relvel = vec2.add( p:vel(), vec2.mul(vel,-1) ):mod()
+   local relpos = fast.dist( target, p )
+   local pvx, pvy = fast.vel( p )
+   local tvx, tvy = fast.vec( vel )
+   local relvel = math.sqrt( (pvx-tvx)^2 + (pvy-tvy)^2 )
 
    if relpos < wrange and relvel < 10 then
       ai.pushsubtask("__killasteroid")
@@ -29,7 +29,7 @@ mem.norun         = false -- Do not run away.
 mem.careful       = false -- Should the pilot try to avoid enemies?
 
 mem.formation     = "circle" -- Formation to use when commanding fleet
-mem.form_pos      = nil -- Position in formation (for follower)
+mem.form_refresh  = 10 -- Control ticks between refreshing the formation positions
 mem.leadermaxdist = nil -- Distance from leader to run back to leader
 mem.gather_range  = 800 -- Radius in which the pilot looks for gatherables
 
@@ -49,6 +49,10 @@ mem.Kd             = 20 -- Second control coefficient
 -- control() call
 control_rate   = 2
 
+-- attacked() only reacts to who is attacking, so run it once per frame and
+-- attacker instead of once per hit
+attacked_batch = true
+
 --[[
    Binary flags for the different states that default to nil (false).
    - attack: the pilot is attacked their target
@@ -90,7 +94,19 @@ function _stateinfo( task )
 end
 
 function lead_fleet ()
-   if #ai.pilot():followers() ~= 0 then
+   local nfollowers = #ai.pilot():followers()
+   if nfollowers ~= 0 then
+      -- Positions only change with the followers or the formation, but are
+      -- refreshed now and then in case a follower got replaced
+      mem.form_ticks = (mem.form_ticks or 0) - 1
+      if nfollowers == mem.form_count and mem.formation == mem.form_last
+            and mem.form_ticks > 0 then
+         return
+      end
+      mem.form_count = nfollowers
+      mem.form_last  = mem.formation
+      mem.form_ticks = mem.form_refresh
+
       if mem.formation == nil then
          formation.clear(ai.pilot())
          return
@@ -110,41 +126,64 @@ function control_manual ()
    lead_fleet()
 end
 
+-- Handles an order from the leader, whether sent as a message or given to
+-- all its escorts with ai.setorder
+local function handle_order( p, l, msgtype, data )
+   if msgtype == "hyperspace" then
+      ai.pushtask("hyperspace", data)
+   -- Escort commands
+   -- Attack target
+   elseif msgtype == "e_attack" then
+      if data ~= nil and data:exists() then
+         if data:leader() ~= l then
+            clean_task( ai.taskname() )
+            ai.pushtask("attack_forced", data)
+         end
+      end
+   -- Hold position
+   elseif msgtype == "e_hold" then
+      ai.pushtask("hold" )
+   -- Return to carrier
+   elseif msgtype == "e_return" then
+      if p:flags().carried then
+         ai.pushtask("flyback", true)
+      else
+         ai.pushtask("flyback", false)
+      end
+   -- Clear orders
+   elseif msgtype == "e_clear" then
+      p:taskClear()
+   end
+end
+
 function handle_messages ()
    local p = ai.pilot()
    local l = p:leader()
+
+   -- Orders are only followed if given after joining the leader
+   local serial, order, odata = ai.order()
+   if mem.order_serial == nil or l ~= mem.order_leader then
+      mem.order_leader = l
+      mem.order_serial = serial
+   elseif serial ~= mem.order_serial then
+      mem.order_serial = serial
+      handle_order( p, l, order, odata )
+   end
+
    for _, v in ipairs(ai.messages()) do
       local sender, msgtype, data = table.unpack(v)
       if sender == l then
          if msgtype == "form-pos" then
-            mem.form_pos = data
-         elseif msgtype == "hyperspace" then
-            ai.pushtask("hyperspace", data)
+            if data ~= nil then
+               p:setFormPos( table.unpack(data) )
+            else
+               p:setFormPos()
+            end
          elseif msgtype == "land" then
             mem.land = ai.planetfrompos(data):pos()
             ai.pushtask("land")
-         -- Escort commands
-         -- Attack target
-         elseif msgtype == "e_attack" then
-            if data ~= nil and data:exists() then
-               if data:leader() ~= l then
-                  clean_task( ai.taskname() )
-                  ai.pushtask("attack_forced", data)
-               end
-            end
-         -- Hold position
-         elseif msgtype == "e_hold" then
-            ai.pushtask("hold" )
-         -- Return to carrier
-         elseif msgtype == "e_return" then
-            if p:flags().carried then
-               ai.pushtask("flyback", true)
-            else
-               ai.pushtask("flyback", false)
-            end
-         -- Clear orders
-         elseif msgtype == "e_clear" then
-            p:taskClear()
+         else
+            handle_order( p, l, msgtype, data )
          end
       end
    end
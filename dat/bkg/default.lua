@@ -44,9 +44,21 @@ stars = {
 
 
 function background ()
+   generate( system.cur(), false )
+end
+
+
+-- Called before jumping to a system, only starts decoding the images
+function prefetch( sys )
+   generate( sys, true )
+end
+
+
+function generate( sys, prefetching )
+   cur_sys = sys
+   prefetch_only = prefetching
 
    -- We can do systems without nebula
-   cur_sys = system.cur()
    local nebud, nebuv = cur_sys:nebula()
    if nebud > 0 then
       return
@@ -67,14 +79,20 @@ function background_nebula ()
    -- Set up parameters
    local path  = "gfx/bkg/"
    local nebula = nebulae[ prng:random(1,#nebulae) ]
-   local img   = tex.open( path .. nebula )
-   local w,h   = img:dim()
    local r     = prng:random() * cur_sys:radius()/2
    local a     = 2*math.pi*prng:random()
    local x     = r*math.cos(a)
    local y     = r*math.sin(a)
    local move  = 0.01 + prng:random()*0.01
-   local scale = 1 + (prng:random()*0.5 + 0.5)*((2000+2000)/(w+h))
+   local s     = prng:random()
+   -- All the random numbers have to be drawn in the same order when prefetching
+   if prefetch_only then
+      tex.prefetch( path .. nebula )
+      return
+   end
+   local img   = tex.open( path .. nebula )
+   local w,h   = img:dim()
+   local scale = 1 + (s*0.5 + 0.5)*((2000+2000)/(w+h))
    if scale > 1.9 then scale = 1.9 end
    bkg.image( img, x, y, move, scale )
 end
@@ -124,9 +142,6 @@ function star_add( added, num_added )
       i   = i + 1
    end
    local star  = stars[ num ]
-   -- Load and set stuff
-   local img   = tex.open( path .. star )
-   local w,h   = img:dim()
    -- Position should depend on whether there's more than a star in the system
    local r     = prng:random() * cur_sys:radius()/3
    if num_added > 0 then
@@ -138,6 +153,12 @@ function star_add( added, num_added )
    local nmove = math.max( .05, prng:random()*0.1 )
    local move  = 0.02 + nmove
    local scale = 1.0 - (1. - nmove/0.2)/5
+   -- Load and set stuff
+   if prefetch_only then
+      tex.prefetch( path .. star )
+      return num
+   end
+   local img   = tex.open( path .. star )
    bkg.image( img, x, y, move, scale ) -- On the background
    return num
 end
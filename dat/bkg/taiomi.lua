@@ -16,6 +16,11 @@ love.w = nw
 love.h = nh
 lg.origin()
 
+-- Called before jumping to the system, only starts decoding the images
+function prefetch( sys )
+   tex.prefetch( "gfx/bkg/nebula23.webp" )
+end
+
 function background ()
    -- Create particles and buffer
    local density = 200*200
@@ -0,0 +1,14 @@
+#include "lib/colorblind.glsl"
+
+uniform sampler2D MainTex;
+uniform float gamma = 1.0;
+in vec4 VaryingTexCoord;
+out vec4 color_out;
+
+/* Gamma correction followed by the colour blindness, in a single pass. */
+void main (void)
+{
+   color_out = texture( MainTex, VaryingTexCoord.st );
+   color_out.rgb = pow( color_out.rgb, vec3(1.0 / gamma) );
+   color_out.rgb = colorblind( color_out.rgb );
+}
@@ -1,11 +1,12 @@
-uniform vec4 color;
-uniform vec4 outline_color;
 uniform sampler2D sampler;
 
 in vec2 tex_coord_out;
+in vec4 glyph_color;
+in vec4 glyph_outline;
+in float glyph_scale;
 out vec4 color_out;
 
-// Colour cutoffs, corresponding to "dist" below.
+// Colour cutoffs, corresponding to "dist" below at the smallest font size.
 const float glyph_center     = 0.5;
 const float outline_center   = 0.2;
 const float glyph_stepsize   = 0.1;
@@ -14,9 +15,13 @@ const float outline_stepsize = 0.125;
 void main(void) {
    // dist is a value between 0 and 1 with 0.5 on the edge and 1 inside it.
    float dist = texture(sampler, tex_coord_out).r;
+   // The spread is shared by all the sizes, glyph_scale is the fraction of it a pixel is worth.
+   float gs = glyph_stepsize * glyph_scale;
+   float oc = glyph_center - (glyph_center-outline_center) * glyph_scale;
+   float os = outline_stepsize * glyph_scale;
    // smoothstep maps values below 0.5 to 0 and above 0.5 to 1, with a smooth transition at 0.5.
-   float alpha = smoothstep(glyph_center-glyph_stepsize, glyph_center+glyph_stepsize, dist);
-   float beta = smoothstep(outline_center-outline_stepsize, outline_center+outline_stepsize, dist);
-   vec4 fg_c = mix(outline_color, color, alpha);
+   float alpha = smoothstep(glyph_center-gs, glyph_center+gs, dist);
+   float beta = smoothstep(oc-os, oc+os, dist);
+   vec4 fg_c = mix(glyph_outline, glyph_color, alpha);
    color_out = vec4(fg_c.rgb, beta*fg_c.a);
 }
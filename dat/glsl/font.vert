@@ -1,10 +1,18 @@
-uniform mat4 projection;
-
 in vec4 vertex;
 in vec2 tex_coord;
+in vec4 vertex_color;
+in vec4 vertex_outline;
+in float vertex_scale;
 out vec2 tex_coord_out;
+out vec4 glyph_color;
+out vec4 glyph_outline;
+out float glyph_scale;
 
 void main(void) {
    tex_coord_out = tex_coord;
-   gl_Position = projection * vertex;
+   glyph_color = vertex_color;
+   glyph_outline = vertex_outline;
+   glyph_scale = vertex_scale;
+   // Glyphs are transformed when queued, see gl_fontBatchGlyph().
+   gl_Position = vertex;
 }
@@ -0,0 +1,11 @@
+#ifndef _GLOBALS_GLSL
+#define _GLOBALS_GLSL
+
+/* State shared by all programs, see gl_globalsUse() in opengl_shader.c. */
+layout(std140) uniform Globals {
+   mat4 view;     /* Current view matrix. */
+   vec4 screen;   /* Screen width, height and their inverses. */
+   float time;    /* Real time in seconds. */
+};
+
+#endif /* _GLOBALS_GLSL */
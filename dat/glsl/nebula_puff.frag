@@ -0,0 +1,9 @@
+uniform sampler2D sampler;
+
+in vec2 tex_coord;
+in vec4 puff_color;
+out vec4 color_out;
+
+void main(void) {
+   color_out = puff_color * texture(sampler, tex_coord);
+}
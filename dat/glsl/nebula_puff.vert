@@ -0,0 +1,23 @@
+#include "lib/globals.glsl"
+
+uniform vec2 puff_xy;
+uniform vec2 wh;
+uniform float puff_buf;
+
+in vec2 vertex;
+in vec2 corner;
+in vec2 vertex_tex;
+in float height;
+in vec4 vertex_color;
+
+out vec2 tex_coord;
+out vec4 puff_color;
+
+void main(void) {
+   /* Puffs further away move less, wrapping around the screen and buffer. */
+   vec2 pos = mod(vertex + puff_xy * height + puff_buf, wh) - puff_buf;
+
+   tex_coord = vertex_tex;
+   puff_color = vertex_color;
+   gl_Position = view * vec4(pos + corner, 0., 1.);
+}
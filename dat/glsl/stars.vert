@@ -14,10 +14,10 @@ void main(void) {
    /* Calculate position */
    float b = 1./(9. - 10.*brightness);
    gl_Position = vertex;
-   gl_Position.xy += star_xy * b;
+   gl_Position.xy = vertex.xy * wh + star_xy * b;
 
-   /* check boundaries */
-   gl_Position.xy = mod(gl_Position.xy + wh/2., wh) - wh/2.;
+   /* check boundaries, vertex is relative to the star field size */
+   gl_Position.xy = mod(gl_Position.xy, wh) - wh/2.;
 
    /* Generate lines. */
    vec2 v = xy * brightness;
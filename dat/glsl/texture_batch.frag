@@ -0,0 +1,14 @@
+uniform sampler2D sampler1;
+uniform sampler2D sampler2;
+
+in vec2 batch_tex_coord;
+in vec2 batch_tex_coord2;
+in vec4 batch_color;
+in float batch_inter;
+out vec4 color_out;
+
+void main(void) {
+   vec4 color1 = batch_color * texture(sampler1, batch_tex_coord);
+   vec4 color2 = batch_color * texture(sampler2, batch_tex_coord2);
+   color_out = mix(color2, color1, batch_inter);
+}
@@ -0,0 +1,19 @@
+#include "lib/globals.glsl"
+
+in vec4 vertex;
+in vec2 tex_coord;
+in vec2 tex_coord2;
+in vec4 vertex_color;
+in float vertex_inter;
+out vec2 batch_tex_coord;
+out vec2 batch_tex_coord2;
+out vec4 batch_color;
+out float batch_inter;
+
+void main(void) {
+   batch_tex_coord = tex_coord;
+   batch_tex_coord2 = tex_coord2;
+   batch_color = vertex_color;
+   batch_inter = vertex_inter;
+   gl_Position = view * vertex;
+}
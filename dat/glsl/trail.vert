@@ -1,8 +1,21 @@
-uniform mat4 projection;
+#include "lib/globals.glsl"
+
 in vec4 vertex;
-out vec2 pos;
+in vec4 vertex_color;
+in vec3 vertex_pos;
+in vec2 vertex_thick;
+in vec2 vertex_trail;
+out vec4 trail_color;
+out vec3 trail_pos;
+out vec2 trail_thick;
+out float r;
+out float dt;
 
 void main(void) {
-   pos = vertex.xy;
-   gl_Position = projection * vertex;
+   trail_color = vertex_color;
+   trail_pos   = vertex_pos;
+   trail_thick = vertex_thick;
+   r           = vertex_trail.x;
+   dt          = vertex_trail.y;
+   gl_Position = view * vertex;
 }
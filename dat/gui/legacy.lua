@@ -170,6 +170,18 @@ function update_system ()
 end
 
 
+--[[
+   @brief Optional static render function.
+
+   Drawn once below what render draws and kept until the player's ship,
+   target, cargo, navigation, system or standings change, or
+   gui.staticDirty() is called. Only put what doesn't move here.
+--]]
+function render_static ()
+   gfx.renderTex( frame, frame_x, frame_y )
+end
+
+
 --[[
    @brief Obligatory render function.
 
@@ -178,7 +190,6 @@ end
       @param dt Current deltatick in seconds since last render.
 --]]
 function render( dt )
-   gfx.renderTex( frame, frame_x, frame_y )
    gui.radarRender( radar_x, radar_y )
    render_border()
    render_nav()
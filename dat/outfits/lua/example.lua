@@ -21,6 +21,20 @@ end
 function update( p, po, dt )
 end
 
+-- Outfits used by many pilots can instead update all of them with a single
+-- call, which is much cheaper. If update_batch exists, update is not run.
+-- 'plts', 'pos' and 'mems' are lists with the pilot, pilot outfit and memory
+-- of each instance of the outfit. It is run every 'update_dt' seconds if set,
+-- otherwise every 1/3 seconds, and 'dt' is the time between runs.
+--[[
+update_dt = 1
+function update_batch( plts, pos, mems, dt )
+   for i,p in ipairs(plts) do
+      mems[i].timer = (mems[i].timer or 0) - dt
+   end
+end
+--]]
+
 -- When the pilot is out of energy, this function triggers. Note that before
 -- this triggers, 'ontoggle( p, po false )' will be run if it exists.
 -- This is especially useful for outfits that can't be toggled, but want to
@@ -18,7 +18,7 @@ function formations.cross(leader)
    local angle = 45 -- Spokes start rotated at a 45 degree angle.
    local radius = 100 -- First ship distance.
    for i, p in ipairs(pilots) do
-      leader:msg(p, "form-pos", {angle, radius})
+      p:setFormPos(angle, radius)
       angle = (angle + 90) % (360) -- Rotate spokes by 90 degrees.
       radius = 100 * (math.floor(i / 4) + 1) -- Increase the radius every 4 positions.
    end
@@ -67,7 +67,7 @@ function formations.buffer(leader)
          count[ship_class] = count[ship_class] + 1 --Update the count
       end
       radius = radii[ship_class] --Assign the radius, defined above.
-      leader:msg(p, "form-pos", {angle, radius})
+      p:setFormPos(angle, radius)
    end
 end
 
@@ -77,7 +77,7 @@ function formations.vee(leader)
    local angle = 45 -- Arms start at a 45 degree angle.
    local radius = 100 -- First ship distance.
    for i, p in ipairs(pilots) do
-      leader:msg(p, "form-pos", {angle, radius})
+      p:setFormPos(angle, radius)
       angle = angle * -1 -- Flip the arms between -45 and 45 degrees.
       radius = 100 * (math.floor(i / 2) + 1) -- Increase the radius every 2 positions.
    end
@@ -90,7 +90,7 @@ function formations.wedge(leader)
    local angle = (flip * 45) + 180
    local radius = 100 -- First ship distance.
    for i, p in ipairs(pilots) do
-      leader:msg(p, "form-pos", {angle, radius})
+      p:setFormPos(angle, radius)
       flip = flip * -1
       angle = (flip * 45) + 180 -- Flip the arms between 135 and 215 degrees.
       radius = 100 * (math.floor(i / 2) + 1) -- Increase the radius every 2 positions.
@@ -104,7 +104,7 @@ function formations.echelon_left(leader)
    local flip = -1
    local angle = 135 + (90 * flip)  --Flip between 45 degrees and 225 degrees.
    for i, p in ipairs(pilots) do
-      leader:msg(p, "form-pos", {angle, radius})
+      p:setFormPos(angle, radius)
       flip = flip * -1
       angle = 135 + (90 * flip)
       radius = 100 * (math.ceil((i+1) / 2)) -- Increase the radius every 2 positions
@@ -118,7 +118,7 @@ function formations.echelon_right(leader)
    local flip = 1
    local angle = 225 + (90 * flip) --Flip between 315 degrees, and 135 degrees
    for i, p in ipairs(pilots) do
-      leader:msg(p, "form-pos", {angle, radius})
+      p:setFormPos(angle, radius)
       flip = flip * -1
       angle = 225 + (90 * flip)
       radius = 100 * (math.ceil((i+1) / 2))
@@ -132,7 +132,7 @@ function formations.column(leader)
    local flip = -1
    local angle = 90 + (90 * flip)  --flip between 0 degrees and 180 degrees
    for i, p in ipairs(pilots) do
-      leader:msg(p, "form-pos", {angle, radius})
+      p:setFormPos(angle, radius)
       flip = flip * -1
       angle = 90 + (90 * flip)
       radius = 100 * (math.ceil((i+1)/2)) --Increase the radius every 2 ships.
@@ -146,7 +146,7 @@ function formations.wall(leader)
    local flip = -1
    local angle = 180 + (90 * flip) --flip between 90 degrees and 270 degrees
    for i, p in ipairs(pilots) do
-      leader:msg(p, "form-pos", {angle, radius})
+      p:setFormPos(angle, radius)
       flip = flip * -1
       angle = 180 + (90 * flip)
       radius = 100 * (math.ceil((i+1)/2)) --Increase the radius every 2 ships.
@@ -160,7 +160,7 @@ function formations.fishbone(leader)
    local orig_radius = radius
    local angle = (22.5 * flip) / (radius / orig_radius)
    for i, p in ipairs(pilots) do
-      leader:msg(p, "form-pos", {angle, radius})
+      p:setFormPos(angle, radius)
       if flip == 0 then
          flip = -1
          radius = (orig_radius * (math.ceil((i+1)/3))) + ((orig_radius * (math.ceil((i+1)/3))) / 30)
@@ -181,7 +181,7 @@ function formations.chevron(leader)
    local orig_radius = radius
    local angle = (22.5 * flip) / (radius / orig_radius)
    for i, p in ipairs(pilots) do
-      leader:msg(p, "form-pos", {angle, radius})
+      p:setFormPos(angle, radius)
       if flip == 0 then
          flip = -1
          radius = (orig_radius * (math.ceil((i+1)/3))) - ((orig_radius * (math.ceil((i+1)/3))) / 20)
@@ -201,7 +201,7 @@ function formations.circle(leader)
    local angle = 360 / #pilots -- The angle between each ship, in radians.
    local radius = 80 + #pilots * 25 -- Pulling these numbers out of my ass. The point being that more ships mean a bigger circle.
    for i, p in ipairs(pilots) do
-      leader:msg(p, "form-pos", {angle * i, radius, "absolute"})
+      p:setFormPos(angle * i, radius, "absolute")
    end
 end
 
@@ -214,7 +214,9 @@ formations.keys = keys
 
 -- Clear formation; not really a 'formation' so it is not in keys
 function formations.clear(leader)
-   leader:msg(leader:followers(), "form-pos", nil)
+   for i, p in ipairs(leader:followers()) do
+      p:setFormPos()
+   end
 end
 
 function formations.random_key()
@@ -230,7 +232,7 @@ function formations.circleLarge(leader)
    local angle = 360 / #pilots -- The angle between each ship, in radians.
    local radius = 1500
    for i, p in ipairs(pilots) do
-      leader:msg(p, "form-pos", {angle * i, radius, "absolute"})
+      p:setFormPos(angle * i, radius, "absolute")
    end
 end
 
@@ -40,33 +40,16 @@ function getsysatdistance( sys, min, max, filter, data, hidden )
       max = min
    end
 
-   open  = { sys }
-   close = { [sys:nameRaw()]=sys }
-   dist  = { [sys:nameRaw()]=0 }
-
-   -- Run max times
-   for i=1,max do
-      nopen = {}
-      -- Get all the adjacent system of the current set
-      for _,s in ipairs(open) do
-         adjsys = s:adjacentSystems( hidden ) -- Get them all
-         for _,a in ipairs(adjsys) do
-            -- Must not have been explored previously
-            if close[ a:nameRaw() ] == nil then
-               nopen[ #nopen+1 ] = a
-               close[ a:nameRaw() ] = a
-               dist[  a:nameRaw() ] = i
-            end
-         end
-      end
-      open = nopen -- New table becomes the old
+   -- The search itself is done natively
+   local inrange = system.withinJumps( sys, max, { min=min, hidden=hidden } )
+   if filter == nil then
+      return inrange
    end
 
    -- Now we filter the solutions
-   finalset = {}
-   for i,s in pairs(close) do
-      if dist[i] >= min and dist[i] <= max and
-            (filter == nil or filter(s,data)) then
+   local finalset = {}
+   for _,s in ipairs(inrange) do
+      if filter(s,data) then
          finalset[ #finalset+1 ] = s
       end
    end
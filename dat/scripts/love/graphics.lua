@@ -146,8 +146,8 @@ function graphics.Image:draw( ... )
       h  = h * q.h
    end
    -- TODO be less horribly inefficient
-   local shader = graphics._shader or graphics._shader_default
-   shader = shader.shader
+   local s = graphics._shader or graphics._shader_default
+   local shader = s.shader
    local s1, s2, s3, s4
    local canvas = graphics._canvas
    if canvas then
@@ -162,7 +162,9 @@ function graphics.Image:draw( ... )
       s4 = 0.0
    end
    -- TODO properly solve this, what happens is it gets run before the window size gets set
-   shader:sendRaw( "love_ScreenSize", s1, s2, s3, s4 )
+   if s._screensize then
+      shader:send( s._screensize, s1, s2, s3, s4 )
+   end
 
    -- Get transformation and run
    local H = _H( x, y, r, w*sx, h*sy )
@@ -562,8 +564,13 @@ void main(void) {
    s.shader = naev.shader.new(
          prepend..frag..pixelcode,
          prepend..vert..vertexcode )
+   -- Uniforms get looked up once and are sent through their handle
+   s._uniforms = {}
+   s._screensize = s.shader:uniform( "love_ScreenSize" )
    -- Set some default uniform values for when post-process shaders are used
-   s.shader:sendRaw( "love_ScreenSize", love.w, love.h, 1.0, 0.0 )
+   if s._screensize then
+      s.shader:send( s._screensize, love.w, love.h, 1.0, 0.0 )
+   end
    return s
 end
 function graphics.setShader( shader )
@@ -573,17 +580,25 @@ function graphics.getShader()
    return graphics._shader
 end
 function graphics.Shader:send( name, ... )
+   -- Unknown uniforms are sent by name so that the error mentions it
+   local u = self._uniforms[name]
+   if u == nil then
+      u = self.shader:uniform( name ) or false
+      self._uniforms[name] = u
+   end
+   u = u or name
+
    local arg = {...}
    if type(arg[1])=="table" then
       if arg[1]._type=="Image" then
-         self.shader:send( name, arg[1].tex )
+         self.shader:send( u, arg[1].tex )
       elseif arg[1]._type=="Canvas" then
-         self.shader:send( name, arg[1].t.tex )
+         self.shader:send( u, arg[1].t.tex )
       else
-         self.shader:send( name, ... )
+         self.shader:send( u, ... )
       end
    else
-      self.shader:send( name, ... )
+      self.shader:send( u, ... )
    end
 end
 function graphics.Shader:hasUniform( name )
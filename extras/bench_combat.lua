@@ -0,0 +1,27 @@
+--[[
+   Benchmark scenario of a large fight, to be run with:
+
+      naev --bench extras/bench_combat.lua
+
+   Run it before and after a change: the timings should be comparable and the
+   checksum should match unless the change affects the simulation.
+--]]
+
+bench_system = "Gamma Polaris" -- System to fight in
+bench_ticks  = 3600 -- One minute of game time
+bench_dt     = 1/60 -- Fixed update length
+bench_seed   = 1 -- Seed of the random numbers
+
+local fleets = {
+   { ship="Empire Lancelot", faction="Empire", n=20, pos=vec2.new( -3000, 0 ) },
+   { ship="Pirate Shark", faction="Pirate", n=30, pos=vec2.new( 3000, 0 ) },
+}
+
+function setup ()
+   for k,f in ipairs(fleets) do
+      for i=1,f.n do
+         local offset = vec2.new( 0, (i - f.n/2) * 100 )
+         pilot.add( f.ship, f.faction, f.pos + offset )
+      end
+   end
+end
@@ -65,6 +65,7 @@
 #include <lauxlib.h>
 #include <lualib.h>
 #include <math.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include "physfs.h"
@@ -76,23 +77,29 @@
 
 #include "array.h"
 #include "board.h"
+#include "camera.h"
+#include "conf.h"
 #include "escort.h"
 #include "faction.h"
 #include "hook.h"
 #include "log.h"
 #include "ndata.h"
 #include "nlua.h"
+#include "nlua_fast.h"
 #include "nlua_faction.h"
+#include "nlua_jump.h"
 #include "nlua_pilot.h"
 #include "nlua_planet.h"
 #include "nlua_rnd.h"
 #include "nlua_vec2.h"
 #include "nluadef.h"
 #include "nstring.h"
+#include "opengl.h"
 #include "physics.h"
 #include "pilot.h"
 #include "player.h"
 #include "rng.h"
+#include "scratch.h"
 #include "space.h"
 
 
@@ -110,6 +117,17 @@
 #define AI_DISTRESS     (1<<2)   /**< Sent distress signal. */
 
 
+/*
+ * level of detail
+ *
+ * Pilots at reduced detail only think every 2^lod frames and have their
+ * control rate stretched. Reduced detail runs are limited per frame, with
+ * pilots that have waited too long going through regardless.
+ */
+#define AI_LOD_BUDGET   32 /**< Reduced detail AI runs allowed per frame. */
+#define AI_LOD_STARVE   16 /**< Frames after which a pilot ignores the budget. */
+
+
 /*
  * file info
  */
@@ -120,8 +138,64 @@
 /*
  * all the AI profiles
  */
-static AI_Profile* profiles = NULL; /**< Array of AI_Profiles loaded. */
+static AI_Profile* profiles = NULL; /**< Array of AI_Profiles, loaded when first used. */
 static nlua_env equip_env = LUA_NOREF; /**< Equipment enviornment. */
+static int ai_lodRuns = 0; /**< Reduced detail AI runs done this frame. */
+
+
+/*
+ * batched attacked events
+ *
+ * Hits are accumulated per attacked and attacker pair during a frame so
+ *  the opted in AI and hooks only run once per pair.
+ */
+/**
+ * @brief Damage done by an attacker to a pilot during the frame.
+ */
+typedef struct AIAttacked_ {
+   unsigned int attacked; /**< Pilot attacked. */
+   unsigned int attacker; /**< Pilot attacking. */
+   double dmg; /**< Total damage done. */
+} AIAttacked;
+static AIAttacked *ai_attackedEvents = NULL; /**< Events of the frame in order (array.h). */
+static AIAttacked *ai_attackedRunning = NULL; /**< Events being run by ai_attackedFlush() (array.h). */
+static int *ai_attackedHash = NULL; /**< Open addressing table of event indices, -1 if empty. */
+static int ai_attackedHashSize = 0; /**< Size of ai_attackedHash, a power of two. */
+
+
+/*
+ * equipment templates
+ *
+ * Equipping runs Lua that adds the outfits one at a time. What it comes up
+ *  with only depends on the ship and the equipment script, so the results are
+ *  kept and replayed with a single stats calculation. Each ship and script
+ *  pair has a few templates chosen at random to keep some variety.
+ */
+#define AI_EQUIP_TEMPLATES 8 /**< Templates kept for each ship and equipment script. */
+/**
+ * @brief Outfits and cargo an equipment script gave to a ship.
+ */
+typedef struct AIEquip_ {
+   const Ship *ship; /**< Ship equipped. */
+   nlua_env env; /**< Equipment script used. */
+   int n; /**< Template number. */
+   Outfit **outfits; /**< Outfit of each slot, NULL if empty (array.h). */
+   PilotCommodity *cargo; /**< Cargo added (array.h). */
+} AIEquip;
+static AIEquip *ai_equips = NULL; /**< Templates (array.h). */
+static int *ai_equipHash = NULL; /**< Open addressing table of template indices, -1 if empty. */
+static int ai_equipHashSize = 0; /**< Size of ai_equipHash, a power of two. */
+
+
+/*
+ * task allocation
+ *
+ * Tasks are pushed and popped all the time, so they are allocated in blocks
+ *  and recycled through a free list shared by all the pilots.
+ */
+#define AI_TASK_SLAB    64 /**< Number of tasks allocated at once. */
+static Task **ai_taskSlabs = NULL; /**< Blocks of allocated tasks (array.h). */
+static Task *ai_taskPool = NULL; /**< Free tasks, linked through next. */
 
 
 /*
@@ -129,15 +203,32 @@ static nlua_env equip_env = LUA_NOREF; /**< Equipment enviornment. */
  */
 /* Internal C routines */
 static void ai_run( nlua_env env, int nargs );
-static int ai_loadProfile( const char* filename );
+static int ai_loadProfile( AI_Profile *prof );
 static void ai_setMemory (void);
 static void ai_create( Pilot* pilot );
+static AI_Profile* ai_findProfile( const char *name );
+static int ai_lodLevel( const Pilot *p );
+static int ai_lodSchedule( Pilot *p );
 static int ai_loadEquip (void);
+static int ai_equipSlot( const Ship *ship, nlua_env env, int n );
+static void ai_equipSave( const Pilot *p, nlua_env env, int n );
+static int ai_equipApply( Pilot *p, nlua_env env, int n );
+static void ai_equipFree (void);
+static int ai_attackedSlot( unsigned int attacked, unsigned int attacker );
+static void ai_attackedRecord( unsigned int attacked, unsigned int attacker, double dmg );
 /* Task management. */
 static void ai_taskGC( Pilot* pilot );
 static Task* ai_curTask( Pilot* pilot );
 static Task* ai_createTask( lua_State *L, int subtask );
 static int ai_tasktarget( lua_State *L, Task *t );
+static Task* ai_allocTask( const char *name );
+/* Shared by the Lua primitives. */
+static double ai_face( const Vector2d *tv, int invert, int compensate );
+static void ai_followGoal( Vector2d *goal, const Pilot *target, double radius,
+      double angle, double Kp, double Kd, PilotFormMethod method );
+static double ai_aim( Pilot *p );
+static double ai_brakeDist (void);
+static void ai_shoot( int secondary );
 
 
 
@@ -193,7 +284,9 @@ static int aiL_land( lua_State *L ); /* bool land() */
 static int aiL_stop( lua_State *L ); /* stop() */
 static int aiL_relvel( lua_State *L ); /* relvel( number ) */
 static int aiL_follow_accurate( lua_State *L ); /* follow_accurate() */
+static int aiL_follow_fleet( lua_State *L ); /* boolean follow_fleet( number, number ) */
 static int aiL_face_accurate( lua_State *L ); /* face_accurate() */
+static int aiL_approach( lua_State *L ); /* number, number, number approach( pointer, bool, number ) */
 
 /* Hyperspace. */
 static int aiL_sethyptarget( lua_State *L );
@@ -209,6 +302,7 @@ static int aiL_combat( lua_State *L ); /* combat( number ) */
 static int aiL_settarget( lua_State *L ); /* settarget( number ) */
 static int aiL_weapSet( lua_State *L ); /* weapset( number ) */
 static int aiL_shoot( lua_State *L ); /* shoot( number ); number = 1,2,3 */
+static int aiL_aimshoot( lua_State *L ); /* number aimshoot( pilot, number, bool ) */
 static int aiL_hascannons( lua_State *L ); /* bool hascannons() */
 static int aiL_hasturrets( lua_State *L ); /* bool hasturrets() */
 static int aiL_hasafterburner( lua_State *L ); /* bool hasafterburner() */
@@ -238,6 +332,8 @@ static int aiL_credits( lua_State *L ); /* credits( number ) */
 static int aiL_board( lua_State *L ); /* boolean board() */
 static int aiL_refuel( lua_State *L ); /* boolean, boolean refuel() */
 static int aiL_messages( lua_State *L );
+static int aiL_order( lua_State *L ); /* number, string, data order() */
+static int aiL_setorder( lua_State *L ); /* setorder( string, data ) */
 static int aiL_setasterotarget( lua_State *L ); /* setasterotarget( number, number ) */
 static int aiL_gatherablePos( lua_State *L ); /* gatherablepos( number ) */
 static int aiL_shoot_indicator( lua_State *L ); /* get shoot indicator */
@@ -290,7 +386,9 @@ static const luaL_Reg aiL_methods[] = {
    { "stop", aiL_stop },
    { "relvel", aiL_relvel },
    { "follow_accurate", aiL_follow_accurate },
+   { "follow_fleet", aiL_follow_fleet },
    { "face_accurate", aiL_face_accurate },
+   { "approach", aiL_approach },
    /* Hyperspace. */
    { "sethyptarget", aiL_sethyptarget },
    { "nearhyptarget", aiL_nearhyptarget },
@@ -306,6 +404,7 @@ static const luaL_Reg aiL_methods[] = {
    { "hasturrets", aiL_hasturrets },
    { "hasafterburner", aiL_hasafterburner },
    { "shoot", aiL_shoot },
+   { "aimshoot", aiL_aimshoot },
    { "getenemy", aiL_getenemy },
    { "getenemy_size", aiL_getenemy_size },
    { "getenemy_heuristic", aiL_getenemy_heuristic },
@@ -328,6 +427,8 @@ static const luaL_Reg aiL_methods[] = {
    { "board", aiL_board },
    { "refuel", aiL_refuel },
    { "messages", aiL_messages },
+   { "order", aiL_order },
+   { "setorder", aiL_setorder },
    { "setasterotarget", aiL_setasterotarget },
    { "gatherablepos", aiL_gatherablePos },
    { "shoot_indicator", aiL_shoot_indicator },
@@ -497,7 +598,7 @@ int ai_pinit( Pilot *p, const char *ai )
 
    /* Set fuel.  Hack until we do it through AI itself. */
    if (!pilot_isPlayer(p)) {
-      p->fuel  = (RNG_2SIGMA()/4. + 0.5) * (p->fuel_max - p->fuel_consumption);
+      p->fuel  = (RNGS_2SIGMA(&p->rng)/4. + 0.5) * (p->fuel_max - p->fuel_consumption);
       p->fuel += p->fuel_consumption;
    }
 
@@ -551,8 +652,8 @@ int ai_load (void)
 {
    char** files;
    size_t i;
-   char path[PATH_MAX];
    int flen, suflen;
+   AI_Profile *prof;
 
    /* get the file list */
    files = PHYSFS_enumerateFiles( AI_PATH );
@@ -560,20 +661,20 @@ int ai_load (void)
    /* Create array. */
    profiles = array_create( AI_Profile );
 
-   /* load the profiles */
+   /* Only list the profiles, they get loaded when a pilot first uses them. */
    suflen = strlen(AI_SUFFIX);
    for (i=0; files[i]!=NULL; i++) {
       flen = strlen(files[i]);
       if ((flen > suflen) &&
             strncmp(&files[i][flen-suflen], AI_SUFFIX, suflen)==0) {
-
-         snprintf( path, sizeof(path), AI_PATH"%s", files[i] );
-         if (ai_loadProfile(path)) /* Load the profile */
-            WARN( _("Error loading AI profile '%s'"), path);
+         prof = &array_grow(&profiles);
+         memset( prof, 0, sizeof(AI_Profile) );
+         prof->name = strndup( files[i], flen-suflen );
+         prof->env  = LUA_NOREF;
       }
    }
 
-   DEBUG( n_("Loaded %d AI Profile", "Loaded %d AI Profiles", array_size(profiles) ), array_size(profiles) );
+   DEBUG( n_("Found %d AI Profile", "Found %d AI Profiles", array_size(profiles) ), array_size(profiles) );
 
    /* More clean up. */
    PHYSFS_freeList( files );
@@ -595,6 +696,7 @@ static int ai_loadEquip (void)
    /* Make sure doesn't already exist. */
    if (equip_env != LUA_NOREF)
       nlua_freeEnv(equip_env);
+   ai_equipFree();
 
    /* Create new state. */
    equip_env = nlua_newEnv(1);
@@ -616,36 +718,32 @@ static int ai_loadEquip (void)
 
 
 /**
- * @brief Initializes an AI_Profile and adds it to the stack.
+ * @brief Loads an AI_Profile.
+ *
+ * The functions the AI calls are looked up once here. Modules required by
+ *  the profiles are compiled once and shared through the Lua chunk cache.
  *
- *    @param[in] filename File to create the profile from.
+ *    @param[in] prof Profile to load.
  *    @return 0 on no error.
  */
-static int ai_loadProfile( const char* filename )
+static int ai_loadProfile( AI_Profile *prof )
 {
    char* buf = NULL;
    size_t bufsize = 0;
    nlua_env env;
-   AI_Profile *prof;
-   size_t len;
    const char *str;
+   char filename[PATH_MAX];
 
-   /* Grow array. */
-   prof = &array_grow(&profiles);
-
-   /* Set name. */
-   len = strlen(filename)-strlen(AI_PATH)-strlen(AI_SUFFIX);
-   prof->name = malloc(len+1);
-   strncpy( prof->name, &filename[strlen(AI_PATH)], len );
-   prof->name[len] = '\0';
+   snprintf( filename, sizeof(filename), AI_PATH"%s"AI_SUFFIX, prof->name );
+   prof->loaded = -1;
 
    /* Create Lua. */
    env = nlua_newEnv(1);
    nlua_loadStandard(env);
-   prof->env = env;
 
    /* Register C functions in Lua */
    nlua_register(env, "ai", aiL_methods, 0);
+   nlua_loadFast(env);
 
    /* Add the pilot memory table. */
    lua_newtable(naevL);              /* pm */
@@ -666,13 +764,12 @@ static int ai_loadProfile( const char* filename )
           "%s\n"
           "Most likely Lua file has improper syntax, please check"),
             filename, lua_tostring(naevL,-1));
-      array_erase( &profiles, prof, &prof[1] );
-      free(prof->name);
       nlua_freeEnv( env );
       free(buf);
       return -1;
    }
    free(buf);
+   prof->env = env;
 
    /* Find and set up the necessary references. */
    str = _("AI Profile '%s' is missing '%s' function!");
@@ -682,27 +779,66 @@ static int ai_loadProfile( const char* filename )
    prof->ref_control_manual = nlua_refenv( env, "control_manual" );
    if (prof->ref_control == LUA_NOREF)
       WARN( str, filename, "control_manual" );
+   prof->ref_create   = nlua_refenv( env, "create" );
+   prof->ref_attacked = nlua_refenv( env, "attacked" );
+   prof->ref_distress = nlua_refenv( env, "distress" );
+
+   /* Profiles opt in to getting attacked() once per frame and attacker. */
+   nlua_getenv( env, "attacked_batch" );
+   prof->attacked_batch = lua_toboolean( naevL, -1 );
+   lua_pop( naevL, 1 );
 
+   prof->loaded = 1;
    return 0;
 }
 
 
 /**
- * @brief Gets the AI_Profile by name.
+ * @brief Finds an AI_Profile by name, without loading it.
+ */
+static AI_Profile* ai_findProfile( const char *name )
+{
+   int i;
+   for (i=0; i<array_size(profiles); i++)
+      if (strcmp(name,profiles[i].name)==0)
+         return &profiles[i];
+   return NULL;
+}
+
+
+/**
+ * @brief Gets the AI_Profile by name, loading it if needed.
  *
  *    @param[in] name Name of the profile to get.
  *    @return The profile or NULL on error.
  */
 AI_Profile* ai_getProfile( char* name )
 {
-   int i;
+   AI_Profile *prof = ai_findProfile( name );
 
-   for (i=0; i<array_size(profiles); i++)
-      if (strcmp(name,profiles[i].name)==0)
-         return &profiles[i];
+   if (prof == NULL) {
+      WARN( _("AI Profile '%s' not found in AI stack"), name);
+      return NULL;
+   }
 
-   WARN( _("AI Profile '%s' not found in AI stack"), name);
-   return NULL;
+   /* Load on first use. */
+   if (prof->loaded == 0)
+      ai_loadProfile( prof );
+   if (prof->loaded < 0)
+      return NULL;
+   return prof;
+}
+
+
+/**
+ * @brief Checks to see if an AI_Profile exists, without loading it.
+ *
+ *    @param[in] name Name of the profile to check.
+ *    @return 1 if there is a profile with that name.
+ */
+int ai_profileExists( const char *name )
+{
+   return (ai_findProfile( name ) != NULL);
 }
 
 
@@ -711,19 +847,121 @@ AI_Profile* ai_getProfile( char* name )
  */
 void ai_exit (void)
 {
-   int i;
+   int i, j;
 
    /* Free AI profiles. */
    for (i=0; i<array_size(profiles); i++) {
       free(profiles[i].name);
-      nlua_freeEnv(profiles[i].env);
+      if (profiles[i].loaded > 0)
+         nlua_freeEnv(profiles[i].env);
    }
    array_free( profiles );
 
+   /* Free the tasks. */
+   for (i=0; i<array_size(ai_taskSlabs); i++) {
+      for (j=0; j<AI_TASK_SLAB; j++)
+         free(ai_taskSlabs[i][j].name);
+      free(ai_taskSlabs[i]);
+   }
+   array_free( ai_taskSlabs );
+   ai_taskSlabs = NULL;
+   ai_taskPool  = NULL;
+
    /* Free equipment Lua. */
    if (equip_env != LUA_NOREF)
       nlua_freeEnv(equip_env);
    equip_env = LUA_NOREF;
+   ai_equipFree();
+
+   /* Free batched events. */
+   array_free( ai_attackedEvents );
+   ai_attackedEvents = NULL;
+   array_free( ai_attackedRunning );
+   ai_attackedRunning = NULL;
+   free( ai_attackedHash );
+   ai_attackedHash = NULL;
+   ai_attackedHashSize = 0;
+}
+
+
+/**
+ * @brief Resets the level of detail budget, to be called once per frame.
+ */
+void ai_lodFrame (void)
+{
+   ai_lodRuns = 0;
+}
+
+
+/**
+ * @brief Gets the level of detail the AI of a pilot should run at.
+ *
+ *    @param p Pilot to get level of detail of.
+ *    @return The level of detail (AI_LOD_*).
+ */
+static int ai_lodLevel( const Pilot *p )
+{
+   double x, y, z;
+
+   if (player.p == NULL)
+      return AI_LOD_FULL;
+
+   /* Anything the player can interact with gets full detail. */
+   if (pilot_isFlag(p, PILOT_PLAYER) ||
+         pilot_isFlag(p, PILOT_MANUAL_CONTROL) ||
+         pilot_isFlag(p, PILOT_COMBAT) ||
+         (p->parent == PLAYER_ID) ||
+         (p->target == PLAYER_ID))
+      return AI_LOD_FULL;
+
+   /* On screen, with half a screen of margin. */
+   cam_getPos( &x, &y );
+   z = cam_getZoom();
+   if ((FABS(p->solid->pos.x - x) < SCREEN_W / z) &&
+         (FABS(p->solid->pos.y - y) < SCREEN_H / z))
+      return AI_LOD_FULL;
+
+   /* Sensor range is squared. */
+   if (vect_dist2( &p->solid->pos, &player.p->solid->pos ) < pilot_sensorRange())
+      return AI_LOD_NEAR;
+
+   return AI_LOD_FAR;
+}
+
+
+/**
+ * @brief Decides whether or not the AI of a pilot should run this frame.
+ *
+ * Pilots that don't run keep their previous thrust and turn.
+ *
+ *    @param p Pilot to schedule.
+ *    @return 1 if the AI should run, 0 otherwise.
+ */
+static int ai_lodSchedule( Pilot *p )
+{
+   if (!conf.ai_lod) {
+      p->ai_lod = AI_LOD_FULL;
+      return 1;
+   }
+
+   p->ai_lod = ai_lodLevel( p );
+   if (p->ai_lod == AI_LOD_FULL) {
+      p->ai_lodwait = 0;
+      return 1;
+   }
+
+   /* Not its turn yet. */
+   p->ai_lodwait++;
+   if (p->ai_lodwait < (1 << p->ai_lod))
+      return 0;
+
+   /* Over budget, defer to the next frame unless it has waited too long. */
+   if ((ai_lodRuns >= AI_LOD_BUDGET) && (p->ai_lodwait < AI_LOD_STARVE))
+      return 0;
+
+   ai_lodRuns++;
+   p->ai_lodwait = 0;
+   return 1;
 }
 
 
@@ -745,6 +983,10 @@ void ai_think( Pilot* pilot, const double dt )
    if (pilot->ai == NULL)
       return;
 
+   /* Distant pilots don't think every frame. */
+   if (!ai_lodSchedule( pilot ))
+      return;
+
    ai_setPilot(pilot);
    env = cur_pilot->ai->env; /* set the AI profile to the current pilot's */
 
@@ -775,7 +1017,7 @@ void ai_think( Pilot* pilot, const double dt )
       }
 
       nlua_getenv(env, "control_rate");
-      cur_pilot->tcontrol = lua_tonumber(naevL,-1);
+      cur_pilot->tcontrol = lua_tonumber(naevL,-1) * (1 + cur_pilot->ai_lod);
       lua_pop(naevL,1);
 
       /* Task may have changed due to control tick. */
@@ -856,6 +1098,7 @@ void ai_attacked( Pilot* attacked, const unsigned int attacker, double dmg )
 
    /* Behaves differently if manually overridden. */
    pilot_runHookParam( attacked, PILOT_HOOK_ATTACKED, hparam, 2 );
+   ai_attackedRecord( attacked->id, attacker, dmg );
    if (pilot_isFlag( attacked, PILOT_MANUAL_CONTROL ))
       return;
 
@@ -863,9 +1106,13 @@ void ai_attacked( Pilot* attacked, const unsigned int attacker, double dmg )
    if (attacked->ai == NULL)
       return;
 
+   /* Will be run by ai_attackedFlush(). */
+   if (attacked->ai->attacked_batch)
+      return;
+
    ai_setPilot( attacked ); /* Sets cur_pilot. */
 
-   nlua_getenv(cur_pilot->ai->env, "attacked");
+   lua_rawgeti(naevL, LUA_REGISTRYINDEX, cur_pilot->ai->ref_attacked);
 
    lua_pushpilot(naevL, attacker);
    if (nlua_pcall(cur_pilot->ai->env, 1, 0)) {
@@ -875,6 +1122,123 @@ void ai_attacked( Pilot* attacked, const unsigned int attacker, double dmg )
 }
 
 
+/**
+ * @brief Gets the slot of a pair in the batched attacked events table.
+ *
+ *    @return Slot holding the pair or the empty slot where it goes.
+ */
+static int ai_attackedSlot( unsigned int attacked, unsigned int attacker )
+{
+   unsigned int h;
+   int e;
+
+   h = (attacked * 2654435761u) ^ (attacker * 40503u);
+   for ( ; ; h++) {
+      h &= ai_attackedHashSize-1;
+      e = ai_attackedHash[h];
+      if ((e < 0) || ((ai_attackedEvents[e].attacked == attacked) &&
+               (ai_attackedEvents[e].attacker == attacker)))
+         return h;
+   }
+}
+
+
+/**
+ * @brief Adds damage done to a pilot to the batched attacked events.
+ */
+static void ai_attackedRecord( unsigned int attacked, unsigned int attacker, double dmg )
+{
+   int i, n, s;
+   AIAttacked *ev;
+
+   if (ai_attackedEvents == NULL)
+      ai_attackedEvents = array_create( AIAttacked );
+   n = array_size( ai_attackedEvents );
+
+   /* Keep the table at most half full. */
+   if (2*(n+1) > ai_attackedHashSize) {
+      ai_attackedHashSize = MAX( 64, 2*ai_attackedHashSize );
+      free( ai_attackedHash );
+      ai_attackedHash = malloc( ai_attackedHashSize * sizeof(int) );
+      for (i=0; i<ai_attackedHashSize; i++)
+         ai_attackedHash[i] = -1;
+      for (i=0; i<n; i++)
+         ai_attackedHash[ ai_attackedSlot( ai_attackedEvents[i].attacked,
+               ai_attackedEvents[i].attacker ) ] = i;
+   }
+
+   s = ai_attackedSlot( attacked, attacker );
+   if (ai_attackedHash[s] >= 0) {
+      ai_attackedEvents[ ai_attackedHash[s] ].dmg += dmg;
+      return;
+   }
+   ai_attackedHash[s] = n;
+   ev = &array_grow( &ai_attackedEvents );
+   ev->attacked = attacked;
+   ev->attacker = attacker;
+   ev->dmg      = dmg;
+}
+
+
+/**
+ * @brief Runs the batched attacked events of the frame.
+ *
+ * Runs the "attackedbatch" pilot hooks and the attacked() function of the
+ *  AI profiles that set attacked_batch, once per attacked and attacker pair
+ *  with the total damage done, in the order the pairs were first hit.
+ */
+void ai_attackedFlush (void)
+{
+   int i;
+   Pilot *p;
+   AIAttacked ev, *tmp;
+   HookParam hparam[2];
+
+   if (array_size( ai_attackedEvents ) == 0)
+      return;
+
+   /* Swap the buffers so hits done by the hooks and AI go to the next frame. */
+   tmp = ai_attackedRunning;
+   ai_attackedRunning = ai_attackedEvents;
+   ai_attackedEvents  = tmp;
+   if (ai_attackedEvents != NULL)
+      array_resize( &ai_attackedEvents, 0 );
+   for (i=0; i<ai_attackedHashSize; i++)
+      ai_attackedHash[i] = -1;
+
+   for (i=0; i<array_size(ai_attackedRunning); i++) {
+      ev = ai_attackedRunning[i];
+
+      p = pilot_get( ev.attacked );
+      if ((p == NULL) || pilot_isFlag( p, PILOT_DELETE ))
+         continue;
+
+      hparam[0].type       = HOOK_PARAM_PILOT;
+      hparam[0].u.lp       = ev.attacker;
+      hparam[1].type       = HOOK_PARAM_NUMBER;
+      hparam[1].u.num      = ev.dmg;
+      pilot_runHookParam( p, PILOT_HOOK_ATTACKED_BATCH, hparam, 2 );
+
+      /* Hooks may have changed things around. */
+      p = pilot_get( ev.attacked );
+      if ((p == NULL) || pilot_isFlag( p, PILOT_MANUAL_CONTROL ) ||
+            (p->ai == NULL) || !p->ai->attacked_batch)
+         continue;
+
+      ai_setPilot( p ); /* Sets cur_pilot. */
+      lua_rawgeti(naevL, LUA_REGISTRYINDEX, cur_pilot->ai->ref_attacked);
+      lua_pushpilot(naevL, ev.attacker);
+      lua_pushnumber(naevL, ev.dmg);
+      if (nlua_pcall(cur_pilot->ai->env, 2, 0)) {
+         WARN( _("Pilot '%s' ai -> 'attacked': %s"), cur_pilot->name, lua_tostring(naevL, -1));
+         lua_pop(naevL, 1);
+      }
+   }
+
+   array_resize( &ai_attackedRunning, 0 );
+}
+
+
 /**
  * @brief Has a pilot attempt to refuel the other.
  *
@@ -886,8 +1250,7 @@ void ai_refuel( Pilot* refueler, unsigned int target )
    Task *t;
 
    /* Create the task. */
-   t           = calloc( 1, sizeof(Task) );
-   t->name     = strdup("refuel");
+   t           = ai_allocTask( "refuel" );
    lua_pushpilot(naevL, target);
    t->dat      = luaL_ref(naevL, LUA_REGISTRYINDEX);
 
@@ -920,11 +1283,9 @@ void ai_getDistress( Pilot *p, const Pilot *distressed, const Pilot *attacker )
    ai_setPilot(p);
 
    /* See if function exists. */
-   nlua_getenv(cur_pilot->ai->env, "distress");
-   if (lua_isnil(naevL,-1)) {
-      lua_pop(naevL,1);
+   if (cur_pilot->ai->ref_distress == LUA_NOREF)
       return;
-   }
+   lua_rawgeti(naevL, LUA_REGISTRYINDEX, cur_pilot->ai->ref_distress);
 
    /* Run the function. */
    lua_pushpilot(naevL, distressed->id);
@@ -951,6 +1312,7 @@ static void ai_create( Pilot* pilot )
 {
    nlua_env env;
    char *func;
+   int n;
 
    env = equip_env;
    func = "equip_generic";
@@ -966,13 +1328,18 @@ static void ai_create( Pilot* pilot )
          env = faction_getEquipper( pilot->faction );
          func = "equip";
       }
-      nlua_getenv(env, func);
-      nlua_pushenv(env);
-      lua_setfenv(naevL, -2);
-      lua_pushpilot(naevL, pilot->id);
-      if (nlua_pcall(env, 1, 0)) { /* Error has occurred. */
-         WARN( _("Pilot '%s' equip -> '%s': %s"), pilot->name, func, lua_tostring(naevL, -1));
-         lua_pop(naevL, 1);
+      n = RNG( 0, AI_EQUIP_TEMPLATES-1 );
+      if (ai_equipApply( pilot, env, n ) != 0) {
+         nlua_getenv(env, func);
+         nlua_pushenv(env);
+         lua_setfenv(naevL, -2);
+         lua_pushpilot(naevL, pilot->id);
+         if (nlua_pcall(env, 1, 0)) { /* Error has occurred. */
+            WARN( _("Pilot '%s' equip -> '%s': %s"), pilot->name, func, lua_tostring(naevL, -1));
+            lua_pop(naevL, 1);
+         }
+         else
+            ai_equipSave( pilot, env, n );
       }
    }
 
@@ -987,7 +1354,7 @@ static void ai_create( Pilot* pilot )
    ai_setPilot( pilot );
 
    /* Prepare stack. */
-   nlua_getenv(cur_pilot->ai->env, "create");
+   lua_rawgeti(naevL, LUA_REGISTRYINDEX, cur_pilot->ai->ref_create);
 
    /* Run function. */
    if (nlua_pcall(cur_pilot->ai->env, 0, 0)) { /* error has occurred */
@@ -1001,6 +1368,143 @@ static void ai_create( Pilot* pilot )
 }
 
 
+/**
+ * @brief Gets the slot of a template in the equipment templates table.
+ *
+ *    @return Slot holding the template or the empty slot where it goes.
+ */
+static int ai_equipSlot( const Ship *ship, nlua_env env, int n )
+{
+   unsigned int h;
+   int e;
+
+   h = ((unsigned int)(uintptr_t)ship * 2654435761u) ^ ((unsigned int)env * 40503u) ^ (unsigned int)n;
+   for ( ; ; h++) {
+      h &= ai_equipHashSize-1;
+      e = ai_equipHash[h];
+      if ((e < 0) || ((ai_equips[e].ship == ship) &&
+               (ai_equips[e].env == env) && (ai_equips[e].n == n)))
+         return h;
+   }
+}
+
+
+/**
+ * @brief Keeps what an equipment script gave to a pilot as a template.
+ *
+ *    @param p Pilot that was just equipped.
+ *    @param env Equipment script that was run.
+ *    @param n Template number.
+ */
+static void ai_equipSave( const Pilot *p, nlua_env env, int n )
+{
+   int i, s, ne;
+   AIEquip *eq;
+
+   if (ai_equips == NULL)
+      ai_equips = array_create( AIEquip );
+   ne = array_size( ai_equips );
+
+   /* Keep the table at most half full. */
+   if (2*(ne+1) > ai_equipHashSize) {
+      ai_equipHashSize = MAX( 256, 2*ai_equipHashSize );
+      free( ai_equipHash );
+      ai_equipHash = malloc( ai_equipHashSize * sizeof(int) );
+      for (i=0; i<ai_equipHashSize; i++)
+         ai_equipHash[i] = -1;
+      for (i=0; i<ne; i++)
+         ai_equipHash[ ai_equipSlot( ai_equips[i].ship, ai_equips[i].env,
+               ai_equips[i].n ) ] = i;
+   }
+
+   s = ai_equipSlot( p->ship, env, n );
+   if (ai_equipHash[s] >= 0)
+      return;
+   ai_equipHash[s] = ne;
+
+   eq = &array_grow( &ai_equips );
+   eq->ship    = p->ship;
+   eq->env     = env;
+   eq->n       = n;
+   eq->outfits = array_create_size( Outfit*, array_size(p->outfits) );
+   for (i=0; i<array_size(p->outfits); i++)
+      array_push_back( &eq->outfits, p->outfits[i]->outfit );
+   eq->cargo   = array_create( PilotCommodity );
+   for (i=0; i<array_size(p->commodities); i++)
+      if (p->commodities[i].id == 0)
+         array_push_back( &eq->cargo, p->commodities[i] );
+}
+
+
+/**
+ * @brief Equips a pilot from a template.
+ *
+ * Same as what pilot.addOutfit() does for each outfit, except the stats and
+ *  weapon sets are only updated once at the end.
+ *
+ *    @param p Pilot to equip.
+ *    @param env Equipment script the template is from.
+ *    @param n Template number.
+ *    @return 0 on success, 1 if there is no such template yet.
+ */
+static int ai_equipApply( Pilot *p, nlua_env env, int n )
+{
+   int i, s;
+   AIEquip *eq;
+   Outfit *o;
+
+   if (ai_equipHashSize == 0)
+      return 1;
+   s = ai_equipSlot( p->ship, env, n );
+   if (ai_equipHash[s] < 0)
+      return 1;
+   eq = &ai_equips[ ai_equipHash[s] ];
+
+   /* Start with an empty ship. */
+   for (i=0; i<array_size(p->outfits); i++)
+      if (p->outfits[i]->outfit != NULL)
+         pilot_rmOutfitRaw( p, p->outfits[i] );
+
+   for (i=0; i<array_size(eq->outfits); i++) {
+      o = eq->outfits[i];
+      if (o == NULL)
+         continue;
+      if (pilot_addOutfitRaw( p, o, p->outfits[i] ) != 0)
+         continue;
+      pilot_outfitLInit( p, p->outfits[i] );
+      if (outfit_ammo(o) != NULL)
+         pilot_addAmmo( p, p->outfits[i], outfit_ammo(o), outfit_amount(o) );
+   }
+   pilot_calcStats( p );
+   if (p->autoweap)
+      pilot_weaponAuto( p );
+
+   for (i=0; i<array_size(eq->cargo); i++)
+      pilot_cargoAdd( p, eq->cargo[i].commodity, eq->cargo[i].quantity, 0 );
+
+   return 0;
+}
+
+
+/**
+ * @brief Frees the equipment templates.
+ */
+static void ai_equipFree (void)
+{
+   int i;
+
+   for (i=0; i<array_size(ai_equips); i++) {
+      array_free( ai_equips[i].outfits );
+      array_free( ai_equips[i].cargo );
+   }
+   array_free( ai_equips );
+   ai_equips = NULL;
+   free( ai_equipHash );
+   ai_equipHash = NULL;
+   ai_equipHashSize = 0;
+}
+
+
 /**
  * @brief Creates a new AI task.
  */
@@ -1014,10 +1518,8 @@ Task *ai_newtask( Pilot *p, const char *func, int subtask, int pos )
    luaL_checktype( naevL, -1, LUA_TFUNCTION );
 
    /* Create the new task. */
-   t           = calloc( 1, sizeof(Task) );
-   t->name     = strdup(func);
+   t           = ai_allocTask( func );
    t->func     = luaL_ref(naevL, LUA_REGISTRYINDEX);
-   t->dat      = LUA_NOREF;
 
    /* Handle subtask and general task. */
    if (!subtask) {
@@ -1079,8 +1581,53 @@ void ai_freetask( Task* t )
       t->next = NULL;
    }
 
-   free(t->name);
-   free(t);
+   /* Back to the pool, the name buffer is kept for reuse. */
+   t->next     = ai_taskPool;
+   ai_taskPool = t;
+}
+
+
+/**
+ * @brief Gets a blank task from the pool.
+ *
+ *    @param name Name of the task.
+ *    @return The task, with no function, data, subtasks nor next task.
+ */
+static Task* ai_allocTask( const char *name )
+{
+   int i;
+   size_t len;
+   Task *t, *slab;
+
+   /* Refill the pool. */
+   if (ai_taskPool == NULL) {
+      slab = calloc( AI_TASK_SLAB, sizeof(Task) );
+      if (ai_taskSlabs == NULL)
+         ai_taskSlabs = array_create( Task* );
+      array_push_back( &ai_taskSlabs, slab );
+      for (i=AI_TASK_SLAB-1; i>=0; i--) {
+         slab[i].next = ai_taskPool;
+         ai_taskPool  = &slab[i];
+      }
+   }
+
+   t           = ai_taskPool;
+   ai_taskPool = t->next;
+
+   len = strlen(name)+1;
+   if (len > t->name_size) {
+      free(t->name);
+      t->name      = malloc(len);
+      t->name_size = len;
+   }
+   memcpy( t->name, name, len );
+
+   t->next     = NULL;
+   t->subtask  = NULL;
+   t->done     = 0;
+   t->func     = LUA_NOREF;
+   t->dat      = LUA_NOREF;
+   return t;
 }
 
 
@@ -1297,7 +1844,7 @@ static int aiL_getrndpilot( lua_State *L )
    int p;
 
    pilot_stack = pilot_getAll();
-   p = RNG(0, array_size(pilot_stack)-1);
+   p = RNGS(&cur_pilot->rng, 0, array_size(pilot_stack)-1);
    /* Make sure it can't be the same pilot. */
    if (pilot_stack[p]->id == cur_pilot->id) {
       p++;
@@ -1450,14 +1997,10 @@ static int aiL_minbrakedist( lua_State *L )
          vel = 0.;
    }
 
-   /* Simple calculation based on distance. */
+   /* Simple calculation based on distance, may have been precomputed. */
    else {
-      /* Get current time to reach target. */
-      time = VMOD(cur_pilot->solid->vel) /
-            (cur_pilot->thrust / cur_pilot->solid->mass);
-
-      /* Get velocity. */
-      vel = MIN(cur_pilot->speed,VMOD(cur_pilot->solid->vel));
+      lua_pushnumber(L, ai_brakeDist());
+      return 1;
    }
    /* Get distance to brake. */
    dist = vel*(time+1.1*M_PI/cur_pilot->turn) -
@@ -1689,8 +2232,7 @@ static int aiL_face( lua_State *L )
 {
    Vector2d *tv; /* get the position to face */
    Pilot* p;
-   double k_diff, k_vel, d, diff, vx, vy, dx, dy;
-   int vel;
+   double d;
 
    /* Get first parameter, aka what to face. */
    if (lua_ispilot(L,1)) {
@@ -1710,17 +2252,31 @@ static int aiL_face( lua_State *L )
    else
       NLUA_INVALID_PARAMETER(L);
 
+   lua_pushnumber(L, ai_face( tv, lua_toboolean(L,2), lua_toboolean(L,3) ));
+   return 1;
+}
+
+
+/**
+ * @brief Makes the pilot turn to face a position.
+ *
+ *    @param tv Position to face.
+ *    @param invert Face away from the position instead.
+ *    @param compensate Compensate for velocity.
+ *    @return Angle offset in degrees.
+ */
+static double ai_face( const Vector2d *tv, int invert, int compensate )
+{
+   double k_diff, k_vel, d, diff, vx, vy, dx, dy;
+
    /* Default gain. */
    k_diff = 10.;
    k_vel  = 100.; /* overkill gain! */
 
    /* Check if must invert. */
-   if (lua_toboolean(L,2))
+   if (invert)
       k_diff *= -1;
 
-   /* Third parameter. */
-   vel = lua_toboolean(L, 3);
-
    /* Tangential component of velocity vector
     *
     * v: velocity vector
@@ -1736,7 +2292,7 @@ static int aiL_face( lua_State *L )
    /* Direction vector. */
    dx = tv->x - cur_pilot->solid->pos.x;
    dy = tv->y - cur_pilot->solid->pos.y;
-   if (vel) {
+   if (compensate) {
       /* Calculate dot product. */
       d = (vx * dx + vy * dy) / (dx*dx + dy*dy);
       /* Calculate tangential velocity. */
@@ -1755,8 +2311,69 @@ static int aiL_face( lua_State *L )
    pilot_turn = k_diff * diff;
 
    /* Return angle in degrees away from target. */
-   lua_pushnumber(L, ABS(diff*180./M_PI));
-   return 1;
+   return ABS(diff*180./M_PI);
+}
+
+
+/**
+ * @brief Gets the minimum braking distance of the current pilot.
+ */
+static double ai_brakeDist (void)
+{
+   /* May have been precomputed. */
+   if (cur_pilot->sense.valid)
+      return cur_pilot->sense.brakedist;
+   return pilot_minBrakeDist( cur_pilot );
+}
+
+
+/**
+ * @brief Faces a target and accelerates towards it until within a distance.
+ *
+ * Does what ai.face, ai.dist, ai.minbrakedist and ai.accel are usually
+ *  combined to do when moving to a target: the pilot only accelerates once
+ *  facing the target and while farther than the braking distance.
+ *
+ * @usage dir, dist, bdist = ai.approach( target, true ) -- Compensating velocity
+ * @usage dir, dist = ai.approach( target, false, 50 ) -- Stop accelerating at 50
+ *
+ *    @luatparam Pilot|Vec2 target Target to approach.
+ *    @luatparam[opt=false] boolean compensate Compensate for velocity?
+ *    @luatparam[opt] number bdist Distance to stop accelerating at, defaults to
+ *              the minimum braking distance.
+ *    @luatreturn number Angle offset in degrees.
+ *    @luatreturn number Distance to the target.
+ *    @luatreturn number Distance at which acceleration stops.
+ * @luafunc approach
+ */
+static int aiL_approach( lua_State *L )
+{
+   Vector2d *tv;
+   Pilot *p;
+   double dir, dist, bdist;
+
+   if (lua_ispilot(L,1)) {
+      p  = luaL_validpilot(L,1);
+      tv = &p->solid->pos;
+   }
+   else if (lua_isvector(L,1))
+      tv = lua_tovector(L,1);
+   else
+      NLUA_INVALID_PARAMETER(L);
+
+   dir   = ai_face( tv, 0, lua_toboolean(L,2) );
+   dist  = vect_dist( tv, &cur_pilot->solid->pos );
+   bdist = luaL_optnumber( L, 3, -1. );
+   if (bdist < 0.)
+      bdist = ai_brakeDist();
+
+   if ((dir < 10.) && (dist > bdist))
+      pilot_acc = 1.;
+
+   lua_pushnumber(L, dir);
+   lua_pushnumber(L, dist);
+   lua_pushnumber(L, bdist);
+   return 3;
 }
 
 
@@ -1869,13 +2486,27 @@ static int aiL_careful_face( lua_State *L )
 static int aiL_aim( lua_State *L )
 {
    Pilot *p;
-   double diff;
-   double mod;
-   double angle;
 
    /* Only acceptable parameter is pilot */
    p = luaL_validpilot(L,1);
 
+   lua_pushnumber(L, ai_aim( p ));
+   return 1;
+}
+
+
+/**
+ * @brief Makes the pilot turn to aim at a pilot.
+ *
+ *    @param p Pilot to aim at.
+ *    @return Angle offset from the aiming direction in degrees.
+ */
+static double ai_aim( Pilot *p )
+{
+   double diff;
+   double mod;
+   double angle;
+
    angle = pilot_aimAngle( cur_pilot, p );
 
    /* Calculate what we need to turn */
@@ -1884,8 +2515,7 @@ static int aiL_aim( lua_State *L )
    pilot_turn = mod * diff;
 
    /* Return distance to target (in grad) */
-   lua_pushnumber(L, ABS(diff*180./M_PI));
-   return 1;
+   return ABS(diff*180./M_PI);
 }
 
 
@@ -2214,7 +2844,7 @@ static int aiL_getrndplanet( lua_State *L )
    if (array_size(cur_system->planets) == 0) return 0; /* no planets */
 
    /* get a random planet */
-   p = RNG(0, array_size(cur_system->planets)-1);
+   p = RNGS(&cur_pilot->rng, 0, array_size(cur_system->planets)-1);
 
    /* Copy the data into a vector */
    planet = cur_system->planets[p]->id;
@@ -2233,7 +2863,7 @@ static int aiL_getrndplanet( lua_State *L )
 static int aiL_getlandplanet( lua_State *L )
 {
    int *ind;
-   int i;
+   int i, n;
    LuaPlanet planet;
    Planet *p;
    int only_friend;
@@ -2246,7 +2876,8 @@ static int aiL_getlandplanet( lua_State *L )
    only_friend = lua_toboolean(L, 1);
 
    /* Allocate memory. */
-   ind = array_create_size( int, array_size(cur_system->planets) );
+   ind = scratch_alloc( sizeof(int) * array_size(cur_system->planets) );
+   n   = 0;
 
    /* Copy friendly planet.s */
    for (i=0; i<array_size(cur_system->planets); i++) {
@@ -2260,22 +2891,19 @@ static int aiL_getlandplanet( lua_State *L )
          continue;
 
       /* Add it. */
-      array_push_back( &ind, i );
+      ind[n++] = i;
    }
 
    /* no planet to land on found */
-   if (array_size(ind)==0) {
-      array_free(ind);
+   if (n==0)
       return 0;
-   }
 
    /* we can actually get a random planet now */
-   i = RNG(0,array_size(ind)-1);
+   i = RNGS(&cur_pilot->rng, 0, n-1);
    p = cur_system->planets[ ind[i] ];
    planet = p->id;
    lua_pushplanet( L, planet );
    cur_pilot->nav_planet   = ind[ i ];
-   array_free(ind);
 
    return 1;
 }
@@ -2382,8 +3010,8 @@ static int aiL_sethyptarget( lua_State *L )
    vec = jp->pos;
 
    /* Introduce some error. */
-   a     = RNGF() * M_PI * 2.;
-   rad   = RNGF() * 0.5 * jp->radius;
+   a     = RNGSF(&cur_pilot->rng) * M_PI * 2.;
+   rad   = RNGSF(&cur_pilot->rng) * 0.5 * jp->radius;
    vect_cadd( &vec, rad*cos(a), rad*sin(a) );
 
    /* Set up target. */
@@ -2446,8 +3074,7 @@ static int aiL_nearhyptarget( lua_State *L )
 static int aiL_rndhyptarget( lua_State *L )
 {
    JumpPoint **jumps, *jiter;
-   int i, r;
-   int *id;
+   int i, r, n;
    LuaJump lj;
 
    /* No jumps in the system. */
@@ -2455,27 +3082,24 @@ static int aiL_rndhyptarget( lua_State *L )
       return 0;
 
    /* Find usable jump points. */
-   jumps = array_create_size( JumpPoint*, array_size(cur_system->jumps) );
-   id    = array_create_size( int, array_size(cur_system->jumps) );
+   jumps = scratch_alloc( sizeof(JumpPoint*) * array_size(cur_system->jumps) );
+   n     = 0;
    for (i=0; i < array_size(cur_system->jumps); i++) {
       jiter = &cur_system->jumps[i];
       /* We want only standard jump points to be used. */
       if (jp_isFlag(jiter, JP_HIDDEN) || jp_isFlag(jiter, JP_EXITONLY))
          continue;
-      array_push_back( &id, i );
-      array_push_back( &jumps, jiter );
+      jumps[n++] = jiter;
    }
+   if (n == 0)
+      return 0;
 
    /* Choose random jump point. */
-   r = RNG( 0, MAX( array_size(jumps)-1, 0) );
+   r = RNGS( &cur_pilot->rng, 0, n-1 );
 
    lj.destid = jumps[r]->targetid;
    lj.srcid = cur_system->id;
 
-   /* Clean up. */
-   array_free(jumps);
-   array_free(id);
-
    /* Return Jump. */
    lua_pushjump( L, lj );
    return 1;
@@ -2532,12 +3156,12 @@ static int aiL_relvel( lua_State *L )
  */
 static int aiL_follow_accurate( lua_State *L )
 {
-   Vector2d point, cons, goal, pv;
-   double radius, angle, Kp, Kd, angle2;
-   Pilot *p, *target;
+   Vector2d goal;
+   double radius, angle, Kp, Kd;
+   Pilot *target;
    const char *method;
+   PilotFormMethod m;
 
-   p = cur_pilot;
    target = luaL_validpilot(L,1);
    radius = luaL_checklong(L,2);
    angle = luaL_checklong(L,3);
@@ -2550,13 +3174,50 @@ static int aiL_follow_accurate( lua_State *L )
       method = luaL_checkstring(L,6);
 
    if (strcmp( method, "absolute" ) == 0)
+      m = PILOT_FORM_ABSOLUTE;
+   else if (strcmp( method, "keepangle" ) == 0)
+      m = PILOT_FORM_KEEPANGLE;
+   else /* method == "velocity" */
+      m = PILOT_FORM_VELOCITY;
+
+   ai_followGoal( &goal, target, radius, angle, Kp, Kd, m );
+
+   /* Push info */
+   lua_pushvector( L, goal );
+
+   return 1;
+
+}
+
+
+/**
+ * @brief Computes the point to face to follow another pilot using a PD controller.
+ *
+ *    @param[out] goal Point to face.
+ *    @param target Pilot to follow.
+ *    @param radius Distance to keep from the target.
+ *    @param angle Angle to keep to the target in degrees.
+ *    @param Kp Proportional gain.
+ *    @param Kd Derivative gain.
+ *    @param method How the angle is measured.
+ */
+static void ai_followGoal( Vector2d *goal, const Pilot *target, double radius,
+      double angle, double Kp, double Kd, PilotFormMethod method )
+{
+   Vector2d point, cons, pv;
+   double angle2;
+   Pilot *p;
+
+   p = cur_pilot;
+
+   if (method == PILOT_FORM_ABSOLUTE)
       angle2 = angle * M_PI/180;
-   else if (strcmp( method, "keepangle" ) == 0) {
+   else if (method == PILOT_FORM_KEEPANGLE) {
       vect_cset( &pv, p->solid->pos.x - target->solid->pos.x,
             p->solid->pos.y - target->solid->pos.y );
       angle2 = VANGLE(pv);
-      }
-   else /* method == "velocity" */
+   }
+   else
       angle2 = angle * M_PI/180 + VANGLE( target->solid->vel );
 
    vect_cset( &point, VX(target->solid->pos) + radius * cos(angle2),
@@ -2568,13 +3229,89 @@ static int aiL_follow_accurate( lua_State *L )
          (point.y - p->solid->pos.y) * Kp +
          (target->solid->vel.y - p->solid->vel.y) *Kd );
 
-   vect_cset( &goal, cons.x + p->solid->pos.x, cons.y + p->solid->pos.y);
+   vect_cset( goal, cons.x + p->solid->pos.x, cons.y + p->solid->pos.y);
+}
 
-   /* Push info */
-   lua_pushvector( L, goal );
 
-   return 1;
+/**
+ * @brief Follows the leader of the pilot, keeping its position in formation.
+ *
+ * Without a position in formation the pilot just stays near the leader.
+ *  Otherwise it approaches its position, makes small corrections once close
+ *  and then flies along with the leader.
+ *
+ *    @luatparam number Kp The first controller parameter.
+ *    @luatparam number Kd The second controller parameter.
+ *    @luatreturn boolean false if there is no leader to follow.
+ * @luafunc follow_fleet
+ */
+static int aiL_follow_fleet( lua_State *L )
+{
+   Pilot *l;
+   PilotFormation *f;
+   Vector2d goal, goal0;
+   double Kp, Kd, dir, dist;
+
+   Kp = luaL_checknumber(L,1);
+   Kd = luaL_checknumber(L,2);
+
+   l = pilot_get( cur_pilot->parent );
+   if ((l == NULL) || pilot_isFlag( l, PILOT_DEAD )) {
+      lua_pushboolean(L,0);
+      return 1;
+   }
+   lua_pushboolean(L,1);
+
+   /* Simply follow unaccurately. */
+   f = &cur_pilot->formation;
+   if (!f->set) {
+      dir = ai_face( &l->solid->pos, 0, 0 );
+      if ((dir < 10.) && (vect_dist( &cur_pilot->solid->pos, &l->solid->pos ) > 300.))
+         pilot_acc = 1.;
+      return 1;
+   }
+
+   ai_followGoal( &goal, l, f->radius, f->angle, Kp, Kd, f->method );
+   dist = vect_dist( &cur_pilot->solid->pos, &goal );
 
+   /* Far away, approach. */
+   if (f->app == 2) {
+      dir = ai_face( &goal, 0, 0 );
+      if (dist > 300.) {
+         if (dir < 10.)
+            pilot_acc = 1.;
+      }
+      else
+         f->app = 1;
+   }
+   /* Only small corrections to do. */
+   else if (f->app == 1) {
+      if (dist > 300.)
+         f->app = 2;
+      else {
+         /* Derivative-augmented controller. */
+         ai_followGoal( &goal0, l, f->radius, f->angle, 2.*Kp, 10.*Kd, f->method );
+         dir = ai_face( &goal0, 0, 0 );
+         if (vect_dist( &cur_pilot->solid->pos, &goal0 ) > 300.) {
+            if (dir < 10.)
+               pilot_acc = 1.;
+         }
+         else
+            f->app = 0;
+      }
+   }
+   /* In position, face forward. */
+   else {
+      ai_face( &goal, 0, 0 );
+      if (dist > 300.)
+         f->app = 1;
+      else {
+         vect_cset( &goal, cur_pilot->solid->pos.x + l->solid->vel.x,
+               cur_pilot->solid->pos.y + l->solid->vel.y );
+         ai_face( &goal, 0, 0 );
+      }
+   }
+   return 1;
 }
 
 
@@ -2869,17 +3606,56 @@ static int aiL_hasafterburner( lua_State *L )
  *    @luafunc shoot
  */
 static int aiL_shoot( lua_State *L )
+{
+   ai_shoot( lua_toboolean(L,1) );
+   return 0;
+}
+
+
+/**
+ * @brief Makes the current pilot shoot.
+ *
+ *    @param secondary Fire secondary weapons instead of primary.
+ */
+static void ai_shoot( int secondary )
 {
    /* Cooldown is similar to a ship being disabled, but the AI continues to
     * think during cooldown, and thus must not be allowed to fire weapons. */
    if (pilot_isFlag(cur_pilot, PILOT_COOLDOWN))
-      return 0;
+      return;
 
-   if (lua_toboolean(L,1))
+   if (secondary)
       ai_setFlag(AI_SECONDARY);
    else
       ai_setFlag(AI_PRIMARY);
-   return 0;
+}
+
+
+/**
+ * @brief Aims at a pilot and shoots if aiming close enough.
+ *
+ * Same as ai.aim followed by ai.shoot when the offset is within the cone.
+ *
+ * @usage dir = ai.aimshoot( target ) -- Shoots primary when within 10 degrees
+ *
+ *    @luatparam Pilot target The pilot to aim at.
+ *    @luatparam[opt=10] number cone Maximum offset to shoot at (in degrees).
+ *    @luatparam[opt=false] boolean secondary Fire secondary weapons instead of primary.
+ *    @luatreturn number The offset from the target aiming position (in degrees).
+ * @luafunc aimshoot
+ */
+static int aiL_aimshoot( lua_State *L )
+{
+   Pilot *p;
+   double dir;
+
+   p   = luaL_validpilot(L,1);
+   dir = ai_aim( p );
+   if (dir < luaL_optnumber(L,2,10.))
+      ai_shoot( lua_toboolean(L,3) );
+
+   lua_pushnumber(L, dir);
+   return 1;
 }
 
 
@@ -3291,6 +4067,71 @@ static int aiL_messages( lua_State *L )
    return 1;
 }
 
+
+/**
+ * @brief Gets the last order given by the pilot's leader to its escorts.
+ *
+ * Orders aren't queued like messages, so the AI has to remember the serial of
+ *  the last order it followed to notice new ones.
+ *
+ *    @luatreturn number Serial of the order, 0 if no order was given.
+ *    @luatreturn string|nil Type of the order.
+ *    @luatreturn Pilot|Jump|nil Pilot or jump the order is about.
+ *    @luafunc order
+ */
+static int aiL_order( lua_State *L )
+{
+   Pilot *l;
+   LuaJump lj;
+
+   l = pilot_get( cur_pilot->parent );
+   if ((l == NULL) || (l->order.serial == 0)) {
+      lua_pushnumber( L, 0 );
+      return 1;
+   }
+
+   lua_pushnumber( L, l->order.serial );
+   lua_pushstring( L, l->order.type );
+   if (l->order.target != 0)
+      lua_pushpilot( L, l->order.target );
+   else if (l->order.jump >= 0) {
+      lj.destid = l->order.jump;
+      lj.srcid  = cur_system->id;
+      lua_pushjump( L, lj );
+   }
+   else
+      lua_pushnil( L );
+   return 3;
+}
+
+
+/**
+ * @brief Gives an order to all the pilots led by the pilot.
+ *
+ *    @luatparam string type Type of the order.
+ *    @luatparam[opt] Pilot|Jump data Pilot or jump the order is about.
+ *    @luafunc setorder
+ */
+static int aiL_setorder( lua_State *L )
+{
+   const char *type;
+   unsigned int target;
+   int jump;
+
+   type   = luaL_checkstring( L, 1 );
+   target = 0;
+   jump   = -1;
+   if (lua_ispilot( L, 2 ))
+      target = lua_topilot( L, 2 );
+   else if (lua_isjump( L, 2 ))
+      jump = lua_tojump( L, 2 )->destid;
+   else if (!lua_isnoneornil( L, 2 ))
+      NLUA_INVALID_PARAMETER( L );
+
+   pilot_order( cur_pilot, type, target, jump );
+   return 0;
+}
+
 /**
  * @}
  */
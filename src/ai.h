@@ -24,6 +24,12 @@ typedef struct Pilot_ Pilot;
 #define MIN_VEL_ERR     5.0 /**< Minimum velocity error. */
 
 
+/* AI levels of detail, see ai_think(). */
+#define AI_LOD_FULL     0  /**< Thinks every frame. */
+#define AI_LOD_NEAR     1  /**< Off screen but in sensor range of the player. */
+#define AI_LOD_FAR      2  /**< Out of sensor range of the player. */
+
+
 /* maximum number of AI timers */
 #define MAX_AI_TIMERS   2 /**< Max amount of AI timers. */
 
@@ -36,6 +42,7 @@ typedef struct Pilot_ Pilot;
 typedef struct Task_ {
    struct Task_* next; /**< Next task */
    char *name; /**< Task name. */
+   size_t name_size; /**< Allocated size of the name, kept when the task is reused. */
    int func; /**< Reference to the function to be run. */
    int done; /**< Task is done and ready for deletion. */
 
@@ -52,9 +59,14 @@ typedef struct Task_ {
  */
 typedef struct AI_Profile_ {
    char* name; /**< Name of the profile. */
+   int loaded; /**< 1 if loaded, -1 if it failed to load, 0 if not loaded yet. */
    nlua_env env; /**< Assosciated Lua Environment. */
    int ref_control; /**< Profile control reference function. */
    int ref_control_manual; /**< Profile manual control reference function. */
+   int ref_create; /**< Profile create reference function. */
+   int ref_attacked; /**< Profile attacked reference function. */
+   int ref_distress; /**< Profile distress reference function. */
+   int attacked_batch; /**< Run attacked() once per frame and attacker, see ai_attackedFlush(). */
 } AI_Profile;
 
 
@@ -62,6 +74,7 @@ typedef struct AI_Profile_ {
  * misc
  */
 AI_Profile* ai_getProfile( char* name );
+int ai_profileExists( const char *name );
 
 
 /*
@@ -88,9 +101,11 @@ void ai_cleartasks( Pilot* p );
  * Misc functions.
  */
 void ai_attacked( Pilot* attacked, const unsigned int attacker, double dmg );
+void ai_attackedFlush (void);
 void ai_refuel( Pilot* refueler, unsigned int target );
 void ai_getDistress( Pilot *p, const Pilot *distressed, const Pilot *attacker );
 void ai_think( Pilot* pilot, const double dt );
+void ai_lodFrame (void);
 void ai_setPilot( Pilot *p );
 
 
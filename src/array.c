@@ -6,23 +6,41 @@
 #include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
+#if DEBUG_ARRAYS
+#include "SDL_atomic.h"
+#endif /* DEBUG_ARRAYS */
 /** @endcond */
 
 #include "array.h"
 
 #include "nstring.h"
 
+#if DEBUG_ARRAYS
+static SDL_atomic_t array_statCreated; /**< Arrays created. */
+static SDL_atomic_t array_statFreed; /**< Arrays freed. */
+static SDL_atomic_t array_statReallocs; /**< Array reallocations. */
+static SDL_atomic_t array_statBytes; /**< Memory reserved by the arrays. */
+#define ARRAY_STAT(stat)   SDL_AtomicAdd( &array_stat##stat, 1 ) /**< Counts an allocation event. */
+#define ARRAY_BYTES(c,n)   SDL_AtomicAdd( &array_statBytes, (int)(c)->_esize * (int)(n) ) /**< Counts n elements being reserved. */
+#else /* DEBUG_ARRAYS */
+#define ARRAY_STAT(stat)   ((void)0) /**< Counters are only kept when debugging arrays. */
+#define ARRAY_BYTES(c,n)   ((void)0) /**< Counters are only kept when debugging arrays. */
+#endif /* DEBUG_ARRAYS */
+
 void *_array_create_helper(size_t e_size, size_t capacity)
 {
    if ( capacity <= 0 )
       capacity = 1;
 
    _private_container *c = malloc(sizeof(_private_container) + e_size * capacity);
+   ARRAY_STAT(Created);
 #if DEBUG_ARRAYS
    c->_sentinel = ARRAY_SENTINEL;
+   c->_esize = e_size;
 #endif
    c->_reserved = capacity;
    c->_size = 0;
+   ARRAY_BYTES( c, capacity );
    return c->_array;
 }
 
@@ -33,11 +51,14 @@ static void _array_resize_container(_private_container **c_, size_t e_size, size
 
    if (new_size > c->_reserved) {
       /* increases the reserved space */
+      ARRAY_BYTES( c, -(intptr_t)c->_reserved );
       do
          c->_reserved *= 2;
       while (new_size > c->_reserved);
+      ARRAY_BYTES( c, c->_reserved );
 
       c = realloc(c, sizeof(_private_container) + e_size * c->_reserved);
+      ARRAY_STAT(Reallocs);
    }
 
    c->_size = new_size;
@@ -56,14 +77,30 @@ void *_array_grow_helper(void **a, size_t e_size)
    _private_container *c = _array_private_container(*a);
    if (c->_size == c->_reserved) {
       /* Array full, doubles the reserved memory */
+      ARRAY_BYTES( c, c->_reserved );
       c->_reserved *= 2;
       c = realloc(c, sizeof(_private_container) + e_size * c->_reserved);
+      ARRAY_STAT(Reallocs);
       *a = c->_array;
    }
 
    return c->_array + (c->_size++) * e_size;
 }
 
+void _array_reserve_helper(void **a, size_t e_size, size_t capacity)
+{
+   assert( capacity <= (size_t)INT_MAX );
+   _private_container *c = _array_private_container(*a);
+   if (capacity <= c->_reserved)
+      return;
+
+   ARRAY_BYTES( c, capacity - c->_reserved );
+   c->_reserved = capacity;
+   c = realloc(c, sizeof(_private_container) + e_size * c->_reserved);
+   ARRAY_STAT(Reallocs);
+   *a = c->_array;
+}
+
 void _array_erase_helper(void **a, size_t e_size, void *first, void *last)
 {
    intptr_t diff = (char *)last - (char *)first;
@@ -80,9 +117,22 @@ void _array_erase_helper(void **a, size_t e_size, void *first, void *last)
    c->_size -= diff / e_size;
 }
 
+void _array_erase_unordered_helper(void **a, size_t e_size, void *elem)
+{
+   _private_container *c = _array_private_container(*a);
+   char *last = c->_array + (c->_size - 1) * e_size;
+
+   assert("Invalid iterator passed to array erase" && (c->_size > 0) &&
+         ((char *)elem >= c->_array) && ((char *)elem <= last));
+   if ((char *)elem != last)
+      memcpy(elem, last, e_size);
+   c->_size--;
+}
+
 void _array_shrink_helper(void **a, size_t e_size)
 {
    _private_container *c = _array_private_container(*a);
+   ARRAY_BYTES( c, -(intptr_t)c->_reserved );
    if (c->_size != 0) {
       c = realloc(c, sizeof(_private_container) + e_size * c->_size);
       c->_reserved = c->_size;
@@ -90,6 +140,8 @@ void _array_shrink_helper(void **a, size_t e_size)
       c = realloc(c, sizeof(_private_container) + e_size);
       c->_reserved = 1;
    }
+   ARRAY_BYTES( c, c->_reserved );
+   ARRAY_STAT(Reallocs);
    *a = c->_array;
 }
 
@@ -97,9 +149,30 @@ void _array_free_helper(void *a)
 {
    if (a==NULL)
       return;
+   ARRAY_STAT(Freed);
+   ARRAY_BYTES( _array_private_container(a), -(intptr_t)_array_private_container(a)->_reserved );
    free(_array_private_container(a));
 }
 
+/**
+ * @brief Gets the allocation counters of the arrays.
+ *
+ *    @return The counters, all zero unless built with DEBUG_ARRAYS.
+ */
+ArrayStats array_stats( void )
+{
+   ArrayStats stats;
+#if DEBUG_ARRAYS
+   stats.created  = SDL_AtomicGet( &array_statCreated );
+   stats.freed    = SDL_AtomicGet( &array_statFreed );
+   stats.reallocs = SDL_AtomicGet( &array_statReallocs );
+   stats.bytes    = SDL_AtomicGet( &array_statBytes );
+#else /* DEBUG_ARRAYS */
+   memset( &stats, 0, sizeof(stats) );
+#endif /* DEBUG_ARRAYS */
+   return stats;
+}
+
 void *_array_copy_helper(size_t e_size, void *a)
 {
    _private_container *c = _array_private_container(a);
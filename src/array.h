@@ -55,6 +55,7 @@
 typedef struct {
 #if DEBUG_ARRAYS
    int _sentinel;         /**< Sentinel for when debugging. */
+   size_t _esize;         /**< Size of an element, for counting the memory. */
 #endif
    size_t _reserved;      /**< Number of elements reserved */
    size_t _size;          /**< Number of elements in the array */
@@ -69,6 +70,19 @@ void _array_erase_helper(void **a, size_t e_size, void *first, void *last);
 void _array_shrink_helper(void **a, size_t e_size);
 void _array_free_helper(void *a);
 void *_array_copy_helper(size_t e_size, void *a);
+void _array_reserve_helper(void **a, size_t e_size, size_t capacity);
+void _array_erase_unordered_helper(void **a, size_t e_size, void *elem);
+
+/**
+ * @brief Allocation counters of the arrays, only kept with DEBUG_ARRAYS.
+ */
+typedef struct ArrayStats_ {
+   int created;   /**< Arrays created. */
+   int freed;     /**< Arrays freed. */
+   int reallocs;  /**< Times an array had to be moved to grow or shrink. */
+   int bytes;     /**< Memory reserved by the arrays still allocated. */
+} ArrayStats;
+ArrayStats array_stats( void );
 
 /**
  * @brief Gets the container of an array.
@@ -115,6 +129,18 @@ static inline _private_container *_array_private_container(void *a)
  */
 #define array_resize(ptr_array, new_size) \
    (_array_resize_helper((void **)(ptr_array), sizeof((ptr_array)[0][0]), new_size))
+/**
+ * @brief Makes sure the array can hold capacity elements without reallocating.
+ *
+ * Does not change the size of the array, and never shrinks it.
+ *
+ * @note Invalidates all iterators.
+ *
+ *    @param ptr_array Array being manipulated.
+ *    @param capacity Number of elements to reserve space for.
+ */
+#define array_reserve(ptr_array, capacity) \
+   (_array_reserve_helper((void **)(ptr_array), sizeof((ptr_array)[0][0]), capacity))
 /**
  * @brief Increases the number of elements by one and returns the last element.
  *
@@ -143,6 +169,18 @@ static inline _private_container *_array_private_container(void *a)
  */
 #define array_erase(ptr_array, first, last) \
       (_array_erase_helper((void **)(ptr_array), sizeof((ptr_array)[0][0]), (void *)(first), (void *)(last)))
+/**
+ * @brief Erases an element by moving the last element into its place.
+ *
+ * Constant time unlike array_erase(), but doesn't preserve the order.
+ *
+ * @note Invalidates iterators to the last element.
+ *
+ *    @param ptr_array Array being manipulated.
+ *    @param elem Iterator to erase.
+ */
+#define array_erase_unordered(ptr_array, elem) \
+      (_array_erase_unordered_helper((void **)(ptr_array), sizeof((ptr_array)[0][0]), (void *)(elem)))
 /**
  * @brief Shrinks memory to fit only `size' elements.
  *
@@ -25,6 +25,7 @@
 #include "nlua_col.h"
 #include "nlua_tex.h"
 #include "nlua_camera.h"
+#include "nlua_system.h"
 #include "nluadef.h"
 #include "nstring.h"
 #include "nxml.h"
@@ -34,6 +35,9 @@
 #include "rng.h"
 
 
+#define BACKGROUND_LAYER_MAX  4096 /**< Largest side of a composited background layer. */
+
+
 /**
  * @brief Represents a background image like say a Nebula.
  */
@@ -50,6 +54,28 @@ static background_image_t *bkg_image_arr_bk = NULL; /**< Background image array
 static background_image_t *bkg_image_arr_ft = NULL; /**< Background image array to display (in front of stars). */
 
 
+/**
+ * @brief Consecutive background images with the same movement.
+ *
+ * They keep the same relative positions whatever the camera does, so when
+ *  there are several they are composited once into a texture that gets drawn
+ *  instead of the images.
+ */
+typedef struct background_layer_s {
+   int start; /**< First image of the layer. */
+   int n; /**< Number of images in the layer. */
+   double move; /**< How many pixels it moves for each pixel the player moves. */
+   double x; /**< X position of the composited images before moving. */
+   double y; /**< Y position of the composited images before moving. */
+   glTexture *tex; /**< Composited images, NULL if they are drawn one by one. */
+   GLuint fbo; /**< Framebuffer used to composite tex. */
+} background_layer_t;
+static background_layer_t *bkg_layer_arr_bk = NULL; /**< Layers of bkg_image_arr_bk. */
+static background_layer_t *bkg_layer_arr_ft = NULL; /**< Layers of bkg_image_arr_ft. */
+static int bkg_layers_valid = 0; /**< Whether or not the layers match the images. */
+static double bkg_layers_brightness = 0.; /**< Brightness the layers were composited with. */
+
+
 static unsigned int bkg_idgen = 0; /**< ID generator for backgrounds. */
 
 
@@ -60,13 +86,16 @@ static nlua_env bkg_cur_env = LUA_NOREF; /**< Current Lua state. */
 static nlua_env bkg_def_env = LUA_NOREF; /**< Default Lua state. */
 static int bkg_L_renderbg = LUA_NOREF; /**< Background rendering function. */
 static int bkg_L_renderfg = LUA_NOREF; /**< Overlay rendering function. */
+static nlua_env bkg_next_env = LUA_NOREF; /**< Lua state created ahead of time by background_prefetch(). */
+static char *bkg_next_name = NULL; /**< Name of the script of bkg_next_env. */
 
 
 /*
  * Background stars.
  */
 #define STAR_BUF     250 /**< Area to leave around screen for stars, more = less repetition */
-static gl_vbo *star_vertexVBO = NULL; /**< Star Vertex VBO. */
+static gl_vbo *star_vertexVBO = NULL; /**< Star Vertex VBO, positions relative to the star field size. */
+static unsigned int star_vertexN = 0; /**< Number of stars in star_vertexVBO. */
 static unsigned int nstars = 0; /**< Total stars. */
 static GLfloat star_x = 0.; /**< Star X movement. */
 static GLfloat star_y = 0.; /**< Star Y movement. */
@@ -75,9 +104,19 @@ static GLfloat star_y = 0.; /**< Star Y movement. */
 /*
  * Prototypes.
  */
-static void background_renderImages( background_image_t *bkg_arr );
+static void background_renderImages( const background_image_t *bkg_arr,
+      const background_layer_t *layers );
+static void background_renderImage( const background_image_t *bkg );
+static void background_imageColour( glColour *col, const background_image_t *bkg );
+static int background_imagesReady( const background_image_t *bkg_arr );
+static void background_buildLayers( background_layer_t **layers,
+      const background_image_t *bkg_arr );
+static void background_compositeLayer( background_layer_t *l,
+      const background_image_t *bkg_arr );
+static void background_clearLayers( background_layer_t **layers );
 static nlua_env background_create( const char *path );
 static void background_clearCurrent (void);
+static void background_clearNext (void);
 static void background_clearImgArr( background_image_t **arr );
 /* Sorting. */
 static int bkg_compare( const void *p1, const void *p2 );
@@ -87,12 +126,15 @@ static void bkg_sort( background_image_t *arr );
 /**
  * @brief Initializes background stars.
  *
+ * The stars are stored relative to the size of the star field, so changing
+ *  systems only changes how many of them get drawn. The buffer is only
+ *  regenerated when more stars than ever are needed.
+ *
  *    @param n Number of stars to add (stars per 800x640 screen).
  */
 void background_initStars( int n )
 {
    unsigned int i;
-   GLfloat w, h, hw, hh;
    double size;
    GLfloat *star_vertex;
 
@@ -100,36 +142,31 @@ void background_initStars( int n )
    size  = SCREEN_W*SCREEN_H+STAR_BUF*STAR_BUF;
    size /= pow2(conf.zoom_far);
 
-   /* Calculate star buffer. */
-   w  = (SCREEN_W + 2.*STAR_BUF);
-   w += conf.zoom_stars * (w / conf.zoom_far - 1.);
-   h  = (SCREEN_H + 2.*STAR_BUF);
-   h += conf.zoom_stars * (h / conf.zoom_far - 1.);
-   hw = w / 2.;
-   hh = h / 2.;
-
    /* Calculate stars. */
    size  *= n;
    nstars = (unsigned int)(size/(800.*600.));
+   if ((star_vertexVBO != NULL) && (nstars <= star_vertexN))
+      return;
 
    /* Create data. */
-   star_vertex = malloc( nstars * sizeof(GLfloat) * 6 );
+   star_vertexN = MAX( nstars, 2*star_vertexN );
+   star_vertex = malloc( star_vertexN * sizeof(GLfloat) * 6 );
 
-   for (i=0; i < nstars; i++) {
+   for (i=0; i < star_vertexN; i++) {
       /* Set the position. */
-      star_vertex[6*i+0] = RNGF()*w - hw;
-      star_vertex[6*i+1] = RNGF()*h - hh;
+      star_vertex[6*i+0] = RNGF_COSMETIC();
+      star_vertex[6*i+1] = RNGF_COSMETIC();
       star_vertex[6*i+3] = star_vertex[6*i+0];
       star_vertex[6*i+4] = star_vertex[6*i+1];
       /* Set the colour. */
-      star_vertex[6*i+2] = RNGF()*0.6 + 0.2;
+      star_vertex[6*i+2] = RNGF_COSMETIC()*0.6 + 0.2;
       star_vertex[6*i+5] = star_vertex[6*i+2];
    }
 
    /* Recreate VBO. */
    gl_vboDestroy( star_vertexVBO );
    star_vertexVBO = gl_vboCreateStatic(
-         nstars * sizeof(GLfloat) * 6, star_vertex );
+         star_vertexN * sizeof(GLfloat) * 6, star_vertex );
 
    free(star_vertex);
 }
@@ -161,7 +198,7 @@ void background_renderStars( const double dt )
    double z;
    gl_Matrix4 projection;
 
-   glUseProgram(shaders.stars.program);
+   gl_useProgram(shaders.stars.program);
 
    glLineWidth(1 / gl_screen.scale);
 
@@ -215,7 +252,7 @@ void background_renderStars( const double dt )
    glUniform2f(shaders.stars.wh, w, h);
    glUniform2f(shaders.stars.xy, x, y);
    glUniform1f(shaders.stars.scale, 1 / gl_screen.scale);
-   glDrawArrays( GL_LINES, 0, nstars );
+   gl_drawArrays( GL_LINES, 0, nstars );
 
    /* Disable vertex array. */
    glDisableVertexAttribArray( shaders.stars.vertex );
@@ -223,7 +260,7 @@ void background_renderStars( const double dt )
 
    glLineWidth(1 / gl_screen.scale);
 
-   glUseProgram(0);
+   gl_useProgram(0);
 
    /* Check for errors. */
    gl_checkErr();
@@ -235,9 +272,20 @@ void background_renderStars( const double dt )
  */
 void background_render( double dt )
 {
-   background_renderImages( bkg_image_arr_bk );
+   /* Composite the layers again when the images or their colour changed. */
+   if ((conf.bg_brightness > 0.) && (!bkg_layers_valid ||
+            (bkg_layers_brightness != conf.bg_brightness)) &&
+         background_imagesReady( bkg_image_arr_bk ) &&
+         background_imagesReady( bkg_image_arr_ft )) {
+      background_buildLayers( &bkg_layer_arr_bk, bkg_image_arr_bk );
+      background_buildLayers( &bkg_layer_arr_ft, bkg_image_arr_ft );
+      bkg_layers_valid      = 1;
+      bkg_layers_brightness = conf.bg_brightness;
+   }
+
+   background_renderImages( bkg_image_arr_bk, bkg_layer_arr_bk );
    background_renderStars(dt);
-   background_renderImages( bkg_image_arr_ft );
+   background_renderImages( bkg_image_arr_ft, bkg_layer_arr_ft );
 
    if (bkg_L_renderbg != LUA_NOREF) {
       lua_rawgeti( naevL, LUA_REGISTRYINDEX, bkg_L_renderbg );
@@ -322,6 +370,7 @@ unsigned int background_addImage( glTexture *image, double x, double y,
 
    /* Sort if necessary. */
    bkg_sort( *arr );
+   bkg_layers_valid = 0;
 
    return bkg_idgen;
 }
@@ -329,36 +378,246 @@ unsigned int background_addImage( glTexture *image, double x, double y,
 
 /**
  * @brief Renders the background images.
+ *
+ *    @param bkg_arr Images to render.
+ *    @param layers Layers of the images, drawn instead of them when valid.
  */
-static void background_renderImages( background_image_t *bkg_arr )
+static void background_renderImages( const background_image_t *bkg_arr,
+      const background_layer_t *layers )
 {
-   int i;
-   background_image_t *bkg;
-   double px,py, x,y, xs,ys, z;
-   glColour col;
+   int i, j;
+   const background_layer_t *l;
+   double px,py, xs,ys, z;
 
    /* Skip rendering altogether if disabled. */
    if (conf.bg_brightness <= 0.)
       return;
 
-   /* Render images in order. */
+   /* Layers are out of date, just render the images in order. */
+   if (!bkg_layers_valid) {
+      for (i=0; i<array_size(bkg_arr); i++)
+         background_renderImage( &bkg_arr[i] );
+      return;
+   }
+
+   cam_getPos( &px, &py );
+   z = cam_getZoom();
+   for (i=0; i<array_size(layers); i++) {
+      l = &layers[i];
+      if (l->tex == NULL) {
+         for (j=0; j<l->n; j++)
+            background_renderImage( &bkg_arr[ l->start+j ] );
+         continue;
+      }
+
+      /* The layer was composited with premultiplied alpha. */
+      gl_gameToScreenCoords( &xs, &ys, px + l->x - px*l->move,
+            py + l->y - py*l->move );
+      gl_blendFunc( GL_ONE, GL_ONE_MINUS_SRC_ALPHA );
+      gl_blitScale( l->tex, xs, ys, z*l->tex->sw, z*l->tex->sh, &cWhite );
+      gl_blendFunc( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA );
+   }
+}
+
+
+/**
+ * @brief Renders a single background image.
+ *
+ *    @param bkg Image to render.
+ */
+static void background_renderImage( const background_image_t *bkg )
+{
+   double px,py, x,y, xs,ys, z;
+   glColour col;
+
+   cam_getPos( &px, &py );
+   x  = px + (bkg->x - px) * bkg->move - bkg->scale*bkg->image->sw/2.;
+   y  = py + (bkg->y - py) * bkg->move - bkg->scale*bkg->image->sh/2.;
+   gl_gameToScreenCoords( &xs, &ys, x, y );
+   z = cam_getZoom();
+   z *= bkg->scale;
+   /* TODO add rotation too! */
+   background_imageColour( &col, bkg );
+   gl_blitScale( bkg->image, xs, ys,
+         z*bkg->image->sw, z*bkg->image->sh, &col );
+}
+
+
+/**
+ * @brief Gets the colour a background image is drawn with.
+ *
+ *    @param[out] col Colour to draw with.
+ *    @param bkg Image to get the colour of.
+ */
+static void background_imageColour( glColour *col, const background_image_t *bkg )
+{
+   col->r = bkg->col.r * conf.bg_brightness;
+   col->g = bkg->col.g * conf.bg_brightness;
+   col->b = bkg->col.b * conf.bg_brightness;
+   col->a = bkg->col.a;
+}
+
+
+/**
+ * @brief Checks to see if the images can be composited.
+ *
+ * Evicted images are reloaded in the background, compositing them before
+ *  they are back would leave holes in the layers.
+ *
+ *    @param bkg_arr Images to check.
+ *    @return 1 if all the images are loaded.
+ */
+static int background_imagesReady( const background_image_t *bkg_arr )
+{
+   int i, ready;
+
+   ready = 1;
+   for (i=0; i<array_size(bkg_arr); i++)
+      if (!gl_texUse( bkg_arr[i].image ))
+         ready = 0;
+   return ready;
+}
+
+
+/**
+ * @brief Splits background images into layers and composites them.
+ *
+ *    @param[in,out] layers Layers to rebuild.
+ *    @param bkg_arr Images sorted by movement.
+ */
+static void background_buildLayers( background_layer_t **layers,
+      const background_image_t *bkg_arr )
+{
+   int i;
+   background_layer_t *l;
+
+   background_clearLayers( layers );
+   if (*layers == NULL)
+      *layers = array_create( background_layer_t );
+
+   l = NULL;
    for (i=0; i<array_size(bkg_arr); i++) {
-      bkg = &bkg_arr[i];
-
-      cam_getPos( &px, &py );
-      x  = px + (bkg->x - px) * bkg->move - bkg->scale*bkg->image->sw/2.;
-      y  = py + (bkg->y - py) * bkg->move - bkg->scale*bkg->image->sh/2.;
-      gl_gameToScreenCoords( &xs, &ys, x, y );
-      z = cam_getZoom();
-      z *= bkg->scale;
-      /* TODO add rotation too! */
-      col.r = bkg->col.r * conf.bg_brightness;
-      col.g = bkg->col.g * conf.bg_brightness;
-      col.b = bkg->col.b * conf.bg_brightness;
-      col.a = bkg->col.a;
-      gl_blitScale( bkg->image, xs, ys,
-            z*bkg->image->sw, z*bkg->image->sh, &col );
+      if ((l == NULL) || (bkg_arr[i].move != l->move)) {
+         l        = &array_grow( layers );
+         memset( l, 0, sizeof(background_layer_t) );
+         l->start = i;
+         l->move  = bkg_arr[i].move;
+      }
+      l->n++;
+   }
+
+   for (i=0; i<array_size(*layers); i++)
+      background_compositeLayer( &(*layers)[i], bkg_arr );
+}
+
+
+/**
+ * @brief Composites the images of a layer into a texture.
+ *
+ * The texture has one pixel per unit at a zoom of 1 so it only depends on the
+ *  images, zooming and resizing the screen just scale it. Layers with a
+ *  single image or too large to fit are left to draw their images directly.
+ *
+ *    @param l Layer to composite.
+ *    @param bkg_arr Images the layer is made of.
+ */
+static void background_compositeLayer( background_layer_t *l,
+      const background_image_t *bkg_arr )
+{
+   int i, w, h, max;
+   double x, y, x1,y1, x2,y2;
+   const background_image_t *bkg;
+   GLint fbo, viewport[4];
+   GLenum status;
+   gl_Matrix4 view;
+   glColour col;
+
+   l->tex = NULL;
+   if (l->n < 2)
+      return;
+
+   /* Bounding box before moving. */
+   x1 = y1 = HUGE_VAL;
+   x2 = y2 = -HUGE_VAL;
+   for (i=0; i<l->n; i++) {
+      bkg = &bkg_arr[ l->start+i ];
+      x  = bkg->x * l->move - bkg->scale*bkg->image->sw/2.;
+      y  = bkg->y * l->move - bkg->scale*bkg->image->sh/2.;
+      x1 = MIN( x1, x );
+      y1 = MIN( y1, y );
+      x2 = MAX( x2, x + bkg->scale*bkg->image->sw );
+      y2 = MAX( y2, y + bkg->scale*bkg->image->sh );
+   }
+   w   = (int)ceil( x2 - x1 );
+   h   = (int)ceil( y2 - y1 );
+   max = MIN( BACKGROUND_LAYER_MAX, gl_screen.tex_max );
+   if ((w <= 0) || (h <= 0) || (w > max) || (h > max))
+      return;
+   l->x = x1;
+   l->y = y1;
+
+   /* Set up the framebuffer. */
+   glGetIntegerv( GL_FRAMEBUFFER_BINDING, &fbo );
+   glGetIntegerv( GL_VIEWPORT, viewport );
+   l->tex = gl_loadImageData( NULL, w, h, 1, 1, NULL );
+   glGenFramebuffers( 1, &l->fbo );
+   glBindFramebuffer( GL_FRAMEBUFFER, l->fbo );
+   glFramebufferTexture2D( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, l->tex->texture, 0 );
+   status = glCheckFramebufferStatus( GL_FRAMEBUFFER );
+   if (status != GL_FRAMEBUFFER_COMPLETE) {
+      WARN(_("Error setting up framebuffer!"));
+      glBindFramebuffer( GL_FRAMEBUFFER, fbo );
+      glDeleteFramebuffers( 1, &l->fbo );
+      gl_freeTexture( l->tex );
+      l->tex = NULL;
+      return;
+   }
+   glViewport( 0, 0, w, h );
+   glClearColor( 0., 0., 0., 0. );
+   glClear( GL_COLOR_BUFFER_BIT );
+   glClearColor( 0., 0., 0., 1. );
+
+   /* Draw the images as they would be on screen, keeping the alpha right. */
+   view = gl_view_matrix;
+   gl_view_matrix = gl_Matrix4_Ortho( 0., w, 0., h, -1., 1. );
+   gl_blendFuncSeparate( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA,
+         GL_ONE, GL_ONE_MINUS_SRC_ALPHA );
+   for (i=0; i<l->n; i++) {
+      bkg = &bkg_arr[ l->start+i ];
+      x  = bkg->x * l->move - bkg->scale*bkg->image->sw/2.;
+      y  = bkg->y * l->move - bkg->scale*bkg->image->sh/2.;
+      background_imageColour( &col, bkg );
+      gl_blitScale( bkg->image, x - x1, y - y1,
+            bkg->scale*bkg->image->sw, bkg->scale*bkg->image->sh, &col );
+   }
+   gl_blendFunc( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA );
+   gl_view_matrix = view;
+
+   /* Restore state. */
+   glBindFramebuffer( GL_FRAMEBUFFER, fbo );
+   glViewport( viewport[0], viewport[1], viewport[2], viewport[3] );
+   gl_checkErr();
+}
+
+
+/**
+ * @brief Frees the composited layers.
+ *
+ *    @param layers Layers to clear.
+ */
+static void background_clearLayers( background_layer_t **layers )
+{
+   int i;
+   background_layer_t *l;
+
+   for (i=0; i<array_size(*layers); i++) {
+      l = &(*layers)[i];
+      if (l->tex == NULL)
+         continue;
+      glDeleteFramebuffers( 1, &l->fbo );
+      gl_freeTexture( l->tex );
    }
+   array_erase( layers, array_begin(*layers), array_end(*layers) );
 }
 
 
@@ -434,9 +693,15 @@ int background_load( const char *name )
    /* Load default. */
    if (name == NULL)
       bkg_cur_env = bkg_def_env;
+   /* Already created by background_prefetch(). */
+   else if ((bkg_next_name != NULL) && (strcmp( bkg_next_name, name ) == 0)) {
+      bkg_cur_env  = bkg_next_env;
+      bkg_next_env = LUA_NOREF;
+   }
    /* Load new script. */
    else
       bkg_cur_env = background_create( name );
+   background_clearNext();
 
    /* Comfort. */
    env = bkg_cur_env;
@@ -461,6 +726,63 @@ int background_load( const char *name )
 }
 
 
+/**
+ * @brief Gets a background ready for a system that is about to be entered.
+ *
+ * Creates the Lua state of the system's background script so that
+ *  background_load() doesn't have to, and runs its optional prefetch function
+ *  so it can start decoding the images it will open.
+ *
+ *    @param sys System whose background to prefetch.
+ */
+void background_prefetch( StarSystem *sys )
+{
+   int ret;
+   nlua_env env;
+   const char *err;
+
+   background_clearNext();
+
+   if (sys->background == NULL)
+      env = bkg_def_env;
+   else {
+      bkg_next_env  = background_create( sys->background );
+      bkg_next_name = strdup( sys->background );
+      env = bkg_next_env;
+   }
+   if (env == LUA_NOREF)
+      return;
+
+   /* Prefetching is optional. */
+   nlua_getenv(env,"prefetch");
+   if (lua_isnil(naevL,-1)) {
+      lua_pop(naevL,1);
+      return;
+   }
+   lua_pushsystem(naevL, system_index( sys ));
+   ret = nlua_pcall(env, 1, 0);
+   if (ret != 0) { /* error has occurred */
+      err = (lua_isstring(naevL,-1)) ? lua_tostring(naevL,-1) : NULL;
+      WARN( _("Background -> 'prefetch' : %s"),
+            (err) ? err : _("unknown error"));
+      lua_pop(naevL, 1);
+   }
+}
+
+
+/**
+ * @brief Destroys the background script created ahead of time.
+ */
+static void background_clearNext (void)
+{
+   if (bkg_next_env != LUA_NOREF)
+      nlua_freeEnv( bkg_next_env );
+   bkg_next_env = LUA_NOREF;
+   free( bkg_next_name );
+   bkg_next_name = NULL;
+}
+
+
 /**
  * @brief Destroys the current running background script.
  */
@@ -490,6 +812,9 @@ void background_clear (void)
    /* Clear the backgrounds. */
    background_clearImgArr( &bkg_image_arr_bk );
    background_clearImgArr( &bkg_image_arr_ft );
+   background_clearLayers( &bkg_layer_arr_bk );
+   background_clearLayers( &bkg_layer_arr_ft );
+   bkg_layers_valid = 0;
 }
 
 
@@ -529,14 +854,20 @@ void background_free (void)
    bkg_image_arr_ft = NULL;
    array_free( bkg_image_arr_bk );
    bkg_image_arr_bk = NULL;
+   array_free( bkg_layer_arr_ft );
+   bkg_layer_arr_ft = NULL;
+   array_free( bkg_layer_arr_bk );
+   bkg_layer_arr_bk = NULL;
 
    /* Free the Lua. */
    if (bkg_cur_env != LUA_NOREF)
       nlua_freeEnv( bkg_cur_env );
    bkg_cur_env = LUA_NOREF;
+   background_clearNext();
 
    gl_vboDestroy( star_vertexVBO );
    star_vertexVBO = NULL;
+   star_vertexN = 0;
 
    nstars = 0;
 }
@@ -10,6 +10,7 @@
 
 #include "colour.h"
 #include "opengl.h"
+#include "space.h"
 
 
 /* Render. */
@@ -28,6 +29,7 @@ void background_moveStars( double x, double y );
 /* Init. */
 int background_init (void);
 int background_load( const char *name );
+void background_prefetch( StarSystem *sys );
 
 
 /* Clean up. */
@@ -0,0 +1,698 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+
+/**
+ * @file bench.c
+ *
+ * @brief Runs the simulation on a scripted scenario for benchmarking.
+ *
+ * A scenario is a Lua script with the standard libraries that sets some
+ *  globals and optionally defines a setup() function, which gets called once
+ *  the system is entered to add the pilots:
+ *
+ *  - bench_system: System to run in (required).
+ *  - bench_ticks: Number of updates to run (default 3600).
+ *  - bench_dt: Length of an update in seconds (default 1/60).
+ *  - bench_seed: Seed of the random number generator (default 0).
+ *  - bench_render: Also render every tick, timing the GPU work too (default false).
+ *  - bench_baseline: Table of p50, p95 and p99 tick times (ms) not to exceed.
+ *  - bench_tolerance: How much over the baseline is still a pass (default 1.25).
+ *
+ * A tick(i) function, if defined, is called before every update with the tick
+ *  number, so scenarios can spawn more pilots or order them to land or jump as
+ *  they go.
+ *
+ * The simulation is updated with a fixed dt and seeded random numbers, so runs
+ *  are comparable: a checksum of the state of the pilots is reported along
+ *  with the timings, and should only change with the content or the
+ *  simulation code. The percentiles of the tick times and, with the profiler,
+ *  the mean cost of the zones are printed as a JSON line to stdout. Exceeding
+ *  the baseline fails the run, which is how the scenarios in test/bench are
+ *  used as meson tests.
+ *
+ * Kernels are microbenchmarks of hot engine functions on fixed synthetic
+ *  inputs, run once the data is loaded. Each prints a JSON line to stdout with
+ *  its timing and a checksum of the results, so numbers can be diffed between
+ *  releases and changed results stand out.
+ */
+
+
+/** @cond */
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "SDL.h"
+
+#include "naev.h"
+/** @endcond */
+
+#include "bench.h"
+
+#include "array.h"
+#include "collision.h"
+#include "cond.h"
+#include "economy.h"
+#include "font.h"
+#include "log.h"
+#include "map.h"
+#include "ndata.h"
+#include "nfile.h"
+#include "nlua.h"
+#include "ntime.h"
+#include "opengl.h"
+#include "opengl_tex.h"
+#include "physics.h"
+#include "pilot.h"
+#include "profile.h"
+#include "render.h"
+#include "rng.h"
+#include "space.h"
+
+
+#define BENCH_TICKS        3600 /**< Default number of updates. */
+#define BENCH_DT           (1./60.) /**< Default length of an update. */
+#define BENCH_TOLERANCE    1.25 /**< Default tolerance over the baseline. */
+#define BENCH_POLY_POINTS  16 /**< Points of the synthetic collision polygons. */
+#define BENCH_SPRITE_SIZE  96 /**< Size of the synthetic sprites. */
+
+
+/**
+ * @brief A microbenchmark of an engine function.
+ */
+typedef struct BenchKernel_ {
+   const char *name; /**< Name to select it with. */
+   uint64_t (*run)( int n ); /**< Runs n iterations and returns a checksum. */
+   int n; /**< Number of iterations. */
+} BenchKernel;
+
+
+/*
+ * Prototypes.
+ */
+static double bench_number( nlua_env env, const char *name, double def );
+static uint64_t bench_hash( uint64_t h, const void *data, size_t len );
+static uint64_t bench_checksum (void);
+static int bench_compare( const void *a, const void *b );
+static double bench_percentile( const double *sorted, double p );
+static int bench_baseline( nlua_env env, const char *script, const double *sorted );
+static void bench_polygon( CollPoly *poly, float *x, float *y, float r );
+static uint64_t bench_collideSprite( int n );
+static uint64_t bench_collidePolygon( int n );
+static uint64_t bench_collideLinePolygon( int n );
+static uint64_t bench_physics( int n );
+static uint64_t bench_economy( int n );
+static uint64_t bench_jumpPath( int n );
+static uint64_t bench_array( int n );
+static uint64_t bench_fontWidth( int n );
+static uint64_t bench_cond( int n );
+static uint64_t bench_condChunk( int n );
+
+
+static const BenchKernel bench_kernels[] = {
+   { "collide_sprite", bench_collideSprite, 200000 },
+   { "collide_polygon", bench_collidePolygon, 200000 },
+   { "collide_line_polygon", bench_collideLinePolygon, 200000 },
+   { "physics", bench_physics, 1000 },
+   { "economy", bench_economy, 200 },
+   { "jump_path", bench_jumpPath, 2000 },
+   { "array", bench_array, 200 },
+   { "font_width", bench_fontWidth, 20000 },
+   { "cond", bench_cond, 20000 },
+   { "cond_chunk", bench_condChunk, 100000 },
+}; /**< Available kernels. */
+
+
+/**
+ * @brief Gets a number global from the scenario.
+ */
+static double bench_number( nlua_env env, const char *name, double def )
+{
+   double n;
+   nlua_getenv( env, name );
+   n = luaL_optnumber( naevL, -1, def );
+   lua_pop( naevL, 1 );
+   return n;
+}
+
+
+/**
+ * @brief Adds data to a hash (FNV-1a).
+ */
+static uint64_t bench_hash( uint64_t h, const void *data, size_t len )
+{
+   size_t i;
+   const unsigned char *c = data;
+   for (i=0; i<len; i++) {
+      h ^= c[i];
+      h *= 1099511628211ULL;
+   }
+   return h;
+}
+
+
+/**
+ * @brief Gets a checksum of the state of all the pilots.
+ */
+static uint64_t bench_checksum (void)
+{
+   int i;
+   uint64_t h;
+   double state[8];
+   Pilot *const* pilot_stack;
+   const Pilot *p;
+
+   h = 14695981039346656037ULL;
+   pilot_stack = pilot_getAll();
+   for (i=0; i<array_size(pilot_stack); i++) {
+      p = pilot_stack[i];
+      state[0] = p->solid->pos.x;
+      state[1] = p->solid->pos.y;
+      state[2] = p->solid->vel.x;
+      state[3] = p->solid->vel.y;
+      state[4] = p->solid->dir;
+      state[5] = p->armour;
+      state[6] = p->shield;
+      state[7] = p->energy;
+      h = bench_hash( h, &p->id, sizeof(p->id) );
+      h = bench_hash( h, state, sizeof(state) );
+   }
+   return h;
+}
+
+
+/**
+ * @brief Compares tick times for sorting.
+ */
+static int bench_compare( const void *a, const void *b )
+{
+   double da = *(const double*)a;
+   double db = *(const double*)b;
+   return (da > db) - (da < db);
+}
+
+
+/**
+ * @brief Gets a percentile of sorted tick times.
+ *
+ *    @param sorted Tick times sorted in increasing order (array.h).
+ *    @param p Percentile to get (0 to 100).
+ *    @return The time at the percentile, by nearest rank.
+ */
+static double bench_percentile( const double *sorted, double p )
+{
+   int n = array_size( sorted );
+   if (n <= 0)
+      return 0.;
+   return sorted[ CLAMP( 0, n-1, (int)ceil( p/100. * n ) - 1 ) ];
+}
+
+
+/**
+ * @brief Checks the tick times against the baseline of the scenario.
+ *
+ *    @return 0 if within the baseline or there is none, -1 otherwise.
+ */
+static int bench_baseline( nlua_env env, const char *script, const double *sorted )
+{
+   int i, ret;
+   double tol, base, ms;
+   const char *keys[] = { "p50", "p95", "p99" };
+   const double pcts[] = { 50., 95., 99. };
+
+   tol = bench_number( env, "bench_tolerance", BENCH_TOLERANCE );
+   ret = 0;
+   nlua_getenv( env, "bench_baseline" );
+   if (lua_istable( naevL, -1 )) {
+      for (i=0; i<3; i++) {
+         lua_getfield( naevL, -1, keys[i] );
+         if (lua_isnumber( naevL, -1 )) {
+            base = lua_tonumber( naevL, -1 );
+            ms   = bench_percentile( sorted, pcts[i] );
+            if (ms > base * tol) {
+               WARN(_("Benchmark '%s' %s of %.3f ms is over the baseline of %.3f ms!"),
+                     script, keys[i], ms, base );
+               ret = -1;
+            }
+         }
+         lua_pop( naevL, 1 );
+      }
+   }
+   lua_pop( naevL, 1 );
+   return ret;
+}
+
+
+/**
+ * @brief Runs a benchmark scenario.
+ *
+ *    @param script Scenario to run, either a file or a path in the data.
+ *    @return 0 on success.
+ */
+int bench_run( const char *script )
+{
+   nlua_env env;
+   char *buf;
+   const char *sysname;
+   size_t bufsize;
+   int i, ticks, rendering, ret;
+   double dt, elapsed, t, freq;
+   double *times;
+   Uint64 start, tick;
+#ifdef PROFILING
+   int z;
+   const char *zname;
+   double zms, zones[PROFILE_ZONES];
+#endif /* PROFILING */
+
+   /* Scripts outside of the data are more practical for CI. */
+   buf = nfile_readFile( &bufsize, script );
+   if (buf == NULL)
+      buf = ndata_read( script, &bufsize );
+   if (buf == NULL) {
+      WARN(_("Benchmark scenario '%s' not found!"), script);
+      return -1;
+   }
+
+   /* Load the scenario, seeded so anything random it does is repeatable. */
+   rng_seed( 0 );
+   env = nlua_newEnv(1);
+   nlua_loadStandard( env );
+   if (nlua_dobufenv( env, buf, bufsize, script ) != 0) {
+      WARN(_("Error loading benchmark scenario '%s': %s"), script, lua_tostring(naevL,-1));
+      lua_pop(naevL,1);
+      free(buf);
+      nlua_freeEnv(env);
+      return -1;
+   }
+   free(buf);
+
+   nlua_getenv( env, "bench_system" );
+   sysname = lua_tostring( naevL, -1 );
+   if ((sysname == NULL) || (system_get( sysname ) == NULL)) {
+      WARN(_("Benchmark scenario '%s' has no valid 'bench_system'!"), script);
+      lua_pop(naevL,1);
+      nlua_freeEnv(env);
+      return -1;
+   }
+   ticks = (int) bench_number( env, "bench_ticks", BENCH_TICKS );
+   dt    = bench_number( env, "bench_dt", BENCH_DT );
+   rng_seed( (uint32_t) bench_number( env, "bench_seed", 0. ) );
+   nlua_getenv( env, "bench_render" );
+   rendering = lua_toboolean( naevL, -1 );
+   lua_pop(naevL,1);
+
+   /* Set up the scenario. */
+   space_init( sysname );
+   lua_pop(naevL,1); /* sysname is only valid while on the stack. */
+   nlua_getenv( env, "setup" );
+   if (lua_isfunction( naevL, -1 )) {
+      if (nlua_pcall( env, 0, 0 )) {
+         WARN(_("Benchmark scenario '%s' setup failed: %s"), script, lua_tostring(naevL,-1));
+         lua_pop(naevL,1);
+         nlua_freeEnv(env);
+         return -1;
+      }
+   }
+   else
+      lua_pop(naevL,1);
+
+   LOG(_("Benchmarking '%s': %d ticks of %.4f s with %d pilots."),
+         script, ticks, dt, array_size( pilot_getAll() ));
+
+   /* Run the simulation. */
+   ret     = 0;
+   times   = array_create_size( double, MAX( 1, ticks ) );
+   freq    = (double)SDL_GetPerformanceFrequency() / 1000.;
+#ifdef PROFILING
+   memset( zones, 0, sizeof(zones) );
+#endif /* PROFILING */
+   start   = SDL_GetPerformanceCounter();
+   for (i=0; i<ticks; i++) {
+#ifdef PROFILING
+      profile_frame();
+#endif /* PROFILING */
+      tick = SDL_GetPerformanceCounter();
+
+      /* Scripted events. */
+      nlua_getenv( env, "tick" );
+      if (lua_isfunction( naevL, -1 )) {
+         lua_pushinteger( naevL, i );
+         if (nlua_pcall( env, 1, 0 )) {
+            WARN(_("Benchmark scenario '%s' tick %d failed: %s"), script, i, lua_tostring(naevL,-1));
+            lua_pop(naevL,1);
+            ret = -1;
+            break;
+         }
+      }
+      else
+         lua_pop(naevL,1);
+
+      update_routine( dt, 0 );
+      if (rendering) {
+         render_all( dt, dt );
+         glFinish(); /* Count the GPU work in the tick. */
+      }
+      t = (double)(SDL_GetPerformanceCounter() - tick) / freq;
+      array_push_back( &times, t );
+
+#ifdef PROFILING
+      for (z=0; profile_getFrame( z, &zname, &zms )==0; z++)
+         zones[z] += zms;
+#endif /* PROFILING */
+   }
+   elapsed = (double)(SDL_GetPerformanceCounter() - start) / freq;
+   qsort( times, array_size(times), sizeof(double), bench_compare );
+
+   LOG(_("Benchmark done: %.1f ms total, %.3f ms per tick, %.3f ms worst tick."),
+         elapsed, elapsed / MAX( 1, ticks ), bench_percentile( times, 100. ) );
+   LOG(_("Benchmark state: %d pilots, checksum %016"PRIx64"."),
+         array_size( pilot_getAll() ), bench_checksum() );
+
+   /* Not LOG, the output has to stay machine readable. */
+   printf( "{\"scenario\":\"%s\",\"ticks\":%d,\"p50\":%.3f,\"p95\":%.3f,"
+         "\"p99\":%.3f,\"worst\":%.3f", script, array_size(times),
+         bench_percentile( times, 50. ), bench_percentile( times, 95. ),
+         bench_percentile( times, 99. ), bench_percentile( times, 100. ) );
+#ifdef PROFILING
+   printf( ",\"zones\":{" );
+   for (z=0; profile_getFrame( z, &zname, &zms )==0; z++)
+      printf( "%s\"%s\":%.3f", (z>0) ? "," : "", zname,
+            zones[z] / MAX( 1, array_size(times) ) );
+   printf( "}" );
+#endif /* PROFILING */
+   printf( "}\n" );
+   fflush( stdout );
+
+#ifdef PROFILING
+   profile_frame();
+   profile_report();
+#else /* PROFILING */
+   LOG(_("Build with the profiler option for per subsystem timings."));
+#endif /* PROFILING */
+
+   if ((ret == 0) && (i == ticks))
+      ret = bench_baseline( env, script, times );
+
+   array_free( times );
+   nlua_freeEnv(env);
+   return ret;
+}
+
+
+/**
+ * @brief Makes a regular polygon around the origin.
+ */
+static void bench_polygon( CollPoly *poly, float *x, float *y, float r )
+{
+   int i;
+   for (i=0; i<BENCH_POLY_POINTS; i++) {
+      x[i] = r * cos( 2.*M_PI * i / BENCH_POLY_POINTS );
+      y[i] = r * sin( 2.*M_PI * i / BENCH_POLY_POINTS );
+   }
+   poly->x     = x;
+   poly->y     = y;
+   poly->npt   = BENCH_POLY_POINTS;
+   poly->xmin  = -r;
+   poly->xmax  = r;
+   poly->ymin  = -r;
+   poly->ymax  = r;
+   poly->rad   = r;
+}
+
+
+/**
+ * @brief Sprite against sprite, half the positions overlapping.
+ */
+static uint64_t bench_collideSprite( int n )
+{
+   int i, x, y, hits;
+   SDL_Surface *s;
+   Uint32 *px;
+   glTexture *tex;
+   Vector2d a, b, crash;
+   double r, c;
+
+   /* Opaque disc on a transparent background. */
+   s  = SDL_CreateRGBSurface( 0, BENCH_SPRITE_SIZE, BENCH_SPRITE_SIZE, 32,
+         RMASK, GMASK, BMASK, AMASK );
+   px = s->pixels;
+   c  = BENCH_SPRITE_SIZE / 2.;
+   r  = BENCH_SPRITE_SIZE * 0.4;
+   for (y=0; y<BENCH_SPRITE_SIZE; y++)
+      for (x=0; x<BENCH_SPRITE_SIZE; x++)
+         px[ y*s->pitch/4 + x ] = (pow2(x+0.5-c) + pow2(y+0.5-c) < pow2(r)) ?
+               (RMASK | AMASK) : 0;
+   tex = gl_loadImage( s, OPENGL_TEX_MAPTRANS );
+
+   hits = 0;
+   vect_cset( &a, 0., 0. );
+   for (i=0; i<n; i++) {
+      vect_cset( &b, (i % 128) - 64., ((i / 128) % 128) - 64. );
+      hits += CollideSprite( tex, 0, 0, &a, tex, 0, 0, &b, &crash );
+   }
+   gl_freeTexture( tex );
+   return hits;
+}
+
+
+/**
+ * @brief Polygon against polygon, half the positions overlapping.
+ */
+static uint64_t bench_collidePolygon( int n )
+{
+   int i, hits;
+   float ax[BENCH_POLY_POINTS], ay[BENCH_POLY_POINTS];
+   float bx[BENCH_POLY_POINTS], by[BENCH_POLY_POINTS];
+   CollPoly pa, pb;
+   Vector2d a, b, crash;
+
+   bench_polygon( &pa, ax, ay, 40. );
+   bench_polygon( &pb, bx, by, 25. );
+   hits = 0;
+   vect_cset( &a, 0., 0. );
+   for (i=0; i<n; i++) {
+      vect_cset( &b, (i % 128) - 64., ((i / 128) % 128) - 64. );
+      hits += CollidePolygon( &pa, &a, &pb, &b, &crash );
+   }
+   return hits;
+}
+
+
+/**
+ * @brief Beam against polygon, sweeping around it.
+ */
+static uint64_t bench_collideLinePolygon( int n )
+{
+   int i, hits;
+   float x[BENCH_POLY_POINTS], y[BENCH_POLY_POINTS];
+   CollPoly p;
+   Vector2d a, b, crash[2];
+
+   bench_polygon( &p, x, y, 40. );
+   hits = 0;
+   vect_cset( &a, -200., 0. );
+   vect_cset( &b, 0., 0. );
+   for (i=0; i<n; i++)
+      hits += CollideLinePolygon( &a, (i % 360) * M_PI / 180., 400., &p, &b, crash );
+   return hits;
+}
+
+
+/**
+ * @brief Integrates a field of thrusting and turning solids.
+ */
+static uint64_t bench_physics( int n )
+{
+   int i, j;
+   Solid s[256];
+   Vector2d pos, vel;
+   uint64_t h;
+
+   for (j=0; j<256; j++) {
+      vect_cset( &pos, j*10., -j*5. );
+      vect_pset( &vel, 100., j*0.1 );
+      solid_init( &s[j], 1000., j*0.1, &pos, &vel,
+            (j%2) ? SOLID_UPDATE_EULER : SOLID_UPDATE_RK4 );
+      s[j].speed_max = 300.;
+      s[j].thrust    = 5000.;
+      s[j].dir_vel   = 0.5;
+   }
+   for (i=0; i<n; i++)
+      for (j=0; j<256; j++)
+         s[j].update( &s[j], BENCH_DT );
+
+   h = 14695981039346656037ULL;
+   for (j=0; j<256; j++)
+      h = bench_hash( h, &s[j].pos, sizeof(Vector2d) );
+   return h;
+}
+
+
+/**
+ * @brief Gets the prices of all the planets at different times.
+ */
+static uint64_t bench_economy( int n )
+{
+   int i, j;
+   Planet *planets;
+   credits_t *prices;
+   uint64_t h;
+
+   planets = planet_getAll();
+   prices  = array_create( credits_t );
+   h = 14695981039346656037ULL;
+   for (i=0; i<n; i++) {
+      for (j=0; j<array_size(planets); j++) {
+         array_resize( &prices, array_size(planets[j].commodities) );
+         economy_getPricesAtTime( &planets[j], ntime_create( 600, i, 0 ), prices );
+         h = bench_hash( h, prices, array_size(prices) * sizeof(credits_t) );
+      }
+   }
+   array_free( prices );
+   return h;
+}
+
+
+/**
+ * @brief Finds paths between systems spread over the universe.
+ */
+static uint64_t bench_jumpPath( int n )
+{
+   int i, ns;
+   StarSystem *systems, **path;
+   uint64_t h;
+
+   systems = system_getAll();
+   ns      = array_size( systems );
+   h = 0;
+   for (i=0; i<n; i++) {
+      path = map_getJumpPath( systems[ (i*7) % ns ].name,
+            systems[ (i*13 + ns/2) % ns ].name, 1, 1, NULL );
+      h += array_size( path );
+      array_free( path );
+   }
+   return h;
+}
+
+
+/**
+ * @brief Grows, walks and erases arrays.
+ */
+static uint64_t bench_array( int n )
+{
+   int i, j;
+   int *a;
+   uint64_t h;
+
+   h = 0;
+   for (i=0; i<n; i++) {
+      a = array_create( int );
+      for (j=0; j<10000; j++)
+         array_push_back( &a, j ^ i );
+      for (j=0; j<array_size(a); j++)
+         h += a[j];
+      array_erase( &a, &a[100], &a[200] );
+      for (j=0; j<100; j++)
+         array_erase( &a, &a[array_size(a)-1], array_end(a) );
+      h += array_size(a);
+      array_free( a );
+   }
+   return h;
+}
+
+
+/**
+ * @brief Lays out a paragraph with the default font at different widths.
+ */
+static uint64_t bench_fontWidth( int n )
+{
+   int i, outw;
+   uint64_t h;
+   const char *text = "Lorem ipsum dolor sit amet, consectetur adipiscing elit, "
+      "sed do eiusmod tempor incididunt ut labore et dolore magna aliqua. "
+      "#rUt enim#0 ad minim veniam, quis nostrud exercitation ullamco laboris "
+      "nisi ut aliquip ex ea commodo consequat.\nDuis aute irure dolor in "
+      "reprehenderit in voluptate velit esse cillum dolore eu fugiat nulla "
+      "pariatur.";
+
+   h = 0;
+   for (i=0; i<n; i++) {
+      h += gl_printWidthForText( &gl_defFont, text, 150 + (i % 300), &outw );
+      h += outw;
+   }
+   return h;
+}
+
+
+/**
+ * @brief Checks a condition, compiling it every time like one-off checks.
+ */
+static uint64_t bench_cond( int n )
+{
+   int i;
+   uint64_t h = 0;
+   for (i=0; i<n; i++)
+      h += cond_check( "return math.floor(7.5) == 7 and (\"abc\"):len() > 2" );
+   return h;
+}
+
+
+/**
+ * @brief Checks a precompiled condition like mission and event conditions.
+ */
+static uint64_t bench_condChunk( int n )
+{
+   int i, chunk;
+   uint64_t h = 0;
+
+   chunk = cond_compile( "return math.floor(7.5) == 7 and (\"abc\"):len() > 2" );
+   for (i=0; i<n; i++)
+      h += cond_checkChunk( chunk );
+   cond_free( chunk );
+   return h;
+}
+
+
+/**
+ * @brief Runs engine microbenchmarks.
+ *
+ *    @param name Name of the kernel to run or "all".
+ *    @return 0 on success.
+ */
+int bench_kernel( const char *name )
+{
+   int i, found;
+   const BenchKernel *k;
+   Uint64 start;
+   double ms;
+   uint64_t check;
+
+   found = 0;
+   for (i=0; i<(int)(sizeof(bench_kernels)/sizeof(bench_kernels[0])); i++) {
+      k = &bench_kernels[i];
+      if ((strcmp( name, "all" ) != 0) && (strcmp( name, k->name ) != 0))
+         continue;
+      found = 1;
+
+      rng_seed( 0 );
+      start = SDL_GetPerformanceCounter();
+      check = k->run( k->n );
+      ms    = (double)(SDL_GetPerformanceCounter() - start) * 1000. /
+            (double)SDL_GetPerformanceFrequency();
+
+      /* Not LOG, the output has to stay machine readable. */
+      printf( "{\"kernel\":\"%s\",\"iterations\":%d,\"ms\":%.3f,"
+            "\"ns_per_op\":%.1f,\"checksum\":\"%016"PRIx64"\"}\n",
+            k->name, k->n, ms, ms * 1e6 / k->n, check );
+      fflush( stdout );
+   }
+
+   if (!found) {
+      WARN(_("Benchmark kernel '%s' not found!"), name);
+      return -1;
+   }
+   return 0;
+}
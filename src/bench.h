@@ -0,0 +1,15 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+
+
+
+#ifndef BENCH_H
+#  define BENCH_H
+
+
+int bench_run( const char *script );
+int bench_kernel( const char *name );
+
+
+#endif /* BENCH_H */
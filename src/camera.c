@@ -34,6 +34,8 @@ static int zoom_override   = 0; /**< Whether or not to override the zoom. */
 static double camera_Z     = 1.; /**< Current in-game zoom. */
 static double camera_X     = 0.; /**< X position of camera. */
 static double camera_Y     = 0.; /**< Y position of camera. */
+static double ahead_X      = 0.; /**< X offset of the camera while drawing ahead of the simulation. */
+static double ahead_Y      = 0.; /**< Y offset of the camera while drawing ahead of the simulation. */
 /* Old is used to compensate pilot movement. */
 static double old_X        = 0.; /**< Old X positiion. */
 static double old_Y        = 0.; /**< Old Y position. */
@@ -121,8 +123,60 @@ double cam_getZoomTarget (void)
  */
 void cam_getPos( double *x, double *y )
 {
-   *x = camera_X;
-   *y = camera_Y;
+   *x = camera_X + ahead_X;
+   *y = camera_Y + ahead_Y;
+}
+
+
+/**
+ * @brief Gets the part of the system that is visible on screen.
+ *
+ * Inverse of gl_gameToScreenCoords() for the corners of the screen, used
+ *  to skip drawing objects that can't be seen.
+ *
+ *    @param[out] x1 Left bound in game coordinates.
+ *    @param[out] y1 Bottom bound in game coordinates.
+ *    @param[out] x2 Right bound in game coordinates.
+ *    @param[out] y2 Top bound in game coordinates.
+ */
+void cam_getBounds( double *x1, double *y1, double *x2, double *y2 )
+{
+   double cx, cy, gx, gy, z;
+
+   cam_getPos( &cx, &cy );
+   z = cam_getZoom();
+   gui_getOffset( &gx, &gy );
+
+   *x1 = cx - (gx + SCREEN_W/2.) / z;
+   *x2 = cx + (SCREEN_W/2. - gx) / z;
+   *y1 = cy - (gy + SCREEN_H/2.) / z;
+   *y2 = cy + (SCREEN_H/2. - gy) / z;
+}
+
+
+/**
+ * @brief Moves the camera with the pilot it follows while drawing ahead of
+ *        the simulation.
+ *
+ * The followed pilot is drawn where it will be after t, so the camera has to
+ *  move the same way or the pilot jitters on screen.
+ *
+ *    @param t Game time the frame is drawn ahead by, 0 to stop.
+ */
+void cam_setAhead( double t )
+{
+   Pilot *p;
+
+   ahead_X = 0.;
+   ahead_Y = 0.;
+   if ((t == 0.) || camera_fly || (camera_followpilot == 0))
+      return;
+
+   p = pilot_get( camera_followpilot );
+   if (p == NULL)
+      return;
+   ahead_X = p->solid->vel.x * t;
+   ahead_Y = p->solid->vel.y * t;
 }
 
 
@@ -16,6 +16,7 @@
 double cam_getZoom (void);
 double cam_getZoomTarget (void);
 void cam_getPos( double *x, double *y );
+void cam_getBounds( double *x1, double *y1, double *x2, double *y2 );
 int cam_getTarget( void );
 
 
@@ -33,6 +34,7 @@ void cam_setTargetPos( double x, double y, int soft_over );
  * Update.
  */
 void cam_update( double dt );
+void cam_setAhead( double t );
 
 
 #endif /* CAMERA_H */
@@ -30,7 +30,15 @@ struct Claim_s {
    char **strs; /**< Strings. */
 };
 
-static char **claimed_strs = NULL; /**< Global claimed strings. */
+static char **claimed_strs = NULL; /**< Global claimed strings, sorted (array.h). */
+static int *claimed_sys = NULL; /**< Number of active claims on each system (array.h). */
+
+
+/*
+ * Prototypes.
+ */
+static void claim_sysChange( int ss_id, int n );
+static int claim_strFind( const char *str, int *pos );
 
 
 /**
@@ -121,7 +129,7 @@ int claim_isNull( Claim_t *claim )
  */
 int claim_test( Claim_t *claim )
 {
-   int claimed, i, j;
+   int claimed, i, pos;
 
    /* Must actually have a claim. */
    if (claim == NULL)
@@ -135,12 +143,9 @@ int claim_test( Claim_t *claim )
    }
 
    /* Check strings. */
-   for (i=0; i<array_size(claim->strs); i++) {
-      for (j=0; j<array_size(claimed_strs); j++) {
-         if (strcmp( claim->strs[i], claimed_strs[j] )==0)
-            return 1;
-      }
-   }
+   for (i=0; i<array_size(claim->strs); i++)
+      if (claim_strFind( claim->strs[i], &pos ))
+         return 1;
 
    return 0;
 }
@@ -202,16 +207,20 @@ int claim_testSys( Claim_t *claim, int sys )
  */
 void claim_destroy( Claim_t *claim )
 {
-   int i;
+   int i, pos;
 
    if (claim->active)
       for (i=0; i<array_size(claim->ids); i++)
-         sys_rmFlag( system_getIndex(claim->ids[i]), SYSTEM_CLAIMED );
+         claim_sysChange( claim->ids[i], -1 );
    array_free( claim->ids );
 
-   if (claim->active)
-      for (i=0; i<array_size(claim->strs); i++)
-         free( claim->strs[i] );
+   for (i=0; i<array_size(claim->strs); i++) {
+      if (claim->active && claim_strFind( claim->strs[i], &pos )) {
+         free( claimed_strs[pos] );
+         array_erase( &claimed_strs, &claimed_strs[pos], &claimed_strs[pos+1] );
+      }
+      free( claim->strs[i] );
+   }
    array_free( claim->strs );
    free(claim);
 }
@@ -229,6 +238,8 @@ void claim_clear (void)
    sys = system_getAll();
    for (i=0; i<array_size(sys); i++)
       sys_rmFlag( &sys[i], SYSTEM_CLAIMED );
+   array_free(claimed_sys);
+   claimed_sys = NULL;
 
    for (i=0; i<array_size(claimed_strs); i++)
       free(claimed_strs[i]);
@@ -255,24 +266,89 @@ void claim_activateAll (void)
  */
 void claim_activate( Claim_t *claim )
 {
-   int i;
-   char **s;
+   int i, pos;
 
    /* Add flags. */
    for (i=0; i<array_size(claim->ids); i++)
-      sys_setFlag( system_getIndex(claim->ids[i]), SYSTEM_CLAIMED );
+      claim_sysChange( claim->ids[i], +1 );
 
-   /* Add strings. */
+   /* Add strings, keeping them sorted. */
    if ((claimed_strs == NULL) && (array_size(claim->strs) > 0))
       claimed_strs = array_create( char* );
    for (i=0; i<array_size(claim->strs); i++) {
-      s = &array_grow( &claimed_strs );
-      *s = strdup( claim->strs[i] );
+      claim_strFind( claim->strs[i], &pos );
+      array_grow( &claimed_strs );
+      memmove( &claimed_strs[pos+1], &claimed_strs[pos],
+            (array_size(claimed_strs)-pos-1) * sizeof(char*) );
+      claimed_strs[pos] = strdup( claim->strs[i] );
    }
    claim->active = 1;
 }
 
 
+/**
+ * @brief Changes the number of active claims on a system.
+ *
+ * The system stays flagged as claimed until the last claim on it is gone.
+ *
+ *    @param ss_id Id of the system.
+ *    @param n Number of claims to add, or remove if negative.
+ */
+static void claim_sysChange( int ss_id, int n )
+{
+   int size;
+   StarSystem *sys;
+
+   sys = system_getIndex( ss_id );
+   if (sys == NULL)
+      return;
+
+   size = array_size(claimed_sys);
+   if (size <= ss_id) {
+      if (claimed_sys == NULL)
+         claimed_sys = array_create( int );
+      array_resize( &claimed_sys, MAX( ss_id+1, array_size(system_getAll()) ) );
+      memset( &claimed_sys[size], 0, (array_size(claimed_sys)-size) * sizeof(int) );
+   }
+
+   claimed_sys[ss_id] = MAX( 0, claimed_sys[ss_id] + n );
+   if (claimed_sys[ss_id] > 0)
+      sys_setFlag( sys, SYSTEM_CLAIMED );
+   else
+      sys_rmFlag( sys, SYSTEM_CLAIMED );
+}
+
+
+/**
+ * @brief Looks for a string in the claimed strings.
+ *
+ *    @param str String to look for.
+ *    @param[out] pos Position of the string or where it would be inserted.
+ *    @return 1 if the string is claimed, 0 otherwise.
+ */
+static int claim_strFind( const char *str, int *pos )
+{
+   int lo, hi, mid, cmp;
+
+   lo = 0;
+   hi = array_size(claimed_strs);
+   while (lo < hi) {
+      mid = (lo + hi) / 2;
+      cmp = strcmp( claimed_strs[mid], str );
+      if (cmp == 0) {
+         *pos = mid;
+         return 1;
+      }
+      if (cmp < 0)
+         lo = mid+1;
+      else
+         hi = mid;
+   }
+   *pos = lo;
+   return 0;
+}
+
+
 /**
  * @brief Saves all the systems in a claim in XML.
  *
@@ -10,21 +10,340 @@
 
 
 /** @cond */
+#include <stdint.h>
+#include <stdlib.h>
+
 #include "naev.h"
 /** @endcond */
 
 #include "collision.h"
 
+#include "array.h"
 #include "log.h"
+#include "md5.h"
+#include "ndata.h"
+#include "nfile.h"
+#include "nstring.h"
+
+
+#define POLYGON_CACHE_MAGIC   0x474c504eu /**< Identifies polygon cache files ("NPLG"). */
+#define POLYGON_CACHE_VERSION 1 /**< Bump whenever the cache format changes. */
+
+
+/**
+ * @brief Header of a polygon cache file.
+ *
+ * Followed by every polygon as its number of points, bounds, and then the X
+ *  and Y coordinates. Stored in native byte order as the cache is local.
+ */
+typedef struct PolygonCacheHeader_ {
+   uint32_t magic; /**< POLYGON_CACHE_MAGIC. */
+   uint32_t version; /**< POLYGON_CACHE_VERSION. */
+   uint32_t npoly; /**< Number of polygons. */
+} PolygonCacheHeader;
 
 
 /*
  * Prototypes
  */
+static void polygonRadius( CollPoly *polygon );
+static CollPoly* polygonCacheRead( const char *data, size_t len );
+static void polygonCacheWrite( const CollPoly *polygons, const char *path );
 static int pointInPolygon( const CollPoly* at, const Vector2d* ap,
       float x, float y );
 static int LineOnPolygon( const CollPoly* at, const Vector2d* ap,
       float x1, float y1, float x2, float y2, Vector2d* crash );
+static uint64_t maskBits( const uint64_t *row, int words, int x );
+
+
+/**
+ * @brief Sets the bounding radius of a polygon from its points.
+ */
+static void polygonRadius( CollPoly *polygon )
+{
+   int i;
+   float r2;
+
+   r2 = 0.;
+   for (i=0; i<polygon->npt; i++)
+      r2 = MAX( r2, polygon->x[i]*polygon->x[i] + polygon->y[i]*polygon->y[i] );
+   polygon->rad = sqrt( r2 );
+}
+
+
+/**
+ * @brief Loads polygons from a cache file.
+ *
+ *    @param data Contents of the cache file.
+ *    @param len Length of the contents.
+ *    @return The polygons (array.h) or NULL if the cache is invalid.
+ */
+static CollPoly* polygonCacheRead( const char *data, size_t len )
+{
+   PolygonCacheHeader hdr;
+   CollPoly *polygons, *p;
+   uint32_t i, npt;
+   size_t pos, n;
+
+   if (len < sizeof(hdr))
+      return NULL;
+   memcpy( &hdr, data, sizeof(hdr) );
+   if ((hdr.magic != POLYGON_CACHE_MAGIC) || (hdr.version != POLYGON_CACHE_VERSION))
+      return NULL;
+   pos = sizeof(hdr);
+
+   polygons = array_create_size( CollPoly, MAX( hdr.npoly, 1 ) );
+   for (i=0; i<hdr.npoly; i++) {
+      if (pos + sizeof(uint32_t) + 4*sizeof(float) > len)
+         break;
+      memcpy( &npt, &data[pos], sizeof(uint32_t) );
+      pos += sizeof(uint32_t);
+      n = npt * sizeof(float);
+      if (pos + 4*sizeof(float) + 2*n > len)
+         break;
+
+      p = &array_grow( &polygons );
+      p->npt = npt;
+      memcpy( &p->xmin, &data[pos], sizeof(float) ); pos += sizeof(float);
+      memcpy( &p->xmax, &data[pos], sizeof(float) ); pos += sizeof(float);
+      memcpy( &p->ymin, &data[pos], sizeof(float) ); pos += sizeof(float);
+      memcpy( &p->ymax, &data[pos], sizeof(float) ); pos += sizeof(float);
+      p->x = malloc( MAX( n, sizeof(float) ) );
+      p->y = malloc( MAX( n, sizeof(float) ) );
+      memcpy( p->x, &data[pos], n ); pos += n;
+      memcpy( p->y, &data[pos], n ); pos += n;
+      polygonRadius( p );
+   }
+
+   /* Truncated file. */
+   if (i < hdr.npoly) {
+      for (i=0; i<(uint32_t)array_size(polygons); i++) {
+         free( polygons[i].x );
+         free( polygons[i].y );
+      }
+      array_free( polygons );
+      return NULL;
+   }
+
+   return polygons;
+}
+
+
+/**
+ * @brief Saves polygons to a cache file.
+ *
+ *    @param polygons Polygons (array.h) to save.
+ *    @param path Cache file to write.
+ */
+static void polygonCacheWrite( const CollPoly *polygons, const char *path )
+{
+   PolygonCacheHeader hdr;
+   const CollPoly *p;
+   char *data;
+   size_t len, pos, n;
+   uint32_t npt;
+   int i;
+
+   /* Get the size. */
+   len = sizeof(hdr);
+   for (i=0; i<array_size(polygons); i++)
+      len += sizeof(uint32_t) + (4 + 2*polygons[i].npt) * sizeof(float);
+   data = malloc( len );
+
+   hdr.magic   = POLYGON_CACHE_MAGIC;
+   hdr.version = POLYGON_CACHE_VERSION;
+   hdr.npoly   = array_size(polygons);
+   memcpy( data, &hdr, sizeof(hdr) );
+   pos = sizeof(hdr);
+   for (i=0; i<array_size(polygons); i++) {
+      p   = &polygons[i];
+      npt = p->npt;
+      n   = npt * sizeof(float);
+      memcpy( &data[pos], &npt, sizeof(uint32_t) ); pos += sizeof(uint32_t);
+      memcpy( &data[pos], &p->xmin, sizeof(float) ); pos += sizeof(float);
+      memcpy( &data[pos], &p->xmax, sizeof(float) ); pos += sizeof(float);
+      memcpy( &data[pos], &p->ymin, sizeof(float) ); pos += sizeof(float);
+      memcpy( &data[pos], &p->ymax, sizeof(float) ); pos += sizeof(float);
+      memcpy( &data[pos], p->x, n ); pos += n;
+      memcpy( &data[pos], p->y, n ); pos += n;
+   }
+
+   nfile_writeFile( data, len, path );
+   free( data );
+}
+
+
+/**
+ * @brief Loads the polygons of a polygon xml file.
+ *
+ * Parsed polygons are cached by the md5 of the file contents so that later
+ *  loads don't have to parse the xml.
+ *
+ *    @param file Path of the polygon file in ndata.
+ *    @param size_hint Expected number of polygons.
+ *    @return The polygons (array.h) or NULL on error.
+ */
+CollPoly* LoadPolygonFile( const char *file, int size_hint )
+{
+   char *buf, *data, *cachefile;
+   char digest[33], dirpath[PATH_MAX];
+   size_t i, bufsize, datasize;
+   md5_state_t md5;
+   md5_byte_t md5val[16];
+   xmlDocPtr doc;
+   xmlNodePtr node, cur;
+   CollPoly *polygons;
+
+   buf = ndata_read( file, &bufsize );
+   if (buf == NULL)
+      return NULL;
+
+   /* Look for a cached version. */
+   md5_init( &md5 );
+   md5_append( &md5, (md5_byte_t*)buf, bufsize );
+   md5_finish( &md5, md5val );
+   for (i=0; i<16; i++)
+      snprintf( &digest[i * 2], 3, "%02x", md5val[i] );
+   asprintf( &cachefile, "%spolygons/%s", nfile_cachePath(), digest );
+   if (nfile_fileExists( cachefile )) {
+      data = nfile_readFile( &datasize, cachefile );
+      if (data != NULL) {
+         polygons = polygonCacheRead( data, datasize );
+         free( data );
+         if (polygons != NULL) {
+            free( buf );
+            free( cachefile );
+            return polygons;
+         }
+      }
+   }
+
+   /* Parse the xml. */
+   doc = xmlParseMemory( buf, bufsize );
+   free( buf );
+   if (doc == NULL) {
+      WARN(_("Unable to parse document '%s'"), file);
+      free( cachefile );
+      return NULL;
+   }
+
+   node = doc->xmlChildrenNode; /* First polygon node */
+   if (node == NULL) {
+      xmlFreeDoc(doc);
+      WARN(_("Malformed %s file: does not contain elements"), file);
+      free( cachefile );
+      return NULL;
+   }
+
+   polygons = NULL;
+   do { /* load the polygon data */
+      if (xml_isNode(node,"polygons")) {
+         cur = node->children;
+         polygons = array_create_size( CollPoly, size_hint );
+         do {
+            if (xml_isNode(cur,"polygon"))
+               LoadPolygon( &array_grow( &polygons ), cur );
+         } while (xml_nextNode(cur));
+      }
+   } while (xml_nextNode(node));
+   xmlFreeDoc(doc);
+
+   /* Cache for next time. */
+   if (polygons != NULL) {
+      snprintf( dirpath, sizeof(dirpath), "%s/%s", nfile_cachePath(), "polygons/" );
+      nfile_dirMakeExist( dirpath );
+      polygonCacheWrite( polygons, cachefile );
+   }
+   free( cachefile );
+
+   return polygons;
+}
+
+
+/**
+ * @brief Keeps only some of the polygons of a sprite sheet.
+ *
+ * The polygons kept are evenly spaced, the ones in between can be
+ *  approximated by rotating the closest with RotatePolygon().
+ *
+ *    @param[in,out] polygons Polygons (array.h), one per sprite.
+ *    @param keyframes Number of polygons to keep at least.
+ *    @return Number of sprites between the polygons kept, 1 if all are kept.
+ */
+int CompactPolygons( CollPoly **polygons, int keyframes )
+{
+   int i, n, step;
+   CollPoly *p;
+
+   n = array_size(*polygons);
+   if ((keyframes <= 0) || (keyframes >= n))
+      return 1;
+   step = n / keyframes;
+   if (step <= 1)
+      return 1;
+
+   p = *polygons;
+   for (i=0; i<n; i++) {
+      if (i % step == 0)
+         p[i/step] = p[i];
+      else {
+         free( p[i].x );
+         free( p[i].y );
+      }
+   }
+   array_resize( polygons, (n+step-1) / step );
+   array_shrink( polygons );
+   return step;
+}
+
+
+/**
+ * @brief Rotates a polygon around the origin.
+ *
+ * Written as plain loops over the coordinate arrays so the compiler can
+ *  vectorize them.
+ *
+ *    @param[in,out] rpolygon Rotated polygon, its coordinates are reallocated.
+ *    @param[in] ipolygon Polygon to rotate.
+ *    @param theta Angle to rotate by in radians.
+ */
+void RotatePolygon( CollPoly* rpolygon, const CollPoly* ipolygon, float theta )
+{
+   int i, n;
+   float c, s, xmin, xmax, ymin, ymax;
+   float *rx, *ry;
+   const float *ix, *iy;
+
+   n  = ipolygon->npt;
+   rpolygon->x   = realloc( rpolygon->x, MAX(n,1) * sizeof(float) );
+   rpolygon->y   = realloc( rpolygon->y, MAX(n,1) * sizeof(float) );
+   rpolygon->npt = n;
+   rpolygon->rad = ipolygon->rad; /* Doesn't change around the origin. */
+
+   c  = cos( theta );
+   s  = sin( theta );
+   rx = rpolygon->x;
+   ry = rpolygon->y;
+   ix = ipolygon->x;
+   iy = ipolygon->y;
+   for (i=0; i<n; i++) {
+      rx[i] = ix[i]*c - iy[i]*s;
+      ry[i] = ix[i]*s + iy[i]*c;
+   }
+
+   /* Bounds include the origin as when loading. */
+   xmin = xmax = ymin = ymax = 0.;
+   for (i=0; i<n; i++) {
+      xmin = MIN( xmin, rx[i] );
+      xmax = MAX( xmax, rx[i] );
+      ymin = MIN( ymin, ry[i] );
+      ymax = MAX( ymax, ry[i] );
+   }
+   rpolygon->xmin = xmin;
+   rpolygon->xmax = xmax;
+   rpolygon->ymin = ymin;
+   rpolygon->ymax = ymax;
+}
 
 
 /**
@@ -81,16 +400,42 @@ void LoadPolygon( CollPoly* polygon, xmlNodePtr node )
       }
    } while (xml_nextNode(cur));
 
+   polygonRadius( polygon );
    return;
 }
 
 
+/**
+ * @brief Gets 64 bits of a collision mask row starting at a pixel.
+ *
+ *    @param row Row of the mask.
+ *    @param words Number of words in the row.
+ *    @param x First pixel, bit 0 of the result.
+ *    @return The bits, past the end of the row are 0.
+ */
+static uint64_t maskBits( const uint64_t *row, int words, int x )
+{
+   int w, s;
+   uint64_t v;
+
+   w = x / 64;
+   s = x % 64;
+   v = row[w] >> s;
+   if ((s > 0) && (w+1 < words))
+      v |= row[w+1] << (64-s);
+   return v;
+}
+
+
 /**
  * @brief Checks whether or not two sprites collide.
  *
  * This function does pixel perfect checks.  If the collision actually occurs,
  *  crash is set to store the real position of the collision.
  *
+ * The overlap is tested 64 pixels at a time on the packed collision masks,
+ *  after shrinking it to the bounding boxes of the opaque pixels.
+ *
  *    @param[in] at Texture a.
  *    @param[in] asx Position of x of sprite a.
  *    @param[in] asy Position of y of sprite a.
@@ -106,20 +451,26 @@ int CollideSprite( const glTexture* at, const int asx, const int asy, const Vect
       const glTexture* bt, const int bsx, const int bsy, const Vector2d* bp,
       Vector2d* crash )
 {
-   int x,y;
+   int x,y, n;
    int ax1,ax2, ay1,ay2;
    int bx1,bx2, by1,by2;
    int inter_x0, inter_x1, inter_y0, inter_y1;
    int rasy, rbsy;
-   int abx,aby, bbx, bby;
-
+   int ash, bsh;
+   const glTexMask *am, *bm;
+   const uint64_t *arow, *brow;
+   const int16_t *abox, *bbox;
+   uint64_t bits;
+
+   am = at->mask;
+   bm = bt->mask;
 #if DEBUGGING
    /* Make sure the surfaces have transparency maps. */
-   if (at->trans == NULL) {
+   if (am == NULL) {
       WARN(_("Texture '%s' has no transparency map"), at->name);
       return 0;
    }
-   if (bt->trans == NULL) {
+   if (bm == NULL) {
       WARN(_("Texture '%s' has no transparency map"), bt->name);
       return 0;
    }
@@ -151,23 +502,41 @@ int CollideSprite( const glTexture* at, const int asx, const int asy, const Vect
    rasy = at->sy - asy - 1;
    rbsy = bt->sy - bsy - 1;
 
-   /* set up the base points */
-   abx =  asx*(int)(at->sw) - ax1;
-   aby = rasy*(int)(at->sh) - ay1;
-   bbx =  bsx*(int)(bt->sw) - bx1;
-   bby = rbsy*(int)(bt->sh) - by1;
+   /* Shrink to the opaque pixels of both sprites. */
+   abox = &am->box[ (rasy*(int)at->sx + asx)*4 ];
+   bbox = &bm->box[ (rbsy*(int)bt->sx + bsx)*4 ];
+   if ((abox[2] < abox[0]) || (bbox[2] < bbox[0]))
+      return 0;
+   inter_x0 = MAX( inter_x0, MAX( ax1+abox[0], bx1+bbox[0] ) );
+   inter_x1 = MIN( inter_x1, MIN( ax1+abox[2], bx1+bbox[2] ) );
+   inter_y0 = MAX( inter_y0, MAX( ay1+abox[1], by1+bbox[1] ) );
+   inter_y1 = MIN( inter_y1, MIN( ay1+abox[3], by1+bbox[3] ) );
+   if ((inter_x1 < inter_x0) || (inter_y1 < inter_y0))
+      return 0;
 
-   for (y=inter_y0; y<=inter_y1; y++)
-      for (x=inter_x0; x<=inter_x1; x++)
-         /* compute offsets for surface before pass to TransparentPixel test */
-         if ((!gl_isTrans(at, abx + x, aby + y)) &&
-               (!gl_isTrans(bt, bbx + x, bby + y))) {
+   /* First row of the sprites. */
+   ash  = (int)(at->sh);
+   bsh  = (int)(bt->sh);
+   arow = &am->bits[ (rasy*(int)at->sx + asx)*ash*am->words ];
+   brow = &bm->bits[ (rbsy*(int)bt->sx + bsx)*bsh*bm->words ];
 
-            /* Set the crash position. */
-            crash->x = x;
-            crash->y = y;
-            return 1;
-         }
+   for (y=inter_y0; y<=inter_y1; y++) {
+      for (x=inter_x0; x<=inter_x1; x+=64) {
+         bits = maskBits( &arow[ (y-ay1)*am->words ], am->words, x-ax1 ) &
+               maskBits( &brow[ (y-by1)*bm->words ], bm->words, x-bx1 );
+         n = inter_x1 - x + 1;
+         if (n < 64)
+            bits &= ((uint64_t)1 << n) - 1;
+         if (bits == 0)
+            continue;
+
+         /* Set the crash position to the first opaque pixel. */
+         for (n=0; !(bits & ((uint64_t)1 << n)); n++);
+         crash->x = x + n;
+         crash->y = y;
+         return 1;
+      }
+   }
 
    return 0;
 }
@@ -269,6 +638,14 @@ int CollidePolygon( const CollPoly* at, const Vector2d* ap,
    int bx1,bx2, by1,by2;
    int inter_x0, inter_x1, inter_y0, inter_y1;
    float xabs, yabs, x1, y1, x2, y2;
+   double dx, dy, r;
+
+   /* Bounding circles are cheapest, most pairs are rejected here. */
+   dx = VX(*bp) - VX(*ap);
+   dy = VY(*bp) - VY(*ap);
+   r  = at->rad + bt->rad;
+   if (dx*dx + dy*dy > r*r)
+      return 0;
 
    /* a - cube coordinates */
    ax1 = (int)VX(*ap) + (int)(at->xmin);
@@ -297,13 +674,14 @@ int CollidePolygon( const CollPoly* at, const Vector2d* ap,
       xabs = bt->x[i] + VX(*bp);
       yabs = bt->y[i] + VY(*bp);
 
+      /* Points outside of the intersection can't be inside at. */
       if ((xabs<inter_x0) || (xabs>inter_x1) ||
-          (yabs<inter_y0) || (yabs>inter_y1)) {
-         if (pointInPolygon( at, ap, xabs, yabs )) {
-            crash->x = (int)xabs;
-            crash->y = (int)yabs;
-            return 1;
-         }
+          (yabs<inter_y0) || (yabs>inter_y1))
+         continue;
+      if (pointInPolygon( at, ap, xabs, yabs )) {
+         crash->x = (int)xabs;
+         crash->y = (int)yabs;
+         return 1;
       }
    }
 
@@ -339,36 +717,27 @@ int CollidePolygon( const CollPoly* at, const Vector2d* ap,
 int pointInPolygon( const CollPoly* at, const Vector2d* ap,
       float x, float y )
 {
-   int i;
-   float vprod, sprod, angle;
-   float dxi, dxip, dyi, dyip;
+   int i, j, in;
+   const float *px, *py;
 
-   /* See if the pixel is inside the polygon:
-      We increment the angle when doing a loop along all the points
-      If the final angle is 0, we are outside the polygon
-      Otherwise, the angle should be +/- 2pi*/
-   angle = 0.0;
-   for (i=0; i<=at->npt-2; i++) {
-      dxi  = at->x[i]  +VX(*ap)-x;
-      dxip = at->x[i+1]+VX(*ap)-x;
-      dyi  = at->y[i]  +VY(*ap)-y;
-      dyip = at->y[i+1]+VY(*ap)-y;
-      sprod = dxi * dxip + dyi * dyip;
-      vprod = dxi * dyip - dyi * dxip;
-      angle += atan2(vprod, sprod);
-   }
-   dxi  = at->x[at->npt-1] + VX(*ap) - x;
-   dxip = at->x[0] + VX(*ap) - x;
-   dyi  = at->y[at->npt-1] + VY(*ap)- y;
-   dyip = at->y[0] + VY(*ap) - y;
-   sprod = dxi * dxip + dyi * dyip;
-   vprod = dxi * dyip - dyi * dxip;
-   angle += atan2(vprod, sprod);
-
-   if (FABS(angle) < 1e-5)
+   /* Work in the coordinates of the polygon. */
+   x -= VX(*ap);
+   y -= VY(*ap);
+   if ((x < at->xmin) || (x > at->xmax) || (y < at->ymin) || (y > at->ymax))
       return 0;
 
-   return 1;
+   /* See if the pixel is inside the polygon:
+      A ray going right from the point crosses the edges an odd number of
+      times if it's inside. */
+   px = at->x;
+   py = at->y;
+   in = 0;
+   for (i=0, j=at->npt-1; i<at->npt; j=i++)
+      if (((py[i] > y) != (py[j] > y)) &&
+            (x < (px[j]-px[i]) * (y-py[i]) / (py[j]-py[i]) + px[i]))
+         in = !in;
+
+   return in;
 }
 
 
@@ -387,24 +756,26 @@ int pointInPolygon( const CollPoly* at, const Vector2d* ap,
 int LineOnPolygon( const CollPoly* at, const Vector2d* ap,
       float x1, float y1, float x2, float y2, Vector2d* crash )
 {
-   float xi, xip, yi, yip;
-   int i;
+   int i, j;
 
    /* In this function, we are only looking for one collision point. */
 
-   xi  = at->x[at->npt-1] + ap->x;
-   xip = at->x[0]         + ap->x;
-   yi  = at->y[at->npt-1] + ap->y;
-   yip = at->y[0]         + ap->y;
-   if ( CollideLineLine(x1, y1, x2, y2, xi, yi, xip, yip, crash) == 1 )
-      return 1;
-   for (i=0; i<=at->npt-2; i++) {
-      xi  = at->x[i]   + ap->x;
-      xip = at->x[i+1] + ap->x;
-      yi  = at->y[i]   + ap->y;
-      yip = at->y[i+1] + ap->y;
-      if ( CollideLineLine(x1, y1, x2, y2, xi, yi, xip, yip, crash) == 1 )
+   /* Work in the coordinates of the polygon. */
+   x1 -= ap->x;
+   y1 -= ap->y;
+   x2 -= ap->x;
+   y2 -= ap->y;
+   if ((MAX(x1,x2) < at->xmin) || (MIN(x1,x2) > at->xmax) ||
+         (MAX(y1,y2) < at->ymin) || (MIN(y1,y2) > at->ymax))
+      return 0;
+
+   for (i=0, j=at->npt-1; i<at->npt; j=i++) {
+      if ( CollideLineLine(x1, y1, x2, y2,
+            at->x[j], at->y[j], at->x[i], at->y[i], crash) == 1 ) {
+         crash->x += ap->x;
+         crash->y += ap->y;
          return 1;
+      }
    }
 
    return 0;
@@ -638,11 +1009,22 @@ int CollideLinePolygon( const Vector2d* ap, double ad, double al,
    double xi, yi, xip, yip;
    int hits, real_hits;
    Vector2d tmp_crash;
+   double dx, dy, t;
 
    /* Set up end point of line. */
    ep[0] = ap->x + al*cos(ad);
    ep[1] = ap->y + al*sin(ad);
 
+   /* Reject if the closest point of the line is out of the bounding circle. */
+   dx = ep[0] - ap->x;
+   dy = ep[1] - ap->y;
+   t  = (al > 0.) ? ((bp->x-ap->x)*dx + (bp->y-ap->y)*dy) / (al*al) : 0.;
+   t  = CLAMP( 0., 1., t );
+   dx = ap->x + t*dx - bp->x;
+   dy = ap->y + t*dy - bp->y;
+   if (dx*dx + dy*dy > (double)bt->rad*bt->rad)
+      return 0;
+
    real_hits = 0;
    vectnull( &tmp_crash );
 
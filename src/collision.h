@@ -24,12 +24,16 @@ typedef struct CollPoly_ {
    float xmax; /**< Max of x. */
    float ymin; /**< Min of y. */
    float ymax; /**< Max of y. */
+   float rad; /**< Bounding radius around the origin. */
    int npt; /**< Nb of points in the polygon. */
 } CollPoly;
 
 
 /* Loads a polygon data from xml. */
 void LoadPolygon( CollPoly* polygon, xmlNodePtr node );
+CollPoly* LoadPolygonFile( const char *file, int size_hint );
+int CompactPolygons( CollPoly **polygons, int keyframes );
+void RotatePolygon( CollPoly* rpolygon, const CollPoly* ipolygon, float theta );
 
 /* Returns 1 if collision is detected */
 int CollideSprite( const glTexture* at, const int asx, const int asy, const Vector2d* ap,
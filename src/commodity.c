@@ -62,6 +62,7 @@ extern int *econ_comm;
 /* Commodity. */
 static void commodity_freeOne( Commodity* com );
 static int commodity_parse( Commodity *temp, xmlNodePtr parent );
+static int commodity_loadNode( xmlNodePtr node, void *data );
 
 
 /**
@@ -427,9 +428,9 @@ void gatherable_update( double dt )
       g->pos.x += dt*gatherable_stack[i].vel.x;
       g->pos.y += dt*gatherable_stack[i].vel.y;
 
-      /* Remove the gatherable */
+      /* Remove the gatherable, they aren't kept in any order. */
       if (g->timer > g->lifeleng) {
-         array_erase( &gatherable_stack, g, g+1 );
+         array_erase_unordered( &gatherable_stack, g );
          i--;
       }
    }
@@ -564,6 +565,33 @@ void gatherable_gather( int pilot )
 }
 
 
+/**
+ * @brief Loads a commodity as the file is streamed.
+ */
+static int commodity_loadNode( xmlNodePtr node, void *data )
+{
+   (void) data;
+   Commodity *c;
+   int *e;
+
+   if (!xml_isNode(node, XML_COMMODITY_TAG)) {
+      WARN(_("'%s' has unknown node '%s'."), COMMODITY_DATA_PATH, node->name);
+      return 0;
+   }
+
+   /* Load commodity. */
+   c = &array_grow(&commodity_stack);
+   commodity_parse( c, node );
+
+   /* See if should get added to commodity list. */
+   if (c->price > 0.) {
+      e = &array_grow( &econ_comm );
+      *e = array_size(commodity_stack)-1;
+   }
+   return 0;
+}
+
+
 /**
  * @brief Loads all the commodity data.
  *
@@ -571,52 +599,19 @@ void gatherable_gather( int pilot )
  */
 int commodity_load (void)
 {
-   xmlNodePtr node;
-   xmlDocPtr doc;
-   Commodity *c;
-   int *e;
-
    commodity_stack = array_create( Commodity );
    econ_comm = array_create( int );
    gatherable_stack = array_create( Gatherable );
 
-   /* Load the file. */
-   doc = xml_parsePhysFS( COMMODITY_DATA_PATH );
-   if (doc == NULL)
-      return -1;
-
-   node = doc->xmlChildrenNode; /* Commodities node */
-   if (strcmp((char*)node->name,XML_COMMODITY_ID)) {
-      ERR(_("Malformed %s file: missing root element '%s'"), COMMODITY_DATA_PATH, XML_COMMODITY_ID);
+   /* Commodities are independent of each other, so there's no need for the
+    * whole tree at once. */
+   if (xml_streamPhysFS( COMMODITY_DATA_PATH, XML_COMMODITY_ID, commodity_loadNode, NULL ) < 0)
       return -1;
-   }
-
-   node = node->xmlChildrenNode; /* first commodity type */
-   if (node == NULL) {
+   if (array_size(commodity_stack) == 0) {
       ERR(_("Malformed %s file: does not contain elements"), COMMODITY_DATA_PATH);
       return -1;
    }
 
-   do {
-      xml_onlyNodes(node);
-      if (xml_isNode(node, XML_COMMODITY_TAG)) {
-
-         /* Load commodity. */
-         c = &array_grow(&commodity_stack);
-         commodity_parse( c, node );
-
-         /* See if should get added to commodity list. */
-         if (c->price > 0.) {
-            e = &array_grow( &econ_comm );
-            *e = array_size(commodity_stack)-1;
-         }
-      }
-      else
-         WARN(_("'%s' has unknown node '%s'."), COMMODITY_DATA_PATH, node->name);
-   } while (xml_nextNode(node));
-
-   xmlFreeDoc(doc);
-
    DEBUG( n_( "Loaded %d Commodity", "Loaded %d Commodities", array_size(commodity_stack) ), array_size(commodity_stack) );
 
    return 0;
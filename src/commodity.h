@@ -69,6 +69,9 @@ typedef struct CommodityPrice_ {
   double sum; /**< used when averaging over jump points during setup, and then for capturing the moving average when the player visits a planet. */
   double sum2; /**< sum of (squared prices seen), used for calc of standard deviation. */
   int cnt; /**< used for calc of mean and standard deviation - number of records in the data. */
+  int64_t cacheTime; /**< Time cachePrice was evaluated at. */
+  credits_t cachePrice; /**< Price at cacheTime. */
+  unsigned int cacheGen; /**< Generation of the prices cachePrice was evaluated with, 0 if none. */
 } CommodityPrice;
 
 /**
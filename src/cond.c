@@ -23,6 +23,12 @@
 static nlua_env cond_env = LUA_NOREF; /** Conditional Lua env. */
 
 
+/*
+ * Prototypes.
+ */
+static int cond_result( int ret );
+
+
 /**
  * @brief Initializes the conditional subsystem.
  */
@@ -55,22 +61,97 @@ void cond_exit (void)
 
 
 /**
- * @brief Checks to see if a condition is true.
+ * @brief Compiles a condition so it can be checked without parsing it again.
  *
- *    @param cond Condition to check.
- *    @return 0 if is false, 1 if is true, -1 on error.
+ *    @param cond Condition to compile.
+ *    @return Reference to the compiled condition to use with cond_checkChunk,
+ *            or LUA_NOREF on error.
  */
-int cond_check( const char* cond )
+int cond_compile( const char *cond )
 {
-   int b;
    int ret;
 
    /* Load the string. */
    lua_pushstring(naevL, "return ");
    lua_pushstring(naevL, cond);
    lua_concat(naevL, 2);
-   ret = nlua_dobufenv(cond_env, lua_tostring(naevL,-1),
-                       lua_strlen(naevL,-1), "Lua Conditional");
+   ret = luaL_loadbuffer(naevL, lua_tostring(naevL,-1),
+                         lua_strlen(naevL,-1), "Lua Conditional");
+   if (ret != 0) {
+      WARN(_("Lua conditional syntax error: %s"), lua_tostring(naevL, -1));
+      lua_pop(naevL, 2);
+      return LUA_NOREF;
+   }
+   lua_remove(naevL, -2);
+
+   /* Run it in the conditional environment. */
+   nlua_pushenv(cond_env);
+   lua_setfenv(naevL, -2);
+
+   return luaL_ref(naevL, LUA_REGISTRYINDEX);
+}
+
+
+/**
+ * @brief Frees a condition compiled with cond_compile.
+ *
+ *    @param chunk Compiled condition to free.
+ */
+void cond_free( int chunk )
+{
+   if (chunk != LUA_NOREF)
+      luaL_unref(naevL, LUA_REGISTRYINDEX, chunk);
+}
+
+
+/**
+ * @brief Checks to see if a compiled condition is true.
+ *
+ *    @param chunk Condition compiled with cond_compile.
+ *    @return 0 if is false, 1 if is true, -1 on error.
+ */
+int cond_checkChunk( int chunk )
+{
+   if (chunk == LUA_NOREF)
+      return -1;
+
+   lua_rawgeti(naevL, LUA_REGISTRYINDEX, chunk);
+   return cond_result( nlua_pcall(cond_env, 0, 1) );
+}
+
+
+/**
+ * @brief Checks to see if a condition is true.
+ *
+ * Compiles the condition every time, conditions checked often should be
+ *  compiled once with cond_compile instead.
+ *
+ *    @param cond Condition to check.
+ *    @return 0 if is false, 1 if is true, -1 on error.
+ */
+int cond_check( const char* cond )
+{
+   int ret, chunk;
+
+   chunk = cond_compile( cond );
+   if (chunk == LUA_NOREF)
+      return -1;
+   ret = cond_checkChunk( chunk );
+   cond_free( chunk );
+   return ret;
+}
+
+
+/**
+ * @brief Gets the result of running a condition.
+ *
+ *    @param ret Return value of running the condition.
+ *    @return 0 if is false, 1 if is true, -1 on error.
+ */
+static int cond_result( int ret )
+{
+   int b;
+
    switch (ret) {
       case  LUA_ERRSYNTAX:
          WARN(_("Lua conditional syntax error: %s"), lua_tostring(naevL, -1));
@@ -110,6 +110,11 @@ static void print_usage( void )
    LOG(_("   -s f, --svol f        sets the sound volume to f"));
    LOG(_("   -d, --datapath        adds a new datapath to be mounted (i.e., appends it to the search path for game assets)"));
    LOG(_("   -X, --scale           defines the scale factor"));
+   LOG(_("   -b f, --bench f       runs the benchmark scenario f and exits"));
+   LOG(_("   -k s, --kernel s      runs the engine microbenchmark s (or all) and exits"));
+   LOG(_("   -r f, --record f      records the input of the session to the replay f"));
+   LOG(_("   -p f, --replay f      plays back the replay f and exits"));
+   LOG(_("   --headless            hides the window and disables sound"));
 #ifdef DEBUGGING
    LOG(_("   --devmode             enables dev mode perks like the editors"));
    LOG(_("   --devcsv              generates csv output from the ndata for development purposes"));
@@ -154,6 +159,10 @@ void conf_setDefaults (void)
    /* Misc. */
    conf.redirect_file = 1;
    conf.nosave       = 0;
+   conf.ai_threaded  = 0;
+   conf.ai_lod       = 1;
+   conf.seeker_rate  = 30.;
+   conf.sim_rate     = 60.;
    conf.devmode      = 0;
    conf.devautosave  = 0;
    conf.devcsv       = 0;
@@ -190,6 +199,7 @@ void conf_setGameplayDefaults (void)
    conf.compression_velocity  = TIME_COMPRESSION_DEFAULT_MAX;
    conf.compression_mult      = TIME_COMPRESSION_DEFAULT_MULT;
    conf.save_compress         = SAVE_COMPRESSION_DEFAULT;
+   conf.save_xml              = SAVE_XML_DEFAULT;
    conf.mouse_thrust          = MOUSE_THRUST_DEFAULT;
    conf.mouse_doubleclick     = MOUSE_DOUBLECLICK_TIME;
    conf.autonav_reset_speed   = AUTONAV_RESET_SPEED_DEFAULT;
@@ -205,8 +215,10 @@ void conf_setAudioDefaults (void)
    /* Sound. */
    conf.snd_voices   = VOICES_DEFAULT;
    conf.snd_pilotrel = PILOT_RELATIVE_DEFAULT;
+   conf.snd_cache    = SOUND_CACHE_DEFAULT;
    conf.al_efx       = USE_EFX_DEFAULT;
    conf.al_bufsize   = BUFFER_SIZE_DEFAULT;
+   conf.al_bufcount  = BUFFER_COUNT_DEFAULT;
    conf.nosound      = MUTE_SOUND_DEFAULT;
    conf.sound        = SOUND_VOLUME_DEFAULT;
    conf.music        = MUSIC_VOLUME_DEFAULT;
@@ -244,6 +256,7 @@ void conf_setVideoDefaults (void)
    conf.fsaa         = FSAA_DEFAULT;
    conf.vsync        = VSYNC_DEFAULT;
    conf.compress     = TEXTURE_COMPRESSION_DEFAULT;
+   conf.vram_budget  = VRAM_BUDGET_DEFAULT;
 
    /* Window. */
    conf.fullscreen   = f;
@@ -260,12 +273,18 @@ void conf_setVideoDefaults (void)
    /* FPS. */
    conf.fps_show     = SHOW_FPS_DEFAULT;
    conf.fps_max      = FPS_MAX_DEFAULT;
+   conf.fps_precise  = FPS_PRECISE_DEFAULT;
+   conf.fps_background = FPS_BACKGROUND_DEFAULT;
+   conf.dynres       = DYNRES_DEFAULT;
+   conf.dynres_min   = DYNRES_MIN_DEFAULT;
+   conf.hitch_ms     = HITCH_MS_DEFAULT;
 
    /* Pause. */
    conf.pause_show   = SHOW_PAUSE_DEFAULT;
 
    /* Memory. */
    conf.engineglow   = ENGINE_GLOWS_DEFAULT;
+   conf.polygon_keyframes = POLYGON_KEYFRAMES_DEFAULT;
 }
 
 
@@ -326,9 +345,11 @@ int conf_loadConfig ( const char* file )
       conf_loadInt( lEnv, "fsaa", conf.fsaa );
       conf_loadBool( lEnv, "vsync", conf.vsync );
       conf_loadBool( lEnv, "compress", conf.compress );
+      conf_loadInt( lEnv, "vram_budget", conf.vram_budget );
 
       /* Memory. */
       conf_loadBool( lEnv, "engineglow", conf.engineglow );
+      conf_loadInt( lEnv, "polygon_keyframes", conf.polygon_keyframes );
 
       /* Window. */
       w = h = 0;
@@ -354,6 +375,11 @@ int conf_loadConfig ( const char* file )
       /* FPS */
       conf_loadBool( lEnv, "showfps", conf.fps_show );
       conf_loadInt( lEnv, "maxfps", conf.fps_max );
+      conf_loadBool( lEnv, "fps_precise", conf.fps_precise );
+      conf_loadInt( lEnv, "fps_background", conf.fps_background );
+      conf_loadBool( lEnv, "dynres", conf.dynres );
+      conf_loadFloat( lEnv, "dynres_min", conf.dynres_min );
+      conf_loadInt( lEnv, "hitch_ms", conf.hitch_ms );
 
       /*  Pause */
       conf_loadBool( lEnv, "showpause", conf.pause_show );
@@ -362,8 +388,12 @@ int conf_loadConfig ( const char* file )
       conf_loadInt( lEnv, "snd_voices", conf.snd_voices );
       conf.snd_voices = MAX( VOICES_MIN, conf.snd_voices ); /* Must be at least 16. */
       conf_loadBool( lEnv, "snd_pilotrel", conf.snd_pilotrel );
+      conf_loadInt( lEnv, "snd_cache", conf.snd_cache );
+      conf.snd_cache = MAX( 0, conf.snd_cache );
       conf_loadBool( lEnv, "al_efx", conf.al_efx );
       conf_loadInt( lEnv, "al_bufsize", conf.al_bufsize );
+      conf_loadInt( lEnv, "al_bufcount", conf.al_bufcount );
+      conf.al_bufcount = CLAMP( BUFFER_COUNT_MIN, BUFFER_COUNT_MAX, conf.al_bufcount );
       conf_loadBool( lEnv, "nosound", conf.nosound );
       conf_loadFloat( lEnv, "sound", conf.sound );
       conf_loadFloat( lEnv, "music", conf.music );
@@ -406,6 +436,7 @@ int conf_loadConfig ( const char* file )
       conf_loadFloat( lEnv, "compression_mult", conf.compression_mult );
       conf_loadBool( lEnv, "redirect_file", conf.redirect_file );
       conf_loadBool( lEnv, "save_compress", conf.save_compress );
+      conf_loadBool( lEnv, "save_xml", conf.save_xml );
       conf_loadInt( lEnv, "afterburn_sensitivity", conf.afterburn_sens );
       conf_loadInt( lEnv, "mouse_thrust", conf.mouse_thrust );
       conf_loadFloat( lEnv, "mouse_doubleclick", conf.mouse_doubleclick );
@@ -413,6 +444,10 @@ int conf_loadConfig ( const char* file )
       conf_loadBool( lEnv, "devmode", conf.devmode );
       conf_loadBool( lEnv, "devautosave", conf.devautosave );
       conf_loadBool( lEnv, "conf_nosave", conf.nosave );
+      conf_loadBool( lEnv, "ai_threaded", conf.ai_threaded );
+      conf_loadBool( lEnv, "ai_lod", conf.ai_lod );
+      conf_loadFloat( lEnv, "seeker_rate", conf.seeker_rate );
+      conf_loadFloat( lEnv, "sim_rate", conf.sim_rate );
       conf_loadString( lEnv, "lastversion", conf.lastversion );
 
       /* Debugging. */
@@ -558,6 +593,11 @@ void conf_parseCLI( int argc, char** argv )
       { "mvol", required_argument, 0, 'm' },
       { "svol", required_argument, 0, 's' },
       { "scale", required_argument, 0, 'X' },
+      { "bench", required_argument, 0, 'b' },
+      { "kernel", required_argument, 0, 'k' },
+      { "record", required_argument, 0, 'r' },
+      { "replay", required_argument, 0, 'p' },
+      { "headless", no_argument, 0, 'G' },
 #ifdef DEBUGGING
       { "devmode", no_argument, 0, 'D' },
       { "devcsv", no_argument, 0, 'C' },
@@ -574,7 +614,7 @@ void conf_parseCLI( int argc, char** argv )
     */
    optind = 0;
    while ((c = getopt_long(argc, argv,
-         "fF:Vd:j:J:W:H:MSm:s:X:Nhv",
+         "fF:Vd:j:J:W:H:MSm:s:X:b:k:r:p:Nhv",
          long_options, &option_index)) != -1) {
       switch (c) {
          case 'd':
@@ -622,6 +662,34 @@ void conf_parseCLI( int argc, char** argv )
          case 'X':
             conf.scalefactor = atof(optarg);
             break;
+         case 'b':
+            free(conf.bench);
+            conf.bench    = strdup(optarg);
+            conf.headless = 1;
+            conf.nosound  = 1;
+            conf.nosave   = 1;
+            break;
+         case 'k':
+            free(conf.bench_kernel);
+            conf.bench_kernel = strdup(optarg);
+            conf.headless = 1;
+            conf.nosound  = 1;
+            conf.nosave   = 1;
+            break;
+         case 'r':
+            free(conf.record);
+            conf.record = strdup(optarg);
+            break;
+         case 'p':
+            free(conf.replay);
+            conf.replay = strdup(optarg);
+            conf.nosave = 1;
+            break;
+         case 'G':
+            conf.headless = 1;
+            conf.nosound  = 1;
+            conf.nosave   = 1;
+            break;
 #ifdef DEBUGGING
          case 'D':
             conf.devmode = 1;
@@ -850,11 +918,19 @@ int conf_saveConfig ( const char* file )
    conf_saveBool("compress",conf.compress);
    conf_saveEmptyLine();
 
+   conf_saveComment(_("MiB of video memory images such as planets and portraits can use before the least recently drawn are unloaded, 0 for no limit"));
+   conf_saveInt("vram_budget",conf.vram_budget);
+   conf_saveEmptyLine();
+
    /* Memory. */
    conf_saveComment(_("If true enables engine glow"));
    conf_saveBool("engineglow",conf.engineglow);
    conf_saveEmptyLine();
 
+   conf_saveComment(_("Collision polygons kept per ship, the others are rotated from them when needed. 0 keeps one per sprite"));
+   conf_saveInt("polygon_keyframes",conf.polygon_keyframes);
+   conf_saveEmptyLine();
+
    /* Window. */
    conf_saveComment(_("The window size or screen resolution"));
    conf_saveComment(_("Set both of these to 0 to make Naev try the desktop resolution"));
@@ -910,6 +986,24 @@ int conf_saveConfig ( const char* file )
    conf_saveInt("maxfps",conf.fps_max);
    conf_saveEmptyLine();
 
+   conf_saveComment(_("Spin for the last moments before each frame instead of sleeping, for even frame times"));
+   conf_saveBool("fps_precise",conf.fps_precise);
+   conf_saveEmptyLine();
+
+   conf_saveComment(_("Limit the frame rate to this when the window is not focused or a menu is open, 0 to not limit"));
+   conf_saveInt("fps_background",conf.fps_background);
+   conf_saveEmptyLine();
+
+   conf_saveComment(_("Render the game at a lower resolution when the GPU can't keep up with the frame rate, the GUI stays sharp"));
+   conf_saveBool("dynres",conf.dynres);
+   conf_saveComment(_("Lowest scale of the game resolution, between 0.25 and 1"));
+   conf_saveFloat("dynres_min",conf.dynres_min);
+   conf_saveEmptyLine();
+
+   conf_saveComment(_("Frames taking longer than this many milliseconds save the last frames to a hitch capture in the cache, 0 to disable"));
+   conf_saveInt("hitch_ms",conf.hitch_ms);
+   conf_saveEmptyLine();
+
    /* Pause */
    conf_saveComment(_("Show 'PAUSED' on screen while paused"));
    conf_saveBool("showpause",conf.pause_show);
@@ -924,6 +1018,10 @@ int conf_saveConfig ( const char* file )
    conf_saveBool("snd_pilotrel",conf.snd_pilotrel);
    conf_saveEmptyLine();
 
+   conf_saveComment(_("Memory budget for the loaded sounds in mebibytes, least recently played ones get unloaded past it. 0 is unlimited."));
+   conf_saveInt("snd_cache",conf.snd_cache);
+   conf_saveEmptyLine();
+
    conf_saveComment(_("Enables EFX extension for OpenAL backend."));
    conf_saveBool("al_efx",conf.al_efx);
    conf_saveEmptyLine();
@@ -932,6 +1030,10 @@ int conf_saveConfig ( const char* file )
    conf_saveInt("al_bufsize",conf.al_bufsize);
    conf_saveEmptyLine();
 
+   conf_saveComment(_("Amount of OpenAL music buffers to queue, smaller buffers need more of them."));
+   conf_saveInt("al_bufcount",conf.al_bufcount);
+   conf_saveEmptyLine();
+
    conf_saveComment(_("Disable all sound"));
    conf_saveBool("nosound",conf.nosound);
    conf_saveEmptyLine();
@@ -1016,6 +1118,10 @@ int conf_saveConfig ( const char* file )
    conf_saveBool("save_compress",conf.save_compress);
    conf_saveEmptyLine();
 
+   conf_saveComment(_("Writes saved games as plain XML, which is slower to list and load"));
+   conf_saveBool("save_xml",conf.save_xml);
+   conf_saveEmptyLine();
+
    conf_saveComment(_("Afterburner sensitivity"));
    conf_saveInt("afterburn_sensitivity",conf.afterburn_sens);
    conf_saveEmptyLine();
@@ -1044,6 +1150,22 @@ int conf_saveConfig ( const char* file )
    conf_saveInt("conf_nosave",conf.nosave);
    conf_saveEmptyLine();
 
+   conf_saveComment(_("Precompute what the AI senses on multiple threads before it thinks"));
+   conf_saveBool("ai_threaded",conf.ai_threaded);
+   conf_saveEmptyLine();
+
+   conf_saveComment(_("Makes pilots far away from the player think less often"));
+   conf_saveBool("ai_lod",conf.ai_lod);
+   conf_saveEmptyLine();
+
+   conf_saveComment(_("How many times per second seeker missiles update their guidance, 0 to update every step"));
+   conf_saveFloat("seeker_rate",conf.seeker_rate);
+   conf_saveEmptyLine();
+
+   conf_saveComment(_("How many times per second the game is simulated regardless of the frame rate, 0 to simulate once per frame"));
+   conf_saveFloat("sim_rate",conf.sim_rate);
+   conf_saveEmptyLine();
+
    conf_saveComment(_("Indicates the last version the game has run in before"));
    conf_saveString("lastversion", conf.lastversion);
    conf_saveEmptyLine();
@@ -1174,6 +1296,10 @@ void conf_free( PlayerConf_t *config )
    free(config->dev_save_sys);
    free(config->dev_save_map);
    free(config->dev_save_asset);
+   free(config->bench);
+   free(config->bench_kernel);
+   free(config->record);
+   free(config->replay);
 
    /* Clear memory. */
    memset( config, 0, sizeof(PlayerConf_t) );
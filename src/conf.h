@@ -16,6 +16,7 @@
 #define TIME_COMPRESSION_DEFAULT_MULT        200   /**< Default level of time compression multiplier. */
 #define REDIRECT_FILE_DEFAULT                1     /**< Whether output should be redirected to a file. */
 #define SAVE_COMPRESSION_DEFAULT             1     /**< Whether or not saved games should be compressed. */
+#define SAVE_XML_DEFAULT                     0     /**< Whether or not saved games should be plain XML. */
 #define MOUSE_THRUST_DEFAULT                 1     /**< Whether or not to use mouse thrust controls. */
 #define MOUSE_DOUBLECLICK_TIME               0.5   /**< How long to consider double-clicks for. */
 #define AUTONAV_RESET_SPEED_DEFAULT          1.    /**< Shield level (0-1) to reset autonav speed at. 1 means at enemy presence, 0 means at armour damage. */
@@ -32,12 +33,19 @@
 #define FSAA_DEFAULT                         1     /**< Whether to use Full Screen Anti-Aliasing. */
 #define VSYNC_DEFAULT                        0     /**< Whether to wait for vertical sync. */
 #define TEXTURE_COMPRESSION_DEFAULT          0     /**< Whether to use texture compression. */
+#define VRAM_BUDGET_DEFAULT                  512   /**< MiB of GPU memory reloadable textures can use. */
 #define SCALE_FACTOR_DEFAULT                 1.    /**< Default scale factor. */
 #define NEBULA_SCALE_FACTOR_DEFAULT          4.    /**< Default scale factor for nebula rendering. */
 #define SHOW_FPS_DEFAULT                     0     /**< Whether to display FPS on screen. */
 #define FPS_MAX_DEFAULT                      60    /**< Maximum FPS. */
+#define FPS_PRECISE_DEFAULT                  1     /**< Whether to spin just before frame deadlines. */
+#define FPS_BACKGROUND_DEFAULT               20    /**< Maximum FPS when unfocused or in menus. */
+#define DYNRES_DEFAULT                       1     /**< Whether to scale the game resolution with the GPU load. */
+#define DYNRES_MIN_DEFAULT                   0.5   /**< Lowest dynamic resolution scale. */
+#define HITCH_MS_DEFAULT                     250   /**< Frame length in ms considered a hitch. */
 #define SHOW_PAUSE_DEFAULT                   1     /**< Whether to display pause status. */
 #define ENGINE_GLOWS_DEFAULT                 1     /**< Whether to display engine glows. */
+#define POLYGON_KEYFRAMES_DEFAULT            0     /**< Collision polygons kept per ship. */
 #define MINIMIZE_DEFAULT                     1     /**< Whether to minimize on focus loss. */
 #define COLORBLIND_DEFAULT                   0     /**< Whether to enable colorblindness simulation. */
 #define BG_BRIGHTNESS_DEFAULT                1.    /**< How much to darken (or lighten) the backgrounds. */
@@ -51,8 +59,12 @@
 #define VOICES_DEFAULT                       128   /**< Amount of voices to use. */
 #define VOICES_MIN                           16    /**< Minimum amount of voices to use. */
 #define PILOT_RELATIVE_DEFAULT               1     /**< Whether the sound is relative to the pilot (as opposed to the camera). */
+#define SOUND_CACHE_DEFAULT                  0     /**< Memory budget of the decoded sounds in MiB, 0 is unlimited. */
 #define USE_EFX_DEFAULT                      1     /**< Whether or not to use EFX (if using OpenAL). */
 #define BUFFER_SIZE_DEFAULT                  128   /**< Default buffer size (if using OpenAL). */
+#define BUFFER_COUNT_DEFAULT                 2     /**< Default amount of music buffers (if using OpenAL). */
+#define BUFFER_COUNT_MIN                     2     /**< Minimum amount of music buffers. */
+#define BUFFER_COUNT_MAX                     16    /**< Maximum amount of music buffers. */
 #define MUTE_SOUND_DEFAULT                   0     /**< Whether sound should be disabled. */
 #define SOUND_VOLUME_DEFAULT                 0.6   /**< Default sound volume. */
 #define MUSIC_VOLUME_DEFAULT                 0.8   /**< Default music volume. */
@@ -81,9 +93,11 @@ typedef struct PlayerConf_s {
    int vsync; /**< Whether or not to use vsync. */
    int mipmaps; /**< Use mipmaps. */
    int compress; /**< Use texture compression. */
+   int vram_budget; /**< MiB of GPU memory reloadable textures can use before old ones are evicted, 0 for no limit. */
 
    /* Memory usage. */
    int engineglow; /**< Sets engine glow. */
+   int polygon_keyframes; /**< Collision polygons kept per ship, 0 to keep one per sprite. */
 
    /* Video options. */
    int width; /**< Width of the window to use. */
@@ -101,8 +115,10 @@ typedef struct PlayerConf_s {
    /* Sound. */
    int snd_voices; /**< Number of sound voices to use. */
    int snd_pilotrel; /**< Sound is relative to pilot when following. */
+   int snd_cache; /**< Memory budget of the decoded sounds in MiB, 0 is unlimited. */
    int al_efx; /**< Should EFX extension be used? (only applicable for OpenAL) */
    int al_bufsize; /**< Size of the buffer (in kilobytes) to use for music. */
+   int al_bufcount; /**< Amount of buffers to queue for music. */
    int nosound; /**< Whether or not sound is on. */
    double sound; /**< Sound level for sound effects. */
    double music; /**< Sound level for music. */
@@ -110,6 +126,11 @@ typedef struct PlayerConf_s {
    /* FPS. */
    int fps_show; /**< Whether or not FPS should be shown */
    int fps_max; /**< Maximum FPS to limit to. */
+   int fps_precise; /**< Spin instead of sleeping just before frame deadlines. */
+   int fps_background; /**< Maximum FPS when unfocused or in menus, 0 for no limit. */
+   int dynres; /**< Lower the resolution of the game layer when the GPU can't keep up. */
+   double dynres_min; /**< Lowest scale of the game layer resolution. */
+   int hitch_ms; /**< Frames longer than this many ms dump a hitch capture, 0 to disable. */
 
    /* Pause. */
    int pause_show; /**< Whether pause status should be shown. */
@@ -145,11 +166,21 @@ typedef struct PlayerConf_s {
    double compression_mult; /**< Maximum time multiplier. */
    int redirect_file; /**< Redirect output to files. */
    int save_compress; /**< Compress saved game. */
+   int save_xml; /**< Write saved games as plain XML instead of chunks. */
    unsigned int afterburn_sens; /**< Afterburn sensibility. */
    int mouse_thrust; /**< Whether mouse flying controls thrust. */
    double mouse_doubleclick; /**< How long to consider double-clicks for. */
    double autonav_reset_speed; /**< Condition for resetting autonav speed. */
    int nosave; /**< Disables conf saving. */
+   char *bench; /**< Benchmark scenario to run instead of the game. */
+   char *bench_kernel; /**< Engine microbenchmark to run instead of the game. */
+   char *record; /**< File to record a replay of the session to. */
+   char *replay; /**< Replay to play back instead of taking input. */
+   int headless; /**< Hides the window and disables sound. */
+   int ai_threaded; /**< Run the AI sensing pass on multiple threads. */
+   int ai_lod; /**< Reduce how often distant pilots think. */
+   double seeker_rate; /**< Seeker guidance updates per second, 0 to update every step. */
+   double sim_rate; /**< Fixed simulation updates per second, 0 to update once per frame. */
    int devmode; /**< Developer mode. */
    int devautosave; /**< Developer mode autosave. */
    int devcsv; /**< Output CSV data. */
@@ -80,10 +80,14 @@ static int cli_firstline   = 1; /**< Is this the first line? */
  */
 static int cli_script( lua_State *L );
 static int cli_printOnly( lua_State *L );
+static int cli_luaprof( lua_State *L );
+static int cli_luaprofDump( lua_State *L );
 static const luaL_Reg cli_methods[] = {
    { "print", cli_printOnly },
    { "script", cli_script },
    { "warn", cli_warn },
+   { "luaprof", cli_luaprof },
+   { "luaprof_dump", cli_luaprofDump },
    {NULL, NULL}
 }; /**< Console only functions. */
 
@@ -214,6 +218,60 @@ static int cli_printOnly( lua_State *L )
 }
 
 
+/**
+ * @brief Controls and displays the timing of Lua functions.
+ *
+ * @usage luaprof(true) -- Starts timing from scratch
+ * @usage luaprof() -- Shows the 20 functions that took the most time
+ * @usage luaprof(false) -- Stops timing
+ *
+ *    @luatparam[opt] boolean|number enable Whether to time (resets the
+ *              timings when starting), or number of functions to show.
+ */
+static int cli_luaprof( lua_State *L )
+{
+   int i, n;
+   char buf[STRMAX];
+   const NluaProfEntry *e;
+
+   if (lua_isboolean(L,1)) {
+      if (lua_toboolean(L,1) && !nlua_profEnabled())
+         nlua_profReset();
+      nlua_profEnable( lua_toboolean(L,1) );
+      return 0;
+   }
+
+   n = luaL_optinteger(L,1,20);
+   e = nlua_profSort();
+   if (!nlua_profEnabled())
+      cli_addMessage( _("Lua function timing is off, enable it with luaprof(true).") );
+   snprintf( buf, sizeof(buf), "%8s %10s %8s %8s  %s",
+         _("calls"), _("total ms"), _("avg ms"), _("max ms"), _("function") );
+   cli_addMessage( buf );
+   for (i=0; i<MIN(n, array_size(e)); i++) {
+      snprintf( buf, sizeof(buf), "%8u %10.2f %8.3f %8.2f  %s",
+            e[i].calls, e[i].time, e[i].time / MAX( 1, e[i].calls ), e[i].max,
+            e[i].name );
+      cli_printCoreString( buf, 1 );
+   }
+   return 0;
+}
+
+
+/**
+ * @brief Writes the timing of Lua functions to a CSV file in the save directory.
+ *
+ *    @luatparam[opt="luaprof.csv"] string filename File to write to.
+ */
+static int cli_luaprofDump( lua_State *L )
+{
+   const char *filename = luaL_optstring(L, 1, "luaprof.csv");
+   if (nlua_profDump( filename ))
+      NLUA_ERROR(L, _("Unable to write '%s'."), filename);
+   return 0;
+}
+
+
 /**
  * @brief Would be like "dofile" from the base Lua lib.
  */
@@ -101,20 +101,20 @@ void debris_add( double mass, double r, double px, double py,
    /* Now add the spfx. */
    for (i=0; i<n; i++) {
       /* Get position. */
-      d = r/2. * RNG_2SIGMA();
-      a = RNGF()*2*M_PI;
+      d = r/2. * RNG_2SIGMA_COSMETIC();
+      a = RNGF_COSMETIC()*2*M_PI;
       npx = px + d*cos(a);
       npy = py + d*sin(a);
 
       /* Get velocity. */
-      d = n * RNG_2SIGMA();
-      a = RNGF()*2*M_PI;
+      d = n * RNG_2SIGMA_COSMETIC();
+      a = RNGF_COSMETIC()*2*M_PI;
       nvx = vx + d*cos(a);
       nvy = vy + d*sin(a);
 
       /* Createsprite. */
-      spfx_add( debris_spfx[ RNG( 0, debris_nspfx-1 ) ],
-            npx, npy, nvx, nvy, RNG(0,1) );
+      spfx_add( debris_spfx[ RNG_COSMETIC( 0, debris_nspfx-1 ) ],
+            npx, npy, nvx, nvy, RNG_COSMETIC(0,1) );
    }
 }
 
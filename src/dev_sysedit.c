@@ -284,8 +284,7 @@ static void sysedit_close( unsigned int wid, char *wgt )
    system_setFaction( sysedit_sys );
 
    /* Save the system */
-   if (conf.devautosave)
-      dsys_saveSystem( sysedit_sys );
+   dsys_edited( sysedit_sys );
 
    /* Reconstruct universe presences. */
    space_reconstructPresences();
@@ -312,9 +311,6 @@ static void sysedit_editPntClose( unsigned int wid, char *unused )
 
    p = sysedit_sys->planets[ sysedit_select[0].u.planet ];
 
-   /* Remove the old presence. */
-   system_addPresence(sysedit_sys, p->faction, -p->presenceAmount, p->presenceRange);
-
    p->population = (uint64_t)strtoull( window_getInput( sysedit_widEdit, "inpPop" ), 0, 10);
 
    inp = window_getInput( sysedit_widEdit, "inpClass" );
@@ -337,14 +333,11 @@ static void sysedit_editPntClose( unsigned int wid, char *unused )
    p->presenceRange  = atoi(window_getInput( sysedit_widEdit, "inpPresenceRange" ));
    p->hide           = pow2( atof(window_getInput( sysedit_widEdit, "inpHide" )) );
 
-   /* Add the new presence. */
-   system_addPresence(sysedit_sys, p->faction, p->presenceAmount, p->presenceRange);
-
    if (conf.devautosave)
       dpl_savePlanet( p );
 
-   /* Clean up presences. */
-   space_reconstructPresences();
+   /* Update the presence of the planet. */
+   space_updatePresences();
 
    window_close( wid, unused );
 }
@@ -9,6 +9,8 @@
  */
 
 /** @cond */
+#include <errno.h>
+#include <stdio.h>
 #include <stdlib.h> /* qsort */
 
 #include "naev.h"
@@ -24,6 +26,10 @@
 #include "physics.h"
 #include "space.h"
 #include "nebula.h"
+#include "threadpool.h"
+
+
+static char *dsys_dirty = NULL; /**< Systems edited since they were last saved, indexed by ID (array.h). */
 
 
 /*
@@ -31,6 +37,9 @@
  */
 static int dsys_compPlanet( const void *planet1, const void *planet2 );
 static int dsys_compJump( const void *jmp1, const void *jmp2 );
+static void dsys_setDirty( const StarSystem *sys, int dirty );
+static int dsys_writeSystem( StarSystem *sys );
+static int dsys_saveJob( void *data );
 
 
 /**
@@ -70,6 +79,48 @@ static int dsys_compJump( const void *jmp1, const void *jmp2 )
 
 
 
+/**
+ * @brief Sets whether a star system has unsaved changes.
+ *
+ *    @param sys Star system to set.
+ *    @param dirty Whether it has unsaved changes.
+ */
+static void dsys_setDirty( const StarSystem *sys, int dirty )
+{
+   int n;
+
+   if (dsys_dirty == NULL)
+      dsys_dirty = array_create( char );
+   n = array_size( dsys_dirty );
+   if (sys->id >= n) {
+      if (!dirty)
+         return;
+      array_resize( &dsys_dirty, sys->id+1 );
+      memset( &dsys_dirty[n], 0, sys->id+1-n );
+   }
+   dsys_dirty[ sys->id ] = dirty;
+}
+
+
+/**
+ * @brief Notes that a star system was edited.
+ *
+ * It gets saved right away with autosave, otherwise on the next save all.
+ *
+ *    @param sys Star system that was edited.
+ */
+void dsys_edited( StarSystem *sys )
+{
+   /* Routes drawn on the map and editor caches depend on the system. */
+   space_pathGen++;
+
+   if (conf.devautosave)
+      dsys_saveSystem( sys );
+   else
+      dsys_setDirty( sys, 1 );
+}
+
+
 /**
  * @brief Saves a star system.
  *
@@ -78,17 +129,33 @@ static int dsys_compJump( const void *jmp1, const void *jmp2 )
  */
 int dsys_saveSystem( StarSystem *sys )
 {
-   int i, j;
+   /* Reconstruct jumps so jump pos are updated. */
+   system_reconstructJumps(sys);
+   dsys_setDirty( sys, 0 );
+   return dsys_writeSystem( sys );
+}
+
+
+/**
+ * @brief Writes a star system to its file.
+ *
+ * Doesn't modify the system, so systems can be written from worker threads.
+ *  The file is written next to the old one and renamed over it, so it is
+ *  never left half written.
+ *
+ *    @param sys Star system to write.
+ *    @return 0 on success.
+ */
+static int dsys_writeSystem( StarSystem *sys )
+{
+   int i, j, ret;
    xmlDocPtr doc;
    xmlTextWriterPtr writer;
    const Planet **sorted_planets;
    const JumpPoint **sorted_jumps, *jp;
    const AsteroidAnchor *ast;
    const AsteroidExclusion *aexcl;
-   char *file, *cleanName;
-
-   /* Reconstruct jumps so jump pos are updated. */
-   system_reconstructJumps(sys);
+   char *file, *tmp, *cleanName;
 
    /* Create the writer. */
    writer = xmlNewTextWriterDoc(&doc, 0);
@@ -222,35 +289,76 @@ int dsys_saveSystem( StarSystem *sys )
    xmlFreeTextWriter(writer);
 
    /* Write data. */
+   ret = 0;
    cleanName = uniedit_nameFilter( sys->name );
    asprintf( &file, "%s/%s.xml", conf.dev_save_sys, cleanName );
-   if (xmlSaveFileEnc( file, doc, "UTF-8" ) < 0)
-      WARN("Failed writing '%s'!", file);
+   asprintf( &tmp, "%s.tmp", file );
+   if (xmlSaveFileEnc( tmp, doc, "UTF-8" ) < 0) {
+      WARN(_("Failed writing '%s'!"), tmp);
+      remove(tmp);
+      ret = -1;
+   }
+   else {
+#ifdef _WIN32
+      /* rename() does not replace existing files on Windows. */
+      remove(file);
+#endif /* _WIN32 */
+      if (rename(tmp, file) != 0) {
+         WARN(_("Failed to rename '%s' to '%s': %s"), tmp, file, strerror(errno));
+         ret = -1;
+      }
+   }
 
    /* Clean up. */
    xmlFreeDoc(doc);
    free(cleanName);
    free(file);
+   free(tmp);
 
-   return 0;
+   return ret;
 }
 
 
 /**
- * @brief Saves all the star systems.
+ * @brief Writes a star system on the threadpool.
+ */
+static int dsys_saveJob( void *data )
+{
+   return dsys_writeSystem( data );
+}
+
+
+/**
+ * @brief Saves all the star systems edited since they were last saved.
+ *
+ * Jumps are updated here, and the systems are then written in parallel.
  *
  *    @return 0 on success.
  */
 int dsys_saveAll (void)
 {
-   int i;
+   int i, n;
    StarSystem *sys;
+   ThreadQueue *q;
 
    sys = system_getAll();
 
-   /* Write systems. */
-   for (i=0; i<array_size(sys); i++)
-      dsys_saveSystem( &sys[i] );
+   /* Write edited systems. */
+   q = NULL;
+   n = 0;
+   for (i=0; i<MIN( array_size(sys), array_size(dsys_dirty) ); i++) {
+      if (!dsys_dirty[i])
+         continue;
+      system_reconstructJumps( &sys[i] );
+      dsys_dirty[i] = 0;
+      if (q == NULL)
+         q = vpool_create();
+      vpool_enqueue( q, dsys_saveJob, &sys[i] );
+      n++;
+   }
+   if (q != NULL)
+      vpool_wait( q );
 
+   DEBUG( n_("Saved %d edited star system.", "Saved %d edited star systems.", n), n );
    return 0;
 }
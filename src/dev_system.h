@@ -10,6 +10,7 @@
 #include "space.h"
 
 int dsys_saveSystem( StarSystem *sys );
+void dsys_edited( StarSystem *sys );
 int dsys_saveAll (void);
 
 
@@ -53,6 +53,9 @@
 #define UNIEDIT_ZOOM_MAX         5     /**< Maximum uniedit zoom level (close). */
 #define UNIEDIT_ZOOM_MIN         -5    /**< Minimum uniedit zoom level (far). */
 
+#define UNIEDIT_GRID_CELL        100.  /**< Minimum size of the picking grid cells. */
+#define UNIEDIT_GRID_MAX         256   /**< Maximum picking grid cells per axis. */
+
 /*
  * The editor modes.
  */
@@ -83,6 +86,16 @@ static int uniedit_msys       = 0;  /**< Memory allocated for selected systems.
 static double uniedit_mx      = 0.; /**< X mouse position. */
 static double uniedit_my      = 0.; /**< Y mouse position. */
 
+/* Picking grid, buckets of system indices sorted by cell. */
+static int *uniedit_gridStart = NULL; /**< First entry of each cell in uniedit_gridSys (array.h). */
+static int *uniedit_gridSys   = NULL; /**< System indices sorted by cell (array.h). */
+static int uniedit_gridW      = 0;  /**< Cells along X. */
+static int uniedit_gridH      = 0;  /**< Cells along Y. */
+static double uniedit_gridX   = 0.; /**< X position of the grid origin. */
+static double uniedit_gridY   = 0.; /**< Y position of the grid origin. */
+static double uniedit_gridCell = 0.; /**< Size of the cells. */
+static unsigned int uniedit_gridGen = 0; /**< Value of space_pathGen the grid was made at. */
+
 
 static map_find_t *found_cur  = NULL;  /**< Pointer to found stuff. */
 static int found_ncur         = 0;     /**< Number of found stuff. */
@@ -91,6 +104,10 @@ static int found_ncur         = 0;     /**< Number of found stuff. */
 /*
  * Universe editor Prototypes.
  */
+/* Picking. */
+static void uniedit_gridBuild (void);
+static void uniedit_gridFree (void);
+static StarSystem *uniedit_pick( double x, double y, double r );
 /* Selection. */
 static void uniedit_deselect (void);
 static void uniedit_selectAdd( StarSystem *sys );
@@ -274,6 +291,7 @@ static void uniedit_close( unsigned int wid, char *wgt )
 {
    /* Frees some memory. */
    uniedit_deselect();
+   uniedit_gridFree();
 
    /* Reconstruct jumps. */
    systems_reconstructJumps();
@@ -438,6 +456,125 @@ static void uniedit_renderOverlay( double bx, double by, double bw, double bh, v
       toolkit_drawAltText( x, y, _("Click to toggle jump route"));
 }
 
+/**
+ * @brief Sorts the systems into the picking grid.
+ */
+static void uniedit_gridBuild (void)
+{
+   int i, n, c, cx, cy;
+   double xmin, ymin, xmax, ymax;
+   StarSystem *sys;
+
+   n = array_size(systems_stack);
+   if (uniedit_gridStart == NULL) {
+      uniedit_gridStart = array_create( int );
+      uniedit_gridSys   = array_create( int );
+   }
+
+   /* Bounds of the universe. */
+   xmin = ymin = HUGE_VAL;
+   xmax = ymax = -HUGE_VAL;
+   for (i=0; i<n; i++) {
+      sys  = system_getIndex( i );
+      xmin = MIN( xmin, sys->pos.x );
+      ymin = MIN( ymin, sys->pos.y );
+      xmax = MAX( xmax, sys->pos.x );
+      ymax = MAX( ymax, sys->pos.y );
+   }
+   if (n == 0)
+      xmin = ymin = xmax = ymax = 0.;
+   uniedit_gridX     = xmin;
+   uniedit_gridY     = ymin;
+   uniedit_gridCell  = MAX( UNIEDIT_GRID_CELL,
+         MAX( xmax-xmin, ymax-ymin ) / (UNIEDIT_GRID_MAX-1) );
+   uniedit_gridW     = (int)((xmax-xmin) / uniedit_gridCell) + 1;
+   uniedit_gridH     = (int)((ymax-ymin) / uniedit_gridCell) + 1;
+
+   /* Count the systems in each cell, then turn the counts into offsets. */
+   array_resize( &uniedit_gridStart, uniedit_gridW*uniedit_gridH + 1 );
+   memset( uniedit_gridStart, 0, sizeof(int) * array_size(uniedit_gridStart) );
+   for (i=0; i<n; i++) {
+      sys = system_getIndex( i );
+      cx  = (int)((sys->pos.x - xmin) / uniedit_gridCell);
+      cy  = (int)((sys->pos.y - ymin) / uniedit_gridCell);
+      uniedit_gridStart[ cy*uniedit_gridW + cx + 1 ]++;
+   }
+   for (c=0; c<uniedit_gridW*uniedit_gridH; c++)
+      uniedit_gridStart[c+1] += uniedit_gridStart[c];
+
+   /* Fill the cells, using the next cell's offset as a cursor. */
+   array_resize( &uniedit_gridSys, n );
+   for (i=0; i<n; i++) {
+      sys = system_getIndex( i );
+      cx  = (int)((sys->pos.x - xmin) / uniedit_gridCell);
+      cy  = (int)((sys->pos.y - ymin) / uniedit_gridCell);
+      c   = cy*uniedit_gridW + cx;
+      uniedit_gridSys[ uniedit_gridStart[c+1] - 1 ] = i;
+      uniedit_gridStart[c+1]--;
+   }
+   /* The cursors now point at the start of each cell. */
+   memmove( &uniedit_gridStart[0], &uniedit_gridStart[1], sizeof(int) * uniedit_gridW*uniedit_gridH );
+   uniedit_gridStart[ uniedit_gridW*uniedit_gridH ] = n;
+
+   uniedit_gridGen = space_pathGen;
+}
+
+
+/**
+ * @brief Frees the picking grid.
+ */
+static void uniedit_gridFree (void)
+{
+   array_free( uniedit_gridStart );
+   uniedit_gridStart = NULL;
+   array_free( uniedit_gridSys );
+   uniedit_gridSys = NULL;
+}
+
+
+/**
+ * @brief Finds the system closest to a position.
+ *
+ *    @param x X position in the universe.
+ *    @param y Y position in the universe.
+ *    @param r Maximum distance.
+ *    @return The closest system within the distance or NULL if none.
+ */
+static StarSystem *uniedit_pick( double x, double y, double r )
+{
+   int i, cx, cy, x0, y0, x1, y1, c;
+   double d, dmin;
+   StarSystem *sys, *best;
+
+   /* Systems move and get added whenever space_pathGen changes. */
+   if ((uniedit_gridStart == NULL) || (uniedit_gridGen != space_pathGen) ||
+         (array_size(uniedit_gridSys) != array_size(systems_stack)))
+      uniedit_gridBuild();
+
+   x0 = MAX( 0, (int)floor((x - r - uniedit_gridX) / uniedit_gridCell) );
+   y0 = MAX( 0, (int)floor((y - r - uniedit_gridY) / uniedit_gridCell) );
+   x1 = MIN( uniedit_gridW-1, (int)floor((x + r - uniedit_gridX) / uniedit_gridCell) );
+   y1 = MIN( uniedit_gridH-1, (int)floor((y + r - uniedit_gridY) / uniedit_gridCell) );
+
+   best = NULL;
+   dmin = pow2(r);
+   for (cy=y0; cy<=y1; cy++) {
+      for (cx=x0; cx<=x1; cx++) {
+         c = cy*uniedit_gridW + cx;
+         for (i=uniedit_gridStart[c]; i<uniedit_gridStart[c+1]; i++) {
+            sys = system_getIndex( uniedit_gridSys[i] );
+            d   = pow2(sys->pos.x-x) + pow2(sys->pos.y-y);
+            if (d < dmin) {
+               dmin = d;
+               best = sys;
+            }
+         }
+      }
+   }
+   return best;
+}
+
+
 /**
  * @brief System editor custom widget mouse handling.
  */
@@ -447,11 +584,11 @@ static int uniedit_mouse( unsigned int wid, SDL_Event* event, double mx, double
    (void) wid;
    (void) data;
    int i;
-   double x,y, t;
+   double t;
    StarSystem *sys;
    SDL_Keymod mod;
 
-   t = 15.*15.; /* threshold */
+   t = 15.; /* threshold */
 
    /* Handle modifiers. */
    mod = SDL_GetModState();
@@ -486,67 +623,60 @@ static int uniedit_mouse( unsigned int wid, SDL_Event* event, double mx, double
                return 1;
             }
 
-            for (i=0; i<array_size(systems_stack); i++) {
-               sys = system_getIndex( i );
-
-               /* get position */
-               x = sys->pos.x * uniedit_zoom;
-               y = sys->pos.y * uniedit_zoom;
-
-               if ((pow2(mx-x)+pow2(my-y)) < t) {
-
-                  /* Try to find in selected systems - begin drag move. */
-                  for (i=0; i<uniedit_nsys; i++) {
-                     /* Must match. */
-                     if (uniedit_sys[i] != sys)
-                        continue;
-
-                     /* Detect double click to open system. */
-                     if ((SDL_GetTicks() - uniedit_dragTime < UNIEDIT_DRAG_THRESHOLD*2)
-                           && (uniedit_moved < UNIEDIT_MOVE_THRESHOLD)) {
-                        if (uniedit_nsys == 1) {
-                           sysedit_open( uniedit_sys[0] );
-                           return 1;
-                        }
-                     }
-
-                     /* Handle normal click. */
-                     if (uniedit_mode == UNIEDIT_DEFAULT) {
-                        uniedit_dragSys   = 1;
-                        uniedit_tsys      = sys;
-
-                        /* Check modifier. */
-                        if (mod & (KMOD_LCTRL | KMOD_RCTRL))
-                           uniedit_tadd      = 0;
-                        else
-                           uniedit_tadd      = -1;
-                        uniedit_dragTime  = SDL_GetTicks();
-                        uniedit_moved     = 0;
+            /* Threshold is in pixels, so it grows in the universe when zooming out. */
+            sys = uniedit_pick( mx / uniedit_zoom, my / uniedit_zoom, t / uniedit_zoom );
+            if (sys != NULL) {
+               /* Try to find in selected systems - begin drag move. */
+               for (i=0; i<uniedit_nsys; i++) {
+                  /* Must match. */
+                  if (uniedit_sys[i] != sys)
+                     continue;
+
+                  /* Detect double click to open system. */
+                  if ((SDL_GetTicks() - uniedit_dragTime < UNIEDIT_DRAG_THRESHOLD*2)
+                        && (uniedit_moved < UNIEDIT_MOVE_THRESHOLD)) {
+                     if (uniedit_nsys == 1) {
+                        sysedit_open( uniedit_sys[0] );
+                        return 1;
                      }
-                     return 1;
                   }
 
+                  /* Handle normal click. */
                   if (uniedit_mode == UNIEDIT_DEFAULT) {
-                     /* Add the system if not selected. */
-                     if (mod & (KMOD_LCTRL | KMOD_RCTRL))
-                        uniedit_selectAdd( sys );
-                     else {
-                        uniedit_deselect();
-                        uniedit_selectAdd( sys );
-                     }
-                     uniedit_tsys      = NULL;
-
-                     /* Start dragging anyway. */
                      uniedit_dragSys   = 1;
+                     uniedit_tsys      = sys;
+
+                     /* Check modifier. */
+                     if (mod & (KMOD_LCTRL | KMOD_RCTRL))
+                        uniedit_tadd      = 0;
+                     else
+                        uniedit_tadd      = -1;
                      uniedit_dragTime  = SDL_GetTicks();
                      uniedit_moved     = 0;
                   }
-                  else if (uniedit_mode == UNIEDIT_JUMP) {
-                     uniedit_toggleJump( sys );
-                     uniedit_mode = UNIEDIT_DEFAULT;
-                  }
                   return 1;
                }
+
+               if (uniedit_mode == UNIEDIT_DEFAULT) {
+                  /* Add the system if not selected. */
+                  if (mod & (KMOD_LCTRL | KMOD_RCTRL))
+                     uniedit_selectAdd( sys );
+                  else {
+                     uniedit_deselect();
+                     uniedit_selectAdd( sys );
+                  }
+                  uniedit_tsys      = NULL;
+
+                  /* Start dragging anyway. */
+                  uniedit_dragSys   = 1;
+                  uniedit_dragTime  = SDL_GetTicks();
+                  uniedit_moved     = 0;
+               }
+               else if (uniedit_mode == UNIEDIT_JUMP) {
+                  uniedit_toggleJump( sys );
+                  uniedit_mode = UNIEDIT_DEFAULT;
+               }
+               return 1;
             }
 
             /* Start dragging. */
@@ -581,9 +711,8 @@ static int uniedit_mouse( unsigned int wid, SDL_Event* event, double mx, double
                }
             }
             uniedit_dragSys   = 0;
-            if (conf.devautosave)
-               for (i=0; i<uniedit_nsys; i++)
-                  dsys_saveSystem(uniedit_sys[i]);
+            for (i=0; i<uniedit_nsys; i++)
+               dsys_edited(uniedit_sys[i]);
          }
          break;
 
@@ -607,6 +736,8 @@ static int uniedit_mouse( unsigned int wid, SDL_Event* event, double mx, double
                   uniedit_sys[i]->pos.x += rx / uniedit_zoom;
                   uniedit_sys[i]->pos.y -= ry / uniedit_zoom;
                }
+               /* Routes and the picking grid have to follow. */
+               space_pathGen++;
             }
 
             /* Update mouse movement. */
@@ -751,8 +882,7 @@ static void uniedit_newSys( double x, double y )
    uniedit_deselect();
    uniedit_selectAdd( sys );
 
-   if (conf.devautosave)
-      dsys_saveSystem( sys );
+   dsys_edited( sys );
 }
 
 
@@ -791,11 +921,9 @@ static void uniedit_toggleJump( StarSystem *sys )
    /* Reconstruct universe presences. */
    space_reconstructPresences();
 
-   if (conf.devautosave) {
-      dsys_saveSystem( sys );
-      if (isys != NULL)
-         dsys_saveSystem( isys );
-   }
+   dsys_edited( sys );
+   if (isys != NULL)
+      dsys_edited( isys );
 
    /* Update sidebar text. */
    uniedit_selectText();
@@ -1401,8 +1529,7 @@ static void uniedit_editSysClose( unsigned int wid, char *name )
    /* Text might need changing. */
    uniedit_selectText();
 
-   if (conf.devautosave)
-      dsys_saveSystem( uniedit_sys[0] );
+   dsys_edited( uniedit_sys[0] );
 
    /* Close the window. */
    window_close( wid, name );
@@ -1513,8 +1640,7 @@ static void uniedit_btnEditAddAssetAdd( unsigned int wid, char *unused )
    /* Regenerate the list. */
    uniedit_editGenList( uniedit_widEdit );
 
-   if (conf.devautosave)
-      dsys_saveSystem( uniedit_sys[0] );
+   dsys_edited( uniedit_sys[0] );
 
    /* Close the window. */
    window_close( wid, unused );
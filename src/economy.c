@@ -39,6 +39,7 @@
 #include "rng.h"
 #include "space.h"
 #include "spfx.h"
+#include "threadpool.h"
 
 
 /*
@@ -49,6 +50,7 @@
 #define ECON_FACTION_MOD   0.1 /**< Modifier on Base for faction standings. */
 #define ECON_PROD_MODIFIER 500000. /**< Production modifier, divide production by this amount. */
 #define ECON_PROD_VAR      0.01 /**< Defines the variability of production. */
+#define ECON_SOLVE_BLOCK   8 /**< Right hand sides solved together by a job. */
 
 
 /* systems stack. */
@@ -65,12 +67,17 @@ extern Commodity* commodity_stack;
 static int econ_initialized   = 0; /**< Is economy system initialized? */
 static int econ_queued        = 0; /**< Whether there are any queued updates. */
 static cs *econ_G             = NULL; /**< Admittance matrix. */
+static css *econ_S            = NULL; /**< Symbolic Cholesky analysis of econ_G. */
+static csn *econ_N            = NULL; /**< Numeric Cholesky factorization of econ_G. */
 int *econ_comm         = NULL; /**< Commodities to calculate. */
+static unsigned int econ_priceGen = 1; /**< Changes whenever the price parameters do, to invalidate cached prices. */
 
 
 /*
  * Prototypes.
  */
+/* Prices. */
+static credits_t economy_evalPrice( CommodityPrice *commPrice, ntime_t tme );
 /* Economy. */
 //static double econ_calcJumpR( StarSystem *A, StarSystem *B );
 //static double econ_calcSysI( unsigned int dt, StarSystem *sys, int price );
@@ -113,16 +120,7 @@ credits_t economy_getPriceAtTime( const Commodity *com,
                                   const StarSystem *sys, const Planet *p, ntime_t tme )
 {
    int i, k;
-   double price;
-   double t;
-   CommodityPrice *commPrice;
    (void) sys;
-   /* Get current time in periods.
-    * Note, taking off and landing takes about 1e7 ntime, which is 1 period.
-    * Time does not advance when on a planet.
-    * Journey with a single jump takes approx 3e7, so about 3 periods.
-    */
-   t = ntime_convertSeconds( tme ) / NT_PERIOD_SECONDS;
 
    /* Get position in stack. */
    k = com - commodity_stack;
@@ -140,14 +138,57 @@ credits_t economy_getPriceAtTime( const Commodity *com,
 
    /* and get the index on this planet */
    for ( i=0; i<array_size(p->commodities); i++) {
-     if ( ( strcmp(p->commodities[i]->name, com->name) == 0 ) )
+     if ( p->commodities[i] == com )
        break;
    }
    if (i >= array_size(p->commodities)) {
      WARN(_("Price for commodity '%s' not known on this planet."), com->name);
      return 0;
    }
-   commPrice = &p->commodityPrice[i];
+   return economy_evalPrice( &p->commodityPrice[i], tme );
+}
+
+
+/**
+ * @brief Gets the prices of all the goods of a planet.
+ *
+ *    @param p Planet to get the prices of.
+ *    @param tme Time to get prices at, eg as returned by ntime_get()
+ *    @param[out] prices Prices in the order of p->commodities.
+ */
+void economy_getPricesAtTime( const Planet *p, ntime_t tme, credits_t *prices )
+{
+   int i;
+   for (i=0; i<array_size(p->commodities); i++)
+      prices[i] = economy_evalPrice( &p->commodityPrice[i], tme );
+}
+
+
+/**
+ * @brief Evaluates the price of a good, reusing the last price if asked for the same time.
+ *
+ * Time does not advance when landed, so the trade screen keeps asking for
+ *  the same prices.
+ *
+ *    @param commPrice Price parameters of the good on a planet.
+ *    @param tme Time to get price at.
+ *    @return The price of the commodity.
+ */
+static credits_t economy_evalPrice( CommodityPrice *commPrice, ntime_t tme )
+{
+   double price;
+   double t;
+
+   if ((commPrice->cacheGen == econ_priceGen) && (commPrice->cacheTime == tme))
+      return commPrice->cachePrice;
+
+   /* Get current time in periods.
+    * Note, taking off and landing takes about 1e7 ntime, which is 1 period.
+    * Time does not advance when on a planet.
+    * Journey with a single jump takes approx 3e7, so about 3 periods.
+    */
+   t = ntime_convertSeconds( tme ) / NT_PERIOD_SECONDS;
+
    /* Calculate price. */
    /* price  = (double) com->price; */
    /* price *= sys->prices[i]; */
@@ -155,7 +196,11 @@ credits_t economy_getPriceAtTime( const Commodity *com,
             * sin(2 * M_PI * t / commPrice->sysPeriod)
          + commPrice->planetVariation
             * sin(2 * M_PI * t / commPrice->planetPeriod));
-   return (credits_t) (price+0.5);/* +0.5 to round */
+
+   commPrice->cacheGen   = econ_priceGen;
+   commPrice->cacheTime  = tme;
+   commPrice->cachePrice = (credits_t) (price+0.5);/* +0.5 to round */
+   return commPrice->cachePrice;
 }
 
 /**
@@ -404,8 +449,131 @@ static int econ_createGMatrix (void)
    /* Clean up. */
    cs_spfree(M);
 
+   /* G is symmetric and strictly diagonally dominant so it is positive
+    * definite, factorize it once here so that the solves are just
+    * substitutions. Only changes when the universe changes. */
+   cs_sfree( econ_S );
+   cs_nfree( econ_N );
+   econ_S = cs_schol( 1, econ_G );
+   econ_N = (econ_S != NULL) ? cs_chol( econ_G, econ_S ) : NULL;
+   if (econ_N == NULL)
+      ERR(_("Unable to factorize economy G Matrix."));
+
+   return 0;
+}
+
+
+/**
+ * @brief Block of right hand sides to solve.
+ */
+typedef struct EconSolveJob_ {
+   double *B; /**< Right hand sides, n by ncols column major. */
+   int n; /**< Number of rows. */
+   int start; /**< First column of the block. */
+   int end; /**< Column after the last of the block. */
+} EconSolveJob;
+
+
+/**
+ * @brief Solves a block of right hand sides with the cached factorization.
+ *
+ * The block is interleaved so that every row of L is applied to all the
+ *  columns of the block while it is in cache.
+ */
+static int econ_solveJob( void *data )
+{
+   EconSolveJob *job = data;
+   int i, j, k, c, nb, n;
+   const int *Lp, *Li, *pinv;
+   const double *Lx;
+   double *W, *x, d;
+
+   n    = job->n;
+   nb   = job->end - job->start;
+   Lp   = econ_N->L->p;
+   Li   = econ_N->L->i;
+   Lx   = econ_N->L->x;
+   pinv = econ_S->pinv;
+   W    = malloc( sizeof(double) * n * nb );
+
+   /* W = P b, interleaved. */
+   for (c=0; c<nb; c++)
+      for (k=0; k<n; k++)
+         W[ pinv[k]*nb + c ] = job->B[ (job->start+c)*n + k ];
+
+   /* Solve L y = W. */
+   for (j=0; j<n; j++) {
+      x = &W[ j*nb ];
+      d = 1. / Lx[ Lp[j] ];
+      for (c=0; c<nb; c++)
+         x[c] *= d;
+      for (k=Lp[j]+1; k<Lp[j+1]; k++) {
+         i = Li[k];
+         for (c=0; c<nb; c++)
+            W[ i*nb + c ] -= Lx[k] * x[c];
+      }
+   }
+
+   /* Solve L' x = y. */
+   for (j=n-1; j>=0; j--) {
+      x = &W[ j*nb ];
+      for (k=Lp[j]+1; k<Lp[j+1]; k++) {
+         i = Li[k];
+         for (c=0; c<nb; c++)
+            x[c] -= Lx[k] * W[ i*nb + c ];
+      }
+      d = 1. / Lx[ Lp[j] ];
+      for (c=0; c<nb; c++)
+         x[c] *= d;
+   }
+
+   /* b = P' x. */
+   for (c=0; c<nb; c++)
+      for (k=0; k<n; k++)
+         job->B[ (job->start+c)*n + k ] = W[ pinv[k]*nb + c ];
+
+   free( W );
    return 0;
 }
+
+
+/**
+ * @brief Solves G X = B for many right hand sides at once.
+ *
+ * Blocks of ECON_SOLVE_BLOCK columns are solved on the threadpool.
+ *
+ *    @param[in,out] B Right hand sides, array_size(systems_stack) by ncols
+ *           column major, the solutions are stored in place.
+ *    @param ncols Number of right hand sides.
+ *    @param threaded Whether or not to solve on the threadpool.
+ */
+static void econ_solveBatch( double *B, int ncols, int threaded )
+{
+   int i;
+   EconSolveJob *jobs, *job;
+   ThreadQueue *queue;
+
+   jobs = array_create_size( EconSolveJob, ncols/ECON_SOLVE_BLOCK+1 );
+   for (i=0; i<ncols; i+=ECON_SOLVE_BLOCK) {
+      job = &array_grow( &jobs );
+      job->B     = B;
+      job->n     = array_size(systems_stack);
+      job->start = i;
+      job->end   = MIN( i+ECON_SOLVE_BLOCK, ncols );
+   }
+
+   if (threaded && (array_size(jobs) > 1)) {
+      queue = vpool_create();
+      for (i=0; i<array_size(jobs); i++)
+         vpool_enqueue( queue, econ_solveJob, &jobs[i] );
+      vpool_wait( queue );
+   }
+   else {
+      for (i=0; i<array_size(jobs); i++)
+         econ_solveJob( &jobs[i] );
+   }
+   array_free( jobs );
+}
 #endif
 
 
@@ -491,8 +659,8 @@ int economy_update( unsigned int dt )
 {
    (void)dt;
 #if 0
-   int i, j;
-   double *X;
+   int i, j, n;
+   double *B, *X;
    double scale, offset;
    /*double min, max;*/
 
@@ -500,32 +668,25 @@ int economy_update( unsigned int dt )
    if (econ_initialized == 0)
       return 0;
 
-   /* Create the vector to solve the system. */
-   X = malloc(sizeof(double)*array_size(systems_stack));
-   if (X == NULL) {
+   /* Create the matrix with a column per price set. */
+   n = array_size(systems_stack);
+   B = malloc(sizeof(double)*n*array_size(econ_comm));
+   if (B == NULL) {
       WARN(_("Out of Memory"));
       return -1;
    }
 
-   /* Calculate the results for each price set. */
-   for (j=0; j<array_size(econ_comm); j++) {
+   /* First we must load the matrix with intensities. */
+   for (j=0; j<array_size(econ_comm); j++)
+      for (i=0; i<n; i++)
+         B[j*n+i] = econ_calcSysI( dt, &systems_stack[i], j );
 
+   /* Solve all the price sets at once. */
+   econ_solveBatch( B, array_size(econ_comm), 1 );
 
-      /* First we must load the vector with intensities. */
-      for (i=0; i<array_size(systems_stack); i++)
-         X[i] = econ_calcSysI( dt, &systems_stack[i], j );
-
-      /* Solve the system. */
-      /** @TODO This should be improved to try to use better factorizations (LU/Cholesky)
-       * if possible or just outright try to use some other library that does fancy stuff
-       * like UMFPACK. Would be also interesting to see if it could be optimized so we
-       * store the factorization or update that instead of handling it individually. Another
-       * point of interest would be to split loops out to make the solving faster, however,
-       * this may be trickier to do (although it would surely let us use cholesky always if we
-       * enforce that condition). */
-      ret = cs_qrsol( 3, econ_G, X );
-      if (ret != 1)
-         WARN(_("Failed to solve the Economy System."));
+   /* Calculate the results for each price set. */
+   for (j=0; j<array_size(econ_comm); j++) {
+      X = &B[j*n];
 
       /*
        * Get the minimum and maximum to scale.
@@ -555,7 +716,7 @@ int economy_update( unsigned int dt )
    }
 
    /* Clean up. */
-   free(X);
+   free(B);
 
 #endif
    econ_queued = 0;
@@ -583,6 +744,10 @@ void economy_destroy (void)
    /* Destroy the economy matrix. */
    cs_spfree( econ_G );
    econ_G = NULL;
+   cs_sfree( econ_S );
+   econ_S = NULL;
+   cs_nfree( econ_N );
+   econ_N = NULL;
 
    /* Economy is now deinitialized. */
    econ_initialized = 0;
@@ -602,6 +767,9 @@ static int economy_calcPrice( Planet *planet, Commodity *commodity, CommodityPri
    double base, scale, factor;
    const char *factionname;
 
+   /* Nothing cached for the new parameters. */
+   commodityPrice->cacheGen = 0;
+
    /* Check the faction is not NULL.*/
    if ( planet->faction == -1 ) {
       WARN(_("Planet '%s' appears to have commodity '%s' defined, but no faction."), planet->name, commodity->name);
@@ -839,6 +1007,7 @@ void economy_initialiseCommodityPrices(void)
    StarSystem *sys;
    Commodity *com;
    CommodityModifier *this, *next;
+   econ_priceGen++;
    /* First use planet attributes to set prices and variability */
    for (k=0; k<array_size(systems_stack); k++) {
       sys = &systems_stack[k];
@@ -898,6 +1067,7 @@ void economy_initialiseCommodityPrices(void)
 void economy_initialiseSingleSystem( StarSystem *sys, Planet *planet )
 {
    int i;
+   econ_priceGen++;
    for ( i=0; i<array_size(planet->commodities); i++ ) {
       economy_calcPrice(planet, planet->commodities[i], &planet->commodityPrice[i]);
    }
@@ -907,24 +1077,7 @@ void economy_initialiseSingleSystem( StarSystem *sys, Planet *planet )
 
 void economy_averageSeenPrices( const Planet *p )
 {
-   int i;
-   ntime_t t;
-   Commodity *c;
-   CommodityPrice *cp;
-   credits_t price;
-   t = ntime_get();
-   for ( i = 0; i < array_size(p->commodities); i++ ) {
-      c=p->commodities[i];
-      cp=&p->commodityPrice[i];
-      if ( cp->updateTime < t ) { /* has not yet been updated at present time. */
-         cp->updateTime = t;
-         /* Calculate values for mean and std */
-         cp->cnt++;
-         price = economy_getPrice(c, NULL, p);
-         cp->sum += price;
-         cp->sum2 += price*price;
-      }
-   }
+   economy_averageSeenPricesAtTime( p, ntime_get() );
 }
 
 
@@ -932,22 +1085,23 @@ void economy_averageSeenPricesAtTime( const Planet *p, const ntime_t tupdate )
 {
    int i;
    ntime_t t;
-   Commodity *c;
    CommodityPrice *cp;
-   credits_t price;
+   credits_t price, *prices;
    t = ntime_get();
+   prices = malloc( MAX( 1, array_size(p->commodities) ) * sizeof(credits_t) );
+   economy_getPricesAtTime( p, tupdate, prices );
    for ( i = 0; i < array_size(p->commodities); i++ ) {
-      c=p->commodities[i];
       cp=&p->commodityPrice[i];
       if ( cp->updateTime < t ) { /* has not yet been updated at present time. */
          cp->updateTime = t;
+         /* Calculate values for mean and std */
          cp->cnt++;
-         price = economy_getPriceAtTime(c, NULL, p, tupdate);
+         price = prices[i];
          cp->sum += price;
          cp->sum2 += price*price;
       }
    }
-
+   free( prices );
 }
 
 /**
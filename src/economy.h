@@ -33,6 +33,7 @@ void economy_averageSeenPrices( const Planet *p );
 void economy_averageSeenPricesAtTime( const Planet *p, const ntime_t tupdate );
 credits_t economy_getPrice( const Commodity *com, const StarSystem *sys, const Planet *p );
 credits_t economy_getPriceAtTime( const Commodity *com, const StarSystem *sys, const Planet *p, ntime_t t );
+void economy_getPricesAtTime( const Planet *p, ntime_t t, credits_t *prices );
 
 /*
  * Calculating the sinusoidal economy values
@@ -81,6 +81,10 @@ static void equipment_getDim( unsigned int wid, int *w, int *h,
       int *cw, int *ch, int *bw, int *bh );
 static void equipment_genShipList( unsigned int wid );
 static void equipment_genOutfitList( unsigned int wid );
+static int equipment_getOutfits( unsigned int wid, int active, Outfit ***outfits );
+static int equipment_updateShipCells( unsigned int wid );
+static int equipment_updateOutfitCells( unsigned int wid );
+static void equipment_shipCellLoad( ImageArrayCell *cell );
 /* Widget. */
 static void equipment_genLists( unsigned int wid );
 static void equipment_renderColumn( double x, double y, double w, double h,
@@ -778,7 +782,7 @@ static void equipment_renderOverlaySlots( double bx, double by, double bw, doubl
    }
 
    /* Get text. */
-   if (o->desc_short == NULL)
+   if (outfit_descShort(o) == NULL)
       return;
    outfit_altText( alt, sizeof(alt), o );
 
@@ -1140,6 +1144,21 @@ void equipment_regenLists( unsigned int wid, int outfits, int ships )
    /* Save focus. */
    focused = window_getFocus( wid );
 
+   /* Lists that still have the same cells are only updated. */
+   if (outfits && equipment_updateOutfitCells( wid )) {
+      outfits = 0;
+      equipment_updateOutfits( wid, NULL );
+   }
+   if (ships && equipment_updateShipCells( wid )) {
+      ships = 0;
+      equipment_updateShips( wid, NULL );
+   }
+   if (!outfits && !ships) {
+      window_setFocus( wid, focused );
+      free(focused);
+      return;
+   }
+
    /* Save positions. */
    if (outfits) {
       i = window_tabWinGetActive( wid, EQUIPMENT_OUTFIT_TAB );
@@ -1309,12 +1328,11 @@ static void equipment_genLists( unsigned int wid )
  */
 static void equipment_genShipList( unsigned int wid )
 {
-   int i, l;
+   int i;
    ImageArrayCell *cships;
    int nships;
    int w, h;
    int sw, sh;
-   Pilot *s;
    const PlayerShip_t *ps;
    char r[PATH_MAX];
    glTexture *t;
@@ -1357,17 +1375,9 @@ static void equipment_genShipList( unsigned int wid )
             }
          }
       }
-      /* Ship stats in alt text. */
-      for (i=0; i<nships; i++) {
-         s        = player_getShip( cships[i].caption );
-         cships[i].alt = malloc( STRMAX_SHORT );
-         l        = snprintf( &cships[i].alt[0], STRMAX_SHORT, _("Ship Stats\n") );
-         l        = equipment_shipStats( &cships[i].alt[0], STRMAX_SHORT-l, s, 1 );
-         if (l == 0) {
-            free( cships[i].alt );
-            cships[i].alt = NULL;
-         }
-      }
+      /* Ship stats in alt text, only once shown. */
+      for (i=0; i<nships; i++)
+         cships[i].load = equipment_shipCellLoad;
 
       /* Create the image array. */
       iconsize = 96;
@@ -1386,13 +1396,122 @@ static void equipment_genShipList( unsigned int wid )
 
 
 /**
- * @brief Generates the outfit list.
- *    @param wid Window to generate list on.
+ * @brief Fills in the ship stats of a ship list cell.
+ *
+ *    @param cell Cell to fill in, with the ship name as caption.
  */
-static void equipment_genOutfitList( unsigned int wid )
+static void equipment_shipCellLoad( ImageArrayCell *cell )
 {
-   int x, y, w, h, ow, oh;
-   int ix, iy, iw, ih, barw; /* Input filter. */
+   int l;
+   Pilot *s;
+
+   s = player_getShip( cell->caption );
+   if (s == NULL)
+      return;
+   cell->alt = malloc( STRMAX_SHORT );
+   l         = snprintf( &cell->alt[0], STRMAX_SHORT, _("Ship Stats\n") );
+   l         = equipment_shipStats( &cell->alt[0], STRMAX_SHORT-l, s, 1 );
+   if (l == 0) {
+      free( cell->alt );
+      cell->alt = NULL;
+   }
+}
+
+
+/**
+ * @brief Updates the ship list in place if it still holds the same ships.
+ *
+ * The ship stats are reloaded lazily as they may have changed.
+ *
+ *    @param wid Window containing the ship list.
+ *    @return 1 if the list was updated, 0 if it has to be regenerated.
+ */
+static int equipment_updateShipCells( unsigned int wid )
+{
+   int i, n, nships;
+   ImageArrayCell *cells;
+   const PlayerShip_t *ps;
+
+   cells = toolkit_getImageArrayCells( wid, EQUIPMENT_SHIPS, &n );
+   if (cells == NULL)
+      return 0;
+
+   /* Must be the same ships in the same order. */
+   nships = 0;
+   ps     = NULL;
+   if (planet_hasService(land_planet, PLANET_SERVICE_SHIPYARD)) {
+      player_shipsSort();
+      ps     = player_getShipStack();
+      nships = array_size(ps);
+   }
+   if (n != nships+1)
+      return 0;
+   if (strcmp( cells[0].caption, player.p->name ) != 0)
+      return 0;
+   for (i=1; i<n; i++)
+      if (strcmp( cells[i].caption, ps[i-1].p->name ) != 0)
+         return 0;
+
+   for (i=0; i<n; i++) {
+      free( cells[i].alt );
+      cells[i].alt  = NULL;
+      cells[i].load = equipment_shipCellLoad;
+   }
+   return 1;
+}
+
+
+/**
+ * @brief Updates the outfit list in place if it still holds the same outfits.
+ *
+ * Only the owned quantities change, for cells that are already loaded.
+ *
+ *    @param wid Window containing the outfit list.
+ *    @return 1 if the list was updated, 0 if it has to be regenerated.
+ */
+static int equipment_updateOutfitCells( unsigned int wid )
+{
+   int i, n, noutfits, active;
+   ImageArrayCell *cells;
+   Outfit **outfits;
+
+   cells = toolkit_getImageArrayCells( wid, EQUIPMENT_OUTFITS, &n );
+   if (cells == NULL)
+      return 0;
+
+   active   = window_tabWinGetActive( wid, EQUIPMENT_OUTFIT_TAB );
+   noutfits = equipment_getOutfits( wid, active, &outfits );
+   if (noutfits != n) {
+      free( outfits );
+      return 0;
+   }
+   for (i=0; i<n; i++) {
+      if (cells[i].data != outfits[i]) {
+         free( outfits );
+         return 0;
+      }
+   }
+
+   free( iar_outfits[active] );
+   iar_outfits[active] = outfits;
+   for (i=0; i<n; i++)
+      if (cells[i].load == NULL)
+         cells[i].quantity = player_outfitOwned( outfits[i] );
+   return 1;
+}
+
+
+/**
+ * @brief Gets the player's outfits to show in a tab of the outfit list.
+ *
+ *    @param wid Window containing the outfit list.
+ *    @param active Tab to get outfits of.
+ *    @param[out] outfits Outfits to show, must be freed.
+ *    @return Number of outfits.
+ */
+static int equipment_getOutfits( unsigned int wid, int active, Outfit ***outfits )
+{
+   int noutfits;
    char *filtertext;
    int (*tabfilters[])( const Outfit *o ) = {
       NULL,
@@ -1401,6 +1520,31 @@ static void equipment_genOutfitList( unsigned int wid )
       outfit_filterStructure,
       outfit_filterCore
    };
+
+   /* Allocate space. */
+   noutfits = MAX( 1, player_numOutfits() ); /* This is the most we'll need, probably less due to filtering. */
+   *outfits = calloc( noutfits, sizeof(Outfit*) );
+
+   filtertext = NULL;
+   if (widget_exists(wid, EQUIPMENT_FILTER)) {
+      filtertext = window_getInput( wid, EQUIPMENT_FILTER );
+      if (strlen(filtertext) == 0)
+         filtertext = NULL;
+   }
+
+   /* Get the outfits. */
+   return player_getOutfitsFiltered( *outfits, tabfilters[active], filtertext );
+}
+
+
+/**
+ * @brief Generates the outfit list.
+ *    @param wid Window to generate list on.
+ */
+static void equipment_genOutfitList( unsigned int wid )
+{
+   int x, y, w, h, ow, oh;
+   int ix, iy, iw, ih, barw; /* Input filter. */
    const char *tabnames[] = {
       _("All"), _(OUTFIT_LABEL_WEAPON), _(OUTFIT_LABEL_UTILITY), _(OUTFIT_LABEL_STRUCTURE), _(OUTFIT_LABEL_CORE)
    };
@@ -1447,20 +1591,9 @@ static void equipment_genOutfitList( unsigned int wid )
    if (widget_exists( wid, EQUIPMENT_OUTFITS ))
       return;
 
-   /* Allocate space. */
-   noutfits = MAX( 1, player_numOutfits() ); /* This is the most we'll need, probably less due to filtering. */
-   free( iar_outfits[active] );
-   iar_outfits[active] = calloc( noutfits, sizeof(Outfit*) );
-
-   filtertext = NULL;
-   if (widget_exists(equipment_wid, EQUIPMENT_FILTER)) {
-      filtertext = window_getInput( equipment_wid, EQUIPMENT_FILTER );
-      if (strlen(filtertext) == 0)
-         filtertext = NULL;
-   }
-
    /* Get the outfits. */
-   noutfits = player_getOutfitsFiltered( iar_outfits[active], tabfilters[active], filtertext );
+   free( iar_outfits[active] );
+   noutfits = equipment_getOutfits( equipment_wid, active, &iar_outfits[active] );
    coutfits = outfits_imageArrayCells( iar_outfits[active], &noutfits );
 
 
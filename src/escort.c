@@ -18,8 +18,6 @@
 #include "dialogue.h"
 #include "hook.h"
 #include "log.h"
-#include "nlua.h"
-#include "nluadef.h"
 #include "nstring.h"
 #include "player.h"
 
@@ -28,7 +26,7 @@
  * Prototypes.
  */
 /* Static */
-static int escort_command( Pilot *parent, const char *cmd, unsigned int index );
+static int escort_command( Pilot *parent, const char *cmd, unsigned int target, int jump );
 
 
 /**
@@ -174,27 +172,21 @@ unsigned int escort_create( Pilot *p, char *ship,
 /**
  * @brief Runs an escort command on all of a pilot's escorts.
  *
+ * The command is given once as an order of the parent, which the escorts
+ *  read from their AI.
+ *
  *    @param parent Pilot who is giving orders.
  *    @param cmd Order to give.
- *    @param idx Lua index of argument or 0.
+ *    @param target Pilot the order is about or 0.
+ *    @param jump Destination system ID of a jump order or -1.
  *    @return 0 on success, 1 if no orders given.
  */
-static int escort_command( Pilot *parent, const char *cmd, unsigned int idx )
+static int escort_command( Pilot *parent, const char *cmd, unsigned int target, int jump )
 {
-   int i;
-   Pilot *e;
-
    if (array_size(parent->escorts) == 0)
       return 1;
 
-   for (i=0; i<array_size(parent->escorts); i++) {
-      e = pilot_get( parent->escorts[i].id );
-      if (e == NULL) /* Most likely died. */
-         continue;
-
-      pilot_msg(parent, e, cmd, idx);
-   }
-
+   pilot_order( parent, cmd, target, jump );
    return 0;
 }
 
@@ -218,11 +210,8 @@ int escorts_attack( Pilot *parent )
 
    /* Send command. */
    ret = 1;
-   if (parent->target != parent->id) {
-      lua_pushpilot(naevL, parent->target);
-      ret = escort_command( parent, "e_attack", -1 );
-      lua_pop(naevL, 1);
-   }
+   if (parent->target != parent->id)
+      ret = escort_command( parent, "e_attack", parent->target, -1 );
    if ((ret == 0) && (parent == player.p))
       player_message(_("#gEscorts: #0Attacking %s."), t->name);
    return ret;
@@ -235,7 +224,7 @@ int escorts_attack( Pilot *parent )
 int escorts_hold( Pilot *parent )
 {
    int ret;
-   ret = escort_command( parent, "e_hold", 0 );
+   ret = escort_command( parent, "e_hold", 0, -1 );
    if ((ret == 0) && (parent == player.p))
          player_message(_("#gEscorts: #0Holding position."));
    return ret;
@@ -248,7 +237,7 @@ int escorts_hold( Pilot *parent )
 int escorts_return( Pilot *parent )
 {
    int ret;
-   ret = escort_command( parent, "e_return", 0 );
+   ret = escort_command( parent, "e_return", 0, -1 );
    if ((ret == 0) && (parent == player.p))
       player_message(_("#gEscorts: #0Returning to ship."));
    return ret;
@@ -261,7 +250,7 @@ int escorts_return( Pilot *parent )
 int escorts_clear( Pilot *parent )
 {
    int ret;
-   ret = escort_command( parent, "e_clear", 0 );
+   ret = escort_command( parent, "e_clear", 0, -1 );
    if ((ret == 0) && (parent == player.p))
       player_message(_("#gEscorts: #0Clearing orders."));
    return ret;
@@ -329,14 +318,8 @@ int escort_playerCommand( Pilot *e )
 int escorts_jump( Pilot *parent, JumpPoint *jp )
 {
    int ret;
-   LuaJump lj;
-
-   lj.destid = jp->targetid;
-   lj.srcid = cur_system->id;
 
-   lua_pushjump( naevL, lj );
-   ret = escort_command( parent, "hyperspace", -1 );
-   lua_pop(naevL, 1);
+   ret = escort_command( parent, "hyperspace", 0, jp->targetid );
 
    if ((ret == 0) && (parent == player.p))
       player_message(_("#gEscorts: #0Jumping."));
@@ -63,6 +63,7 @@ typedef struct EventData_ {
 
    EventTrigger_t trigger; /**< What triggers the event. */
    char *cond; /**< Conditional Lua code to execute. */
+   int cond_chunk; /**< Compiled cond, see cond_compile(). */
    double chance; /**< Chance of appearing. */
    int priority; /**< Event priority: 0 = main plot, 5 = default, 10 = insignificant. */
 } EventData;
@@ -72,6 +73,8 @@ typedef struct EventData_ {
  * Event data.
  */
 static EventData *event_data   = NULL; /**< Allocated event data. */
+#define EVENT_TRIGGERS  (EVENT_TRIGGER_LOAD+1) /**< Number of event triggers. */
+static int *event_byTrigger[EVENT_TRIGGERS]; /**< Events of each trigger in priority order (array.h). */
 
 
 /*
@@ -90,6 +93,8 @@ static int event_parseFile( const char* file );
 static int event_parseXML( EventData *temp, const xmlNodePtr parent );
 static void event_freeData( EventData *event );
 static int event_create( int dataid, unsigned int *id );
+static int event_loadEnv( Event_t *ev );
+static void event_rest( Event_t *ev );
 int events_saveActive( xmlTextWriterPtr writer );
 int events_loadActive( xmlNodePtr parent );
 static int events_parseActive( xmlNodePtr parent );
@@ -246,7 +251,6 @@ static unsigned int event_genID (void)
 static int event_create( int dataid, unsigned int *id )
 {
    Event_t *ev;
-   EventData *data;
 
    if (event_active==NULL)
       event_active = array_create( Event_t );
@@ -261,9 +265,31 @@ static int event_create( int dataid, unsigned int *id )
 
    /* Add the data. */
    ev->data = dataid;
-   data = &event_data[dataid];
 
    /* Open the new state. */
+   if (event_loadEnv( ev ) != 0)
+      return -1;
+
+   /* Run Lua. */
+   if ((id==NULL) || (*id==0))
+      event_runLua( ev, "create" );
+   if (id != NULL)
+      *id = ev->id;
+
+   return 0;
+}
+
+
+/**
+ * @brief Creates the Lua environment of an event and loads its code.
+ *
+ *    @param ev Event to load the code of.
+ *    @return 0 on success.
+ */
+static int event_loadEnv( Event_t *ev )
+{
+   EventData *data = &event_data[ ev->data ];
+
    ev->env = nlua_newEnv(1);
    nlua_loadStandard(ev->env);
    nlua_loadEvt(ev->env);
@@ -284,16 +310,80 @@ static int event_create( int dataid, unsigned int *id )
       return -1;
    }
 
-   /* Run Lua. */
-   if ((id==NULL) || (*id==0))
-      event_runLua( ev, "create" );
-   if (id != NULL)
-      *id = ev->id;
-
    return 0;
 }
 
 
+/**
+ * @brief Frees the Lua environment of an event until it is needed again.
+ *
+ * Same as mission_rest(), the event wakes as if loaded from a save.
+ *
+ *    @param ev Event to rest.
+ */
+static void event_rest( Event_t *ev )
+{
+   xmlDocPtr doc;
+
+   doc = nxml_persistLuaDoc( ev->env );
+   if (doc == NULL)
+      return;
+
+   nlua_freeEnv( ev->env );
+   ev->env  = LUA_NOREF;
+   ev->rest = doc;
+}
+
+
+/**
+ * @brief Recreates the Lua environment of a resting event.
+ *
+ *    @param ev Event to wake, nothing is done if it isn't resting.
+ *    @return 0 on success.
+ */
+int event_wake( Event_t *ev )
+{
+   int ret;
+
+   ev->busy = 1;
+   if (ev->rest == NULL)
+      return 0;
+
+   ret = event_loadEnv( ev );
+   if (ret == 0)
+      nxml_unpersistLua( ev->env, xmlDocGetRootElement( ev->rest ) );
+   xmlFreeDoc( ev->rest );
+   ev->rest = NULL;
+   return ret;
+}
+
+
+/**
+ * @brief Lets the saved events that haven't run since the last call and only
+ *        wait on hooks that run seldom rest.
+ *
+ * Events that aren't saved may keep data that wouldn't survive, so they
+ *  never rest.
+ */
+void events_rest (void)
+{
+   int i;
+   Event_t *ev;
+
+   for (i=0; i<array_size(event_active); i++) {
+      ev = &event_active[i];
+      if (!ev->save || (ev->rest != NULL))
+         continue;
+      if (ev->busy) {
+         ev->busy = 0;
+         continue;
+      }
+      if (hook_restEventParent( ev->id ))
+         event_rest( ev );
+   }
+}
+
+
 /**
  * @brief Cleans up an event.
  *
@@ -302,7 +392,10 @@ static int event_create( int dataid, unsigned int *id )
 static void event_cleanup( Event_t *ev )
 {
    /* Free lua env. */
-   nlua_freeEnv(ev->env);
+   if (ev->env != LUA_NOREF)
+      nlua_freeEnv(ev->env);
+   if (ev->rest != NULL)
+      xmlFreeDoc(ev->rest);
 
    /* Free hooks. */
    hook_rmEventParent(ev->id);
@@ -384,14 +477,17 @@ int event_alreadyRunning( int data )
  */
 void events_trigger( EventTrigger_t trigger )
 {
-   int i, c;
+   int i, j, c;
    int created;
+   const int *list;
+
+   if ((trigger < 0) || (trigger >= EVENT_TRIGGERS))
+      return;
 
    created = 0;
-   for (i=0; i<array_size(event_data); i++) {
-      /* Make sure trigger matches. */
-      if (event_data[i].trigger != trigger)
-         continue;
+   list    = event_byTrigger[ trigger ];
+   for (j=0; j<array_size(list); j++) {
+      i = list[j];
 
       /* Make sure chance is succeeded. */
       if (RNGF() > event_data[i].chance)
@@ -404,7 +500,7 @@ void events_trigger( EventTrigger_t trigger )
 
       /* Test conditional. */
       if (event_data[i].cond != NULL) {
-         c = cond_check(event_data[i].cond);
+         c = cond_checkChunk(event_data[i].cond_chunk);
          if (c<0) {
             WARN(_("Conditional for event '%s' failed to run."), event_data[i].name);
             continue;
@@ -507,6 +603,11 @@ static int event_parseXML( EventData *temp, const xmlNodePtr parent )
    MELEMENT(temp->trigger==EVENT_TRIGGER_NULL,"trigger");
 #undef MELEMENT
 
+   /* Compile the condition once, it gets checked often. */
+   temp->cond_chunk = LUA_NOREF;
+   if (temp->cond != NULL)
+      temp->cond_chunk = cond_compile( temp->cond );
+
    return 0;
 }
 
@@ -547,6 +648,13 @@ int events_load (void)
    /* Sort based on priority so higher priority missions can establish claims first. */
    qsort( event_data, array_size(event_data), sizeof(EventData), event_cmp );
 
+   /* Index by trigger so triggering only looks at the candidates. */
+   for (i=0; i<EVENT_TRIGGERS; i++)
+      event_byTrigger[i] = array_create( int );
+   for (i=0; i<array_size(event_data); i++)
+      if ((event_data[i].trigger >= 0) && (event_data[i].trigger < EVENT_TRIGGERS))
+         array_push_back( &event_byTrigger[ event_data[i].trigger ], i );
+
    DEBUG( n_("Loaded %d Event", "Loaded %d Events", array_size(event_data) ), array_size(event_data) );
 
    return 0;
@@ -644,6 +752,7 @@ static void event_freeData( EventData *event )
    free( event->lua );
    free( event->sourcefile );
    free( event->cond );
+   cond_free( event->cond_chunk );
 #if DEBUGGING
    memset( event, 0, sizeof(EventData) );
 #endif /* DEBUGGING */
@@ -675,6 +784,10 @@ void events_exit (void)
    events_cleanup();
 
    /* Free data. */
+   for (i=0; i<EVENT_TRIGGERS; i++) {
+      array_free( event_byTrigger[i] );
+      event_byTrigger[i] = NULL;
+   }
    for (i=0; i<array_size(event_data); i++)
       event_freeData( &event_data[i] );
    array_free(event_data);
@@ -796,7 +909,10 @@ int events_saveActive( xmlTextWriterPtr writer )
 
       /* Write Lua magic */
       xmlw_startElem(writer,"lua");
-      nxml_persistLua( ev->env, writer );
+      if (ev->rest != NULL)
+         nxml_writeLuaDoc( ev->rest, writer );
+      else
+         nxml_persistLua( ev->env, writer );
       xmlw_endElem(writer); /* "lua" */
 
       xmlw_endElem(writer); /* "event" */
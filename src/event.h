@@ -9,6 +9,7 @@
 
 #include "claim.h"
 #include "nlua.h"
+#include "nxml.h"
 
 
 /**
@@ -17,7 +18,9 @@
 typedef struct Event_s {
    unsigned int id; /**< Event ID. */
    int data; /**< EventData parent. */
-   nlua_env env; /**< The environment of the running Lua code. */
+   nlua_env env; /**< The environment of the running Lua code, LUA_NOREF while resting. */
+   xmlDocPtr rest; /**< Persisted Lua data while resting, see event_wake(). */
+   int busy; /**< Ran since the last look for events that can rest. */
    int save; /**< Whether or not it should be saved. */
    Claim_t *claims; /**< Event claims. */
 } Event_t;
@@ -58,6 +61,13 @@ void events_trigger( EventTrigger_t trigger );
  * Handling.
  */
 Event_t *event_get( unsigned int eventid );
+
+
+/*
+ * Resting.
+ */
+void events_rest (void);
+int event_wake( Event_t *ev );
 void event_remove( unsigned int eventid );
 int event_save( unsigned int eventid );
 const char *event_getData( unsigned int eventid );
@@ -11,7 +11,9 @@
 
 /** @cond */
 #include <assert.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "naev.h"
 /** @endcond */
@@ -30,6 +32,7 @@
 #include "opengl.h"
 #include "rng.h"
 #include "space.h"
+#include "strindex.h"
 
 
 #define XML_FACTION_ID     "Factions"   /**< XML section identifier */
@@ -46,6 +49,10 @@
 #define faction_isFlag(fa,f)  ((fa)->flags & (f))
 #define faction_isKnown_(fa)   ((fa)->flags & (FACTION_KNOWN))
 
+#define FACTION_REL_ENEMY     0 /**< Enemy relation matrix. */
+#define FACTION_REL_ALLY      1 /**< Ally relation matrix. */
+#define FACTION_REL_BITS      32 /**< Bits per word of the relation matrices. */
+
 /**
  * @struct Faction
  *
@@ -87,6 +94,23 @@ typedef struct Faction_ {
 } Faction;
 
 static Faction* faction_stack = NULL; /**< Faction stack. */
+static StrIndex faction_index; /**< Factions by name. */
+static unsigned int faction_relations = 0; /**< Changes whenever relations between factions change. */
+static uint32_t *faction_rel[2] = { NULL, NULL }; /**< Bit matrices of relations between factions. */
+static int faction_relSize  = 0; /**< Number of factions in the relation matrices. */
+static int faction_relWords = 0; /**< Words per row of the relation matrices. */
+
+
+/**
+ * @brief Standing change waiting for factions_modPlayerFlush().
+ */
+typedef struct FactionMod_ {
+   int f; /**< Faction whose standing changes. */
+   double mod; /**< Sum of the modifiers. */
+   const char *source; /**< Source of the modifiers, must stay valid. */
+   int secondary; /**< Whether it comes from an ally or enemy. */
+} FactionMod;
+static FactionMod *faction_queue = NULL; /**< Queued standing changes (array.h). */
 
 
 /*
@@ -94,11 +118,23 @@ static Faction* faction_stack = NULL; /**< Faction stack. */
  */
 /* static */
 static int faction_getRaw( const char *name );
+static void faction_indexBuild (void);
 static void faction_freeOne( Faction *f );
 static void faction_sanitizePlayer( Faction* faction );
+static int faction_hitLua( int f, double mod, const char *source, int secondary );
 static void faction_modPlayerLua( int f, double mod, const char *source, int secondary );
+static void faction_standingChanged( int f, double delta );
+static void faction_queueAdd( int f, double mod, const char *source, int secondary );
 static int faction_parse( Faction* temp, xmlNodePtr parent );
 static void faction_parseSocial( xmlNodePtr parent );
+/* relations */
+static int faction_areEnemiesRaw( int a, int b );
+static int faction_areAlliesRaw( int a, int b );
+static void faction_relSet( int rel, int a, int b, int value );
+static void faction_relUpdate( int a, int b );
+static void faction_relUpdatePlayer (void);
+static void faction_relBuild (void);
+static void faction_relFree (void);
 /* externed */
 int pfaction_save( xmlTextWriterPtr writer );
 int pfaction_load( xmlNodePtr parent );
@@ -112,20 +148,157 @@ int pfaction_load( xmlNodePtr parent );
  */
 static int faction_getRaw( const char* name )
 {
-   int i;
    /* Escorts are part of the "player" faction. */
    if (strcmp(name, "Escort") == 0)
       return FACTION_PLAYER;
 
-   if (name != NULL) {
-      for (i=0; i<array_size(faction_stack); i++)
-         if (strcmp(faction_stack[i].name, name)==0)
-            break;
+   return strindex_get( &faction_index, name );
+}
+
+
+/**
+ * @brief Rebuilds the index of factions by name.
+ */
+static void faction_indexBuild (void)
+{
+   int i;
+
+   strindex_clear( &faction_index );
+   for (i=0; i<array_size(faction_stack); i++)
+      strindex_add( &faction_index, faction_stack[i].name, i );
+}
+
+
+/**
+ * @brief Checks whether two factions are enemies.
+ *
+ *    @param a Faction A.
+ *    @param b Faction B.
+ *    @return 1 if A and B are enemies, 0 otherwise.
+ */
+int areEnemies( int a, int b )
+{
+   if (a==b) return 0; /* luckily our factions aren't masochistic */
+
+   if (!faction_isFaction(a) || !faction_isFaction(b))
+      return 0;
+
+   /* Not in the matrix yet. */
+   if ((a >= faction_relSize) || (b >= faction_relSize))
+      return faction_areEnemiesRaw( a, b );
+
+   return (faction_rel[FACTION_REL_ENEMY][ a*faction_relWords + b/FACTION_REL_BITS ]
+         >> (b % FACTION_REL_BITS)) & 1;
+}
+
+
+/**
+ * @brief Checks whether two factions are allies or not.
+ *
+ *    @param a Faction A.
+ *    @param b Faction B.
+ *    @return 1 if A and B are allies, 0 otherwise.
+ */
+int areAllies( int a, int b )
+{
+   /* If they are the same they must be allies. */
+   if (a==b) return 1;
+
+   if (!faction_isFaction(a) || !faction_isFaction(b))
+      return 0;
+
+   /* Not in the matrix yet. */
+   if ((a >= faction_relSize) || (b >= faction_relSize))
+      return faction_areAlliesRaw( a, b );
 
-      if (i != array_size(faction_stack))
-         return i;
+   return (faction_rel[FACTION_REL_ALLY][ a*faction_relWords + b/FACTION_REL_BITS ]
+         >> (b % FACTION_REL_BITS)) & 1;
+}
+
+
+/**
+ * @brief Sets a relation between two factions in a relation matrix.
+ */
+static void faction_relSet( int rel, int a, int b, int value )
+{
+   uint32_t *wa, *wb;
+
+   wa = &faction_rel[rel][ a*faction_relWords + b/FACTION_REL_BITS ];
+   wb = &faction_rel[rel][ b*faction_relWords + a/FACTION_REL_BITS ];
+   if (value) {
+      *wa |= (uint32_t)1 << (b % FACTION_REL_BITS);
+      *wb |= (uint32_t)1 << (a % FACTION_REL_BITS);
+   }
+   else {
+      *wa &= ~((uint32_t)1 << (b % FACTION_REL_BITS));
+      *wb &= ~((uint32_t)1 << (a % FACTION_REL_BITS));
+   }
+}
+
+
+/**
+ * @brief Updates the relations between two factions in the relation matrices.
+ *
+ *    @param a Faction A.
+ *    @param b Faction B.
+ */
+static void faction_relUpdate( int a, int b )
+{
+   faction_relations++;
+
+   if ((a == b) || (a >= faction_relSize) || (b >= faction_relSize))
+      return;
+
+   faction_relSet( FACTION_REL_ENEMY, a, b, faction_areEnemiesRaw( a, b ) );
+   faction_relSet( FACTION_REL_ALLY, a, b, faction_areAlliesRaw( a, b ) );
+}
+
+
+/**
+ * @brief Updates the relations of every faction with the player.
+ */
+static void faction_relUpdatePlayer (void)
+{
+   int i;
+   for (i=0; i<array_size(faction_stack); i++)
+      faction_relUpdate( FACTION_PLAYER, i );
+}
+
+
+/**
+ * @brief Builds the relation matrices from scratch.
+ */
+static void faction_relBuild (void)
+{
+   int i, j, n;
+
+   faction_relFree();
+
+   n = array_size(faction_stack);
+   faction_relWords = (n + FACTION_REL_BITS - 1) / FACTION_REL_BITS;
+   for (i=0; i<2; i++)
+      faction_rel[i] = calloc( n * faction_relWords, sizeof(uint32_t) );
+   faction_relSize = n;
+
+   for (i=0; i<n; i++)
+      for (j=i+1; j<n; j++)
+         faction_relUpdate( i, j );
+}
+
+
+/**
+ * @brief Frees the relation matrices.
+ */
+static void faction_relFree (void)
+{
+   int i;
+   for (i=0; i<2; i++) {
+      free( faction_rel[i] );
+      faction_rel[i] = NULL;
    }
-   return -1;
+   faction_relSize  = 0;
+   faction_relWords = 0;
+   faction_relations++;
 }
 
 
@@ -500,6 +673,7 @@ void faction_addEnemy( int f, int o )
 
    tmp = &array_grow( &ff->enemies );
    *tmp = o;
+   faction_relUpdate( f, o );
 }
 
 
@@ -526,6 +700,7 @@ void faction_rmEnemy( int f, int o )
    for (i=0;i<array_size(ff->enemies);i++) {
       if (ff->enemies[i] == o) {
          array_erase( &ff->enemies, &ff->enemies[i], &ff->enemies[i+1] );
+         faction_relUpdate( f, o );
          return;
       }
    }
@@ -574,6 +749,7 @@ void faction_addAlly( int f, int o )
 
    tmp = &array_grow( &ff->allies );
    *tmp = o;
+   faction_relUpdate( f, o );
 }
 
 
@@ -600,6 +776,7 @@ void faction_rmAlly( int f, int o )
    for (i=0;i<array_size(ff->allies);i++) {
       if (ff->allies[i] == o) {
          array_erase( &ff->allies, &ff->allies[i], &ff->allies[i+1] );
+         faction_relUpdate( f, o );
          return;
       }
    }
@@ -645,25 +822,26 @@ static void faction_sanitizePlayer( Faction* faction )
       faction->player = 100.;
    else if (faction->player < -100.)
       faction->player = -100.;
+
+   /* Standing may change whether or not the player is an enemy. */
+   faction_relUpdate( FACTION_PLAYER, faction - faction_stack );
 }
 
 
 /**
- * @brief Mods player using the power of Lua.
+ * @brief Changes the player's standing through the faction's Lua, without running hooks.
+ *
+ *    @return 0 if the standing was changed.
  */
-static void faction_modPlayerLua( int f, double mod, const char *source, int secondary )
+static int faction_hitLua( int f, double mod, const char *source, int secondary )
 {
    Faction *faction;
-   double old, delta;
-   HookParam hparam[3];
 
    faction = &faction_stack[f];
 
    /* Make sure it's not static. */
    if (faction_isFlag(faction, FACTION_STATIC))
-      return;
-
-   old   = faction->player;
+      return -1;
 
    if (faction->env == LUA_NOREF)
       faction->player += mod;
@@ -681,7 +859,7 @@ static void faction_modPlayerLua( int f, double mod, const char *source, int sec
       if (nlua_pcall( faction->env, 4, 1 )) { /* An error occurred. */
          WARN(_("Faction '%s': %s"), faction->name, lua_tostring(naevL,-1));
          lua_pop( naevL, 1 );
-         return;
+         return -1;
       }
 
       /* Parse return. */
@@ -694,20 +872,44 @@ static void faction_modPlayerLua( int f, double mod, const char *source, int sec
 
    /* Sanitize just in case. */
    faction_sanitizePlayer( faction );
+   return 0;
+}
 
-   /* Run hook if necessary. */
-   delta = faction->player - old;
-   if (FABS(delta) > 1e-10) {
-      hparam[0].type    = HOOK_PARAM_FACTION;
-      hparam[0].u.lf    = f;
-      hparam[1].type    = HOOK_PARAM_NUMBER;
-      hparam[1].u.num   = delta;
-      hparam[2].type    = HOOK_PARAM_SENTINEL;
-      hooks_runParam( "standing", hparam );
-
-      /* Tell space the faction changed. */
-      space_factionChange();
-   }
+
+/**
+ * @brief Runs the standing hooks if the player's standing changed.
+ *
+ *    @param f Faction whose standing changed.
+ *    @param delta Change of the standing.
+ */
+static void faction_standingChanged( int f, double delta )
+{
+   HookParam hparam[3];
+
+   if (FABS(delta) <= 1e-10)
+      return;
+
+   hparam[0].type    = HOOK_PARAM_FACTION;
+   hparam[0].u.lf    = f;
+   hparam[1].type    = HOOK_PARAM_NUMBER;
+   hparam[1].u.num   = delta;
+   hparam[2].type    = HOOK_PARAM_SENTINEL;
+   hooks_runParam( "standing", hparam );
+
+   /* Tell space the faction changed. */
+   space_factionChange();
+}
+
+
+/**
+ * @brief Mods player using the power of Lua.
+ */
+static void faction_modPlayerLua( int f, double mod, const char *source, int secondary )
+{
+   double old = faction_stack[f].player;
+
+   if (faction_hitLua( f, mod, source, secondary ) == 0)
+      faction_standingChanged( f, faction_stack[f].player - old );
 }
 
 
@@ -751,6 +953,105 @@ void faction_modPlayer( int f, double mod, const char *source )
       faction_modPlayerLua( faction->enemies[i], -mod, source, 1 );
 }
 
+/**
+ * @brief Adds a standing change to the queue, summing it with a matching one.
+ */
+static void faction_queueAdd( int f, double mod, const char *source, int secondary )
+{
+   int i;
+   FactionMod *fm;
+
+   if (faction_queue == NULL)
+      faction_queue = array_create( FactionMod );
+
+   for (i=0; i<array_size(faction_queue); i++) {
+      fm = &faction_queue[i];
+      if ((fm->f == f) && (fm->secondary == secondary)
+            && (strcmp( fm->source, source ) == 0)) {
+         fm->mod += mod;
+         return;
+      }
+   }
+
+   fm = &array_grow( &faction_queue );
+   fm->f         = f;
+   fm->mod       = mod;
+   fm->source    = source;
+   fm->secondary = secondary;
+}
+
+
+/**
+ * @brief Modifies the player's standing with a faction at the end of the frame.
+ *
+ * Same as faction_modPlayer(), except the changes of a frame are summed for
+ *  each faction and source, so the Lua of each faction and the standing
+ *  hooks run at most once per faction in factions_modPlayerFlush(). Meant
+ *  for changes that can pile up during fights.
+ *
+ *    @param f Faction to modify player's standing.
+ *    @param mod Modifier to modify by.
+ *    @param source Source of the faction modifier, must stay valid until flushed.
+ */
+void faction_modPlayerQueue( int f, double mod, const char *source )
+{
+   int i;
+   Faction *faction;
+
+   if (!faction_isFaction(f)) {
+      WARN(_("Faction id '%d' is invalid."), f);
+      return;
+   }
+   faction = &faction_stack[f];
+
+   faction_queueAdd( f, mod, source, 0 );
+   for (i=0; i<array_size(faction->allies); i++)
+      faction_queueAdd( faction->allies[i], mod, source, 1 );
+   for (i=0; i<array_size(faction->enemies); i++)
+      faction_queueAdd( faction->enemies[i], -mod, source, 1 );
+}
+
+
+/**
+ * @brief Applies the standing changes queued by faction_modPlayerQueue().
+ */
+void factions_modPlayerFlush (void)
+{
+   int i, j, n, *fs;
+   double *old;
+   FactionMod *fm;
+
+   n = array_size( faction_queue );
+   if (n == 0)
+      return;
+
+   /* Standing before any of the changes. */
+   fs  = malloc( n * sizeof(int) );
+   old = malloc( n * sizeof(double) );
+   for (i=0; i<n; i++) {
+      fs[i]  = faction_queue[i].f;
+      old[i] = faction_stack[ fs[i] ].player;
+   }
+
+   for (i=0; i<n; i++) {
+      fm = &faction_queue[i];
+      faction_hitLua( fm->f, fm->mod, fm->source, fm->secondary );
+   }
+
+   /* Hooks once per faction, they may queue more changes. */
+   array_resize( &faction_queue, 0 );
+   for (i=0; i<n; i++) {
+      for (j=0; j<i; j++)
+         if (fs[j] == fs[i])
+            break;
+      if (j == i)
+         faction_standingChanged( fs[i], faction_stack[ fs[i] ].player - old[i] );
+   }
+   free( fs );
+   free( old );
+}
+
+
 /**
  * @brief Modifies the player's standing without affecting others.
  *
@@ -1121,13 +1422,13 @@ const char *faction_getStandingBroad( int f, int bribed, int override )
 
 
 /**
- * @brief Checks whether two factions are enemies.
+ * @brief Checks whether two factions are enemies without the relation matrix.
  *
  *    @param a Faction A.
  *    @param b Faction B.
  *    @return 1 if A and B are enemies, 0 otherwise.
  */
-int areEnemies( int a, int b )
+static int faction_areEnemiesRaw( int a, int b )
 {
    Faction *fa, *fb;
    int i;
@@ -1170,13 +1471,26 @@ int areEnemies( int a, int b )
 
 
 /**
- * @brief Checks whether two factions are allies or not.
+ * @brief Gets a counter that changes whenever relations between factions change.
+ *
+ * Allows caching the results of areEnemies() and areAllies().
+ *
+ *    @return The current relations counter.
+ */
+unsigned int faction_relationsVersion (void)
+{
+   return faction_relations;
+}
+
+
+/**
+ * @brief Checks whether two factions are allies without the relation matrix.
  *
  *    @param a Faction A.
  *    @param b Faction B.
  *    @return 1 if A and B are allies, 0 otherwise.
  */
-int areAllies( int a, int b )
+static int faction_areAlliesRaw( int a, int b )
 {
    Faction *fa, *fb;
    int i;
@@ -1459,6 +1773,11 @@ void factions_reset (void)
       faction_stack[i].player = faction_stack[i].player_def;
       faction_stack[i].flags = faction_stack[i].oflags;
    }
+   faction_relUpdatePlayer();
+
+   /* Changes from the previous game don't apply. */
+   if (faction_queue != NULL)
+      array_resize( &faction_queue, 0 );
 }
 
 
@@ -1514,6 +1833,7 @@ int factions_load (void)
          f->oflags = f->flags;
       }
    } while (xml_nextNode(node));
+   faction_indexBuild();
 
    /* Second pass - sets allies and enemies */
    node = factions;
@@ -1560,6 +1880,9 @@ int factions_load (void)
 
    xmlFreeDoc(doc);
 
+   /* Cache all the relations. */
+   faction_relBuild();
+
    DEBUG( n_( "Loaded %d Faction", "Loaded %d Factions", array_size(faction_stack) ), array_size(faction_stack) );
 
    return 0;
@@ -1600,6 +1923,10 @@ void factions_free (void)
       faction_freeOne( &faction_stack[i] );
    array_free(faction_stack);
    faction_stack = NULL;
+   strindex_free( &faction_index );
+   faction_relFree();
+   array_free( faction_queue );
+   faction_queue = NULL;
 }
 
 
@@ -1681,6 +2008,7 @@ int pfaction_load( xmlNodePtr parent )
       }
    } while (xml_nextNode(node));
 
+   faction_relUpdatePlayer();
    return 0;
 }
 
@@ -1742,6 +2070,10 @@ void factions_clearDynamic (void)
          i--;
       }
    }
+
+   /* Faction ids past the first dynamic one have changed. */
+   faction_indexBuild();
+   faction_relBuild();
 }
 
 
@@ -1796,5 +2128,9 @@ int faction_dynAdd( int base, const char* name, const char* display, const char*
       f->equip_env = bf->equip_env;
    }
 
+   /* The matrix has to grow. */
+   strindex_add( &faction_index, f->name, f-faction_stack );
+   faction_relBuild();
+
    return f-faction_stack;
 }
@@ -49,6 +49,8 @@ int faction_setKnown( int id, int state );
 void faction_modPlayer( int f, double mod, const char *source );
 void faction_modPlayerSingle( int f, double mod, const char *source );
 void faction_modPlayerRaw( int f, double mod );
+void faction_modPlayerQueue( int f, double mod, const char *source );
+void factions_modPlayerFlush (void);
 void faction_setPlayer( int f, double value );
 double faction_getPlayer( int f );
 double faction_getPlayerDef( int f );
@@ -62,6 +64,7 @@ char faction_getColourChar( int f );
 /* works with only factions */
 int areEnemies( int a, int b );
 int areAllies( int a, int b );
+unsigned int faction_relationsVersion (void);
 
 /* load/free */
 int factions_load (void);
@@ -43,6 +43,24 @@ static int nfleets = 0; /**< Number of fleets. */
 static int fleet_parse( Fleet *temp, const xmlNodePtr parent );
 
 
+/**
+ * @brief Starts loading the graphics of the ships a faction flies in the background.
+ *
+ *    @param faction Faction expected to show up.
+ */
+void fleet_prefetch( int faction )
+{
+   int i, j;
+
+   for (i=0; i<nfleets; i++) {
+      if (fleet_stack[i].faction != faction)
+         continue;
+      for (j=0; j<fleet_stack[i].npilots; j++)
+         ship_gfxPrefetch( fleet_stack[i].pilots[j].ship );
+   }
+}
+
+
 /**
  * @brief Grabs a fleet out of the stack.
  *
@@ -128,7 +146,7 @@ static int fleet_parse( Fleet *temp, const xmlNodePtr parent )
 
       /* Set AI. */
       xmlr_strd(node,"ai",temp->ai);
-      if (ai_getProfile ( temp->ai ) == NULL)
+      if (!ai_profileExists( temp->ai ))
          WARN(_("Fleet '%s' has invalid AI '%s'."), temp->name, temp->ai );
 
       /* Set flags. */
@@ -45,6 +45,7 @@ typedef struct Fleet_ {
  * getting fleet stuff
  */
 Fleet* fleet_get( const char* name );
+void fleet_prefetch( int faction );
 
 
 /*
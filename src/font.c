@@ -10,6 +10,15 @@
  * We use distance fields [1] to render high quality fonts with the help of
  * some shaders. Characters are generated on demand using a texture atlas.
  *
+ * Distance fields scale well, so glyphs are always generated at
+ * FONT_DISTANCE_FIELD_SIZE and a single atlas is shared by all the sizes of a
+ * list of font files. The spread of the field is wide enough for the outline
+ * of the smallest sizes, and the shader gets told how many pixels a unit of
+ * the field is for the size being drawn. Computing the distance field is the
+ * slow part, so it is done by the threadpool and the glyph is uploaded and
+ * drawn as soon as it is done, while FreeType stays on the main thread since
+ * faces can't be used from several threads.
+ *
  * [1]: https://steamcdn-a.akamaihd.net/apps/valve/2007/SIGGRAPH2007_AlphaTestedMagnification.pdf
  */
 
@@ -20,6 +29,8 @@
 #include FT_GLYPH_H
 #include FT_MODULE_H
 
+#include "SDL.h"
+
 #include "naev.h"
 /** @endcond */
 
@@ -31,14 +42,24 @@
 #include "log.h"
 #include "ndata.h"
 #include "nfile.h"
+#include "threadpool.h"
 #include "utf8.h"
 
 
 #define MAX_EFFECT_RADIUS 2 /**< Maximum pixel distance from glyph to outline/shadow/etc. */
 #define FONT_DISTANCE_FIELD_SIZE   55 /**< Size to render the fonts at. */
+#define FONT_SDF_SIZE_MIN 10 /**< Smallest size the distance field spread has room for the effects of. */
 #define HASH_LUT_SIZE 512 /**< Size of glyph look up table. */
 #define DEFAULT_TEXTURE_SIZE 1024 /**< Default size of texture caches for glyphs. */
 #define MAX_ROWS 64 /**< Max number of rows per texture cache. */
+#define FONT_BATCH_FLOATS 13 /**< Floats per glyph vertex (position, texture, colour, outline and field scale). */
+#define FONT_BATCH_QUADS 1024 /**< Maximum glyphs per batch. */
+#define FONT_LAYOUT_BUCKETS 1024 /**< Buckets of the text layout cache, power of two. */
+#define FONT_LAYOUT_MAX 4096 /**< Layouts to keep before clearing the cache. */
+
+#define FONT_LAYOUT_WIDTH (1<<0) /**< Width of the whole text is computed. */
+#define FONT_LAYOUT_LINES (1<<1) /**< Line breaks and height are computed. */
+#define FONT_LAYOUT_LIMIT (1<<2) /**< Truncation to the width is computed. */
 
 
 /**
@@ -49,7 +70,7 @@ static gl_Matrix4 font_projection_mat; /**< Projection matrix. */
 static FT_Library font_library = NULL; /**< Global, reference-counted FreeType library. */
 static int        font_library_refs = 0; /**< Our refcount for font_library, because FreeType inexplicably hides its own. */
 static FT_UInt    prev_glyph_index; /**< Index of last character drawn (for kerning). */
-static int        prev_glyph_ft_index; /**< HACK: Index into which stsh->ft[_].face? */
+static int        prev_glyph_ft_index; /**< HACK: Index into which atlas->ft[_].face? */
 
 
 /**
@@ -76,9 +97,10 @@ typedef struct glFontTex_s {
  */
 typedef struct glFontGlyph_s {
    uint32_t codepoint; /**< Real character. */
-   GLfloat adv_x; /**< X advancement on the screen. */
+   GLfloat adv_x; /**< X advancement at FONT_DISTANCE_FIELD_SIZE. */
    int ft_index; /**< HACK: Index into the array of fallback fonts. */
-   int tex_index; /**< Might be on different texture. */
+   FT_UInt ft_glyph; /**< Index of the glyph in the face of ft_index, for kerning. */
+   int tex_index; /**< Might be on different texture, -1 while being generated. */
    GLushort vbo_id; /**< VBO index to use. */
    int next; /**< Stored as a linked list. */
 } glFontGlyph;
@@ -90,12 +112,13 @@ typedef struct glFontGlyph_s {
 typedef struct font_char_s {
    GLubyte *data; /**< Data of the character. */
    GLfloat *dataf; /**< Float data of the character. */
+   int sdf; /**< Whether data still has to be turned into a distance field. */
    int w; /**< Width. */
    int h; /**< Height. */
    int ft_index; /**< HACK: Index into the array of fallback fonts. */
    int off_x; /**< X offset when rendering. */
    int off_y; /**< Y offset when rendering. */
-   GLfloat adv_x; /**< X advancement on the screen. */
+   GLfloat adv_x; /**< X advancement at FONT_DISTANCE_FIELD_SIZE. */
    int tx; /**< Texture x position. */
    int ty; /**< Texture y position. */
    int tw; /**< Texture width. */
@@ -124,38 +147,87 @@ typedef struct glFontStashFreetype_s {
 
 
 /**
- * @brief Font structure.
+ * @brief Glyph atlas, shared by all the sizes of a list of font files.
  */
-typedef struct glFontStash_s {
-   /* Core values (determine font). */
-   char *fname; /**< Font list name. */
+typedef struct glFontAtlas_s {
+   char *fname; /**< Comma separated paths of the font files. */
+   int refcount; /**< Reference counting. */
+   int pending; /**< Glyphs being generated in the background. */
 
    /* Generated values. */
    GLint magfilter; /**< Magnification filter. */
    GLint minfilter; /**< Minification filter. */
-   int h; /**< Font height. */
    int tw; /**< Width of textures. */
    int th; /**< Height of textures. */
    glFontTex *tex; /**< Textures. */
-   gl_vbo *vbo_tex; /**< VBO associated to texture coordinates. */
-   gl_vbo *vbo_vert; /**< VBO associated to vertex coordinates. */
-   GLfloat *vbo_tex_data; /**< Copy of texture coordinate data. */
-   GLshort *vbo_vert_data; /**< Copy of vertex coordinate data. */
+   GLfloat *vbo_tex_data; /**< Texture coordinates of the glyph quads. */
+   GLshort *vbo_vert_data; /**< Vertex coordinates of the glyph quads. */
    int nvbo; /**< Amount of vbo data. */
    int mvbo; /**< Amount of vbo memory. */
    glFontGlyph *glyphs; /**< Unicode glyphs. */
    int lut[HASH_LUT_SIZE]; /**< Look up table. */
+   int ascii[128]; /**< Glyphs of the ASCII characters, skipping the look up table, -1 if not loaded. */
 
    /* Freetype stuff. */
    glFontStashFreetype *ft;
+} glFontAtlas;
 
+
+/**
+ * @brief Font structure.
+ */
+typedef struct glFontStash_s {
+   char *fname; /**< Font list name. */
+   int h; /**< Font height. */
+   glFontAtlas *atlas; /**< Glyphs of the font. */
    int refcount; /**< Reference counting. */
 } glFontStash;
 
+
+/**
+ * @brief Distance field of a glyph being generated in the background.
+ */
+typedef struct glFontJob_s {
+   glFontAtlas *atlas; /**< Atlas the glyph belongs to. */
+   int glyph; /**< Index of the glyph in the atlas. */
+   font_char_t ch; /**< Character, dataf gets generated from data. */
+} glFontJob;
+
+
+/**
+ * @brief A line of a text layout.
+ */
+typedef struct glFontLine_s {
+   int start; /**< Offset of the first byte of the line. */
+   int end; /**< Offset after the last byte of the line. */
+} glFontLine;
+
+
+/**
+ * @brief Cached measurements of a string printed with a font and width.
+ *
+ * Fields are computed as they are needed, see the FONT_LAYOUT_* flags.
+ */
+typedef struct glFontLayout_s {
+   struct glFontLayout_s *next; /**< Next layout in the bucket. */
+   uint32_t hash; /**< Hash of the key. */
+   int font; /**< Font stash of the key. */
+   int width; /**< Width of the key. */
+   char *text; /**< Text of the key. */
+   unsigned int flags; /**< Fields that have been computed. */
+   int w; /**< Width of the whole text (FONT_LAYOUT_WIDTH). */
+   int h; /**< Height of the text broken at width (FONT_LAYOUT_LINES). */
+   glFontLine *lines; /**< Lines of the text broken at width (FONT_LAYOUT_LINES, array.h). */
+   size_t limit; /**< Bytes that fit in width (FONT_LAYOUT_LIMIT). */
+   int limit_w; /**< Width of the bytes that fit (FONT_LAYOUT_LIMIT). */
+} glFontLayout;
+
+
 /**
  * Available fonts stashes.
  */
 static glFontStash *avail_fonts = NULL;  /**< These are pointed to by the font struct exposed in font.h. */
+static glFontAtlas **font_atlases = NULL; /**< Atlases used by the stashes. */
 
 /* default font */
 glFont gl_defFont; /**< Default font. */
@@ -168,26 +240,59 @@ static const glColour *font_lastCol    = NULL; /**< Stores last colour used (act
 static int font_restoreLast      = 0; /**< Restore last colour. */
 
 
+/* Glyph batching. */
+static gl_vbo *font_batchVBO     = NULL; /**< Streaming VBO for the glyph quads. */
+static GLfloat *font_batchData   = NULL; /**< Vertex data of the queued glyphs. */
+static int font_batchCount       = 0; /**< Glyphs queued. */
+static GLuint font_batchTex      = 0; /**< Texture of the queued glyphs. */
+static int font_batchActive      = 0; /**< Whether glyphs stay queued between print calls. */
+static glColour font_batchCol; /**< Colour of the glyphs being printed. */
+static glColour font_batchOutline; /**< Outline colour of the glyphs being printed. */
+static GLfloat font_batchScale; /**< Distance field scale of the glyphs being printed. */
+
+
+/* Background glyph generation. */
+static SDL_mutex *font_jobLock   = NULL; /**< Protects font_jobsDone. */
+static glFontJob **font_jobsDone = NULL; /**< Generated glyphs waiting to be uploaded. */
+static SDL_atomic_t font_jobsReady; /**< Number of glyphs in font_jobsDone, readable without the lock. */
+
+
+/* Text layout cache. */
+static glFontLayout *font_layouts[ FONT_LAYOUT_BUCKETS ]; /**< Cached layouts by hash. */
+static int font_nlayouts = 0; /**< Number of cached layouts. */
+
+
 /*
  * prototypes
  */
-static int gl_fontstashAddFallback( glFontStash* stsh, const char *fname, unsigned int h );
+static char* gl_fontFullNames( const char *fname, const char *prefix );
+static glFontAtlas* gl_fontAtlasGet( const char *fname );
+static void gl_fontAtlasFree( glFontAtlas *atlas );
+static int gl_fontAtlasAddFallbacks( glFontAtlas *atlas, const char *fname );
+static int gl_fontAtlasAddFallback( glFontAtlas *atlas, const char *fname );
+static GLfloat gl_fontAdvance( const glFontStash *stsh, const glFontGlyph *glyph );
 static size_t font_limitSize( glFontStash *stsh, int *width, const char *text, const int max );
 static const glColour* gl_fontGetColour( uint32_t ch );
+/* Layout cache. */
+static uint32_t font_layoutHash( int font, int width, const char *text );
+static glFontLayout* font_layoutGet( const glFont *ft_font, const char *text, int width );
+static void font_layoutLines( const glFont *ft_font, glFontLayout *lay );
+static void font_layoutClear (void);
 /* Get unicode glyphs from cache. */
-static glFontGlyph* gl_fontGetGlyph( glFontStash *stsh, uint32_t ch );
-/* Render.
- * TODO this should be changed to be more like font-stash (https://github.com/akrinke/Font-Stash)
- * In particular, instead of writing char by char, they should be batched up by textures and rendered
- * when gl_fontRenderEnd() is called, saving lots of opengl calls.
- */
+static glFontGlyph* gl_fontGetGlyph( glFontAtlas *atlas, uint32_t ch );
+static inline uint32_t font_nextchar( const char *text, size_t *i );
+static void font_charDistanceField( font_char_t *c );
+static int font_jobDistanceField( void *data );
+static void gl_fontUploadJobs (void);
+/* Render. */
+static void gl_fontBatchGlyph( const glFontAtlas *atlas, const glFontGlyph *glyph );
 static void gl_fontRenderStart( const glFontStash *stsh, double x, double y, const glColour *c, double outlineR );
 static void gl_fontRenderStartH( const glFontStash* stsh, const gl_Matrix4 *H, const glColour *c, double outlineR );
 static int gl_fontRenderGlyph( glFontStash *stsh, uint32_t ch, const glColour *c, int state );
 static void gl_fontRenderEnd (void);
 /* Fussy layout concerns. */
 static void gl_fontKernStart (void);
-static int gl_fontKernGlyph( glFontStash* stsh, uint32_t ch, glFontGlyph* glyph );
+static int gl_fontKernGlyph( glFontStash* stsh, glFontGlyph* glyph );
 
 
 /**
@@ -200,9 +305,9 @@ static glFontStash *gl_fontGetStash( const glFont *font )
 
 
 /**
- * @brief Adds a font glyph to the texture stash.
+ * @brief Adds a font glyph to the texture atlas.
  */
-static int gl_fontAddGlyphTex( glFontStash *stsh, font_char_t *ch, glFontGlyph *glyph )
+static int gl_fontAddGlyphTex( glFontAtlas *atlas, font_char_t *ch, glFontGlyph *glyph )
 {
    int i, j, n;
    glFontRow *r, *gr, *lr;
@@ -216,16 +321,16 @@ static int gl_fontAddGlyphTex( glFontStash *stsh, font_char_t *ch, glFontGlyph *
    /* Find free row. */
    tex = NULL;
    gr = NULL;
-   for (i=0; i<array_size( stsh->tex ); i++) {
+   for (i=0; i<array_size( atlas->tex ); i++) {
       for (j=0; j<MAX_ROWS; j++) {
-         r = &stsh->tex->rows[j];
+         r = &atlas->tex[i].rows[j];
          /* Not empty row and doesn't fit. */
          if ((r->h != 0) && (r->h != ch->h))
             continue;
          if (r->h == ch->h) {
             /* Fits in current row, so use that. */
-            if (r->x + ch->w <= stsh->tw) {
-               tex = &stsh->tex[i];
+            if (r->x + ch->w <= atlas->tw) {
+               tex = &atlas->tex[i];
                gr = r;
                break;
             }
@@ -236,18 +341,18 @@ static int gl_fontAddGlyphTex( glFontStash *stsh, font_char_t *ch, glFontGlyph *
             continue;
          /* First row. */
          if (j==0) {
-            assert( ch->h <= stsh->th ); /* Would be ridiculously large character... */
+            assert( ch->h <= atlas->th ); /* Would be ridiculously large character... */
             r->h = ch->h;
-            tex = &stsh->tex[i];
+            tex = &atlas->tex[i];
             gr = r;
             break;
          }
          /* See if height fits to create a new row. */
-         lr = &stsh->tex->rows[j-1];
-         if (lr->y + lr->h + ch->h <= stsh->th) {
+         lr = &atlas->tex[i].rows[j-1];
+         if (lr->y + lr->h + ch->h <= atlas->th) {
             r->h = ch->h;
             r->y = lr->y + lr->h;
-            tex = &stsh->tex[i];
+            tex = &atlas->tex[i];
             gr = r;
          }
          break; /* Have to break here because either we added a new row or texture is full. */
@@ -258,23 +363,23 @@ static int gl_fontAddGlyphTex( glFontStash *stsh, font_char_t *ch, glFontGlyph *
 
    /* Didn't fit so allocate new texture. */
    if (gr == NULL) {
-      tex = &array_grow( &stsh->tex );
+      tex = &array_grow( &atlas->tex );
       memset( tex, 0, sizeof(glFontTex) );
 
       /* Create new texture. */
       glGenTextures( 1, &tex->id );
-      glBindTexture( GL_TEXTURE_2D, tex->id );
+      gl_bindTexture( GL_TEXTURE_2D, tex->id );
 
       /* Set a sane default minification and magnification filter. */
-      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, stsh->magfilter);
-      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, stsh->minfilter);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, atlas->magfilter);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, atlas->minfilter);
 
       /* Clamp texture .*/
       glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
       glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 
       /* Initialize size. */
-      glTexImage2D( GL_TEXTURE_2D, 0, GL_RED, stsh->tw, stsh->th, 0,
+      glTexImage2D( GL_TEXTURE_2D, 0, GL_RED, atlas->tw, atlas->th, 0,
             GL_RED, GL_UNSIGNED_BYTE, NULL );
 
       /* Check for errors. */
@@ -286,7 +391,7 @@ static int gl_fontAddGlyphTex( glFontStash *stsh, font_char_t *ch, glFontGlyph *
    }
 
    /* Upload data. */
-   glBindTexture( GL_TEXTURE_2D, tex->id );
+   gl_bindTexture( GL_TEXTURE_2D, tex->id );
    glPixelStorei(GL_UNPACK_ALIGNMENT,1);
    if (ch->dataf != NULL)
       glTexSubImage2D( GL_TEXTURE_2D, 0, gr->x, gr->y, ch->w, ch->h,
@@ -298,16 +403,16 @@ static int gl_fontAddGlyphTex( glFontStash *stsh, font_char_t *ch, glFontGlyph *
    /* Check for error. */
    gl_checkErr();
 
-   /* Update VBOs. */
-   stsh->nvbo++;
-   if (stsh->nvbo > stsh->mvbo) {
-      stsh->mvbo *= 2;
-      stsh->vbo_tex_data  = realloc( stsh->vbo_tex_data,  8*stsh->mvbo*sizeof(GLfloat) );
-      stsh->vbo_vert_data = realloc( stsh->vbo_vert_data, 8*stsh->mvbo*sizeof(GLshort) );
+   /* Update the quads. */
+   atlas->nvbo++;
+   if (atlas->nvbo > atlas->mvbo) {
+      atlas->mvbo *= 2;
+      atlas->vbo_tex_data  = realloc( atlas->vbo_tex_data,  8*atlas->mvbo*sizeof(GLfloat) );
+      atlas->vbo_vert_data = realloc( atlas->vbo_vert_data, 8*atlas->mvbo*sizeof(GLshort) );
    }
-   n = 8*stsh->nvbo;
-   vbo_tex  = &stsh->vbo_tex_data[n-8];
-   vbo_vert = &stsh->vbo_vert_data[n-8];
+   n = 8*atlas->nvbo;
+   vbo_tex  = &atlas->vbo_tex_data[n-8];
+   vbo_vert = &atlas->vbo_vert_data[n-8];
    /* We do something like the following for vertex coordinates.
       *
       *
@@ -332,8 +437,8 @@ static int gl_fontAddGlyphTex( glFontStash *stsh, font_char_t *ch, glFontGlyph *
       *   off_x
       */
    /* Temporary variables. */
-   fw  = (GLfloat) stsh->tw;
-   fh  = (GLfloat) stsh->th;
+   fw  = (GLfloat) atlas->tw;
+   fh  = (GLfloat) atlas->th;
    tx  = (GLfloat) gr->x / fw;
    ty  = (GLfloat) gr->y / fh;
    txw = (GLfloat) (gr->x + ch->w) / fw;
@@ -360,20 +465,12 @@ static int gl_fontAddGlyphTex( glFontStash *stsh, font_char_t *ch, glFontGlyph *
    vbo_vert[ 5 ] = vy;
    vbo_vert[ 6 ] = vx+vw; /* Bottom right. */
    vbo_vert[ 7 ] = vy;
-   /* Update vbos. */
-   gl_vboData( stsh->vbo_tex,  sizeof(GLfloat)*n,  stsh->vbo_tex_data );
-   gl_vboData( stsh->vbo_vert, sizeof(GLshort)*n, stsh->vbo_vert_data );
-
    /* Add space for the new character. */
    gr->x += ch->w;
 
    /* Save glyph data. */
    glyph->vbo_id = (n-8)/2;
-   glyph->tex_index = tex - stsh->tex;
-
-   /* Since the VBOs have possibly changed, we have to reset the data. */
-   gl_vboActivateAttribOffset( stsh->vbo_vert, shaders.font.vertex, 0, 2, GL_SHORT, 0 );
-   gl_vboActivateAttribOffset( stsh->vbo_tex, shaders.font.tex_coord, 0, 2, GL_FLOAT, 0 );
+   glyph->tex_index = tex - atlas->tex;
 
    return 0;
 }
@@ -484,7 +581,7 @@ static size_t font_limitSize( glFontStash *stsh, int *width, const char *text, c
    gl_fontKernStart();
    i = 0;
    n = 0.;
-   while ((ch = u8_nextchar( text, &i ))) {
+   while ((ch = font_nextchar( text, &i ))) {
       /* Ignore escape sequence. */
       if (ch == FONT_COLOUR_CODE) {
          if (text[i] != '\0')
@@ -493,8 +590,8 @@ static size_t font_limitSize( glFontStash *stsh, int *width, const char *text, c
       }
 
       /* Count length. */
-      glFontGlyph *glyph = gl_fontGetGlyph( stsh, ch );
-      adv_x = gl_fontKernGlyph( stsh, ch, glyph ) + glyph->adv_x;
+      glFontGlyph *glyph = gl_fontGetGlyph( stsh->atlas, ch );
+      adv_x = gl_fontKernGlyph( stsh, glyph ) + gl_fontAdvance( stsh, glyph );
 
       /* See if enough room. */
       n += adv_x;
@@ -511,6 +608,129 @@ static size_t font_limitSize( glFontStash *stsh, int *width, const char *text, c
 }
 
 
+/**
+ * @brief Hashes the key of a text layout (FNV-1a).
+ */
+static uint32_t font_layoutHash( int font, int width, const char *text )
+{
+   uint32_t h;
+
+   h = 2166136261u;
+   h = (h ^ (uint32_t)font) * 16777619u;
+   h = (h ^ (uint32_t)width) * 16777619u;
+   for (; *text != '\0'; text++)
+      h = (h ^ (unsigned char)*text) * 16777619u;
+   return h;
+}
+
+
+/**
+ * @brief Gets the cached layout of a text, adding it if needed.
+ *
+ * Labels and descriptions are measured every frame while rarely changing, so
+ *  their measurements are kept around. The cache is cleared when it gets too
+ *  big, which only happens with lots of changing text, and when fonts change.
+ *
+ *    @param ft_font Font the text is printed with.
+ *    @param text Text to get the layout of.
+ *    @param width Width the text is limited or broken at.
+ *    @return The layout of the text.
+ */
+static glFontLayout* font_layoutGet( const glFont *ft_font, const char *text, int width )
+{
+   uint32_t hash;
+   glFontLayout *lay, **bucket;
+
+   hash   = font_layoutHash( ft_font->id, width, text );
+   bucket = &font_layouts[ hash & (FONT_LAYOUT_BUCKETS-1) ];
+   for (lay=*bucket; lay!=NULL; lay=lay->next)
+      if ((lay->hash == hash) && (lay->font == ft_font->id) &&
+            (lay->width == width) && (strcmp( lay->text, text ) == 0))
+         return lay;
+
+   if (font_nlayouts >= FONT_LAYOUT_MAX)
+      font_layoutClear();
+
+   lay         = calloc( 1, sizeof(glFontLayout) );
+   lay->hash   = hash;
+   lay->font   = ft_font->id;
+   lay->width  = width;
+   lay->text   = strdup( text );
+   lay->next   = *bucket;
+   *bucket     = lay;
+   font_nlayouts++;
+   return lay;
+}
+
+
+/**
+ * @brief Breaks the text of a layout into lines.
+ *
+ * Lines are broken like gl_printTextRaw() always did, while the height is
+ *  computed like gl_printHeightRaw() did.
+ */
+static void font_layoutLines( const glFont *ft_font, glFontLayout *lay )
+{
+   int p, lp, l;
+   double y;
+   const char *text;
+   glFontLine *line;
+
+   text = lay->text;
+   lay->lines = array_create( glFontLine );
+
+   /* Lines to print. */
+   p = 0;
+   do {
+      lp = p;
+      l  = gl_printWidthForText( ft_font, &text[p], lay->width, NULL );
+      line = &array_grow( &lay->lines );
+      line->start = p;
+      line->end   = p + l;
+      p = line->end;
+      if ((text[p] == '\n') || (text[p] == ' '))
+         p++; /* Skip "empty char". */
+   } while ((text[p] != '\0') && (p != lp));
+
+   /* Height. */
+   if (text[0] == '\0')
+      lay->h = 0;
+   else {
+      y = 0.;
+      p = 0;
+      do {
+         l  = gl_printWidthForText( ft_font, &text[p], lay->width, NULL );
+         p += l + 1;
+         y += 1.5*(double)ft_font->h;
+      } while (text[p-1] != '\0');
+      lay->h = (int) (y - 0.5*(double)ft_font->h) + 1;
+   }
+
+   lay->flags |= FONT_LAYOUT_LINES;
+}
+
+
+/**
+ * @brief Clears the text layout cache.
+ */
+static void font_layoutClear (void)
+{
+   int i;
+   glFontLayout *lay, *next;
+
+   for (i=0; i<FONT_LAYOUT_BUCKETS; i++) {
+      for (lay=font_layouts[i]; lay!=NULL; lay=next) {
+         next = lay->next;
+         free( lay->text );
+         array_free( lay->lines );
+         free( lay );
+      }
+      font_layouts[i] = NULL;
+   }
+   font_nlayouts = 0;
+}
+
+
 /**
  * @brief Gets the number of characters in text that fit into width.
  *
@@ -575,10 +795,10 @@ int gl_printWidthForText( const glFont *ft_font, const char *text,
          lastwidth = (int)round(n);
       }
 
-      ch = u8_nextchar( text, &i );
+      ch = font_nextchar( text, &i );
       /* Unicode. */
-      glFontGlyph *glyph = gl_fontGetGlyph( stsh, ch );
-      adv_x = glyph==NULL ? 0 : gl_fontKernGlyph( stsh, ch, glyph ) + glyph->adv_x;
+      glFontGlyph *glyph = gl_fontGetGlyph( stsh->atlas, ch );
+      adv_x = glyph==NULL ? 0 : gl_fontKernGlyph( stsh, glyph ) + gl_fontAdvance( stsh, glyph );
       n += adv_x;
 
       /* Check if out of bounds. */
@@ -630,7 +850,7 @@ void gl_printRaw( const glFont *ft_font, double x, double y, const glColour* c,
    s = 0;
    i = 0;
    gl_fontRenderStart( stsh, x, y, c, outlineR );
-   while ((ch = u8_nextchar( text, &i )))
+   while ((ch = font_nextchar( text, &i )))
       s = gl_fontRenderGlyph( stsh, ch, c, s );
    gl_fontRenderEnd();
 }
@@ -662,7 +882,7 @@ void gl_printRawH( const glFont *ft_font, const gl_Matrix4 *H,
    s = 0;
    i = 0;
    gl_fontRenderStartH( stsh, H, c, outlineR );
-   while ((ch = u8_nextchar( text, &i )))
+   while ((ch = font_nextchar( text, &i )))
       s = gl_fontRenderGlyph( stsh, ch, c, s );
    gl_fontRenderEnd();
 }
@@ -728,19 +948,26 @@ int gl_printMaxRaw( const glFont *ft_font, const int max, double x, double y,
    int s;
    size_t ret, i;
    uint32_t ch;
+   glFontLayout *lay;
 
    if (ft_font == NULL)
       ft_font = &gl_defFont;
    glFontStash *stsh = gl_fontGetStash( ft_font );
 
-   /* Limit size. */
-   ret = font_limitSize( stsh, NULL, text, max );
+   /* Limit size, shared with gl_printMidRaw(). */
+   lay = font_layoutGet( ft_font, text, max );
+   if (!(lay->flags & FONT_LAYOUT_LIMIT)) {
+      lay->limit_w = 0;
+      lay->limit   = font_limitSize( stsh, &lay->limit_w, text, max );
+      lay->flags  |= FONT_LAYOUT_LIMIT;
+   }
+   ret = lay->limit;
 
    /* Render it. */
    s = 0;
    gl_fontRenderStart( stsh, x, y, c, outlineR );
    i = 0;
-   while ((ch = u8_nextchar( text, &i )) && (i <= ret))
+   while ((ch = font_nextchar( text, &i )) && (i <= ret))
       s = gl_fontRenderGlyph( stsh, ch, c, s );
    gl_fontRenderEnd();
 
@@ -803,21 +1030,28 @@ int gl_printMidRaw(
    int n, s;
    size_t ret, i;
    uint32_t ch;
+   glFontLayout *lay;
 
    if (ft_font == NULL)
       ft_font = &gl_defFont;
    glFontStash *stsh = gl_fontGetStash( ft_font );
 
    /* limit size */
-   n = 0;
-   ret = font_limitSize( stsh, &n, text, width );
+   lay = font_layoutGet( ft_font, text, width );
+   if (!(lay->flags & FONT_LAYOUT_LIMIT)) {
+      lay->limit_w = 0;
+      lay->limit   = font_limitSize( stsh, &lay->limit_w, text, width );
+      lay->flags  |= FONT_LAYOUT_LIMIT;
+   }
+   n   = lay->limit_w;
+   ret = lay->limit;
    x += (double)(width - n)/2.;
 
    /* Render it. */
    s = 0;
    gl_fontRenderStart( stsh, x, y, c, outlineR );
    i = 0;
-   while ((ch = u8_nextchar( text, &i )) && (i <= ret))
+   while ((ch = font_nextchar( text, &i )) && (i <= ret))
       s = gl_fontRenderGlyph( stsh, ch, c, s );
    gl_fontRenderEnd();
 
@@ -881,10 +1115,12 @@ int gl_printTextRaw( const glFont *ft_font,
       const char *text
     )
 {
-   int p, s, l;
+   int j, s;
    double x,y;
-   size_t i, ret;
+   size_t i;
    uint32_t ch;
+   const glFontLine *line;
+   glFontLayout *lay;
 
    if (ft_font == NULL)
       ft_font = &gl_defFont;
@@ -900,35 +1136,27 @@ int gl_printTextRaw( const glFont *ft_font,
    /* Clears restoration. */
    gl_printRestoreClear();
 
-   ch = text[0]; /* In case of a 0-width first line (ret==p) below, we just care if text is empty or not. */
-   i = 0;
+   /* Get the lines. */
+   lay = font_layoutGet( ft_font, text, width );
+   if (!(lay->flags & FONT_LAYOUT_LINES))
+      font_layoutLines( ft_font, lay );
+
    s = 0;
-   p = 0; /* where we last drew up to */
-   while (y - by > -1e-5) {
-      int lp = p;
-      l = gl_printWidthForText( ft_font, &text[p], width, NULL );
-      ret = p + l;
+   for (j=0; (j<array_size(lay->lines)) && (y - by > -1e-5); j++) {
+      line = &lay->lines[j];
 
       /* Must restore stuff. */
       gl_printRestoreLast();
 
       /* Render it. */
       gl_fontRenderStart( stsh, x, y, c, outlineR );
-      for (i=p; i<ret; ) {
-         ch = u8_nextchar( text, &i);
+      for (i=line->start; i<(size_t)line->end; ) {
+         ch = font_nextchar( text, &i );
          s = gl_fontRenderGlyph( stsh, ch, c, s );
       }
       gl_fontRenderEnd();
 
-      if (ch == '\0')
-         break;
-      p = i;
-      if ((text[p] == '\n') || (text[p] == ' '))
-         p++; /* Skip "empty char". */
       y -= line_height; /* move position down */
-      /* Case we haven't moved. */
-      if (p==lp)
-         break;
    }
 
    return 0;
@@ -984,15 +1212,20 @@ int gl_printWidthRaw( const glFont *ft_font, const char *text )
    GLfloat n;
    size_t i;
    uint32_t ch;
+   glFontLayout *lay;
 
    if (ft_font == NULL)
       ft_font = &gl_defFont;
    glFontStash *stsh = gl_fontGetStash( ft_font );
 
+   lay = font_layoutGet( ft_font, text, 0 );
+   if (lay->flags & FONT_LAYOUT_WIDTH)
+      return lay->w;
+
    gl_fontKernStart();
    n = 0.;
    i = 0;
-   while ((ch = u8_nextchar( text, &i ))) {
+   while ((ch = font_nextchar( text, &i ))) {
       /* Ignore escape sequence. */
       if (ch == FONT_COLOUR_CODE) {
          if (text[i] != '\0')
@@ -1002,11 +1235,13 @@ int gl_printWidthRaw( const glFont *ft_font, const char *text )
       }
 
       /* Increment width. */
-      glFontGlyph *glyph = gl_fontGetGlyph( stsh, ch );
-      n += gl_fontKernGlyph( stsh, ch, glyph ) + glyph->adv_x;
+      glFontGlyph *glyph = gl_fontGetGlyph( stsh->atlas, ch );
+      n += gl_fontKernGlyph( stsh, glyph ) + gl_fontAdvance( stsh, glyph );
    }
 
-   return (int)round(n);
+   lay->w      = (int)round(n);
+   lay->flags |= FONT_LAYOUT_WIDTH;
+   return lay->w;
 }
 
 
@@ -1048,8 +1283,7 @@ int gl_printWidth( const glFont *ft_font, const char *fmt, ... )
 int gl_printHeightRaw( const glFont *ft_font,
       const int width, const char *text )
 {
-   int i, p;
-   double y;
+   glFontLayout *lay;
 
    if (ft_font == NULL)
       ft_font = &gl_defFont;
@@ -1058,15 +1292,10 @@ int gl_printHeightRaw( const glFont *ft_font,
    if (text[0] == '\0')
       return 0;
 
-   y = 0.;
-   p = 0;
-   do {
-      i = gl_printWidthForText( ft_font, &text[p], width, NULL );
-      p += i + 1;
-      y += 1.5*(double)ft_font->h; /* move position down */
-   } while (text[p-1] != '\0');
-
-   return (int) (y - 0.5*(double)ft_font->h) + 1;
+   lay = font_layoutGet( ft_font, text, width );
+   if (!(lay->flags & FONT_LAYOUT_LINES))
+      font_layoutLines( ft_font, lay );
+   return lay->h;
 }
 
 /**
@@ -1102,19 +1331,22 @@ int gl_printHeight( const glFont *ft_font,
  *
  */
 /**
+ * @brief Loads a character from FreeType.
+ *
+ * Glyphs with an outline are left buffered in data for
+ *  font_charDistanceField().
  */
-static int font_makeChar( glFontStash *stsh, font_char_t *c, uint32_t ch )
+static int font_makeChar( glFontAtlas *atlas, font_char_t *c, uint32_t ch )
 {
    FT_Bitmap bitmap;
    FT_GlyphSlot slot;
    FT_UInt glyph_index;
    int i, u,v, w,h, rw,rh, len, b;
    glFontStashFreetype *ft;
-   GLubyte *buffer;
 
-   len = array_size(stsh->ft);
+   len = array_size(atlas->ft);
    for (i=0; i<len; i++) {
-      ft = &stsh->ft[i];
+      ft = &atlas->ft[i];
 
       /* Get glyph index. */
       glyph_index = FT_Get_Char_Index( ft->face, ch );
@@ -1124,7 +1356,7 @@ static int font_makeChar( glFontStash *stsh, font_char_t *c, uint32_t ch )
             continue;
          else {
             WARN(_("Font '%s' unicode character '%#x' not found in font! Using missing glyph."), ft->file->name, ch);
-            ft = &stsh->ft[0]; /* Fallback to first font. */
+            ft = &atlas->ft[0]; /* Fallback to first font. */
          }
       }
 
@@ -1145,6 +1377,7 @@ static int font_makeChar( glFontStash *stsh, font_char_t *c, uint32_t ch )
       /* Store data. */
       c->data = NULL;
       c->dataf = NULL;
+      c->sdf = 0;
       if (bitmap.buffer == NULL) {
          /* Space characters tend to have no buffer. */
          b = 0;
@@ -1155,17 +1388,14 @@ static int font_makeChar( glFontStash *stsh, font_char_t *c, uint32_t ch )
       }
       else {
          /* Create a larger image using an extra border and center glyph. */
-         b = 1 + ((MAX_EFFECT_RADIUS+1) * FONT_DISTANCE_FIELD_SIZE - 1) / stsh->h;
+         b = 1 + ((MAX_EFFECT_RADIUS+1) * FONT_DISTANCE_FIELD_SIZE - 1) / FONT_SDF_SIZE_MIN;
          rw = w+b*2;
          rh = h+b*2;
-         buffer = calloc( rw*rh, sizeof(GLubyte) );
+         c->data = calloc( rw*rh, sizeof(GLubyte) );
          for (v=0; v<h; v++)
             for (u=0; u<w; u++)
-               buffer[ (b+v)*rw+(b+u) ] = bitmap.buffer[ v*w+u ];
-         /* Compute signed fdistance field with buffered glyph. */
-         c->dataf = make_distance_mapbf( buffer, rw, rh,
-               (double)(MAX_EFFECT_RADIUS*FONT_DISTANCE_FIELD_SIZE) / stsh->h);
-         free( buffer );
+               c->data[ (b+v)*rw+(b+u) ] = bitmap.buffer[ v*w+u ];
+         c->sdf = 1;
       }
       c->w     = rw;
       c->h     = rh;
@@ -1181,6 +1411,60 @@ static int font_makeChar( glFontStash *stsh, font_char_t *c, uint32_t ch )
 }
 
 
+/**
+ * @brief Turns the buffered glyph of a character into a signed distance field.
+ *
+ * Only touches the character, so it can run in the threadpool.
+ */
+static void font_charDistanceField( font_char_t *c )
+{
+   c->dataf = make_distance_mapbf( c->data, c->w, c->h,
+         (double)(MAX_EFFECT_RADIUS*FONT_DISTANCE_FIELD_SIZE) / FONT_SDF_SIZE_MIN );
+   free( c->data );
+   c->data = NULL;
+   c->sdf  = 0;
+}
+
+
+/**
+ * @brief Threadpool job generating the distance field of a glyph.
+ */
+static int font_jobDistanceField( void *data )
+{
+   glFontJob *job = data;
+
+   font_charDistanceField( &job->ch );
+
+   SDL_mutexP( font_jobLock );
+   array_push_back( &font_jobsDone, job );
+   SDL_AtomicIncRef( &font_jobsReady );
+   SDL_mutexV( font_jobLock );
+   return 0;
+}
+
+
+/**
+ * @brief Uploads the glyphs generated in the background.
+ */
+static void gl_fontUploadJobs (void)
+{
+   int i;
+   glFontJob *job;
+
+   SDL_mutexP( font_jobLock );
+   for (i=0; i<array_size(font_jobsDone); i++) {
+      job = font_jobsDone[i];
+      gl_fontAddGlyphTex( job->atlas, &job->ch, &job->atlas->glyphs[ job->glyph ] );
+      job->atlas->pending--;
+      free( job->ch.dataf );
+      free( job );
+   }
+   array_resize( &font_jobsDone, 0 );
+   SDL_AtomicSet( &font_jobsReady, 0 );
+   SDL_mutexV( font_jobLock );
+}
+
+
 /**
  * @brief Starts the rendering engine.
  */
@@ -1205,24 +1489,31 @@ static void gl_fontRenderStartH( const glFontStash* stsh, const gl_Matrix4 *H, c
    else
       col = c;
 
-   glUseProgram(shaders.font.program);
-   gl_uniformAColor(shaders.font.color, col, a);
-   if (outlineR == 0.)
-      gl_uniformAColor(shaders.font.outline_color, col, 0.);
-   else
-      gl_uniformAColor(shaders.font.outline_color, &cGrey10, a);
+   font_batchCol   = *col;
+   font_batchCol.a = a;
+   if (outlineR == 0.) {
+      font_batchOutline   = *col;
+      font_batchOutline.a = 0.;
+   }
+   else {
+      font_batchOutline   = cGrey10;
+      font_batchOutline.a = a;
+   }
 
    scale = (double)stsh->h / FONT_DISTANCE_FIELD_SIZE;
    font_projection_mat = gl_Matrix4_Scale(*H, scale, scale, 1 );
+   /* Smaller fonts don't fit the whole outline in the spread. */
+   font_batchScale = (GLfloat)FONT_SDF_SIZE_MIN / MAX( stsh->h, FONT_SDF_SIZE_MIN );
 
    font_restoreLast = 0;
    gl_fontKernStart();
 
-   /* Activate the appropriate VBOs. */
-   glEnableVertexAttribArray( shaders.font.vertex );
-   gl_vboActivateAttribOffset( stsh->vbo_vert, shaders.font.vertex, 0, 2, GL_SHORT, 0 );
-   glEnableVertexAttribArray( shaders.font.tex_coord );
-   gl_vboActivateAttribOffset( stsh->vbo_tex, shaders.font.tex_coord, 0, 2, GL_FLOAT, 0 );
+   /* Pick up the glyphs that got generated since. */
+   if (SDL_AtomicGet( &font_jobsReady ) > 0)
+      gl_fontUploadJobs();
+
+   /* Queued sprites go below the text. */
+   gl_batchFlush();
 }
 
 
@@ -1282,57 +1573,103 @@ static uint32_t hashint( uint32_t a )
    return a;
 }
 
+/**
+ * @brief Gets the next character of a text like u8_nextchar(), without
+ *        decoding ASCII characters.
+ *
+ *    @param text Text to get the character of.
+ *    @param[in,out] i Offset of the character, moved to the next one.
+ *    @return The character, 0 at the end of the text.
+ */
+static inline uint32_t font_nextchar( const char *text, size_t *i )
+{
+   unsigned char c = text[*i];
+   if (c < 0x80) {
+      if (c != '\0')
+         (*i)++;
+      return c;
+   }
+   return u8_nextchar( text, i );
+}
+
+
 /**
  * @brief Gets or caches a glyph to render.
+ *
+ * New glyphs can be measured right away, but are only drawn once their
+ *  distance field is uploaded (tex_index stays -1 until then).
  */
-static glFontGlyph* gl_fontGetGlyph( glFontStash *stsh, uint32_t ch )
+static glFontGlyph* gl_fontGetGlyph( glFontAtlas *atlas, uint32_t ch )
 {
    int i;
    unsigned int h;
 
+   /* Most text is ASCII. */
+   if ((ch < 128) && (atlas->ascii[ch] >= 0))
+      return &atlas->glyphs[ atlas->ascii[ch] ];
+
    /* Use hash table and linked lists to find the glyph. */
    h = hashint(ch) & (HASH_LUT_SIZE-1);
-   i = stsh->lut[h];
+   i = atlas->lut[h];
    while (i != -1) {
-      if (stsh->glyphs[i].codepoint == ch)
-         return &stsh->glyphs[i];
-      i = stsh->glyphs[i].next;
+      if (atlas->glyphs[i].codepoint == ch)
+         return &atlas->glyphs[i];
+      i = atlas->glyphs[i].next;
    }
 
    /* Glyph not found, have to generate. */
    glFontGlyph *glyph;
+   glFontJob *job;
    font_char_t ft_char;
    int idx;
 
    /* Load data from freetype. */
-   if (font_makeChar( stsh, &ft_char, ch ))
+   if (font_makeChar( atlas, &ft_char, ch ))
       return NULL;
 
    /* Create new character. */
-   glyph = &array_grow( &stsh->glyphs );
+   glyph = &array_grow( &atlas->glyphs );
    glyph->codepoint = ch;
    glyph->adv_x = ft_char.adv_x;
    glyph->ft_index = ft_char.ft_index;
+   glyph->ft_glyph = FT_Get_Char_Index( atlas->ft[ft_char.ft_index].face, ch );
+   glyph->tex_index = -1;
    glyph->next  = -1;
-   idx = glyph - stsh->glyphs;
+   idx = glyph - atlas->glyphs;
+   if (ch < 128)
+      atlas->ascii[ch] = idx;
 
    /* Insert in linked list. */
-   i = stsh->lut[h];
+   i = atlas->lut[h];
    if (i == -1) {
-      stsh->lut[h] = idx;
+      atlas->lut[h] = idx;
    }
    else {
       while (i != -1) {
-         if (stsh->glyphs[i].next == -1) {
-            stsh->glyphs[i].next = idx;
+         if (atlas->glyphs[i].next == -1) {
+            atlas->glyphs[i].next = idx;
             break;
          }
-         i = stsh->glyphs[i].next;
+         i = atlas->glyphs[i].next;
       }
    }
 
+   /* Generate the distance field in the background. */
+   if (ft_char.sdf) {
+      job = malloc( sizeof(glFontJob) );
+      job->atlas = atlas;
+      job->glyph = idx;
+      job->ch    = ft_char;
+      if (threadpool_newJob( font_jobDistanceField, job ) == 0) {
+         atlas->pending++;
+         return glyph;
+      }
+      free( job );
+      font_charDistanceField( &ft_char );
+   }
+
    /* Find empty texture and render char. */
-   gl_fontAddGlyphTex( stsh, &ft_char, glyph );
+   gl_fontAddGlyphTex( atlas, &ft_char, glyph );
 
    free(ft_char.data);
    free(ft_char.dataf);
@@ -1341,6 +1678,15 @@ static glFontGlyph* gl_fontGetGlyph( glFontStash *stsh, uint32_t ch )
 }
 
 
+/**
+ * @brief Gets the advance of a glyph on the screen.
+ */
+static GLfloat gl_fontAdvance( const glFontStash *stsh, const glFontGlyph *glyph )
+{
+   return glyph->adv_x * stsh->h / FONT_DISTANCE_FIELD_SIZE;
+}
+
+
 /**
  * @brief Call at the start of a string/line.
  */
@@ -1353,18 +1699,19 @@ static void gl_fontKernStart (void)
 /**
  * @brief Return the signed advance (same units as adv_x) ahead of the current char.
  */
-static int gl_fontKernGlyph( glFontStash* stsh, uint32_t ch, glFontGlyph* glyph )
+static int gl_fontKernGlyph( glFontStash* stsh, glFontGlyph* glyph )
 {
    FT_Face ft_face;
    FT_UInt ft_glyph_index;
    FT_Vector kerning;
    int kern_adv_x = 0;
 
-   ft_face = stsh->ft[glyph->ft_index].face;
-   ft_glyph_index = FT_Get_Char_Index( ft_face, ch );
+   ft_face = stsh->atlas->ft[glyph->ft_index].face;
+   ft_glyph_index = glyph->ft_glyph;
    if (prev_glyph_index && prev_glyph_ft_index == glyph->ft_index) {
+      /* Faces are sized to FONT_DISTANCE_FIELD_SIZE. */
       FT_Get_Kerning( ft_face, prev_glyph_index, ft_glyph_index, FT_KERNING_DEFAULT, &kerning );
-      kern_adv_x = kerning.x / 64;
+      kern_adv_x = kerning.x * stsh->h / (64 * FONT_DISTANCE_FIELD_SIZE);
    }
    prev_glyph_index = ft_glyph_index;
    prev_glyph_ft_index = glyph->ft_index;
@@ -1381,6 +1728,7 @@ static int gl_fontRenderGlyph( glFontStash* stsh, uint32_t ch, const glColour *c
    double a;
    const glColour *col;
    int kern_adv_x;
+   GLuint tex;
 
    /* Handle escape sequences. */
    if ((ch == FONT_COLOUR_CODE) && (state==0)) {/* Start sequence. */
@@ -1389,12 +1737,14 @@ static int gl_fontRenderGlyph( glFontStash* stsh, uint32_t ch, const glColour *c
    if ((state == 1) && (ch != FONT_COLOUR_CODE)) {
       col = gl_fontGetColour( ch );
       a = (c==NULL) ? 1. : c->a;
-      if (col != NULL)
-         gl_uniformAColor(shaders.font.color, col, a );
+      if (col != NULL) {
+         font_batchCol   = *col;
+         font_batchCol.a = a;
+      }
       else if (c==NULL)
-         gl_uniformColor(shaders.font.color, &cWhite);
+         font_batchCol = cWhite;
       else
-         gl_uniformColor(shaders.font.color, c);
+         font_batchCol = *c;
       font_lastCol = col;
       return 0;
    }
@@ -1402,7 +1752,7 @@ static int gl_fontRenderGlyph( glFontStash* stsh, uint32_t ch, const glColour *c
    /* Unicode goes here.
     * First try to find the glyph. */
    glFontGlyph *glyph;
-   glyph = gl_fontGetGlyph( stsh, ch );
+   glyph = gl_fontGetGlyph( stsh->atlas, ch );
    if (glyph == NULL) {
       WARN(_("Unable to find glyph '%d'!"), ch );
       return -1;
@@ -1410,68 +1760,205 @@ static int gl_fontRenderGlyph( glFontStash* stsh, uint32_t ch, const glColour *c
 
    /* Kern if possible. */
    scale = (double)stsh->h / FONT_DISTANCE_FIELD_SIZE;
-   kern_adv_x = gl_fontKernGlyph( stsh, ch, glyph );
+   kern_adv_x = gl_fontKernGlyph( stsh, glyph );
    if (kern_adv_x) {
       font_projection_mat = gl_Matrix4_Translate( font_projection_mat,
             kern_adv_x/scale, 0, 0 );
    }
 
-   /* Activate texture. */
-   glBindTexture(GL_TEXTURE_2D, stsh->tex[glyph->tex_index].id);
-
-   gl_Matrix4_Uniform(shaders.font.projection, font_projection_mat);
-
-   /* Draw the element. */
-   glDrawArrays( GL_TRIANGLE_STRIP, glyph->vbo_id, 4 );
+   /* Queue the glyph, batches can only have one texture. Glyphs still being
+    * generated only take up their space. */
+   if (glyph->tex_index >= 0) {
+      tex = stsh->atlas->tex[glyph->tex_index].id;
+      if ((font_batchCount > 0) &&
+            ((font_batchTex != tex) || (font_batchCount >= FONT_BATCH_QUADS)))
+         gl_printBatchFlush();
+      font_batchTex = tex;
+      gl_fontBatchGlyph( stsh->atlas, glyph );
+   }
 
    /* Translate matrix. */
    font_projection_mat = gl_Matrix4_Translate( font_projection_mat,
-         glyph->adv_x/scale, 0, 0 );
+         glyph->adv_x, 0, 0 );
 
    return 0;
 }
 
 
+/**
+ * @brief Queues the quad of a glyph at the current position.
+ *
+ * The quad is transformed on the CPU so glyphs printed with different
+ *  matrices and colours can be drawn together.
+ */
+static void gl_fontBatchGlyph( const glFontAtlas *atlas, const glFontGlyph *glyph )
+{
+   /* Two triangles from the triangle strip of the glyph. */
+   static const int quad[6] = { 0, 1, 2, 1, 3, 2 };
+   int i, j;
+   GLfloat vx, vy;
+   GLfloat *d;
+   const gl_Matrix4 *m;
+
+   m = &font_projection_mat;
+   d = &font_batchData[ font_batchCount * 6 * FONT_BATCH_FLOATS ];
+   for (i=0; i<6; i++) {
+      j  = glyph->vbo_id + quad[i];
+      vx = atlas->vbo_vert_data[ 2*j+0 ];
+      vy = atlas->vbo_vert_data[ 2*j+1 ];
+      d[0]  = m->m[0][0]*vx + m->m[1][0]*vy + m->m[3][0];
+      d[1]  = m->m[0][1]*vx + m->m[1][1]*vy + m->m[3][1];
+      d[2]  = atlas->vbo_tex_data[ 2*j+0 ];
+      d[3]  = atlas->vbo_tex_data[ 2*j+1 ];
+      d[4]  = font_batchCol.r;
+      d[5]  = font_batchCol.g;
+      d[6]  = font_batchCol.b;
+      d[7]  = font_batchCol.a;
+      d[8]  = font_batchOutline.r;
+      d[9]  = font_batchOutline.g;
+      d[10] = font_batchOutline.b;
+      d[11] = font_batchOutline.a;
+      d[12] = font_batchScale;
+      d += FONT_BATCH_FLOATS;
+   }
+   font_batchCount++;
+}
+
+
 /**
  * @brief Ends the rendering engine.
  */
 static void gl_fontRenderEnd (void)
 {
+   if (!font_batchActive)
+      gl_printBatchFlush();
+}
+
+
+/**
+ * @brief Starts batching text.
+ *
+ * Until gl_printBatchEnd() is called, printed glyphs are queued and drawn
+ *  together when the font texture changes or the batch fills up. Anything else
+ *  rendered in between must call gl_printBatchFlush() first so that ordering
+ *  is kept, which the solid, smooth, circle and texture rendering already do.
+ */
+void gl_printBatchStart (void)
+{
+   font_batchActive = 1;
+}
+
+
+/**
+ * @brief Draws all the queued glyphs.
+ */
+void gl_printBatchFlush (void)
+{
+   GLsizei stride;
+   GLuint offset;
+   gl_vbo *vbo;
+
+   if (font_batchCount == 0)
+      return;
+
+   stride = sizeof(GLfloat) * FONT_BATCH_FLOATS;
+   vbo    = gl_vboStream( font_batchVBO, stride * 6 * font_batchCount, font_batchData, &offset );
+
+   gl_useProgram(shaders.font.program);
+   gl_bindTexture( GL_TEXTURE_2D, font_batchTex );
+
+   /* Set the vertex data. */
+   glEnableVertexAttribArray( shaders.font.vertex );
+   glEnableVertexAttribArray( shaders.font.tex_coord );
+   glEnableVertexAttribArray( shaders.font.vertex_color );
+   glEnableVertexAttribArray( shaders.font.vertex_outline );
+   glEnableVertexAttribArray( shaders.font.vertex_scale );
+   gl_vboActivateAttribOffset( vbo, shaders.font.vertex,
+         offset, 2, GL_FLOAT, stride );
+   gl_vboActivateAttribOffset( vbo, shaders.font.tex_coord,
+         offset + sizeof(GLfloat) * 2, 2, GL_FLOAT, stride );
+   gl_vboActivateAttribOffset( vbo, shaders.font.vertex_color,
+         offset + sizeof(GLfloat) * 4, 4, GL_FLOAT, stride );
+   gl_vboActivateAttribOffset( vbo, shaders.font.vertex_outline,
+         offset + sizeof(GLfloat) * 8, 4, GL_FLOAT, stride );
+   gl_vboActivateAttribOffset( vbo, shaders.font.vertex_scale,
+         offset + sizeof(GLfloat) * 12, 1, GL_FLOAT, stride );
+
+   /* Draw. */
+   gl_drawArrays( GL_TRIANGLES, 0, 6 * font_batchCount );
+
+   /* Clear state. */
    glDisableVertexAttribArray( shaders.font.vertex );
    glDisableVertexAttribArray( shaders.font.tex_coord );
-   glUseProgram(0);
+   glDisableVertexAttribArray( shaders.font.vertex_color );
+   glDisableVertexAttribArray( shaders.font.vertex_outline );
+   glDisableVertexAttribArray( shaders.font.vertex_scale );
+   gl_useProgram(0);
 
    /* Check for errors. */
    gl_checkErr();
+
+   font_batchCount = 0;
+}
+
+
+/**
+ * @brief Draws the queued glyphs and stops batching text.
+ */
+void gl_printBatchEnd (void)
+{
+   gl_printBatchFlush();
+   font_batchActive = 0;
 }
 
 
 /**
  * @brief Sets the minification and magnification filters for a font.
  *
+ * The textures are shared by all the sizes of the font files.
+ *
  *    @param ft_font Font to set filters of.
  *    @param min Minification filter (GL_LINEAR on GL_NEAREST).
  *    @param mag Magnification filter (GL_LINEAR on GL_NEAREST).
  */
 void gl_fontSetFilter( const glFont *ft_font, GLint min, GLint mag )
 {
-   glFontStash *stsh;
+   glFontAtlas *atlas;
    int i;
 
-   stsh = gl_fontGetStash( ft_font );
-   stsh->minfilter = min;
-   stsh->magfilter = mag;
+   atlas = gl_fontGetStash( ft_font )->atlas;
+   atlas->minfilter = min;
+   atlas->magfilter = mag;
 
-   for (i=0; i<array_size(stsh->tex); i++) {
-      glBindTexture( GL_TEXTURE_2D, stsh->tex[i].id );
-      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, stsh->magfilter);
-      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, stsh->minfilter);
+   for (i=0; i<array_size(atlas->tex); i++) {
+      gl_bindTexture( GL_TEXTURE_2D, atlas->tex[i].id );
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, atlas->magfilter);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, atlas->minfilter);
    }
 
    gl_checkErr();
 }
 
 
+/**
+ * @brief Checks whether glyphs are still being generated.
+ *
+ * Text printed meanwhile can be missing glyphs, so anything caching what it
+ *  renders should render again.
+ *
+ *    @return Number of glyphs not yet uploaded.
+ */
+int gl_fontPending (void)
+{
+   int i, n;
+
+   n = 0;
+   for (i=0; i<array_size(font_atlases); i++)
+      n += font_atlases[i]->pending;
+   return n;
+}
+
+
 /**
  * @brief Initializes a font.
  *
@@ -1484,10 +1971,9 @@ void gl_fontSetFilter( const glFont *ft_font, GLint min, GLint mag )
  */
 int gl_fontInit( glFont* font, const char *fname, const unsigned int h, const char *prefix, unsigned int flags )
 {
-   size_t i, len, plen;
+   size_t i;
    glFontStash *stsh, *reusable_stsh_slot;
-   int ch;
-   char fullname[PATH_MAX];
+   char *fullnames;
 
    /* Initialize FreeType. */
    if (font_library_refs++ == 0) {
@@ -1502,8 +1988,10 @@ int gl_fontInit( glFont* font, const char *fname, const unsigned int h, const ch
       fname = FONT_DEFAULT_PATH;
 
    /* Get font stash. */
-   if (avail_fonts==NULL)
-      avail_fonts = array_create( glFontStash );
+   if (avail_fonts==NULL) {
+      avail_fonts  = array_create( glFontStash );
+      font_atlases = array_create( glFontAtlas* );
+   }
 
    /* Check if available. */
    reusable_stsh_slot = NULL;
@@ -1533,52 +2021,173 @@ int gl_fontInit( glFont* font, const char *fname, const unsigned int h, const ch
    memset( stsh, 0, sizeof(glFontStash) );
    stsh->refcount = 1; /* Initialize refcount. */
    stsh->fname = strdup(fname);
+   stsh->h = h;
    font->id = stsh - avail_fonts;
    font->h = h;
 
-   /* Default stuff. */
-   stsh->magfilter = GL_LINEAR;
-   stsh->minfilter = GL_LINEAR;
-   stsh->tw = DEFAULT_TEXTURE_SIZE;
-   stsh->th = DEFAULT_TEXTURE_SIZE;
-   stsh->h = h;
+   /* Glyph batching is shared by all the fonts. */
+   if (font_batchVBO == NULL) {
+      font_batchData = malloc( sizeof(GLfloat) * 6 * FONT_BATCH_FLOATS * FONT_BATCH_QUADS );
+      font_batchVBO  = gl_vboCreateStream( sizeof(GLfloat) * 6 * FONT_BATCH_FLOATS * FONT_BATCH_QUADS, NULL );
+   }
+   if (font_jobLock == NULL) {
+      font_jobLock  = SDL_CreateMutex();
+      font_jobsDone = array_create( glFontJob* );
+   }
 
-   /* Set up font stuff for next glyphs. */
-   stsh->ft = array_create( glFontStashFreetype );
-   ch = 0;
-   len = strlen(fname);
+   /* Glyphs are shared with the other sizes. */
+   fullnames = gl_fontFullNames( fname, prefix );
+   stsh->atlas = gl_fontAtlasGet( fullnames );
+   free( fullnames );
+
+   return 0;
+}
+
+
+/**
+ * @brief Adds the prefix to every name of a comma separated font list.
+ *
+ *    @param fname Comma separated names of the fonts.
+ *    @param prefix Prefix to add to the names.
+ *    @return Newly allocated comma separated paths.
+ */
+static char* gl_fontFullNames( const char *fname, const char *prefix )
+{
+   size_t i, len, plen, n;
+   int ch;
+   char *fullnames;
+
+   len  = strlen(fname);
    plen = strlen(prefix);
+   n    = plen+1;
+   for (i=0; i<len; i++)
+      if (fname[i]==',')
+         n += plen;
+   fullnames = malloc( len+n );
+
+   n = 0;
+   ch = 0;
    for (i=0; i<=len; i++) {
       if ((fname[i]=='\0') || (fname[i]==',')) {
-         strncpy( fullname, prefix, PATH_MAX-1 );
-         strncat( fullname, &fname[ch], MIN( PATH_MAX-1-plen, i-ch ) );
-         gl_fontstashAddFallback( stsh, fullname, h );
-         ch = i;
-         if (fname[i]==',')
-            ch++;
+         memcpy( &fullnames[n], prefix, plen );
+         memcpy( &fullnames[n+plen], &fname[ch], i-ch );
+         n += plen + i-ch;
+         fullnames[n++] = fname[i];
+         ch = i+1;
       }
    }
+   return fullnames;
+}
+
+
+/**
+ * @brief Gets the atlas of a list of font files, creating it if needed.
+ *
+ *    @param fname Comma separated paths of the font files.
+ *    @return The atlas with an added reference.
+ */
+static glFontAtlas* gl_fontAtlasGet( const char *fname )
+{
+   int i;
+   glFontAtlas *atlas;
+
+   for (i=0; i<array_size(font_atlases); i++) {
+      if (strcmp( font_atlases[i]->fname, fname ) == 0) {
+         font_atlases[i]->refcount++;
+         return font_atlases[i];
+      }
+   }
+
+   atlas = calloc( 1, sizeof(glFontAtlas) );
+   atlas->fname     = strdup( fname );
+   atlas->refcount  = 1;
+   atlas->magfilter = GL_LINEAR;
+   atlas->minfilter = GL_LINEAR;
+   atlas->tw        = DEFAULT_TEXTURE_SIZE;
+   atlas->th        = DEFAULT_TEXTURE_SIZE;
+
+   /* Set up font stuff for next glyphs. */
+   atlas->ft = array_create( glFontStashFreetype );
+   gl_fontAtlasAddFallbacks( atlas, fname );
 
    /* Initialize the unicode support. */
    for (i=0; i<HASH_LUT_SIZE; i++)
-      stsh->lut[i] = -1;
-   stsh->glyphs = array_create( glFontGlyph );
-   stsh->tex    = array_create( glFontTex );
+      atlas->lut[i] = -1;
+   for (i=0; i<128; i++)
+      atlas->ascii[i] = -1;
+   atlas->glyphs = array_create( glFontGlyph );
+   atlas->tex    = array_create( glFontTex );
 
    /* Set up VBOs. */
-   stsh->mvbo = 256;
-   stsh->vbo_tex_data  = calloc( 8*stsh->mvbo, sizeof(GLfloat) );
-   stsh->vbo_vert_data = calloc( 8*stsh->mvbo, sizeof(GLshort) );
-   stsh->vbo_tex  = gl_vboCreateStatic( sizeof(GLfloat)*8*stsh->mvbo,  stsh->vbo_tex_data );
-   stsh->vbo_vert = gl_vboCreateStatic( sizeof(GLshort)*8*stsh->mvbo, stsh->vbo_vert_data );
+   atlas->mvbo = 256;
+   atlas->vbo_tex_data  = calloc( 8*atlas->mvbo, sizeof(GLfloat) );
+   atlas->vbo_vert_data = calloc( 8*atlas->mvbo, sizeof(GLshort) );
 
-   return 0;
+   array_push_back( &font_atlases, atlas );
+
+   /* Get the common glyphs going ahead of use. */
+   for (i=' '; i<='~'; i++)
+      gl_fontGetGlyph( atlas, i );
+
+   return atlas;
+}
+
+
+/**
+ * @brief Removes a reference to an atlas, freeing it when unused.
+ *
+ *    @param atlas Atlas to free.
+ */
+static void gl_fontAtlasFree( glFontAtlas *atlas )
+{
+   int i;
+   glFontStashFreetype *ft;
+
+   if (--atlas->refcount > 0)
+      return;
+
+   /* Glyphs being generated point to the atlas. */
+   while (atlas->pending > 0) {
+      SDL_Delay( 1 );
+      gl_fontUploadJobs();
+   }
+
+   for (i=0; i<array_size(font_atlases); i++) {
+      if (font_atlases[i] == atlas) {
+         array_erase( &font_atlases, &font_atlases[i], &font_atlases[i+1] );
+         break;
+      }
+   }
+
+   for (i=0; i<array_size(atlas->ft); i++) {
+      ft = &atlas->ft[i];
+      if(--ft->file->refcount == 0) {
+         free(ft->file->name);
+         free(ft->file->data);
+         free(ft->file);
+      }
+      FT_Done_Face(ft->face);
+   }
+   array_free( atlas->ft );
+
+   free( atlas->fname );
+   for (i=0; i<array_size(atlas->tex); i++)
+      gl_deleteTextures( 1, &atlas->tex[i].id );
+   array_free( atlas->tex );
+
+   array_free( atlas->glyphs );
+   free(atlas->vbo_tex_data);
+   free(atlas->vbo_vert_data);
+   free(atlas);
 }
 
 
 /**
  * @brief Adds a fallback font to a font.
  *
+ * The atlas is shared with the other sizes of the font, which shouldn't get
+ *  the fallback, so the font switches to an atlas of its own if needed.
+ *
  *    @param font Font to add fallback to.
  *    @param fname Name of the fallback to add.
  *    @param prefix Prefix to use.
@@ -1586,54 +2195,82 @@ int gl_fontInit( glFont* font, const char *fname, const unsigned int h, const ch
  */
 int gl_fontAddFallback( glFont* font, const char *fname, const char *prefix )
 {
-   size_t i, len, plen;
+   int ret;
+   char *fullnames, *atlasname;
+   glFontStash *stsh = gl_fontGetStash( font );
+   glFontAtlas *atlas = stsh->atlas;
+
+   ret = 0;
+   fullnames = gl_fontFullNames( fname, prefix );
+   atlasname = malloc( strlen(atlas->fname) + strlen(fullnames) + 2 );
+   sprintf( atlasname, "%s,%s", atlas->fname, fullnames );
+   if (atlas->refcount > 1) {
+      stsh->atlas = gl_fontAtlasGet( atlasname );
+      gl_fontAtlasFree( atlas );
+      free( atlasname );
+   }
+   else {
+      ret = gl_fontAtlasAddFallbacks( atlas, fullnames );
+      free( atlas->fname );
+      atlas->fname = atlasname;
+   }
+   free( fullnames );
+
+   /* Glyphs can measure differently with the new fallback. */
+   font_layoutClear();
+
+   return ret;
+}
+
+
+/**
+ * @brief Adds a comma separated list of fallback fonts to an atlas.
+ *
+ *    @param atlas Atlas to add fallbacks to.
+ *    @param fname Comma separated paths of the fallbacks to add.
+ *    @return 0 on success.
+ */
+static int gl_fontAtlasAddFallbacks( glFontAtlas *atlas, const char *fname )
+{
+   size_t i, len;
    int ch, ret;
    char fullname[PATH_MAX];
-   glFontStash *stsh = gl_fontGetStash( font );
 
    ret = 0;
    ch = 0;
    len = strlen(fname);
-   plen = strlen(prefix);
    for (i=0; i<=len; i++) {
       if ((fname[i]=='\0') || (fname[i]==',')) {
-         strncpy( fullname, prefix, PATH_MAX-1 );
-         strncat( fullname, &fname[ch], MIN( PATH_MAX-1-plen, i-ch ) );
-         ret |= gl_fontstashAddFallback( stsh, fullname, font->h );
-         ch = i;
-         if (fname[i]==',')
-            ch++;
+         strncpy( fullname, &fname[ch], MIN( PATH_MAX-1, i-ch ) );
+         fullname[ MIN( PATH_MAX-1, i-ch ) ] = '\0';
+         ret |= gl_fontAtlasAddFallback( atlas, fullname );
+         ch = i+1;
       }
    }
-
    return ret;
 }
 
 
 /**
- * @brief Adds a fallback font to a stash.
+ * @brief Adds a fallback font to an atlas.
  *
- *    @param stsh Stash to add fallback to.
+ *    @param atlas Atlas to add fallback to.
  *    @param fname Name of the fallback to add.
- *    @param h Height to use for the font.
  *    @return 0 on success.
  */
-static int gl_fontstashAddFallback( glFontStash* stsh, const char *fname, unsigned int h )
+static int gl_fontAtlasAddFallback( glFontAtlas *atlas, const char *fname )
 {
    glFontStashFreetype *ft;
    FT_Face face;
-   FT_Matrix scale;
    int i, j;
 
    /* Set up file data. Reference a loaded copy if we have one. */
-   ft = &array_grow( &stsh->ft );
+   ft = &array_grow( &atlas->ft );
    ft->file = NULL;
-   for (i=0; i<array_size(avail_fonts); i++) {
-      if (avail_fonts[i].ft == NULL)
-         continue;
-      for (j=0; j<array_size(avail_fonts[i].ft); j++)
-         if (ft != &avail_fonts[i].ft[j] && !strcmp( fname, avail_fonts[i].ft[j].file->name ))
-            ft->file = avail_fonts[i].ft[j].file;
+   for (i=0; i<array_size(font_atlases); i++) {
+      for (j=0; j<array_size(font_atlases[i]->ft); j++)
+         if (ft != &font_atlases[i]->ft[j] && !strcmp( fname, font_atlases[i]->ft[j].file->name ))
+            ft->file = font_atlases[i]->ft[j].file;
       if (ft->file != NULL) {
          ft->file->refcount++;
          break;
@@ -1658,17 +2295,14 @@ static int gl_fontstashAddFallback( glFontStash* stsh, const char *fname, unsign
       return -1;
    }
 
-   /* Try to resize. */
+   /* Try to resize, all the sizes use the same glyphs. */
    if (FT_IS_SCALABLE(face)) {
       if (FT_Set_Char_Size( face,
                0, /* Same as width. */
-               h * 64,
+               FONT_DISTANCE_FIELD_SIZE * 64,
                96, /* Create at 96 DPI */
                96)) /* Create at 96 DPI */
          WARN(_("FT_Set_Char_Size failed."));
-      scale.xx = scale.yy = (FT_Fixed)FONT_DISTANCE_FIELD_SIZE*0x10000/h;
-      scale.xy = scale.yx = 0;
-      FT_Set_Transform( face, &scale, NULL );
    }
    else
       WARN(_("Font isn't resizable!"));
@@ -1694,9 +2328,6 @@ static int gl_fontstashAddFallback( glFontStash* stsh, const char *fname, unsign
  */
 void gl_freeFont( glFont* font )
 {
-   int i;
-   glFontStashFreetype *ft;
-
    if (font == NULL)
       font = &gl_defFont;
    glFontStash *stsh = gl_fontGetStash( font );
@@ -1706,32 +2337,21 @@ void gl_freeFont( glFont* font )
    if (stsh->refcount > 0)
       return;
    /* Not references and must eliminate. */
+   font_layoutClear();
 
-   for (i=0; i<array_size(stsh->ft); i++) {
-      ft = &stsh->ft[i];
-      if(--ft->file->refcount == 0) {
-         free(ft->file->name);
-         free(ft->file->data);
-         free(ft->file);
-      }
-      FT_Done_Face(ft->face);
-   }
-   array_free( stsh->ft );
+   gl_fontAtlasFree( stsh->atlas );
 
    if (--font_library_refs == 0) {
       FT_Done_FreeType( font_library );
       font_library = NULL;
+
+      gl_printBatchFlush();
+      gl_vboDestroy( font_batchVBO );
+      font_batchVBO = NULL;
+      free( font_batchData );
+      font_batchData = NULL;
    }
 
    free( stsh->fname );
-   for (i=0; i<array_size(stsh->tex); i++)
-      glDeleteTextures( 1, &stsh->tex->id );
-   array_free( stsh->tex );
-
-   array_free( stsh->glyphs );
-   gl_vboDestroy(stsh->vbo_tex);
-   gl_vboDestroy(stsh->vbo_vert);
-   free(stsh->vbo_tex_data);
-   free(stsh->vbo_vert_data);
    memset( stsh, 0, sizeof(glFontStash) );
 }
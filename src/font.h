@@ -109,8 +109,14 @@ void gl_printRestore( const glFontRestore *restore );
 void gl_printStoreMax( glFontRestore *restore, const char *text, int max );
 void gl_printStore( glFontRestore *restore, const char *text );
 
+/* Batching. */
+void gl_printBatchStart (void);
+void gl_printBatchFlush (void);
+void gl_printBatchEnd (void);
+
 /* Misc stuff. */
 void gl_fontSetFilter( const glFont *ft_font, GLint min, GLint mag );
+int gl_fontPending (void);
 
 
 #endif /* FONT_H */
@@ -27,9 +27,21 @@
 #include "ndata.h"
 
 
+/**
+ * @brief Entry of the hash table of a translation.
+ */
+typedef struct translation_entry {
+   uint32_t hash;               /**< Hash of the msgid. */
+   const char *msgid;           /**< English string, NULL if the entry is free. */
+   const char *trans;           /**< Translation, all plural forms. */
+   int cat;                     /**< Index of the catalog it comes from in the chain. */
+} translation_entry_t;
+
 typedef struct translation {
    char *language;              /**< Language code (allocated string). */
    msgcat_t *chain;             /**< Array of message catalogs to try in order. */
+   translation_entry_t *table;  /**< Hash table of the strings of the chain, NULL if none. */
+   uint32_t table_mask;         /**< Size of the hash table minus one. */
    struct translation *next;    /**< Next entry in the list of loaded translations. */
 } translation_t;
 
@@ -39,6 +51,11 @@ static translation_t *gettext_translations = NULL;      /**< Linked list of load
 static translation_t *gettext_activeTranslation = NULL; /**< Active language's code. */
 
 
+static uint32_t gettext_hash( const char *str );
+static void gettext_buildTable( translation_t *t );
+static const translation_entry_t* gettext_find( const translation_t *t, const char *msgid );
+
+
 /**
  * @brief Initialize the translation system.
  * There's no presumption that PhysicsFS is available, so this doesn't actually load translations.
@@ -131,9 +148,86 @@ void gettext_setLanguage( const char* lang )
       }
       array_free( paths );
    }
+   gettext_buildTable( newtrans );
    gettext_activeTranslation = newtrans;
 }
 
+/**
+ * @brief Hashes a string (FNV-1a).
+ */
+static uint32_t gettext_hash( const char *str )
+{
+   uint32_t h = 2166136261u;
+   for (; *str != '\0'; str++)
+      h = (h ^ (uint8_t)*str) * 16777619u;
+   return h;
+}
+
+/**
+ * @brief Builds the hash table of all the strings of a translation chain.
+ *
+ * The catalogs are binary searched with strcmp(), which gets expensive with
+ *  all the strings translated every frame. The table is never modified once
+ *  built, so it can be read from any thread.
+ */
+static void gettext_buildTable( translation_t *t )
+{
+   int i;
+   uint32_t j, n, size, h, k;
+   const char *msgid, *trans;
+   translation_entry_t *e;
+
+   n = 0;
+   for (i=0; i<array_size(t->chain); i++)
+      n += msgcat_nstrings( &t->chain[i] );
+   if (n == 0)
+      return;
+
+   /* Keep it at most half full. */
+   for (size=16; size < 2*n; size *= 2);
+   t->table = calloc( size, sizeof(translation_entry_t) );
+   t->table_mask = size-1;
+
+   for (i=0; i<array_size(t->chain); i++) {
+      n = msgcat_nstrings( &t->chain[i] );
+      for (j=0; j<n; j++) {
+         msgid = msgcat_entry( &t->chain[i], j, &trans );
+         if (msgid == NULL)
+            continue;
+         /* Earlier catalogs in the chain take precedence. */
+         if (gettext_find( t, msgid ) != NULL)
+            continue;
+         h = gettext_hash( msgid );
+         for (k=h & t->table_mask; t->table[k].msgid != NULL; k=(k+1) & t->table_mask);
+         e = &t->table[k];
+         e->hash  = h;
+         e->msgid = msgid;
+         e->trans = trans;
+         e->cat   = i;
+      }
+   }
+}
+
+/**
+ * @brief Finds a string in the hash table of a translation.
+ *
+ *    @return The entry of the string or NULL if not translated.
+ */
+static const translation_entry_t* gettext_find( const translation_t *t, const char *msgid )
+{
+   uint32_t h, k;
+   const translation_entry_t *e;
+
+   h = gettext_hash( msgid );
+   for (k=h & t->table_mask; ; k=(k+1) & t->table_mask) {
+      e = &t->table[k];
+      if (e->msgid == NULL)
+         return NULL;
+      if ((e->hash == h) && (strcmp( e->msgid, msgid ) == 0))
+         return e;
+   }
+}
+
 /**
  * @brief Return a translated version of the input, using the current language catalogs.
  *
@@ -145,16 +239,17 @@ void gettext_setLanguage( const char* lang )
  */
 const char* gettext_ngettext( const char* msgid, const char* msgid_plural, uint64_t n )
 {
-   msgcat_t *chain;
+   const translation_t *t;
+   const translation_entry_t *e;
    const char* trans;
-   int i;
 
-   if (gettext_activeTranslation != NULL) {
-      chain = gettext_activeTranslation->chain;
-      for (i=0; i<array_size(chain); i++) {
-         trans = msgcat_ngettext( &chain[i], msgid, msgid_plural, n );
+   t = gettext_activeTranslation;
+   if ((t != NULL) && (t->table != NULL)) {
+      e = gettext_find( t, msgid );
+      if (e != NULL) {
+         trans = msgcat_plural( &t->chain[ e->cat ], e->trans, msgid_plural, n );
          if (trans != NULL)
-            return (char*)trans;
+            return trans;
       }
    }
 
@@ -19,6 +19,7 @@
 #include "gui.h"
 
 #include "ai.h"
+#include "array.h"
 #include "camera.h"
 #include "comm.h"
 #include "conf.h"
@@ -74,6 +75,8 @@
 #define RADAR_BLINK_PILOT        0.5 /**< Blink rate of the pilot target on radar. */
 #define RADAR_BLINK_PLANET       1. /**< Blink rate of the planet target on radar. */
 
+#define RADAR_VERTEX_FLOATS      6 /**< Floats per radar contact vertex (x, y, r, g, b, a). */
+
 
 /* for interference. */
 static int interference_layer = 0; /**< Layer of the current interference. */
@@ -89,6 +92,12 @@ static gl_vbo *gui_planet_vbo = NULL;
 static gl_vbo *gui_radar_select_vbo = NULL;
 static gl_vbo *gui_planet_blink_vbo = NULL;
 
+/* Radar contacts, drawn in a single pass per primitive type. */
+static gl_vbo *gui_contacts_vbo = NULL; /**< Streaming VBO of the radar contacts. */
+static GLsizei gui_contacts_vboSize = 0; /**< Size of the contacts VBO (bytes). */
+static GLfloat *gui_contacts_lines = NULL; /**< Pilot outlines queued to be drawn (array.h). */
+static GLfloat *gui_contacts_quads = NULL; /**< Asteroid squares queued to be drawn (array.h). */
+
 static int gui_getMessage     = 1; /**< Whether or not the player should receive messages. */
 
 
@@ -102,6 +111,16 @@ static nlua_env gui_env = LUA_NOREF; /**< Current GUI Lua environment. */
 static int gui_L_mclick = 0; /**< Use mouse click callback. */
 static int gui_L_mmove = 0; /**< Use mouse movement callback. */
 
+/**
+ * Static layer, what the GUI draws in render_static() is kept until it changes.
+ */
+static int gui_static_use     = 0; /**< The GUI has a render_static function. */
+static int gui_static_dirty   = 1; /**< The static layer has to be drawn again. */
+static GLuint gui_static_fbo  = 0; /**< Framebuffer of the static layer. */
+static GLuint gui_static_tex  = 0; /**< Texture of the static layer. */
+static int gui_static_w       = 0; /**< Width of the static layer. */
+static int gui_static_h       = 0; /**< Height of the static layer. */
+
 
 /**
  * Cropping.
@@ -233,12 +252,16 @@ static void gui_borderIntersection( double *cx, double *cy, double rx, double ry
 static void gui_renderPilotTarget( double dt );
 static void gui_renderPlanetTarget( double dt );
 static void gui_renderBorder( double dt );
+static void gui_renderStatic (void);
+static void gui_freeStatic (void);
 static void gui_renderMessages( double dt );
 static const glColour *gui_getPlanetColour( int i );
 static void gui_renderRadarOutOfRange( RadarShape sh, int w, int h, int cx, int cy, const glColour *col );
 static void gui_blink( int w, int h, int rc, int cx, int cy, GLfloat vr, RadarShape shape, const glColour *col, const double blinkInterval, const double blinkVar );
 static const glColour* gui_getPilotColour( const Pilot* p );
 static void gui_renderInterference (void);
+static void gui_contactVertex( GLfloat **buf, double x, double y, const glColour *c );
+static void gui_contactsUpload( const GLfloat *buf, int offset );
 static void gui_calcBorders (void);
 /* Lua GUI. */
 static int gui_doFunc( const char* func );
@@ -847,6 +870,93 @@ void gui_renderReticles( double dt )
 
 
 static int can_jump = 0; /**< Stores whether or not the player is able to jump. */
+/**
+ * @brief Renders the static layer of the GUI, drawing it again if needed.
+ *
+ * GUIs can put what only changes along with the player's ship, target,
+ *  cargo and such in render_static(), which is drawn once into a texture and
+ *  reused until one of those changes or gui.staticDirty() is called.
+ */
+static void gui_renderStatic (void)
+{
+   GLuint fbo;
+
+   if (!gui_static_use)
+      return;
+
+   /* Screen changed size. */
+   if ((gui_static_fbo == 0) || (gui_static_w != gl_screen.rw) ||
+         (gui_static_h != gl_screen.rh)) {
+      gui_freeStatic();
+      gl_fboCreate( &gui_static_fbo, &gui_static_tex, gl_screen.rw, gl_screen.rh );
+      gui_static_w = gl_screen.rw;
+      gui_static_h = gl_screen.rh;
+      gui_static_dirty = 1;
+   }
+
+   if (gui_static_dirty) {
+      gl_printBatchFlush();
+      fbo = gl_screen.current_fbo;
+      gl_screen.current_fbo = gui_static_fbo;
+      glBindFramebuffer( GL_FRAMEBUFFER, gui_static_fbo );
+      glClearColor( 0., 0., 0., 0. );
+      glClear( GL_COLOR_BUFFER_BIT );
+      glClearColor( 0., 0., 0., 1. );
+
+      /* Keep the alpha premultiplied so it blends like drawing directly. */
+      gl_blendFuncSeparate( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA );
+      if (gui_prepFunc( "render_static" )==0)
+         gui_runFunc( "render_static", 0, 0 );
+      gl_printBatchFlush();
+      gl_blendFuncSeparate( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA );
+
+      gl_screen.current_fbo = fbo;
+      glBindFramebuffer( GL_FRAMEBUFFER, fbo );
+      gui_static_dirty = 0;
+   }
+
+   /* Draw the layer over the whole screen. */
+   gl_blendFunc( GL_ONE, GL_ONE_MINUS_SRC_ALPHA );
+   gl_useProgram( shaders.texture.program );
+   gl_bindTexture( GL_TEXTURE_2D, gui_static_tex );
+   glEnableVertexAttribArray( shaders.texture.vertex );
+   gl_vboActivateAttribOffset( gl_squareVBO, shaders.texture.vertex,
+         0, 2, GL_FLOAT, 0 );
+   gl_uniformColor( shaders.texture.color, &cWhite );
+   gl_Matrix4_Uniform( shaders.texture.projection, gl_Matrix4_Ortho(0, 1, 0, 1, 1, -1) );
+   gl_Matrix4_Uniform( shaders.texture.tex_mat, gl_Matrix4_Identity() );
+   gl_drawArrays( GL_TRIANGLE_STRIP, 0, 4 );
+   glDisableVertexAttribArray( shaders.texture.vertex );
+   gl_useProgram( 0 );
+   gl_blendFuncSeparate( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA );
+   gl_checkErr();
+}
+
+
+/**
+ * @brief Frees the static layer of the GUI.
+ */
+static void gui_freeStatic (void)
+{
+   if (gui_static_fbo != 0) {
+      glDeleteFramebuffers( 1, &gui_static_fbo );
+      gl_deleteTextures( 1, &gui_static_tex );
+   }
+   gui_static_fbo = 0;
+   gui_static_tex = 0;
+   gui_static_dirty = 1;
+}
+
+
+/**
+ * @brief Makes the static layer of the GUI get drawn again.
+ */
+void gui_staticDirty (void)
+{
+   gui_static_dirty = 1;
+}
+
+
 /**
  * @brief Renders the player's GUI.
  *
@@ -894,6 +1004,7 @@ void gui_render( double dt )
 
    /* Run Lua. */
    if (gui_env != LUA_NOREF) {
+      gui_renderStatic();
       if (gui_prepFunc( "render" )==0) {
          lua_pushnumber( naevL, dt );
          lua_pushnumber( naevL, dt_mod );
@@ -908,12 +1019,11 @@ void gui_render( double dt )
       }
    }
 
-   /* Messages. */
+   /* Messages and OSD, mostly text. */
+   gl_printBatchStart();
    gui_renderMessages(dt);
-
-
-   /* OSD. */
    osd_render();
+   gl_printBatchEnd();
 
    /* Noise when getting near a jump. */
    if (player.p->nav_hyperspace >= 0) { /* hyperspace target */
@@ -941,7 +1051,7 @@ void gui_render( double dt )
    /* Perform the fade. */
    if (fade > 0.) {
       /* Set up the program. */
-      glUseProgram( shaders.jump.program );
+      gl_useProgram( shaders.jump.program );
       glEnableVertexAttribArray( shaders.jump.vertex );
       gl_vboActivateAttribOffset( gl_squareVBO, shaders.jump.vertex, 0, 2, GL_FLOAT, 0 );
 
@@ -964,11 +1074,11 @@ void gui_render( double dt )
       }
 
       /* Draw. */
-      glDrawArrays( GL_TRIANGLE_STRIP, 0, 4 );
+      gl_drawArrays( GL_TRIANGLE_STRIP, 0, 4 );
 
       /* Clear state. */
       glDisableVertexAttribArray( shaders.jump.vertex );
-      glUseProgram(0);
+      gl_useProgram(0);
 
       /* Check errors. */
       gl_checkErr();
@@ -1144,6 +1254,7 @@ void gui_radarRender( double x, double y )
       for (j=0; j<ast->nb; j++)
          gui_renderAsteroid( &ast->asteroids[j], radar->w, radar->h, radar->res, 0 );
    }
+   gui_renderContacts();
 
    /* Interference. */
    gui_renderInterference();
@@ -1285,7 +1396,7 @@ static void gui_renderInterference (void)
 
    /* Calculate frame to draw. */
    if (interference_t > INTERFERENCE_CHANGE_DT) { /* Time to change */
-      t = RNG(0, INTERFERENCE_LAYERS-1);
+      t = RNG_COSMETIC(0, INTERFERENCE_LAYERS-1);
       if (t != interference_layer)
          interference_layer = t;
       else
@@ -1338,8 +1449,11 @@ static const glColour* gui_getPilotColour( const Pilot* p )
  */
 void gui_renderPilot( const Pilot* p, RadarShape shape, double w, double h, double res, int overlay )
 {
-   int x, y;
-   double scale;
+   /* Same triangle as gl_renderTriangleEmpty(), before halving. */
+   static const double tri[3][2] = {
+      { -0.5, -0.866025403784 }, { 1., 0. }, { -0.5, 0.866025403784 } };
+   int i, x, y;
+   double scale, c, s, vx[3], vy[3];
    glColour col;
 
    /* Make sure is in range. */
@@ -1394,10 +1508,17 @@ void gui_renderPilot( const Pilot* p, RadarShape shape, double w, double h, doub
       // col = cRadar_hilight;
    col.a = 1.-interference_alpha;
 
-   glLineWidth( 2. );
-   gl_renderTriangleEmpty( x, y, p->solid->dir, scale, 1., &cBlack );
-   glLineWidth( 1. );
-   gl_renderTriangleEmpty( x, y, p->solid->dir, scale, 1., &col );
+   /* Queue the outline, drawn by gui_renderContacts(). */
+   c = cos( p->solid->dir ) * scale / 2.;
+   s = sin( p->solid->dir ) * scale / 2.;
+   for (i=0; i<3; i++) {
+      vx[i] = x + c*tri[i][0] - s*tri[i][1];
+      vy[i] = y + s*tri[i][0] + c*tri[i][1];
+   }
+   for (i=0; i<3; i++) {
+      gui_contactVertex( &gui_contacts_lines, vx[i], vy[i], &col );
+      gui_contactVertex( &gui_contacts_lines, vx[(i+1)%3], vy[(i+1)%3], &col );
+   }
 
    /* Draw name. */
    if (overlay && pilot_isFlag(p, PILOT_HILIGHT))
@@ -1417,7 +1538,7 @@ void gui_renderPilot( const Pilot* p, RadarShape shape, double w, double h, doub
 void gui_renderAsteroid( const Asteroid* a, double w, double h, double res, int overlay )
 {
    int x, y, sx, sy, i, j, targeted;
-   double px, py;
+   double px, py, qw, qh;
    const glColour *col;
    glColour ccol;
 
@@ -1470,7 +1591,16 @@ void gui_renderAsteroid( const Asteroid* a, double w, double h, double res, int
    ccol.g = col->g;
    ccol.b = col->b;
    ccol.a = 1.-interference_alpha;
-   gl_renderRect( px, py, MIN( 2*sx, w-px ), MIN( 2*sy, h-py ), &ccol );
+
+   /* Queue the square, drawn by gui_renderContacts(). */
+   qw = MIN( 2*sx, w-px );
+   qh = MIN( 2*sy, h-py );
+   gui_contactVertex( &gui_contacts_quads, px,    py,    &ccol );
+   gui_contactVertex( &gui_contacts_quads, px+qw, py,    &ccol );
+   gui_contactVertex( &gui_contacts_quads, px,    py+qh, &ccol );
+   gui_contactVertex( &gui_contacts_quads, px+qw, py,    &ccol );
+   gui_contactVertex( &gui_contacts_quads, px+qw, py+qh, &ccol );
+   gui_contactVertex( &gui_contacts_quads, px,    py+qh, &ccol );
 
    if (targeted){
       gui_blink( w, h, 0, x, y, 12, RADAR_RECT, &ccol, RADAR_BLINK_PILOT, blink_pilot );
@@ -1478,6 +1608,108 @@ void gui_renderAsteroid( const Asteroid* a, double w, double h, double res, int
 }
 
 
+/**
+ * @brief Queues a vertex of a radar contact.
+ */
+static void gui_contactVertex( GLfloat **buf, double x, double y, const glColour *c )
+{
+   int n;
+   GLfloat *v;
+
+   n = array_size( *buf );
+   array_resize( buf, n+RADAR_VERTEX_FLOATS );
+   v = &(*buf)[n];
+   v[0] = x;
+   v[1] = y;
+   v[2] = c->r;
+   v[3] = c->g;
+   v[4] = c->b;
+   v[5] = c->a;
+}
+
+
+/**
+ * @brief Uploads queued contacts to the contacts VBO.
+ *
+ *    @param buf Contacts to upload.
+ *    @param offset Offset to upload at (bytes).
+ */
+static void gui_contactsUpload( const GLfloat *buf, int offset )
+{
+   gl_vboSubData( gui_contacts_vbo, offset,
+         sizeof(GLfloat) * array_size(buf), (void*) buf );
+}
+
+
+/**
+ * @brief Draws the radar contacts queued by gui_renderPilot() and
+ *        gui_renderAsteroid().
+ *
+ * Contacts are batched so that the whole radar takes a draw per primitive type
+ *  instead of a few per contact.
+ */
+void gui_renderContacts (void)
+{
+   int nlines, nquads;
+   GLsizei size, stride;
+
+   nlines = array_size( gui_contacts_lines ) / RADAR_VERTEX_FLOATS;
+   nquads = array_size( gui_contacts_quads ) / RADAR_VERTEX_FLOATS;
+   if ((nlines == 0) && (nquads == 0))
+      return;
+
+   /* Grow the VBO as needed, it is reused between frames. */
+   size = sizeof(GLfloat) * RADAR_VERTEX_FLOATS * (nlines + nquads);
+   if (gui_contacts_vbo == NULL) {
+      gui_contacts_vboSize = MAX( size, (GLsizei)(sizeof(GLfloat) * RADAR_VERTEX_FLOATS * 1024) );
+      gui_contacts_vbo = gl_vboCreateStream( gui_contacts_vboSize, NULL );
+   }
+   else if (size > gui_contacts_vboSize) {
+      gui_contacts_vboSize = MAX( size, 2*gui_contacts_vboSize );
+      gl_vboData( gui_contacts_vbo, gui_contacts_vboSize, NULL );
+   }
+   if (nquads > 0)
+      gui_contactsUpload( gui_contacts_quads, 0 );
+   if (nlines > 0)
+      gui_contactsUpload( gui_contacts_lines,
+            sizeof(GLfloat) * RADAR_VERTEX_FLOATS * nquads );
+   stride = sizeof(GLfloat) * RADAR_VERTEX_FLOATS;
+
+   /* Asteroids go below the pilots. */
+   if (nquads > 0) {
+      gl_beginSmoothProgram( gl_view_matrix );
+      gl_vboActivateAttribOffset( gui_contacts_vbo, shaders.smooth.vertex,
+            0, 2, GL_FLOAT, stride );
+      gl_vboActivateAttribOffset( gui_contacts_vbo, shaders.smooth.vertex_color,
+            sizeof(GLfloat) * 2, 4, GL_FLOAT, stride );
+      gl_drawArrays( GL_TRIANGLES, 0, nquads );
+      gl_endSmoothProgram();
+   }
+
+   /* Pilots get a black border drawn with the same vertices. */
+   if (nlines > 0) {
+      glLineWidth( 2. );
+      gl_beginSolidProgram( gl_view_matrix, &cBlack );
+      gl_vboActivateAttribOffset( gui_contacts_vbo, shaders.solid.vertex,
+            stride * nquads, 2, GL_FLOAT, stride );
+      gl_drawArrays( GL_LINES, 0, nlines );
+      gl_endSolidProgram();
+      glLineWidth( 1. );
+
+      gl_beginSmoothProgram( gl_view_matrix );
+      gl_vboActivateAttribOffset( gui_contacts_vbo, shaders.smooth.vertex,
+            stride * nquads, 2, GL_FLOAT, stride );
+      gl_vboActivateAttribOffset( gui_contacts_vbo, shaders.smooth.vertex_color,
+            stride * nquads + sizeof(GLfloat) * 2, 4, GL_FLOAT, stride );
+      gl_drawArrays( GL_LINES, 0, nlines );
+      gl_endSmoothProgram();
+   }
+
+   array_resize( &gui_contacts_lines, 0 );
+   array_resize( &gui_contacts_quads, 0 );
+}
+
+
 /**
  * @brief Renders the player cross on the radar or whatever.
  */
@@ -1562,7 +1794,7 @@ static void gui_blink( int w, int h, int rc, int cx, int cy, GLfloat vr, RadarSh
       projection = gl_Matrix4_Scale(projection, vr, vr, 1);
       gl_beginSolidProgram(projection, col);
       gl_vboActivateAttribOffset( gui_planet_blink_vbo, shaders.solid.vertex, 0, 2, GL_FLOAT, 0 );
-      glDrawArrays( GL_LINES, 0, 8 );
+      gl_drawArrays( GL_LINES, 0, 8 );
       gl_endSolidProgram();
    }
 }
@@ -1686,7 +1918,7 @@ void gui_renderPlanet( int ind, RadarShape shape, double w, double h, double res
    /*
    gl_beginSolidProgram(gl_Matrix4_Scale(gl_Matrix4_Translate(gl_view_matrix, cx, cy, 0), vr, vr, 1), &col);
    gl_vboActivateAttribOffset( gui_planet_vbo, shaders.solid.vertex, 0, 2, GL_FLOAT, 0 );
-   glDrawArrays( GL_LINE_STRIP, 0, 5 );
+   gl_drawArrays( GL_LINE_STRIP, 0, 5 );
    gl_endSolidProgram();
    */
    gl_drawCircle( cx - 1, cy, vr/2.5, &cBlack, 0 );
@@ -1952,6 +2184,11 @@ int gui_init (void)
       gui_planet_blink_vbo = gl_vboCreateStatic( sizeof(GLfloat) * 16, vertex );
    }
 
+   if (gui_contacts_lines == NULL) {
+      gui_contacts_lines = array_create_size( GLfloat, 256*RADAR_VERTEX_FLOATS );
+      gui_contacts_quads = array_create_size( GLfloat, 256*RADAR_VERTEX_FLOATS );
+   }
+
    /*
     * OSD
     */
@@ -1965,7 +2202,7 @@ int gui_init (void)
    /*
     * Icons.
     */
-   gui_ico_hail = gl_newSprite( GUI_GFX_PATH"hail.png", 5, 2, 0 );
+   gui_ico_hail = gl_newSprite( GUI_GFX_PATH"hail.png", 5, 2, OPENGL_TEX_ATLAS );
 
    return 0;
 }
@@ -2054,6 +2291,7 @@ void gui_reload (void)
  */
 void gui_setCargo (void)
 {
+   gui_static_dirty = 1;
    if (gui_env != LUA_NOREF)
       gui_doFunc( "update_cargo" );
 }
@@ -2064,6 +2302,7 @@ void gui_setCargo (void)
  */
 void gui_setNav (void)
 {
+   gui_static_dirty = 1;
    if (gui_env != LUA_NOREF)
       gui_doFunc( "update_nav" );
 }
@@ -2074,6 +2313,7 @@ void gui_setNav (void)
  */
 void gui_setTarget (void)
 {
+   gui_static_dirty = 1;
    if (gui_env != LUA_NOREF)
       gui_doFunc( "update_target" );
 }
@@ -2084,6 +2324,7 @@ void gui_setTarget (void)
  */
 void gui_setShip (void)
 {
+   gui_static_dirty = 1;
    if (gui_env != LUA_NOREF)
       gui_doFunc( "update_ship" );
 }
@@ -2094,6 +2335,7 @@ void gui_setShip (void)
  */
 void gui_setSystem (void)
 {
+   gui_static_dirty = 1;
    if (gui_env != LUA_NOREF)
       gui_doFunc( "update_system" );
 }
@@ -2104,6 +2346,7 @@ void gui_setSystem (void)
  */
 void gui_updateFaction (void)
 {
+   gui_static_dirty = 1;
    if (gui_env != LUA_NOREF && player.p->nav_planet != -1)
       gui_doFunc( "update_faction" );
 }
@@ -2200,6 +2443,13 @@ int gui_load( const char* name )
       gui_env = LUA_NOREF;
    }
 
+   /* See if the GUI has a static layer. */
+   if (gui_env != LUA_NOREF) {
+      nlua_getenv( gui_env, "render_static" );
+      gui_static_use = !lua_isnil( naevL, -1 );
+      lua_pop( naevL, 1 );
+   }
+
    /* Recreate land window if landed. */
    if (landed) {
       land_genWindows( 0, 1 );
@@ -2301,6 +2551,10 @@ void gui_cleanup (void)
    gui_mouseClickEnable( 0 );
    gui_mouseMoveEnable( 0 );
 
+   /* Static layer. */
+   gui_static_use = 0;
+   gui_freeStatic();
+
    /* Interference. */
    for (i=0; i<INTERFERENCE_LAYERS; i++) {
       gl_freeTexture(gui_radar.interference[i]);
@@ -2349,6 +2603,13 @@ void gui_free (void)
    gui_radar_select_vbo = NULL;
    gl_vboDestroy( gui_planet_blink_vbo );
    gui_planet_blink_vbo = NULL;
+   gl_vboDestroy( gui_contacts_vbo );
+   gui_contacts_vbo = NULL;
+   gui_contacts_vboSize = 0;
+   array_free( gui_contacts_lines );
+   gui_contacts_lines = NULL;
+   array_free( gui_contacts_quads );
+   gui_contacts_quads = NULL;
 
    osd_exit();
 
@@ -93,6 +93,7 @@ void gui_renderJumpPoint( int ind, RadarShape shape, double w, double h, double
 void gui_renderPilot( const Pilot* p, RadarShape shape, double w, double h, double res, int overlay );
 void gui_renderAsteroid( const Asteroid* a, double w, double h, double res, int overlay );
 void gui_renderPlayer( double res, int overlay );
+void gui_renderContacts (void);
 
 
 /*
@@ -113,6 +114,7 @@ void gui_mouseMoveEnable( int enabel );
 /*
  * misc
  */
+void gui_staticDirty (void);
 void gui_setViewport( double x, double y, double w, double h );
 void gui_clearViewport (void);
 void gui_setDefaults (void);
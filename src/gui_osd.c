@@ -30,6 +30,7 @@ typedef struct OSD_s {
    char ***items; /**< Array of array (array.h) of allocated strings. */
 
    unsigned int active; /**< Active item. */
+   int duplicates; /**< Identical OSD shown merged into this one, -1 if merged into another. */
 } OSD_t;
 
 
@@ -352,18 +353,24 @@ int osd_getActive( unsigned int osd )
  */
 int osd_setup( int x, int y, int w, int h )
 {
-   int i, must_rewrap;
+   int i, must_rewrap, tabLen, hyphenLen;
+
+   /* Calculate some font things. */
+   tabLen = gl_printWidthRaw( &gl_smallFont, "   " );
+   hyphenLen = gl_printWidthRaw( &gl_smallFont, "- " );
+
+   /* Only rewrap when the width or font changed. */
+   must_rewrap = ((osd_w != w) || (osd_tabLen != tabLen) ||
+         (osd_hyphenLen != hyphenLen)) && (osd_list != NULL);
+
    /* Set offsets. */
-   must_rewrap = (osd_w != w) && (osd_list != NULL);
    osd_x = x;
    osd_y = y;
    osd_w = w;
    osd_lines = h / (gl_smallFont.h+5);
    osd_h = h - h % (gl_smallFont.h+5);
-
-   /* Calculate some font things. */
-   osd_tabLen = gl_printWidthRaw( &gl_smallFont, "   " );
-   osd_hyphenLen = gl_printWidthRaw( &gl_smallFont, "- " );
+   osd_tabLen = tabLen;
+   osd_hyphenLen = hyphenLen;
 
    if (must_rewrap)
       for (i=0; i<array_size(osd_list); i++)
@@ -394,26 +401,23 @@ void osd_exit (void)
 
 /**
  * @brief Renders all the OSD.
+ *
+ * Items are word-wrapped and duplicates merged when the OSD change, so this
+ *  only prints the stored lines.
  */
 void osd_render (void)
 {
    OSD_t *ll;
    double p;
-   int i, j, k, l, m;
+   int i, j, k, l;
    int w, x;
    const glColour *c;
-   int *ignore;
-   int nignore;
-   int is_duplicate, duplicates;
    char title[1024];
 
    /* Nothing to render. */
    if (osd_list == NULL)
       return;
 
-   nignore = array_size(osd_list);
-   ignore  = calloc( nignore, sizeof( int ) );
-
    /* Background. */
    gl_renderRect( osd_x-5., osd_y-(osd_rh+5.), osd_w+10., osd_rh+10, &cBlackHilight );
 
@@ -421,54 +425,24 @@ void osd_render (void)
    p = osd_y-gl_smallFont.h;
    l = 0;
    for (k=0; k<array_size(osd_list); k++) {
-      if (ignore[k])
+      ll = &osd_list[k];
+      if (ll->duplicates < 0)
          continue;
 
-      ll = &osd_list[k];
       x = osd_x;
       w = osd_w;
 
-      /* Check how many duplicates we have, mark duplicates for ignoring */
-      duplicates = 0;
-      for (m=k+1; m<array_size(osd_list); m++) {
-         if ((strcmp(osd_list[m].title, ll->title) == 0) &&
-               (array_size(osd_list[m].items) == array_size(ll->items)) &&
-               (osd_list[m].active == ll->active)) {
-            is_duplicate = 1;
-            for (i=osd_list[m].active; i<array_size(osd_list[m].items); i++) {
-               if (array_size(osd_list[m].items[i]) == array_size(ll->items[i])) {
-                  for (j=0; j<array_size(osd_list[m].items[i]); j++) {
-                     if (strcmp(osd_list[m].items[i][j], ll->items[i][j]) != 0 ) {
-                        is_duplicate = 0;
-                        break;
-                     }
-                  }
-               } else {
-                  is_duplicate = 0;
-               }
-               if (!is_duplicate)
-                  break;
-            }
-            if (is_duplicate) {
-               duplicates++;
-               ignore[m] = 1;
-            }
-         }
-      }
-
       /* Print title. */
-      if (duplicates > 0)
-         snprintf( title, sizeof(title), "%s (%d)", ll->title, duplicates + 1 );
+      if (ll->duplicates > 0) {
+         snprintf( title, sizeof(title), "%s (%d)", ll->title, ll->duplicates + 1 );
+         gl_printMaxRaw( &gl_smallFont, w, x, p, NULL, -1., title);
+      }
       else
-         strncpy( title, ll->title, sizeof(title)-1 );
-      title[sizeof(title)-1] = '\0';
-      gl_printMaxRaw( &gl_smallFont, w, x, p, NULL, -1., title);
+         gl_printMaxRaw( &gl_smallFont, w, x, p, NULL, -1., ll->title);
       p -= gl_smallFont.h + 5.;
       l++;
-      if (l >= osd_lines) {
-         free(ignore);
+      if (l >= osd_lines)
          return;
-      }
 
       /* Print items. */
       for (i=ll->active; i<array_size(ll->items); i++) {
@@ -484,49 +458,44 @@ void osd_render (void)
             }
             p -= gl_smallFont.h + 5.;
             l++;
-            if (l >= osd_lines) {
-               free(ignore);
+            if (l >= osd_lines)
                return;
-            }
          }
       }
    }
-
-   free(ignore);
 }
 
 
 /**
  * @brief Calculates and sets the length of the OSD.
+ *
+ * Also merges identical OSD, which osd_render() relies on.
  */
 static void osd_calcDimensions (void)
 {
    OSD_t *ll;
    int i, j, k, m;
    double len;
-   int *ignore;
-   int nignore;
-   int is_duplicate, duplicates;
+   int is_duplicate;
 
    /* Nothing to render. */
    if (osd_list == NULL)
       return;
 
-   nignore = array_size(osd_list);
-   ignore  = calloc( nignore, sizeof( int ) );
+   for (k=0; k<array_size(osd_list); k++)
+      osd_list[k].duplicates = 0;
 
    /* Render each thingy. */
    len = 0;
    for (k=0; k<array_size(osd_list); k++) {
-      if (ignore[k])
-         continue;
-
       ll = &osd_list[k];
+      if (ll->duplicates < 0)
+         continue;
 
       /* Check how many duplicates we have, mark duplicates for ignoring */
-      duplicates = 0;
       for (m=k+1; m<array_size(osd_list); m++) {
-         if ((strcmp(osd_list[m].title, ll->title) == 0) &&
+         if ((osd_list[m].duplicates == 0) &&
+               (strcmp(osd_list[m].title, ll->title) == 0) &&
                (array_size(osd_list[m].items) == array_size(ll->items)) &&
                (osd_list[m].active == ll->active)) {
             is_duplicate = 1;
@@ -545,8 +514,8 @@ static void osd_calcDimensions (void)
                   break;
             }
             if (is_duplicate) {
-               duplicates++;
-               ignore[m] = 1;
+               ll->duplicates++;
+               osd_list[m].duplicates = -1;
             }
          }
       }
@@ -560,7 +529,6 @@ static void osd_calcDimensions (void)
             len += gl_smallFont.h + 5.;
    }
    osd_rh = MIN( len, osd_h );
-   free(ignore);
 }
 
 
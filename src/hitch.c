@@ -0,0 +1,191 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+
+/**
+ * @file hitch.c
+ *
+ * @brief Captures the frames leading up to a hitch.
+ *
+ * A few numbers are kept for each of the last frames: their length, the time
+ *  spent in scripts and collecting garbage, the Lua allocations and, with the
+ *  profiler build option, the CPU zones. This is cheap enough to always be on.
+ *  When a frame takes longer than the configured threshold, the kept frames
+ *  are written to a CSV file in the hitches directory of the cache, along
+ *  with the current system and number of pilots, so stutters seen by players
+ *  can be sent to us and looked at.
+ *
+ * Captures are limited in number and frequency, so loading screens or a slow
+ *  machine don't fill the cache.
+ */
+
+
+/** @cond */
+#include <stdio.h>
+#include <time.h>
+#include "SDL.h"
+
+#include "naev.h"
+/** @endcond */
+
+#include "hitch.h"
+
+#include "array.h"
+#include "conf.h"
+#include "log.h"
+#include "memtrack.h"
+#include "nfile.h"
+#include "nlua.h"
+#include "pilot.h"
+#include "profile.h"
+#include "space.h"
+
+
+#define HITCH_FRAMES    240 /**< Frames kept, a few seconds worth. */
+#define HITCH_COOLDOWN  10000. /**< Minimum time between captures (ms). */
+#define HITCH_MAX       10 /**< Maximum captures per session. */
+
+
+/**
+ * @brief What is kept of a frame.
+ */
+typedef struct HitchFrame_ {
+   double time; /**< Time the frame ended at (ms). */
+   double dt; /**< Length of the frame (ms). */
+   double lua; /**< Time spent in scripts (ms). */
+   double gc; /**< Time spent in paced garbage collection (ms). */
+   unsigned int allocs; /**< Lua allocations. */
+   int pilots; /**< Pilots in the system. */
+#ifdef PROFILING
+   double zones[PROFILE_ZONES]; /**< Time of the CPU zones (ms). */
+#endif /* PROFILING */
+} HitchFrame;
+
+
+static HitchFrame hitch_frames[HITCH_FRAMES]; /**< Ring buffer of the last frames. */
+static unsigned int hitch_count = 0; /**< Frames recorded so far. */
+static unsigned int hitch_allocs = 0; /**< Lua allocations at the end of the last frame. */
+static double hitch_time = 0.; /**< Time recorded so far (ms). */
+static double hitch_last = -HITCH_COOLDOWN; /**< Time of the last capture (ms). */
+static int hitch_dumps = 0; /**< Captures written. */
+
+
+/*
+ * Prototypes.
+ */
+static void hitch_dump( const HitchFrame *hitch );
+
+
+/**
+ * @brief Writes the kept frames to a capture.
+ *
+ *    @param hitch Frame that hitched.
+ */
+static void hitch_dump( const HitchFrame *hitch )
+{
+   char dir[PATH_MAX], path[PATH_MAX], timestr[20];
+   const char *name;
+   time_t cur;
+   FILE *f;
+   unsigned int i, n, first;
+   size_t used, peak;
+   const HitchFrame *h;
+#ifdef PROFILING
+   int j, zones;
+   double ms;
+#endif /* PROFILING */
+
+   time( &cur );
+   strftime( timestr, sizeof(timestr), "%Y-%m-%d_%H-%M-%S", localtime( &cur ) );
+   snprintf( dir, sizeof(dir), "%shitches/", nfile_cachePath() );
+   nfile_dirMakeExist( dir );
+   snprintf( path, sizeof(path), "%s%s.csv", dir, timestr );
+   f = fopen( path, "w" );
+   if (f == NULL) {
+      WARN(_("Unable to open '%s' for writing!"), path);
+      return;
+   }
+
+   /* What was going on. */
+   fprintf( f, "# Naev %s hitch capture\n", naev_version( 1 ) );
+   fprintf( f, "# frame: %.3f ms (threshold %d ms)\n", hitch->dt, conf.hitch_ms );
+   fprintf( f, "# system: %s\n", (cur_system != NULL) ? cur_system->name : "none" );
+   fprintf( f, "# pilots: %d\n", array_size( pilot_getAll() ) );
+   for (i=0; memtrack_get( i, &name, &used, &peak )==0; i++)
+      fprintf( f, "# memory %s: %.2f MiB\n", name, used / 1048576. );
+
+   /* The frames, oldest first. */
+   fprintf( f, "time,dt,lua,gc,allocs,pilots" );
+#ifdef PROFILING
+   zones = (profile_getFrame( 0, &name, &ms )==0);
+   for (j=0; zones && (j<PROFILE_ZONES); j++) {
+      profile_getFrame( j, &name, &ms );
+      fprintf( f, ",%s", name );
+   }
+#endif /* PROFILING */
+   fprintf( f, "\n" );
+   n     = MIN( hitch_count, HITCH_FRAMES );
+   first = hitch_count - n;
+   for (i=first; i<hitch_count; i++) {
+      h = &hitch_frames[ i % HITCH_FRAMES ];
+      fprintf( f, "%.3f,%.3f,%.3f,%.3f,%u,%d", h->time, h->dt, h->lua, h->gc,
+            h->allocs, h->pilots );
+#ifdef PROFILING
+      for (j=0; zones && (j<PROFILE_ZONES); j++)
+         fprintf( f, ",%.3f", h->zones[j] );
+#endif /* PROFILING */
+      fprintf( f, "\n" );
+   }
+   fclose( f );
+
+   LOG(_("Frame took %.0f ms, hitch capture saved to '%s'."), hitch->dt, path);
+}
+
+
+/**
+ * @brief Records a frame, capturing the last frames if it was too long.
+ *
+ *    @param ms Length of the frame (ms), measured around main_loop().
+ */
+void hitch_frame( double ms )
+{
+   HitchFrame *h;
+   const NluaAllocStats *as;
+   const NluaGCStats *gs;
+   unsigned int allocs;
+#ifdef PROFILING
+   int i;
+   const char *name;
+#endif /* PROFILING */
+
+   hitch_time += ms;
+
+   /* Lua stats are cumulative. */
+   as     = nlua_allocStats();
+   gs     = nlua_gcStats();
+   allocs = as->pooled + as->large;
+
+   h = &hitch_frames[ hitch_count % HITCH_FRAMES ];
+   h->time     = hitch_time;
+   h->dt       = ms;
+   h->lua      = nlua_scriptTime();
+   h->gc       = 1000. * gs->pause_last;
+   h->allocs   = allocs - hitch_allocs;
+   h->pilots   = array_size( pilot_getAll() );
+#ifdef PROFILING
+   for (i=0; i<PROFILE_ZONES; i++)
+      if (profile_getFrame( i, &name, &h->zones[i] ))
+         h->zones[i] = 0.;
+#endif /* PROFILING */
+   hitch_allocs = allocs;
+   hitch_count++;
+
+   /* Check for a hitch. */
+   if ((conf.hitch_ms <= 0) || (ms < (double)conf.hitch_ms))
+      return;
+   if ((hitch_dumps >= HITCH_MAX) || (hitch_time - hitch_last < HITCH_COOLDOWN))
+      return;
+   hitch_last = hitch_time;
+   hitch_dumps++;
+   hitch_dump( h );
+}
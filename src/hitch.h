@@ -0,0 +1,14 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+
+
+
+#ifndef HITCH_H
+#  define HITCH_H
+
+
+void hitch_frame( double ms );
+
+
+#endif /* HITCH_H */
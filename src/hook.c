@@ -31,6 +31,7 @@
 
 #include "hook.h"
 
+#include "array.h"
 #include "claim.h"
 #include "event.h"
 #include "log.h"
@@ -42,6 +43,7 @@
 #include "nxml.h"
 #include "player.h"
 #include "space.h"
+#include "strindex.h"
 
 
 /**
@@ -58,6 +60,10 @@ static int hook_atomic           = 0; /**< Whether or not hooks should be queued
 static ntime_t hook_time_accum   = 0; /**< Time accumulator. */
 
 
+#define HOOK_REST_PERIOD   30. /**< Real seconds between looking for missions and events that can rest. */
+static double hook_rest_timer    = HOOK_REST_PERIOD; /**< Real time until the next look. */
+
+
 /**
  * @brief Types of hook.
  */
@@ -76,9 +82,11 @@ typedef enum HookType_e {
  */
 typedef struct Hook_ {
    struct Hook_ *next; /**< Linked list. */
+   struct Hook_ *snext; /**< Linked list of the hooks of the same stack. */
 
    unsigned int id; /**< unique id */
    char *stack; /**< stack it's a part of */
+   int stackid; /**< Index of the stack in hook_stacks. */
    int created; /**< Hook has just been created. */
    int delete; /**< indicates it should be deleted when possible */
    int ran_once; /**< Indicates if the hook already ran, useful when iterating. */
@@ -86,13 +94,20 @@ typedef struct Hook_ {
 
    /* Timer information. */
    int is_timer; /**< Whether or not is actually a timer. */
-   double ms; /**< Milliseconds left. */
+   double expire; /**< Value of hook_timerClock at which the timer runs. */
+   int heap; /**< Position in hook_timers, -1 if not in it. */
 
    /* Date information. */
    int is_date; /**< Whether or not it is a date hook. */
    ntime_t res; /**< Resolution to display. */
    ntime_t acc; /**< Accumulated resolution. */
 
+   /* Interval information. */
+   double interval; /**< Seconds between runs of an update hook, 0. to run every update. */
+   int interval_real; /**< Whether the interval is in real time instead of game time. */
+   double acc_dt; /**< Game time accumulated since the last run. */
+   double acc_rdt; /**< Real time accumulated since the last run. */
+
    HookType_t type; /**< Type of hook. */
    union {
       struct {
@@ -116,24 +131,63 @@ static int hook_runningstack  = 0; /**< Check if stack is running. */
 static int hook_loadingstack  = 0; /**< Check if the hooks are being loaded. */
 
 
+/**
+ * @brief Hooks of a stack.
+ *
+ * Every hook is both in hook_list and in the list of its stack, in the same
+ *  order, so running a stack only has to go over its own hooks.
+ */
+typedef struct HookStack_ {
+   char *name; /**< Name of the stack. */
+   Hook *list; /**< Hooks of the stack, linked by snext. */
+} HookStack;
+static HookStack *hook_stacks = NULL; /**< Stacks that have had hooks (array.h). */
+static StrIndex hook_stackIndex; /**< Looks up stacks by name. */
+
+
+/*
+ * Timers are kept in a binary min-heap by expiry so that updating only has to
+ * look at the timers that are due. Timers created during an update wait in
+ * hook_timersNew until the next one, like other newly created hooks.
+ */
+static Hook **hook_timers     = NULL; /**< Heap of pending timers (array.h). */
+static Hook **hook_timersNew  = NULL; /**< Timers created since the last update (array.h). */
+static Hook **hook_timersDue  = NULL; /**< Timers being run (array.h). */
+static double hook_timerClock = 0.; /**< Milliseconds the timers have been updated for. */
+
+
 /*
  * prototypes
  */
 /* Execution. */
 static int hooks_executeParam( const char* stack, HookParam *param );
 static void hooks_updateDateExecute( ntime_t change );
+static void hook_intervalAccumulate( Hook *h, const HookParam *param );
+static int hook_intervalDue( Hook *h, HookParam *iparam );
 /* intern */
 static void hook_rmRaw( Hook *h );
 static void hooks_purgeList (void);
 static Hook* hook_get( unsigned int id );
 static unsigned int hook_genID (void);
 static Hook* hook_new( HookType_t type, const char *stack );
+static int hook_getStack( const char *stack );
+static int hook_stackID( const char *stack );
+static unsigned int hook_addTimer( HookType_t type, unsigned int parent,
+      const char *func, double ms );
+/* Timer heap. */
+static void hook_timerSwap( int a, int b );
+static void hook_timerUp( int i );
+static void hook_timerDown( int i );
+static void hook_timerPush( Hook *h );
+static void hook_timerRemove( Hook *h );
+static int hook_cmpNewest( const void *p1, const void *p2 );
 static int hook_parseParam( lua_State *L, HookParam *param );
 static int hook_runMisn( Hook *hook, HookParam *param, int claims );
 static int hook_runEvent( Hook *hook, HookParam *param, int claims );
 static int hook_run( Hook *hook, HookParam *param, int claims );
 static void hook_free( Hook *h );
 static int hook_needSave( Hook *h );
+static int hook_canRest( Hook *h );
 static int hook_parse( xmlNodePtr base );
 /* externed */
 int hook_save( xmlTextWriterPtr writer );
@@ -459,6 +513,44 @@ static unsigned int hook_genID (void)
 }
 
 
+/**
+ * @brief Gets the index of a stack.
+ *
+ *    @param stack Name of the stack.
+ *    @return The index of the stack in hook_stacks or -1 if it has never had hooks.
+ */
+static int hook_getStack( const char *stack )
+{
+   return strindex_get( &hook_stackIndex, stack );
+}
+
+
+/**
+ * @brief Gets the index of a stack, creating it if needed.
+ *
+ *    @param stack Name of the stack.
+ *    @return The index of the stack in hook_stacks.
+ */
+static int hook_stackID( const char *stack )
+{
+   int id;
+   HookStack *hs;
+
+   id = hook_getStack( stack );
+   if (id >= 0)
+      return id;
+
+   if (hook_stacks == NULL)
+      hook_stacks = array_create( HookStack );
+   id = array_size( hook_stacks );
+   hs = &array_grow( &hook_stacks );
+   hs->name = strdup( stack );
+   hs->list = NULL;
+   strindex_add( &hook_stackIndex, hs->name, id );
+   return id;
+}
+
+
 /**
  * @brief Generates and allocates a new hook.
  *
@@ -486,6 +578,11 @@ static Hook* hook_new( HookType_t type, const char *stack )
    new_hook->stack   = strdup(stack);
    new_hook->created = 1;
 
+   /* Also put at the front of its stack to keep the same order. */
+   new_hook->stackid = hook_stackID( stack );
+   new_hook->snext   = hook_stacks[ new_hook->stackid ].list;
+   hook_stacks[ new_hook->stackid ].list = new_hook;
+
    /** @TODO fix this hack. */
    if (strcmp(stack,"safe")==0)
       new_hook->once = 1;
@@ -541,32 +638,58 @@ unsigned int hook_addEvent( unsigned int parent, const char *func, const char *s
 
 
 /**
- * @brief Adds a new mission type hook timer hook.
+ * @brief Adds a new timer hook.
  *
- *    @param parent Hook mission parent.
+ *    @param type Type of the hook.
+ *    @param parent Hook parent.
  *    @param func Function to run when hook is triggered.
- *    @param ms Milliseconds to wait
+ *    @param ms Milliseconds to wait.
  *    @return The new hook identifier.
  */
-unsigned int hook_addTimerMisn( unsigned int parent, const char *func, double ms )
+static unsigned int hook_addTimer( HookType_t type, unsigned int parent,
+      const char *func, double ms )
 {
    Hook *new_hook;
 
    /* Create the new hook. */
-   new_hook = hook_new( HOOK_TYPE_MISN, "timer" );
+   new_hook = hook_new( type, "timer" );
 
-   /* Put mission specific details. */
-   new_hook->u.misn.parent = parent;
-   new_hook->u.misn.func   = strdup(func);
+   /* Put type specific details. */
+   if (type == HOOK_TYPE_MISN) {
+      new_hook->u.misn.parent = parent;
+      new_hook->u.misn.func   = strdup(func);
+   }
+   else {
+      new_hook->u.event.parent = parent;
+      new_hook->u.event.func   = strdup(func);
+   }
 
-   /* Timer information. */
+   /* Timer information, gets into the heap on the next update. */
    new_hook->is_timer      = 1;
-   new_hook->ms            = ms;
+   new_hook->expire        = hook_timerClock + ms;
+   new_hook->heap          = -1;
+   if (hook_timersNew == NULL)
+      hook_timersNew = array_create( Hook* );
+   array_push_back( &hook_timersNew, new_hook );
 
    return new_hook->id;
 }
 
 
+/**
+ * @brief Adds a new mission type hook timer hook.
+ *
+ *    @param parent Hook mission parent.
+ *    @param func Function to run when hook is triggered.
+ *    @param ms Milliseconds to wait
+ *    @return The new hook identifier.
+ */
+unsigned int hook_addTimerMisn( unsigned int parent, const char *func, double ms )
+{
+   return hook_addTimer( HOOK_TYPE_MISN, parent, func, ms );
+}
+
+
 /**
  * @brief Adds a new event type hook timer.
  *
@@ -577,20 +700,115 @@ unsigned int hook_addTimerMisn( unsigned int parent, const char *func, double ms
  */
 unsigned int hook_addTimerEvt( unsigned int parent, const char *func, double ms )
 {
-   Hook *new_hook;
+   return hook_addTimer( HOOK_TYPE_EVENT, parent, func, ms );
+}
 
-   /* Create the new hook. */
-   new_hook = hook_new( HOOK_TYPE_EVENT, "timer" );
 
-   /* Put event specific details. */
-   new_hook->u.event.parent = parent;
-   new_hook->u.event.func   = strdup(func);
+/**
+ * @brief Swaps two timers in the heap.
+ */
+static void hook_timerSwap( int a, int b )
+{
+   Hook *h;
+   h              = hook_timers[a];
+   hook_timers[a] = hook_timers[b];
+   hook_timers[b] = h;
+   hook_timers[a]->heap = a;
+   hook_timers[b]->heap = b;
+}
 
-   /* Timer information. */
-   new_hook->is_timer      = 1;
-   new_hook->ms            = ms;
 
-   return new_hook->id;
+/**
+ * @brief Moves a timer up the heap until it's in place.
+ */
+static void hook_timerUp( int i )
+{
+   int p;
+   while (i > 0) {
+      p = (i-1) / 2;
+      if (hook_timers[p]->expire <= hook_timers[i]->expire)
+         break;
+      hook_timerSwap( i, p );
+      i = p;
+   }
+}
+
+
+/**
+ * @brief Moves a timer down the heap until it's in place.
+ */
+static void hook_timerDown( int i )
+{
+   int c, n;
+   n = array_size( hook_timers );
+   for (c=2*i+1; c<n; c=2*i+1) {
+      if ((c+1 < n) && (hook_timers[c+1]->expire < hook_timers[c]->expire))
+         c++;
+      if (hook_timers[i]->expire <= hook_timers[c]->expire)
+         break;
+      hook_timerSwap( i, c );
+      i = c;
+   }
+}
+
+
+/**
+ * @brief Adds a timer to the heap.
+ */
+static void hook_timerPush( Hook *h )
+{
+   if (hook_timers == NULL)
+      hook_timers = array_create( Hook* );
+   h->heap = array_size( hook_timers );
+   array_push_back( &hook_timers, h );
+   hook_timerUp( h->heap );
+}
+
+
+/**
+ * @brief Removes a timer from the heap or the new timers.
+ */
+static void hook_timerRemove( Hook *h )
+{
+   int i, n;
+
+   /* Not in the heap yet. */
+   if (h->heap < 0) {
+      for (i=0; i<array_size(hook_timersNew); i++) {
+         if (hook_timersNew[i] == h) {
+            array_erase( &hook_timersNew, &hook_timersNew[i], &hook_timersNew[i+1] );
+            break;
+         }
+      }
+      return;
+   }
+
+   i = h->heap;
+   n = array_size( hook_timers ) - 1;
+   if (i != n)
+      hook_timerSwap( i, n );
+   array_resize( &hook_timers, n );
+   h->heap = -1;
+   if (i != n) {
+      hook_timerUp( i );
+      hook_timerDown( i );
+   }
+}
+
+
+/**
+ * @brief Sorts hooks in the same order as hook_list, newest first.
+ */
+static int hook_cmpNewest( const void *p1, const void *p2 )
+{
+   const Hook *h1, *h2;
+   h1 = *(const Hook**) p1;
+   h2 = *(const Hook**) p2;
+   if (h1->id > h2->id)
+      return -1;
+   else if (h1->id < h2->id)
+      return +1;
+   return 0;
 }
 
 
@@ -599,12 +817,24 @@ unsigned int hook_addTimerEvt( unsigned int parent, const char *func, double ms
  */
 static void hooks_purgeList (void)
 {
-   Hook *h, *hl;
+   int i;
+   Hook *h, *hl, **hp;
 
    /* Do not run while stack is being run. */
    if (hook_runningstack)
       return;
 
+   /* First unlink from the stacks. */
+   for (i=0; i<array_size(hook_stacks); i++) {
+      hp = &hook_stacks[i].list;
+      while (*hp != NULL) {
+         if ((*hp)->delete)
+            *hp = (*hp)->snext;
+         else
+            hp = &(*hp)->snext;
+      }
+   }
+
    /* Second pass to delete. */
    hl = NULL;
    h  = hook_list;
@@ -612,6 +842,10 @@ static void hooks_purgeList (void)
       /* Find valid timer hooks. */
       if (h->delete) {
 
+         /* Timers can't be left in the heap. */
+         if (h->is_timer)
+            hook_timerRemove( h );
+
          if (hl == NULL)
             hook_list = h->next;
          else
@@ -649,21 +883,26 @@ void hooks_updateDate( ntime_t change )
  */
 static void hooks_updateDateExecute( ntime_t change )
 {
-   int j;
+   int j, id;
    Hook *h;
 
    /* Don't update without player. */
    if ((player.p == NULL) || player_isFlag(PLAYER_CREATING))
       return;
 
+   /* Date hooks are all in the date stack. */
+   id = hook_getStack( "date" );
+   if (id < 0)
+      return;
+
    /* Clear creation flags. */
-   for (h=hook_list; h!=NULL; h=h->next)
+   for (h=hook_stacks[id].list; h!=NULL; h=h->snext)
       h->created = 0;
 
    /* On j=0 we increment all timers and try to run, then on j=1 we update the timers. */
    hook_runningstack++; /* running hooks */
    for (j=1; j>=0; j--) {
-      for (h=hook_list; h!=NULL; h=h->next) {
+      for (h=hook_stacks[id].list; h!=NULL; h=h->snext) {
          /* Not be deleting. */
          if (h->delete)
             continue;
@@ -741,35 +980,42 @@ unsigned int hook_addDateEvt( unsigned int parent, const char *func, ntime_t res
  */
 void hooks_update( double dt )
 {
-   int j;
+   int i, j;
    Hook *h;
 
    /* Don't update without player. */
    if ((player.p == NULL) || player_isFlag(PLAYER_CREATING))
       return;
 
-   /* Clear creation flags. */
-   for (h=hook_list; h!=NULL; h=h->next)
+   /* Timers created since the last update can now run. */
+   for (i=0; i<array_size(hook_timersNew); i++) {
+      h = hook_timersNew[i];
       h->created = 0;
+      hook_timerPush( h );
+   }
+   array_resize( &hook_timersNew, 0 );
 
    hook_runningstack++; /* running hooks */
    for (j=1; j>=0; j--) {
-      for (h=hook_list; h!=NULL; h=h->next) {
+      /* Advance timers and check to see what should run. */
+      if (j==0)
+         hook_timerClock += dt;
+      if (hook_timersDue == NULL)
+         hook_timersDue = array_create( Hook* );
+      array_resize( &hook_timersDue, 0 );
+      while ((array_size(hook_timers) > 0) && (hook_timers[0]->expire <= hook_timerClock)) {
+         h = hook_timers[0];
+         hook_timerRemove( h );
+         array_push_back( &hook_timersDue, h );
+      }
+
+      /* Run in the same order as they were in the hook list. */
+      qsort( hook_timersDue, array_size(hook_timersDue), sizeof(Hook*), hook_cmpNewest );
+      for (i=0; i<array_size(hook_timersDue); i++) {
+         h = hook_timersDue[i];
          /* Not be deleting. */
          if (h->delete)
             continue;
-         /* Find valid timer hooks. */
-         if (h->is_timer == 0)
-            continue;
-         /* Don't update newly created hooks. */
-         if (h->created != 0)
-            continue;
-
-         /* Decrement timer and check to see if should run. */
-         if (j==0)
-            h->ms -= dt;
-         if (h->ms > 0.)
-            continue;
 
          /* Run the timer hook. */
          hook_run( h, NULL, j );
@@ -874,6 +1120,103 @@ int hook_hasMisnParent( unsigned int parent )
 }
 
 
+/**
+ * @brief Checks to see if a hook runs seldom enough for its parent to rest.
+ *
+ * Resting parents have their Lua environment freed until one of their hooks
+ *  runs, which is only worth it for hooks that can go long without running.
+ *
+ *    @param h Hook to check.
+ *    @return 1 if the parent can rest with it.
+ */
+static int hook_canRest( Hook *h )
+{
+   int i;
+   const char *rest[] = {
+         "land", "load", "takeoff", "jumpout", "jumpin", "enter",
+         "outfits", "shipyard", "bar", "mission", "commodity", "equipment", /* landing */
+         "end" };
+
+   /* Gone anyway. */
+   if (h->delete)
+      return 1;
+
+   /* Timers are near by definition. */
+   if (h->is_timer)
+      return 0;
+
+   /* Dates only when far apart, they accumulate while flying. */
+   if (h->is_date)
+      return (h->res >= ntime_create( 0, 1, 0 ));
+
+   for (i=0; strcmp(rest[i],"end") != 0; i++)
+      if (strcmp(rest[i],h->stack)==0)
+         return 1;
+   return 0;
+}
+
+
+/**
+ * @brief Checks to see if all the hooks of a mission parent run seldom.
+ *
+ *    @param parent ID of the parent.
+ *    @return 1 if the mission can rest.
+ */
+int hook_restMisnParent( unsigned int parent )
+{
+   Hook *h;
+
+   for (h=hook_list; h!=NULL; h=h->next)
+      if ((h->type==HOOK_TYPE_MISN) && (parent == h->u.misn.parent)
+            && !hook_canRest( h ))
+         return 0;
+
+   return 1;
+}
+
+
+/**
+ * @brief Checks to see if all the hooks of an event parent run seldom.
+ *
+ *    @param parent ID of the parent.
+ *    @return 1 if the event can rest.
+ */
+int hook_restEventParent( unsigned int parent )
+{
+   Hook *h;
+
+   for (h=hook_list; h!=NULL; h=h->next)
+      if ((h->type==HOOK_TYPE_EVENT) && (parent == h->u.event.parent)
+            && !hook_canRest( h ))
+         return 0;
+
+   return 1;
+}
+
+
+/**
+ * @brief Lets the missions and events that have been idle rest now and then.
+ *
+ * Must be called from the main loop, it doesn't do anything while Lua code is
+ *  running as the code may belong to what would rest.
+ *
+ *    @param dt Real time elapsed (s).
+ */
+void hooks_rest( double dt )
+{
+   hook_rest_timer -= dt;
+   if (hook_rest_timer > 0.)
+      return;
+   hook_rest_timer = HOOK_REST_PERIOD;
+
+   if ((__NLUA_CURENV != LUA_NOREF) || hook_runningstack)
+      return;
+
+   missions_rest();
+   events_rest();
+}
+
+
 /**
  * @brief Checks to see how many hooks there are with the same event parent.
  *
@@ -897,25 +1240,32 @@ int hook_hasEventParent( unsigned int parent )
 
 static int hooks_executeParam( const char* stack, HookParam *param )
 {
-   int j;
+   int j, id;
    int run;
    Hook *h;
+   HookParam iparam[3];
 
    /* Don't update if player is dead. */
    if ((player.p == NULL) || player_isFlag(PLAYER_DESTROYED))
       return 0;
 
+   /* Stack has never had any hooks. */
+   id = hook_getStack( stack );
+   if (id < 0)
+      return 0;
+
    /* Reset the current stack's ran and creation flags. */
-   for (h=hook_list; h!=NULL; h=h->next)
-      if (strcmp(stack, h->stack)==0) {
-         h->ran_once = 0;
-         h->created = 0;
-      }
+   for (h=hook_stacks[id].list; h!=NULL; h=h->snext) {
+      if (!h->created && (h->interval > 0.))
+         hook_intervalAccumulate( h, param );
+      h->ran_once = 0;
+      h->created = 0;
+   }
 
    run = 0;
    hook_runningstack++; /* running hooks */
    for (j=1; j>=0; j--) {
-      for (h=hook_list; h!=NULL; h=h->next) {
+      for (h=hook_stacks[id].list; h!=NULL; h=h->snext) {
          /* Should be deleted. */
          if (h->delete)
             continue;
@@ -925,9 +1275,15 @@ static int hooks_executeParam( const char* stack, HookParam *param )
          /* Don't update newly created hooks. */
          if (h->created != 0)
             continue;
-         /* Doesn't match stack. */
-         if (strcmp(stack, h->stack) != 0)
+
+         /* Interval hooks get the time since their last run instead. */
+         if (h->interval > 0.) {
+            if (!hook_intervalDue( h, iparam ))
+               continue;
+            hook_run( h, iparam, j );
+            run++;
             continue;
+         }
 
          /* Run hook. */
          hook_run( h, param, j );
@@ -944,6 +1300,73 @@ static int hooks_executeParam( const char* stack, HookParam *param )
 }
 
 
+/**
+ * @brief Accumulates the time passed for an interval hook.
+ *
+ *    @param h Interval hook.
+ *    @param param Parameters of the update stack, game and real time passed.
+ */
+static void hook_intervalAccumulate( Hook *h, const HookParam *param )
+{
+   if ((param == NULL) || (param[0].type != HOOK_PARAM_NUMBER) ||
+         (param[1].type != HOOK_PARAM_NUMBER))
+      return;
+   h->acc_dt  += param[0].u.num;
+   h->acc_rdt += param[1].u.num;
+}
+
+
+/**
+ * @brief Checks to see if an interval hook is due, consuming its time if so.
+ *
+ * Intervals missed in between are coalesced into a single run that gets all
+ *  the time accumulated since the last one.
+ *
+ *    @param h Interval hook.
+ *    @param[out] iparam Parameters to run the hook with.
+ *    @return 1 if the hook should run.
+ */
+static int hook_intervalDue( Hook *h, HookParam *iparam )
+{
+   if ((h->interval_real ? h->acc_rdt : h->acc_dt) < h->interval)
+      return 0;
+
+   iparam[0].type    = HOOK_PARAM_NUMBER;
+   iparam[0].u.num   = h->acc_dt;
+   iparam[1].type    = HOOK_PARAM_NUMBER;
+   iparam[1].u.num   = h->acc_rdt;
+   iparam[2].type    = HOOK_PARAM_SENTINEL;
+   h->acc_dt  = 0.;
+   h->acc_rdt = 0.;
+   return 1;
+}
+
+
+/**
+ * @brief Makes an update hook run at most once per interval.
+ *
+ *    @param id ID of the hook, must be in the "update" stack.
+ *    @param interval Seconds between runs, 0. to run it every update.
+ *    @param real Whether the interval is in real time instead of game time.
+ *    @return 0 on success.
+ */
+int hook_setInterval( unsigned int id, double interval, int real )
+{
+   Hook *h = hook_get( id );
+   if (h == NULL)
+      return -1;
+   if (strcmp( h->stack, "update" ) != 0) {
+      WARN(_("Hook '%u' of stack '%s' can't have an interval!"), id, h->stack);
+      return -1;
+   }
+   h->interval       = MAX( 0., interval );
+   h->interval_real  = real;
+   h->acc_dt         = 0.;
+   h->acc_rdt        = 0.;
+   return 0;
+}
+
+
 /**
  * @brief Runs all the hooks of stack.
  *
@@ -1024,12 +1447,12 @@ nlua_env hook_env( unsigned int hook )
    switch (h->type) {
       case HOOK_TYPE_MISN:
          misn = hook_getMission( h );
-         if (misn != NULL)
+         if ((misn != NULL) && (mission_wake( misn ) == 0))
              return misn->env;
          break;
       case HOOK_TYPE_EVENT:
          evt = event_get( h->u.event.parent );
-         if (evt != NULL)
+         if ((evt != NULL) && (event_wake( evt ) == 0))
             return evt->env;
 	 break;
       default:
@@ -1115,6 +1538,7 @@ static void hook_free( Hook *h )
  */
 void hook_cleanup (void)
 {
+   int i;
    Hook *h, *hn;
 
    if (hook_runningstack)
@@ -1131,6 +1555,22 @@ void hook_cleanup (void)
    }
    /* safe defaults just in case */
    hook_list  = NULL;
+
+   /* Clear the stacks. */
+   for (i=0; i<array_size(hook_stacks); i++)
+      free( hook_stacks[i].name );
+   array_free( hook_stacks );
+   hook_stacks = NULL;
+   strindex_free( &hook_stackIndex );
+
+   /* Clear the timers. */
+   array_free( hook_timers );
+   hook_timers = NULL;
+   array_free( hook_timersNew );
+   hook_timersNew = NULL;
+   array_free( hook_timersDue );
+   hook_timersDue = NULL;
+   hook_timerClock = 0.;
 }
 
 
@@ -1212,6 +1652,12 @@ int hook_save( xmlTextWriterPtr writer )
       if (h->is_date)
          xmlw_elem(writer,"resolution","%"PRId64,h->res);
 
+      /* Store interval information. */
+      if (h->interval > 0.) {
+         xmlw_elem(writer,"interval","%f",h->interval);
+         xmlw_elem(writer,"interval_real","%d",h->interval_real);
+      }
+
       xmlw_endElem(writer); /* "hook" */
    }
    xmlw_endElem(writer); /* "hooks" */
@@ -1266,8 +1712,9 @@ static int hook_parse( xmlNodePtr base )
    unsigned int parent, id, new_id;
    HookType_t type;
    Hook *h;
-   int is_date;
+   int is_date, interval_real;
    ntime_t res = 0;
+   double interval;
 
    /* Defaults. */
 
@@ -1279,6 +1726,8 @@ static int hook_parse( xmlNodePtr base )
          func     = NULL;
          stack    = NULL;
          is_date  = 0;
+         interval = 0.;
+         interval_real = 0;
 
          /* Handle the type. */
          xmlr_attr_strd(node, "type", stype);
@@ -1326,6 +1775,10 @@ static int hook_parse( xmlNodePtr base )
                continue;
             }
 
+            /* Interval of update hooks. */
+            xmlr_float(cur, "interval", interval);
+            xmlr_int(cur, "interval_real", interval_real);
+
             WARN(_("Save has unknown hook node '%s'."), cur->name);
          } while (xml_nextNode(cur));
 
@@ -1358,6 +1811,8 @@ static int hook_parse( xmlNodePtr base )
                h->is_date = 1;
                h->res = res;
             }
+            if (interval > 0.)
+               hook_setInterval( h->id, interval, interval_real );
          }
       }
    } while (xml_nextNode(node));
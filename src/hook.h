@@ -63,6 +63,9 @@ void hook_rmMisnParent( unsigned int parent );
 void hook_rmEventParent( unsigned int parent );
 int hook_hasMisnParent( unsigned int parent );
 int hook_hasEventParent( unsigned int parent );
+int hook_restMisnParent( unsigned int parent );
+int hook_restEventParent( unsigned int parent );
+void hooks_rest( double dt );
 
 /* pilot hook. */
 int pilot_runHookParam( Pilot* p, int hook_type, HookParam *param, int nparam );
@@ -108,6 +111,9 @@ void hooks_update( double dt );
 unsigned int hook_addTimerMisn( unsigned int parent, const char *func, double ms );
 unsigned int hook_addTimerEvt( unsigned int parent, const char *func, double ms );
 
+/* Update hooks. */
+int hook_setInterval( unsigned int id, double interval, int real );
+
 /* Date hooks. */
 void hooks_updateDate( ntime_t change );
 unsigned int hook_addDateMisn( unsigned int parent, const char *func, ntime_t resolution );
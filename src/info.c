@@ -1318,12 +1318,13 @@ static void info_shiplogView( unsigned int wid, char *str )
    i = toolkit_getListPos( wid, "lstLogEntries" );
    if ( i < 0 )
       return;
-   shiplog_listLog(
-         logIDs[selectedLog], info_getLogTypeFilter(selectedLogType), &nentries,
-         &logentries, 1);
+   /* Only the selected entry is needed. */
+   shiplog_listLogRange(
+         logIDs[selectedLog], info_getLogTypeFilter(selectedLogType), i, 1,
+         &nentries, &logentries );
 
-   if ( i < nentries )
-      dialogue_msgRaw( _("Log message"), logentries[i] );
+   if ( nentries > 0 )
+      dialogue_msgRaw( _("Log message"), logentries[0] );
 
    for (i=0; i<nentries; i++)
       free( logentries[i] );
@@ -33,6 +33,7 @@
 #include "pause.h"
 #include "pilot.h"
 #include "player.h"
+#include "replay.h"
 #include "toolkit.h"
 #include "weapon.h"
 
@@ -1538,6 +1539,10 @@ void input_handle( SDL_Event* event )
 {
    int ismouse = 0;
 
+   /* Replays record the input, or replace it when playing back. */
+   if (replay_input( event ))
+      return;
+
    /* Special case mouse stuff. */
    if ((event->type == SDL_MOUSEMOTION)  ||
          (event->type == SDL_MOUSEBUTTONDOWN) ||
@@ -457,6 +457,7 @@ int intro_display( const char *text, const char *mus )
       }
 
       /* Clear stuff. */
+      naev_present();
       glClear(GL_COLOR_BUFFER_BIT);
 
       /* Only thing we actually care about updating is music. */
@@ -20,6 +20,7 @@
 
 #include "land.h"
 
+#include "array.h"
 #include "camera.h"
 #include "conf.h"
 #include "dialogue.h"
@@ -27,6 +28,7 @@
 #include "equipment.h"
 #include "escort.h"
 #include "event.h"
+#include "faction.h"
 #include "gui.h"
 #include "hook.h"
 #include "land_outfits.h"
@@ -86,6 +88,8 @@ static glTexture *gfx_exterior = NULL; /**< Exterior graphic of the landed plane
  */
 static Mission* mission_computer = NULL; /**< Missions at the computer. */
 static int mission_ncomputer = 0; /**< Number of missions at the computer. */
+#define MISSION_GEN_BUDGET (4e-3) /**< Time spent generating computer missions per frame. [s] */
+static MissionGen mission_gen = { .done = 1 }; /**< Computer missions still being generated. */
 
 /*
  * Bar stuff.
@@ -135,6 +139,7 @@ static void misn_close( unsigned int wid, char *name );
 static void misn_accept( unsigned int wid, char* str );
 static void misn_genList( unsigned int wid, int first );
 static void misn_update( unsigned int wid, char* str );
+static void misn_genStep (void);
 
 
 /**
@@ -709,6 +714,52 @@ static void misn_genList( unsigned int wid, int first )
    free(focused);
    /* duplicateed the save focus functionaility from the bar */
 }
+/**
+ * @brief Generates computer missions for a frame and shows the new ones.
+ */
+static void misn_genStep (void)
+{
+   int n;
+
+   missions_genStep( &mission_gen, MISSION_GEN_BUDGET );
+
+   /* Take the new missions. */
+   n = array_size( mission_gen.missions );
+   if (n > 0) {
+      mission_computer = realloc( mission_computer,
+            sizeof(Mission) * (mission_ncomputer + n) );
+      memcpy( &mission_computer[ mission_ncomputer ], mission_gen.missions,
+            sizeof(Mission) * n );
+      mission_ncomputer += n;
+      array_resize( &mission_gen.missions, 0 );
+      missions_sort( mission_computer, mission_ncomputer );
+   }
+   if (mission_gen.done)
+      missions_genFree( &mission_gen );
+
+   /* Update the list if it's being shown. */
+   if ((n > 0) && (land_wid > 0) && land_tabGenerated(LAND_WINDOW_MISSION)) {
+      misn_genList( land_getWid(LAND_WINDOW_MISSION), 0 );
+      misn_update( land_getWid(LAND_WINDOW_MISSION), NULL );
+   }
+}
+
+
+/**
+ * @brief Keeps generating the computer missions while landed.
+ *
+ * Missions get generated in steps so landing on a planet with many missions
+ *  doesn't freeze the game until they are all created.
+ */
+void land_update (void)
+{
+   /* Dialogues run their own loop, don't run missions from there. */
+   if (mission_gen.done || !landed || dialogue_isOpen())
+      return;
+   misn_genStep();
+}
+
+
 /**
  * @brief Updates the mission list.
  *    @param wid Window of the mission computer.
@@ -1041,10 +1092,12 @@ void land_genWindows( int load, int changetab )
       /* Generate bar missions first for claims. */
       if (planet_hasService(land_planet, PLANET_SERVICE_BAR) && !planet_isFlag(land_planet, PLANET_NOMISNSPAWN))
          npc_generateMissions(); /* Generate bar npc. */
-      if (planet_hasService(land_planet, PLANET_SERVICE_MISSIONS))
-         mission_computer = missions_genList( &mission_ncomputer,
-               land_planet->faction, land_planet->name, cur_system->name,
-               MIS_AVAIL_COMPUTER );
+      if (planet_hasService(land_planet, PLANET_SERVICE_MISSIONS)) {
+         /* The rest gets done in land_update if this runs out of time. */
+         missions_genStart( &mission_gen, land_planet->faction,
+               land_planet->name, cur_system->name, MIS_AVAIL_COMPUTER );
+         misn_genStep();
+      }
    }
 
 
@@ -1134,6 +1187,9 @@ void land( Planet* p, int load )
    if (landed)
       return;
 
+   /* Standing changes from the last frame in space apply before landing. */
+   factions_modPlayerFlush();
+
    /* Resets the player's heat. */
    pilot_heatReset( player.p );
 
@@ -1510,6 +1566,7 @@ void land_cleanup (void)
    gfx_exterior   = NULL;
 
    /* Clean up mission computer. */
+   missions_genFree( &mission_gen );
    for (i=0; i<mission_ncomputer; i++)
       mission_cleanup( &mission_computer[i] );
    free(mission_computer);
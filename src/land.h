@@ -68,6 +68,7 @@ void land_queueTakeoff (void);
 int land_doneLoading (void);
 void land( Planet* p, int load );
 void land_genWindows( int load, int changetab );
+void land_update (void);
 void takeoff( int delay );
 void land_cleanup (void);
 void land_exit (void);
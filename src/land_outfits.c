@@ -69,6 +69,7 @@ static credits_t outfit_getPrice( Outfit *outfit );
 static void outfits_genList( unsigned int wid );
 static void outfits_changeTab( unsigned int wid, char *wgt, int old, int tab );
 static void outfits_onClose( unsigned int wid, char *str );
+static void outfits_imageArrayLoad( ImageArrayCell *cell );
 
 
 /**
@@ -448,8 +449,8 @@ void outfits_update( unsigned int wid, char* str )
          buf_license );
    window_modifyText( wid, "txtDDesc", buf );
    window_modifyText( wid, "txtOutfitName", _(outfit->name) );
-   window_modifyText( wid, "txtDescShort", outfit->desc_short );
-   th = gl_printHeightRaw( &gl_smallFont, w - (20 + iw + 20) - 200 - 20, outfit->desc_short );
+   window_modifyText( wid, "txtDescShort", outfit_descShort(outfit) );
+   th = gl_printHeightRaw( &gl_smallFont, w - (20 + iw + 20) - 200 - 20, outfit_descShort(outfit) );
    window_moveWidget( wid, "txtSDesc", 20+iw+20, -40-th-30-32 );
    window_moveWidget( wid, "txtDDesc", 20+iw+20+90, -40-th-30-32 );
    th += gl_printHeightRaw( &gl_smallFont, w - (20 + iw + 20) - 200 - 20, buf );
@@ -599,7 +600,7 @@ int outfit_altText( char *buf, int n, const Outfit *o )
    if (o->slot.spid!=0)
       p += scnprintf( &buf[p], n-p, _("#o%s#0\n"),
             _( sp_display( o->slot.spid ) ) );
-   p += scnprintf( &buf[p], n-p, "\n%s", o->desc_short );
+   p += scnprintf( &buf[p], n-p, "\n%s", outfit_descShort(o) );
    if ((o->mass > 0.) && (p < n))
       scnprintf( &buf[p], n-p,
             n_("\n%.0f Tonne", "\n%.0f Tonnes", mass),
@@ -610,15 +611,14 @@ int outfit_altText( char *buf, int n, const Outfit *o )
 
 /**
  * @brief Generates image array cells corresponding to outfits.
+ *
+ * Only the captions are set, the rest is filled in by the image array when
+ *  the cells are first shown, so large lists are cheap to generate.
  */
 ImageArrayCell *outfits_imageArrayCells( Outfit **outfits, int *noutfits )
 {
    int i;
-   const glColour *c;
    ImageArrayCell *coutfits;
-   Outfit *o;
-   const char *typename;
-   glTexture *t;
 
    /* Allocate. */
    coutfits = calloc( MAX(1,*noutfits), sizeof(ImageArrayCell) );
@@ -629,49 +629,65 @@ ImageArrayCell *outfits_imageArrayCells( Outfit **outfits, int *noutfits )
       coutfits[0].caption = strdup( _("None") );
    }
    else {
-      /* Set alt text. */
       for (i=0; i<*noutfits; i++) {
-         o = outfits[i];
-
-         coutfits[i].image = gl_dupTexture( o->gfx_store );
-         coutfits[i].caption = strdup( _(o->name) );
-         coutfits[i].quantity = player_outfitOwned(o);
-
-         /* Background colour. */
-         c = outfit_slotSizeColour( &o->slot );
-         if (c == NULL)
-            c = &cBlack;
-         col_blend( &coutfits[i].bg, c, &cGrey70, 1 );
-
-         /* Short description. */
-         if (o->desc_short == NULL)
-            coutfits[i].alt = NULL;
-         else {
-            coutfits[i].alt = malloc( STRMAX );
-            outfit_altText( coutfits[i].alt, STRMAX, o );
-         }
-
-         /* Slot type. */
-         if ( (strcmp(outfit_slotName(o), "N/A") != 0)
-               && (strcmp(outfit_slotName(o), "NULL") != 0) ) {
-            typename       = outfit_slotName(o);
-            coutfits[i].slottype = malloc(2);
-            coutfits[i].slottype[0] = typename[0];
-            coutfits[i].slottype[1] = '\0';
-         }
-
-         /* Layers. */
-         coutfits[i].layers = gl_copyTexArray( o->gfx_overlays, &coutfits[i].nlayers );
-         if (o->rarity > 0) {
-            t = rarity_texture( o->rarity );
-            coutfits[i].layers = gl_addTexArray( coutfits[i].layers, &coutfits[i].nlayers, t );
-         }
+         coutfits[i].caption = strdup( _(outfits[i]->name) );
+         coutfits[i].load    = outfits_imageArrayLoad;
+         coutfits[i].data    = outfits[i];
       }
    }
    return coutfits;
 }
 
 
+/**
+ * @brief Fills in an image array cell of an outfit.
+ *
+ *    @param cell Cell to fill in, with the outfit as data.
+ */
+static void outfits_imageArrayLoad( ImageArrayCell *cell )
+{
+   const glColour *c;
+   const Outfit *o;
+   const char *typename;
+   glTexture *t;
+
+   o = cell->data;
+
+   cell->image = gl_dupTexture( o->gfx_store );
+   cell->quantity = player_outfitOwned(o);
+
+   /* Background colour. */
+   c = outfit_slotSizeColour( &o->slot );
+   if (c == NULL)
+      c = &cBlack;
+   col_blend( &cell->bg, c, &cGrey70, 1 );
+
+   /* Short description. */
+   if (outfit_descShort(o) == NULL)
+      cell->alt = NULL;
+   else {
+      cell->alt = malloc( STRMAX );
+      outfit_altText( cell->alt, STRMAX, o );
+   }
+
+   /* Slot type. */
+   if ( (strcmp(outfit_slotName(o), "N/A") != 0)
+         && (strcmp(outfit_slotName(o), "NULL") != 0) ) {
+      typename       = outfit_slotName(o);
+      cell->slottype = malloc(2);
+      cell->slottype[0] = typename[0];
+      cell->slottype[1] = '\0';
+   }
+
+   /* Layers. */
+   cell->layers = gl_copyTexArray( o->gfx_overlays, &cell->nlayers );
+   if (o->rarity > 0) {
+      t = rarity_texture( o->rarity );
+      cell->layers = gl_addTexArray( cell->layers, &cell->nlayers, t );
+   }
+}
+
+
 
 /**
  * @brief Checks to see if the player can buy the outfit.
@@ -50,6 +50,7 @@ static void shipyard_rmouse( unsigned int wid, char* widget_name );
 static void shipyard_renderSlots( double bx, double by, double bw, double bh, void *data );
 static void shipyard_renderSlotsRow( double bx, double by, double bw, const char *str, ShipOutfitSlot *s );
 static void shipyard_find( unsigned int wid, char* str );
+static void shipyard_imageArrayLoad( ImageArrayCell *cell );
 
 
 /**
@@ -66,7 +67,6 @@ void shipyard_open( unsigned int wid )
    int th;
    int y;
    const char *buf;
-   glTexture *t;
    int iconsize;
 
    /* Mark as generated. */
@@ -164,12 +164,8 @@ void shipyard_open( unsigned int wid )
    else {
       for (i=0; i<nships; i++) {
          cships[i].caption = strdup( _(shipyard_list[i]->name) );
-         cships[i].image = gl_dupTexture(shipyard_list[i]->gfx_store);
-         cships[i].layers = gl_copyTexArray( shipyard_list[i]->gfx_overlays, &cships[i].nlayers );
-         if (shipyard_list[i]->rarity > 0) {
-            t = rarity_texture( shipyard_list[i]->rarity );
-            cships[i].layers = gl_addTexArray( cships[i].layers, &cships[i].nlayers, t );
-         }
+         cships[i].load    = shipyard_imageArrayLoad;
+         cships[i].data    = shipyard_list[i];
       }
    }
 
@@ -190,6 +186,27 @@ void shipyard_open( unsigned int wid )
    /* Set default keyboard focuse to the list */
    window_setFocus( wid , "iarShipyard" );
 }
+/**
+ * @brief Fills in an image array cell of a ship when it is first shown.
+ *
+ *    @param cell Cell to fill in, with the ship as data.
+ */
+static void shipyard_imageArrayLoad( ImageArrayCell *cell )
+{
+   Ship *s;
+   glTexture *t;
+
+   s = cell->data;
+   ship_gfxLoad( s );
+   cell->image  = gl_dupTexture( s->gfx_store );
+   cell->layers = gl_copyTexArray( s->gfx_overlays, &cell->nlayers );
+   if (s->rarity > 0) {
+      t = rarity_texture( s->rarity );
+      cell->layers = gl_addTexArray( cell->layers, &cell->nlayers, t );
+   }
+}
+
+
 /**
  * @brief Updates the ships in the shipyard window.
  *    @param wid Window to update the ships in.
@@ -243,10 +260,11 @@ void shipyard_update( unsigned int wid, char* str )
    shipyard_selected = ship;
 
    /* update image */
+   ship_gfxLoad( ship );
    window_modifyImage( wid, "imgTarget", ship->gfx_store, 0, 0 );
 
    /* update text */
-   window_modifyText( wid, "txtStats", ship->desc_stats );
+   window_modifyText( wid, "txtStats", ship_descStats(ship) );
    window_modifyText( wid, "txtDescription", _(ship->description) );
    price2str( buf2, ship_buyPrice(ship), player.p->credits, 2 );
    credits2str( buf3, player.p->credits, 2 );
@@ -35,6 +35,8 @@
 #include "nxml.h"
 #include "outfit.h"
 #include "player.h"
+#include "save.h"
+#include "savefile.h"
 #include "shiplog.h"
 #include "space.h"
 #include "toolkit.h"
@@ -93,7 +95,7 @@ static int load_load( nsave_t *save, const char *path );
 static int load_gameInternal( const char* file, const char* version );
 static int load_enumerateCallback( void* data, const char* origdir, const char* fname );
 static int load_sortCompare( const void *p1, const void *p2 );
-static xmlDocPtr load_xml_parsePhysFS( const char* filename );
+static xmlDocPtr load_xml_parsePhysFS( const char* filename, const char *section );
 
 
 /**
@@ -104,13 +106,20 @@ static xmlDocPtr load_xml_parsePhysFS( const char* filename );
 static int load_load( nsave_t *save, const char *path )
 {
    xmlDocPtr doc;
-   xmlNodePtr root, parent, node, cur;
-   int cycles, periods, seconds;
+   xmlNodePtr root;
+
+   /* Chunked saves have the info in a header, no need to parse the rest. */
+   if (savefile_isChunked( path )) {
+      if (savefile_readHeader( save, path ) != 0)
+         return -1;
+      save->path = strdup(path);
+      return 0;
+   }
 
    memset( save, 0, sizeof(nsave_t) );
 
    /* Load the XML. */
-   doc = load_xml_parsePhysFS( path );
+   doc = load_xml_parsePhysFS( path, NULL );
    if (doc == NULL) {
       WARN( _("Unable to parse save path '%s'."), path);
       return -1;
@@ -122,9 +131,34 @@ static int load_load( nsave_t *save, const char *path )
       return -1;
    }
 
+   load_header( save, root );
+
    /* Save path. */
    save->path = strdup(path);
 
+   /* Clean up. */
+   xmlFreeDoc(doc);
+
+   return 0;
+}
+
+
+/**
+ * @brief Gets the information shown in the load menu from a saved game.
+ *
+ * Only reads the document so it can be used from any thread.
+ *
+ *    @param[out] save Structure to populate, except for the path.
+ *    @param root The "naev_save" node.
+ *    @return 0 on success.
+ */
+int load_header( nsave_t *save, xmlNodePtr root )
+{
+   xmlNodePtr parent, node, cur;
+   int cycles, periods, seconds;
+
+   memset( save, 0, sizeof(nsave_t) );
+
    /* Iterate inside the naev_save. */
    parent = root->xmlChildrenNode;
    do {
@@ -176,9 +210,6 @@ static int load_load( nsave_t *save, const char *path )
       }
    } while (xml_nextNode(parent));
 
-   /* Clean up. */
-   xmlFreeDoc(doc);
-
    return 0;
 }
 
@@ -197,6 +228,9 @@ int load_refresh (void)
    if (load_saves != NULL)
       load_free();
 
+   /* Saves may still be being written. */
+   save_sync();
+
    /* load the saves */
    files = array_create( filedata_t );
    PHYSFS_enumerate( "saves", load_enumerateCallback, &files );
@@ -572,14 +606,16 @@ int load_gameDiff( const char* file )
    xmlNodePtr node;
    xmlDocPtr doc;
 
+   save_sync();
+
    /* Make sure it exists. */
    if (!PHYSFS_exists( file )) {
       dialogue_alert( _("Saved game file seems to have been deleted.") );
       return -1;
    }
 
-   /* Load the XML. */
-   doc = load_xml_parsePhysFS( file );
+   /* Load the XML, only the diffs are needed. */
+   doc = load_xml_parsePhysFS( file, "diffs" );
    if (doc == NULL)
       goto err;
    node  = doc->xmlChildrenNode; /* base node */
@@ -640,6 +676,10 @@ static int load_gameInternal( const char* file, const char* version )
    Planet *pnt;
    int version_diff = (version!=NULL) ? naev_versionCompare(version) : 0;
 
+   save_sync();
+   /* The first save of the loaded game compacts it. */
+   savefile_forget();
+
    /* Make sure it exists. */
    if (!PHYSFS_exists( file )) {
       dialogue_alert( _("Saved game file seems to have been deleted.") );
@@ -647,7 +687,7 @@ static int load_gameInternal( const char* file, const char* version )
    }
 
    /* Load the XML. */
-   doc = load_xml_parsePhysFS( file );
+   doc = load_xml_parsePhysFS( file, NULL );
    if (doc == NULL)
       goto err;
    node  = doc->xmlChildrenNode; /* base node */
@@ -728,11 +768,17 @@ err:
 
 /**
  * @brief Temporary (hopefully) wrapper around xml_parsePhysFS in support of gzipped XML (like .ns files).
+ *
+ *    @param filename PhysicsFS path of the save.
+ *    @param section Only section needed from chunked saves, NULL for all.
  */
-static xmlDocPtr load_xml_parsePhysFS( const char* filename )
+static xmlDocPtr load_xml_parsePhysFS( const char* filename, const char *section )
 {
    char buf[PATH_MAX];
 
+   if (savefile_isChunked( filename ))
+      return savefile_readDoc( filename, section );
+
    snprintf( buf, sizeof(buf), "%s/%s", PHYSFS_getWriteDir(), filename);
    return xmlParseFile( buf );
 }
@@ -13,6 +13,7 @@
 /** @endcond */
 
 #include "ntime.h"
+#include "nxml.h"
 
 
 /**
@@ -41,6 +42,7 @@ void load_loadGameMenu (void);
 int load_gameDiff( const char* file );
 int load_gameFile( const char* file );
 int load_game( nsave_t *ns );
+int load_header( nsave_t *save, xmlNodePtr root );
 
 int load_refresh (void);
 void load_free (void);
@@ -6,6 +6,11 @@
  * @file log.c
  *
  * @brief Home of logprintf.
+ *
+ * Once the output is set up with log_redirect(), lines are queued for a
+ *  writer thread. Printing to slow consoles and the log files never blocks
+ *  the game, and lines are dropped (and counted) if the queue fills up.
+ *  Warnings repeated by the same call site get collapsed into a count.
  */
 
 /** @cond */
@@ -13,6 +18,10 @@
 #include <stdio.h>
 #include <time.h> /* strftime */
 #include "physfs.h"
+#include "SDL_atomic.h"
+#include "SDL_mutex.h"
+#include "SDL_thread.h"
+#include "SDL_timer.h"
 
 #include "naev.h"
 /** @endcond */
@@ -25,6 +34,36 @@
 #include "nstring.h"
 
 
+#define LOG_LINE_MAX       2048 /**< Longest line that can be printed. */
+#define LOG_PENDING_MAX    256 /**< Text printed without newline kept until the rest of the line. */
+#define LOG_QUEUE_SIZE     256 /**< Lines that can wait for the writer thread, power of two. */
+#define LOG_SITES          64 /**< Warning sites tracked for collapsing, power of two. */
+#define LOG_SITE_BURST     8 /**< Warnings a site prints before the rest get collapsed. */
+#define LOG_SITE_WINDOW    5000 /**< Milliseconds after which a site can print again. */
+
+
+/**
+ * @brief Line waiting for the writer thread.
+ */
+typedef struct LogMsg_ {
+   FILE *stream; /**< Stream to write to (stdout or stderr). */
+   int flush; /**< Whether to flush after writing. */
+   int len; /**< Length of the line. */
+   char buf[LOG_LINE_MAX]; /**< The line. */
+} LogMsg;
+
+
+/**
+ * @brief Warnings printed by a call site, identified by its format string.
+ */
+typedef struct LogSite_ {
+   const char *fmt; /**< Format string of the site. */
+   Uint32 start; /**< Ticks when the current window started. */
+   int count; /**< Warnings in the current window. */
+   int suppressed; /**< Warnings not printed in the current window. */
+} LogSite;
+
+
 /**< Temporary storage buffers. */
 static char *outcopy = NULL;
 static char *errcopy = NULL;
@@ -46,35 +85,107 @@ static int copying = 0;
 static PHYSFS_File *logout_file = NULL;
 static PHYSFS_File *logerr_file = NULL;
 
+/* Writer thread. */
+static LogMsg *log_queue         = NULL; /**< Lines waiting to be written. */
+static SDL_atomic_t log_queueWrite; /**< Lines queued so far. */
+static SDL_atomic_t log_queueRead; /**< Lines written so far. */
+static SDL_SpinLock log_queueLock = 0; /**< Serializes the threads queueing lines. */
+static SDL_atomic_t log_dropped; /**< Lines dropped because the queue was full. */
+static SDL_sem *log_sem          = NULL; /**< Wakes the writer thread. */
+static SDL_Thread *log_thread    = NULL; /**< Writer thread. */
+static SDL_atomic_t log_threadRun; /**< Whether the writer thread should keep running. */
+
+/* Lines printed in parts. */
+static _Thread_local char log_pending[LOG_PENDING_MAX]; /**< Start of the line being printed. */
+static _Thread_local int log_npending = 0; /**< Length of log_pending. */
+static _Thread_local FILE *log_pendingStream = NULL; /**< Stream of log_pending. */
+
+/* Collapsing warnings. */
+static LogSite log_sites[LOG_SITES]; /**< Sites that printed warnings lately. */
+static SDL_SpinLock log_siteLock = 0; /**< Protects log_sites. */
+
 
 /*
  * Prototypes
  */
 static void log_copy( int enable );
-static void log_append( FILE *stream, char *str );
+static void log_append( FILE *stream, const char *str );
 static void log_cleanStream( PHYSFS_File **file, const char *fname, const char *filedouble );
 static void log_purge (void);
+static void log_emit( FILE *stream, char *buf, int n, int newline );
+static void log_output( FILE *stream, const char *str, int len, int flush );
+static void log_write( FILE *stream, const char *str, int len, int flush );
+static int log_siteSuppress( const char *fmt );
+static void log_siteReport( const char *fmt, int suppressed );
+static void log_startThread (void);
+static void log_stopThread (void);
+static int log_threadMain( void *unused );
+static void log_drain (void);
 
 /**
  * @brief Like fprintf but also prints to the naev console.
+ *
+ * Text printed without newline is kept until the rest of the line comes, so
+ *  that headers and messages get printed together.
  */
 int logprintf( FILE *stream, int newline, const char *fmt, ... )
 {
    va_list ap;
-   char buf[2048];
-   size_t n;
+   char buf[LOG_LINE_MAX], pbuf[LOG_PENDING_MAX+4];
+   int n, p;
 
    if (fmt == NULL)
       return 0;
-   else { /* get the message */
-      /* Add header if necessary. */
-      /* Print variable text. */
-      va_start( ap, fmt );
-      n = vsnprintf( &buf[2], sizeof(buf)-3, fmt, ap )-1;
-      va_end( ap );
 
+   /* Start with what was printed without newline. */
+   p = 0;
+   if (log_npending > 0) {
+      if (log_pendingStream == stream) {
+         memcpy( &buf[2], log_pending, log_npending );
+         p = log_npending;
+      }
+      else {
+         memcpy( &pbuf[2], log_pending, log_npending );
+         pbuf[2+log_npending] = '\0';
+         log_emit( log_pendingStream, pbuf, log_npending, 0 );
+      }
+      log_npending = 0;
+   }
+
+   /* Print variable text. */
+   va_start( ap, fmt );
+   n = vsnprintf( &buf[2+p], sizeof(buf)-3-p, fmt, ap );
+   va_end( ap );
+   n = p + CLAMP( 0, (int)sizeof(buf)-4-p, n );
+   buf[2+n] = '\0';
+
+   /* Wait for the rest of the line. */
+   if (!newline && (n < LOG_PENDING_MAX) && ((n == 0) || (buf[2+n-1] != '\n'))) {
+      memcpy( log_pending, &buf[2], n );
+      log_npending      = n;
+      log_pendingStream = stream;
+      return n;
    }
 
+   /* Collapse repeated warnings. */
+   if ((stream == stderr) && log_siteSuppress( fmt ))
+      return 0;
+
+   log_emit( stream, buf, n, newline );
+   return n;
+}
+
+
+/**
+ * @brief Prints a line to the console and queues it for writing.
+ *
+ *    @param stream Stream to print to.
+ *    @param buf Line to print, starting at buf[2] with room for a newline.
+ *    @param n Length of the line.
+ *    @param newline Whether to end with a newline.
+ */
+static void log_emit( FILE *stream, char *buf, int n, int newline )
+{
 #ifndef NOLOGPRINTFCONSOLE
    /* Add to console. */
    if (stream == stderr) {
@@ -88,33 +199,247 @@ int logprintf( FILE *stream, int newline, const char *fmt, ... )
 
    /* Finally add newline if necessary. */
    if (newline) {
-      buf[2+n+1] = '\n';
-      buf[2+n+2] = '\0';
+      buf[2+n] = '\n';
+      n++;
+      buf[2+n] = '\0';
    }
-   else
-      buf[2+n+1] = '\0';
 
+   log_output( stream, &buf[2], n, newline );
+}
+
+
+/**
+ * @brief Hands a line to the writer thread, or writes it if there is none.
+ */
+static void log_output( FILE *stream, const char *str, int len, int flush )
+{
+   int w;
+   LogMsg *msg;
+
+   if (log_thread == NULL) {
+      log_write( stream, str, len, flush );
+      return;
+   }
+
+   SDL_AtomicLock( &log_queueLock );
+   w = SDL_AtomicGet( &log_queueWrite );
+   if ((unsigned int)(w - SDL_AtomicGet( &log_queueRead )) >= LOG_QUEUE_SIZE) {
+      SDL_AtomicUnlock( &log_queueLock );
+      SDL_AtomicIncRef( &log_dropped );
+      return;
+   }
+   msg = &log_queue[ w & (LOG_QUEUE_SIZE-1) ];
+   msg->stream = stream;
+   msg->flush  = flush;
+   msg->len    = MIN( len, LOG_LINE_MAX-1 );
+   memcpy( msg->buf, str, msg->len );
+   msg->buf[ msg->len ] = '\0';
+   SDL_AtomicSet( &log_queueWrite, w+1 );
+   SDL_AtomicUnlock( &log_queueLock );
+
+   SDL_SemPost( log_sem );
+}
+
+
+/**
+ * @brief Writes a line to the stream, the log files and the copy buffers.
+ */
+static void log_write( FILE *stream, const char *str, int len, int flush )
+{
    /* Append to buffer. */
    if (copying)
-      log_append(stream, &buf[2]);
+      log_append( stream, str );
 
    if ( stream == stdout && logout_file != NULL ) {
-      PHYSFS_writeBytes( logout_file, &buf[2], newline ? n+2 : n+1 );
-      if ( newline )
+      PHYSFS_writeBytes( logout_file, str, len );
+      if ( flush )
          PHYSFS_flush( logout_file );
    }
 
    if ( stream == stderr && logerr_file != NULL ) {
-      PHYSFS_writeBytes( logerr_file, &buf[2], newline ? n+2 : n+1 );
-      if ( newline )
+      PHYSFS_writeBytes( logerr_file, str, len );
+      if ( flush )
          PHYSFS_flush( logerr_file );
    }
 
    /* Also print to the stream. */
-   n = fprintf( stream, "%s", &buf[ 2 ] );
-   if ( newline )
+   fwrite( str, 1, len, stream );
+   if ( flush )
       fflush( stream );
-   return n;
+}
+
+
+/**
+ * @brief Checks to see if a warning should be collapsed.
+ *
+ * Each site prints LOG_SITE_BURST warnings, the rest are only counted until
+ *  LOG_SITE_WINDOW is over.
+ *
+ *    @param fmt Format string of the warning, identifying the site.
+ *    @return 1 if the warning should not be printed.
+ */
+static int log_siteSuppress( const char *fmt )
+{
+   LogSite *site;
+   Uint32 now;
+   const char *old;
+   int ret, suppressed;
+
+   now  = SDL_GetTicks();
+   site = &log_sites[ ((uintptr_t)fmt >> 3) & (LOG_SITES-1) ];
+
+   SDL_AtomicLock( &log_siteLock );
+   old = NULL;
+   suppressed = 0;
+   if ((site->fmt != fmt) || (now - site->start > LOG_SITE_WINDOW)) {
+      old               = site->fmt;
+      suppressed        = site->suppressed;
+      site->fmt         = fmt;
+      site->start       = now;
+      site->count       = 0;
+      site->suppressed  = 0;
+   }
+   site->count++;
+   ret = (site->count > LOG_SITE_BURST);
+   if (ret)
+      site->suppressed++;
+   SDL_AtomicUnlock( &log_siteLock );
+
+   if (suppressed > 0)
+      log_siteReport( old, suppressed );
+   return ret;
+}
+
+
+/**
+ * @brief Prints how many warnings of a site were collapsed.
+ */
+static void log_siteReport( const char *fmt, int suppressed )
+{
+   char buf[LOG_LINE_MAX];
+   int n;
+
+   n = scnprintf( &buf[2], sizeof(buf)-3, _("Warning: %d more like \"%.*s\" not shown"),
+         suppressed, (int)strcspn( fmt, "\n" ), fmt );
+   log_emit( stderr, buf, n, 1 );
+}
+
+
+/**
+ * @brief Waits for the writer thread to write everything queued so far.
+ *
+ * Used before aborting, so that the reason gets logged.
+ */
+void log_flush (void)
+{
+   int w;
+
+   if (log_thread == NULL)
+      return;
+
+   w = SDL_AtomicGet( &log_queueWrite );
+   while ((w - SDL_AtomicGet( &log_queueRead )) > 0) {
+      SDL_SemPost( log_sem );
+      SDL_Delay( 1 );
+   }
+}
+
+
+/**
+ * @brief Starts writing in the background.
+ */
+static void log_startThread (void)
+{
+   if (log_thread != NULL)
+      return;
+
+   log_queue = calloc( LOG_QUEUE_SIZE, sizeof(LogMsg) );
+   log_sem   = SDL_CreateSemaphore( 0 );
+   SDL_AtomicSet( &log_queueWrite, 0 );
+   SDL_AtomicSet( &log_queueRead, 0 );
+   SDL_AtomicSet( &log_dropped, 0 );
+   SDL_AtomicSet( &log_threadRun, 1 );
+   if (log_sem != NULL)
+      log_thread = SDL_CreateThread( log_threadMain, "log_thread", NULL );
+   if (log_thread == NULL) {
+      if (log_sem != NULL)
+         SDL_DestroySemaphore( log_sem );
+      log_sem = NULL;
+      free( log_queue );
+      log_queue = NULL;
+      WARN(_("Unable to create the log thread, writing logs directly."));
+   }
+}
+
+
+/**
+ * @brief Stops writing in the background, after writing what is queued.
+ */
+static void log_stopThread (void)
+{
+   int i, suppressed;
+
+   /* Report the warnings left to collapse. */
+   for (i=0; i<LOG_SITES; i++) {
+      SDL_AtomicLock( &log_siteLock );
+      suppressed = log_sites[i].suppressed;
+      log_sites[i].suppressed = 0;
+      SDL_AtomicUnlock( &log_siteLock );
+      if (suppressed > 0)
+         log_siteReport( log_sites[i].fmt, suppressed );
+   }
+
+   if (log_thread == NULL)
+      return;
+
+   SDL_AtomicSet( &log_threadRun, 0 );
+   SDL_SemPost( log_sem );
+   SDL_WaitThread( log_thread, NULL );
+   log_thread = NULL;
+   SDL_DestroySemaphore( log_sem );
+   log_sem = NULL;
+   free( log_queue );
+   log_queue = NULL;
+}
+
+
+/**
+ * @brief Writes the queued lines until told to stop.
+ */
+static int log_threadMain( void *unused )
+{
+   (void) unused;
+
+   while (SDL_AtomicGet( &log_threadRun )) {
+      SDL_SemWait( log_sem );
+      log_drain();
+   }
+   log_drain();
+   return 0;
+}
+
+
+/**
+ * @brief Writes all the queued lines, run by the writer thread.
+ */
+static void log_drain (void)
+{
+   int r, n, dropped;
+   LogMsg *msg;
+   char buf[128];
+
+   r = SDL_AtomicGet( &log_queueRead );
+   while (r != SDL_AtomicGet( &log_queueWrite )) {
+      msg = &log_queue[ r & (LOG_QUEUE_SIZE-1) ];
+      log_write( msg->stream, msg->buf, msg->len, msg->flush );
+      SDL_AtomicSet( &log_queueRead, ++r );
+   }
+
+   dropped = SDL_AtomicSet( &log_dropped, 0 );
+   if (dropped > 0) {
+      n = scnprintf( buf, sizeof(buf), _("Warning: %d log lines dropped!\n"), dropped );
+      log_write( stderr, buf, n, 1 );
+   }
 }
 
 
@@ -128,8 +453,11 @@ void log_redirect (void)
    struct tm *ts;
    char timestr[20];
 
-   if (!conf.redirect_file)
+   /* From now on the writing happens in the background. */
+   if (!conf.redirect_file) {
+      log_startThread();
       return;
+   }
 
    time(&cur);
    ts = localtime(&cur);
@@ -148,6 +476,7 @@ void log_redirect (void)
    asprintf( &errfiledouble, "logs/%s_stderr.txt", timestr );
 
    log_copy(0);
+   log_startThread();
 }
 
 
@@ -225,6 +554,7 @@ static void log_purge (void)
  */
 void log_clean (void)
 {
+   log_stopThread();
    log_cleanStream( &logout_file, "logs/stdout.txt", outfiledouble );
    log_cleanStream( &logerr_file, "logs/stderr.txt", errfiledouble );
 }
@@ -259,7 +589,7 @@ static void log_cleanStream( PHYSFS_File **file, const char *fname, const char *
  *    @param stream Destination stream (stdout or stderr)
  *    @param str String to append.
  */
-static void log_append( FILE *stream, char *str )
+static void log_append( FILE *stream, const char *str )
 {
    int len;
 
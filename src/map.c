@@ -8,6 +8,7 @@
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "naev.h"
 /** @endcond */
@@ -46,10 +47,9 @@ typedef enum MapMode_ {
 #define BUTTON_HEIGHT   30 /**< Map button height. */
 
 
-#define MAP_LOOP_PROT   1000 /**< Number of iterations max in pathfinding before
-                                 aborting. */
-
 #define MAP_MARKER_CYCLE  750 /**< Time of a mission marker's animation cycle in milliseconds. */
+#define MAP_LABEL_ZOOM    1. /**< Below this zoom the editor thins out the system names. */
+#define MAP_LABEL_CELL    64 /**< Width of the screen cells used to thin out names. */
 
 /* map decorator stack */
 static MapDecorator* decorator_stack = NULL; /**< Contains all the map decorators. */
@@ -67,6 +67,7 @@ double map_alpha_names        = 1.;
 double map_alpha_markers      = 1.;
 static MapMode map_mode       = MAPMODE_TRAVEL; /**< Default map mode. */
 static StarSystem **map_path  = NULL; /**< Array (array.h): The path to current selected system. */
+static double *map_path_dist  = NULL; /**< Array (array.h): Distance flown in each system of the path after the current one, NULL when it has to be recomputed. */
 glTexture *gl_faction_disk    = NULL; /**< Texture of the disk representing factions. */
 static int cur_commod         = -1; /**< Current commodity selected. */
 static int cur_commod_mode    = 0; /**< 0 for cost, 1 for difference. */
@@ -74,10 +75,27 @@ static Commodity **commod_known = NULL; /**< index of known commodities */
 static char** map_modes = NULL; /**< Array (array.h) of the map modes' names, e.g. "Gold: Cost". */
 static int listMapModeVisible = 0; /**< Whether the map mode list widget is visible. */
 static double commod_av_gal_price = 0; /**< Average price across the galaxy. */
+/**
+ * @brief Known prices of the current commodity in a system.
+ */
+typedef struct MapCommodPrice_ {
+   double min; /**< Lowest known price. */
+   double max; /**< Highest known price. */
+   double avg; /**< Average of the known prices. */
+   int cnt; /**< Planets whose price is known, 0 if none. */
+} MapCommodPrice;
+static MapCommodPrice *commod_prices = NULL; /**< Array (array.h): Known prices by system id, made by map_update_commod_av_price. */
 static double map_nebu_dt     = 0.; /***< Nebula animation stuff. */
 /* VBO. */
 static gl_vbo *map_vbo = NULL; /**< Map VBO. */
 static gl_vbo *marker_vbo = NULL;
+static gl_vbo *map_jumps_vbo = NULL; /**< Cached jump routes in galaxy coordinates. */
+static GLfloat *map_jumps_vertex = NULL; /**< Array (array.h): Vertex data of map_jumps_vbo. */
+static unsigned int map_jumps_gen = 0; /**< Value of space_pathGen map_jumps_vbo was made at. */
+static int map_jumps_valid = 0; /**< Whether map_jumps_vbo has been made. */
+static int map_jumps_editor = 0; /**< Whether map_jumps_vbo was made for the editor. */
+static char *decorator_visible = NULL; /**< Array (array.h): Whether each decorator is near a known system. */
+static unsigned int decorator_gen = 0; /**< Value of space_pathGen decorator_visible was computed at. */
 
 /*
  * extern
@@ -101,6 +119,8 @@ static void map_renderMarkers( double x, double y, double r, double a );
 static void map_renderCommod( double bx, double by, double x, double y,
                               double w, double h, double r, int editor );
 static void map_renderCommodIgnorance( double x, double y, StarSystem *sys, Commodity *c );
+static void map_genJumps( int editor );
+static void map_genDecorators (void);
 static void map_drawMarker( double x, double y, double r, double a,
       int num, int cur, int type );
 /* Mouse. */
@@ -116,6 +136,14 @@ static void map_selectCur (void);
 static void map_genModeList(void);
 static void map_update_commod_av_price();
 static void map_window_close( unsigned int wid, char *str );
+/* Pathfinding. */
+static int map_pathUsable( unsigned int flags, StarSystem *target, int ignore_known, int show_hidden );
+static const int* map_pathTree( const StarSystem *ssys, int ignore_known, int show_hidden,
+      const int **dist );
+static void map_pathFree (void);
+static double map_legDistance( StarSystem *sys, StarSystem *prev, StarSystem *next );
+static double map_legTime( double d, double speed, double accel );
+static void map_pathCosts (void);
 
 
 /**
@@ -153,9 +181,20 @@ void map_exit (void)
 
    gl_vboDestroy(map_vbo);
    map_vbo = NULL;
+   gl_vboDestroy(map_jumps_vbo);
+   map_jumps_vbo = NULL;
+   array_free(map_jumps_vertex);
+   map_jumps_vertex = NULL;
+   map_jumps_valid = 0;
+   array_free(decorator_visible);
+   decorator_visible = NULL;
+   array_free(commod_prices);
+   commod_prices = NULL;
 
    gl_freeTexture( gl_faction_disk );
 
+   map_pathFree();
+
    if (decorator_stack != NULL) {
       for (i=0; i<array_size(decorator_stack); i++)
          gl_freeTexture( decorator_stack[i].image );
@@ -375,6 +414,9 @@ void map_open (void)
 
 /*
  * Prepares economy info for rendering.  Called when cur_commod changes.
+ *
+ * Known prices only change while landing or loading, so they are gathered
+ *  once here for all the systems and the map is drawn from the table.
  */
 
 static void map_update_commod_av_price()
@@ -383,51 +425,55 @@ static void map_update_commod_av_price()
    int i,j,k;
    StarSystem *sys;
    Planet *p;
+   MapCommodPrice *mp;
+   double thisPrice, totPrice;
+   int totPriceCnt;
+
    if (cur_commod == -1 || map_selected == -1) {
       commod_av_gal_price = 0;
       return;
    }
    c = commod_known[cur_commod];
-   if ( cur_commod_mode == 0 ) {
-      double totPrice = 0;
-      int totPriceCnt = 0;
-      for (i=0; i<array_size(systems_stack); i++) {
-         sys = system_getIndex( i );
 
-         /* if system is not known, reachable, or marked. and we are not in the editor */
-         if ((!sys_isKnown(sys) && !sys_isFlag(sys, SYSTEM_MARKED | SYSTEM_CMARKED)
-              && !space_sysReachable(sys)))
-            continue;
-         if ((sys_isKnown(sys)) && (system_hasPlanet(sys))) {
-            double sumPrice=0;
-            int sumCnt=0;
-            double thisPrice;
-            for ( j=0 ; j<array_size(sys->planets); j++) {
-               p=sys->planets[j];
-               for ( k=0; k<array_size(p->commodities); k++) {
-                  if ( p->commodities[k] == c ) {
-                     if ( p->commodityPrice[k].cnt > 0 ) {/*commodity is known about*/
-                        thisPrice = p->commodityPrice[k].sum / p->commodityPrice[k].cnt;
-                        sumPrice+=thisPrice;
-                        sumCnt+=1;
-                        break;
-                     }
-                  }
+   if (commod_prices == NULL)
+      commod_prices = array_create_size( MapCommodPrice, array_size(systems_stack) );
+   array_resize( &commod_prices, array_size(systems_stack) );
+   totPrice = 0.;
+   totPriceCnt = 0;
+   for (i=0; i<array_size(systems_stack); i++) {
+      sys = system_getIndex( i );
+      mp  = &commod_prices[i];
+      memset( mp, 0, sizeof(MapCommodPrice) );
+
+      /* Only prices of known systems are shown. */
+      if (!sys_isKnown(sys) || !system_hasPlanet(sys))
+         continue;
+      for ( j=0 ; j<array_size(sys->planets); j++) {
+         p=sys->planets[j];
+         for ( k=0; k<array_size(p->commodities); k++) {
+            if ( p->commodities[k] == c ) {
+               if ( p->commodityPrice[k].cnt > 0 ) {/*commodity is known about*/
+                  thisPrice = p->commodityPrice[k].sum / p->commodityPrice[k].cnt;
+                  if (thisPrice > mp->max) mp->max = thisPrice;
+                  if (mp->min == 0 || thisPrice < mp->min) mp->min = thisPrice;
+                  mp->avg += thisPrice;
+                  mp->cnt++;
+                  break;
                }
             }
-            if ( sumCnt>0 ) {
-               totPrice += sumPrice / sumCnt;
-               totPriceCnt++;
-            }
          }
       }
-      if ( totPriceCnt > 0 )
-         totPrice /= totPriceCnt;
-      commod_av_gal_price = totPrice;
+      if ( mp->cnt>0 ) {
+         mp->avg /= mp->cnt;
+         totPrice += mp->avg;
+         totPriceCnt++;
+      }
+   }
 
-   } else {
+   if ( cur_commod_mode == 0 && totPriceCnt > 0 )
+      commod_av_gal_price = totPrice / totPriceCnt;
+   else
       commod_av_gal_price = 0;
-   }
 }
 
 /**
@@ -449,6 +495,7 @@ static void map_update( unsigned int wid )
    glTexture *logo;
    double w;
    Commodity *c;
+   char *nt;
 
    /* Needs map to update. */
    if (!map_isOpen())
@@ -716,6 +763,15 @@ static void map_update( unsigned int wid )
       window_modifyText( wid, "txtSystemStatus", buf );
       (void)p;
    }
+   else if ((array_size(map_path) > 0) && (array_back(map_path) == sys)) {
+      /* Estimated time of arrival at the destination. */
+      nt = ntime_pretty( map_getTravelTime(), 2 );
+      snprintf( buf, sizeof(buf), n_("%d jump, about %s of travel",
+               "%d jumps, about %s of travel", array_size(map_path)),
+            array_size(map_path), nt );
+      window_modifyText( wid, "txtSystemStatus", buf );
+      free( nt );
+   }
 }
 
 
@@ -773,7 +829,7 @@ static void map_drawMarker( double x, double y, double r, double a,
    projection = gl_Matrix4_Rotate2d(projection, alpha);
    gl_beginSolidProgram(projection, &col);
    gl_vboActivateAttribOffset( marker_vbo, shaders.solid.vertex, 0, 2, GL_FLOAT, 0 );
-   glDrawArrays( GL_TRIANGLES, 0, 3 );
+   gl_drawArrays( GL_TRIANGLES, 0, 3 );
    gl_endSolidProgram();
    glDisable(GL_POLYGON_SMOOTH);
 }
@@ -963,22 +1019,63 @@ void map_renderParams( double bx, double by, double xpos, double ypos,
    *y = round((by - ypos + h/2) * 1.);
 }
 
+/**
+ * @brief Computes which map decorators are near known systems.
+ */
+static void map_genDecorators (void)
+{
+   int i, j;
+   MapDecorator *decorator;
+   StarSystem *sys;
+
+   if (decorator_visible == NULL)
+      decorator_visible = array_create( char );
+   array_resize( &decorator_visible, array_size(decorator_stack) );
+   for (i=0; i<array_size(decorator_stack); i++) {
+      decorator = &decorator_stack[i];
+      decorator_visible[i] = 0;
+      for (j=0; j<array_size(systems_stack); j++) {
+         sys = system_getIndex( j );
+
+         if (sys_isFlag(sys, SYSTEM_HIDDEN))
+            continue;
+
+         if (!sys_isKnown(sys))
+            continue;
+
+         if ((decorator->x < sys->pos.x + decorator->detection_radius) &&
+               (decorator->x > sys->pos.x - decorator->detection_radius) &&
+               (decorator->y < sys->pos.y + decorator->detection_radius) &&
+               (decorator->y > sys->pos.y - decorator->detection_radius)) {
+            decorator_visible[i] = 1;
+            break;
+         }
+      }
+   }
+   decorator_gen = space_pathGen;
+}
+
+
 /**
  * @brief Renders the map background decorators.
  */
 void map_renderDecorators( double x, double y, int editor, double alpha )
 {
-   int i,j;
+   int i;
    int sw, sh;
    double tx, ty;
-   int visible;
    MapDecorator *decorator;
-   StarSystem *sys;
    glColour ccol = { .r=1.00, .g=1.00, .b=1.00, .a=2./3. }; /**< White */
 
    /* Fade in the decorators to allow toggling between commodity and nothing */
    ccol.a *= alpha;
 
+   /* Visibility only changes with what systems are known. */
+   if (!editor && ((decorator_visible == NULL) ||
+         (array_size(decorator_visible) != array_size(decorator_stack)) ||
+         (decorator_gen != space_pathGen)))
+      map_genDecorators();
+
    for (i=0; i<array_size(decorator_stack); i++) {
 
       decorator = &decorator_stack[i];
@@ -987,28 +1084,7 @@ void map_renderDecorators( double x, double y, int editor, double alpha )
       if (decorator->image == NULL)
          continue;
 
-      visible=0;
-
-      if (!editor) {
-         for (j=0; j<array_size(systems_stack) && visible==0; j++) {
-            sys = system_getIndex( j );
-
-            if (sys_isFlag(sys, SYSTEM_HIDDEN))
-               continue;
-
-            if (!sys_isKnown(sys))
-               continue;
-
-            if ((decorator->x < sys->pos.x + decorator->detection_radius) &&
-                  (decorator->x > sys->pos.x - decorator->detection_radius) &&
-                  (decorator->y < sys->pos.y + decorator->detection_radius) &&
-                  (decorator->y > sys->pos.y - decorator->detection_radius)) {
-               visible=1;
-            }
-         }
-      }
-
-      if (editor || visible==1) {
+      if (editor || decorator_visible[i]) {
 
          tx = x + decorator->x*map_zoom;
          ty = y + decorator->y*map_zoom;
@@ -1112,7 +1188,7 @@ void map_renderSystemEnvironment( double x, double y, int editor, double alpha )
          projection = gl_Matrix4_Scale(projection, sw, sh, 1);
 
          /* Start the program. */
-         glUseProgram(shaders.nebula_map.program);
+         gl_useProgram(shaders.nebula_map.program);
 
          /* Set shader uniforms. */
          glUniform1f(shaders.nebula_map.hue, sys->nebu_hue);
@@ -1125,11 +1201,11 @@ void map_renderSystemEnvironment( double x, double y, int editor, double alpha )
          /* Draw. */
          glEnableVertexAttribArray( shaders.nebula_map.vertex );
          gl_vboActivateAttribOffset( gl_squareVBO, shaders.nebula_map.vertex, 0, 2, GL_FLOAT, 0 );
-         glDrawArrays( GL_TRIANGLE_STRIP, 0, 4 );
+         gl_drawArrays( GL_TRIANGLE_STRIP, 0, 4 );
 
          /* Clean up. */
          glDisableVertexAttribArray( shaders.nebula_map.vertex );
-         glUseProgram(0);
+         gl_useProgram(0);
          gl_checkErr();
       }
    }
@@ -1137,17 +1213,24 @@ void map_renderSystemEnvironment( double x, double y, int editor, double alpha )
 
 
 /**
- * @brief Renders the jump routes between systems.
+ * @brief Generates the vertices of the jump routes between systems.
+ *
+ * They are in galaxy coordinates so they only change with the known jumps.
+ *  The editor bumps space_pathGen whenever it moves systems or edits jumps.
+ *
+ *    @param editor Whether or not we are in the editor.
  */
-void map_renderJumps( double x, double y, int editor)
+static void map_genJumps( int editor )
 {
-   int i, j, k;
+   int i, j, k, l, n;
    const glColour *col, *cole;
-   GLfloat vertex[8*(2+4)];
+   GLfloat *vertex;
+   GLfloat pos[8], c[16];
    StarSystem *sys, *jsys;
 
-   /* Generate smooth lines. */
-   glLineWidth( CLAMP(1., 4., 2. * map_zoom)*gl_screen.scale );
+   if (map_jumps_vertex == NULL)
+      map_jumps_vertex = array_create( GLfloat );
+   array_resize( &map_jumps_vertex, 0 );
 
    for (i=0; i<array_size(systems_stack); i++) {
       sys = system_getIndex( i );
@@ -1158,11 +1241,6 @@ void map_renderJumps( double x, double y, int editor)
       if (!sys_isKnown(sys) && !editor)
          continue; /* we don't draw hyperspace lines */
 
-      /* first we draw all of the paths. */
-      gl_beginSmoothProgram(gl_view_matrix);
-      gl_vboActivateAttribOffset( map_vbo, shaders.smooth.vertex, 0, 2, GL_FLOAT, 0 );
-      gl_vboActivateAttribOffset( map_vbo, shaders.smooth.vertex_color,
-            sizeof(GLfloat) * 2*3, 4, GL_FLOAT, 0 );
       for (j = 0; j < array_size(sys->jumps); j++) {
          jsys = sys->jumps[j].target;
          if (sys_isFlag(jsys,SYSTEM_HIDDEN))
@@ -1188,31 +1266,79 @@ void map_renderJumps( double x, double y, int editor)
          else
             col = &cLightBlue;
 
-         /* Draw the lines. */
-         vertex[0]  = x + sys->pos.x * map_zoom;
-         vertex[1]  = y + sys->pos.y * map_zoom;
-         vertex[2]  = vertex[0] + (jsys->pos.x - sys->pos.x)/2. * map_zoom;
-         vertex[3]  = vertex[1] + (jsys->pos.y - sys->pos.y)/2. * map_zoom;
-         vertex[4]  = x + jsys->pos.x * map_zoom;
-         vertex[5]  = y + jsys->pos.y * map_zoom;
-         vertex[6]  = col->r;
-         vertex[7]  = col->g;
-         vertex[8]  = col->b;
-         vertex[9]  = 0.2;
-         vertex[10] = (col->r + cole->r)/2.;
-         vertex[11] = (col->g + cole->g)/2.;
-         vertex[12] = (col->b + cole->b)/2.;
-         vertex[13] = 0.8;
-         vertex[14] = cole->r;
-         vertex[15] = cole->g;
-         vertex[16] = cole->b;
-         vertex[17] = 0.2;
-         gl_vboSubData( map_vbo, 0, sizeof(GLfloat) * 3*(2+4), vertex );
-         glDrawArrays( GL_LINE_STRIP, 0, 3 );
+         /* Two segments meeting halfway, interleaved with the colours. */
+         pos[0] = sys->pos.x;
+         pos[1] = sys->pos.y;
+         pos[2] = (sys->pos.x + jsys->pos.x) / 2.;
+         pos[3] = (sys->pos.y + jsys->pos.y) / 2.;
+         pos[4] = pos[2];
+         pos[5] = pos[3];
+         pos[6] = jsys->pos.x;
+         pos[7] = jsys->pos.y;
+         c[0]  = col->r;
+         c[1]  = col->g;
+         c[2]  = col->b;
+         c[3]  = 0.2;
+         c[4]  = (col->r + cole->r)/2.;
+         c[5]  = (col->g + cole->g)/2.;
+         c[6]  = (col->b + cole->b)/2.;
+         c[7]  = 0.8;
+         memcpy( &c[8], &c[4], sizeof(GLfloat) * 4 );
+         c[12] = cole->r;
+         c[13] = cole->g;
+         c[14] = cole->b;
+         c[15] = 0.2;
+         n = array_size(map_jumps_vertex);
+         array_resize( &map_jumps_vertex, n + 4*(2+4) );
+         vertex = &map_jumps_vertex[n];
+         for (l=0; l<4; l++) {
+            memcpy( &vertex[l*(2+4)], &pos[2*l], sizeof(GLfloat) * 2 );
+            memcpy( &vertex[l*(2+4)+2], &c[4*l], sizeof(GLfloat) * 4 );
+         }
       }
-      gl_endSmoothProgram();
    }
 
+   /* Upload. */
+   if (map_jumps_vbo == NULL)
+      map_jumps_vbo = gl_vboCreateDynamic( sizeof(GLfloat) * array_size(map_jumps_vertex),
+            map_jumps_vertex );
+   else
+      gl_vboData( map_jumps_vbo, sizeof(GLfloat) * array_size(map_jumps_vertex),
+            map_jumps_vertex );
+   map_jumps_gen     = space_pathGen;
+   map_jumps_valid   = 1;
+   map_jumps_editor  = editor;
+}
+
+
+/**
+ * @brief Renders the jump routes between systems.
+ */
+void map_renderJumps( double x, double y, int editor)
+{
+   gl_Matrix4 projection;
+
+   /* The routes only change with the jumps or when switching to the editor. */
+   if (!map_jumps_valid || (map_jumps_editor != editor) || (map_jumps_gen != space_pathGen))
+      map_genJumps( editor );
+   if (array_size(map_jumps_vertex) == 0)
+      return;
+
+   /* Generate smooth lines. */
+   glLineWidth( CLAMP(1., 4., 2. * map_zoom)*gl_screen.scale );
+
+   /* Panning and zooming just moves the routes. */
+   projection = gl_Matrix4_Translate( gl_view_matrix, x, y, 0 );
+   projection = gl_Matrix4_Scale( projection, map_zoom, map_zoom, 1 );
+
+   gl_beginSmoothProgram( projection );
+   gl_vboActivateAttribOffset( map_jumps_vbo, shaders.smooth.vertex,
+         0, 2, GL_FLOAT, sizeof(GLfloat) * (2+4) );
+   gl_vboActivateAttribOffset( map_jumps_vbo, shaders.smooth.vertex_color,
+         sizeof(GLfloat) * 2, 4, GL_FLOAT, sizeof(GLfloat) * (2+4) );
+   gl_drawArrays( GL_LINES, 0, array_size(map_jumps_vertex) / (2+4) );
+   gl_endSmoothProgram();
+
    /* Reset render parameters. */
    glLineWidth( 1. );
 }
@@ -1334,7 +1460,7 @@ static void map_renderPath( double x, double y, double a, double alpha )
          gl_vboActivateAttribOffset( map_vbo, shaders.smooth.vertex, 0, 2, GL_FLOAT, 0 );
          gl_vboActivateAttribOffset( map_vbo, shaders.smooth.vertex_color,
                sizeof(GLfloat) * 2*6, 4, GL_FLOAT, 0 );
-         glDrawArrays( GL_TRIANGLE_STRIP, 0, 6 );
+         gl_drawArrays( GL_TRIANGLE_STRIP, 0, 6 );
          gl_endSmoothProgram();
 
          sys0 = sys1;
@@ -1352,10 +1478,24 @@ void map_renderNames( double bx, double by, double x, double y,
    double tx,ty, vx,vy, d,n;
    int textw;
    StarSystem *sys, *jsys;
-   int i, j;
-   char buf[32];
+   int i, j, cx, cy, gw, gh;
+   char buf[32], *used;
    glColour col;
 
+   /* Names are unreadable when zoomed out too far. */
+   if (map_zoom <= 0.5)
+      return;
+
+   /* Large universes get crowded in the editor, so only one name is drawn per
+    * screen cell until zoomed in. */
+   used = NULL;
+   gw = gh = 0;
+   if (editor && (map_zoom < MAP_LABEL_ZOOM)) {
+      gw = (int)(w / MAP_LABEL_CELL) + 1;
+      gh = (int)(h / gl_smallFont.h) + 1;
+      used = calloc( gw*gh, 1 );
+   }
+
    for (i=0; i<array_size(systems_stack); i++) {
       sys = system_getIndex( i );
 
@@ -1363,13 +1503,28 @@ void map_renderNames( double bx, double by, double x, double y,
          continue;
 
       /* Skip system. */
-      if ((!editor && !sys_isKnown(sys)) || (map_zoom <= 0.5 ))
+      if (!editor && !sys_isKnown(sys))
          continue;
 
-      textw = gl_printWidthRaw( &gl_smallFont, _(sys->name) );
       tx = x + (sys->pos.x+11.) * map_zoom;
       ty = y + (sys->pos.y-5.) * map_zoom;
 
+      /* Cheap check before measuring the text, names only extend right. */
+      if ((tx > bx+w) || (ty > by+h) || (ty+gl_smallFont.h < by))
+         continue;
+
+      if (used != NULL) {
+         cx = (int)((tx-bx) / MAP_LABEL_CELL);
+         cy = (int)((ty-by) / gl_smallFont.h);
+         if ((cx >= 0) && (cx < gw) && (cy >= 0) && (cy < gh)) {
+            if (used[ cy*gw + cx ])
+               continue;
+            used[ cy*gw + cx ] = 1;
+         }
+      }
+
+      textw = gl_printWidthRaw( &gl_smallFont, _(sys->name) );
+
       /* Skip if out of bounds. */
       if (!rectOverlap(tx, ty, textw, gl_smallFont.h, bx, by, w, h))
          continue;
@@ -1379,6 +1534,7 @@ void map_renderNames( double bx, double by, double x, double y,
       gl_printRaw( &gl_smallFont, tx, ty, &col, -1, _(sys->name) );
 
    }
+   free( used );
 
    /* Raw hidden values if we're in the editor. */
    if (!editor || (map_zoom <= 1.0))
@@ -1397,6 +1553,8 @@ void map_renderNames( double bx, double by, double x, double y,
          d   = MAX(n*0.3*map_zoom, 15);
          tx  = x + map_zoom*sys->pos.x + d*vx;
          ty  = y + map_zoom*sys->pos.y + d*vy;
+         if (!rectOverlap(tx, ty, MAP_LABEL_CELL, gl_smallFont.h, bx, by, w, h))
+            continue;
          /* Display. */
          n = sqrt(sys->jumps[j].hide);
          if (n == 0.)
@@ -1507,15 +1665,16 @@ static void map_renderSysBlack(double bx, double by, double x,double y, double w
 void map_renderCommod( double bx, double by, double x, double y,
       double w, double h, double r, int editor)
 {
-   int i,j,k;
+   int i,k;
    StarSystem *sys;
    double tx, ty;
-   Planet *p;
    Commodity *c;
    glColour ccol;
-   double best,worst,maxPrice,minPrice,curMaxPrice,curMinPrice,thisPrice;
+   const MapCommodPrice *mp;
+   double best,worst,curMaxPrice,curMinPrice;
    /* If not plotting commodities, return */
-   if (cur_commod == -1 || map_selected == -1)
+   if (cur_commod == -1 || map_selected == -1 ||
+         array_size(commod_prices) != array_size(systems_stack))
       return;
 
    c=commod_known[cur_commod];
@@ -1541,35 +1700,14 @@ void map_renderCommod( double bx, double by, double x, double y,
          }
       } else {
          /* not currently landed, so get max and min price in the selected system. */
-         if ((sys_isKnown(sys)) && (system_hasPlanet(sys))) {
-            minPrice=0;
-            maxPrice=0;
-            for ( j=0 ; j<array_size(sys->planets); j++) {
-               p=sys->planets[j];
-               for ( k=0; k<array_size(p->commodities); k++) {
-                  if ( p->commodities[k] == c ) {
-                     if ( p->commodityPrice[k].cnt > 0 ) {/*commodity is known about*/
-                        thisPrice = p->commodityPrice[k].sum / p->commodityPrice[k].cnt;
-                        if (thisPrice > maxPrice)maxPrice=thisPrice;
-                        if (minPrice == 0 || thisPrice < minPrice)minPrice = thisPrice;
-                        break;
-                     }
-                  }
-               }
-
-            }
-            if ( maxPrice == 0 ) {/* no prices are known here */
-               map_renderCommodIgnorance( x, y, sys, c );
-               map_renderSysBlack(bx,by,x,y,w,h,r,editor);
-               return;
-            }
-            curMaxPrice=maxPrice;
-            curMinPrice=minPrice;
-         } else {
+         mp = &commod_prices[map_selected];
+         if ( mp->cnt == 0 ) {/* no prices are known here */
             map_renderCommodIgnorance( x, y, sys, c );
             map_renderSysBlack(bx,by,x,y,w,h,r,editor);
             return;
          }
+         curMaxPrice=mp->max;
+         curMinPrice=mp->min;
       }
       for (i=0; i<array_size(systems_stack); i++) {
          sys = system_getIndex( i );
@@ -1590,28 +1728,13 @@ void map_renderCommod( double bx, double by, double x, double y,
 
          /* If system is known fill it. */
          if ((sys_isKnown(sys)) && (system_hasPlanet(sys))) {
-            minPrice=0;
-            maxPrice=0;
-            for ( j=0 ; j<array_size(sys->planets); j++) {
-               p=sys->planets[j];
-               for ( k=0; k<array_size(p->commodities); k++) {
-                  if ( p->commodities[k] == c ) {
-                     if ( p->commodityPrice[k].cnt > 0 ) {/*commodity is known about*/
-                        thisPrice = p->commodityPrice[k].sum / p->commodityPrice[k].cnt;
-                        if (thisPrice > maxPrice)maxPrice=thisPrice;
-                        if (minPrice == 0 || thisPrice < minPrice)minPrice = thisPrice;
-                        break;
-                     }
-                  }
-               }
-            }
-
+            mp = &commod_prices[i];
 
             /* Calculate best and worst profits */
-            if ( maxPrice > 0 ) {
+            if ( mp->cnt > 0 ) {
                /* Commodity sold at this system */
-               best = maxPrice - curMinPrice ;
-               worst= minPrice - curMaxPrice ;
+               best = mp->max - curMinPrice ;
+               worst= mp->min - curMaxPrice ;
                if ( best >= 0 ) {/* draw circle above */
                   gl_print(&gl_smallFont, x + (sys->pos.x+11) * map_zoom , y + (sys->pos.y-22)*map_zoom, &cLightBlue, "%.1f",best);
                   best = tanh ( 2*best / curMinPrice );
@@ -1654,35 +1777,19 @@ void map_renderCommod( double bx, double by, double x, double y,
 
          /* If system is known fill it. */
          if ((sys_isKnown(sys)) && (system_hasPlanet(sys))) {
-            double sumPrice=0;
-            int sumCnt=0;
-            for ( j=0 ; j<array_size(sys->planets); j++) {
-               p=sys->planets[j];
-               for ( k=0; k<array_size(p->commodities); k++) {
-                  if ( p->commodities[k] == c ) {
-                     if ( p->commodityPrice[k].cnt > 0 ) {/*commodity is known about*/
-                        thisPrice = p->commodityPrice[k].sum / p->commodityPrice[k].cnt;
-                        sumPrice+=thisPrice;
-                        sumCnt+=1;
-                        break;
-                     }
-                  }
-               }
-            }
-
-            if ( sumCnt > 0 ) {
+            mp = &commod_prices[i];
+            if ( mp->cnt > 0 ) {
                /* Commodity sold at this system */
                /* Colour as a % of global average */
                double frac;
-               sumPrice/=sumCnt;
-               if ( sumPrice < commod_av_gal_price ) {
-                  frac = tanh(5*(commod_av_gal_price / sumPrice - 1));
+               if ( mp->avg < commod_av_gal_price ) {
+                  frac = tanh(5*(commod_av_gal_price / mp->avg - 1));
                   col_blend( &ccol, &cFontOrange, &cFontYellow, frac );
                } else {
-                  frac = tanh(5*(sumPrice / commod_av_gal_price - 1));
+                  frac = tanh(5*(mp->avg / commod_av_gal_price - 1));
                   col_blend( &ccol, &cFontBlue, &cFontYellow, frac );
                }
-               gl_print(&gl_smallFont, x + (sys->pos.x+11) * map_zoom , y + (sys->pos.y-22)*map_zoom, &ccol, "%.1f",sumPrice);
+               gl_print(&gl_smallFont, x + (sys->pos.x+11) * map_zoom , y + (sys->pos.y-22)*map_zoom, &ccol, "%.1f",mp->avg);
                gl_drawCircle( tx, ty , r, &ccol, 1 );
             } else {
                /* Commodity not sold here */
@@ -2093,6 +2200,8 @@ void map_clear (void)
    }
    array_free(map_path);
    map_path = NULL;
+   array_free(map_path_dist);
+   map_path_dist = NULL;
 
    /* default system is current system */
    map_selectCur();
@@ -2142,6 +2251,113 @@ StarSystem* map_getDestination( int *jumps )
 }
 
 
+/**
+ * @brief Gets the distance flown through a system of the path.
+ *
+ * Goes from where pilots come in from the previous system to the jump radius
+ *  of the next one, without the randomness of space_calcJumpInPos.
+ *
+ *    @param sys System being crossed.
+ *    @param prev System coming from, or NULL to start at the player.
+ *    @param next System going to.
+ *    @return Distance flown in the system.
+ */
+static double map_legDistance( StarSystem *sys, StarSystem *prev, StarSystem *next )
+{
+   JumpPoint *jin, *jout;
+   Vector2d pos;
+   double a, d;
+
+   jout = jump_getTarget( next, sys );
+   if (jout == NULL)
+      return 0.;
+
+   if (prev == NULL)
+      pos = player.p->solid->pos;
+   else {
+      jin = jump_getTarget( prev, sys );
+      if (jin == NULL)
+         return 0.;
+      a = 2.*M_PI - jin->angle;
+      d = (HYPERSPACE_ENTER_MIN + HYPERSPACE_ENTER_MAX) / 2.;
+      vect_cset( &pos, jin->pos.x + d*cos(a), jin->pos.y + d*sin(a) );
+   }
+
+   return MAX( 0., vect_dist( &pos, &jout->pos ) - jout->radius );
+}
+
+
+/**
+ * @brief Estimates how long it takes to fly a distance from standstill to standstill.
+ *
+ *    @param d Distance to fly.
+ *    @param speed Maximum speed.
+ *    @param accel Acceleration.
+ *    @return Time it takes in seconds.
+ */
+static double map_legTime( double d, double speed, double accel )
+{
+   /* Short hops never reach the top speed. */
+   if (d*accel < speed*speed)
+      return 2. * sqrt( d / accel );
+   return d / speed + speed / accel;
+}
+
+
+/**
+ * @brief Computes the distances flown along the path if they're not cached.
+ *
+ * Only the first leg depends on where the player is, so the others are kept
+ *  until the path changes.
+ */
+static void map_pathCosts (void)
+{
+   int j;
+   StarSystem *prev;
+
+   if (map_path_dist != NULL)
+      return;
+
+   map_path_dist = array_create_size( double, MAX( 1, array_size(map_path) ) );
+   for (j=1; j<array_size(map_path); j++) {
+      prev = (j > 1) ? map_path[j-2] : cur_system;
+      array_push_back( &map_path_dist, map_legDistance( map_path[j-1], prev, map_path[j] ) );
+   }
+}
+
+
+/**
+ * @brief Estimates how long the player takes to get to the destination.
+ *
+ * Takes into account the flying based on the ship's speed and thrust, and the
+ *  hyperspace jumps, but not the time compression.
+ *
+ *    @return The estimated travel time, or 0 if there is no path set.
+ */
+ntime_t map_getTravelTime (void)
+{
+   int j;
+   double t, speed, accel;
+
+   if ((player.p == NULL) || (array_size(map_path) == 0))
+      return 0;
+
+   speed = solid_maxspeed( player.p->solid, player.p->speed, player.p->thrust );
+   accel = player.p->thrust / player.p->solid->mass;
+   if ((speed <= 0.) || (accel <= 0.))
+      return 0;
+
+   map_pathCosts();
+   t = map_legTime( map_legDistance( cur_system, NULL, map_path[0] ), speed, accel );
+   for (j=0; j<array_size(map_path_dist); j++)
+      t += map_legTime( map_path_dist[j], speed, accel );
+   t += array_size(map_path) * (HYPERSPACE_ENGINE_DELAY + HYPERSPACE_FLY_DELAY);
+
+   return ntime_create( 0, 0, (int)(t * NT_SECONDS_DT) ) +
+         array_size(map_path) * pilot_hyperspaceDelay( player.p );
+}
+
+
 /**
  * @brief Updates the map after a jump.
  */
@@ -2158,6 +2374,8 @@ void map_jump (void)
    /* update path if set */
    if (array_size(map_path) != 0) {
       array_erase( &map_path, &map_path[0], &map_path[1] );
+      array_free( map_path_dist );
+      map_path_dist = NULL;
       if (array_size(map_path) == 0)
          player_targetHyperspaceSet( -1 );
       else { /* get rid of bottom of the path */
@@ -2209,6 +2427,8 @@ void map_select( StarSystem *sys, char shifted )
          array_free( map_path );
          map_path  = NULL;
       }
+      array_free( map_path_dist );
+      map_path_dist = NULL;
 
       /* Try to make path if is reachable. */
       if (space_sysReachable(sys)) {
@@ -2251,139 +2471,150 @@ void map_select( StarSystem *sys, char shifted )
 }
 
 /*
- * A* algorithm for shortest path finding
+ * Jump path finding.
  *
- * Note since that we can't actually get an admissible heurestic for A* this is
- * in reality just Djikstras. I've removed the heurestic bit to make sure I
- * don't try to implement an admissible heuristic when I'm pretty sure there is
- * none.
+ * Every jump costs the same, so the shortest paths are found with a breadth
+ * first search. A search from a system gives the path to every other system,
+ * so the search trees are cached per start system and only redone when the
+ * jumps or their known status change (space_pathGen).
  */
 /**
- * @brief Node structure for A* pathfinding.
+ * @brief Cached search trees for a set of pathfinding options.
  */
-typedef struct SysNode_ {
-   struct SysNode_ *next; /**< Next node */
-   struct SysNode_ *gnext; /**< Next node in the garbage collector. */
-
-   struct SysNode_ *parent; /**< Parent node. */
-   StarSystem* sys; /**< System in node. */
-   int g; /**< step */
-} SysNode; /**< System Node for use in A* pathfinding. */
-static SysNode *A_gc;
+typedef struct MapPathCache_ {
+   int n; /**< Number of systems the cache is for. */
+   int **tree; /**< Search tree of each start system, NULL if not computed. */
+   int **dist; /**< Jumps from each start system to every system, -1 if unreachable. */
+   unsigned int *gen; /**< Value of space_pathGen each tree was computed at. */
+} MapPathCache;
+static MapPathCache map_paths[4]; /**< Caches indexed by 2*ignore_known + show_hidden. */
+static int *map_pathQueue = NULL; /**< Search queue reused by all the searches (array.h). */
 /* prototypes */
-static SysNode* A_newNode( StarSystem* sys );
-static int A_g( SysNode* n );
-static SysNode* A_add( SysNode *first, SysNode *cur );
-static SysNode* A_rm( SysNode *first, StarSystem *cur );
-static SysNode* A_in( SysNode *first, StarSystem *cur );
-static SysNode* A_lowest( SysNode *first );
-static void A_freeList( SysNode *first );
 static int map_decorator_parse( MapDecorator *temp, xmlNodePtr parent );
-/** @brief Creates a new node link to star system. */
-static SysNode* A_newNode( StarSystem* sys )
+/** @brief Checks to see if a jump of the jump graph can be used for a path. */
+static int map_pathUsable( unsigned int flags, StarSystem *target, int ignore_known, int show_hidden )
 {
-   SysNode* n;
-
-   n        = malloc(sizeof(SysNode));
-
-   n->next  = NULL;
-   n->sys   = sys;
+   /* Make sure it's reachable */
+   if (!ignore_known) {
+      if (!(flags & JP_KNOWN))
+         return 0;
+      if (!sys_isKnown(target) && !space_sysReachable(target))
+         return 0;
+   }
+   if (flags & JP_EXITONLY)
+      return 0;
 
-   n->gnext = A_gc;
-   A_gc     = n;
+   /* Skip hidden jumps if they're not specifically requested */
+   if (!show_hidden && (flags & JP_HIDDEN))
+      return 0;
 
-   return n;
-}
-/** @brief Gets the g from a node. */
-static int A_g( SysNode* n )
-{
-   return n->g;
+   return 1;
 }
-/** @brief Adds a node to the linked list. */
-static SysNode* A_add( SysNode *first, SysNode *cur )
+/**
+ * @brief Gets the search tree from a system.
+ *
+ * Each element is the index of the previous system on the shortest path to
+ *  that system, or -1 if it can't be reached.
+ *
+ *    @param[out] dist If not NULL, set to the number of jumps to each system.
+ */
+static const int* map_pathTree( const StarSystem *ssys, int ignore_known, int show_hidden,
+      const int **dist )
 {
-   SysNode *n;
-
-   if (first == NULL)
-      return cur;
-
-   n = first;
-   while (n->next != NULL)
-      n = n->next;
-   n->next = cur;
+   int i, k, e, n, s, head, tail;
+   int *tree, *d;
+   MapPathCache *c;
+   StarSystem *systems;
+   const JumpGraph *g;
+
+   systems = system_getAll();
+   g = space_jumpGraph();
+   n = array_size( systems );
+   c = &map_paths[ 2*(ignore_known != 0) + (show_hidden != 0) ];
+
+   /* Systems were added, start over. */
+   if (c->n != n) {
+      for (i=0; i<c->n; i++) {
+         free( c->tree[i] );
+         free( c->dist[i] );
+      }
+      free( c->tree );
+      free( c->dist );
+      free( c->gen );
+      c->tree = calloc( n, sizeof(int*) );
+      c->dist = calloc( n, sizeof(int*) );
+      c->gen  = calloc( n, sizeof(unsigned int) );
+      c->n    = n;
+   }
 
-   return first;
-}
-/* @brief Removes a node from a linked list. */
-static SysNode* A_rm( SysNode *first, StarSystem *cur )
-{
-   SysNode *n, *p;
+   /* Still valid. */
+   s = ssys->id;
+   if ((c->tree[s] != NULL) && (c->gen[s] == space_pathGen)) {
+      if (dist != NULL)
+         *dist = c->dist[s];
+      return c->tree[s];
+   }
 
-   if (first->sys == cur) {
-      n = first->next;
-      first->next = NULL;
-      return n;
+   if (c->tree[s] == NULL) {
+      c->tree[s] = malloc( n * sizeof(int) );
+      c->dist[s] = malloc( n * sizeof(int) );
+   }
+   tree = c->tree[s];
+   d    = c->dist[s];
+   c->gen[s] = space_pathGen;
+   for (i=0; i<n; i++) {
+      tree[i] = -1;
+      d[i]    = -1;
    }
 
-   p = first;
-   n = p->next;
-   do {
-      if (n->sys == cur) {
-         n->next = NULL;
-         p->next = n->next;
-         break;
+   /* Every system is queued at most once so the queue never grows. */
+   if (map_pathQueue == NULL)
+      map_pathQueue = array_create_size( int, n );
+   array_resize( &map_pathQueue, n );
+
+   /* Jumps are tried in order and the first to reach a system wins. */
+   tree[s]  = s;
+   d[s]     = 0;
+   map_pathQueue[0] = s;
+   head     = 0;
+   tail     = 1;
+   while (head < tail) {
+      k = map_pathQueue[head++];
+      for (e=g->start[k]; e<g->start[k+1]; e++) {
+         i = g->target[e];
+         if (tree[i] >= 0)
+            continue;
+         if (!map_pathUsable( g->flags[e], &systems[i], ignore_known, show_hidden ))
+            continue;
+         tree[i] = k;
+         d[i]    = d[k] + 1;
+         map_pathQueue[tail++] = i;
       }
-      p = n;
-   } while ((n=n->next) != NULL);
-
-   return first;
-}
-/** @brief Checks to see if node is in linked list. */
-static SysNode* A_in( SysNode *first, StarSystem *cur )
-{
-   SysNode *n;
-
-   if (first == NULL)
-      return NULL;
-
-   n = first;
-   do {
-      if (n->sys == cur)
-         return n;
-   } while ((n=n->next) != NULL);
-   return NULL;
-}
-/** @brief Returns the lowest ranking node from a linked list of nodes. */
-static SysNode* A_lowest( SysNode *first )
-{
-   SysNode *lowest, *n;
-
-   if (first == NULL)
-      return NULL;
+   }
 
-   n = first;
-   lowest = n;
-   do {
-      if (n->g < lowest->g)
-         lowest = n;
-   } while ((n=n->next) != NULL);
-   return lowest;
+   if (dist != NULL)
+      *dist = d;
+   return tree;
 }
-/** @brief Frees a linked list. */
-static void A_freeList( SysNode *first )
+/** @brief Frees the cached search trees. */
+static void map_pathFree (void)
 {
-   SysNode *p, *n;
-
-   if (first == NULL)
-      return;
+   int i, j;
+   MapPathCache *c;
 
-   p = NULL;
-   n = first;
-   do {
-      free(p);
-      p = n;
-   } while ((n=n->gnext) != NULL);
-   free(p);
+   for (i=0; i<4; i++) {
+      c = &map_paths[i];
+      for (j=0; j<c->n; j++) {
+         free( c->tree[j] );
+         free( c->dist[j] );
+      }
+      free( c->tree );
+      free( c->dist );
+      free( c->gen );
+      memset( c, 0, sizeof(MapPathCache) );
+   }
+   array_free( map_pathQueue );
+   map_pathQueue = NULL;
 }
 
 /** @brief Sets map_zoom to zoom and recreates the faction disk texture. */
@@ -2405,16 +2636,10 @@ void map_setZoom(double zoom)
 StarSystem** map_getJumpPath( const char* sysstart, const char* sysend,
     int ignore_known, int show_hidden, StarSystem** old_data )
 {
-   int i, j, cost, njumps, ojumps;
-
-   StarSystem *sys, *ssys, *esys, **res;
-   JumpPoint *jp;
-
-   SysNode *cur,   *neighbour;
-   SysNode *open,  *closed;
-   SysNode *ocost, *ccost;
+   int i, j, njumps, ojumps;
+   const int *tree;
+   StarSystem *ssys, *esys, *systems, **res;
 
-   A_gc = NULL;
    res = old_data;
    ojumps = array_size( old_data );
 
@@ -2439,95 +2664,71 @@ StarSystem** map_getJumpPath( const char* sysstart, const char* sysend,
       return NULL;
    }
 
-   /* start the linked lists */
-   open     = closed = NULL;
-   cur      = A_newNode( ssys );
-   cur->parent = NULL;
-   cur->g   = 0;
-   open     = A_add( open, cur ); /* Initial open node is the start system */
-
-   j = 0;
-   while ((cur = A_lowest(open))) {
-      /* End condition. */
-      if (cur->sys == esys)
-         break;
-
-      /* Break if infinite loop. */
-      j++;
-      if (j > MAP_LOOP_PROT)
-         break;
-
-      /* Get best from open and toss to closed */
-      open   = A_rm( open, cur->sys );
-      closed = A_add( closed, cur );
-      cost   = A_g(cur) + 1; /* Base unit is jump and always increases by 1. */
+   /* Not linked. */
+   tree = map_pathTree( ssys, ignore_known, show_hidden, NULL );
+   if (tree[ esys->id ] < 0) {
+      array_free( res );
+      return NULL;
+   }
 
-      for (i=0; i<array_size(cur->sys->jumps); i++) {
-         jp  = &cur->sys->jumps[i];
-         sys = jp->target;
+   /* Count the jumps. */
+   njumps = ojumps;
+   for (i=esys->id; i!=ssys->id; i=tree[i])
+      njumps++;
 
-         /* Make sure it's reachable */
-         if (!ignore_known) {
-            if (!jp_isKnown(jp))
-               continue;
-            if (!sys_isKnown(sys) && !space_sysReachable(sys))
-               continue;
-         }
-         if (jp_isFlag( jp, JP_EXITONLY ))
-            continue;
+   /* Build path backwards. */
+   if (res == NULL)
+      res = array_create_size( StarSystem*, njumps );
+   array_resize( &res, njumps );
+   systems = system_getAll();
+   for (i=esys->id, j=njumps-1; i!=ssys->id; i=tree[i], j--)
+      res[j] = &systems[i];
 
-         /* Skip hidden jumps if they're not specifically requested */
-         if (!show_hidden && jp_isFlag( jp, JP_HIDDEN ))
-            continue;
+   return res;
+}
 
-         /* Check to see if it's already in the closed set. */
-         ccost = A_in(closed, sys);
-         if ((ccost != NULL) && (cost >= A_g(ccost)))
-            continue;
-            //closed = A_rm( closed, sys );
-
-         /* Remove if it exists and current is better. */
-         ocost = A_in(open, sys);
-         if (ocost != NULL) {
-            if (cost < A_g(ocost))
-               open = A_rm( open, sys ); /* New path is better */
-            else
-               continue; /* This node is worse, so ignore it. */
-         }
 
-         /* Create the node. */
-         neighbour         = A_newNode( sys );
-         neighbour->parent = cur;
-         neighbour->g      = cost;
-         open              = A_add( open, neighbour );
-      }
+/**
+ * @brief Gets the number of jumps between two systems.
+ *
+ * Uses the same rules as map_getJumpPath() without building the path.
+ *
+ *    @param ssys System to start from.
+ *    @param esys System to end at.
+ *    @param ignore_known Whether or not to ignore if systems and jump points are known.
+ *    @param show_hidden Whether or not to use hidden jumps points.
+ *    @return Number of jumps, 0 if the systems are the same or -1 if there is no path.
+ */
+int map_jumpDist( const StarSystem *ssys, StarSystem *esys,
+      int ignore_known, int show_hidden )
+{
+   const int *dist;
 
-      /* Safety check in case not linked. */
-      if (open == NULL)
-         break;
-   }
+   if (ssys == esys)
+      return 0;
+   if (!ignore_known && !sys_isKnown(esys) && !space_sysReachable(esys))
+      return -1;
+   map_pathTree( ssys, ignore_known, show_hidden, &dist );
+   return dist[ esys->id ];
+}
 
-   /* Build path backwards if not broken from loop. */
-   if ( cur != NULL && esys == cur->sys ) {
-      njumps = A_g(cur) + ojumps;
-      assert( njumps > ojumps );
-      if (res == NULL)
-         res = array_create_size( StarSystem*, njumps );
-      array_resize( &res, njumps );
-      /* Build path. */
-      for (i=0; i<njumps-ojumps; i++) {
-         res[njumps-i-1] = cur->sys;
-         cur = cur->parent;
-      }
-   }
-   else {
-      res = NULL;
-      array_free( old_data );
-   }
 
-   /* free the linked lists */
-   A_freeList(A_gc);
-   return res;
+/**
+ * @brief Gets the number of jumps from a system to every system.
+ *
+ * The result is cached and only valid until the systems or jumps change,
+ *  copy it if needed.
+ *
+ *    @param ssys System to start from.
+ *    @param ignore_known Whether or not to ignore if systems and jump points are known.
+ *    @param show_hidden Whether or not to use hidden jumps points.
+ *    @return Jumps to each system indexed by system id, -1 if there is no path.
+ */
+const int* map_jumpDists( const StarSystem *ssys, int ignore_known, int show_hidden )
+{
+   const int *dist;
+   map_pathTree( ssys, ignore_known, show_hidden, &dist );
+   return dist;
 }
 
 
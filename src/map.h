@@ -30,6 +30,7 @@ int map_isOpen (void);
 
 /* misc */
 StarSystem* map_getDestination( int *jumps );
+ntime_t map_getTravelTime (void);
 void map_setZoom( double zoom );
 void map_select( StarSystem *sys, char shifted );
 void map_cleanup (void);
@@ -39,6 +40,9 @@ void map_jump (void);
 /* manipulate universe stuff */
 StarSystem **map_getJumpPath( const char *sysstart, const char *sysend, int ignore_known, int show_hidden,
                               StarSystem **old_data );
+int map_jumpDist( const StarSystem *ssys, StarSystem *esys,
+      int ignore_known, int show_hidden );
+const int* map_jumpDists( const StarSystem *ssys, int ignore_known, int show_hidden );
 int map_map( const Outfit *map );
 int map_isUseless( const Outfit* map );
 
@@ -41,6 +41,16 @@ static char **map_foundOutfitNames  = NULL; /**< Array (array.h): Internal names
 static tech_group_t **map_known_techs = NULL; /**< Array (array.h) of known techs. */
 static Planet **map_known_planets   = NULL;  /**< Array (array.h) of known planets with techs. */
 
+/**
+ * @brief Item available at a known planet, for looking up where items are.
+ */
+typedef struct map_knownItem_s {
+   const void *item; /**< Outfit or ship. */
+   int planet; /**< Index in map_known_planets. */
+} map_knownItem;
+static map_knownItem *map_known_outfits = NULL; /**< Array (array.h) of outfits at known planets sorted by outfit, built on demand. */
+static map_knownItem *map_known_ships = NULL; /**< Array (array.h) of ships at known planets sorted by ship, built on demand. */
+
 
 /*
  * Prototypes.
@@ -48,6 +58,9 @@ static Planet **map_known_planets   = NULL;  /**< Array (array.h) of known plane
 /* Init/cleanup. */
 static int map_knownInit (void);
 static void map_knownClean (void);
+static int map_knownItemCompare( const void *p1, const void *p2 );
+static map_knownItem* map_knownIndex( int ships );
+static int map_knownFind( const map_knownItem *idx, const void *item );
 /* Toolkit-related. */
 static void map_find_check_update( unsigned int wid, char *str );
 static void map_findClose( unsigned int wid, char* str );
@@ -125,6 +138,95 @@ static void map_knownClean (void)
    map_known_techs = NULL;
    array_free( map_known_planets );
    map_known_planets = NULL;
+   array_free( map_known_outfits );
+   map_known_outfits = NULL;
+   array_free( map_known_ships );
+   map_known_ships = NULL;
+}
+
+
+/**
+ * @brief Compares known items by item and then by planet.
+ */
+static int map_knownItemCompare( const void *p1, const void *p2 )
+{
+   const map_knownItem *k1, *k2;
+   uintptr_t i1, i2;
+
+   k1 = (const map_knownItem*) p1;
+   k2 = (const map_knownItem*) p2;
+   i1 = (uintptr_t) k1->item;
+   i2 = (uintptr_t) k2->item;
+   if (i1 < i2)
+      return -1;
+   else if (i1 > i2)
+      return +1;
+   return k1->planet - k2->planet;
+}
+
+
+/**
+ * @brief Gets the index of where the items are at the known planets.
+ *
+ * Built the first time it's needed, so searches don't have to go through the
+ *  techs of every known planet.
+ *
+ *    @param ships Whether to get the ship index instead of the outfit one.
+ *    @return Array (array.h) of items sorted by item.
+ */
+static map_knownItem* map_knownIndex( int ships )
+{
+   int i, j;
+   map_knownItem **idx, *k;
+   void **list;
+
+   idx = ships ? &map_known_ships : &map_known_outfits;
+   if (*idx != NULL)
+      return *idx;
+
+   *idx = array_create( map_knownItem );
+   for (i=0; i<array_size(map_known_techs); i++) {
+      if (ships)
+         list = (void**) tech_getShip( map_known_techs[i] );
+      else
+         list = (void**) tech_getOutfit( map_known_techs[i] );
+      for (j=0; j<array_size(list); j++) {
+         k = &array_grow( idx );
+         k->item   = list[j];
+         k->planet = i;
+      }
+      array_free( list );
+   }
+   qsort( *idx, array_size(*idx), sizeof(map_knownItem), map_knownItemCompare );
+
+   return *idx;
+}
+
+
+/**
+ * @brief Finds the first entry of an item in an index.
+ *
+ *    @param idx Index to look in.
+ *    @param item Item to find.
+ *    @return Position of the first entry of the item, or -1 if not found.
+ */
+static int map_knownFind( const map_knownItem *idx, const void *item )
+{
+   int l, h, m;
+
+   /* Lower bound. */
+   l = 0;
+   h = array_size(idx);
+   while (l < h) {
+      m = (l+h) / 2;
+      if ((uintptr_t)idx[m].item < (uintptr_t)item)
+         l = m+1;
+      else
+         h = m;
+   }
+   if ((l < array_size(idx)) && (idx[l].item == item))
+      return l;
+   return -1;
 }
 
 
@@ -738,8 +840,8 @@ static void map_showOutfitDetail(unsigned int wid, char* wgtname, int x, int y,
          (outfit->license != NULL) ? _(outfit->license) : _("None") );
    window_modifyText( wid, "txtDDesc", buf );
    window_modifyText( wid, "txtOutfitName", _(outfit->name) );
-   window_modifyText( wid, "txtDescShort", outfit->desc_short );
-   th = MAX( 128, gl_printHeightRaw( &gl_smallFont, 280, outfit->desc_short ) );
+   window_modifyText( wid, "txtDescShort", outfit_descShort(outfit) );
+   th = MAX( 128, gl_printHeightRaw( &gl_smallFont, 280, outfit_descShort(outfit) ) );
    window_moveWidget( wid, "txtSDesc", iw+20, -60-th-20 );
    window_moveWidget( wid, "txtDDesc", iw+20+90, -60-th-20 );
    th += gl_printHeightRaw( &gl_smallFont, 280, buf );
@@ -761,7 +863,8 @@ static int map_findSearchOutfits( unsigned int parent, const char *name )
    StarSystem *sys;
    const char *oname, *sysname;
    char **list;
-   Outfit *o, **olist;
+   Outfit *o;
+   const map_knownItem *idx;
 
    assert( "Outfit search is not reentrant!" && map_foundOutfitNames == NULL );
 
@@ -797,17 +900,10 @@ static int map_findSearchOutfits( unsigned int parent, const char *name )
    found = NULL;
    n = 0;
    len = array_size(map_known_techs);
-   for (i=0; i<len; i++) {
-      /* Try to find the outfit in the planet. */
-      olist = tech_getOutfit( map_known_techs[i] );
-      for (j=array_size(olist)-1; j>=0; j--)
-         if (olist[j] == o)
-            break;
-      array_free( olist );
-      olist = NULL;
-      if (j < 0)
-         continue;
-      pnt = map_known_planets[i];
+   idx = map_knownIndex( 0 );
+   j   = map_knownFind( idx, o );
+   for (i=j; (j >= 0) && (i<array_size(idx)) && (idx[i].item == o); i++) {
+      pnt = map_known_planets[ idx[i].planet ];
 
       /* System must be known. */
       sysname = planet_getSystem( pnt->name );
@@ -883,7 +979,8 @@ static int map_findSearchShips( unsigned int parent, const char *name )
    StarSystem *sys;
    const char *sname, *sysname;
    char **list;
-   Ship *s, **slist;
+   Ship *s;
+   const map_knownItem *idx;
 
    /* Match planet first. */
    s     = NULL;
@@ -915,17 +1012,10 @@ static int map_findSearchShips( unsigned int parent, const char *name )
    found = NULL;
    n = 0;
    len = array_size(map_known_techs);
-   for (i=0; i<len; i++) {
-      /* Try to find the ship in the planet. */
-      slist = tech_getShip( map_known_techs[i] );
-      for (j=array_size(slist)-1; j>=0; j--)
-         if (slist[j] == s)
-            break;
-      array_free(slist);
-      slist = NULL;
-      if (j < 0)
-         continue;
-      pnt = map_known_planets[i];
+   idx = map_knownIndex( 1 );
+   j   = map_knownFind( idx, s );
+   for (i=j; (j >= 0) && (i<array_size(idx)) && (idx[i].item == s); i++) {
+      pnt = map_known_planets[ idx[i].planet ];
 
       /* System must be known. */
       sysname = planet_getSystem( pnt->name );
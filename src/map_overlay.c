@@ -5,6 +5,7 @@
 
 /** @cond */
 #include <float.h>
+#include <stdint.h>
 #include "SDL.h"
 /** @endcond */
 
@@ -45,6 +46,7 @@ typedef struct MapOverlayPosOpt_ {
    float text_offx_base; /**< Base x position of the caption text. */
    float text_offy_base; /**< Base y position of the caption text. */
    float text_width; /**< width of the caption text. */
+   float radius; /**< Size of the item before fitting the sizes together. */
 } MapOverlayPosOpt;
 
 
@@ -71,6 +73,32 @@ static int ovr_open = 0; /**< Is the overlay open? */
 static double ovr_res = 10.; /**< Resolution. */
 
 
+#define OVR_GRID_CELL   64. /**< Size of the cells of the label grid in pixels. */
+
+
+/**
+ * @brief Inputs and result of laying out an item, to only redo what changed.
+ */
+typedef struct MapOverlayLayout_ {
+   const MapOverlayPos *mo; /**< Layout data of the item. */
+   Vector2d pos; /**< Position of the item. */
+   float radius; /**< Size of the item before fitting the sizes together. */
+   float text_width; /**< Width of the label. */
+   MapOverlayPos res; /**< Layout that was computed. */
+} MapOverlayLayout;
+static MapOverlayLayout *ovr_layout = NULL; /**< Last layout (array.h). */
+static double ovr_layoutRes = 0.; /**< Resolution of the last layout. */
+
+/* Grid of the items by their position in pixels, to find what overlaps. */
+static int *ovr_gridStart = NULL; /**< First entry of each cell in ovr_gridItems. */
+static int *ovr_gridItems = NULL; /**< Items sorted by cell. */
+static int ovr_gridW = 0; /**< Cells along X. */
+static int ovr_gridH = 0; /**< Cells along Y. */
+static float ovr_gridX = 0.; /**< X position of the grid origin in pixels. */
+static float ovr_gridY = 0.; /**< Y position of the grid origin in pixels. */
+static float ovr_gridReach = 0.; /**< How far objects and labels extend from their item. */
+
+
 /*
  * Prototypes
  */
@@ -78,7 +106,14 @@ static int update_collision( float *ox, float *oy, float weight,
       float x, float y, float w, float h,
       float mx, float my, float mw, float mh );
 static void ovr_optimizeLayout( int items, const Vector2d** pos,
+      MapOverlayPos** mo, MapOverlayPosOpt* moo, float res, const uint8_t *active );
+static uint8_t *ovr_layoutChanged( int items, const Vector2d** pos,
       MapOverlayPos** mo, MapOverlayPosOpt* moo, float res );
+static void ovr_layoutSave( int items, const Vector2d** pos,
+      MapOverlayPos** mo, MapOverlayPosOpt* moo, float res );
+static void ovr_gridBuild( int items, const Vector2d** pos, float res );
+static void ovr_gridFree (void);
+static void ovr_gridReachUpdate( const MapOverlayPos *mo, const MapOverlayPosOpt *moo );
 static void ovr_init_position( float *px, float *py, float res, float x, float y, float w, float h,
       float margin, const Vector2d** pos, MapOverlayPos** mo, MapOverlayPosOpt* moo, int items, int self,
       float pixbuf, float object_weight, float text_weight );
@@ -152,6 +187,7 @@ void ovr_refresh (void)
    const Vector2d **pos;
    MapOverlayPos **mo;
    MapOverlayPosOpt *moo;
+   uint8_t *active;
    char buf[STRMAX_SHORT];
 
    /* Must be open. */
@@ -204,8 +240,12 @@ void ovr_refresh (void)
    if (items == 0)
       ovr_res = 50.;
 
-   /* Compute text overlap and try to minimize it. */
-   ovr_optimizeLayout( items, pos, mo, moo, ovr_res );
+   /* Compute text overlap and try to minimize it, only for what changed. */
+   active = ovr_layoutChanged( items, pos, mo, moo, ovr_res );
+   if (active != NULL) {
+      ovr_optimizeLayout( items, pos, mo, moo, ovr_res, active );
+      free( active );
+   }
 
    /* Free the moos. */
    free( mo );
@@ -214,10 +254,214 @@ void ovr_refresh (void)
 }
 
 
+/**
+ * @brief Finds the items whose layout has to be computed again.
+ *
+ * Items that didn't change get their last layout back. Items that changed
+ *  and those close enough to be pushed around by them are laid out again.
+ *
+ *    @return Items to lay out again (to free), or NULL if nothing changed.
+ */
+static uint8_t *ovr_layoutChanged( int items, const Vector2d** pos,
+      MapOverlayPos** mo, MapOverlayPosOpt* moo, float res )
+{
+   int i, j, n, changed;
+   uint8_t *dirty, *active;
+   const MapOverlayLayout *l, **prev;
+   float reach, dx, dy;
+
+   if (items <= 0)
+      return NULL;
+
+   /* Everything moves with the resolution. */
+   n = array_size(ovr_layout);
+   if ((ovr_layout == NULL) || (ovr_layoutRes != res)) {
+      active = malloc( items );
+      memset( active, 1, items );
+      return active;
+   }
+
+   /* Match the items with the last layout. */
+   dirty   = calloc( items, 1 );
+   prev    = calloc( items, sizeof(MapOverlayLayout*) );
+   changed = (n != items);
+   for (i=0; i<items; i++) {
+      l = NULL;
+      if ((i < n) && (ovr_layout[i].mo == mo[i]))
+         l = &ovr_layout[i];
+      else {
+         for (j=0; j<n; j++) {
+            if (ovr_layout[j].mo == mo[i]) {
+               l = &ovr_layout[j];
+               break;
+            }
+         }
+      }
+      if ((l == NULL) || (l->pos.x != pos[i]->x) || (l->pos.y != pos[i]->y) ||
+            (l->radius != mo[i]->radius) || (l->text_width != moo[i].text_width)) {
+         dirty[i] = 1;
+         changed  = 1;
+         continue;
+      }
+      prev[i] = l;
+   }
+   if (!changed) {
+      for (i=0; i<items; i++)
+         *mo[i] = prev[i]->res;
+      free( prev );
+      free( dirty );
+      return NULL;
+   }
+
+   /* Sizes get fitted together again, but the labels stay where they were. */
+   for (i=0; i<items; i++) {
+      if (prev[i] == NULL)
+         continue;
+      mo[i]->text_offx = prev[i]->res.text_offx;
+      mo[i]->text_offy = prev[i]->res.text_offy;
+   }
+   free( prev );
+
+   /* Labels close to the changes may have to move too. */
+   active = calloc( items, 1 );
+   reach  = 0.;
+   for (i=0; i<n; i++)
+      if (fabs(ovr_layout[i].res.text_offx) < HUGE_VALF)
+         reach = MAX( reach, MAX( fabs(ovr_layout[i].res.text_offx) + ovr_layout[i].text_width,
+                  fabs(ovr_layout[i].res.text_offy) + gl_smallFont.h ) );
+   for (i=0; i<items; i++)
+      reach = MAX( reach, mo[i]->radius + moo[i].text_width );
+   reach *= 2.;
+   for (i=0; i<items; i++) {
+      if (!dirty[i])
+         continue;
+      for (j=0; j<items; j++) {
+         dx = (pos[i]->x - pos[j]->x) / res;
+         dy = (pos[i]->y - pos[j]->y) / res;
+         if ((fabs(dx) < reach) && (fabs(dy) < reach))
+            active[j] = 1;
+      }
+   }
+   /* Removed items may have been pushing the others around. */
+   for (j=0; j<n; j++) {
+      for (i=0; i<items; i++)
+         if (ovr_layout[j].mo == mo[i])
+            break;
+      if (i < items)
+         continue;
+      for (i=0; i<items; i++) {
+         dx = (ovr_layout[j].pos.x - pos[i]->x) / res;
+         dy = (ovr_layout[j].pos.y - pos[i]->y) / res;
+         if ((fabs(dx) < reach) && (fabs(dy) < reach))
+            active[i] = 1;
+      }
+   }
+   free( dirty );
+   return active;
+}
+
+
+/**
+ * @brief Remembers the layout to only redo what changes the next time.
+ */
+static void ovr_layoutSave( int items, const Vector2d** pos,
+      MapOverlayPos** mo, MapOverlayPosOpt* moo, float res )
+{
+   int i;
+   MapOverlayLayout *l;
+
+   if (ovr_layout == NULL)
+      ovr_layout = array_create( MapOverlayLayout );
+   array_resize( &ovr_layout, items );
+   for (i=0; i<items; i++) {
+      l = &ovr_layout[i];
+      l->mo          = mo[i];
+      l->pos         = *pos[i];
+      l->radius      = moo[i].radius;
+      l->text_width  = moo[i].text_width;
+      l->res         = *mo[i];
+   }
+   ovr_layoutRes = res;
+}
+
+
+/**
+ * @brief Sorts the items into the grid used to find what overlaps.
+ */
+static void ovr_gridBuild( int items, const Vector2d** pos, float res )
+{
+   int i, c, cx, cy;
+   float xmin, ymin, xmax, ymax;
+
+   xmin = ymin = HUGE_VALF;
+   xmax = ymax = -HUGE_VALF;
+   for (i=0; i<items; i++) {
+      xmin = MIN( xmin, pos[i]->x / res );
+      ymin = MIN( ymin, pos[i]->y / res );
+      xmax = MAX( xmax, pos[i]->x / res );
+      ymax = MAX( ymax, pos[i]->y / res );
+   }
+   ovr_gridX   = xmin;
+   ovr_gridY   = ymin;
+   ovr_gridW   = (int)((xmax-xmin) / OVR_GRID_CELL) + 1;
+   ovr_gridH   = (int)((ymax-ymin) / OVR_GRID_CELL) + 1;
+   ovr_gridReach = 0.;
+
+   /* Counting sort of the items by cell. */
+   ovr_gridStart = calloc( ovr_gridW*ovr_gridH + 1, sizeof(int) );
+   ovr_gridItems = malloc( items * sizeof(int) );
+   for (i=0; i<items; i++) {
+      cx = (int)((pos[i]->x / res - xmin) / OVR_GRID_CELL);
+      cy = (int)((pos[i]->y / res - ymin) / OVR_GRID_CELL);
+      ovr_gridStart[ cy*ovr_gridW + cx + 1 ]++;
+   }
+   for (c=0; c<ovr_gridW*ovr_gridH; c++)
+      ovr_gridStart[c+1] += ovr_gridStart[c];
+   for (i=items-1; i>=0; i--) {
+      cx = (int)((pos[i]->x / res - xmin) / OVR_GRID_CELL);
+      cy = (int)((pos[i]->y / res - ymin) / OVR_GRID_CELL);
+      c  = cy*ovr_gridW + cx;
+      ovr_gridItems[ --ovr_gridStart[c+1] ] = i;
+   }
+   /* The cursors ended up at the start of each cell, shift them back. */
+   memmove( &ovr_gridStart[0], &ovr_gridStart[1], ovr_gridW*ovr_gridH * sizeof(int) );
+   ovr_gridStart[ ovr_gridW*ovr_gridH ] = items;
+}
+
+
+/**
+ * @brief Frees the grid used to find what overlaps.
+ */
+static void ovr_gridFree (void)
+{
+   free( ovr_gridStart );
+   ovr_gridStart = NULL;
+   free( ovr_gridItems );
+   ovr_gridItems = NULL;
+}
+
+
+/**
+ * @brief Grows how far the objects and labels extend from their items.
+ *
+ * The queries add their own margin on top of it.
+ */
+static void ovr_gridReachUpdate( const MapOverlayPos *mo, const MapOverlayPosOpt *moo )
+{
+   float r;
+
+   r = mo->radius/2.;
+   /* Labels not placed yet are infinitely far away and can't overlap. */
+   if (fabs(mo->text_offx) < HUGE_VALF)
+      r = MAX( r, MAX( fabs(mo->text_offx) + moo->text_width, fabs(mo->text_offy) + gl_smallFont.h ) );
+   ovr_gridReach = MAX( ovr_gridReach, r );
+}
+
+
 /**
  * @brief Makes a best effort to fit the given assets' overlay indicators and labels fit without collisions.
  */
-static void ovr_optimizeLayout( int items, const Vector2d** pos, MapOverlayPos** mo, MapOverlayPosOpt* moo, float res )
+static void ovr_optimizeLayout( int items, const Vector2d** pos, MapOverlayPos** mo, MapOverlayPosOpt* moo, float res, const uint8_t *active )
 {
    int i, iter, changed;
    float cx,cy, ox,oy, r, off;
@@ -236,6 +480,10 @@ static void ovr_optimizeLayout( int items, const Vector2d** pos, MapOverlayPos**
    if (items <= 0)
       return;
 
+   /* Remember the sizes before fitting them to tell what changed next time. */
+   for (i=0; i<items; i++)
+      moo[i].radius = mo[i]->radius;
+
    /* Fix radii which fit together. */
    MapOverlayRadiusConstraint cur, *fits = array_create(MapOverlayRadiusConstraint);
    uint8_t *must_shrink = malloc( items );
@@ -266,14 +514,24 @@ static void ovr_optimizeLayout( int items, const Vector2d** pos, MapOverlayPos**
    free( must_shrink );
    array_free( fits );
 
-   /* Initialize text positions to infinity. */
+   /* Initialize text positions to infinity, the others keep theirs. */
    for (i=0; i<items; i++) {
+      if (!active[i])
+         continue;
       mo[i]->text_offx = HUGE_VALF;
       mo[i]->text_offy = HUGE_VALF;
    }
+   ovr_gridBuild( items, pos, res );
+   for (i=0; i<items; i++)
+      ovr_gridReachUpdate( mo[i], &moo[i] );
 
-   /* Initialize all items. */
+   /* Initialize the items to lay out. */
    for (i=0; i<items; i++) {
+      if (!active[i]) {
+         moo[i].text_offx_base = moo[i].text_offx = mo[i]->text_offx;
+         moo[i].text_offy_base = moo[i].text_offy = mo[i]->text_offy;
+         continue;
+      }
       /* Test to see what side is best to put the text on.
        * We actually compute the text overlap also so hopefully it will alternate
        * sides when stuff is clustered together. */
@@ -287,12 +545,15 @@ static void ovr_optimizeLayout( int items, const Vector2d** pos, MapOverlayPos**
       /* Initialize mo. */
       mo[i]->text_offx = moo[i].text_offx;
       mo[i]->text_offy = moo[i].text_offy;
+      ovr_gridReachUpdate( mo[i], &moo[i] );
    }
 
    /* Optimize over them. */
    for (iter=0; iter<max_iters; iter++) {
       changed = 0;
       for (i=0; i<items; i++) {
+         if (!active[i])
+            continue;
          cx = pos[i]->x / res;
          cy = pos[i]->y / res;
          /* Move text if overlap. */
@@ -326,11 +587,15 @@ static void ovr_optimizeLayout( int items, const Vector2d** pos, MapOverlayPos**
          /* Propagate updates. */
          mo[i]->text_offx = moo[i].text_offx;
          mo[i]->text_offy = moo[i].text_offy;
+         ovr_gridReachUpdate( mo[i], &moo[i] );
       }
       /* Converged (or unnecessary). */
       if (!changed)
          break;
    }
+
+   ovr_gridFree();
+   ovr_layoutSave( items, pos, mo, moo, res );
 }
 
 
@@ -412,29 +677,44 @@ static int ovr_refresh_compute_overlap( float *ox, float *oy,
       MapOverlayPos** mo, MapOverlayPosOpt* moo, int items, int self, int radius, float pixbuf,
       float object_weight, float text_weight )
 {
-   int i, collided;
-   float mx, my, mw, mh;
+   int i, k, c, cx, cy, x0, y0, x1, y1;
+   int collided;
+   float mx, my, mw, mh, reach;
    const float pb2 = pixbuf*2.;
+   (void) items;
 
    *ox = *oy = 0.;
    collided = 0;
 
-   for (i=0; i<items; i++) {
-      if (i != self || !radius) {
-         /* convert center coordinates to bottom left*/
-         mw = mo[i]->radius + pb2;
-         mh = mw;
-         mx = pos[i]->x/res - mw/2.;
-         my = pos[i]->y/res - mh/2.;
-         collided |= update_collision( ox, oy, object_weight, x, y, w, h, mx, my, mw, mh );
-      }
-      if (i != self || radius) {
-         /* no need to convert coordinates, just add pixbuf */
-         mw = moo[i].text_width + pb2;
-         mh = gl_smallFont.h + pb2;
-         mx = pos[i]->x/res + mo[i]->text_offx-pixbuf;
-         my = pos[i]->y/res + mo[i]->text_offy-pixbuf;
-         collided |= update_collision( ox, oy, text_weight, x, y, w, h, mx, my, mw, mh );
+   /* Only the cells of items which can reach the rectangle. */
+   reach = ovr_gridReach + pixbuf;
+   x0 = MAX( 0, (int)floor((x - reach - ovr_gridX) / OVR_GRID_CELL) );
+   y0 = MAX( 0, (int)floor((y - reach - ovr_gridY) / OVR_GRID_CELL) );
+   x1 = MIN( ovr_gridW-1, (int)floor((x + w + reach - ovr_gridX) / OVR_GRID_CELL) );
+   y1 = MIN( ovr_gridH-1, (int)floor((y + h + reach - ovr_gridY) / OVR_GRID_CELL) );
+
+   for (cy=y0; cy<=y1; cy++) {
+      for (cx=x0; cx<=x1; cx++) {
+         c = cy*ovr_gridW + cx;
+         for (k=ovr_gridStart[c]; k<ovr_gridStart[c+1]; k++) {
+            i = ovr_gridItems[k];
+            if (i != self || !radius) {
+               /* convert center coordinates to bottom left*/
+               mw = mo[i]->radius + pb2;
+               mh = mw;
+               mx = pos[i]->x/res - mw/2.;
+               my = pos[i]->y/res - mh/2.;
+               collided |= update_collision( ox, oy, object_weight, x, y, w, h, mx, my, mw, mh );
+            }
+            if (i != self || radius) {
+               /* no need to convert coordinates, just add pixbuf */
+               mw = moo[i].text_width + pb2;
+               mh = gl_smallFont.h + pb2;
+               mx = pos[i]->x/res + mo[i]->text_offx-pixbuf;
+               my = pos[i]->y/res + mo[i]->text_offy-pixbuf;
+               collided |= update_collision( ox, oy, text_weight, x, y, w, h, mx, my, mw, mh );
+            }
+         }
       }
    }
 
@@ -559,6 +839,7 @@ void ovr_render( double dt )
       for (j=0; j<ast->nb; j++)
          gui_renderAsteroid( &ast->asteroids[j], w, h, res, 1 );
    }
+   gui_renderContacts();
 
    /* Render the player. */
    gui_renderPlayer( res, 1 );
@@ -603,6 +884,10 @@ void ovr_mrkFree (void)
    /* Free array. */
    array_free( ovr_markers );
    ovr_markers = NULL;
+
+   /* The layout is no longer needed either. */
+   array_free( ovr_layout );
+   ovr_layout = NULL;
 }
 
 
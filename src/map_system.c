@@ -627,7 +627,7 @@ static void map_system_array_update( unsigned int wid, char* str ) {
                    "#nLicense:#0 %s"),
                  _(outfit->name),
                  _(outfit->description),
-                 outfit->desc_short,
+                 outfit_descShort(outfit),
                  player_outfitOwned( outfit ),
                  _(outfit_slotName( outfit )),
                  _(outfit_slotSize( outfit )),
@@ -685,7 +685,7 @@ static void map_system_array_update( unsigned int wid, char* str ) {
                  ship->fuel_consumption, n_( "unit", "units", ship->fuel_consumption ),
                  buf_price,
                  (ship->license != NULL) ? _(ship->license) : _("None"),
-                 ship->desc_stats
+                 ship_descStats(ship)
                  );
    } else if ( ( strcmp( str, MAPSYS_TRADE ) == 0 ) ) {
       Commodity *com;
@@ -924,6 +924,7 @@ static void map_system_genShipsList( unsigned int wid, float goodsSpace, float o
    if (nships > 0) {
       cships = calloc( nships, sizeof(ImageArrayCell) );
       for ( i=0; i<nships; i++ ) {
+         ship_gfxLoad( cur_planet_sel_ships[i] );
          cships[i].image = gl_dupTexture( cur_planet_sel_ships[i]->gfx_store );
          cships[i].caption = strdup( _(cur_planet_sel_ships[i]->name) );
       }
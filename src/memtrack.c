@@ -0,0 +1,143 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+
+/**
+ * @file memtrack.c
+ *
+ * @brief Keeps track of the memory used by the major subsystems.
+ *
+ * Most subsystems count their allocations as they happen. Textures are
+ *  summed from the texture cache when asked for, and arrays are only counted
+ *  when built with DEBUG_ARRAYS. The usage is shown in the profiler overlay,
+ *  returned by naev.memory() and logged at exit.
+ */
+
+
+/** @cond */
+#include "SDL_atomic.h"
+
+#include "naev.h"
+/** @endcond */
+
+#include "memtrack.h"
+
+#include "array.h"
+#include "log.h"
+#include "opengl_tex.h"
+
+
+/**
+ * @brief Memory usage of a subsystem.
+ */
+typedef struct MemTrackStat_ {
+   size_t used; /**< Bytes currently in use. */
+   size_t peak; /**< Most bytes used at once. */
+} MemTrackStat;
+
+
+static const char *memtrack_names[MEMTRACK_N] = {
+   "textures",
+   "lua",
+   "audio",
+   "pilots",
+   "weapons",
+   "arrays"
+}; /**< Names of the subsystems. */
+static MemTrackStat memtrack_stats[MEMTRACK_N]; /**< Usage of the subsystems. */
+static SDL_SpinLock memtrack_lock = 0; /**< Sounds are loaded from worker threads. */
+
+
+/**
+ * @brief Counts memory allocated by a subsystem.
+ *
+ *    @param sub Subsystem allocating.
+ *    @param size Bytes allocated.
+ */
+void memtrack_alloc( MemTrack sub, size_t size )
+{
+   MemTrackStat *s = &memtrack_stats[sub];
+   SDL_AtomicLock( &memtrack_lock );
+   s->used += size;
+   s->peak  = MAX( s->peak, s->used );
+   SDL_AtomicUnlock( &memtrack_lock );
+}
+
+
+/**
+ * @brief Counts memory freed by a subsystem.
+ *
+ *    @param sub Subsystem freeing.
+ *    @param size Bytes freed.
+ */
+void memtrack_free( MemTrack sub, size_t size )
+{
+   MemTrackStat *s = &memtrack_stats[sub];
+   SDL_AtomicLock( &memtrack_lock );
+   s->used -= MIN( size, s->used );
+   SDL_AtomicUnlock( &memtrack_lock );
+}
+
+
+/**
+ * @brief Sets the memory used by a subsystem that can't count as it goes.
+ *
+ *    @param sub Subsystem to set.
+ *    @param size Bytes in use.
+ */
+void memtrack_set( MemTrack sub, size_t size )
+{
+   MemTrackStat *s = &memtrack_stats[sub];
+   SDL_AtomicLock( &memtrack_lock );
+   s->used = size;
+   s->peak = MAX( s->peak, size );
+   SDL_AtomicUnlock( &memtrack_lock );
+}
+
+
+/**
+ * @brief Gets the memory usage of a subsystem.
+ *
+ *    @param i Index of the subsystem (see MemTrack).
+ *    @param[out] name Name of the subsystem.
+ *    @param[out] used Bytes currently in use.
+ *    @param[out] peak Most bytes used at once, as far as it was seen.
+ *    @return 0 on success, -1 if there is no such subsystem.
+ */
+int memtrack_get( int i, const char **name, size_t *used, size_t *peak )
+{
+   MemTrackStat *s;
+
+   if ((i < 0) || (i >= MEMTRACK_N))
+      return -1;
+
+   /* Those not counted as they go are updated now. */
+   if (i == MEMTRACK_TEXTURES)
+      memtrack_set( i, gl_texMemory() );
+   else if (i == MEMTRACK_ARRAYS)
+      memtrack_set( i, (size_t)MAX( 0, array_stats().bytes ) );
+
+   s = &memtrack_stats[i];
+   SDL_AtomicLock( &memtrack_lock );
+   *name = memtrack_names[i];
+   *used = s->used;
+   *peak = s->peak;
+   SDL_AtomicUnlock( &memtrack_lock );
+   return 0;
+}
+
+
+/**
+ * @brief Logs the memory usage of all the subsystems.
+ */
+void memtrack_report (void)
+{
+   int i;
+   const char *name;
+   size_t used, peak;
+
+   LOG(_("Memory usage:"));
+   LOG("   %-10s %10s %10s", "subsystem", "MiB", "peak MiB");
+   for (i=0; memtrack_get( i, &name, &used, &peak )==0; i++)
+      LOG("   %-10s %10.2f %10.2f", name, used / 1048576., peak / 1048576.);
+}
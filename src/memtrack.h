@@ -0,0 +1,40 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+
+
+
+#ifndef MEMTRACK_H
+#  define MEMTRACK_H
+
+
+/** @cond */
+#include <stddef.h>
+/** @endcond */
+
+
+/**
+ * @brief Subsystems whose memory usage is tracked.
+ */
+typedef enum MemTrack_ {
+   MEMTRACK_TEXTURES, /**< Cached textures and atlas pages (estimated GPU memory). */
+   MEMTRACK_LUA, /**< Lua heap of naevL. */
+   MEMTRACK_AUDIO, /**< OpenAL sound buffers. */
+   MEMTRACK_PILOTS, /**< Pilot structures, including the pooled ones. */
+   MEMTRACK_WEAPONS, /**< Weapon pool chunks. */
+   MEMTRACK_ARRAYS, /**< Memory reserved by arrays, only with DEBUG_ARRAYS. */
+   MEMTRACK_N /**< Number of subsystems, not a subsystem. */
+} MemTrack;
+
+
+/* Counting. */
+void memtrack_alloc( MemTrack sub, size_t size );
+void memtrack_free( MemTrack sub, size_t size );
+void memtrack_set( MemTrack sub, size_t size );
+
+/* Reporting. */
+int memtrack_get( int i, const char **name, size_t *used, size_t *peak );
+void memtrack_report (void);
+
+
+#endif /* MEMTRACK_H */
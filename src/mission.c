@@ -39,6 +39,7 @@
 #include "player.h"
 #include "rng.h"
 #include "space.h"
+#include "strindex.h"
 
 
 #define XML_MISSION_TAG       "mission" /**< XML mission tag. */
@@ -57,6 +58,15 @@ Mission *player_missions[MISSION_MAX]; /**< Player's active missions. */
 static MissionData *mission_stack = NULL; /**< Unmutable after creation */
 
 
+/*
+ * candidate indices, all in ascending (priority) order
+ */
+#define MISSION_LOCATIONS  (MIS_AVAIL_SPACE+1) /**< Number of mission locations. */
+static int *mission_byLoc[MISSION_LOCATIONS]; /**< Missions without a planet requirement by location (array.h). */
+static StrIndex mission_planetIndex; /**< First mission requiring each planet. */
+static int *mission_planetNext = NULL; /**< Next mission requiring the same planet, or -1 (array.h). */
+
+
 /*
  * prototypes
  */
@@ -64,15 +74,20 @@ static MissionData *mission_stack = NULL; /**< Unmutable after creation */
 /* Generation. */
 static unsigned int mission_genID (void);
 static int mission_init( Mission* mission, MissionData* misn, int genid, int create, unsigned int *id );
+static int mission_loadEnv( Mission* mission );
+static void mission_rest( Mission* misn );
 static void mission_freeData( MissionData* mission );
 /* Matching. */
 static int mission_compare( const void* arg1, const void* arg2 );
 static int mission_meetReq( int mission, int faction,
       const char* planet, const char* sysname );
 static int mission_matchFaction( MissionData* misn, int faction );
+static int mission_nextCandidate( int loc, int *li, int *pi );
 static int mission_location( const char *loc );
 /* Loading. */
 static int missions_cmp( const void *a, const void *b );
+static void missions_buildIndex (void);
+static void missions_freeIndex (void);
 static int mission_parseFile( const char* file );
 static int mission_parseXML( MissionData *temp, const xmlNodePtr parent );
 static int missions_parseActive( xmlNodePtr parent );
@@ -175,6 +190,33 @@ static int mission_init( Mission* mission, MissionData* misn, int genid, int cre
    }
 
    /* init Lua */
+   if (mission_loadEnv( mission ) != 0)
+      return -1;
+
+   /* run create function */
+   if (create) {
+      /* Failed to create. */
+      ret = misn_run( mission, "create");
+      if (ret) {
+         mission_cleanup(mission);
+         return ret;
+      }
+   }
+
+   return 0;
+}
+
+
+/**
+ * @brief Creates the Lua environment of a mission and loads its code.
+ *
+ *    @param mission Mission to load the code of.
+ *    @return 0 on success.
+ */
+static int mission_loadEnv( Mission* mission )
+{
+   MissionData *misn = mission->data;
+
    mission->env = nlua_newEnv(1);
 
    misn_loadLibs( mission->env ); /* load our custom libraries */
@@ -188,17 +230,75 @@ static int mission_init( Mission* mission, MissionData* misn, int genid, int cre
       return -1;
    }
 
-   /* run create function */
-   if (create) {
-      /* Failed to create. */
-      ret = misn_run( mission, "create");
-      if (ret) {
-         mission_cleanup(mission);
-         return ret;
+   return 0;
+}
+
+
+/**
+ * @brief Frees the Lua environment of a mission until it is needed again.
+ *
+ * The Lua data is kept as it would be saved, waking the mission is the same
+ *  as loading it from a save.
+ *
+ *    @param misn Mission to rest.
+ */
+static void mission_rest( Mission* misn )
+{
+   xmlDocPtr doc;
+
+   doc = nxml_persistLuaDoc( misn->env );
+   if (doc == NULL)
+      return;
+
+   nlua_freeEnv( misn->env );
+   misn->env  = LUA_NOREF;
+   misn->rest = doc;
+}
+
+
+/**
+ * @brief Recreates the Lua environment of a resting mission.
+ *
+ *    @param misn Mission to wake, nothing is done if it isn't resting.
+ *    @return 0 on success.
+ */
+int mission_wake( Mission *misn )
+{
+   int ret;
+
+   misn->busy = 1;
+   if (misn->rest == NULL)
+      return 0;
+
+   ret = mission_loadEnv( misn );
+   if (ret == 0)
+      nxml_unpersistLua( misn->env, xmlDocGetRootElement( misn->rest ) );
+   xmlFreeDoc( misn->rest );
+   misn->rest = NULL;
+   return ret;
+}
+
+
+/**
+ * @brief Lets the player's missions that haven't run since the last call and
+ *        only wait on hooks that run seldom rest.
+ */
+void missions_rest (void)
+{
+   int i;
+   Mission *misn;
+
+   for (i=0; i<MISSION_MAX; i++) {
+      misn = player_missions[i];
+      if ((misn->id == 0) || (misn->rest != NULL))
+         continue;
+      if (misn->busy) {
+         misn->busy = 0;
+         continue;
       }
+      if (hook_restMisnParent( misn->id ))
+         mission_rest( misn );
    }
-
-   return 0;
 }
 
 
@@ -272,7 +372,7 @@ static int mission_meetReq( int mission, int faction,
 
    /* Must meet Lua condition. */
    if (misn->avail.cond != NULL) {
-      c = cond_check(misn->avail.cond);
+      c = cond_checkChunk(misn->avail.cond_chunk);
       if (c < 0) {
          WARN(_("Conditional for mission '%s' failed to run"), misn->name);
          return 0;
@@ -290,6 +390,35 @@ static int mission_meetReq( int mission, int faction,
 }
 
 
+/**
+ * @brief Gets the next mission that could be available at a location.
+ *
+ * Merges the missions of the location with the missions requiring the
+ *  planet, so they're visited in the same order as the stack.
+ *
+ *    @param loc Location to get candidates of.
+ *    @param[in,out] li Position in the location's candidates, start at 0.
+ *    @param[in,out] pi Next candidate requiring the planet, start with the
+ *                   first one or -1.
+ *    @return ID of the next candidate or -1 when there are no more.
+ */
+static int mission_nextCandidate( int loc, int *li, int *pi )
+{
+   int l;
+   const int *list = mission_byLoc[ loc ];
+
+   l = (*li < array_size(list)) ? list[ *li ] : -1;
+   if ((*pi >= 0) && ((l < 0) || (*pi < l))) {
+      l   = *pi;
+      *pi = mission_planetNext[ *pi ];
+      return l;
+   }
+   if (l >= 0)
+      (*li)++;
+   return l;
+}
+
+
 /**
  * @brief Runs missions matching location, all Lua side and one-shot.
  *
@@ -302,10 +431,15 @@ void missions_run( int loc, int faction, const char* planet, const char* sysname
 {
    MissionData* misn;
    Mission mission;
-   int i;
+   int i, li, pi;
    double chance;
 
-   for (i=0; i<array_size(mission_stack); i++) {
+   if ((loc < 0) || (loc >= MISSION_LOCATIONS))
+      return;
+
+   li = 0;
+   pi = strindex_get( &mission_planetIndex, planet );
+   while ((i = mission_nextCandidate( loc, &li, &pi )) >= 0) {
       misn = &mission_stack[i];
       if (misn->avail.loc != loc)
          continue;
@@ -518,6 +652,8 @@ void mission_cleanup( Mission* misn )
     */
    if (misn->env != LUA_NOREF && misn->env != 0)
       nlua_freeEnv(misn->env);
+   if (misn->rest != NULL)
+      xmlFreeDoc(misn->rest);
 
    /* Data. */
    free(misn->title);
@@ -577,6 +713,7 @@ static void mission_freeData( MissionData* mission )
    free(mission->avail.system);
    array_free(mission->avail.factions);
    free(mission->avail.cond);
+   cond_free(mission->avail.cond_chunk);
    free(mission->avail.done);
 
    /* Clear the memory. */
@@ -667,57 +804,144 @@ static int mission_compare( const void* arg1, const void* arg2 )
 Mission* missions_genList( int *n, int faction,
       const char* planet, const char* sysname, int loc )
 {
-   int i,j, m, alloced;
-   double chance;
-   int rep;
+   int m;
    Mission* tmp;
-   MissionData* misn;
+   MissionGen gen;
+
+   /* Generate all in one go. */
+   missions_genStart( &gen, faction, planet, sysname, loc );
+   missions_genStep( &gen, -1. );
+
+   /* Take the missions. */
+   m   = array_size( gen.missions );
+   tmp = NULL;
+   if (m > 0) {
+      tmp = malloc( sizeof(Mission) * m );
+      memcpy( tmp, gen.missions, sizeof(Mission) * m );
+      missions_sort( tmp, m );
+   }
+   array_resize( &gen.missions, 0 );
+   missions_genFree( &gen );
 
-   /* Find available missions. */
-   tmp      = NULL;
-   m        = 0;
-   alloced  = 0;
-   for (i=0; i<array_size(mission_stack); i++) {
+   (*n) = m;
+   return tmp;
+}
+
+
+/**
+ * @brief Starts generating missions in steps.
+ *
+ * The missions are generated in the same order as missions_genList, but
+ *  missions_genStep can stop after a time budget so the generation can be
+ *  spread out over frames.
+ *
+ *    @param[out] gen Generation state to set up.
+ *    @param faction Faction of the planet.
+ *    @param planet Name of the planet.
+ *    @param sysname Name of the current system.
+ *    @param loc Location.
+ */
+void missions_genStart( MissionGen *gen, int faction,
+      const char* planet, const char* sysname, int loc )
+{
+   memset( gen, 0, sizeof(MissionGen) );
+   gen->loc       = loc;
+   gen->faction   = faction;
+   gen->planet    = (planet != NULL) ? strdup( planet ) : NULL;
+   gen->sysname   = (sysname != NULL) ? strdup( sysname ) : NULL;
+   gen->pi        = strindex_get( &mission_planetIndex, planet );
+   gen->missions  = array_create( Mission );
+   gen->done      = ((loc < 0) || (loc >= MISSION_LOCATIONS));
+}
+
+
+/**
+ * @brief Generates missions until done or out of time.
+ *
+ * Generated missions get appended to gen->missions, the caller can take them
+ *  from there and empty the array.
+ *
+ *    @param gen Generation state.
+ *    @param budget Time to spend in seconds, negative to not stop until done.
+ *    @return 1 if the generation is done, 0 otherwise.
+ */
+int missions_genStep( MissionGen *gen, double budget )
+{
+   int i, j, rep;
+   double chance;
+   Uint64 start, limit;
+   MissionData *misn;
+   Mission *m;
+
+   start = SDL_GetPerformanceCounter();
+   limit = (Uint64)(MAX( 0., budget ) * (double)SDL_GetPerformanceFrequency());
+   while (!gen->done) {
+      i = mission_nextCandidate( gen->loc, &gen->li, &gen->pi );
+      if (i < 0) {
+         gen->done = 1;
+         break;
+      }
       misn = &mission_stack[i];
-      if (misn->avail.loc == loc) {
+      if (misn->avail.loc != gen->loc)
+         continue;
 
-         /* Must meet requirements. */
-         if (!mission_meetReq(i, faction, planet, sysname))
-            continue;
+      /* Must meet requirements. */
+      if (!mission_meetReq(i, gen->faction, gen->planet, gen->sysname))
+         continue;
 
-         /* Must hit chance. */
-         chance = (double)(misn->avail.chance % 100)/100.;
-         if (chance == 0.) /* We want to consider 100 -> 100% not 0% */
-            chance = 1.;
-         rep = MAX(1, misn->avail.chance / 100);
-
-         for (j=0; j<rep; j++) /* random chance of rep appearances */
-            if (RNGF() < chance) {
-               m++;
-               /* Extra allocation. */
-               if (m > alloced) {
-                  if (alloced == 0)
-                     alloced = 32;
-                  else
-                     alloced *= 2;
-                  tmp      = realloc( tmp, sizeof(Mission) * alloced );
-               }
-               /* Initialize the mission. */
-               if (mission_init( &tmp[m-1], misn, 1, 1, NULL ))
-                  m--;
-            }
+      /* Must hit chance. */
+      chance = (double)(misn->avail.chance % 100)/100.;
+      if (chance == 0.) /* We want to consider 100 -> 100% not 0% */
+         chance = 1.;
+      rep = MAX(1, misn->avail.chance / 100);
+
+      for (j=0; j<rep; j++) { /* random chance of rep appearances */
+         if (RNGF() < chance) {
+            /* Initialize the mission. */
+            m = &array_grow( &gen->missions );
+            if (mission_init( m, misn, 1, 1, NULL ))
+               array_resize( &gen->missions, array_size(gen->missions)-1 );
+         }
       }
-   }
 
-   /* Sort. */
-   if (tmp != NULL) {
-      qsort( tmp, m, sizeof(Mission), mission_compare );
-      (*n) = m;
+      /* Out of time. */
+      if ((budget >= 0.) && (SDL_GetPerformanceCounter() - start > limit))
+         break;
    }
-   else
-      (*n) = 0;
 
-   return tmp;
+   return gen->done;
+}
+
+
+/**
+ * @brief Frees a mission generation, cleaning up the missions not taken.
+ *
+ *    @param gen Generation state to free.
+ */
+void missions_genFree( MissionGen *gen )
+{
+   int i;
+
+   for (i=0; i<array_size(gen->missions); i++)
+      mission_cleanup( &gen->missions[i] );
+   array_free( gen->missions );
+   free( gen->planet );
+   free( gen->sysname );
+   memset( gen, 0, sizeof(MissionGen) );
+   gen->done = 1;
+}
+
+
+/**
+ * @brief Sorts missions in the order they should be shown.
+ *
+ *    @param missions Missions to sort.
+ *    @param n Number of missions.
+ */
+void missions_sort( Mission *missions, int n )
+{
+   if (n > 0)
+      qsort( missions, n, sizeof(Mission), mission_compare );
 }
 
 
@@ -827,6 +1051,11 @@ static int mission_parseXML( MissionData *temp, const xmlNodePtr parent )
    MELEMENT((temp->avail.loc!=MIS_AVAIL_NONE) && (temp->avail.chance==0),"chance");
 #undef MELEMENT
 
+   /* Compile the condition once, it gets checked often. */
+   temp->avail.cond_chunk = LUA_NOREF;
+   if (temp->avail.cond != NULL)
+      temp->avail.cond_chunk = cond_compile( temp->avail.cond );
+
    return 0;
 }
 
@@ -847,6 +1076,69 @@ static int missions_cmp( const void *a, const void *b )
 }
 
 
+/**
+ * @brief Builds the candidate indices of the missions.
+ *
+ * Missions requiring a planet are only indexed by the planet, the others by
+ *  their location. The stack must not change afterwards.
+ */
+static void missions_buildIndex (void)
+{
+   int i, j, loc;
+   int *tail;
+   MissionData *misn;
+
+   for (i=0; i<MISSION_LOCATIONS; i++)
+      mission_byLoc[i] = array_create( int );
+   strindex_init( &mission_planetIndex );
+   mission_planetNext = array_create_size( int, array_size(mission_stack) );
+   array_resize( &mission_planetNext, array_size(mission_stack) );
+   tail = malloc( MAX(1,array_size(mission_stack)) * sizeof(int) );
+
+   for (i=0; i<array_size(mission_stack); i++) {
+      misn = &mission_stack[i];
+      loc  = misn->avail.loc;
+      mission_planetNext[i] = -1;
+
+      /* Missions not requiring a planet go by location. */
+      if (misn->avail.planet == NULL) {
+         if ((loc >= 0) && (loc < MISSION_LOCATIONS))
+            array_push_back( &mission_byLoc[loc], i );
+         continue;
+      }
+
+      /* Append to the planet's chain, the index has its head. */
+      j = strindex_get( &mission_planetIndex, misn->avail.planet );
+      if (j < 0) {
+         strindex_add( &mission_planetIndex, misn->avail.planet, i );
+         tail[i] = i;
+      }
+      else {
+         mission_planetNext[ tail[j] ] = i;
+         tail[j] = i;
+      }
+   }
+   free( tail );
+}
+
+
+/**
+ * @brief Frees the candidate indices of the missions.
+ */
+static void missions_freeIndex (void)
+{
+   int i;
+
+   for (i=0; i<MISSION_LOCATIONS; i++) {
+      array_free( mission_byLoc[i] );
+      mission_byLoc[i] = NULL;
+   }
+   strindex_free( &mission_planetIndex );
+   array_free( mission_planetNext );
+   mission_planetNext = NULL;
+}
+
+
 /**
  * @brief Loads all the mission data.
  *
@@ -873,6 +1165,7 @@ int missions_load (void)
 
    /* Sort based on priority so higher priority missions can establish claims first. */
    qsort( mission_stack, array_size(mission_stack), sizeof(MissionData), missions_cmp );
+   missions_buildIndex();
 
    DEBUG( n_("Loaded %d Mission", "Loaded %d Missions", array_size(mission_stack) ), array_size(mission_stack) );
 
@@ -970,6 +1263,7 @@ void missions_free (void)
    missions_cleanup();
 
    /* Free the mission data. */
+   missions_freeIndex();
    for (i=0; i<array_size(mission_stack); i++)
       mission_freeData( &mission_stack[i] );
    array_free( mission_stack );
@@ -1060,7 +1354,10 @@ int missions_saveActive( xmlTextWriterPtr writer )
 
          /* Write Lua magic */
          xmlw_startElem(writer,"lua");
-         nxml_persistLua( player_missions[i]->env, writer );
+         if (player_missions[i]->rest != NULL)
+            nxml_writeLuaDoc( player_missions[i]->rest, writer );
+         else
+            nxml_persistLua( player_missions[i]->env, writer );
          xmlw_endElem(writer); /* "lua" */
 
          xmlw_endElem(writer); /* "mission" */
@@ -9,6 +9,7 @@
 
 #include "claim.h"
 #include "nlua.h"
+#include "nxml.h"
 #include "opengl.h"
 
 
@@ -59,6 +60,7 @@ typedef struct MissionAvail_s {
    int* factions; /**< Array (array.h): To certain factions. */
 
    char* cond; /**< Condition that must be met (Lua). */
+   int cond_chunk; /**< Compiled cond, see cond_compile(). */
    char* done; /**< Previous mission that must have been done. */
 
    int priority; /**< Mission priority: 0 = main plot, 5 = default, 10 = insignificant. */
@@ -121,7 +123,9 @@ typedef struct Mission_ {
    /* Claims. */
    Claim_t *claims; /**< System claims. */
 
-   nlua_env env; /**< The environment of the running Lua code. */
+   nlua_env env; /**< The environment of the running Lua code, LUA_NOREF while resting. */
+   xmlDocPtr rest; /**< Persisted Lua data while resting, see mission_wake(). */
+   int busy; /**< Ran since the last look for missions that can rest. */
 } Mission;
 
 
@@ -132,11 +136,31 @@ typedef struct Mission_ {
 extern Mission *player_missions[MISSION_MAX]; /**< Player's active missions. */
 
 
+/**
+ * @brief State of a mission generation done in steps, see missions_genStart().
+ */
+typedef struct MissionGen_ {
+   int loc; /**< Location being generated. */
+   int faction; /**< Faction of the planet. */
+   char *planet; /**< Name of the planet. */
+   char *sysname; /**< Name of the system. */
+   int li; /**< Position in the candidates of the location. */
+   int pi; /**< Next candidate requiring the planet. */
+   int done; /**< All the candidates have been tried. */
+   Mission *missions; /**< Generated missions not yet taken by the caller (array.h). */
+} MissionGen;
+
+
 /*
  * creates missions for a planet and such
  */
 Mission* missions_genList( int *n, int faction,
       const char* planet, const char* sysname, int loc );
+void missions_genStart( MissionGen *gen, int faction,
+      const char* planet, const char* sysname, int loc );
+int missions_genStep( MissionGen *gen, double budget );
+void missions_genFree( MissionGen *gen );
+void missions_sort( Mission *missions, int n );
 int mission_accept( Mission* mission ); /* player accepted mission for computer/bar */
 void missions_run( int loc, int faction, const char* planet, const char* sysname );
 int mission_start( const char *name, unsigned int *id );
@@ -183,6 +207,13 @@ int misn_run( Mission *misn, const char *func );
 void missions_activateClaims (void);
 
 
+/*
+ * Resting.
+ */
+void missions_rest (void);
+int mission_wake( Mission *misn );
+
+
 #endif /* MISSION_H */
 
 
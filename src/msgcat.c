@@ -102,7 +102,20 @@ const char* msgcat_ngettext( const msgcat_t* p, const char* msgid1, const char*
 {
    const char *trans = msgcat_mo_lookup(p->map, p->map_size, msgid1);
    if (!trans) return NULL;
+   return msgcat_plural( p, trans, msgid2, n );
+}
 
+/**
+ * @brief Picks the plural form of a translation found in the given message catalog.
+ *
+ * @param p The message catalog.
+ * @param trans The translation, as found by msgcat_entry().
+ * @param msgid2 The English plural form. (Pass NULL if simply translating.)
+ * @param n The number determining the plural form to use.
+ * @return The plural form of the translation, or NULL if it doesn't exist.
+ */
+const char* msgcat_plural( const msgcat_t* p, const char* trans, const char* msgid2, uint64_t n )
+{
    /* Non-plural-processing gettext forms pass a null pointer as
     * msgid2 to request that dcngettext suppress plural processing. */
 
@@ -163,6 +176,57 @@ const char *msgcat_mo_lookup(const void *p, size_t size, const char *s)
 	return 0;
 }
 
+/**
+ * @brief Gets the number of strings in the given message catalog.
+ */
+uint32_t msgcat_nstrings( const msgcat_t* p )
+{
+   const uint32_t *mo = p->map;
+   uint32_t n;
+   int sw;
+
+   if (p->map_size < 5*4)
+      return 0;
+   sw = *mo - 0x950412de;
+   n  = swapc(mo[2], sw);
+   return (n < p->map_size/4) ? n : 0;
+}
+
+/**
+ * @brief Gets a string of the given message catalog, checking it like msgcat_mo_lookup() does.
+ *
+ * @param p The message catalog.
+ * @param i Index of the string, lower than msgcat_nstrings().
+ * @param[out] trans The translation of the string.
+ * @return The English string (singular form), or NULL if the catalog is malformed.
+ */
+const char* msgcat_entry( const msgcat_t* p, uint32_t i, const char **trans )
+{
+   const uint32_t *mo = p->map;
+   const char *map = p->map;
+   size_t size = p->map_size;
+   int sw = *mo - 0x950412de;
+   uint32_t n = swapc(mo[2], sw);
+   uint32_t o = swapc(mo[3], sw);
+   uint32_t t = swapc(mo[4], sw);
+   uint32_t ol, os, tl, ts;
+
+   if (i>=n || n>=size/4 || o>=size-4*n || t>=size-4*n || ((o|t)%4))
+      return NULL;
+   o/=4;
+   t/=4;
+   ol = swapc(mo[o+2*i], sw);
+   os = swapc(mo[o+2*i+1], sw);
+   tl = swapc(mo[t+2*i], sw);
+   ts = swapc(mo[t+2*i+1], sw);
+   if (os >= size || ol >= size-os || map[os+ol])
+      return NULL;
+   if (ts >= size || tl >= size-ts || map[ts+tl])
+      return NULL;
+   *trans = map + ts;
+   return map + os;
+}
+
 
 /* ===================== https://git.musl-libc.org/cgit/musl/tree/src/locale/pleval.c ======================== */
 /*
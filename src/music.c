@@ -65,6 +65,7 @@ static double music_timer     = 0.; /**< Music timer. */
 static int music_temp_disabled= 0; /**< Music is temporarily disabled. */
 static int music_temp_repeat  = 0; /**< Music is repeating. */
 static char *music_temp_repeatname = NULL; /**< Repeating song name. */
+static int music_combat       = 0; /**< Whether the music script was last told about combat. */
 
 
 /*
@@ -73,6 +74,7 @@ static char *music_temp_repeatname = NULL; /**< Repeating song name. */
 /* music stuff */
 static int music_find (void);
 static void music_free (void);
+static void music_filename( char *filename, size_t len, const char *name );
 /* Lua stuff */
 static int music_luaInit (void);
 static void music_luaQuit (void);
@@ -325,15 +327,15 @@ int music_load( const char* name )
    /* Free current music if needed. */
    music_free();
 
-   /* Determine the filename. */
-   if (name[0]=='/')
-      snprintf( filename, sizeof(filename), "%s", &name[1]);
-   else
-      snprintf( filename, sizeof(filename), MUSIC_PATH"%s"MUSIC_SUFFIX, name);
-
    /* Load new music. */
    music_name  = strdup(name);
    music_start = SDL_GetTicks();
+
+   /* Already opened and partially decoded by music_prebuffer(). */
+   if (music_al_loadPrebuffered( name ) == 0)
+      return 0;
+
+   music_filename( filename, sizeof(filename), name );
    rw = PHYSFSRWOPS_openRead( filename );
    if (rw == NULL) {
       WARN(_("Music '%s' not found."), filename);
@@ -345,6 +347,54 @@ int music_load( const char* name )
 }
 
 
+/**
+ * @brief Hints the music that will be loaded next.
+ *
+ * The music gets opened and the start of it decoded in the background, so
+ *  that loading it with music_load() later starts playing right away.
+ *
+ *    @param name Name of the music to prebuffer.
+ *    @return 0 on success.
+ */
+int music_prebuffer( const char* name )
+{
+   SDL_RWops *rw;
+   char filename[PATH_MAX];
+
+   if (music_disabled)
+      return 0;
+
+   music_filename( filename, sizeof(filename), name );
+   rw = PHYSFSRWOPS_openRead( filename );
+   if (rw == NULL) {
+      WARN(_("Music '%s' not found."), filename);
+      return -1;
+   }
+   if (music_al_prebuffer( name, rw )) {
+      SDL_RWclose( rw );
+      return -1;
+   }
+
+   return 0;
+}
+
+
+/**
+ * @brief Gets the file of a music.
+ *
+ *    @param[out] filename Where to write the path of the file.
+ *    @param len Size of filename.
+ *    @param name Name of the music.
+ */
+static void music_filename( char *filename, size_t len, const char *name )
+{
+   if (name[0]=='/')
+      snprintf( filename, len, "%s", &name[1]);
+   else
+      snprintf( filename, len, MUSIC_PATH"%s"MUSIC_SUFFIX, name);
+}
+
+
 /**
  * @brief Plays the loaded music.
  */
@@ -568,12 +618,34 @@ int music_choose( const char* situation )
    music_timer = 0.;
    music_temp_repeat = 0;
    music_temp_disabled = 0;
+
+   /* Running out of music doesn't change what is going on. */
+   if ((situation == NULL) || (strcmp(situation, "idle") != 0))
+      music_combat = ((situation != NULL) && (strcmp(situation, "combat") == 0));
    music_runLua( situation );
 
    return 0;
 }
 
 
+/**
+ * @brief Tells the music script when combat starts or ends.
+ *
+ * Called once a frame with the engine's view of hostiles, the script only
+ *  runs when it changes instead of every time a pilot becomes hostile.
+ *
+ *    @param combat Whether or not the player has active hostiles.
+ */
+void music_setCombat( int combat )
+{
+   combat = !!combat;
+   if (combat == music_combat)
+      return;
+
+   music_choose( combat ? "combat" : "ambient" );
+}
+
+
 
 /**
  * @brief Actually runs the music stuff, based on situation after a delay.
@@ -40,6 +40,7 @@ int music_volume( const double vol );
 double music_getVolume (void);
 double music_getVolumeLog(void);
 int music_load( const char* name );
+int music_prebuffer( const char* name );
 void music_play (void);
 void music_stop (void);
 void music_pause (void);
@@ -58,6 +59,7 @@ int music_luaString( const char *str );
 int music_choose( const char* situation );
 int music_chooseDelay( const char* situation, double delay );
 void music_rechoose (void);
+void music_setCombat( int combat );
 void music_tempDisable( int disable );
 void music_repeat( int repeat );
 
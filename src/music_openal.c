@@ -63,6 +63,7 @@ static SDL_Thread *music_player = NULL; /**< Music player thread. */
  * Playing buffers.
  */
 static int music_bufSize            = 32*1024; /**< Size of music playing buffer. */
+static int music_bufCount           = 2; /**< Amount of queued OpenAL buffers. */
 static char *music_buf              = NULL; /**< Music playing buffer. */
 
 
@@ -95,7 +96,7 @@ typedef struct MusicData_s {
    music_state_t state;
    int active; /* active buffer */
    ALint alstate;
-   ALuint removed[2];
+   ALuint removed[BUFFER_COUNT_MAX];
    ALenum value;
    ALfloat gain;
    int fadein_start;
@@ -107,8 +108,21 @@ typedef struct MusicData_s {
  * song currently playing
  */
 static alMusic music_vorbis; /**< Current music. */
-static ALuint music_buffer[2]; /**< Front and back buffer. */
+static ALuint *music_buffer = NULL; /**< Ring of queued buffers. */
 static ALuint music_source = 0; /**< Source associated to music. */
+static int music_preloaded  = 0; /**< Buffers of the current music already decoded. */
+static int music_preeof     = 0; /**< Whether the decoded buffers reach the end. */
+
+
+/*
+ * Song hinted to play next, its start gets decoded ahead of time by the
+ *  music thread. Protected by the vorbis lock.
+ */
+static alMusic music_next; /**< Next music. */
+static char *music_next_name = NULL; /**< Name of the next music. */
+static ALuint *music_next_buffer = NULL; /**< Buffers of the next music. */
+static int music_next_loaded = 0; /**< Buffers of the next music decoded. */
+static int music_next_eof    = 0; /**< Whether the next music is fully decoded. */
 
 
 /*
@@ -124,7 +138,10 @@ static ALfloat music_vol_lin = 1.; /**< Current volume level (linear). */
 static void rg_filter( float **pcm, long channels, long samples, void *filter_param );
 static void music_kill (void);
 static int music_thread( void* unused );
-static int stream_loadBuffer( ALuint buffer );
+static int stream_open( alMusic *mus, const char *name, SDL_RWops *rw );
+static void stream_close( alMusic *mus );
+static int stream_loadBuffer( alMusic *mus, ALuint buffer );
+static void stream_prebuffer (void);
 
 
 /*
@@ -160,48 +177,48 @@ static int mal_stop( MusicData *m )
 }
 static int mal_load( MusicData *m )
 {
-   int ret;
+   int i, ret;
 
-   /* Load buffer and start playing. */
-   m->active = 0; /* load first buffer */
-   ret = stream_loadBuffer( music_buffer[m->active] );
-   soundLock();
-   alSourceQueueBuffers( music_source, 1, &music_buffer[m->active] );
+   /* Queue all the buffers, the prebuffered ones are already decoded. */
+   ret = 0;
+   for (i=0; i<music_bufCount; i++) {
+      if (i < music_preloaded)
+         ret = (music_preeof && (i == music_preloaded-1)) ? 1 : 0;
+      else
+         ret = stream_loadBuffer( &music_vorbis, music_buffer[i] );
+
+      /* Special case NULL file or error. */
+      if (ret < 0)
+         break;
 
-   /* Special case NULL file or error. */
-   if (ret < 0) {
-      soundUnlock();
-      return -1;
-   }
-   /* Force volume level. */
-   alSourcef( music_source, AL_GAIN, (m->fadein_start) ? 0. : music_vol );
+      soundLock();
+      alSourceQueueBuffers( music_source, 1, &music_buffer[i] );
 
-   /* Start playing. */
-   alSourcePlay( music_source );
+      /* Start playing as soon as there is something to play. */
+      if (i == 0) {
+         /* Force volume level. */
+         alSourcef( music_source, AL_GAIN, (m->fadein_start) ? 0. : music_vol );
+         alSourcePlay( music_source );
+      }
 
-   /* Check for errors. */
-   al_checkErr();
+      /* Check for errors. */
+      al_checkErr();
+      soundUnlock();
 
-   soundUnlock();
-   /* Special case of a very short song. */
-   if (ret > 1) {
-      m->active = -1;
-      return 0;
+      /* Special case of a very short song. */
+      if (ret > 0)
+         break;
    }
+   music_preloaded = 0;
+   music_preeof    = 0;
 
-   /* Load second buffer. */
-   m->active = 1;
-   ret = stream_loadBuffer( music_buffer[m->active] );
-   if (ret < 0)
+   if (i == 0) {
       m->active = -1;
-   else {
-      soundLock();
-      alSourceQueueBuffers( music_source, 1, &music_buffer[m->active] );
-      /* Check for errors. */
-      al_checkErr();
-      soundUnlock();
-      m->active = 1 - m->active;
+      return -1;
    }
+
+   /* The first buffer queued is the first to refill. */
+   m->active = (ret != 0) ? -1 : 0;
    return 0;
 }
 static int mal_play( MusicData *m )
@@ -398,18 +415,18 @@ static int music_thread( void* unused )
             al_checkErr();
             soundLock();
 
-            /* See if needs another buffer set. */
+            /* Refill all the played buffers, in the order they were queued. */
             alGetSourcei( music_source, AL_BUFFERS_PROCESSED, &m.alstate );
-            if (m.alstate > 0) {
-               /* refill active buffer */
+            while ((m.alstate > 0) && (m.active >= 0)) {
                alSourceUnqueueBuffers( music_source, 1, m.removed );
-               ret = stream_loadBuffer( music_buffer[m.active] );
+               ret = stream_loadBuffer( &music_vorbis, music_buffer[m.active] );
                if (ret < 0)
                   m.active = -1;
                else {
                   alSourceQueueBuffers( music_source, 1, &music_buffer[m.active] );
-                  m.active = 1 - m.active;
+                  m.active = (m.active + 1) % music_bufCount;
                }
+               m.alstate--;
             }
 
             /* Check for errors. */
@@ -418,6 +435,9 @@ static int music_thread( void* unused )
             soundUnlock();
       }
 
+      /* Use the spare time to decode the start of the next song. */
+      stream_prebuffer();
+
       /* Global thread delay. */
       SDL_Delay(0);
 
@@ -467,19 +487,89 @@ static void rg_filter( float **pcm, long channels, long samples, void *filter_pa
 }
 
 
+/**
+ * @brief Opens a music stream.
+ *
+ *    @param mus Stream to open.
+ *    @param name Name of the music.
+ *    @param rw Data of the music, owned by the stream on success.
+ *    @return 0 on success.
+ */
+static int stream_open( alMusic *mus, const char *name, SDL_RWops *rw )
+{
+   int rg;
+   ALfloat track_gain_db, track_peak;
+   vorbis_comment *vc;
+   char *tag = NULL;
+
+   /* Load new ogg. */
+   mus->rw = rw;
+   if (ov_open_callbacks( mus->rw, &mus->stream,
+            NULL, 0, sound_al_ovcall ) < 0) {
+      WARN(_("Song '%s' does not appear to be a Vorbis bitstream."), name);
+      mus->rw = NULL;
+      return -1;
+   }
+   mus->info = ov_info( &mus->stream, -1 );
+
+   /* Get Replaygain information. */
+   vc             = ov_comment( &mus->stream, -1 );
+   track_gain_db  = 0.;
+   track_peak     = 1.;
+   rg             = 0;
+   if ((tag = vorbis_comment_query(vc, "replaygain_track_gain", 0))) {
+      track_gain_db  = atof(tag);
+      rg             = 1;
+   }
+   if ((tag = vorbis_comment_query(vc, "replaygain_track_peak", 0))) {
+      track_peak     = atof(tag);
+      rg             = 1;
+   }
+   mus->rg_scale_factor = pow(10.0, (track_gain_db + RG_PREAMP_DB)/20);
+   mus->rg_max_scale = 1.0 / track_peak;
+   if (!rg)
+      DEBUG(_("Song '%s' has no replaygain information."), name );
+
+   /* Set the format */
+   if (mus->info->channels == 1)
+      mus->format = AL_FORMAT_MONO16;
+   else
+      mus->format = AL_FORMAT_STEREO16;
+
+   return 0;
+}
+
+
+/**
+ * @brief Closes a music stream if open.
+ *
+ *    @param mus Stream to close.
+ */
+static void stream_close( alMusic *mus )
+{
+   if (mus->rw != NULL) {
+      ov_clear( &mus->stream );
+      mus->rw = NULL; /* somewhat officially ended */
+   }
+}
+
+
 /**
  * @brief Loads a buffer.
  *
+ *    @param mus Stream to decode from.
  *    @param buffer Buffer to load.
  */
-static int stream_loadBuffer( ALuint buffer )
+static int stream_loadBuffer( alMusic *mus, ALuint buffer )
 {
    int ret, size, section, result;
+   ALenum format;
+   ALsizei rate;
 
    musicVorbisLock();
 
    /* Make sure music is valid. */
-   if (music_vorbis.rw == NULL) {
+   if (mus->rw == NULL) {
       musicVorbisUnlock();
       return -1;
    }
@@ -489,7 +579,7 @@ static int stream_loadBuffer( ALuint buffer )
    while (size < music_bufSize) { /* file up the entire data buffer */
 
       result = ov_read_filter(
-            &music_vorbis.stream,   /* stream */
+            &mus->stream,           /* stream */
             &music_buf[size],       /* data */
             music_bufSize - size,   /* amount to read */
             (SDL_BYTEORDER == SDL_BIG_ENDIAN),
@@ -497,7 +587,7 @@ static int stream_loadBuffer( ALuint buffer )
             1,                      /* signed */
             &section,               /* current bitstream */
             rg_filter,              /* filter function */
-            &music_vorbis );        /* filter parameter */
+            mus );                  /* filter parameter */
 
       /* End of file. */
       if (result == 0) {
@@ -524,12 +614,13 @@ static int stream_loadBuffer( ALuint buffer )
       size += result;
    }
 
+   format = mus->format;
+   rate   = mus->info->rate;
    musicVorbisUnlock();
 
-   /* load the buffer up */
+   /* load the buffer up, music_buf is only used by the music thread */
    soundLock();
-   alBufferData( buffer, music_vorbis.format,
-         music_buf, size, music_vorbis.info->rate );
+   alBufferData( buffer, format, music_buf, size, rate );
    al_checkErr();
    soundUnlock();
 
@@ -537,6 +628,29 @@ static int stream_loadBuffer( ALuint buffer )
 }
 
 
+/**
+ * @brief Decodes one more buffer of the next music if needed.
+ */
+static void stream_prebuffer (void)
+{
+   int ret;
+
+   musicVorbisLock();
+   if ((music_next.rw == NULL) || music_next_eof ||
+         (music_next_loaded >= music_bufCount)) {
+      musicVorbisUnlock();
+      return;
+   }
+
+   ret = stream_loadBuffer( &music_next, music_next_buffer[music_next_loaded] );
+   if (ret >= 0)
+      music_next_loaded++;
+   if (ret != 0)
+      music_next_eof = 1;
+   musicVorbisUnlock();
+}
+
+
 /**
  * @brief Initializes the OpenAL music subsystem.
  */
@@ -549,10 +663,14 @@ int music_al_init (void)
    music_state_lock  = SDL_CreateMutex();
    music_vorbis_lock = SDL_CreateMutex();
    music_vorbis.rw   = NULL; /* indication it's not loaded */
+   music_next.rw     = NULL;
 
    /* Create the buffer. */
    music_bufSize     = conf.al_bufsize * 1024;
+   music_bufCount    = CLAMP( BUFFER_COUNT_MIN, BUFFER_COUNT_MAX, conf.al_bufcount );
    music_buf         = malloc( music_bufSize );
+   music_buffer      = calloc( music_bufCount, sizeof(ALuint) );
+   music_next_buffer = calloc( music_bufCount, sizeof(ALuint) );
 
    soundLock();
 
@@ -560,7 +678,8 @@ int music_al_init (void)
    alGenSources( 1, &music_source );
 
    /* Generate buffers and sources. */
-   alGenBuffers( 2, music_buffer );
+   alGenBuffers( music_bufCount, music_buffer );
+   alGenBuffers( music_bufCount, music_next_buffer );
 
    /* Set up OpenAL properties. */
    alSourcef(  music_source, AL_GAIN, music_vol );
@@ -601,7 +720,8 @@ void music_al_exit (void)
    soundLock();
 
    /* Free the music. */
-   alDeleteBuffers( 2, music_buffer );
+   alDeleteBuffers( music_bufCount, music_buffer );
+   alDeleteBuffers( music_bufCount, music_next_buffer );
    alDeleteSources( 1, &music_source );
 
    /* Check for errors. */
@@ -609,8 +729,15 @@ void music_al_exit (void)
 
    soundUnlock();
 
+   stream_close( &music_next );
+   free(music_next_name);
+   music_next_name = NULL;
    free(music_buf);
    music_buf = NULL;
+   free(music_buffer);
+   music_buffer = NULL;
+   free(music_next_buffer);
+   music_next_buffer = NULL;
 
    /* Destroy the mutex. */
    SDL_DestroyMutex( music_vorbis_lock );
@@ -624,46 +751,47 @@ void music_al_exit (void)
  */
 int music_al_load( const char* name, SDL_RWops *rw )
 {
-   int rg;
-   ALfloat track_gain_db, track_peak;
-   vorbis_comment *vc;
-   char *tag = NULL;
+   int ret;
 
    musicVorbisLock();
+   ret = stream_open( &music_vorbis, name, rw );
+   musicVorbisUnlock();
 
-   /* Load new ogg. */
-   music_vorbis.rw = rw;
-   if (ov_open_callbacks( music_vorbis.rw, &music_vorbis.stream,
-            NULL, 0, sound_al_ovcall ) < 0) {
-      WARN(_("Song '%s' does not appear to be a Vorbis bitstream."), name);
-      musicUnlock();
-      return -1;
-   }
-   music_vorbis.info = ov_info( &music_vorbis.stream, -1 );
+   return ret;
+}
 
-   /* Get Replaygain information. */
-   vc             = ov_comment( &music_vorbis.stream, -1 );
-   track_gain_db  = 0.;
-   track_peak     = 1.;
-   rg             = 0;
-   if ((tag = vorbis_comment_query(vc, "replaygain_track_gain", 0))) {
-      track_gain_db  = atof(tag);
-      rg             = 1;
-   }
-   if ((tag = vorbis_comment_query(vc, "replaygain_track_peak", 0))) {
-      track_peak     = atof(tag);
-      rg             = 1;
+
+/**
+ * @brief Loads the music that was prebuffered if it matches.
+ *
+ * Must be called with the previous music freed.
+ *
+ *    @param name Name of the music to load.
+ *    @return 0 if the prebuffered music was loaded.
+ */
+int music_al_loadPrebuffered( const char* name )
+{
+   ALuint *buffers;
+
+   musicVorbisLock();
+
+   if ((music_next.rw == NULL) || (strcmp( music_next_name, name ) != 0)) {
+      musicVorbisUnlock();
+      return -1;
    }
-   music_vorbis.rg_scale_factor = pow(10.0, (track_gain_db + RG_PREAMP_DB)/20);
-   music_vorbis.rg_max_scale = 1.0 / track_peak;
-   if (!rg)
-      DEBUG(_("Song '%s' has no replaygain information."), name );
 
-   /* Set the format */
-   if (music_vorbis.info->channels == 1)
-      music_vorbis.format = AL_FORMAT_MONO16;
-   else
-      music_vorbis.format = AL_FORMAT_STEREO16;
+   /* Swap the streams along with the decoded buffers. */
+   music_vorbis      = music_next;
+   music_next.rw     = NULL;
+   buffers           = music_buffer;
+   music_buffer      = music_next_buffer;
+   music_next_buffer = buffers;
+   music_preloaded   = music_next_loaded;
+   music_preeof      = music_next_eof;
+   music_next_loaded = 0;
+   music_next_eof    = 0;
+   free( music_next_name );
+   music_next_name   = NULL;
 
    musicVorbisUnlock();
 
@@ -671,6 +799,36 @@ int music_al_load( const char* name, SDL_RWops *rw )
 }
 
 
+/**
+ * @brief Hints the music to play next so its start gets decoded ahead of time.
+ *
+ *    @param name Name of the music.
+ *    @param rw Data of the music, owned by the music on success.
+ *    @return 0 on success.
+ */
+int music_al_prebuffer( const char* name, SDL_RWops *rw )
+{
+   int ret;
+
+   musicVorbisLock();
+
+   /* Only one song can be hinted at a time. */
+   stream_close( &music_next );
+   free( music_next_name );
+   music_next_name   = NULL;
+   music_next_loaded = 0;
+   music_next_eof    = 0;
+
+   ret = stream_open( &music_next, name, rw );
+   if (ret == 0)
+      music_next_name = strdup( name );
+
+   musicVorbisUnlock();
+
+   return ret;
+}
+
+
 /**
  * @brief Frees the music.
  */
@@ -689,12 +847,9 @@ void music_al_free (void)
    musicUnlock();
 
    musicVorbisLock();
-
-   if (music_vorbis.rw != NULL) {
-      ov_clear( &music_vorbis.stream );
-      music_vorbis.rw = NULL; /* somewhat officially ended */
-   }
-
+   stream_close( &music_vorbis );
+   music_preloaded = 0;
+   music_preeof    = 0;
    musicVorbisUnlock();
 }
 
@@ -24,6 +24,8 @@ void music_al_exit (void);
  * Loading.
  */
 int music_al_load( const char* name, SDL_RWops *rw );
+int music_al_loadPrebuffered( const char* name );
+int music_al_prebuffer( const char* name, SDL_RWops *rw );
 void music_al_free (void);
 
 
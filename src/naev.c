@@ -28,7 +28,9 @@
 /** @endcond */
 
 #include "ai.h"
+#include "array.h"
 #include "background.h"
+#include "bench.h"
 #include "camera.h"
 #include "cond.h"
 #include "conf.h"
@@ -44,6 +46,7 @@
 #include "fleet.h"
 #include "font.h"
 #include "gui.h"
+#include "hitch.h"
 #include "hook.h"
 #include "input.h"
 #include "joystick.h"
@@ -53,6 +56,7 @@
 #include "map.h"
 #include "map_overlay.h"
 #include "map_system.h"
+#include "memtrack.h"
 #include "menu.h"
 #include "mission.h"
 #include "music.h"
@@ -60,6 +64,7 @@
 #include "nebula.h"
 #include "news.h"
 #include "nfile.h"
+#include "nlua.h"
 #include "nlua_misn.h"
 #include "nlua_var.h"
 #include "npc.h"
@@ -72,8 +77,12 @@
 #include "physics.h"
 #include "pilot.h"
 #include "player.h"
+#include "profile.h"
 #include "render.h"
+#include "replay.h"
 #include "rng.h"
+#include "save.h"
+#include "scratch.h"
 #include "semver.h"
 #include "ship.h"
 #include "slots.h"
@@ -116,6 +125,15 @@ static double fps_cur = 0.; /**< FPS accumulator to trigger change. */
 static double fps_x     =  15.; /**< FPS X position. */
 static double fps_y     = -15.; /**< FPS Y position. */
 const double fps_min    = 1./30.; /**< Minimum fps to run at. */
+static const double fps_min_autonav = 1./15.; /**< Minimum fps when autonav compresses time, fast bolts are swept so they don't need the small steps. */
+static const double fps_min_coarse = 1./10.; /**< Minimum fps when autonav compresses time with nothing to react to. */
+static Uint64 fps_deadline = 0; /**< Performance counter value the next frame should start at. */
+#define FPS_SPIN        0.002 /**< Time spun before a deadline instead of sleeping (s), more than the sleep granularity. */
+#define SIM_ACCUM_MAX   0.25 /**< Most real time that can be waiting to be simulated, the game slows down past it. */
+static double sim_accum = 0.; /**< Real time not simulated yet with fixed steps. */
+static double sim_ahead = 0.; /**< Game time the frame is drawn ahead of the simulation. */
+static double sim_rdt   = 0.; /**< Real time covered by the update being run. */
+static int render_pending = 0; /**< Last rendered frame was submitted but not presented yet. */
 
 /*
  * prototypes
@@ -131,7 +149,10 @@ static void window_caption (void);
 static void fps_init (void);
 static double fps_elapsed (void);
 static void fps_control (void);
+static double fps_cap (void);
+static void fps_sleep( double delay );
 static void update_all (void);
+static void update_step( double gdt, double rdt );
 /* Misc. */
 static void loadscreen_render( double done, const char *msg );
 void main_loop( int update ); /* dialogue.c */
@@ -165,6 +186,13 @@ int naev_isQuit (void)
 int main( int argc, char** argv )
 {
    char conf_file_path[PATH_MAX], **search_path, **p;
+   const NluaGCStats *gcstats;
+   const NluaAllocStats *allocstats;
+#if DEBUG_ARRAYS
+   ArrayStats astats;
+#endif /* DEBUG_ARRAYS */
+   int bench_failed;
+   Uint64 frame_start;
 
    env_detect( argc, argv );
 
@@ -284,6 +312,9 @@ int main( int argc, char** argv )
       exit(EXIT_FAILURE);
    }
    window_caption();
+#ifdef PROFILING
+   profile_init();
+#endif /* PROFILING */
 
    /* Have to set up fonts before rendering anything. */
    //DEBUG("Using '%s' as main font and '%s' as monospace font.", _(FONT_DEFAULT_PATH), _(FONT_MONOSPACE_PATH));
@@ -361,14 +392,26 @@ int main( int argc, char** argv )
    /* Unload load screen. */
    loadscreen_unload();
 
-   /* Start menu. */
-   menu_main();
+   /* Run the benchmark instead of the game. */
+   bench_failed = 0;
+   if (conf.bench != NULL) {
+      bench_failed = bench_run( conf.bench );
+      quit = 1;
+   }
+   else if (conf.bench_kernel != NULL) {
+      bench_failed = bench_kernel( conf.bench_kernel );
+      quit = 1;
+   }
+   else {
+      /* Start menu. */
+      menu_main();
 
-   LOG( _( "Reached main menu" ) );
+      LOG( _( "Reached main menu" ) );
 
-   /* Force a minimum delay with loading screen */
-   if ((SDL_GetTicks() - time_ms) < NAEV_INIT_DELAY)
-      SDL_Delay( NAEV_INIT_DELAY - (SDL_GetTicks() - time_ms) );
+      /* Force a minimum delay with loading screen */
+      if ((SDL_GetTicks() - time_ms) < NAEV_INIT_DELAY)
+         SDL_Delay( NAEV_INIT_DELAY - (SDL_GetTicks() - time_ms) );
+   }
    fps_init(); /* initializes the time_ms */
 
 
@@ -381,7 +424,7 @@ int main( int argc, char** argv )
    while (SDL_PollEvent(&event));
 
    /* Incomplete game note (shows every time version number changes). */
-   if ( conf.lastversion == NULL || naev_versionCompare(conf.lastversion) != 0 ) {
+   if ( !quit && (conf.replay == NULL) && (conf.lastversion == NULL || naev_versionCompare(conf.lastversion) != 0) ) {
       free( conf.lastversion );
       conf.lastversion = strdup( naev_version(0) );
       dialogue_msg(
@@ -403,6 +446,10 @@ int main( int argc, char** argv )
             " And again, thank you for playing!"), conf.lastversion );
    }
 
+   /* Record or play back the session from here on. */
+   if (!quit)
+      replay_init();
+
    /* primary loop */
    while (!quit) {
       while (!quit && SDL_PollEvent(&event)) { /* event loop */
@@ -420,12 +467,25 @@ int main( int argc, char** argv )
          input_handle(&event); /* handles all the events and player keybinds */
       }
 
+      frame_start = SDL_GetPerformanceCounter();
       main_loop( 1 );
+      hitch_frame( 1000. * (double)(SDL_GetPerformanceCounter() - frame_start) /
+            (double)SDL_GetPerformanceFrequency() );
    }
 
+   /* Finish the replay being recorded. */
+   replay_exit();
+
    /* Save configuration. */
    conf_saveConfig(conf_file_path);
 
+   /* Make sure the last save made it to disk. */
+   save_sync();
+
+#ifdef DEBUGGING
+   memtrack_report();
+#endif /* DEBUGGING */
+
    /* data unloading */
    unload_all();
 
@@ -446,11 +506,28 @@ int main( int argc, char** argv )
    joystick_exit(); /* Releases joystick */
    input_exit(); /* Cleans up keybindings */
    nebu_exit(); /* Destroys the nebula */
+   gcstats = nlua_gcStats();
+   DEBUG( _("Lua GC: freed %.0f KiB in %u cycles, %.1f ms total, %.2f ms longest frame."),
+         gcstats->collected / 1024., gcstats->cycles,
+         gcstats->time * 1000., gcstats->pause_max * 1000. );
+   allocstats = nlua_allocStats();
+   DEBUG( _("Lua allocator: %u pooled blocks, %u reused, %u large, %.0f KiB of slabs."),
+         allocstats->pooled, allocstats->reused, allocstats->large,
+         allocstats->slab_bytes / 1024. );
    lua_exit(); /* Closes Lua state. */
+#if DEBUG_ARRAYS
+   astats = array_stats();
+   DEBUG( _("Arrays: %d created, %d freed, %d reallocations."),
+         astats.created, astats.freed, astats.reallocs );
+#endif /* DEBUG_ARRAYS */
+#ifdef PROFILING
+   profile_exit(); /* Writes out the profiling. */
+#endif /* PROFILING */
    render_exit(); /* Cleans up post-processing. */
    gl_exit(); /* Kills video output */
    sound_exit(); /* Kills the sound */
    news_exit(); /* Destroys the news. */
+   scratch_exit(); /* Frees the frame memory. */
 
    /* Has to be run last or it will mess up sound settings. */
    conf_cleanup(); /* Free some memory the configuration allocated. */
@@ -474,7 +551,7 @@ int main( int argc, char** argv )
    PHYSFS_deinit();
 
    /* all is well */
-   exit(EXIT_SUCCESS);
+   exit(bench_failed ? EXIT_FAILURE : EXIT_SUCCESS);
 }
 
 
@@ -556,6 +633,9 @@ void loadscreen_render( double done, const char *msg )
    double rh;  /**<  Loading Progress Text Relative Height */
    SDL_Event event;
 
+   /* Don't draw over a frame that wasn't shown yet. */
+   naev_present();
+
    /* Clear background. */
    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
@@ -630,6 +710,8 @@ static void loadscreen_unload (void)
 #define LOADING_STAGES     13. /**< Amount of loading stages. */
 void load_all (void)
 {
+   unsigned int hits, misses;
+
    /* We can do fast stuff here. */
    sp_load();
 
@@ -669,6 +751,9 @@ void load_all (void)
    weapon_init();
    player_init(); /* Initialize player stuff. */
    loadscreen_render( 1., _("Loading Completed!") );
+
+   gl_texCacheStats( &hits, &misses );
+   DEBUG( _("Loaded %u textures, %u loads served from the texture cache."), misses, hits );
 }
 /**
  * @brief Unloads all data, simplifies main().
@@ -712,6 +797,10 @@ void main_loop( int update )
     * Control FPS.
     */
    fps_control(); /* everyone loves fps control */
+#ifdef PROFILING
+   profile_frame();
+#endif /* PROFILING */
+   scratch_reset(); /* Last frame's temporary memory is no longer in use. */
 
    /*
     * Handle update.
@@ -720,6 +809,9 @@ void main_loop( int update )
    sound_update( real_dt ); /* Update sounds. */
    if (toolkit_isOpen())
       toolkit_update(); /* to simulate key repetition */
+   if (landed)
+      land_update(); /* Missions still being generated. */
+   hooks_rest( real_dt ); /* Free the Lua of idle missions and events. */
    if (!paused && update) {
       /* Important that we pass real_dt here otherwise we get a dt feedback loop which isn't pretty. */
       player_updateAutonav( real_dt );
@@ -727,7 +819,9 @@ void main_loop( int update )
    }
 
    /* Safe hook should be run every frame regardless of whether game is paused or not. */
+   PROFILE_BEGIN( PROFILE_HOOKS );
    hooks_run( "safe" );
+   PROFILE_END( PROFILE_HOOKS );
 
    /* Checks to see if we want to land. */
    space_checkLand();
@@ -735,9 +829,44 @@ void main_loop( int update )
    /*
     * Handle render.
     */
-   /* Clear buffer. */
+   /* Show the previous frame, its commands have been processed by the GPU
+    * while we were updating. */
+   naev_present();
+
+   /* Save screenshots read back last frame. */
+   gl_screenshotUpdate( 0 );
+
+   /* Clear buffer. Things move ahead to where they are at this frame, as
+    * the simulation may be behind when it runs at a fixed rate. */
+   pilots_renderAhead( sim_ahead );
+   weapons_renderAhead( sim_ahead );
+   cam_setAhead( sim_ahead );
    render_all( game_dt, real_dt );
-   /* Draw buffer. */
+   cam_setAhead( 0. );
+   weapons_renderAheadEnd();
+   pilots_renderAheadEnd();
+   gl_texUpdateResidency();
+   /* Submit the frame now, but only present it once the next update is
+    * done so that the update overlaps with the GPU drawing this frame. */
+   glFlush();
+   render_pending = 1;
+
+   /* Recorded input is handled between frames like live input. */
+   replay_events();
+}
+
+
+/**
+ * @brief Presents the last frame rendered by main_loop() if it hasn't been yet.
+ *
+ * Anything drawing to the screen outside of main_loop() must call this
+ * first, or the pending frame would be drawn over.
+ */
+void naev_present (void)
+{
+   if (!render_pending)
+      return;
+   render_pending = 0;
    SDL_GL_SwapWindow( gl_screen.window );
 }
 
@@ -844,35 +973,108 @@ static double fps_elapsed (void)
 
 
 /**
- * @brief Controls the FPS.
+ * @brief Gets the frame rate to limit to.
+ *
+ *    @return Maximum frames per second, 0 for no limit.
  */
-static void fps_control (void)
+static double fps_cap (void)
+{
+   double cap;
+
+   /* Replays run as fast as possible. */
+   if (replay_isPlaying())
+      return 0.;
+
+   /* Vsync already paces the frames. */
+   cap = (conf.vsync || (conf.fps_max <= 0)) ? 0. : (double)conf.fps_max;
+
+   /* Save power when nobody is looking or in menus. */
+   if ((conf.fps_background > 0) && ((menu_open != 0) ||
+         !(SDL_GetWindowFlags( gl_screen.window ) & SDL_WINDOW_INPUT_FOCUS)))
+      cap = (cap > 0.) ? MIN( cap, conf.fps_background ) : conf.fps_background;
+
+   return cap;
+}
+
+
+/**
+ * @brief Sleeps for a while.
+ *
+ *    @param delay Time to sleep (s).
+ */
+static void fps_sleep( double delay )
 {
-   double delay;
-   double fps_max;
 #if HAS_POSIX
    struct timespec ts;
+   ts.tv_sec  = floor( delay );
+   ts.tv_nsec = fmod( delay, 1. ) * 1e9;
+   nanosleep( &ts, NULL );
+#else /* HAS_POSIX */
+   SDL_Delay( (unsigned int)(delay * 1000) );
 #endif /* HAS_POSIX */
+}
+
+
+/**
+ * @brief Controls the FPS.
+ *
+ * Frames are paced to deadlines rather than by the length of the last frame,
+ *  so sleeping too long doesn't carry over. With precise pacing, sleeping
+ *  stops a bit before the deadline and the rest is spun, as sleeping can
+ *  overshoot by a millisecond or more.
+ */
+static void fps_control (void)
+{
+   double delay, period, freq, cap;
+   Uint64 now;
+   int capped;
 
    /* dt in s */
    real_dt  = fps_elapsed();
+   replay_frame( &real_dt ); /* Recorded length when playing back. */
    game_dt  = real_dt * dt_mod; /* Apply the modifier. */
 
-   /* if fps is limited */
-   if (!conf.vsync && conf.fps_max != 0) {
-      fps_max = 1./(double)conf.fps_max;
-      if (real_dt < fps_max) {
-         delay    = fps_max - real_dt;
-#if HAS_POSIX
-         ts.tv_sec  = floor( delay );
-         ts.tv_nsec = fmod( delay, 1. ) * 1e9;
-         nanosleep( &ts, NULL );
-#else /* HAS_POSIX */
-         SDL_Delay( (unsigned int)(delay * 1000) );
-#endif /* HAS_POSIX */
+   capped = 0;
+   cap    = fps_cap();
+   if (cap > 0.) {
+      freq   = (double)SDL_GetPerformanceFrequency();
+      period = freq / cap;
+      now    = SDL_GetPerformanceCounter();
+
+      /* Start over if too far behind, missed frames aren't made up for. */
+      if ((fps_deadline == 0) || ((double)now > (double)fps_deadline + period))
+         fps_deadline = now;
+      fps_deadline += (Uint64)period;
+
+      delay = (double)(fps_deadline - now) / freq;
+      if (delay > 0.) {
+         capped   = 1;
          fps_dt  += delay; /* makes sure it displays the proper fps */
+         /* Collect Lua garbage instead of sleeping. */
+         PROFILE_BEGIN( PROFILE_GC );
+         nlua_gcStep( delay );
+         PROFILE_END( PROFILE_GC );
+
+         /* Sleep until close to the deadline, then spin if precise. */
+         delay = (double)(fps_deadline - MIN( fps_deadline, SDL_GetPerformanceCounter() )) / freq;
+         if (conf.fps_precise)
+            delay -= FPS_SPIN;
+         if (delay > 0.)
+            fps_sleep( delay );
+         if (conf.fps_precise)
+            while (SDL_GetPerformanceCounter() < fps_deadline)
+               ;
       }
    }
+   else
+      fps_deadline = 0;
+
+   /* No idea how much time there is to spare, just do a bit. */
+   if (!capped) {
+      PROFILE_BEGIN( PROFILE_GC );
+      nlua_gcStep( 0. );
+      PROFILE_END( PROFILE_GC );
+   }
 }
 
 
@@ -908,6 +1110,9 @@ void display_fps( const double dt )
    if (conf.fps_show) {
       gl_print( NULL, x, y, NULL, "%3.2f", fps );
       y -= gl_defFont.h + 5.;
+#ifdef PROFILING
+      y = profile_render( x, y ) - 5.;
+#endif /* PROFILING */
    }
 
    if ((player.p != NULL) && !player_isFlag(PLAYER_DESTROYED) &&
@@ -934,17 +1139,67 @@ void display_fps( const double dt )
 static void update_all (void)
 {
    int i, n;
-   double nf, microdt, accumdt;
+   double fdt;
 
    if ((real_dt > 0.25) && (fps_skipped==0)) { /* slow timers down and rerun calculations */
       fps_skipped = 1;
       return;
    }
-   else if (game_dt > fps_min) { /* we'll force a minimum FPS for physics to work alright. */
+   fps_skipped = 0;
+
+   /* Simulation tied to the frame rate. */
+   if (conf.sim_rate <= 0.) {
+      sim_accum = 0.;
+      sim_ahead = 0.;
+      update_step( game_dt, real_dt );
+      return;
+   }
+
+   /* Simulate in fixed steps of real time, so the cost per game second
+    * doesn't depend on the frame rate. Time compression makes the steps
+    * longer in game time, which update_step() chops up as needed. */
+   fdt         = 1. / conf.sim_rate;
+   sim_accum   = MIN( sim_accum + real_dt, SIM_ACCUM_MAX );
+   n           = (int) floor( sim_accum / fdt );
+   for (i=0; i<n; i++)
+      update_step( fdt * dt_mod, fdt );
+   sim_accum  -= n * fdt;
+
+   /* What is left over is drawn ahead. */
+   sim_ahead   = sim_accum * dt_mod;
+}
+
+
+/**
+ * @brief Runs the updates for a step of the game.
+ *
+ * Large steps are split into smaller ones so physics work alright.
+ *
+ *    @param gdt Game time of the step.
+ *    @param rdt Real time of the step.
+ */
+static void update_step( double gdt, double rdt )
+{
+   int i, n, coarse;
+   double nf, microdt, accumdt, step;
+
+   sim_rdt = rdt;
+
+   /* Autonav time compression can take longer steps. */
+   step   = fps_min;
+   coarse = 0;
+   if ((player.p != NULL) && player_isFlag(PLAYER_AUTONAV) && (dt_mod > player_dt_default())) {
+      step   = fps_min_autonav;
+      coarse = player_autonavCoarse();
+      if (coarse)
+         step = fps_min_coarse;
+   }
+
+   if (gdt > step) { /* we'll force a minimum FPS for physics to work alright. */
 
       /* Number of frames. */
-      nf = ceil( game_dt / fps_min );
-      microdt = game_dt / nf;
+      nf = ceil( gdt / step );
+      microdt = gdt / nf;
       n  = (int) nf;
 
       /* Update as much as needed, evenly. */
@@ -958,16 +1213,25 @@ static void update_all (void)
           * player to exceed their target position or get mauled by an enemy ship.
           */
          accumdt += microdt;
-         if (accumdt > dt_mod*real_dt)
+         if (accumdt > dt_mod*rdt)
             break;
+
+         /* Something came up, so go back to finer steps for the rest. */
+         if (coarse && (i < n-1) && !player_autonavCoarse()) {
+            coarse   = 0;
+            nf       = ceil( (gdt - accumdt) / fps_min_autonav );
+            microdt  = (gdt - accumdt) / nf;
+            n        = i+1 + (int) nf;
+         }
       }
 
       /* Note we don't touch game_dt so that fps_display works well */
    }
    else /* Standard, just update with the last dt */
-      update_routine( game_dt, 0 );
+      update_routine( gdt, 0 );
 
-   fps_skipped = 0;
+   /* Updates from elsewhere cover the whole frame. */
+   sim_rdt = real_dt;
 }
 
 
@@ -989,25 +1253,40 @@ void update_routine( double dt, int enter_sys )
    }
 
    /* Update engine stuff. */
+   PROFILE_BEGIN( PROFILE_SPACE );
    space_update(dt);
+   PROFILE_END( PROFILE_SPACE );
+   PROFILE_BEGIN( PROFILE_WEAPONS );
    weapons_update(dt);
-   spfx_update(dt, real_dt);
+   PROFILE_END( PROFILE_WEAPONS );
+   PROFILE_BEGIN( PROFILE_SPFX );
+   spfx_update(dt, sim_rdt);
+   PROFILE_END( PROFILE_SPFX );
+   PROFILE_BEGIN( PROFILE_PILOTS );
    pilots_update(dt);
+   ai_attackedFlush();
+   factions_modPlayerFlush(); /* Standing changes from kills and distress. */
+   music_setCombat( player.enemies > player.disabled_enemies );
+   PROFILE_END( PROFILE_PILOTS );
 
    /* Update camera. */
+   PROFILE_BEGIN( PROFILE_CAMERA );
    cam_update( dt );
+   PROFILE_END( PROFILE_CAMERA );
 
    if (!enter_sys) {
+      PROFILE_BEGIN( PROFILE_HOOKS );
       hook_exclusionEnd( dt );
 
       /* Hook set up. */
       h[0].type = HOOK_PARAM_NUMBER;
       h[0].u.num = dt;
       h[1].type = HOOK_PARAM_NUMBER;
-      h[1].u.num = real_dt;
+      h[1].u.num = sim_rdt;
       h[2].type = HOOK_PARAM_SENTINEL;
       /* Run the update hook. */
       hooks_runParam( "update", h );
+      PROFILE_END( PROFILE_HOOKS );
    }
 }
 
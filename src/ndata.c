@@ -34,7 +34,37 @@
 #endif /* MACOS */
 #include "log.h"
 #include "nfile.h"
+#include "npak.h"
 #include "nstring.h"
+#include "threadpool.h"
+
+
+/**
+ * @brief States of an asynchronous read.
+ */
+typedef enum NDataAsyncState_ {
+   NDATA_ASYNC_PENDING, /**< Waiting for a worker. */
+   NDATA_ASYNC_RUNNING, /**< Being read. */
+   NDATA_ASYNC_DONE, /**< Finished reading. */
+} NDataAsyncState;
+
+
+/**
+ * @brief Asynchronous read of a file, shared by all the requests for it.
+ */
+struct NDataAsync_ {
+   char *path; /**< Path of the file. */
+   int priority; /**< Highest priority it was requested with. */
+   int refcount; /**< Number of handles that haven't been waited for. */
+   NDataAsyncState state; /**< State of the read. */
+   void *buf; /**< Contents of the file once done. */
+   size_t size; /**< Size of the contents. */
+};
+
+
+static SDL_mutex *ndata_asyncLock = NULL; /**< Protects the asynchronous reads. */
+static SDL_cond *ndata_asyncCond  = NULL; /**< Signalled when a read finishes. */
+static NDataAsync **ndata_async   = NULL; /**< Reads that are pending or being waited for. */
 
 
 /*
@@ -43,6 +73,9 @@
 static void ndata_testVersion (void);
 static int ndata_found (void);
 static int ndata_enumerateCallback( void* data, const char* origdir, const char* fname );
+static void ndata_asyncRemove( NDataAsync *req );
+static void ndata_asyncFree( NDataAsync *req );
+static int ndata_asyncJob( void *data );
 
 
 /**
@@ -117,6 +150,15 @@ void ndata_setupReadDirs (void)
 {
    char buf[ PATH_MAX ];
 
+   /* Packs can be used anywhere a data directory can. */
+   npak_register();
+
+   if (ndata_asyncLock == NULL) {
+      ndata_asyncLock = SDL_CreateMutex();
+      ndata_asyncCond = SDL_CreateCond();
+      ndata_async     = array_create( NDataAsync* );
+   }
+
    if ( conf.ndata != NULL && PHYSFS_mount( conf.ndata, NULL, 1 ) )
       LOG(_("Added datapath from conf.lua file: %s"), conf.ndata);
 
@@ -132,6 +174,17 @@ void ndata_setupReadDirs (void)
       PHYSFS_mount( buf, NULL, 1 );
    }
 
+   /* Prefer packed data when it's installed, it's faster to read. */
+   if (!ndata_found() && nfile_concatPaths( buf, PATH_MAX, PKGDATADIR, "dat."NPAK_EXTENSION ) >= 0 && nfile_fileExists( buf )) {
+      LOG(_("Trying default datapath: %s"), buf);
+      PHYSFS_mount( buf, NULL, 1 );
+   }
+
+   if (!ndata_found() && nfile_concatPaths( buf, PATH_MAX, PHYSFS_getBaseDir(), "dat."NPAK_EXTENSION ) >= 0 && nfile_fileExists( buf )) {
+      LOG(_("Trying default datapath: %s"), buf);
+      PHYSFS_mount( buf, NULL, 1 );
+   }
+
    if (!ndata_found() && nfile_concatPaths( buf, PATH_MAX, PKGDATADIR, "dat" ) >= 0) {
       LOG(_("Trying default datapath: %s"), buf);
       PHYSFS_mount( buf, NULL, 1 );
@@ -226,6 +279,182 @@ void* ndata_read( const char* path, size_t *filesize )
 }
 
 
+/**
+ * @brief Removes a read from the list of reads, lock must be held.
+ */
+static void ndata_asyncRemove( NDataAsync *req )
+{
+   int i;
+   for (i=0; i<array_size(ndata_async); i++) {
+      if (ndata_async[i] == req) {
+         array_erase( &ndata_async, &ndata_async[i], &ndata_async[i+1] );
+         return;
+      }
+   }
+}
+
+
+/**
+ * @brief Frees a read.
+ */
+static void ndata_asyncFree( NDataAsync *req )
+{
+   free( req->path );
+   free( req->buf );
+   free( req );
+}
+
+
+/**
+ * @brief Performs the most urgent pending read.
+ *
+ * There is a job for every read, but they don't choose which read they do
+ *  until they run, so that urgent reads skip ahead of the rest.
+ */
+static int ndata_asyncJob( void *data )
+{
+   (void) data;
+   int i;
+   NDataAsync *req;
+
+   SDL_LockMutex( ndata_asyncLock );
+   req = NULL;
+   for (i=0; i<array_size(ndata_async); i++) {
+      if (ndata_async[i]->state != NDATA_ASYNC_PENDING)
+         continue;
+      if ((req == NULL) || (ndata_async[i]->priority > req->priority))
+         req = ndata_async[i];
+   }
+   /* Was cancelled or read by whoever waited for it. */
+   if (req == NULL) {
+      SDL_UnlockMutex( ndata_asyncLock );
+      return 0;
+   }
+   req->state = NDATA_ASYNC_RUNNING;
+   SDL_UnlockMutex( ndata_asyncLock );
+
+   req->buf = ndata_read( req->path, &req->size );
+
+   SDL_LockMutex( ndata_asyncLock );
+   req->state = NDATA_ASYNC_DONE;
+   if (req->refcount <= 0) {
+      ndata_asyncRemove( req );
+      ndata_asyncFree( req );
+   }
+   SDL_CondBroadcast( ndata_asyncCond );
+   SDL_UnlockMutex( ndata_asyncLock );
+   return 0;
+}
+
+
+/**
+ * @brief Starts reading a file in the background.
+ *
+ * Requests for a file that is already being read share the same read. Every
+ *  returned handle must be passed to ndata_readWait() or ndata_readCancel().
+ *
+ *    @param path Path of the file to read.
+ *    @param priority Reads with higher priority are done first.
+ *    @return Handle of the read.
+ */
+NDataAsync* ndata_readAsync( const char *path, int priority )
+{
+   int i;
+   NDataAsync *req;
+
+   SDL_LockMutex( ndata_asyncLock );
+   for (i=0; i<array_size(ndata_async); i++) {
+      req = ndata_async[i];
+      if (strcmp( req->path, path ) != 0)
+         continue;
+      req->priority = MAX( req->priority, priority );
+      req->refcount++;
+      SDL_UnlockMutex( ndata_asyncLock );
+      return req;
+   }
+
+   req = calloc( 1, sizeof(NDataAsync) );
+   req->path      = strdup( path );
+   req->priority  = priority;
+   req->refcount  = 1;
+   req->state     = NDATA_ASYNC_PENDING;
+   array_push_back( &ndata_async, req );
+   SDL_UnlockMutex( ndata_asyncLock );
+
+   if (threadpool_newJob( ndata_asyncJob, NULL ) != 0) {
+      /* No worker will do it, so it'll be read when waited for. */
+      WARN(_("Unable to read '%s' in the background."), path);
+   }
+   return req;
+}
+
+
+/**
+ * @brief Gets the contents of a file read in the background.
+ *
+ * Blocks until the read is done, and does the read itself if no worker has
+ *  started it yet. The handle is no longer valid afterwards.
+ *
+ *    @param req Handle of the read.
+ *    @param[out] filesize Stores the size of the file.
+ *    @return The file data, to be freed by the caller, or NULL on error.
+ */
+void* ndata_readWait( NDataAsync *req, size_t *filesize )
+{
+   void *buf;
+
+   SDL_LockMutex( ndata_asyncLock );
+   if (req->state == NDATA_ASYNC_PENDING) {
+      req->state = NDATA_ASYNC_RUNNING;
+      SDL_UnlockMutex( ndata_asyncLock );
+      req->buf = ndata_read( req->path, &req->size );
+      SDL_LockMutex( ndata_asyncLock );
+      req->state = NDATA_ASYNC_DONE;
+      SDL_CondBroadcast( ndata_asyncCond );
+   }
+   while (req->state != NDATA_ASYNC_DONE)
+      SDL_CondWait( ndata_asyncCond, ndata_asyncLock );
+
+   /* Last one gets the buffer, the others get copies. */
+   *filesize = req->size;
+   req->refcount--;
+   if (req->refcount > 0) {
+      buf = NULL;
+      if (req->buf != NULL) {
+         buf = malloc( MAX( 1, req->size ) );
+         memcpy( buf, req->buf, req->size );
+      }
+   }
+   else {
+      buf      = req->buf;
+      req->buf = NULL;
+      ndata_asyncRemove( req );
+      ndata_asyncFree( req );
+   }
+   SDL_UnlockMutex( ndata_asyncLock );
+   return buf;
+}
+
+
+/**
+ * @brief Drops a handle of a read started with ndata_readAsync().
+ *
+ * The read keeps going until it's done if it had already started.
+ *
+ *    @param req Handle of the read.
+ */
+void ndata_readCancel( NDataAsync *req )
+{
+   SDL_LockMutex( ndata_asyncLock );
+   req->refcount--;
+   if ((req->refcount <= 0) && (req->state != NDATA_ASYNC_RUNNING)) {
+      ndata_asyncRemove( req );
+      ndata_asyncFree( req );
+   }
+   SDL_UnlockMutex( ndata_asyncLock );
+}
+
+
 /**
  * @brief Lists all the visible files in a directory, at any depth.
  *
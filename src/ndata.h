@@ -75,9 +75,15 @@
 #define INTRO_PATH               "intro"
 #define RESCUE_PATH              "rescue.lua"
 
+struct NDataAsync_;
+typedef struct NDataAsync_ NDataAsync; /**< Handle of an asynchronous read. */
+
 void ndata_setupWriteDir (void);
 void ndata_setupReadDirs (void);
 void* ndata_read( const char* filename, size_t *filesize );
+NDataAsync* ndata_readAsync( const char *path, int priority );
+void* ndata_readWait( NDataAsync *req, size_t *filesize );
+void ndata_readCancel( NDataAsync *req );
 char** ndata_listRecursive( const char *path );
 int ndata_backupIfExists( const char *path );
 int ndata_copyIfExists( const char *path1, const char *path2 );
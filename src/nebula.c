@@ -28,6 +28,10 @@
 
 #define NEBULA_PUFFS         32 /**< Amount of puffs to generate */
 #define NEBULA_PUFF_BUFFER   300 /**< Nebula buffer */
+#define NEBULA_PUFF_CELL     64 /**< Size of a puff cell in the puff atlas. */
+#define NEBULA_PUFF_COLS     8 /**< Puff cells per row in the puff atlas. */
+#define NEBULA_PUFF_FLOATS   (2+2+2+1+4) /**< Floats per puff vertex (pos, corner, tex, height, colour). */
+#define NEBULA_KEY_PERIOD    0.1 /**< Seconds between nebula key frames. */
 
 
 /* Nebula properties */
@@ -40,15 +44,34 @@ static double nebu_time = 0.; /**< Timer since last render. */
 
 /* Nebula scaling stuff. */
 static double nebu_scale = 4.; /**< How much to scale nebula. */
-static int nebu_dofbo    = 0;
-static GLuint nebu_fbo   = GL_INVALID_VALUE;
-static GLuint nebu_tex   = GL_INVALID_VALUE;
 static GLfloat nebu_render_w= 0.;
 static GLfloat nebu_render_h= 0.;
 static gl_Matrix4 nebu_render_P;
 
+/**
+ * @brief A nebula layer, rendered at key frames that get interpolated.
+ *
+ * The nebula only depends on the time and not on the camera position, so
+ *  it is rendered every NEBULA_KEY_PERIOD seconds ahead of time and the
+ *  frames in between are a blend of the two key frames around them.
+ */
+typedef struct NebulaLayer_ {
+   GLuint fbo[2]; /**< Key frame framebuffers. */
+   GLuint tex[2]; /**< Key frame textures. */
+   double t[2]; /**< Nebula time of each key frame. */
+   int cur; /**< Key frame being blended from. */
+   int next; /**< Whether the key frame after cur is rendered. */
+   int valid; /**< Whether cur is rendered with the current parameters. */
+   GLfloat horizon; /**< Horizon the key frames were rendered with. */
+   GLfloat eddy; /**< Eddy scale the key frames were rendered with. */
+   void (*draw)( double t ); /**< Renders the layer at a time. */
+} NebulaLayer;
+static NebulaLayer nebu_bg; /**< Background layer. */
+static NebulaLayer nebu_ovr; /**< Overlay layer. */
+
 /* puff textures */
-static glTexture *nebu_pufftexs[NEBULA_PUFFS]; /**< Nebula puffs. */
+static glTexture *nebu_pufftex = NULL; /**< Atlas with all the nebula puffs. */
+static int nebu_puffsize[NEBULA_PUFFS]; /**< Size of each puff in the atlas. */
 
 
 /**
@@ -63,22 +86,31 @@ typedef struct NebulaPuff_ {
    int tex; /**< Texture */
    glColour col; /**< Colour. */
 } NebulaPuff;
-static NebulaPuff *nebu_puffs = NULL; /**< Stack of puffs. */
-static int nebu_npuffs        = 0; /**< Number of puffs. */
-static double puff_x          = 0.;
-static double puff_y          = 0.;
+static gl_vbo *nebu_puffVBO   = NULL; /**< Puff vertices, below player puffs first. */
+static int nebu_npuffsBelow   = 0; /**< Number of puffs below the player. */
+static int nebu_npuffsAbove   = 0; /**< Number of puffs above the player. */
+static double puff_x          = 0.; /**< Total puff movement since nebu_prep(). */
+static double puff_y          = 0.; /**< Total puff movement since nebu_prep(). */
 
 
 /*
  * prototypes
  */
-static SDL_Surface* nebu_surfaceFromNebulaMap( float* map, const int w, const int h );
+static void nebu_surfaceFromNebulaMap( SDL_Surface *sur, int x, int y,
+      float* map, const int w, const int h );
 /* Puffs. */
 static void nebu_generatePuffs (void);
 static void nebu_renderPuffs( int below_player );
+static int nebu_puffVertices( GLfloat *data, const NebulaPuff *puffs, int n, int below_player );
 /* Nebula render methods. */
 static void nebu_renderBackground( const double dt );
-static void nebu_blitFBO (void);
+static void nebu_drawBackground( double t );
+static void nebu_drawOverlay( double t );
+/* Key frames. */
+static void nebu_layerResize( NebulaLayer *l );
+static void nebu_layerFree( NebulaLayer *l );
+static void nebu_layerKey( NebulaLayer *l, int k, double t );
+static void nebu_layerRender( NebulaLayer *l, GLfloat horizon, GLfloat eddy );
 
 
 /**
@@ -88,7 +120,9 @@ static void nebu_blitFBO (void);
  */
 int nebu_init (void)
 {
-   nebu_time = -1000.0 * RNGF();
+   nebu_bg.draw  = nebu_drawBackground;
+   nebu_ovr.draw = nebu_drawOverlay;
+   nebu_time = -1000.0 * RNGF_COSMETIC();
    nebu_generatePuffs();
    return nebu_resize();
 }
@@ -113,22 +147,18 @@ int nebu_resize (void)
    nebu_scale = scale;
    nebu_render_w = fbo_w;
    nebu_render_h = fbo_h;
-   nebu_dofbo = (nebu_scale != 1.);
-   glDeleteTextures( 1, &nebu_tex );
-   glDeleteFramebuffers( 1, &nebu_fbo );
-
-   if (nebu_dofbo)
-      gl_fboCreate( &nebu_fbo, &nebu_tex, nebu_render_w, nebu_render_h );
+   nebu_layerResize( &nebu_bg );
+   nebu_layerResize( &nebu_ovr );
 
    /* Set up the matrices. */
    nebu_render_P = gl_Matrix4_Identity();
    nebu_render_P = gl_Matrix4_Translate(nebu_render_P, -nebu_render_w/2., -nebu_render_h/2., 0. );
    nebu_render_P = gl_Matrix4_Scale(nebu_render_P, nebu_render_w, nebu_render_h, 1);
-   glUseProgram(shaders.nebula_background.program);
+   gl_useProgram(shaders.nebula_background.program);
    gl_Matrix4_Uniform(shaders.nebula_background.projection, nebu_render_P);
-   glUseProgram(shaders.nebula.program);
+   gl_useProgram(shaders.nebula.program);
    gl_Matrix4_Uniform(shaders.nebula.projection, nebu_render_P);
-   glUseProgram(0);
+   gl_useProgram(0);
 
    return 0;
 }
@@ -149,17 +179,140 @@ double nebu_getSightRadius (void)
  * @brief Cleans up the nebu subsystem.
  */
 void nebu_exit (void)
+{
+   /* Free the puffs. */
+   gl_freeTexture( nebu_pufftex );
+   nebu_pufftex = NULL;
+   gl_vboDestroy( nebu_puffVBO );
+   nebu_puffVBO = NULL;
+
+   nebu_layerFree( &nebu_bg );
+   nebu_layerFree( &nebu_ovr );
+}
+
+
+/**
+ * @brief Recreates the key frames of a layer at the render size.
+ *
+ *    @param l Layer to resize.
+ */
+static void nebu_layerResize( NebulaLayer *l )
 {
    int i;
+   nebu_layerFree( l );
+   for (i=0; i<2; i++)
+      gl_fboCreate( &l->fbo[i], &l->tex[i], nebu_render_w, nebu_render_h );
+}
 
-   /* Free the puffs. */
-   for (i=0; i<NEBULA_PUFFS; i++)
-      gl_freeTexture( nebu_pufftexs[i] );
 
-   if (nebu_dofbo) {
-      glDeleteFramebuffers( 1, &nebu_fbo );
-      glDeleteTextures( 1, &nebu_tex );
+/**
+ * @brief Frees the key frames of a layer.
+ *
+ *    @param l Layer to free.
+ */
+static void nebu_layerFree( NebulaLayer *l )
+{
+   int i;
+   for (i=0; i<2; i++) {
+      if (l->fbo[i] == 0)
+         continue;
+      glDeleteFramebuffers( 1, &l->fbo[i] );
+      gl_deleteTextures( 1, &l->tex[i] );
+      l->fbo[i] = 0;
+      l->tex[i] = 0;
    }
+   l->valid = 0;
+   l->next  = 0;
+}
+
+
+/**
+ * @brief Renders a key frame of a layer.
+ *
+ *    @param l Layer to render.
+ *    @param k Key frame to render.
+ *    @param t Nebula time to render it at.
+ */
+static void nebu_layerKey( NebulaLayer *l, int k, double t )
+{
+   glBindFramebuffer(GL_FRAMEBUFFER, l->fbo[k]);
+   glClearColor( 0., 0., 0., 0. );
+   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+   glClearColor( 0., 0., 0., 1. );
+   l->draw( t );
+   l->t[k] = t;
+   glBindFramebuffer(GL_FRAMEBUFFER, gl_screen.current_fbo);
+}
+
+
+/**
+ * @brief Renders a layer, updating its key frames as needed.
+ *
+ * The parameters only serve to know when the key frames are outdated, as
+ *  when zooming.
+ *
+ *    @param l Layer to render.
+ *    @param horizon Horizon the layer is rendered with.
+ *    @param eddy Eddy scale the layer is rendered with.
+ */
+static void nebu_layerRender( NebulaLayer *l, GLfloat horizon, GLfloat eddy )
+{
+   double period, inter;
+   int next;
+
+   period = NEBULA_KEY_PERIOD * nebu_dt;
+
+   /* Changed parameters or time jumps invalidate everything. */
+   if (!l->valid || (l->horizon != horizon) || (l->eddy != eddy) ||
+         (nebu_time < l->t[l->cur]) || (nebu_time > l->t[l->cur] + 2.*period)) {
+      l->horizon = horizon;
+      l->eddy    = eddy;
+      nebu_layerKey( l, l->cur, nebu_time );
+      l->valid   = 1;
+      l->next    = 0;
+   }
+   /* Move on to the next key frame. */
+   else if (l->next && (nebu_time >= l->t[1-l->cur])) {
+      l->cur  = 1-l->cur;
+      l->next = 0;
+   }
+
+   /* Render ahead. */
+   next = 1-l->cur;
+   if (!l->next && (period > 0.)) {
+      nebu_layerKey( l, next, l->t[l->cur] + period );
+      l->next = 1;
+   }
+   inter = (l->next) ? CLAMP( 0., 1., (nebu_time - l->t[l->cur]) / period ) : 0.;
+
+   /* Blend the key frames onto the screen. */
+   gl_useProgram(shaders.texture_interpolate.program);
+
+   gl_activeTexture( GL_TEXTURE0 );
+   gl_bindTexture( GL_TEXTURE_2D, l->tex[next] );
+   gl_activeTexture( GL_TEXTURE1 );
+   gl_bindTexture( GL_TEXTURE_2D, l->tex[l->cur] );
+   gl_activeTexture( GL_TEXTURE0 );
+
+   glEnableVertexAttribArray( shaders.texture_interpolate.vertex );
+   gl_vboActivateAttribOffset( gl_squareVBO, shaders.texture_interpolate.vertex,
+         0, 2, GL_FLOAT, 0 );
+
+   /* Set shader uniforms. */
+   glUniform1i(shaders.texture_interpolate.sampler1, 0);
+   glUniform1i(shaders.texture_interpolate.sampler2, 1);
+   gl_uniformColor(shaders.texture_interpolate.color, &cWhite);
+   glUniform1f(shaders.texture_interpolate.inter, inter);
+   gl_Matrix4_Uniform(shaders.texture_interpolate.projection, gl_Matrix4_Ortho(0, 1, 0, 1, 1, -1));
+   gl_Matrix4_Uniform(shaders.texture_interpolate.tex_mat, gl_Matrix4_Identity());
+
+   /* Draw. */
+   gl_drawArrays( GL_TRIANGLE_STRIP, 0, 4 );
+
+   /* Clear state. */
+   glDisableVertexAttribArray( shaders.texture_interpolate.vertex );
+   gl_useProgram(0);
+   gl_checkErr();
 }
 
 
@@ -185,61 +338,36 @@ static void nebu_renderBackground( const double dt )
    /* calculate frame to draw */
    nebu_time += dt * nebu_dt;
 
-   if (nebu_dofbo) {
-      glBindFramebuffer(GL_FRAMEBUFFER, nebu_fbo);
-      glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-   }
+   nebu_layerRender( &nebu_bg, 0., nebu_view * cam_getZoom() / nebu_scale );
+}
 
+
+/**
+ * @brief Draws the nebula background to the bound framebuffer.
+ *
+ *    @param t Nebula time to draw at.
+ */
+static void nebu_drawBackground( double t )
+{
    /* Start the program. */
-   glUseProgram(shaders.nebula_background.program);
+   gl_useProgram(shaders.nebula_background.program);
 
    /* Set shader uniforms. */
-   glUniform1f(shaders.nebula_background.eddy_scale, nebu_view * cam_getZoom() / nebu_scale);
-   glUniform1f(shaders.nebula_background.time, nebu_time);
+   glUniform1f(shaders.nebula_background.eddy_scale, nebu_bg.eddy);
+   glUniform1f(shaders.nebula_background.time, t);
 
    /* Draw. */
    glEnableVertexAttribArray( shaders.nebula_background.vertex );
    gl_vboActivateAttribOffset( gl_squareVBO, shaders.nebula_background.vertex, 0, 2, GL_FLOAT, 0 );
-   glDrawArrays( GL_TRIANGLE_STRIP, 0, 4 );
-   nebu_blitFBO();
+   gl_drawArrays( GL_TRIANGLE_STRIP, 0, 4 );
 
    /* Clean up. */
    glDisableVertexAttribArray( shaders.nebula_background.vertex );
-   glUseProgram(0);
+   gl_useProgram(0);
    gl_checkErr();
 }
 
 
-/**
- * @brief If we're drawing the nebula buffered, copy to the screen.
- */
-static void nebu_blitFBO (void)
-{
-   if (nebu_dofbo) {
-      glBindFramebuffer(GL_FRAMEBUFFER, gl_screen.current_fbo);
-
-      glUseProgram(shaders.texture.program);
-
-      glBindTexture( GL_TEXTURE_2D, nebu_tex );
-
-      glEnableVertexAttribArray( shaders.texture.vertex );
-      gl_vboActivateAttribOffset( gl_squareVBO, shaders.texture.vertex,
-            0, 2, GL_FLOAT, 0 );
-
-      /* Set shader uniforms. */
-      gl_uniformColor(shaders.texture.color, &cWhite);
-      gl_Matrix4_Uniform(shaders.texture.projection, gl_Matrix4_Ortho(0, 1, 0, 1, 1, -1));
-      gl_Matrix4_Uniform(shaders.texture.tex_mat, gl_Matrix4_Identity());
-
-      /* Draw. */
-      glDrawArrays( GL_TRIANGLE_STRIP, 0, 4 );
-
-      /* Clear state. */
-      glDisableVertexAttribArray( shaders.texture.vertex );
-   }
-}
-
-
 /**
  * @brief Updates visibility and stuff.
  */
@@ -278,79 +406,110 @@ void nebu_renderOverlay( const double dt )
     */
    nebu_renderPuffs( 0 );
 
-   /* Prepare the matrix */
-   if (nebu_dofbo) {
-      glBindFramebuffer(GL_FRAMEBUFFER, nebu_fbo);
-      glClearColor( 0., 0., 0., 0. );
-      glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-   }
+   nebu_layerRender( &nebu_ovr, nebu_view * z / nebu_scale, nebu_dx * z / nebu_scale );
+}
+
 
+/**
+ * @brief Draws the nebula overlay to the bound framebuffer.
+ *
+ *    @param t Nebula time to draw at.
+ */
+static void nebu_drawOverlay( double t )
+{
    /* Start the program. */
-   glUseProgram(shaders.nebula.program);
+   gl_useProgram(shaders.nebula.program);
 
    /* Set shader uniforms. */
-   glUniform1f(shaders.nebula.horizon, nebu_view * z / nebu_scale);
-   glUniform1f(shaders.nebula.eddy_scale, nebu_dx * z / nebu_scale);
-   glUniform1f(shaders.nebula.time, nebu_time);
+   glUniform1f(shaders.nebula.horizon, nebu_ovr.horizon);
+   glUniform1f(shaders.nebula.eddy_scale, nebu_ovr.eddy);
+   glUniform1f(shaders.nebula.time, t);
 
    /* Draw. */
    glEnableVertexAttribArray(shaders.nebula.vertex);
    gl_vboActivateAttribOffset( gl_squareVBO, shaders.nebula.vertex, 0, 2, GL_FLOAT, 0 );
-   glDrawArrays( GL_TRIANGLE_STRIP, 0, 4 );
-   nebu_blitFBO();
+   gl_drawArrays( GL_TRIANGLE_STRIP, 0, 4 );
 
    /* Clean up. */
    glDisableVertexAttribArray( shaders.nebula.vertex );
-   glClearColor( 0., 0., 0., 1. );
-   glUseProgram(0);
+   gl_useProgram(0);
    gl_checkErr();
-
-   /* Reset puff movement. */
-   puff_x = 0.;
-   puff_y = 0.;
 }
 
 
 /**
  * @brief Renders the puffs.
  *
+ * The puffs never change after nebu_prep(), the shader moves them by the
+ *  total puff movement scaled by their height and wraps them around the
+ *  screen, so each layer is a single draw call.
+ *
  *    @param below_player Render the puffs below player or above player?
  */
 static void nebu_renderPuffs( int below_player )
 {
-   int i;
-   NebulaPuff *puff;
+   GLsizei stride;
+   GLint first;
+   GLsizei n;
 
    /* Main menu shouldn't have puffs */
    if (menu_isOpen(MENU_MAIN))
       return;
 
-   for (i=0; i<nebu_npuffs; i++) {
-      puff = &nebu_puffs[i];
-
-      /* Separate by layers */
-      if ((below_player && (puff->height < 1.)) ||
-            (!below_player && (puff->height > 1.))) {
-
-         /* calculate new position */
-         puff->x += puff_x * puff->height;
-         puff->y += puff_y * puff->height;
-
-         /* Check boundaries */
-         if (puff->x > SCREEN_W + NEBULA_PUFF_BUFFER)
-            puff->x -= SCREEN_W + 2*NEBULA_PUFF_BUFFER;
-         else if (puff->y > SCREEN_H + NEBULA_PUFF_BUFFER)
-            puff->y -= SCREEN_H + 2*NEBULA_PUFF_BUFFER;
-         else if (puff->x < -NEBULA_PUFF_BUFFER)
-            puff->x += SCREEN_W + 2*NEBULA_PUFF_BUFFER;
-         else if (puff->y < -NEBULA_PUFF_BUFFER)
-            puff->y += SCREEN_H + 2*NEBULA_PUFF_BUFFER;
-
-         /* Render */
-         gl_blitStatic( nebu_pufftexs[puff->tex],
-               puff->x, puff->y, &puff->col );
-      }
+   if (below_player) {
+      first = 0;
+      n     = nebu_npuffsBelow;
    }
+   else {
+      first = nebu_npuffsBelow;
+      n     = nebu_npuffsAbove;
+   }
+   if ((n == 0) || !gl_texUse( nebu_pufftex ))
+      return;
+
+   gl_useProgram(shaders.nebula_puff.program);
+
+   /* Bind the atlas. */
+   gl_activeTexture( GL_TEXTURE0 );
+   gl_bindTexture( GL_TEXTURE_2D, nebu_pufftex->texture );
+
+   /* Set the vertex data. */
+   stride = sizeof(GLfloat) * NEBULA_PUFF_FLOATS;
+   glEnableVertexAttribArray( shaders.nebula_puff.vertex );
+   glEnableVertexAttribArray( shaders.nebula_puff.corner );
+   glEnableVertexAttribArray( shaders.nebula_puff.vertex_tex );
+   glEnableVertexAttribArray( shaders.nebula_puff.height );
+   glEnableVertexAttribArray( shaders.nebula_puff.vertex_color );
+   gl_vboActivateAttribOffset( nebu_puffVBO, shaders.nebula_puff.vertex,
+         0, 2, GL_FLOAT, stride );
+   gl_vboActivateAttribOffset( nebu_puffVBO, shaders.nebula_puff.corner,
+         sizeof(GLfloat) * 2, 2, GL_FLOAT, stride );
+   gl_vboActivateAttribOffset( nebu_puffVBO, shaders.nebula_puff.vertex_tex,
+         sizeof(GLfloat) * 4, 2, GL_FLOAT, stride );
+   gl_vboActivateAttribOffset( nebu_puffVBO, shaders.nebula_puff.height,
+         sizeof(GLfloat) * 6, 1, GL_FLOAT, stride );
+   gl_vboActivateAttribOffset( nebu_puffVBO, shaders.nebula_puff.vertex_color,
+         sizeof(GLfloat) * 7, 4, GL_FLOAT, stride );
+
+   /* Set shader uniforms. */
+   glUniform1i(shaders.nebula_puff.sampler, 0);
+   glUniform2f(shaders.nebula_puff.puff_xy, puff_x, puff_y);
+   glUniform2f(shaders.nebula_puff.wh,
+         SCREEN_W + 2*NEBULA_PUFF_BUFFER, SCREEN_H + 2*NEBULA_PUFF_BUFFER);
+   glUniform1f(shaders.nebula_puff.puff_buf, NEBULA_PUFF_BUFFER);
+   gl_globalsUse();
+
+   /* Draw. */
+   gl_drawArrays( GL_TRIANGLES, 6 * first, 6 * n );
+
+   /* Clear state. */
+   glDisableVertexAttribArray( shaders.nebula_puff.vertex );
+   glDisableVertexAttribArray( shaders.nebula_puff.corner );
+   glDisableVertexAttribArray( shaders.nebula_puff.vertex_tex );
+   glDisableVertexAttribArray( shaders.nebula_puff.height );
+   glDisableVertexAttribArray( shaders.nebula_puff.vertex_color );
+   gl_useProgram(0);
+   gl_checkErr();
 }
 
 
@@ -374,23 +533,25 @@ void nebu_movePuffs( double x, double y )
 void nebu_prep( double density, double volatility, double hue )
 {
    (void)volatility;
-   int i;
+   int i, n;
    float puffhue;
    glColour col;
+   NebulaPuff *puffs;
+   GLfloat *data;
 
    /* Set the hue. */
    nebu_hue = hue;
-   glUseProgram(shaders.nebula.program);
+   gl_useProgram(shaders.nebula.program);
    glUniform1f(shaders.nebula.hue, nebu_hue);
-   glUseProgram(shaders.nebula_background.program);
+   gl_useProgram(shaders.nebula_background.program);
    glUniform1f(shaders.nebula_background.hue, nebu_hue);
-   glUseProgram(0);
+   gl_useProgram(0);
 
    /* Also set the hue for trail.s */
    col_hsv2rgb( &col, nebu_hue*360., 0.7, 1.0 );
-   glUseProgram(shaders.trail.program);
+   gl_useProgram(shaders.trail.program);
    glUniform3f( shaders.trail.nebu_col, col.r, col.g, col.b );
-   glUseProgram(0);
+   gl_useProgram(0);
 
    /* Set density parameters. */
    nebu_density = density;
@@ -398,25 +559,95 @@ void nebu_prep( double density, double volatility, double hue )
    nebu_dt   = (2.*density + 200.) / 10000.; /* Faster at higher density */
    nebu_dx   = 15000. / pow(density, 1./3.); /* Closer at higher density */
    nebu_time = 0.;
+   nebu_bg.valid  = 0;
+   nebu_ovr.valid = 0;
 
-   nebu_npuffs = density/2.;
-   nebu_puffs = realloc(nebu_puffs, sizeof(NebulaPuff)*nebu_npuffs);
-   for (i=0; i<nebu_npuffs; i++) {
+   /* Puffs start off where they are generated. */
+   puff_x = 0.;
+   puff_y = 0.;
+
+   n = density/2.;
+   puffs = malloc( sizeof(NebulaPuff) * MAX(n,1) );
+   for (i=0; i<n; i++) {
       /* Position */
-      nebu_puffs[i].x = (double)RNG(-NEBULA_PUFF_BUFFER,
+      puffs[i].x = (double)RNG_COSMETIC(-NEBULA_PUFF_BUFFER,
             SCREEN_W + NEBULA_PUFF_BUFFER);
-      nebu_puffs[i].y = (double)RNG(-NEBULA_PUFF_BUFFER,
+      puffs[i].y = (double)RNG_COSMETIC(-NEBULA_PUFF_BUFFER,
             SCREEN_H + NEBULA_PUFF_BUFFER);
 
       /* Maybe make size related? */
-      nebu_puffs[i].tex = RNG(0,NEBULA_PUFFS-1);
-      nebu_puffs[i].height = RNGF() + 0.2;
+      puffs[i].tex = RNG_COSMETIC(0,NEBULA_PUFFS-1);
+      puffs[i].height = RNGF_COSMETIC() + 0.2;
 
       /* Set the colour, with less saturation. */
-      puffhue = nebu_hue * 360.0 + 0.1*(RNGF()*2.-1.);
-      col_hsv2rgb( &nebu_puffs[i].col, puffhue, 0.6, 1.0 );
-      nebu_puffs[i].col.a = 1.0;
+      puffhue = nebu_hue * 360.0 + 0.1*(RNGF_COSMETIC()*2.-1.);
+      col_hsv2rgb( &puffs[i].col, puffhue, 0.6, 1.0 );
+      puffs[i].col.a = 1.0;
    }
+
+   /* Upload them once, below player puffs go first. */
+   data = malloc( sizeof(GLfloat) * NEBULA_PUFF_FLOATS * 6 * MAX(n,1) );
+   nebu_npuffsBelow = nebu_puffVertices( data, puffs, n, 1 );
+   nebu_npuffsAbove = nebu_puffVertices( &data[ NEBULA_PUFF_FLOATS * 6 * nebu_npuffsBelow ],
+         puffs, n, 0 );
+   gl_vboDestroy( nebu_puffVBO );
+   nebu_puffVBO = gl_vboCreateStatic( sizeof(GLfloat) * NEBULA_PUFF_FLOATS * 6 * MAX(n,1), data );
+   free( data );
+   free( puffs );
+}
+
+
+/**
+ * @brief Writes the vertices of one layer of puffs.
+ *
+ *    @param[out] data Where to write the vertices.
+ *    @param puffs Puffs to write.
+ *    @param n Number of puffs.
+ *    @param below_player Write the puffs below player or above player?
+ *    @return Number of puffs written.
+ */
+static int nebu_puffVertices( GLfloat *data, const NebulaPuff *puffs, int n, int below_player )
+{
+   /* Two triangles covering the unit square. */
+   static const GLfloat qx[6] = { 0., 1., 0., 0., 1., 1. };
+   static const GLfloat qy[6] = { 0., 0., 1., 1., 0., 1. };
+   int i, j, k;
+   GLfloat s, tx, ty, ts;
+   const NebulaPuff *puff;
+   GLfloat *d;
+
+   k = 0;
+   for (i=0; i<n; i++) {
+      puff = &puffs[i];
+
+      /* Separate by layers */
+      if ((below_player && !(puff->height < 1.)) ||
+            (!below_player && !(puff->height > 1.)))
+         continue;
+
+      /* Location of the puff in the atlas. */
+      s  = nebu_puffsize[puff->tex];
+      tx = (puff->tex % NEBULA_PUFF_COLS) * NEBULA_PUFF_CELL / nebu_pufftex->w;
+      ty = (puff->tex / NEBULA_PUFF_COLS) * NEBULA_PUFF_CELL / nebu_pufftex->h;
+      ts = s / nebu_pufftex->w;
+
+      for (j=0; j<6; j++) {
+         d = &data[ NEBULA_PUFF_FLOATS * (6*k + j) ];
+         d[0]  = puff->x;
+         d[1]  = puff->y;
+         d[2]  = qx[j] * s;
+         d[3]  = qy[j] * s;
+         d[4]  = tx + qx[j] * ts;
+         d[5]  = ty + qy[j] * s / nebu_pufftex->h;
+         d[6]  = puff->height;
+         d[7]  = puff->col.r;
+         d[8]  = puff->col.g;
+         d[9]  = puff->col.b;
+         d[10] = puff->col.a;
+      }
+      k++;
+   }
+   return k;
 }
 
 
@@ -430,46 +661,55 @@ static void nebu_generatePuffs (void)
    SDL_Surface *sur;
    float *nebu;
 
+   /* All the puffs go into a single atlas so a layer is drawn at once. */
+   sur = SDL_CreateRGBSurface( SDL_SWSURFACE,
+         NEBULA_PUFF_COLS * NEBULA_PUFF_CELL,
+         (NEBULA_PUFFS + NEBULA_PUFF_COLS - 1) / NEBULA_PUFF_COLS * NEBULA_PUFF_CELL,
+         32, RGBAMASK );
+
    /* Generate the nebula puffs */
    for (i=0; i<NEBULA_PUFFS; i++) {
       /* Generate the nebula */
-      w = h = RNG(20,64);
+      w = h = RNG_COSMETIC(20,NEBULA_PUFF_CELL);
       nebu = noise_genNebulaPuffMap( w, h, 1. );
-      sur = nebu_surfaceFromNebulaMap( nebu, w, h );
+      nebu_surfaceFromNebulaMap( sur,
+            (i % NEBULA_PUFF_COLS) * NEBULA_PUFF_CELL,
+            (i / NEBULA_PUFF_COLS) * NEBULA_PUFF_CELL,
+            nebu, w, h );
       free(nebu);
-
-      /* Load the texture */
-      nebu_pufftexs[i] =  gl_loadImage( sur, 0 );
+      nebu_puffsize[i] = w;
    }
+
+   /* Load the texture */
+   nebu_pufftex = gl_loadImage( sur, 0 );
 }
 
 
 /**
- * @brief Generates a SDL_Surface from a 2d nebula map
+ * @brief Writes a 2d nebula map into part of a SDL_Surface.
  *
+ *    @param sur Surface to write to.
+ *    @param x X position to write the map at.
+ *    @param y Y position to write the map at.
  *    @param map Nebula map to use.
  *    @param w Map width.
  *    @param h Map height.
- *    @return A SDL Surface with the nebula.
  */
-static SDL_Surface* nebu_surfaceFromNebulaMap( float* map, const int w, const int h )
+static void nebu_surfaceFromNebulaMap( SDL_Surface *sur, int x, int y,
+      float* map, const int w, const int h )
 {
-   int i;
-   SDL_Surface *sur;
+   int i, j;
    uint32_t *pix;
    double c;
 
-   /* the good surface */
-   sur = SDL_CreateRGBSurface( SDL_SWSURFACE, w, h, 32, RGBAMASK );
-   pix = sur->pixels;
-
    /* convert from mapping to actual colours */
    SDL_LockSurface( sur );
-   for (i=0; i<h*w; i++) {
-      c = map[i];
-      pix[i] = RMASK + BMASK + GMASK + (AMASK & (uint32_t)((double)AMASK*c));
+   for (j=0; j<h; j++) {
+      pix = (uint32_t*)((uint8_t*)sur->pixels + (y+j)*sur->pitch) + x;
+      for (i=0; i<w; i++) {
+         c = map[j*w+i];
+         pix[i] = RMASK + BMASK + GMASK + (AMASK & (uint32_t)((double)AMASK*c));
+      }
    }
    SDL_UnlockSurface( sur );
-
-   return sur;
 }
@@ -40,6 +40,7 @@
  * News stack.
  */
 news_t* news_list             = NULL;  /**< Linked list containing all articles */
+static news_t **news_articles = NULL;  /**< Array (array.h) of the articles indexed by ID, NULL if freed. */
 
 static int next_id            = 1; /**< next number to use as ID */
 
@@ -57,6 +58,10 @@ static glFont *news_font      = &gl_defFont; /**< Font to use. */
 static char **news_lines      = NULL; /**< Array (array.h) of each line's text. */
 static glFontRestore *news_restores = NULL; /**< Array (array.h) of restorations. */
 static double textlength      = 0.;
+static char *news_layoutBuf   = NULL; /**< Text news_lines are laid out from. */
+static int news_layoutLen     = 0; /**< Length of news_layoutBuf. */
+static int news_layoutPos     = 0; /**< Position in news_layoutBuf laid out so far. */
+static int news_layoutW       = 0; /**< Width news_lines are laid out for. */
 
 /**
  * Save/load
@@ -75,6 +80,7 @@ int news_loadArticles( xmlNodePtr parent ); /* externed in load.c */
 static char* make_clean( char* unclean );
 static char* get_fromclean( char *clean );
 static void clear_newslines (void);
+static void news_layoutLines( int n );
 
 /**
  * @brief makes a new article and puts it into the list
@@ -95,6 +101,11 @@ news_t* new_article(char* title, char* content, const char* faction, ntime_t dat
 
    n_article->id = next_id++;
 
+   /* Index it. */
+   while (array_size(news_articles) <= n_article->id)
+      array_push_back( &news_articles, NULL );
+   news_articles[ n_article->id ] = n_article;
+
    /* allocate it */
    if ( !( (n_article->title = strdup(title)) &&
          (n_article->desc = strdup(content)) &&
@@ -109,6 +120,7 @@ news_t* new_article(char* title, char* content, const char* faction, ntime_t dat
    /* If it belongs first*/
    if (news_list->date <= date) {
       n_article->next = news_list;
+      news_list->prev = n_article;
       news_list = n_article;
    }
    /* article_ptr is the one BEFORE the one we want*/
@@ -119,6 +131,9 @@ news_t* new_article(char* title, char* content, const char* faction, ntime_t dat
          article_ptr = article_ptr->next;
 
       n_article->next = article_ptr->next;
+      n_article->prev = article_ptr;
+      if (article_ptr->next != NULL)
+         article_ptr->next->prev = n_article;
 
       article_ptr->next = n_article;
    }
@@ -133,34 +148,28 @@ news_t* new_article(char* title, char* content, const char* faction, ntime_t dat
  */
 int free_article(int id)
 {
-   news_t *article_ptr, *article_to_rm;
-
-   article_ptr = news_list;
+   news_t *article_to_rm;
 
-   /* if the first article is the one we're looking for */
-   if (news_list->id == id) {
-      article_to_rm = news_list;
-      news_list = news_list->next;
-
-      if (article_to_rm->next == NULL) {
-         WARN(_("\nLast article, do not remove"));
-         return -1;
-      }
+   article_to_rm = news_get( id );
+   if (article_to_rm == NULL) {
+      WARN(_("\nArticle to remove not found"));
+      return -1;
    }
-   else {
-      /* get the article before the one we're looking for */
-      while ((article_ptr->next != NULL) && (article_ptr->next->id != id))
-         article_ptr = article_ptr->next;
-
-      if (article_ptr->next == NULL) {
-         WARN(_("\nArticle to remove not found"));
-         return -1;
-      }
 
-      article_to_rm = article_ptr->next;
-      article_ptr->next = article_to_rm->next;
+   /* the list ends with a dummy article */
+   if (article_to_rm->next == NULL) {
+      WARN(_("\nLast article, do not remove"));
+      return -1;
    }
 
+   /* unlink it */
+   if (article_to_rm->prev != NULL)
+      article_to_rm->prev->next = article_to_rm->next;
+   else
+      news_list = article_to_rm->next;
+   article_to_rm->next->prev = article_to_rm->prev;
+   news_articles[ id ] = NULL;
+
    free(article_to_rm->title);
    free(article_to_rm->desc);
    free(article_to_rm->faction);
@@ -181,6 +190,8 @@ int news_init (void)
       news_exit();
 
    news_list = calloc(sizeof(news_t), 1);
+   news_articles = array_create( news_t* );
+   array_push_back( &news_articles, news_list );
    news_lines = array_create( char* );
    news_restores = array_create( glFontRestore );
 
@@ -220,7 +231,13 @@ void news_exit (void)
    news_lines  = NULL;
    news_restores = NULL;
    textlength  = 0;
+   free(news_layoutBuf);
+   news_layoutBuf = NULL;
+   news_layoutLen = 0;
+   news_layoutPos = 0;
 
+   array_free(news_articles);
+   news_articles = NULL;
    news_list = NULL;
 
 }
@@ -232,17 +249,9 @@ void news_exit (void)
  */
 news_t* news_get(int id)
 {
-   news_t *article_ptr;
-
-   article_ptr = news_list;
-
-   while ((article_ptr != NULL) && (article_ptr->id != id))
-      article_ptr = article_ptr->next;
-
-   if (article_ptr == NULL)
+   if ((id < 0) || (id >= array_size(news_articles)))
       return NULL;
-
-   return article_ptr;
+   return news_articles[id];
 }
 
 
@@ -320,23 +329,47 @@ int *generate_news( const char* faction )
  */
 void news_widget( unsigned int wid, int x, int y, int w, int h )
 {
-   int i, p;
-
    /* Safe defaults. */
    news_pos    = h/3;
    news_tick   = SDL_GetTicks();
 
-   clear_newslines();
+   /* Lines are only laid out again if the news changed. */
+   if ((news_layoutBuf == NULL) || (news_layoutW != w) || (news_layoutLen != len)
+         || (memcmp( news_layoutBuf, buf, len ) != 0)) {
+      clear_newslines();
+      free( news_layoutBuf );
+      news_layoutBuf = malloc( len+1 );
+      memcpy( news_layoutBuf, buf, len );
+      news_layoutBuf[len] = '\0';
+      news_layoutLen = len;
+      news_layoutPos = 0;
+      news_layoutW   = w;
+   }
+
+   /* Create the custom widget. */
+   window_addCust( wid, x, y, w, h, "cstNews", 1, news_render, news_mouse, NULL );
+}
 
-   /* Now load up the text. */
-   p = 0;
 
-   while (p < len) {
+/**
+ * @brief Lays out the news text until there are enough lines.
+ *
+ * Lines are laid out as they scroll into view, so long news don't have to be
+ *  laid out all at once when landing.
+ *
+ *    @param n Number of lines wanted.
+ */
+static void news_layoutLines( int n )
+{
+   int i, p;
+
+   p = news_layoutPos;
+   while ((array_size( news_lines ) < n) && (p < news_layoutLen)) {
       /* Get the length. */
-      i = gl_printWidthForText( NULL, &buf[p], w-40, NULL );
+      i = gl_printWidthForText( NULL, &news_layoutBuf[p], news_layoutW-40, NULL );
 
       /* Copy the line. */
-      array_push_back( &news_lines, strndup( buf+p, i ) );
+      array_push_back( &news_lines, strndup( news_layoutBuf+p, i ) );
       if (array_size( news_restores ) == 0)
          gl_printRestoreInit( &array_grow( &news_restores ) );
       else {
@@ -347,10 +380,7 @@ void news_widget( unsigned int wid, int x, int y, int w, int h )
 
       p += i + 1;    /* Move pointer. */
    }
-   /* </load text> */
-
-   /* Create the custom widget. */
-   window_addCust( wid, x, y, w, h, "cstNews", 1, news_render, news_mouse, NULL );
+   news_layoutPos = p;
 }
 
 
@@ -458,6 +488,7 @@ static void news_render( double bx, double by, double w, double h, void *data )
    /* Render the text. */
    p = (int)ceil( news_pos / (news_font->h + 5.));
    m = (int)ceil(        h / (news_font->h + 5.));
+   news_layoutLines( p + 1 );
    if (p > array_size( news_lines ) + m + 1) {
       news_pos = 0.;
       return;
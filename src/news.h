@@ -26,6 +26,7 @@ typedef struct news_s {
    ntime_t date_to_rm; /**< Date after which the article will be removed */
 
    struct news_s* next; /**< pointer to next article in the list */
+   struct news_s* prev; /**< pointer to previous article in the list */
 } news_t;
 
 
@@ -10,16 +10,20 @@
 
 /** @cond */
 #include "physfs.h"
+#include "SDL_timer.h"
 
 #include "naev.h"
 /** @endcond */
 
 #include "nlua.h"
 
+#include "array.h"
 #include "log.h"
 #include "lutf8lib.h"
+#include "memtrack.h"
 #include "ndata.h"
 #include "nfile.h"
+#include "nlua_canvas.h"
 #include "nlua_cli.h"
 #include "nlua_commodity.h"
 #include "nlua_data.h"
@@ -41,10 +45,84 @@
 #include "nlua_vec2.h"
 #include "nluadef.h"
 #include "nstring.h"
+#include "strindex.h"
 
 
 lua_State *naevL = NULL;
 nlua_env __NLUA_CURENV = LUA_NOREF;
+static int nlua_pcallDepth = 0; /**< Nesting of nlua_pcall(). */
+static Uint64 nlua_scriptTicks = 0; /**< Counter ticks spent in nlua_pcall(). */
+
+
+/**
+ * @brief Compiled Lua chunk.
+ *
+ * The same scripts get loaded over and over (missions when landing, AI
+ *  profiles, outfits...), so the bytecode of every chunk is kept and reused
+ *  as long as the source doesn't change. Chunks are identified by their name
+ *  and the hash of their source, as some names are shared by many sources
+ *  (e.g. conditionals).
+ */
+typedef struct LuaChunk_ {
+   char *name; /**< Name of the chunk (usually the file it comes from). */
+   uint64_t hash; /**< Hash of the source. */
+   size_t size; /**< Size of the source. */
+   char *bytecode; /**< Compiled chunk (array.h), NULL if it couldn't be dumped. */
+   int next; /**< Next chunk with the same name, -1 if last. */
+} LuaChunk;
+static LuaChunk *lua_chunks = NULL; /**< Compiled chunks (array.h). */
+static StrIndex lua_chunkIndex; /**< Looks up chunks by name. */
+
+/*
+ * Standard libraries are registered once in a shared base environment that
+ *  environments inherit from, see nlua_loadStandard().
+ */
+static int nlua_stdMeta = LUA_NOREF; /**< Metatable inheriting from the base environment. */
+static int nlua_stdRet = 0; /**< Result of loading the standard libraries. */
+
+/*
+ * Garbage collection pacing, see nlua_gcStep().
+ */
+#define NLUA_GC_BUDGET_MIN 0.0005 /**< Time to collect when the spare time is unknown (s). */
+#define NLUA_GC_BUDGET_MAX 0.004 /**< Maximum time to collect in a frame (s). */
+#define NLUA_GC_STEP_MIN   1 /**< Minimum step size. */
+#define NLUA_GC_STEP_MAX   4096 /**< Maximum step size. */
+#define NLUA_GC_GROWTH     1.5 /**< Memory growth since the last cycle that starts a new one. */
+static int gc_stepsize = 16; /**< Current step size, adapted to the budget. */
+static int gc_active = 0; /**< A paced cycle is in progress. */
+static double gc_base = 0.; /**< Memory in use at the end of the last cycle. */
+static NluaGCStats gc_stats; /**< Statistics. */
+static int nlua_allocHooked = 0; /**< naevL uses nlua_alloc(), see nlua_newState(). */
+
+/*
+ * Allocator of the global state, see nlua_alloc(). Small blocks are carved
+ *  out of slabs and recycled through free lists per size class, as tables,
+ *  closures and userdata are allocated and collected all the time.
+ */
+#define NLUA_POOL_GRAIN    16 /**< Size class granularity and block alignment (bytes). */
+#define NLUA_POOL_CLASSES  16 /**< Number of size classes. */
+#define NLUA_POOL_MAX      (NLUA_POOL_GRAIN*NLUA_POOL_CLASSES) /**< Largest pooled block (bytes). */
+#define NLUA_POOL_SLAB     65536 /**< Size of a slab (bytes). */
+#define NLUA_POOL_CLASS(n) (((n)-1) / NLUA_POOL_GRAIN) /**< Size class of n bytes. */
+/**
+ * @brief Free small block, linked through its own memory.
+ */
+typedef struct NluaBlock_ {
+   struct NluaBlock_ *next; /**< Next free block of the same class. */
+} NluaBlock;
+static NluaBlock *nlua_poolFree[NLUA_POOL_CLASSES]; /**< Free blocks per size class. */
+static char **nlua_poolSlabs = NULL; /**< Slabs (array.h). */
+static char *nlua_poolCur = NULL; /**< Unused part of the current slab. */
+static size_t nlua_poolLeft = 0; /**< Bytes left in the current slab. */
+static NluaAllocStats nlua_astats; /**< Allocator statistics. */
+static NluaEnvMem *nlua_envMems = NULL; /**< Memory allocated per environment, indexed by environment (array.h). */
+
+/*
+ * Script profiling, see nlua_profEnable().
+ */
+static int lua_profEnabled = 0; /**< Calls are being timed. */
+static NluaProfEntry *lua_prof = NULL; /**< Timed functions (array.h). */
+static StrIndex lua_profIndex; /**< Looks up timed functions by name. */
 
 
 /*
@@ -52,7 +130,19 @@ nlua_env __NLUA_CURENV = LUA_NOREF;
  */
 static int nlua_require( lua_State* L );
 static lua_State *nlua_newState (void); /* creates a new state */
+static void *nlua_alloc( void *ud, void *ptr, size_t osize, size_t nsize );
+static void *nlua_poolGet( int c );
+static void nlua_poolPut( int c, void *ptr );
+static void nlua_poolClear (void);
+static NluaEnvMem *nlua_envMemGet( nlua_env env );
 static int nlua_loadBasic( lua_State* L );
+static uint64_t nlua_hashBuffer( const char *buff, size_t sz );
+static int nlua_chunkWriter( lua_State *L, const void *p, size_t sz, void *ud );
+static int nlua_loadbuffer( lua_State *L, const char *buff, size_t sz, const char *name );
+static int nlua_createStandard (void);
+static double nlua_gcCount (void);
+static int nlua_profGet( int func );
+static int nlua_profCompare( const void *p1, const void *p2 );
 /* gettext */
 static int nlua_gettext( lua_State *L );
 static int nlua_ngettext( lua_State *L );
@@ -122,8 +212,22 @@ static int nlua_gettext_noop( lua_State *L )
  * @brief Initializes the global Lua state.
  */
 void lua_init(void) {
+   char packagepath[STRMAX];
+
    naevL = nlua_newState();
    nlua_loadBasic(naevL);
+
+   /* Set up paths.
+    * "package.path" to look in the data.
+    * "package.cpath" unset */
+   lua_getglobal(naevL, "package");
+   snprintf( packagepath, sizeof(packagepath),
+         "?.lua;"LUA_INCLUDE_PATH"?.lua" );
+   lua_pushstring(naevL, packagepath);
+   lua_setfield(naevL, -2, "path");
+   lua_pushstring(naevL, "");
+   lua_setfield(naevL, -2, "cpath");
+   lua_pop(naevL,1);
 }
 
 
@@ -131,8 +235,120 @@ void lua_init(void) {
  * @brief Closes the global Lua state.
  */
 void lua_exit(void) {
+   int i;
+
    lua_close(naevL);
    naevL = NULL;
+   nlua_poolClear(); /* Every block has been given back. */
+   nlua_canvasPoolFree(); /* Canvases collected when closing end up there. */
+   nlua_stdMeta = LUA_NOREF;
+   gc_active = 0;
+   gc_base   = 0.;
+   nlua_profReset();
+
+   /* Clear the compiled chunks. */
+   for (i=0; i<array_size(lua_chunks); i++) {
+      free( lua_chunks[i].name );
+      array_free( lua_chunks[i].bytecode );
+   }
+   array_free( lua_chunks );
+   lua_chunks = NULL;
+   strindex_free( &lua_chunkIndex );
+}
+
+
+/*
+ * @brief Hashes a source buffer (FNV-1a).
+ */
+static uint64_t nlua_hashBuffer( const char *buff, size_t sz )
+{
+   size_t i;
+   uint64_t h;
+
+   h = 14695981039346656037ULL;
+   for (i=0; i<sz; i++) {
+      h ^= (unsigned char) buff[i];
+      h *= 1099511628211ULL;
+   }
+   return h;
+}
+
+
+/*
+ * @brief Appends dumped bytecode to a chunk.
+ */
+static int nlua_chunkWriter( lua_State *L, const void *p, size_t sz, void *ud )
+{
+   char **bytecode;
+   size_t n;
+   (void) L;
+
+   bytecode = ud;
+   n = array_size( *bytecode );
+
+   array_resize( bytecode, n+sz );
+   memcpy( &(*bytecode)[n], p, sz );
+   return 0;
+}
+
+
+/*
+ * @brief Loads a buffer as a Lua chunk, reusing its bytecode if it was
+ *        already compiled.
+ *
+ *    @param L Lua state to load into.
+ *    @param buff Pointer to buffer.
+ *    @param sz Size of buffer.
+ *    @param name Name of the chunk.
+ *    @return 0 on success, like luaL_loadbuffer.
+ */
+static int nlua_loadbuffer( lua_State *L, const char *buff, size_t sz, const char *name )
+{
+   int head, id, ret;
+   uint64_t hash;
+   LuaChunk *c;
+
+   if (name == NULL)
+      return luaL_loadbuffer(L, buff, sz, name);
+
+   /* Reuse the bytecode if the source was already compiled. */
+   hash = nlua_hashBuffer( buff, sz );
+   head = strindex_get( &lua_chunkIndex, name );
+   for (id=head; id>=0; id=lua_chunks[id].next) {
+      c = &lua_chunks[id];
+      if ((c->size != sz) || (c->hash != hash))
+         continue;
+      if (c->bytecode == NULL)
+         break;
+      return luaL_loadbuffer(L, c->bytecode, array_size(c->bytecode), name);
+   }
+
+   ret = luaL_loadbuffer(L, buff, sz, name);
+   if ((ret != 0) || (id >= 0))
+      return ret;
+
+   /* Remember the bytecode for next time. */
+   if (lua_chunks == NULL)
+      lua_chunks = array_create( LuaChunk );
+   id = array_size( lua_chunks );
+   c  = &array_grow( &lua_chunks );
+   c->name     = strdup( name );
+   c->hash     = hash;
+   c->size     = sz;
+   c->bytecode = array_create( char );
+   if (head < 0) {
+      c->next = -1;
+      strindex_add( &lua_chunkIndex, c->name, id );
+   }
+   else {
+      c->next = lua_chunks[head].next;
+      lua_chunks[head].next = id;
+   }
+   if (lua_dump(L, nlua_chunkWriter, &c->bytecode) != 0) {
+      array_free( c->bytecode );
+      c->bytecode = NULL;
+   }
+   return 0;
 }
 
 
@@ -148,7 +364,7 @@ int nlua_dobufenv(nlua_env env,
                   const char *buff,
                   size_t sz,
                   const char *name) {
-   if (luaL_loadbuffer(naevL, buff, sz, name) != 0)
+   if (nlua_loadbuffer(naevL, buff, sz, name) != 0)
       return -1;
    nlua_pushenv(env);
    lua_setfenv(naevL, -2);
@@ -183,11 +399,12 @@ int nlua_dofileenv(nlua_env env, const char *filename) {
  *    @param rw Load libraries in read/write mode.
  */
 nlua_env nlua_newEnv(int rw) {
-   char packagepath[STRMAX];
    nlua_env ref;
    lua_newtable(naevL);
    lua_pushvalue(naevL, -1);
    ref = luaL_ref(naevL, LUA_REGISTRYINDEX);
+   if (nlua_allocHooked)
+      memset( nlua_envMemGet( ref ), 0, sizeof(NluaEnvMem) );
 
    /* Metatable */
    lua_newtable(naevL);
@@ -200,18 +417,6 @@ nlua_env nlua_newEnv(int rw) {
    lua_pushcclosure(naevL, nlua_require, 1);
    lua_setfield(naevL, -2, "require");
 
-   /* Set up paths.
-    * "package.path" to look in the data.
-    * "package.cpath" unset */
-   lua_getglobal(naevL, "package");
-   snprintf( packagepath, sizeof(packagepath),
-         "?.lua;"LUA_INCLUDE_PATH"?.lua" );
-   lua_pushstring(naevL, packagepath);
-   lua_setfield(naevL, -2, "path");
-   lua_pushstring(naevL, "");
-   lua_setfield(naevL, -2, "cpath");
-   lua_pop(naevL,1);
-
    /* Some code expect _G to be it's global state, so don't inherit it */
    lua_pushvalue(naevL, -1);
    lua_setfield(naevL, -2, "_G");
@@ -310,7 +515,176 @@ void nlua_register(nlua_env env, const char *libname,
 
 
 /**
- * @brief Wrapper around luaL_newstate.
+ * @brief Gets a small block of a size class.
+ *
+ *    @param c Size class of the block.
+ *    @return The block or NULL if out of memory.
+ */
+static void *nlua_poolGet( int c )
+{
+   NluaBlock *b;
+   size_t size;
+
+   nlua_astats.pooled++;
+   b = nlua_poolFree[c];
+   if (b != NULL) {
+      nlua_poolFree[c] = b->next;
+      nlua_astats.reused++;
+      return b;
+   }
+
+   /* Carve it out of the current slab, the rest of a full one is lost. */
+   size = (size_t)(c+1) * NLUA_POOL_GRAIN;
+   if (nlua_poolLeft < size) {
+      nlua_poolCur = malloc( NLUA_POOL_SLAB );
+      if (nlua_poolCur == NULL) {
+         nlua_poolLeft = 0;
+         return NULL;
+      }
+      if (nlua_poolSlabs == NULL)
+         nlua_poolSlabs = array_create( char* );
+      array_push_back( &nlua_poolSlabs, nlua_poolCur );
+      nlua_poolLeft = NLUA_POOL_SLAB;
+      nlua_astats.slab_bytes += NLUA_POOL_SLAB;
+   }
+   b = (NluaBlock*) nlua_poolCur;
+   nlua_poolCur  += size;
+   nlua_poolLeft -= size;
+   return b;
+}
+
+
+/**
+ * @brief Returns a small block to the free list of its size class.
+ *
+ *    @param c Size class of the block.
+ *    @param ptr Block to return.
+ */
+static void nlua_poolPut( int c, void *ptr )
+{
+   NluaBlock *b = ptr;
+   b->next = nlua_poolFree[c];
+   nlua_poolFree[c] = b;
+}
+
+
+/**
+ * @brief Frees all the slabs, only once the state is closed.
+ */
+static void nlua_poolClear (void)
+{
+   int i;
+
+   for (i=0; i<array_size(nlua_poolSlabs); i++)
+      free( nlua_poolSlabs[i] );
+   array_free( nlua_poolSlabs );
+   nlua_poolSlabs = NULL;
+   nlua_poolCur   = NULL;
+   nlua_poolLeft  = 0;
+   memset( nlua_poolFree, 0, sizeof(nlua_poolFree) );
+   nlua_astats.slab_bytes = 0;
+
+   array_free( nlua_envMems );
+   nlua_envMems = NULL;
+}
+
+
+/**
+ * @brief Gets the memory counters of an environment, making room for them.
+ *
+ *    @param env Environment to get counters of.
+ *    @return The counters or NULL if out of memory.
+ */
+static NluaEnvMem *nlua_envMemGet( nlua_env env )
+{
+   int n;
+
+   if (nlua_envMems == NULL)
+      nlua_envMems = array_create( NluaEnvMem );
+   n = array_size( nlua_envMems );
+   if (env >= n) {
+      array_resize( &nlua_envMems, env+1 );
+      memset( &nlua_envMems[n], 0, (env+1-n) * sizeof(NluaEnvMem) );
+   }
+   return &nlua_envMems[env];
+}
+
+
+/**
+ * @brief Allocator of the Lua state.
+ *
+ * Blocks up to NLUA_POOL_MAX bytes come from the size class pools, larger
+ *  ones from the system. Lua always passes the size of existing blocks, so
+ *  it tells where a block came from without any header. The memory in use is
+ *  counted, and new memory is attributed to the environment running.
+ */
+static void *nlua_alloc( void *ud, void *ptr, size_t osize, size_t nsize )
+{
+   void *p;
+   int oc, nc;
+   NluaEnvMem *mem;
+   (void) ud;
+
+   /* osize is only meaningful for existing blocks. */
+   if (ptr == NULL)
+      osize = 0;
+   oc = ((ptr != NULL) && (osize <= NLUA_POOL_MAX)) ? NLUA_POOL_CLASS(osize) : -1;
+
+   if (nsize == 0) {
+      if (ptr != NULL) {
+         memtrack_free( MEMTRACK_LUA, osize );
+         if (oc >= 0)
+            nlua_poolPut( oc, ptr );
+         else
+            free( ptr );
+      }
+      return NULL;
+   }
+   nc = (nsize <= NLUA_POOL_MAX) ? NLUA_POOL_CLASS(nsize) : -1;
+
+   /* The old block is left untouched if anything fails. */
+   if ((ptr != NULL) && (oc >= 0) && (oc == nc))
+      p = ptr;
+   else if (nc >= 0) {
+      p = nlua_poolGet( nc );
+      if (p == NULL)
+         return NULL;
+      if (ptr != NULL) {
+         memcpy( p, ptr, MIN( osize, nsize ) );
+         if (oc >= 0)
+            nlua_poolPut( oc, ptr );
+         else
+            free( ptr );
+      }
+   }
+   else if (oc < 0) {
+      p = realloc( ptr, nsize );
+      if (p == NULL)
+         return NULL;
+      nlua_astats.large++;
+   }
+   else {
+      p = malloc( nsize );
+      if (p == NULL)
+         return NULL;
+      memcpy( p, ptr, osize );
+      nlua_poolPut( oc, ptr );
+      nlua_astats.large++;
+   }
+
+   memtrack_free( MEMTRACK_LUA, osize );
+   memtrack_alloc( MEMTRACK_LUA, nsize );
+   if ((nsize > osize) && (__NLUA_CURENV >= 0)) {
+      mem = nlua_envMemGet( __NLUA_CURENV );
+      mem->bytes += nsize - osize;
+      mem->allocs++;
+   }
+   return p;
+}
+
+
+/**
+ * @brief Wrapper around lua_newstate.
  *
  *    @return A newly created lua_State.
  */
@@ -318,8 +692,12 @@ static lua_State *nlua_newState (void)
 {
    lua_State *L;
 
-   /* try to create the new state */
-   L = luaL_newstate();
+   /* try to create the new state, LuaJIT doesn't allow custom allocators on
+    * some 64 bit platforms so fall back to the default one. */
+   L = lua_newstate( nlua_alloc, NULL );
+   nlua_allocHooked = (L != NULL);
+   if (L == NULL)
+      L = luaL_newstate();
    if (L == NULL) {
       WARN(_("Failed to create new Lua state."));
       return NULL;
@@ -494,7 +872,7 @@ static int nlua_require( lua_State* L )
    }
 
    /* Try to process the Lua. */
-   if (luaL_loadbuffer(L, buf, bufsize, path_filename) != 0) {
+   if (nlua_loadbuffer(L, buf, bufsize, path_filename) != 0) {
       lua_error(L);
       return 1;
    }
@@ -561,8 +939,37 @@ static int nlua_require( lua_State* L )
  *    @return 0 on success.
  */
 int nlua_loadStandard( nlua_env env )
+{
+   if (nlua_stdMeta == LUA_NOREF)
+      nlua_stdRet = nlua_createStandard();
+
+   /* Inherit the libraries from the base environment. */
+   nlua_pushenv(env);                  /* env */
+   lua_rawgeti(naevL, LUA_REGISTRYINDEX, nlua_stdMeta); /* env, meta */
+   lua_setmetatable(naevL, -2);        /* env */
+   luaL_getmetatable(naevL, "naev");   /* env, naev */
+   lua_setfield(naevL, -2, "naev");    /* env */
+   lua_pop(naevL, 1);                  /* */
+
+   return nlua_stdRet;
+}
+
+
+/**
+ * @brief Creates the base environment holding the standard libraries.
+ *
+ * The libraries are the same for every environment, so instead of
+ *  registering them each time, environments get a metatable that looks
+ *  them up in the base environment, which in turn looks up the globals.
+ *
+ *    @return 0 on success.
+ */
+static int nlua_createStandard (void)
 {
    int r;
+   nlua_env env;
+
+   env = nlua_newEnv(0);
 
    r = 0;
    r |= nlua_loadNaev(env);
@@ -584,6 +991,22 @@ int nlua_loadStandard( nlua_env env )
    r |= nlua_loadFile(env);
    r |= nlua_loadData(env);
 
+   /* Only keep the libraries, the rest is per environment. */
+   nlua_pushenv(env);                  /* env */
+   lua_pushnil(naevL);                 /* env, nil */
+   lua_setfield(naevL, -2, "require"); /* env */
+   lua_pushnil(naevL);                 /* env, nil */
+   lua_setfield(naevL, -2, "_G");      /* env */
+   lua_pushnil(naevL);                 /* env, nil */
+   lua_setfield(naevL, -2, "__RW");    /* env */
+
+   /* Metatable to share with the environments. */
+   lua_newtable(naevL);                /* env, meta */
+   lua_insert(naevL, -2);              /* meta, env */
+   lua_setfield(naevL, -2, "__index"); /* meta */
+   nlua_stdMeta = luaL_ref(naevL, LUA_REGISTRYINDEX); /* */
+   nlua_freeEnv(env);
+
    return r;
 }
 
@@ -625,7 +1048,10 @@ int nlua_errTrace( lua_State *L )
  *    @param nresults Number of return values to take.
  */
 int nlua_pcall( nlua_env env, int nargs, int nresults ) {
-   int errf, ret, prev_env;
+   int errf, ret, prev_env, prof;
+   Uint64 t, ts;
+   double dt;
+   NluaProfEntry *e;
 
 #if DEBUGGING
    int top = lua_gettop(naevL);
@@ -636,13 +1062,39 @@ int nlua_pcall( nlua_env env, int nargs, int nresults ) {
    errf = 0;
 #endif /* DEBUGGING */
 
+   /* Find out what is being called before it is popped. */
+   if (lua_profEnabled) {
+      prof = nlua_profGet( -1-nargs );
+      t    = SDL_GetPerformanceCounter();
+   }
+   else {
+      prof = -1;
+      t    = 0;
+   }
+
    prev_env = __NLUA_CURENV;
    __NLUA_CURENV = env;
 
+   /* Only the outermost call counts towards the script time. */
+   ts = (nlua_pcallDepth++ == 0) ? SDL_GetPerformanceCounter() : 0;
+
    ret = lua_pcall(naevL, nargs, nresults, errf);
 
+   if (--nlua_pcallDepth == 0)
+      nlua_scriptTicks += SDL_GetPerformanceCounter() - ts;
+
    __NLUA_CURENV = prev_env;
 
+   /* May have been reset while running. */
+   if ((prof >= 0) && (prof < array_size(lua_prof))) {
+      dt = 1000. * (double)(SDL_GetPerformanceCounter() - t) /
+            (double)SDL_GetPerformanceFrequency();
+      e  = &lua_prof[prof];
+      e->calls++;
+      e->time += dt;
+      e->max   = MAX( e->max, dt );
+   }
+
 #if DEBUGGING
    lua_remove(naevL, top-nargs);
 #endif /* DEBUGGING */
@@ -666,3 +1118,386 @@ int nlua_refenv( nlua_env env, const char *name )
    lua_pop(naevL, 1);
    return LUA_NOREF;
 }
+
+
+/**
+ * @brief Gets the memory in use by the global Lua state in bytes.
+ */
+static double nlua_gcCount (void)
+{
+   return 1024. * (double)lua_gc(naevL, LUA_GCCOUNT, 0) +
+         (double)lua_gc(naevL, LUA_GCCOUNTB, 0);
+}
+
+
+/**
+ * @brief Runs incremental garbage collection steps on the global Lua state.
+ *
+ * Meant to be called once a frame with the time left before the next frame,
+ *  so garbage gets collected when there is time to spare instead of in the
+ *  middle of busy frames. The step size is adapted so that a step takes a
+ *  fraction of the budget, and cycles are only started once memory has grown
+ *  enough since the last one, so idle frames don't keep marking live data.
+ *  Cycles start before the automatic collector would, leaving it little to do.
+ *
+ *    @param spare Time to spare in the frame (s), 0 if unknown.
+ *    @return Time spent collecting (s).
+ */
+double nlua_gcStep( double spare )
+{
+   int done;
+   double budget, elapsed, dt, before, after, freq;
+   Uint64 t;
+
+   if (naevL == NULL)
+      return 0.;
+
+   /* See if there is anything to collect. */
+   before = nlua_gcCount();
+   if (!nlua_allocHooked)
+      memtrack_set( MEMTRACK_LUA, (size_t)before );
+   if (!gc_active) {
+      if (gc_base <= 0.)
+         gc_base = before;
+      if (before < NLUA_GC_GROWTH * gc_base) {
+         gc_stats.pause_last = 0.;
+         return 0.;
+      }
+      gc_active = 1;
+   }
+
+   if (spare > 0.)
+      budget = MIN( spare / 2., NLUA_GC_BUDGET_MAX );
+   else
+      budget = NLUA_GC_BUDGET_MIN;
+
+   freq    = (double)SDL_GetPerformanceFrequency();
+   elapsed = 0.;
+   do {
+      t    = SDL_GetPerformanceCounter();
+      done = lua_gc(naevL, LUA_GCSTEP, gc_stepsize);
+      dt   = (double)(SDL_GetPerformanceCounter() - t) / freq;
+      elapsed += dt;
+
+      /* Keep steps small with regards to the budget. */
+      if (dt < budget / 8.)
+         gc_stepsize = MIN( 2*gc_stepsize, NLUA_GC_STEP_MAX );
+      else if (dt > budget / 2.)
+         gc_stepsize = MAX( gc_stepsize/2, NLUA_GC_STEP_MIN );
+
+      if (done) {
+         gc_active = 0;
+         gc_stats.cycles++;
+         break;
+      }
+   } while (elapsed + dt < budget);
+
+   after = nlua_gcCount();
+   if (!gc_active)
+      gc_base = after;
+
+   gc_stats.collected += MAX( 0., before - after );
+   gc_stats.time      += elapsed;
+   gc_stats.pause_last = elapsed;
+   gc_stats.pause_max  = MAX( gc_stats.pause_max, elapsed );
+   return elapsed;
+}
+
+
+/**
+ * @brief Gets the statistics of the paced garbage collection.
+ *
+ *    @return The statistics.
+ */
+const NluaGCStats* nlua_gcStats (void)
+{
+   return &gc_stats;
+}
+
+
+/**
+ * @brief Gets the statistics of the allocator of the global Lua state.
+ *
+ *    @return The statistics, all zero if Lua uses its own allocator.
+ */
+const NluaAllocStats* nlua_allocStats (void)
+{
+   return &nlua_astats;
+}
+
+
+/**
+ * @brief Gets the memory allocated while an environment was running.
+ *
+ * Counts what was allocated by the environment since it was created,
+ *  including what has been collected since, so it shows which scripts churn
+ *  memory.
+ *
+ *    @param env Environment to get the memory of.
+ *    @param[out] mem Memory allocated by the environment.
+ *    @return 0 on success, -1 if unknown.
+ */
+int nlua_envMem( nlua_env env, NluaEnvMem *mem )
+{
+   if ((env < 0) || (env >= array_size(nlua_envMems))) {
+      memset( mem, 0, sizeof(NluaEnvMem) );
+      return -1;
+   }
+   *mem = nlua_envMems[env];
+   return 0;
+}
+
+
+/**
+ * @brief Gets the profiling entry of a function, creating it if needed.
+ *
+ *    @param func Stack index of the function.
+ *    @return Index of the entry in lua_prof.
+ */
+static int nlua_profGet( int func )
+{
+   lua_Debug ar;
+   char name[PATH_MAX];
+   int id;
+   NluaProfEntry *e;
+
+   if (!lua_isfunction(naevL, func))
+      snprintf( name, sizeof(name), "?" );
+   else {
+      lua_pushvalue(naevL, func);
+      lua_getinfo(naevL, ">S", &ar); /* Pops the function. */
+      if (ar.linedefined > 0)
+         snprintf( name, sizeof(name), "%s:%d", ar.short_src, ar.linedefined );
+      else
+         snprintf( name, sizeof(name), "%s", ar.short_src );
+   }
+
+   id = strindex_get( &lua_profIndex, name );
+   if (id >= 0)
+      return id;
+
+   if (lua_prof == NULL)
+      lua_prof = array_create( NluaProfEntry );
+   id = array_size( lua_prof );
+   e  = &array_grow( &lua_prof );
+   memset( e, 0, sizeof(NluaProfEntry) );
+   e->name = strdup( name );
+   strindex_add( &lua_profIndex, e->name, id );
+   return id;
+}
+
+
+/**
+ * @brief Starts or stops timing the Lua functions called from C.
+ *
+ * Every function run through nlua_pcall() (hooks, AI tasks, mission and event
+ *  functions...) gets its calls and time accumulated by the file and line it
+ *  is defined at. Time includes the nested calls.
+ *
+ *    @param enable Whether or not to time the calls.
+ */
+void nlua_profEnable( int enable )
+{
+   lua_profEnabled = enable;
+}
+
+
+/**
+ * @brief Checks to see if the Lua functions are being timed.
+ *
+ *    @return 1 if being timed.
+ */
+int nlua_profEnabled (void)
+{
+   return lua_profEnabled;
+}
+
+
+/**
+ * @brief Clears the Lua function timings.
+ */
+void nlua_profReset (void)
+{
+   int i;
+   for (i=0; i<array_size(lua_prof); i++)
+      free( lua_prof[i].name );
+   array_free( lua_prof );
+   lua_prof = NULL;
+   strindex_free( &lua_profIndex );
+}
+
+
+/**
+ * @brief Sorts by descending time.
+ */
+static int nlua_profCompare( const void *p1, const void *p2 )
+{
+   const NluaProfEntry *e1, *e2;
+   e1 = (const NluaProfEntry*) p1;
+   e2 = (const NluaProfEntry*) p2;
+   if (e1->time > e2->time)
+      return -1;
+   if (e1->time < e2->time)
+      return +1;
+   return strcmp( e1->name, e2->name );
+}
+
+
+/**
+ * @brief Gets the Lua function timings sorted by descending total time.
+ *
+ *    @return The timings (array.h), valid until the next Lua call. May be NULL.
+ */
+const NluaProfEntry* nlua_profSort (void)
+{
+   int i;
+
+   if (lua_prof == NULL)
+      return NULL;
+
+   qsort( lua_prof, array_size(lua_prof), sizeof(NluaProfEntry), nlua_profCompare );
+   strindex_clear( &lua_profIndex );
+   for (i=0; i<array_size(lua_prof); i++)
+      strindex_add( &lua_profIndex, lua_prof[i].name, i );
+   return lua_prof;
+}
+
+
+/**
+ * @brief Writes the Lua function timings to a CSV file.
+ *
+ *    @param filename File to write to, relative to the write directory.
+ *    @return 0 on success.
+ */
+int nlua_profDump( const char *filename )
+{
+   int i;
+   char buf[STRMAX];
+   const NluaProfEntry *e;
+   PHYSFS_File *f;
+
+   f = PHYSFS_openWrite( filename );
+   if (f == NULL) {
+      WARN(_("Unable to open '%s' for writing: %s"), filename,
+            PHYSFS_getErrorByCode( PHYSFS_getLastErrorCode() ) );
+      return -1;
+   }
+
+   snprintf( buf, sizeof(buf), "function,calls,total_ms,avg_ms,max_ms\n" );
+   PHYSFS_writeBytes( f, buf, strlen(buf) );
+   nlua_profSort();
+   for (i=0; i<array_size(lua_prof); i++) {
+      e = &lua_prof[i];
+      snprintf( buf, sizeof(buf), "\"%s\",%u,%.3f,%.4f,%.3f\n", e->name,
+            e->calls, e->time, e->time / MAX( 1, e->calls ), e->max );
+      PHYSFS_writeBytes( f, buf, strlen(buf) );
+   }
+
+   PHYSFS_close( f );
+   return 0;
+}
+
+
+/**
+ * @brief Pushes the interning cache table, creating it if needed.
+ *
+ * Caches are weak valued tables in the registry, so the userdata in them
+ *  are still collected once no script references them.
+ *
+ *    @param L Lua state.
+ *    @param cache Name of the cache in the registry.
+ */
+static void nlua_internCache( lua_State *L, const char *cache )
+{
+   lua_getfield( L, LUA_REGISTRYINDEX, cache );
+   if (!lua_isnil( L, -1 ))
+      return;
+   lua_pop( L, 1 );
+   lua_newtable( L );
+   lua_newtable( L );
+   lua_pushstring( L, "v" );
+   lua_setfield( L, -2, "__mode" );
+   lua_setmetatable( L, -2 );
+   lua_pushvalue( L, -1 );
+   lua_setfield( L, LUA_REGISTRYINDEX, cache );
+}
+
+
+/**
+ * @brief Pushes the userdata interned for an object if there is one.
+ *
+ * Pushing the same object repeatedly then reuses a single userdata instead of
+ *  allocating a new one each time, which also makes them usable as table keys.
+ *
+ *    @param L Lua state.
+ *    @param cache Name of the cache in the registry.
+ *    @param key Identifier of the object.
+ *    @return 1 if the userdata was pushed, 0 if nothing was pushed.
+ */
+int nlua_internGet( lua_State *L, const char *cache, uintptr_t key )
+{
+   nlua_internCache( L, cache );
+   lua_pushlightuserdata( L, (void*)key );
+   lua_rawget( L, -2 );
+   if (lua_isnil( L, -1 )) {
+      lua_pop( L, 2 );
+      return 0;
+   }
+   lua_remove( L, -2 );
+   return 1;
+}
+
+
+/**
+ * @brief Interns the userdata at the top of the stack, leaving it there.
+ *
+ *    @param L Lua state.
+ *    @param cache Name of the cache in the registry.
+ *    @param key Identifier of the object.
+ */
+void nlua_internSet( lua_State *L, const char *cache, uintptr_t key )
+{
+   nlua_internCache( L, cache );
+   lua_pushlightuserdata( L, (void*)key );
+   lua_pushvalue( L, -3 );
+   lua_rawset( L, -3 );
+   lua_pop( L, 1 );
+}
+
+
+/**
+ * @brief Forgets the userdata interned for an object that no longer exists.
+ *
+ *    @param L Lua state.
+ *    @param cache Name of the cache in the registry.
+ *    @param key Identifier of the object.
+ */
+void nlua_internRemove( lua_State *L, const char *cache, uintptr_t key )
+{
+   if (L == NULL)
+      return;
+   lua_getfield( L, LUA_REGISTRYINDEX, cache );
+   if (!lua_isnil( L, -1 )) {
+      lua_pushlightuserdata( L, (void*)key );
+      lua_pushnil( L );
+      lua_rawset( L, -3 );
+   }
+   lua_pop( L, 1 );
+}
+
+
+/**
+ * @brief Gets the time spent running scripts through nlua_pcall().
+ *
+ * Nested calls are only counted once. The time is reset every time it is
+ *  read, so calling it once per frame gives the script time of the frame.
+ *
+ *    @return Time spent in scripts since the last call (ms).
+ */
+double nlua_scriptTime (void)
+{
+   double ms = 1000. * (double)nlua_scriptTicks /
+         (double)SDL_GetPerformanceFrequency();
+   nlua_scriptTicks = 0;
+   return ms;
+}
@@ -10,6 +10,7 @@
 /** @cond */
 #include <lua.h>
 #include <lauxlib.h>
+#include <stdint.h>
 /** @endcond */
 
 
@@ -23,6 +24,46 @@
 
 
 typedef int nlua_env;
+
+/**
+ * @brief Statistics of the paced garbage collection of the global Lua state.
+ */
+typedef struct NluaGCStats_ {
+   double collected; /**< Bytes freed by paced steps. */
+   double time; /**< Total time spent in paced steps (s). */
+   double pause_last; /**< Time spent collecting in the last frame (s). */
+   double pause_max; /**< Longest time spent collecting in a frame (s). */
+   unsigned int cycles; /**< Collection cycles completed by paced steps. */
+} NluaGCStats;
+
+/**
+ * @brief Statistics of the allocator of the global Lua state.
+ */
+typedef struct NluaAllocStats_ {
+   size_t slab_bytes; /**< Memory held by the slabs small blocks come from. */
+   unsigned int pooled; /**< Small blocks handed out. */
+   unsigned int reused; /**< Small blocks that came from a free list. */
+   unsigned int large; /**< Blocks too large to pool, left to the system. */
+} NluaAllocStats;
+
+/**
+ * @brief Memory allocated while an environment was running.
+ */
+typedef struct NluaEnvMem_ {
+   size_t bytes; /**< Bytes allocated. */
+   unsigned int allocs; /**< Number of allocations. */
+} NluaEnvMem;
+
+/**
+ * @brief Time spent in a Lua function called through nlua_pcall().
+ */
+typedef struct NluaProfEntry_ {
+   char *name; /**< Source of the function and the line it is defined at. */
+   unsigned int calls; /**< Number of calls. */
+   double time; /**< Total time, including nested calls (ms). */
+   double max; /**< Longest call (ms). */
+} NluaProfEntry;
+
 extern lua_State *naevL;
 extern nlua_env __NLUA_CURENV;
 
@@ -48,5 +89,34 @@ int nlua_errTrace( lua_State *L );
 int nlua_pcall( nlua_env env, int nargs, int nresults );
 int nlua_refenv( nlua_env env, const char *name );
 
+/*
+ * Userdata interning.
+ */
+int nlua_internGet( lua_State *L, const char *cache, uintptr_t key );
+void nlua_internSet( lua_State *L, const char *cache, uintptr_t key );
+void nlua_internRemove( lua_State *L, const char *cache, uintptr_t key );
+
+/*
+ * Script profiling.
+ */
+void nlua_profEnable( int enable );
+int nlua_profEnabled (void);
+void nlua_profReset (void);
+const NluaProfEntry* nlua_profSort (void);
+int nlua_profDump( const char *filename );
+double nlua_scriptTime (void);
+
+/*
+ * Memory.
+ */
+const NluaAllocStats* nlua_allocStats (void);
+int nlua_envMem( nlua_env env, NluaEnvMem *mem );
+
+/*
+ * Garbage collection pacing.
+ */
+double nlua_gcStep( double spare );
+const NluaGCStats* nlua_gcStats (void);
+
 
 #endif /* NLUA_H */
@@ -16,15 +16,25 @@
 
 #include "nlua_canvas.h"
 
+#include "array.h"
 #include "log.h"
 #include "nluadef.h"
 #include "nlua_tex.h"
 #include "nlua_col.h"
 
 
+#define CANVAS_POOL_MAX    16 /**< Most unused canvases kept around to be reused. */
+
+
 static int nlua_canvas_counter = 0;
 static GLuint previous_fbo = 0;
 static int previous_fbo_set = 0;
+static GLint previous_viewport[4]; /**< Viewport to restore when unsetting the canvas. */
+static LuaCanvas_t *canvas_pool = NULL; /**< Unused canvases that can be reused (array.h). */
+
+
+static int canvas_poolTake( LuaCanvas_t *lc, int w, int h );
+static void canvas_free( LuaCanvas_t *lc );
 
 
 /* Canvas metatable methods. */
@@ -139,13 +149,74 @@ int lua_iscanvas( lua_State *L, int ind )
 static int canvasL_gc( lua_State *L )
 {
    LuaCanvas_t *lc = luaL_checkcanvas(L,1);
+
+   /* Texture is still used elsewhere through getTex, can't be reused. */
+   if ((gl_texRefs( lc->tex ) > 1) || (array_size(canvas_pool) >= CANVAS_POOL_MAX)) {
+      canvas_free( lc );
+      return 0;
+   }
+
+   if (canvas_pool == NULL)
+      canvas_pool = array_create( LuaCanvas_t );
+   array_push_back( &canvas_pool, *lc );
+   return 0;
+}
+
+
+/**
+ * @brief Frees a canvas' frame buffer and texture.
+ */
+static void canvas_free( LuaCanvas_t *lc )
+{
    glDeleteFramebuffers( 1, &lc->fbo );
    gl_freeTexture( lc->tex );
    gl_checkErr();
+}
+
+
+/**
+ * @brief Takes an unused canvas of a size from the pool.
+ *
+ *    @param[out] lc Where to store the canvas.
+ *    @param w Width of the canvas.
+ *    @param h Height of the canvas.
+ *    @return 1 if a canvas was found.
+ */
+static int canvas_poolTake( LuaCanvas_t *lc, int w, int h )
+{
+   int i, n;
+
+   n = array_size(canvas_pool);
+   for (i=0; i<n; i++) {
+      if (((int)canvas_pool[i].tex->w != w) || ((int)canvas_pool[i].tex->h != h))
+         continue;
+      *lc = canvas_pool[i];
+      canvas_pool[i] = canvas_pool[n-1];
+      array_resize( &canvas_pool, n-1 );
+
+      /* Undo anything done through getTex before it was freed. */
+      gl_texResetParameters( lc->tex );
+      glBindFramebuffer(GL_FRAMEBUFFER, lc->fbo);
+      return 1;
+   }
    return 0;
 }
 
 
+/**
+ * @brief Frees the unused canvases, has to be done before OpenGL exits.
+ */
+void nlua_canvasPoolFree (void)
+{
+   int i;
+
+   for (i=0; i<array_size(canvas_pool); i++)
+      canvas_free( &canvas_pool[i] );
+   array_free( canvas_pool );
+   canvas_pool = NULL;
+}
+
+
 /**
  * @brief Compares two canvass to see if they are the same.
  *
@@ -184,6 +255,16 @@ static int canvasL_new( lua_State *L )
 
    memset( &lc, 0, sizeof(LuaCanvas_t) );
 
+   /* Reuse an old canvas if possible, GUIs tend to create the same ones over
+    * and over. */
+   if (canvas_poolTake( &lc, w, h )) {
+      glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+      glBindFramebuffer(GL_FRAMEBUFFER, gl_screen.current_fbo);
+      gl_checkErr();
+      lua_pushcanvas( L, lc );
+      return 1;
+   }
+
    /* Create the texture. */
    asprintf( &name, "nlua_canvas_%03d", ++nlua_canvas_counter );
    lc.tex = gl_loadImageData( NULL, w, h, 1, 1, name );
@@ -229,6 +310,7 @@ static int canvasL_set( lua_State *L )
       lc = luaL_checkcanvas(L,1);
       if (!previous_fbo_set) {
          previous_fbo = gl_screen.current_fbo;
+         glGetIntegerv( GL_VIEWPORT, previous_viewport );
          previous_fbo_set = 1;
       }
       gl_screen.current_fbo = lc->fbo;
@@ -238,9 +320,14 @@ static int canvasL_set( lua_State *L )
    }
    else if ((lua_gettop(L)<=0) || lua_isnil(L,1)) {
       gl_screen.current_fbo = previous_fbo;
-      previous_fbo_set = 0;
       glEnable(GL_SCISSOR_TEST);
-      glViewport( 0, 0, gl_screen.rw, gl_screen.rh );
+      /* The game layer may be drawn at a lower resolution. */
+      if (previous_fbo_set)
+         glViewport( previous_viewport[0], previous_viewport[1],
+               previous_viewport[2], previous_viewport[3] );
+      else
+         glViewport( 0, 0, gl_screen.rw, gl_screen.rh );
+      previous_fbo_set = 0;
       glBindFramebuffer(GL_FRAMEBUFFER, gl_screen.current_fbo);
    }
    else
@@ -32,6 +32,7 @@ typedef struct LuaCanvas_s {
  * Library loading
  */
 int nlua_loadCanvas( nlua_env env );
+void nlua_canvasPoolFree (void);
 
 /* Basic operations. */
 LuaCanvas_t* lua_tocanvas( lua_State *L, int ind );
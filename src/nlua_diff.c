@@ -67,15 +67,38 @@ int nlua_loadDiff( nlua_env env )
 /**
  * @brief Applies a diff by name.
  *
- *    @luatparam string name Name of the diff to apply.
+ * A table of names can be given to apply many diffs at once, which only
+ *  updates the universe once at the end.
+ *
+ * @usage diff.apply( "collective_dead" )
+ * @usage diff.apply( { "collective_dead", "collective_outposts" } )
+ *
+ *    @luatparam string|table name Name of the diff to apply, or table of names.
  * @luafunc apply
  */
 static int diff_applyL( lua_State *L )
 {
+   int i, n;
    const char *name;
 
    NLUA_CHECKRW(L);
 
+   if (lua_istable(L,1)) {
+      n = lua_objlen(L,1);
+      diff_batchStart();
+      for (i=1; i<=n; i++) {
+         lua_rawgeti(L,1,i);
+         name = lua_tostring(L,-1);
+         if (name != NULL)
+            diff_apply( name );
+         else
+            WARN(_("diff.apply: element %d of the table is not a string!"), i);
+         lua_pop(L,1);
+      }
+      diff_batchEnd();
+      return 0;
+   }
+
    name = luaL_checkstring(L,1);
 
    diff_apply( name );
@@ -84,15 +107,35 @@ static int diff_applyL( lua_State *L )
 /**
  * @brief Removes a diff by name.
  *
- *    @luatparam string name Name of the diff to remove.
+ * A table of names can be given to remove many diffs at once, which only
+ *  updates the universe once at the end.
+ *
+ *    @luatparam string|table name Name of the diff to remove, or table of names.
  * @luafunc remove
  */
 static int diff_removeL( lua_State *L )
 {
+   int i, n;
    const char *name;
 
    NLUA_CHECKRW(L);
 
+   if (lua_istable(L,1)) {
+      n = lua_objlen(L,1);
+      diff_batchStart();
+      for (i=1; i<=n; i++) {
+         lua_rawgeti(L,1,i);
+         name = lua_tostring(L,-1);
+         if (name != NULL)
+            diff_remove( name );
+         else
+            WARN(_("diff.remove: element %d of the table is not a string!"), i);
+         lua_pop(L,1);
+      }
+      diff_batchEnd();
+      return 0;
+   }
+
    name = luaL_checkstring(L,1);
 
    diff_remove( name );
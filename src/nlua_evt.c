@@ -85,6 +85,8 @@ void event_setupLua( Event_t *ev, const char *func )
 {
    Event_t **evptr;
 
+   event_wake( ev );
+
    /* Set up event pointer. */
    evptr = lua_newuserdata( naevL, sizeof(Event_t*) );
    *evptr = ev;
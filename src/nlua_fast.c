@@ -0,0 +1,228 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+
+/**
+ * @file nlua_fast.c
+ *
+ * @brief Fast read-only numeric accessors for the AI.
+ *
+ * The AI reads the positions, velocities and health of pilots all the time,
+ *  and each of those goes through luaL_check* calls and creates vec2 that
+ *  LuaJIT can't compile traces across. The "fast" table gives the same
+ *  information as plain numbers. When running under LuaJIT with the FFI the
+ *  functions read vec2 directly and get the pilot state with a single FFI
+ *  call, otherwise they fall back to the classic API so scripts can use them
+ *  regardless of the Lua in use.
+ *
+ * Functions in the table, where pilots and positions can be either a Pilot
+ *  or a Vec2:
+ *
+ *  - fast.pos( p ): x, y of the pilot.
+ *  - fast.vel( p ): x, y of the velocity of the pilot.
+ *  - fast.dir( p ): direction of the pilot in degrees.
+ *  - fast.health( p ): armour, shield, stress and disabled like p:health().
+ *  - fast.vec( v ): x, y of a vector.
+ *  - fast.dist( a, b ): distance between two positions.
+ *  - fast.dist2( a, b ): squared distance between two positions.
+ *  - fast.polar( a, b ): modulus and angle in degrees of b - a.
+ */
+
+/** @cond */
+#include <math.h>
+
+#include "naev.h"
+/** @endcond */
+
+#include "nlua_fast.h"
+
+#include "log.h"
+#include "nlua_pilot.h"
+#include "nlua_vec2.h"
+#include "nluadef.h"
+#include "pilot.h"
+
+
+#define FAST_REGISTRY   "nlua_fast" /**< Registry field holding the built table. */
+
+
+#if HAVE_LUAJIT
+/**
+ * @brief Builds the table using the FFI, returns nil if unavailable.
+ */
+static const char fast_ffi[] =
+"local pilot_mt, vec2_mt = ...\n"
+"local ok, ffi = pcall( require, 'ffi' )\n"
+"if not ok then return nil end\n"
+"ffi.cdef[[\n"
+"typedef struct NluaFastPilot_ {\n"
+"   double x, y, vx, vy, dir, armour, shield, stress;\n"
+"   int disabled;\n"
+"} NluaFastPilot;\n"
+"int naev_fastPilot( unsigned int id, NluaFastPilot *out );\n"
+"]]\n"
+"local C = ffi.C\n"
+"if not pcall( function () return C.naev_fastPilot end ) then return nil end\n"
+"local getmetatable, error, sqrt, atan2, deg = getmetatable, error, math.sqrt, math.atan2, math.deg\n"
+"local uintp = ffi.typeof( 'const unsigned int*' )\n"
+"local dblp  = ffi.typeof( 'const double*' )\n"
+"local st    = ffi.new( 'NluaFastPilot' )\n"
+"local function get( p )\n"
+"   if getmetatable( p ) ~= pilot_mt then error( 'Pilot expected' ) end\n"
+"   if C.naev_fastPilot( ffi.cast( uintp, p )[0], st ) == 0 then error( 'Pilot is invalid' ) end\n"
+"   return st\n"
+"end\n"
+"local function xy( o )\n"
+"   if getmetatable( o ) == vec2_mt then\n"
+"      local d = ffi.cast( dblp, o )\n"
+"      return d[0], d[1]\n"
+"   end\n"
+"   local s = get( o )\n"
+"   return s.x, s.y\n"
+"end\n"
+"local fast = {}\n"
+"function fast.pos( p ) local s = get( p ); return s.x, s.y end\n"
+"function fast.vel( p ) local s = get( p ); return s.vx, s.vy end\n"
+"function fast.dir( p ) return get( p ).dir end\n"
+"function fast.health( p )\n"
+"   local s = get( p )\n"
+"   return s.armour, s.shield, s.stress, s.disabled ~= 0\n"
+"end\n"
+"function fast.vec( v )\n"
+"   if getmetatable( v ) ~= vec2_mt then error( 'Vec2 expected' ) end\n"
+"   local d = ffi.cast( dblp, v )\n"
+"   return d[0], d[1]\n"
+"end\n"
+"function fast.dist2( a, b )\n"
+"   local ax, ay = xy( a )\n"
+"   local bx, by = xy( b )\n"
+"   local dx, dy = bx-ax, by-ay\n"
+"   return dx*dx + dy*dy\n"
+"end\n"
+"function fast.dist( a, b ) return sqrt( fast.dist2( a, b ) ) end\n"
+"function fast.polar( a, b )\n"
+"   local ax, ay = xy( a )\n"
+"   local bx, by = xy( b )\n"
+"   local dx, dy = bx-ax, by-ay\n"
+"   return sqrt( dx*dx + dy*dy ), deg( atan2( dy, dx ) )\n"
+"end\n"
+"return fast\n";
+#endif /* HAVE_LUAJIT */
+
+
+/**
+ * @brief Builds the table with the classic API.
+ */
+static const char fast_classic[] =
+"local pilot_mt, vec2_mt = ...\n"
+"local getmetatable = getmetatable\n"
+"local function pos( o )\n"
+"   if getmetatable( o ) == vec2_mt then return o end\n"
+"   return o:pos()\n"
+"end\n"
+"local fast = {}\n"
+"function fast.pos( p ) return p:pos():get() end\n"
+"function fast.vel( p ) return p:vel():get() end\n"
+"function fast.dir( p ) return p:dir() end\n"
+"function fast.health( p ) return p:health() end\n"
+"function fast.vec( v ) return v:get() end\n"
+"function fast.dist2( a, b ) return pos( a ):dist2( pos( b ) ) end\n"
+"function fast.dist( a, b ) return pos( a ):dist( pos( b ) ) end\n"
+"function fast.polar( a, b ) return (pos( b ) - pos( a )):polar() end\n"
+"return fast\n";
+
+
+/*
+ * Prototypes.
+ */
+static int fast_build( const char *buf, size_t len, const char *name );
+
+
+/**
+ * @brief Runs a chunk building the table, leaving the result on the stack.
+ *
+ *    @param buf Chunk to run.
+ *    @param len Length of the chunk.
+ *    @param name Name of the chunk.
+ *    @return 0 on success.
+ */
+static int fast_build( const char *buf, size_t len, const char *name )
+{
+   if (luaL_loadbuffer( naevL, buf, len, name ) != 0) {
+      WARN(_("Unable to load '%s': %s"), name, lua_tostring(naevL,-1));
+      lua_pop(naevL, 1);
+      lua_pushnil(naevL);
+      return -1;
+   }
+   luaL_getmetatable(naevL, PILOT_METATABLE);
+   luaL_getmetatable(naevL, VECTOR_METATABLE);
+   if (lua_pcall( naevL, 2, 1, 0 ) != 0) {
+      WARN(_("Unable to run '%s': %s"), name, lua_tostring(naevL,-1));
+      lua_pop(naevL, 1);
+      lua_pushnil(naevL);
+      return -1;
+   }
+   return 0;
+}
+
+
+/**
+ * @brief Loads the fast accessors into an environment.
+ *
+ * The pilot and vec2 libraries have to be loaded already, so their
+ *  metatables exist.
+ *
+ *    @param env Environment to load into.
+ *    @return 0 on success.
+ */
+int nlua_loadFast( nlua_env env )
+{
+   /* The table is shared between all the environments. */
+   lua_getfield(naevL, LUA_REGISTRYINDEX, FAST_REGISTRY); /* fast */
+   if (lua_isnil(naevL, -1)) {
+      lua_pop(naevL, 1);                                 /* */
+#if HAVE_LUAJIT
+      fast_build( fast_ffi, sizeof(fast_ffi)-1, "=fast_ffi" ); /* fast */
+      if (lua_isnil(naevL, -1)) {
+         lua_pop(naevL, 1);                              /* */
+         DEBUG(_("LuaJIT FFI unavailable, using classic accessors."));
+         fast_build( fast_classic, sizeof(fast_classic)-1, "=fast" );
+      }
+#else /* HAVE_LUAJIT */
+      fast_build( fast_classic, sizeof(fast_classic)-1, "=fast" ); /* fast */
+#endif /* HAVE_LUAJIT */
+      if (lua_isnil(naevL, -1)) {
+         lua_pop(naevL, 1);                              /* */
+         return -1;
+      }
+      lua_pushvalue(naevL, -1);                          /* fast, fast */
+      lua_setfield(naevL, LUA_REGISTRYINDEX, FAST_REGISTRY); /* fast */
+   }
+   nlua_setenv(env, "fast");                             /* */
+   return 0;
+}
+
+
+/**
+ * @brief Gets the state of a pilot for the FFI accessors.
+ *
+ *    @param id ID of the pilot.
+ *    @param[out] out State of the pilot.
+ *    @return 1 if the pilot exists, 0 otherwise.
+ */
+NLUA_FAST_API int naev_fastPilot( unsigned int id, NluaFastPilot *out )
+{
+   Pilot *p = pilot_get( id );
+   if (p == NULL)
+      return 0;
+   out->x      = p->solid->pos.x;
+   out->y      = p->solid->pos.y;
+   out->vx     = p->solid->vel.x;
+   out->vy     = p->solid->vel.y;
+   out->dir    = p->solid->dir * 180. / M_PI;
+   out->armour = (p->armour_max > 0.) ? p->armour / p->armour_max * 100. : 0.;
+   out->shield = (p->shield_max > 0.) ? p->shield / p->shield_max * 100. : 0.;
+   out->stress = MIN( 1., p->stress / p->armour ) * 100.;
+   out->disabled = pilot_isDisabled(p);
+   return 1;
+}
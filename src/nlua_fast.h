@@ -0,0 +1,47 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+
+
+#ifndef NLUA_FAST_H
+#  define NLUA_FAST_H
+
+
+#include "nlua.h"
+
+
+/**
+ * @brief Marks functions that LuaJIT looks up in the executable.
+ */
+#if WIN32
+#define NLUA_FAST_API   __declspec(dllexport)
+#else /* WIN32 */
+#define NLUA_FAST_API   __attribute__((visibility("default")))
+#endif /* WIN32 */
+
+
+/**
+ * @brief State of a pilot as read through the FFI.
+ *
+ * Must match the declaration given to ffi.cdef in nlua_fast.c.
+ */
+typedef struct NluaFastPilot_ {
+   double x; /**< X position. */
+   double y; /**< Y position. */
+   double vx; /**< X velocity. */
+   double vy; /**< Y velocity. */
+   double dir; /**< Direction in degrees. */
+   double armour; /**< Armour in % [0:100]. */
+   double shield; /**< Shield in % [0:100]. */
+   double stress; /**< Stress in % [0:100]. */
+   int disabled; /**< Whether the pilot is disabled. */
+} NluaFastPilot;
+
+
+int nlua_loadFast( nlua_env env );
+
+/* Called from LuaJIT code only. */
+NLUA_FAST_API int naev_fastPilot( unsigned int id, NluaFastPilot *out );
+
+
+#endif /* NLUA_FAST_H */
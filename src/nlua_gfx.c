@@ -299,7 +299,7 @@ static int gfxL_renderTexH( lua_State *L )
    col   = luaL_optcolour(L,4,&cWhite);
    TH    = luaL_opttransform( L,5,&ID );
 
-   glUseProgram( shader->program );
+   gl_useProgram( shader->program );
 
    /* Set the vertex. */
    glEnableVertexAttribArray( shader->VertexPosition );
@@ -314,23 +314,24 @@ static int gfxL_renderTexH( lua_State *L )
             0, 2, GL_FLOAT, 0 );
    }
 
-   /* Set the texture(s). */
-   glBindTexture( GL_TEXTURE_2D, t->texture );
+   /* Set the texture(s), shaders may keep using it. */
+   gl_texPin( t );
+   gl_bindTexture( GL_TEXTURE_2D, t->texture );
    glUniform1i( shader->MainTex, 0 );
    for (int i=0; i<array_size(shader->tex); i++) {
       LuaTexture_t *t = &shader->tex[i];
-      glActiveTexture( t->active );
-      glBindTexture( GL_TEXTURE_2D, t->texid );
+      gl_activeTexture( t->active );
+      gl_bindTexture( GL_TEXTURE_2D, t->texid );
       glUniform1i( t->uniform, t->value );
    }
-   glActiveTexture( GL_TEXTURE0 );
+   gl_activeTexture( GL_TEXTURE0 );
 
    /* Set shader uniforms. */
    gl_uniformColor( shader->ConstantColor, col );
    gl_Matrix4_Uniform( shader->ClipSpaceFromLocal, *H );
 
    /* Draw. */
-   glDrawArrays( GL_TRIANGLE_STRIP, 0, 4 );
+   gl_drawArrays( GL_TRIANGLE_STRIP, 0, 4 );
 
    /* Clear state. */
    glDisableVertexAttribArray( shader->VertexPosition );
@@ -340,7 +341,7 @@ static int gfxL_renderTexH( lua_State *L )
    /* anything failed? */
    gl_checkErr();
 
-   glUseProgram(0);
+   gl_useProgram(0);
 
    return 0;
 }
@@ -853,7 +854,7 @@ static int gfxL_setBlendMode( lua_State *L )
       NLUA_INVALID_PARAMETER(L);
 
    glBlendEquation(func);
-   glBlendFuncSeparate(srcRGB, dstRGB, srcA, dstA);
+   gl_blendFuncSeparate(srcRGB, dstRGB, srcA, dstA);
    gl_checkErr();
 
    return 0;
@@ -41,6 +41,7 @@ static int guiL_mouseMoveEnable( lua_State *L );
 static int guiL_menuInfo( lua_State *L );
 static int guiL_menuSmall( lua_State *L );
 static int guiL_setMapOverlayBounds( lua_State *L );
+static int guiL_staticDirty( lua_State *L );
 static const luaL_Reg guiL_methods[] = {
    { "viewport", guiL_viewport },
    { "fpsPos", guiL_fpsPos },
@@ -56,6 +57,7 @@ static const luaL_Reg guiL_methods[] = {
    { "menuInfo", guiL_menuInfo },
    { "menuSmall", guiL_menuSmall },
    { "setMapOverlayBounds", guiL_setMapOverlayBounds },
+   { "staticDirty", guiL_staticDirty },
    {0,0}
 }; /**< GUI methods. */
 
@@ -451,3 +453,22 @@ static int guiL_setMapOverlayBounds( lua_State *L )
    return 0;
 }
 
+
+/**
+ * @brief Makes the GUI draw its static layer again.
+ *
+ * The static layer is what the GUI draws in its render_static function. It
+ *  is only drawn again when the player's ship, target, cargo, navigation,
+ *  system or faction standings change, so GUIs showing anything else in it
+ *  have to call this when it changes.
+ *
+ * @usage gui.staticDirty()
+ *
+ * @luafunc staticDirty
+ */
+static int guiL_staticDirty( lua_State *L )
+{
+   (void) L;
+   gui_staticDirty();
+   return 0;
+}
@@ -765,15 +765,36 @@ static int hook_safe( lua_State *L )
  * The current delta-tick (time passed in game) and real delta-tick (independent of game status) are passed as parameters:<br/>
  * function f( dt, real_dt, args )
  *
+ * Most of the time there is no need to check something every frame, so an
+ *  interval in seconds can be given first. The hook then runs at most once
+ *  per interval, and the times passed are those since its last run.
+ *
+ * @usage hook.update( "my_update" ) -- Runs every frame
+ * @usage hook.update( 0.5, "my_update" ) -- Runs twice per second of game time
+ * @usage hook.update( 1, "my_update", nil, true ) -- Runs once per second of real time
+ *
+ *    @luatparam[opt] number interval Seconds between runs, runs every frame if omitted.
  *    @luatparam string funcname Name of function to run when hook is triggered.
  *    @luaparam arg Argument to pass to hook.
+ *    @luatparam[opt=false] boolean real Whether the interval is in real time instead of game time.
  *    @luatreturn number Hook identifier.
  * @luafunc update
  */
 static int hook_update( lua_State *L )
 {
    unsigned int h;
-   h = hook_generic( L, "update", 0., 1, 0 );
+   double interval;
+
+   if (lua_type( L, 1 ) != LUA_TNUMBER) {
+      h = hook_generic( L, "update", 0., 1, 0 );
+      lua_pushnumber( L, h );
+      return 1;
+   }
+
+   interval = lua_tonumber( L, 1 );
+   h = hook_generic( L, "update", 0., 2, 0 );
+   if (h != 0)
+      hook_setInterval( h, interval, lua_toboolean( L, 4 ) );
    lua_pushnumber( L, h );
    return 1;
 }
@@ -822,6 +843,7 @@ static int hook_renderfg( lua_State *L )
  *    <li> "hail" : triggered when pilot is hailed.</li>
  *    <li> "land" : triggered when pilot is landing (right when starting land descent).</li>
  *    <li> "attacked" : triggered when the pilot is attacked. </li>
+ *    <li> "attackedbatch" : like "attacked" but triggered once per frame for each attacker, with the total damage done.</li>
  *    <li> "idle" : triggered when the pilot becomes idle in manual control.</li>
  *    <li> "lockon" : triggered when the pilot locked on a missile on it's target.</li>
  * </ul>
@@ -893,6 +915,7 @@ static int hook_pilot( lua_State *L )
    else if (strcmp(hook_type,"hail")==0)     type = PILOT_HOOK_HAIL;
    else if (strcmp(hook_type,"land")==0)     type = PILOT_HOOK_LAND;
    else if (strcmp(hook_type,"attacked")==0) type = PILOT_HOOK_ATTACKED;
+   else if (strcmp(hook_type,"attackedbatch")==0) type = PILOT_HOOK_ATTACKED_BATCH;
    else if (strcmp(hook_type,"idle")==0)     type = PILOT_HOOK_IDLE;
    else if (strcmp(hook_type,"lockon")==0)   type = PILOT_HOOK_LOCKON;
    else { /* hook_type not valid */
@@ -213,6 +213,7 @@ Mission* misn_getFromLua( lua_State *L )
 void misn_runStart( Mission *misn, const char *func )
 {
    Mission **misnptr;
+   mission_wake( misn );
    misnptr = lua_newuserdata( naevL, sizeof(Mission*) );
    *misnptr = misn;
    nlua_setenv( misn->env, "__misn" );
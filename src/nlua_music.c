@@ -26,6 +26,7 @@
 /* Music methods. */
 static int musicL_delay( lua_State* L );
 static int musicL_load( lua_State* L );
+static int musicL_prebuffer( lua_State* L );
 static int musicL_play( lua_State* L );
 static int musicL_pause( lua_State* L );
 static int musicL_resume( lua_State* L );
@@ -36,6 +37,7 @@ static int musicL_setRepeat( lua_State* L );
 static const luaL_Reg music_methods[] = {
    { "delay", musicL_delay },
    { "load", musicL_load },
+   { "prebuffer", musicL_prebuffer },
    { "play", musicL_play },
    { "pause", musicL_pause },
    { "resume", musicL_resume },
@@ -121,6 +123,29 @@ static int musicL_load( lua_State *L )
 }
 
 
+/**
+ * @brief Hints the song to load next, so it starts without delay.
+ *
+ * The start of the song gets decoded in the background, loading it with
+ *  music.load afterwards plays it right away.
+ *
+ * @usage music.prebuffer( "machina" )
+ *
+ *    @luatparam string name Name of the song to prebuffer.
+ * @luafunc prebuffer
+ */
+static int musicL_prebuffer( lua_State *L )
+{
+   const char* str;
+
+   str = luaL_checkstring(L,1);
+   if (music_prebuffer( str ))
+      NLUA_ERROR(L,_("Music '%s' invalid or failed to prebuffer."), str );
+
+   return 0;
+}
+
+
 /**
  * @brief Plays the loaded song.
  *
@@ -19,11 +19,13 @@
 #include "input.h"
 #include "land.h"
 #include "log.h"
+#include "memtrack.h"
 #include "nlua_evt.h"
 #include "nlua_misn.h"
 #include "nluadef.h"
 #include "nstring.h"
 #include "player.h"
+#include "profile.h"
 
 
 static int cache_table = LUA_NOREF; /* No reference. */
@@ -33,6 +35,8 @@ static int cache_table = LUA_NOREF; /* No reference. */
 static int naev_Lversion( lua_State *L );
 static int naev_lastplayed( lua_State *L );
 static int naev_ticks( lua_State *L );
+static int naev_profile( lua_State *L );
+static int naev_memory( lua_State *L );
 static int naev_keyGet( lua_State *L );
 static int naev_keyEnable( lua_State *L );
 static int naev_keyEnableAll( lua_State *L );
@@ -44,6 +48,8 @@ static const luaL_Reg naev_methods[] = {
    { "version", naev_Lversion },
    { "lastplayed", naev_lastplayed },
    { "ticks", naev_ticks },
+   { "profile", naev_profile },
+   { "memory", naev_memory },
    { "keyGet", naev_keyGet },
    { "keyEnable", naev_keyEnable },
    { "keyEnableAll", naev_keyEnableAll },
@@ -129,6 +135,82 @@ static int naev_ticks( lua_State *L )
 }
 
 
+/**
+ * @brief Gets the frame profiler timings.
+ *
+ * Only available in builds with the profiler enabled, GPU zones are only
+ *  there if timer queries are supported.
+ *
+ * @usage for k,v in pairs(naev.profile() or {}) do print( k, v.avg, v.peak ) end
+ *
+ *    @luatreturn table|nil Table of zone names to tables with the smoothed
+ *                time "avg" and the peak over the last second "peak" in ms,
+ *                or nil if the profiler isn't enabled.
+ * @luafunc profile
+ */
+static int naev_profile( lua_State *L )
+{
+#ifdef PROFILING
+   int i;
+   const char *name;
+   double avg, peak;
+
+   if (profile_getTiming( 0, &name, &avg, &peak ))
+      return 0;
+
+   lua_newtable(L);
+   for (i=0; profile_getTiming( i, &name, &avg, &peak )==0; i++) {
+      lua_newtable(L);
+      lua_pushnumber(L, avg);
+      lua_setfield(L, -2, "avg");
+      lua_pushnumber(L, peak);
+      lua_setfield(L, -2, "peak");
+      lua_setfield(L, -2, name);
+   }
+   return 1;
+#else /* PROFILING */
+   (void) L;
+   return 0;
+#endif /* PROFILING */
+}
+
+
+/**
+ * @brief Gets the memory used by the major subsystems.
+ *
+ * Textures are an estimate of the GPU memory, and arrays are only counted in
+ *  builds with DEBUG_ARRAYS.
+ *
+ * @usage for k,v in pairs(naev.memory()) do print( k, v.used, v.peak ) end
+ * @usage naev.memory( true ) -- Also dumps the usage to the log
+ *
+ *    @luatparam[opt=false] boolean dump Whether to also write the usage to the log.
+ *    @luatreturn table Table of subsystem names to tables with the bytes in
+ *                use "used" and the most used at once "peak".
+ * @luafunc memory
+ */
+static int naev_memory( lua_State *L )
+{
+   int i;
+   const char *name;
+   size_t used, peak;
+
+   if (lua_toboolean(L,1))
+      memtrack_report();
+
+   lua_newtable(L);
+   for (i=0; memtrack_get( i, &name, &used, &peak )==0; i++) {
+      lua_newtable(L);
+      lua_pushnumber(L, used);
+      lua_setfield(L, -2, "used");
+      lua_pushnumber(L, peak);
+      lua_setfield(L, -2, "peak");
+      lua_setfield(L, -2, name);
+   }
+   return 1;
+}
+
+
 /**
  * @brief Gets a human-readable name for the key bound to a function.
  *
@@ -142,10 +142,13 @@ Outfit* luaL_validoutfit( lua_State *L, int ind )
 Outfit** lua_pushoutfit( lua_State *L, Outfit *outfit )
 {
    Outfit **o;
+   if (nlua_internGet(L, OUTFIT_INTERN, (uintptr_t)outfit))
+      return (Outfit**) lua_touserdata(L, -1);
    o = (Outfit**) lua_newuserdata(L, sizeof(Outfit*));
    *o = outfit;
    luaL_getmetatable(L, OUTFIT_METATABLE);
    lua_setmetatable(L, -2);
+   nlua_internSet(L, OUTFIT_INTERN, (uintptr_t)outfit);
    return o;
 }
 /**
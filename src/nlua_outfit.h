@@ -12,6 +12,7 @@
 
 
 #define OUTFIT_METATABLE   "outfit" /**< Outfit metatable identifier. */
+#define OUTFIT_INTERN      "outfit_intern" /**< Cache of the pushed outfits. */
 
 
 /*
@@ -39,6 +39,7 @@
 #include "pilot_heat.h"
 #include "player.h"
 #include "rng.h"
+#include "scratch.h"
 #include "space.h"
 #include "weapon.h"
 
@@ -48,6 +49,48 @@
 extern Pilot *cur_pilot;
 
 
+/**
+ * @brief Parsed pilot range query.
+ */
+typedef struct PilotQuery_ {
+   double x; /**< X position to look around. */
+   double y; /**< Y position to look around. */
+   double r; /**< Radius to look in. */
+   const Pilot *self; /**< Pilot used as the position, excluded. */
+   const Pilot *hostile; /**< Only pilots hostile to this one, or NULL. */
+   int *factions; /**< Factions to match (scratch memory). */
+   int nfactions; /**< Number of factions to match. */
+   int nofactions; /**< An empty faction set was given, nothing matches. */
+   int disabled; /**< Include disabled pilots. */
+   int landing; /**< Include landing and taking off pilots. */
+   int sorted; /**< Sort by distance. */
+   int limit; /**< Maximum number of pilots, 0 for no limit. */
+} PilotQuery;
+
+
+/**
+ * @brief Pilot found by a range query.
+ */
+typedef struct PilotQueryHit_ {
+   unsigned int id; /**< ID of the pilot. */
+   double dist2; /**< Squared distance to the query position. */
+} PilotQueryHit;
+
+
+/**
+ * @brief State of a pilot.each() enumeration.
+ */
+typedef struct PilotEach_ {
+   int n; /**< Number of pilots. */
+   int cur; /**< Next pilot to return. */
+   unsigned int ids[]; /**< IDs of the pilots. */
+} PilotEach;
+
+
+static int *pilotL_queryIds = NULL; /**< Grid candidates, reused between queries. */
+static PilotQueryHit *pilotL_queryHits = NULL; /**< Query results, reused between queries. */
+
+
 /*
  * Prototypes.
  */
@@ -65,6 +108,12 @@ static int pilotL_clear( lua_State *L );
 static int pilotL_toggleSpawn( lua_State *L );
 static int pilotL_getPilots( lua_State *L );
 static int pilotL_getHostiles( lua_State *L );
+static void pilotL_parseQuery( lua_State *L, int ind, PilotQuery *q );
+static int pilotL_compareHit( const void *a, const void *b );
+static int pilotL_runQuery( const PilotQuery *q );
+static int pilotL_getInRange( lua_State *L );
+static int pilotL_eachNext( lua_State *L );
+static int pilotL_each( lua_State *L );
 static int pilotL_eq( lua_State *L );
 static int pilotL_name( lua_State *L );
 static int pilotL_id( lua_State *L );
@@ -81,6 +130,11 @@ static int pilotL_outfits( lua_State *L );
 static int pilotL_rename( lua_State *L );
 static int pilotL_position( lua_State *L );
 static int pilotL_velocity( lua_State *L );
+static int pilotL_positionXY( lua_State *L );
+static int pilotL_velocityXY( lua_State *L );
+static Vector2d* pilotL_distTarget( lua_State *L, int ind );
+static int pilotL_distance( lua_State *L );
+static int pilotL_distance2( lua_State *L );
 static int pilotL_dir( lua_State *L );
 static int pilotL_ew( lua_State *L );
 static int pilotL_temp( lua_State *L );
@@ -154,6 +208,7 @@ static int pilotL_land( lua_State *L );
 static int pilotL_hailPlayer( lua_State *L );
 static int pilotL_msg( lua_State *L );
 static int pilotL_leader( lua_State *L );
+static int pilotL_setFormPos( lua_State *L );
 static int pilotL_setLeader( lua_State *L );
 static int pilotL_followers( lua_State *L );
 static int pilotL_hookClear( lua_State *L );
@@ -165,6 +220,8 @@ static const luaL_Reg pilotL_methods[] = {
    { "rm", pilotL_remove },
    { "get", pilotL_getPilots },
    { "getHostiles", pilotL_getHostiles },
+   { "getInRange", pilotL_getInRange },
+   { "each", pilotL_each },
    { "__eq", pilotL_eq },
    /* Info. */
    { "name", pilotL_name },
@@ -182,6 +239,10 @@ static const luaL_Reg pilotL_methods[] = {
    { "rename", pilotL_rename },
    { "pos", pilotL_position },
    { "vel", pilotL_velocity },
+   { "posxy", pilotL_positionXY },
+   { "velxy", pilotL_velocityXY },
+   { "dist", pilotL_distance },
+   { "dist2", pilotL_distance2 },
    { "dir", pilotL_dir },
    { "ew", pilotL_ew },
    { "temp", pilotL_temp },
@@ -264,6 +325,7 @@ static const luaL_Reg pilotL_methods[] = {
    { "hailPlayer", pilotL_hailPlayer },
    { "msg", pilotL_msg },
    { "leader", pilotL_leader },
+   { "setFormPos", pilotL_setFormPos },
    { "setLeader", pilotL_setLeader },
    { "followers", pilotL_followers },
    { "hookClear", pilotL_hookClear },
@@ -387,10 +449,13 @@ Pilot* luaL_validpilot( lua_State *L, int ind )
 LuaPilot* lua_pushpilot( lua_State *L, LuaPilot pilot )
 {
    LuaPilot *p;
+   if (nlua_internGet(L, PILOT_INTERN, pilot))
+      return (LuaPilot*) lua_touserdata(L, -1);
    p = (LuaPilot*) lua_newuserdata(L, sizeof(LuaPilot));
    *p = pilot;
    luaL_getmetatable(L, PILOT_METATABLE);
    lua_setmetatable(L, -2);
+   nlua_internSet(L, PILOT_INTERN, pilot);
    return p;
 }
 /**
@@ -781,7 +846,7 @@ static int pilotL_toggleSpawn( lua_State *L )
  */
 static int pilotL_getPilots( lua_State *L )
 {
-   int i, j, k, d;
+   int i, j, k, d, n, m;
    int *factions;
    Pilot *const* pilot_stack;
 
@@ -792,18 +857,22 @@ static int pilotL_getPilots( lua_State *L )
 
    /* Check for belonging to faction. */
    if (lua_istable(L,1) || lua_isfaction(L,1)) {
+      /* Only needed for this call, so it's frame memory. */
       if (lua_isfaction(L,1)) {
-         factions = array_create( int );
-         array_push_back( &factions, lua_tofaction(L,1) );
+         factions = scratch_alloc( sizeof(int) );
+         factions[0] = lua_tofaction(L,1);
+         n = 1;
       }
       else {
          /* Get table length and preallocate. */
-         factions = array_create_size( int, lua_objlen(L,1) );
+         m = lua_objlen(L,1);
+         factions = scratch_alloc( sizeof(int) * m );
+         n = 0;
          /* Load up the table. */
          lua_pushnil(L);
          while (lua_next(L, -2) != 0) {
-            if (lua_isfaction(L,-1))
-               array_push_back( &factions, lua_tofaction(L, -1) );
+            if (lua_isfaction(L,-1) && (n < m))
+               factions[n++] = lua_tofaction(L, -1);
             lua_pop(L,1);
          }
       }
@@ -812,7 +881,7 @@ static int pilotL_getPilots( lua_State *L )
       lua_newtable(L);
       k = 1;
       for (i=0; i<array_size(pilot_stack); i++) {
-         for (j=0; j<array_size(factions); j++) {
+         for (j=0; j<n; j++) {
             if ((pilot_stack[i]->faction == factions[j]) &&
                   (d || !pilot_isDisabled(pilot_stack[i])) &&
                   !pilot_isFlag(pilot_stack[i], PILOT_DELETE)) {
@@ -822,9 +891,6 @@ static int pilotL_getPilots( lua_State *L )
             }
          }
       }
-
-      /* clean up. */
-      array_free( factions );
    }
    else if ((lua_isnil(L,1)) || (lua_gettop(L) == 0)) {
       /* Now put all the matching pilots in a table. */
@@ -893,6 +959,248 @@ static int pilotL_getHostiles( lua_State *L )
    return 1;
 }
 
+/**
+ * @brief Parses the position, radius and filter of a pilot query.
+ *
+ *    @param L Lua state.
+ *    @param ind Index of the position, followed by the radius and filter.
+ *    @param[out] q Query parsed.
+ */
+static void pilotL_parseQuery( lua_State *L, int ind, PilotQuery *q )
+{
+   Vector2d *v;
+   int m;
+
+   memset( q, 0, sizeof(PilotQuery) );
+   if (lua_ispilot(L,ind)) {
+      q->self = luaL_validpilot(L,ind);
+      v = &q->self->solid->pos;
+   }
+   else
+      v = luaL_checkvector(L,ind);
+   q->x = v->x;
+   q->y = v->y;
+   q->r = luaL_checknumber(L,ind+1);
+
+   if (lua_isnoneornil(L,ind+2))
+      return;
+   luaL_checktype(L,ind+2,LUA_TTABLE);
+
+   /* Factions, only needed for this call. */
+   lua_getfield(L,ind+2,"factions");
+   if (lua_isfaction(L,-1)) {
+      q->factions  = scratch_alloc( sizeof(int) );
+      q->factions[q->nfactions++] = lua_tofaction(L,-1);
+   }
+   else if (lua_istable(L,-1)) {
+      m = lua_objlen(L,-1);
+      q->factions = scratch_alloc( sizeof(int) * MAX(m,1) );
+      lua_pushnil(L);
+      while (lua_next(L,-2) != 0) {
+         if (lua_isfaction(L,-1) && (q->nfactions < m))
+            q->factions[q->nfactions++] = lua_tofaction(L,-1);
+         lua_pop(L,1);
+      }
+      /* Empty set matches nothing. */
+      q->nofactions = (q->nfactions == 0);
+   }
+   lua_pop(L,1);
+
+   lua_getfield(L,ind+2,"hostile");
+   if (!lua_isnil(L,-1))
+      q->hostile = luaL_validpilot(L,-1);
+   lua_pop(L,1);
+
+   lua_getfield(L,ind+2,"disabled");
+   q->disabled = lua_toboolean(L,-1);
+   lua_pop(L,1);
+
+   lua_getfield(L,ind+2,"landing");
+   q->landing = lua_toboolean(L,-1);
+   lua_pop(L,1);
+
+   lua_getfield(L,ind+2,"sort");
+   q->sorted = lua_toboolean(L,-1);
+   lua_pop(L,1);
+
+   lua_getfield(L,ind+2,"limit");
+   q->limit = luaL_optinteger(L,-1,0);
+   lua_pop(L,1);
+}
+
+
+/**
+ * @brief Compares query results by distance.
+ */
+static int pilotL_compareHit( const void *a, const void *b )
+{
+   const PilotQueryHit *ha = a, *hb = b;
+   if (ha->dist2 < hb->dist2)
+      return -1;
+   else if (ha->dist2 > hb->dist2)
+      return +1;
+   return ha->id - hb->id;
+}
+
+
+/**
+ * @brief Finds the pilots matching a query.
+ *
+ * Candidates come from the collision grid, so only the pilots near the
+ *  position are checked.
+ *
+ *    @param q Query to run.
+ *    @return Number of pilots found, stored in pilotL_queryHits.
+ */
+static int pilotL_runQuery( const PilotQuery *q )
+{
+   int i, j, n;
+   double r2, d2;
+   Pilot *const* pilot_stack;
+   const Pilot *t;
+
+   pilot_stack = pilot_getAll();
+   pilot_collideQuery( &pilotL_queryIds, q->x-q->r, q->y-q->r, q->x+q->r, q->y+q->r );
+
+   r2 = pow2(q->r);
+   n  = 0;
+   if (pilotL_queryHits == NULL)
+      pilotL_queryHits = array_create( PilotQueryHit );
+   array_resize( &pilotL_queryHits, array_size(pilotL_queryIds) );
+   for (i=0; i<array_size(pilotL_queryIds); i++) {
+      t = pilot_stack[ pilotL_queryIds[i] ];
+      if ((t == q->self) || pilot_isFlag(t, PILOT_DELETE))
+         continue;
+      d2 = pow2(t->solid->pos.x - q->x) + pow2(t->solid->pos.y - q->y);
+      if (d2 > r2)
+         continue;
+      if (!q->disabled && pilot_isDisabled(t))
+         continue;
+      if (!q->landing && (pilot_isFlag(t, PILOT_LANDING) || pilot_isFlag(t, PILOT_TAKEOFF)))
+         continue;
+      if ((q->hostile != NULL) &&
+            !(areEnemies( t->faction, q->hostile->faction ) ||
+               ((q->hostile->id == PLAYER_ID) && pilot_isHostile(t))))
+         continue;
+      if (q->nofactions)
+         continue;
+      if (q->nfactions > 0) {
+         for (j=0; j<q->nfactions; j++)
+            if (t->faction == q->factions[j])
+               break;
+         if (j >= q->nfactions)
+            continue;
+      }
+
+      pilotL_queryHits[n].id    = t->id;
+      pilotL_queryHits[n].dist2 = d2;
+      n++;
+   }
+
+   /* The grid isn't in any particular order, so always sort when limiting. */
+   if (q->sorted || (q->limit > 0))
+      qsort( pilotL_queryHits, n, sizeof(PilotQueryHit), pilotL_compareHit );
+   if ((q->limit > 0) && (n > q->limit))
+      n = q->limit;
+   return n;
+}
+
+
+/**
+ * @brief Gets the pilots within a distance of a position.
+ *
+ * Only looks at the pilots near the position, so it's much cheaper than
+ *  filtering the results of pilot.get() in Lua. The filter table can have
+ *  the following fields:
+ *
+ *  - "factions": faction or table of factions the pilots must belong to.
+ *  - "hostile": pilot the pilots must be hostile to.
+ *  - "disabled": whether to include disabled pilots (default false).
+ *  - "landing": whether to include landing and taking off pilots (default false).
+ *  - "sort": whether to sort the pilots by distance, nearest first (default false).
+ *  - "limit": maximum number of pilots to get, the nearest ones are returned.
+ *
+ * @usage near = pilot.getInRange( player.pilot(), 3000 )
+ * @usage foes = pilot.getInRange( pos, 5000, { hostile=player.pilot(), limit=3 } ) -- 3 nearest hostiles
+ *
+ *    @luatparam Pilot|Vec2 pos Position to look around, if a pilot it is not included.
+ *    @luatparam number radius Distance to look in.
+ *    @luatparam[opt] table filter Filter to apply.
+ *    @luatreturn {Pilot,...} A table containing the pilots.
+ * @luafunc getInRange
+ */
+static int pilotL_getInRange( lua_State *L )
+{
+   int i, n;
+   PilotQuery q;
+
+   pilotL_parseQuery( L, 1, &q );
+   n = pilotL_runQuery( &q );
+
+   lua_createtable(L, n, 0);
+   for (i=0; i<n; i++) {
+      lua_pushpilot(L, pilotL_queryHits[i].id);
+      lua_rawseti(L, -2, i+1);
+   }
+   return 1;
+}
+
+
+/**
+ * @brief Gets the next pilot of a pilot.each() enumeration.
+ */
+static int pilotL_eachNext( lua_State *L )
+{
+   PilotEach *e;
+   Pilot *p;
+
+   e = lua_touserdata(L, lua_upvalueindex(1));
+   while (e->cur < e->n) {
+      /* Skip pilots that died since the enumeration started. */
+      p = pilot_get( e->ids[ e->cur++ ] );
+      if ((p == NULL) || pilot_isFlag(p, PILOT_DELETE))
+         continue;
+      lua_pushpilot(L, p->id);
+      return 1;
+   }
+   return 0;
+}
+
+
+/**
+ * @brief Enumerates the pilots within a distance of a position.
+ *
+ * Takes the same parameters as pilot.getInRange(), but doesn't build a
+ *  table of the pilots.
+ *
+ * @usage for p in pilot.each( player.pilot(), 2000, { hostile=player.pilot() } ) do p:setHilight() end
+ *
+ *    @luatparam Pilot|Vec2 pos Position to look around, if a pilot it is not included.
+ *    @luatparam number radius Distance to look in.
+ *    @luatparam[opt] table filter Filter to apply.
+ *    @luatreturn function Iterator over the pilots.
+ * @luafunc each
+ */
+static int pilotL_each( lua_State *L )
+{
+   int i, n;
+   PilotQuery q;
+   PilotEach *e;
+
+   pilotL_parseQuery( L, 1, &q );
+   n = pilotL_runQuery( &q );
+
+   /* The results have to outlive other queries done while iterating. */
+   e = lua_newuserdata(L, sizeof(PilotEach) + n*sizeof(unsigned int));
+   e->n   = n;
+   e->cur = 0;
+   for (i=0; i<n; i++)
+      e->ids[i] = pilotL_queryHits[i].id;
+   lua_pushcclosure(L, pilotL_eachNext, 1);
+   return 1;
+}
+
+
 /**
  * @brief Checks to see if pilot and p are the same.
  *
@@ -1774,6 +2082,94 @@ static int pilotL_velocity( lua_State *L )
    return 1;
 }
 
+/**
+ * @brief Gets the coordinates of the pilot's position.
+ *
+ * Unlike pilot.pos this doesn't create a vector, so it's cheaper in code run
+ *  often.
+ *
+ * @usage x, y = p:posxy()
+ *
+ *    @luatparam Pilot p Pilot to get the position of.
+ *    @luatreturn number X coordinate of the pilot's position.
+ *    @luatreturn number Y coordinate of the pilot's position.
+ * @luafunc posxy
+ */
+static int pilotL_positionXY( lua_State *L )
+{
+   Pilot *p = luaL_validpilot(L,1);
+   lua_pushnumber(L, p->solid->pos.x);
+   lua_pushnumber(L, p->solid->pos.y);
+   return 2;
+}
+
+/**
+ * @brief Gets the coordinates of the pilot's velocity.
+ *
+ * @usage vx, vy = p:velxy()
+ *
+ *    @luatparam Pilot p Pilot to get the velocity of.
+ *    @luatreturn number X coordinate of the pilot's velocity.
+ *    @luatreturn number Y coordinate of the pilot's velocity.
+ * @luafunc velxy
+ */
+static int pilotL_velocityXY( lua_State *L )
+{
+   Pilot *p = luaL_validpilot(L,1);
+   lua_pushnumber(L, p->solid->vel.x);
+   lua_pushnumber(L, p->solid->vel.y);
+   return 2;
+}
+
+/**
+ * @brief Gets the position of a pilot or vector parameter.
+ */
+static Vector2d* pilotL_distTarget( lua_State *L, int ind )
+{
+   if (lua_ispilot(L,ind))
+      return &luaL_validpilot(L,ind)->solid->pos;
+   return luaL_checkvector(L,ind);
+}
+
+/**
+ * @brief Gets the distance from the pilot to another pilot or a position.
+ *
+ * Equivalent to p:pos():dist( t:pos() ) without creating any vectors.
+ *
+ * @usage d = p:dist( target )
+ * @usage d = p:dist( vec2.new( 100, 0 ) )
+ *
+ *    @luatparam Pilot p Pilot to get the distance from.
+ *    @luatparam Pilot|Vec2 t Pilot or position to get the distance to.
+ *    @luatreturn number The distance between them.
+ * @luafunc dist
+ */
+static int pilotL_distance( lua_State *L )
+{
+   Pilot *p = luaL_validpilot(L,1);
+   Vector2d *v = pilotL_distTarget(L,2);
+   lua_pushnumber(L, vect_dist( &p->solid->pos, v ));
+   return 1;
+}
+
+/**
+ * @brief Gets the squared distance from the pilot to another pilot or a position.
+ *
+ * @usage d2 = p:dist2( target )
+ *
+ *    @luatparam Pilot p Pilot to get the distance from.
+ *    @luatparam Pilot|Vec2 t Pilot or position to get the distance to.
+ *    @luatreturn number The squared distance between them.
+ * @luafunc dist2
+ */
+static int pilotL_distance2( lua_State *L )
+{
+   Pilot *p = luaL_validpilot(L,1);
+   Vector2d *v = pilotL_distTarget(L,2);
+   lua_pushnumber(L, vect_dist2( &p->solid->pos, v ));
+   return 1;
+}
+
 /**
  * @brief Gets the pilot's evasion.
  *
@@ -4229,6 +4625,53 @@ static int pilotL_leader( lua_State *L ) {
 }
 
 
+/**
+ * @brief Sets the position of a pilot in the formation of its leader.
+ *
+ * The position is followed by the pilot's AI with ai.follow_fleet().
+ *
+ * @usage p:setFormPos( 45, 100 ) -- Keep 100 units away at 45 degrees from the leader's heading
+ * @usage p:setFormPos() -- Leave the formation
+ *
+ *    @luatparam Pilot p Pilot to set the position of.
+ *    @luatparam[opt] number angle Angle to the leader in degrees, nil to leave the formation.
+ *    @luatparam[opt] number radius Distance to the leader.
+ *    @luatparam[opt="velocity"] string method How the angle is measured,
+ *              "velocity", "absolute" or "keepangle".
+ * @luafunc setFormPos
+ */
+static int pilotL_setFormPos( lua_State *L )
+{
+   Pilot *p;
+   PilotFormation *f;
+   const char *method;
+
+   NLUA_CHECKRW(L);
+
+   p = luaL_validpilot(L, 1);
+   f = &p->formation;
+   if (lua_isnoneornil(L, 2)) {
+      f->set = 0;
+      return 0;
+   }
+
+   /* Start by approaching the new position. */
+   if (!f->set)
+      f->app = 2;
+   f->set    = 1;
+   f->angle  = luaL_checknumber(L, 2);
+   f->radius = luaL_checknumber(L, 3);
+   method    = luaL_optstring(L, 4, "velocity");
+   if (strcmp( method, "absolute" ) == 0)
+      f->method = PILOT_FORM_ABSOLUTE;
+   else if (strcmp( method, "keepangle" ) == 0)
+      f->method = PILOT_FORM_KEEPANGLE;
+   else
+      f->method = PILOT_FORM_VELOCITY;
+   return 0;
+}
+
+
 /**
  * @brief Set a pilots leader.
  *
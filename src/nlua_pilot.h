@@ -15,6 +15,7 @@
 
 
 #define PILOT_METATABLE   "pilot" /**< Pilot metatable identifier. */
+#define PILOT_INTERN      "pilot_intern" /**< Cache of the pushed pilots. */
 
 
 /**
@@ -10,6 +10,7 @@
 
 /** @cond */
 #include <lauxlib.h>
+#include <string.h>
 
 #include "naev.h"
 /** @endcond */
@@ -186,7 +187,7 @@ static int poL_state( lua_State *L )
 
    /* Mark as modified if state changed. */
    if (pos != po->state)
-      pilotoutfit_modified = 1;
+      pilotoutfit_modified |= PILOTOUTFIT_MODIFIED_STATE;
 
    return 0;
 }
@@ -205,8 +206,11 @@ static int poL_set( lua_State *L )
    PilotOutfitSlot *po  = luaL_validpilotoutfit(L,1);
    const char *name = luaL_checkstring(L,2);
    double value = luaL_checknumber(L,3);
+   ShipStats old = po->lua_stats;
    ss_statsSet( &po->lua_stats, name, value, 1 );
-   pilotoutfit_modified = 1;
+   /* Setting the same value again every update doesn't change anything. */
+   if (memcmp( &old, &po->lua_stats, sizeof(ShipStats) ) != 0)
+      pilotoutfit_modified |= PILOTOUTFIT_MODIFIED_STATS;
    return 0;
 }
 
@@ -14,6 +14,10 @@
 #define PILOTOUTFIT_METATABLE   "pilotoutfit" /**< Pilot outfit metatable identifier. */
 
 
+#define PILOTOUTFIT_MODIFIED_STATS  (1<<0) /**< Lua stats of a pilot outfit changed. */
+#define PILOTOUTFIT_MODIFIED_STATE  (1<<1) /**< State of a pilot outfit changed. */
+
+
 extern int pilotoutfit_modified;
 
 
@@ -188,10 +188,13 @@ Planet* luaL_validplanet( lua_State *L, int ind )
 LuaPlanet* lua_pushplanet( lua_State *L, LuaPlanet planet )
 {
    LuaPlanet *p;
+   if (nlua_internGet(L, PLANET_INTERN, planet))
+      return (LuaPlanet*) lua_touserdata(L, -1);
    p = (LuaPlanet*) lua_newuserdata(L, sizeof(LuaPlanet));
    *p = planet;
    luaL_getmetatable(L, PLANET_METATABLE);
    lua_setmetatable(L, -2);
+   nlua_internSet(L, PLANET_INTERN, planet);
    return p;
 }
 /**
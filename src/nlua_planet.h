@@ -12,6 +12,7 @@
 
 
 #define PLANET_METATABLE   "planet" /**< Planet metatable identifier. */
+#define PLANET_INTERN      "planet_intern" /**< Cache of the pushed planets. */
 
 
 /**
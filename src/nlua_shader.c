@@ -31,6 +31,7 @@ static int shaderL_new( lua_State *L );
 static int shaderL_send( lua_State *L );
 static int shaderL_sendRaw( lua_State *L );
 static int shaderL_hasUniform( lua_State *L );
+static int shaderL_uniform( lua_State *L );
 static int shaderL_addPostProcess( lua_State *L );
 static int shaderL_rmPostProcess( lua_State *L );
 static const luaL_Reg shaderL_methods[] = {
@@ -40,6 +41,7 @@ static const luaL_Reg shaderL_methods[] = {
    { "send", shaderL_send },
    { "sendRaw", shaderL_sendRaw },
    { "hasUniform", shaderL_hasUniform },
+   { "uniform", shaderL_uniform },
    { "addPPShader", shaderL_addPostProcess },
    { "rmPPShader", shaderL_rmPostProcess },
    {0,0}
@@ -51,6 +53,7 @@ int shader_compareUniform( const void *a, const void *b);
 int shader_searchUniform( const void *id, const void *u );
 LuaUniform_t *shader_getUniform( LuaShader_t *ls, const char *name );
 static int shaderL_sendHelper( lua_State *L, int ignore_missing );
+static LuaUniform_t *shaderL_checkUniform( lua_State *L, LuaShader_t *ls, int ind );
 
 
 /**
@@ -147,7 +150,7 @@ static int shaderL_gc( lua_State *L )
    LuaShader_t *shader = luaL_checkshader(L,1);
    if (shader->pp_id > 0)
       render_postprocessRm( shader->pp_id );
-   glDeleteProgram( shader->program );
+   gl_deleteProgram( shader->program );
    free(shader->uniforms);
    return 0;
 }
@@ -321,7 +324,7 @@ void shader_parseUniformArgsInt( GLint values[4], lua_State *L, int idx, int n )
  * @brief Allows setting values of uniforms for a shader. Errors out if the uniform is unknown or unused (as in optimized out by the compiler).
  *
  *    @luatparam Shader shader Shader to send uniform to.
- *    @luatparam string name Name of the uniform.
+ *    @luatparam string|number name Name of the uniform or handle from shader:uniform().
  * @luafunc send
  */
 static int shaderL_send( lua_State *L )
@@ -334,7 +337,7 @@ static int shaderL_send( lua_State *L )
  * @brief Allows setting values of uniforms for a shader, while ignoring unknown (or unused) uniforms.
  *
  *    @luatparam Shader shader Shader to send uniform to.
- *    @luatparam string name Name of the uniform.
+ *    @luatparam string|number name Name of the uniform or handle from shader:uniform().
  * @luafunc send
  */
 static int shaderL_sendRaw( lua_State *L )
@@ -357,18 +360,23 @@ static int shaderL_sendHelper( lua_State *L, int ignore_missing )
    glTexture *tex;
 
    ls = luaL_checkshader(L,1);
-   name = luaL_checkstring(L,2);
 
-   u = shader_getUniform( ls, name );
-   if (u==NULL) {
-      if (ignore_missing)
-         return 0;
-      NLUA_ERROR(L,_("Shader does not have uniform '%s'!"), name);
+   /* Handles are already resolved. */
+   if (lua_type(L,2) == LUA_TNUMBER)
+      u = shaderL_checkUniform( L, ls, 2 );
+   else {
+      name = luaL_checkstring(L,2);
+      u = shader_getUniform( ls, name );
+      if (u==NULL) {
+         if (ignore_missing)
+            return 0;
+         NLUA_ERROR(L,_("Shader does not have uniform '%s'!"), name);
+      }
    }
 
    /* With OpenGL 4.1 or ARB_separate_shader_objects, there
     * is no need to set the program first. */
-   glUseProgram( ls->program );
+   gl_useProgram( ls->program );
    idx = 3;
    switch (u->type) {
       case GL_FLOAT:
@@ -407,13 +415,14 @@ static int shaderL_sendHelper( lua_State *L, int ignore_missing )
 
       case GL_SAMPLER_2D:
          tex = luaL_checktex(L,idx);
+         gl_texPin( tex ); /* The shader holds on to the texture. */
          ls->tex[ u->tex ].texid = tex->texture;
          break;
 
       default:
          WARN(_("Unsupported shader uniform type '%d' for uniform '%s'. Ignoring."), u->type, u->name );
    }
-   glUseProgram( 0 );
+   gl_useProgram( 0 );
 
    gl_checkErr();
 
@@ -444,12 +453,55 @@ static int shaderL_hasUniform( lua_State *L )
 }
 
 
+/**
+ * @brief Gets a handle to a uniform of a shader.
+ *
+ * Sending to the handle skips looking up the uniform by name, which is
+ *  worth it for uniforms sent every frame.
+ *
+ * @usage u = shader:uniform( "u_time" ); shader:send( u, t )
+ *
+ *    @luatparam Shader shader Shader to get uniform of.
+ *    @luatparam string name Name of the uniform.
+ *    @luatreturn number|nil Handle to the uniform or nil if the shader doesn't have it.
+ * @luafunc uniform
+ */
+static int shaderL_uniform( lua_State *L )
+{
+   LuaShader_t *ls;
+   LuaUniform_t *u;
+   const char *name;
+
+   ls = luaL_checkshader(L,1);
+   name = luaL_checkstring(L,2);
+
+   u = shader_getUniform( ls, name );
+   if (u == NULL)
+      return 0;
+   lua_pushnumber( L, u - ls->uniforms + 1 );
+   return 1;
+}
+
+
+/**
+ * @brief Gets the uniform a handle refers to or raises an error.
+ */
+static LuaUniform_t *shaderL_checkUniform( lua_State *L, LuaShader_t *ls, int ind )
+{
+   int i = luaL_checkint(L,ind);
+   if ((i < 1) || (i > ls->nuniforms))
+      NLUA_ERROR(L,_("Invalid shader uniform handle '%d'!"), i);
+   return &ls->uniforms[ i-1 ];
+}
+
+
 /**
  * @brief Sets a shader as a post-processing shader.
  *
  *    @luatparam Shader shader Shader to set as a post-processing shader.
  *    @luatparam[opt="final"] string layer Layer to add the shader to.
  *    @luatparam[opt=0] number priority Priority of the shader to set. Higher values mean it is run later.
+ *    @luatparam[opt=false] boolean half Whether the shader can be run at half resolution and scaled up, which is much cheaper for blurs and other smooth effects.
  *    @luatreturn boolean true on success.
  * @luafunc addPPShader
  */
@@ -458,6 +510,7 @@ static int shaderL_addPostProcess( lua_State *L )
    LuaShader_t *ls = luaL_checkshader(L,1);
    const char *str = luaL_optstring(L,2,"final");
    int priority = luaL_optinteger(L,3,0);
+   unsigned int flags = lua_toboolean(L,4) ? PP_SHADER_HALF : 0;
    int layer;
 
    if (strcmp(str,"final")==0)
@@ -470,7 +523,7 @@ static int shaderL_addPostProcess( lua_State *L )
       NLUA_ERROR(L,_("Layer was '%s', but must be one of 'final' or 'game'"), str);
 
    if (ls->pp_id == 0)
-      ls->pp_id = render_postprocessAdd( ls, layer, priority );
+      ls->pp_id = render_postprocessAdd( ls, layer, priority, flags );
    lua_pushboolean(L, ls->pp_id>0);
    return 1;
 }
@@ -42,6 +42,7 @@ static int systemL_faction( lua_State *L );
 static int systemL_nebula( lua_State *L );
 static int systemL_jumpdistance( lua_State *L );
 static int systemL_jumpPath( lua_State *L );
+static int systemL_withinJumps( lua_State *L );
 static int systemL_adjacent( lua_State *L );
 static int systemL_jumps( lua_State *L );
 static int systemL_asteroidFields( lua_State *L );
@@ -72,6 +73,7 @@ static const luaL_Reg system_methods[] = {
    { "nebula", systemL_nebula },
    { "jumpDist", systemL_jumpdistance },
    { "jumpPath", systemL_jumpPath },
+   { "withinJumps", systemL_withinJumps },
    { "adjacentSystems", systemL_adjacent },
    { "jumps", systemL_jumps },
    { "asteroidFields", systemL_asteroidFields },
@@ -185,10 +187,13 @@ StarSystem* luaL_validsystem( lua_State *L, int ind )
 LuaSystem* lua_pushsystem( lua_State *L, LuaSystem sys )
 {
    LuaSystem *s;
+   if (nlua_internGet(L, SYSTEM_INTERN, sys))
+      return (LuaSystem*) lua_touserdata(L, -1);
    s = (LuaSystem*) lua_newuserdata(L, sizeof(LuaSystem));
    *s = sys;
    luaL_getmetatable(L, SYSTEM_METATABLE);
    lua_setmetatable(L, -2);
+   nlua_internSet(L, SYSTEM_INTERN, sys);
    return s;
 }
 
@@ -428,31 +433,30 @@ static int systemL_nebula( lua_State *L )
 static int systemL_jumpdistance( lua_State *L )
 {
    StarSystem *sys, *sysp;
-   StarSystem **s;
-   const char *start, *goal;
-   int h, k;
+   const char *goal;
+   int h, k, d;
 
    sys = luaL_validsystem(L,1);
-   start = sys->name;
    h   = lua_toboolean(L,3);
    k   = !lua_toboolean(L,4);
 
    if (lua_gettop(L) > 1) {
-      if (lua_isstring(L,2))
+      if (lua_isstring(L,2)) {
          goal = lua_tostring(L,2);
-      else if (lua_issystem(L,2)) {
-         sysp = luaL_validsystem(L,2);
-         goal = sysp->name;
+         sysp = system_get( goal );
+         if (sysp == NULL)
+            NLUA_ERROR(L, _("System '%s' not found!"), goal);
       }
+      else if (lua_issystem(L,2))
+         sysp = luaL_validsystem(L,2);
       else NLUA_INVALID_PARAMETER(L);
    }
    else
-      goal = cur_system->name;
-
-   s = map_getJumpPath( start, goal, k, h, NULL );
-   lua_pushnumber(L,array_size(s));
+      sysp = cur_system;
 
-   array_free(s);
+   /* Unreachable systems have always been reported as 0 jumps away. */
+   d = map_jumpDist( sys, sysp, k, h );
+   lua_pushnumber(L, MAX(d,0));
    return 1;
 }
 
@@ -524,6 +528,75 @@ static int systemL_jumpPath( lua_State *L )
 }
 
 
+/**
+ * @brief Gets all the systems within a number of jumps of a system.
+ *
+ * Does a single search instead of a jumpDist() call per system. The filter
+ *  table can have the following fields:
+ *
+ *  - "min": minimum number of jumps (default 0, which includes the system itself).
+ *  - "hidden": whether or not to consider hidden jumps (default false).
+ *  - "known": whether or not to consider only jumps known by the player (default false).
+ *  - "faction": only get systems belonging to this faction.
+ *
+ * @usage for i, s in ipairs( system.withinJumps( system.cur(), 3, {min=1} ) ) do -- Systems 1 to 3 jumps away.
+ *
+ *    @luatparam System s System to start from.
+ *    @luatparam number n Maximum number of jumps.
+ *    @luatparam[opt] table filter Filter to apply.
+ *    @luatreturn {System,...} Systems in range, ordered by id.
+ *    @luatreturn {number,...} Number of jumps to each of the systems.
+ * @luafunc withinJumps
+ */
+static int systemL_withinJumps( lua_State *L )
+{
+   StarSystem *sys, *systems;
+   const int *dist;
+   int i, n, min, h, k, f, pushed;
+
+   sys = luaL_validsystem(L,1);
+   n   = luaL_checkinteger(L,2);
+   min = 0;
+   h   = 0;
+   k   = 1;
+   f   = -1;
+   if (!lua_isnoneornil(L,3)) {
+      luaL_checktype(L,3,LUA_TTABLE);
+      lua_getfield(L,3,"min");
+      min = MAX( luaL_optinteger(L,-1,0), 0 );
+      lua_pop(L,1);
+      lua_getfield(L,3,"hidden");
+      h = lua_toboolean(L,-1);
+      lua_pop(L,1);
+      lua_getfield(L,3,"known");
+      k = !lua_toboolean(L,-1);
+      lua_pop(L,1);
+      lua_getfield(L,3,"faction");
+      if (!lua_isnil(L,-1))
+         f = luaL_validfaction(L,-1);
+      lua_pop(L,1);
+   }
+
+   systems = system_getAll();
+   dist    = map_jumpDists( sys, k, h );
+   lua_newtable(L);
+   lua_newtable(L);
+   pushed = 0;
+   for (i=0; i<array_size(systems); i++) {
+      if ((dist[i] < min) || (dist[i] > n))
+         continue;
+      if ((f >= 0) && (systems[i].faction != f))
+         continue;
+      pushed++;
+      lua_pushsystem(L, system_index( &systems[i] ));
+      lua_rawseti(L, -3, pushed);
+      lua_pushinteger(L, dist[i]);
+      lua_rawseti(L, -2, pushed);
+   }
+   return 2;
+}
+
+
 /**
  * @brief Gets all the adjacent systems to a system.
  *
@@ -12,6 +12,7 @@
 
 
 #define SYSTEM_METATABLE   "system" /**< System metatable identifier. */
+#define SYSTEM_INTERN      "system_intern" /**< Cache of the pushed systems. */
 
 
 /**
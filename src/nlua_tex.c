@@ -37,6 +37,7 @@ static inline uint32_t get_pixel(SDL_Surface *surface, int x, int y);
 /* Texture metatable methods. */
 static int texL_close( lua_State *L );
 static int texL_new( lua_State *L );
+static int texL_prefetch( lua_State *L );
 static int texL_readData( lua_State *L );
 static int texL_writeData( lua_State *L );
 static int texL_dim( lua_State *L );
@@ -48,6 +49,7 @@ static const luaL_Reg texL_methods[] = {
    { "__gc", texL_close },
    { "new", texL_new },
    { "open", texL_new },
+   { "prefetch", texL_prefetch },
    { "readData", texL_readData },
    { "writeData", texL_writeData },
    { "dim", texL_dim },
@@ -290,6 +292,25 @@ static inline uint32_t get_pixel(SDL_Surface *surface, int x, int y)
 }
 
 
+/**
+ * @brief Starts decoding an image in the background.
+ *
+ * A later tex.open of the same path then only has to upload the image, which
+ *  makes it much cheaper. Useful to avoid stutters when the image is going to
+ *  be needed soon.
+ *
+ * @usage tex.prefetch( "gfx/bkg/nebula23.webp" )
+ *
+ *    @luatparam string path Path of the image to decode.
+ * @luafunc prefetch
+ */
+static int texL_prefetch( lua_State *L )
+{
+   gl_texPrefetch( luaL_checkstring(L,1), 0 );
+   return 0;
+}
+
+
 /**
  * @brief Reads image data from a file.
  *
@@ -384,7 +405,8 @@ static int texL_writeData( lua_State *L )
    data = malloc( len );
 
    /* Read raw data. */
-   glBindTexture( GL_TEXTURE_2D, tex->texture );
+   gl_texPin( tex );
+   gl_bindTexture( GL_TEXTURE_2D, tex->texture );
    glGetTexImage( GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, data );
    gl_checkErr();
 
@@ -528,7 +550,9 @@ static int texL_setFilter( lua_State *L )
    if (min==0 || mag==0)
       NLUA_INVALID_PARAMETER(L);
 
-   glBindTexture( GL_TEXTURE_2D, tex->texture );
+   /* Would be lost when reloading. */
+   gl_texPin( tex );
+   gl_bindTexture( GL_TEXTURE_2D, tex->texture );
    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, mag );
    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, min );
    gl_checkErr();
@@ -561,7 +585,9 @@ static int texL_setWrap( lua_State *L )
    if (horiz==0 || vert==0 || depth==0)
       NLUA_INVALID_PARAMETER(L);
 
-   glBindTexture( GL_TEXTURE_2D, tex->texture );
+   /* Would be lost when reloading. */
+   gl_texPin( tex );
+   gl_bindTexture( GL_TEXTURE_2D, tex->texture );
    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, horiz );
    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, vert );
    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_R, depth );
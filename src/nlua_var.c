@@ -26,6 +26,7 @@
 #include "nluadef.h"
 #include "nstring.h"
 #include "nxml.h"
+#include "strindex.h"
 
 
 
@@ -53,13 +54,16 @@ typedef struct misn_var_ {
 /*
  * variable stack
  */
-static misn_var* var_stack = NULL; /**< Stack of mission variables. */
+static misn_var* var_stack = NULL; /**< Stack of mission variables, in save order. */
+static StrIndex var_index; /**< Index of the variables by name. */
 
 
 /*
  * prototypes
  */
 /* static */
+static int var_find( const char *name );
+static void var_reindex (void);
 static int var_add( misn_var *var );
 static void var_free( misn_var* var );
 /* externed */
@@ -189,6 +193,30 @@ int var_load( xmlNodePtr parent )
 }
 
 
+/**
+ * @brief Finds a var on the stack.
+ *
+ *    @param name Name of the var.
+ *    @return Index of the var or -1 if it doesn't exist.
+ */
+static int var_find( const char *name )
+{
+   return strindex_get( &var_index, name );
+}
+
+
+/**
+ * @brief Rebuilds the index after vars were removed from the stack.
+ */
+static void var_reindex (void)
+{
+   int i;
+   strindex_clear( &var_index );
+   for (i=0; i<array_size(var_stack); i++)
+      strindex_add( &var_index, var_stack[i].name, i );
+}
+
+
 /**
  * @brief Adds a var to the stack, strings will be SHARED, don't free.
  *
@@ -204,17 +232,22 @@ static int var_add( misn_var *new_var )
       var_stack = array_create( misn_var );
 
    /* check if already exists */
-   for (i=0; i<array_size(var_stack); i++) {
-      if (strcmp(new_var->name,var_stack[i].name)==0) { /* overwrite */
-         var_free( &var_stack[i] );
-         var_stack[i] = *new_var;
-         return 0;
-      }
+   i = var_find( new_var->name );
+   if (i >= 0) { /* overwrite */
+      /* Keep the old name, the index points to it. */
+      mv = &var_stack[i];
+      free( new_var->name );
+      new_var->name = mv->name;
+      mv->name = NULL;
+      var_free( mv );
+      *mv = *new_var;
+      return 0;
    }
 
    /* need new one. */
    mv = &array_grow( &var_stack );
    *mv = *new_var;
+   strindex_add( &var_index, mv->name, array_size(var_stack)-1 );
 
    return 0;
 }
@@ -247,12 +280,7 @@ static int var_add( misn_var *new_var )
  */
 int var_checkflag( char* str )
 {
-   int i;
-
-   for (i=0; i<array_size(var_stack); i++)
-      if (strcmp(var_stack[i].name,str)==0)
-         return 1;
-   return 0;
+   return (var_find( str ) >= 0);
 }
 /**
  * @brief Gets the mission variable value of a certain name.
@@ -270,26 +298,25 @@ static int var_peek( lua_State *L )
    /* Get the parameter. */
    str = luaL_checkstring(L,1);
 
-   for (i=0; i<array_size(var_stack); i++)
-      if (strcmp(str,var_stack[i].name)==0) {
-         switch (var_stack[i].type) {
-            case MISN_VAR_NIL:
-               lua_pushnil(L);
-               break;
-            case MISN_VAR_NUM:
-               lua_pushnumber(L,var_stack[i].d.num);
-               break;
-            case MISN_VAR_BOOL:
-               lua_pushboolean(L,var_stack[i].d.b);
-               break;
-            case MISN_VAR_STR:
-               lua_pushstring(L,var_stack[i].d.str);
-               break;
-         }
-         return 1;
-      }
+   i = var_find( str );
+   if (i < 0)
+      return 0;
 
-   return 0;
+   switch (var_stack[i].type) {
+      case MISN_VAR_NIL:
+         lua_pushnil(L);
+         break;
+      case MISN_VAR_NUM:
+         lua_pushnumber(L,var_stack[i].d.num);
+         break;
+      case MISN_VAR_BOOL:
+         lua_pushboolean(L,var_stack[i].d.b);
+         break;
+      case MISN_VAR_STR:
+         lua_pushstring(L,var_stack[i].d.str);
+         break;
+   }
+   return 1;
 }
 /**
  * @brief Pops a mission variable off the stack, destroying it.
@@ -308,12 +335,14 @@ static int var_pop( lua_State *L )
 
    str = luaL_checkstring(L,1);
 
-   for (i=0; i<array_size(var_stack); i++)
-      if (strcmp(str,var_stack[i].name)==0) {
-         var_free( &var_stack[i] );
-         array_erase( &var_stack, &var_stack[i], &var_stack[i+1] );
-         return 0;
-      }
+   i = var_find( str );
+   if (i >= 0) {
+      /* Erasing keeps the save order, but moves the vars after it. */
+      var_free( &var_stack[i] );
+      array_erase( &var_stack, &var_stack[i], &var_stack[i+1] );
+      var_reindex();
+      return 0;
+   }
 
    /*NLUA_DEBUG("Var '%s' not found in stack", str);*/
    return 0;
@@ -396,5 +425,6 @@ void var_cleanup (void)
 
    array_free( var_stack );
    var_stack   = NULL;
+   strindex_free( &var_index );
 }
 
@@ -0,0 +1,613 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+
+/**
+ * @file npak.c
+ *
+ * @brief PhysicsFS archiver for Naev data packs.
+ *
+ * A pack is an uncompressed archive made with utils/build/npak.py, so files
+ *  can be read straight from it without decompressing or going through a
+ *  directory structure:
+ *
+ *  - Header: "NPAK", version, number of files and size of the names (all
+ *    little endian 32 bit integers).
+ *  - Index: offset and size (64 bit) and name offset (32 bit, padded to 64)
+ *    of each file, sorted by name.
+ *  - Names: NUL terminated paths relative to the pack root.
+ *  - Data: the contents of the files.
+ *
+ * Directories are implicit in the paths. Lookups are binary searches in the
+ *  index, and where possible the pack is mapped into memory so reads don't
+ *  need any system calls.
+ */
+
+
+/** @cond */
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "physfs.h"
+
+#include "naev.h"
+
+#if HAS_POSIX
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif /* HAS_POSIX */
+/** @endcond */
+
+#include "npak.h"
+
+#include "log.h"
+
+
+#define NPAK_MAGIC      "NPAK" /**< Magic at the start of a pack. */
+#define NPAK_VERSION    1 /**< Version of the pack format. */
+#define NPAK_HEADER     16 /**< Size of the header. */
+#define NPAK_ENTRY      24 /**< Size of an entry of the index. */
+
+
+/**
+ * @brief File in a pack.
+ */
+typedef struct NPakEntry_ {
+   PHYSFS_uint64 offset; /**< Offset of the data from the start of the pack. */
+   PHYSFS_uint64 size; /**< Size of the data. */
+   const char *name; /**< Path of the file. */
+} NPakEntry;
+
+
+/**
+ * @brief Mounted pack.
+ */
+typedef struct NPak_ {
+   PHYSFS_Io *io; /**< Io of the pack. */
+   NPakEntry *entries; /**< Files sorted by name. */
+   PHYSFS_uint32 nentries; /**< Number of files. */
+   char *names; /**< Names of the files. */
+   const unsigned char *map; /**< Pack mapped in memory, or NULL. */
+   size_t maplen; /**< Length of the mapping. */
+} NPak;
+
+
+/**
+ * @brief Open file of a pack.
+ */
+typedef struct NPakFile_ {
+   const NPak *pak; /**< Pack the file is in. */
+   const NPakEntry *entry; /**< Entry of the file. */
+   PHYSFS_uint64 pos; /**< Current position. */
+   PHYSFS_Io *io; /**< Own Io of the pack when not mapped. */
+} NPakFile;
+
+
+/*
+ * Prototypes.
+ */
+/* Index. */
+static int npak_lowerBound( const NPak *pak, const char *name );
+static const NPakEntry* npak_find( const NPak *pak, const char *name );
+static int npak_isDir( const NPak *pak, const char *name );
+/* Files. */
+static PHYSFS_Io* npak_fileIo( const NPak *pak, const NPakEntry *entry );
+static PHYSFS_sint64 npak_fileRead( PHYSFS_Io *io, void *buf, PHYSFS_uint64 len );
+static PHYSFS_sint64 npak_fileWrite( PHYSFS_Io *io, const void *buf, PHYSFS_uint64 len );
+static int npak_fileSeek( PHYSFS_Io *io, PHYSFS_uint64 offset );
+static PHYSFS_sint64 npak_fileTell( PHYSFS_Io *io );
+static PHYSFS_sint64 npak_fileLength( PHYSFS_Io *io );
+static PHYSFS_Io* npak_fileDuplicate( PHYSFS_Io *io );
+static int npak_fileFlush( PHYSFS_Io *io );
+static void npak_fileDestroy( PHYSFS_Io *io );
+/* Archiver. */
+static PHYSFS_uint32 npak_u32( const unsigned char *b );
+static PHYSFS_uint64 npak_u64( const unsigned char *b );
+static void* npak_openArchive( PHYSFS_Io *io, const char *name, int forWrite, int *claimed );
+static PHYSFS_EnumerateCallbackResult npak_enumerate( void *opaque, const char *dirname,
+      PHYSFS_EnumerateCallback cb, const char *origdir, void *callbackdata );
+static PHYSFS_Io* npak_openRead( void *opaque, const char *fnm );
+static PHYSFS_Io* npak_openWrite( void *opaque, const char *filename );
+static int npak_remove( void *opaque, const char *filename );
+static int npak_stat( void *opaque, const char *fn, PHYSFS_Stat *stat );
+static void npak_closeArchive( void *opaque );
+
+
+/**
+ * @brief The archiver of the packs.
+ */
+static const PHYSFS_Archiver npak_archiver = {
+   .version = 0,
+   .info = {
+      .extension        = NPAK_EXTENSION,
+      .description      = "Naev data pack",
+      .author           = "Naev Dev Team",
+      .url              = "https://naev.org",
+      .supportsSymlinks = 0,
+   },
+   .openArchive   = npak_openArchive,
+   .enumerate     = npak_enumerate,
+   .openRead      = npak_openRead,
+   .openWrite     = npak_openWrite,
+   .openAppend    = npak_openWrite,
+   .remove        = npak_remove,
+   .mkdir         = npak_remove,
+   .stat          = npak_stat,
+   .closeArchive  = npak_closeArchive,
+};
+
+
+/**
+ * @brief Registers the pack archiver with PhysicsFS.
+ *
+ * Must be called before mounting any packs.
+ *
+ *    @return 0 on success.
+ */
+int npak_register (void)
+{
+   if (!PHYSFS_registerArchiver( &npak_archiver )) {
+      WARN(_("Unable to register the data pack archiver: %s"),
+            PHYSFS_getErrorByCode( PHYSFS_getLastErrorCode() ) );
+      return -1;
+   }
+   return 0;
+}
+
+
+/**
+ * @brief Gets the first entry whose name is not less than a name.
+ */
+static int npak_lowerBound( const NPak *pak, const char *name )
+{
+   int l, h, m;
+
+   l = 0;
+   h = pak->nentries;
+   while (l < h) {
+      m = (l+h) / 2;
+      if (strcmp( pak->entries[m].name, name ) < 0)
+         l = m+1;
+      else
+         h = m;
+   }
+   return l;
+}
+
+
+/**
+ * @brief Finds a file in a pack.
+ */
+static const NPakEntry* npak_find( const NPak *pak, const char *name )
+{
+   int i = npak_lowerBound( pak, name );
+   if ((i < (int)pak->nentries) && (strcmp( pak->entries[i].name, name ) == 0))
+      return &pak->entries[i];
+   return NULL;
+}
+
+
+/**
+ * @brief Checks whether a path is a directory of a pack.
+ */
+static int npak_isDir( const NPak *pak, const char *name )
+{
+   int i;
+   size_t len;
+   char *prefix;
+   const char *found;
+
+   len = strlen( name );
+   if (len == 0)
+      return 1;
+
+   /* Any file under it makes it a directory. */
+   prefix = malloc( len+2 );
+   memcpy( prefix, name, len );
+   prefix[len]   = '/';
+   prefix[len+1] = '\0';
+   i = npak_lowerBound( pak, prefix );
+   found = (i < (int)pak->nentries) ? pak->entries[i].name : NULL;
+   i = (found != NULL) && (strncmp( found, prefix, len+1 ) == 0);
+   free( prefix );
+   return i;
+}
+
+
+/**
+ * @brief Creates an Io to read a file of a pack.
+ */
+static PHYSFS_Io* npak_fileIo( const NPak *pak, const NPakEntry *entry )
+{
+   PHYSFS_Io *io;
+   NPakFile *f;
+
+   f = calloc( 1, sizeof(NPakFile) );
+   f->pak   = pak;
+   f->entry = entry;
+   if (pak->map == NULL) {
+      /* Each file gets its own Io, so they can be read at the same time. */
+      f->io = pak->io->duplicate( pak->io );
+      if (f->io == NULL) {
+         free( f );
+         return NULL;
+      }
+   }
+
+   io = calloc( 1, sizeof(PHYSFS_Io) );
+   io->version    = 0;
+   io->opaque     = f;
+   io->read       = npak_fileRead;
+   io->write      = npak_fileWrite;
+   io->seek       = npak_fileSeek;
+   io->tell       = npak_fileTell;
+   io->length     = npak_fileLength;
+   io->duplicate  = npak_fileDuplicate;
+   io->flush      = npak_fileFlush;
+   io->destroy    = npak_fileDestroy;
+   return io;
+}
+
+
+/**
+ * @brief Reads from a file of a pack.
+ */
+static PHYSFS_sint64 npak_fileRead( PHYSFS_Io *io, void *buf, PHYSFS_uint64 len )
+{
+   NPakFile *f = io->opaque;
+   PHYSFS_sint64 n;
+
+   len = MIN( len, f->entry->size - f->pos );
+   if (len == 0)
+      return 0;
+
+   if (f->pak->map != NULL) {
+      memcpy( buf, &f->pak->map[ f->entry->offset + f->pos ], len );
+      n = len;
+   }
+   else {
+      if (!f->io->seek( f->io, f->entry->offset + f->pos ))
+         return -1;
+      n = f->io->read( f->io, buf, len );
+      if (n < 0)
+         return -1;
+   }
+   f->pos += n;
+   return n;
+}
+
+
+/**
+ * @brief Packs are read only.
+ */
+static PHYSFS_sint64 npak_fileWrite( PHYSFS_Io *io, const void *buf, PHYSFS_uint64 len )
+{
+   (void) io;
+   (void) buf;
+   (void) len;
+   PHYSFS_setErrorCode( PHYSFS_ERR_READ_ONLY );
+   return -1;
+}
+
+
+/**
+ * @brief Seeks in a file of a pack.
+ */
+static int npak_fileSeek( PHYSFS_Io *io, PHYSFS_uint64 offset )
+{
+   NPakFile *f = io->opaque;
+   if (offset > f->entry->size) {
+      PHYSFS_setErrorCode( PHYSFS_ERR_PAST_EOF );
+      return 0;
+   }
+   f->pos = offset;
+   return 1;
+}
+
+
+/**
+ * @brief Gets the position in a file of a pack.
+ */
+static PHYSFS_sint64 npak_fileTell( PHYSFS_Io *io )
+{
+   NPakFile *f = io->opaque;
+   return f->pos;
+}
+
+
+/**
+ * @brief Gets the length of a file of a pack.
+ */
+static PHYSFS_sint64 npak_fileLength( PHYSFS_Io *io )
+{
+   NPakFile *f = io->opaque;
+   return f->entry->size;
+}
+
+
+/**
+ * @brief Duplicates a file of a pack, the copy starts at the beginning.
+ */
+static PHYSFS_Io* npak_fileDuplicate( PHYSFS_Io *io )
+{
+   NPakFile *f = io->opaque;
+   return npak_fileIo( f->pak, f->entry );
+}
+
+
+/**
+ * @brief Nothing to flush in packs.
+ */
+static int npak_fileFlush( PHYSFS_Io *io )
+{
+   (void) io;
+   return 1;
+}
+
+
+/**
+ * @brief Closes a file of a pack.
+ */
+static void npak_fileDestroy( PHYSFS_Io *io )
+{
+   NPakFile *f = io->opaque;
+   if (f->io != NULL)
+      f->io->destroy( f->io );
+   free( f );
+   free( io );
+}
+
+
+/**
+ * @brief Reads a little endian 32 bit integer.
+ */
+static PHYSFS_uint32 npak_u32( const unsigned char *b )
+{
+   return (PHYSFS_uint32)b[0] | ((PHYSFS_uint32)b[1] << 8) |
+         ((PHYSFS_uint32)b[2] << 16) | ((PHYSFS_uint32)b[3] << 24);
+}
+
+
+/**
+ * @brief Reads a little endian 64 bit integer.
+ */
+static PHYSFS_uint64 npak_u64( const unsigned char *b )
+{
+   return (PHYSFS_uint64)npak_u32( b ) | ((PHYSFS_uint64)npak_u32( &b[4] ) << 32);
+}
+
+
+/**
+ * @brief Opens a pack, if the Io is one.
+ */
+static void* npak_openArchive( PHYSFS_Io *io, const char *name, int forWrite, int *claimed )
+{
+   unsigned char header[NPAK_HEADER], *index;
+   PHYSFS_uint32 i, n, namesize, nameoff;
+   PHYSFS_uint64 len;
+   NPak *pak;
+#if HAS_POSIX
+   int fd;
+   struct stat st;
+   void *map;
+#endif /* HAS_POSIX */
+
+   if (forWrite) {
+      PHYSFS_setErrorCode( PHYSFS_ERR_READ_ONLY );
+      return NULL;
+   }
+
+   /* Not a pack, let the other archivers have it. */
+   if ((io->read( io, header, NPAK_HEADER ) != NPAK_HEADER) ||
+         (memcmp( header, NPAK_MAGIC, 4 ) != 0)) {
+      PHYSFS_setErrorCode( PHYSFS_ERR_UNSUPPORTED );
+      return NULL;
+   }
+   *claimed = 1;
+   if (npak_u32( &header[4] ) != NPAK_VERSION) {
+      WARN(_("Data pack '%s' has unsupported version %u."), name, npak_u32( &header[4] ) );
+      PHYSFS_setErrorCode( PHYSFS_ERR_UNSUPPORTED );
+      return NULL;
+   }
+   n        = npak_u32( &header[8] );
+   namesize = npak_u32( &header[12] );
+   len      = io->length( io );
+
+   /* Load the index and the names. */
+   pak = calloc( 1, sizeof(NPak) );
+   pak->nentries = n;
+   pak->entries  = calloc( MAX( 1, n ), sizeof(NPakEntry) );
+   pak->names    = malloc( namesize+1 );
+   index         = malloc( MAX( 1, (size_t)n * NPAK_ENTRY ) );
+   if ((io->read( io, index, (PHYSFS_uint64)n * NPAK_ENTRY ) != (PHYSFS_sint64)n * NPAK_ENTRY) ||
+         (io->read( io, pak->names, namesize ) != namesize))
+      goto corrupt;
+   pak->names[namesize] = '\0';
+   for (i=0; i<n; i++) {
+      pak->entries[i].offset = npak_u64( &index[ i*NPAK_ENTRY ] );
+      pak->entries[i].size   = npak_u64( &index[ i*NPAK_ENTRY + 8 ] );
+      nameoff                = npak_u32( &index[ i*NPAK_ENTRY + 16 ] );
+      if ((nameoff >= namesize) ||
+            (pak->entries[i].offset > len) ||
+            (pak->entries[i].size > len - pak->entries[i].offset))
+         goto corrupt;
+      pak->entries[i].name = &pak->names[ nameoff ];
+      if ((i > 0) && (strcmp( pak->entries[i-1].name, pak->entries[i].name ) >= 0))
+         goto corrupt;
+   }
+   free( index );
+
+   /* Reads are much cheaper from memory. */
+#if HAS_POSIX
+   fd = open( name, O_RDONLY );
+   if (fd >= 0) {
+      if ((fstat( fd, &st ) == 0) && ((PHYSFS_uint64)st.st_size == len) && (len > 0)) {
+         map = mmap( NULL, len, PROT_READ, MAP_PRIVATE, fd, 0 );
+         if (map != MAP_FAILED) {
+            pak->map    = map;
+            pak->maplen = len;
+         }
+      }
+      close( fd );
+   }
+#endif /* HAS_POSIX */
+
+   pak->io = io;
+   DEBUG(_("Mounted data pack '%s' with %u files."), name, n);
+   return pak;
+
+corrupt:
+   WARN(_("Data pack '%s' is corrupt."), name);
+   free( index );
+   free( pak->names );
+   free( pak->entries );
+   free( pak );
+   PHYSFS_setErrorCode( PHYSFS_ERR_CORRUPT );
+   return NULL;
+}
+
+
+/**
+ * @brief Enumerates the files and directories in a directory of a pack.
+ */
+static PHYSFS_EnumerateCallbackResult npak_enumerate( void *opaque, const char *dirname,
+      PHYSFS_EnumerateCallback cb, const char *origdir, void *callbackdata )
+{
+   NPak *pak = opaque;
+   PHYSFS_EnumerateCallbackResult ret;
+   size_t len, clen, plen;
+   char *prefix, *child;
+   const char *name, *end;
+   int i;
+
+   len    = strlen( dirname );
+   prefix = malloc( len+2 );
+   memcpy( prefix, dirname, len );
+   if (len > 0)
+      prefix[len++] = '/';
+   prefix[len] = '\0';
+
+   /* Files in the directory are contiguous in the index, and the ones in the
+    * same subdirectory are next to each other. */
+   ret   = PHYSFS_ENUM_OK;
+   child = NULL;
+   plen  = 0;
+   for (i=npak_lowerBound( pak, prefix ); i<(int)pak->nentries; i++) {
+      name = pak->entries[i].name;
+      if (strncmp( name, prefix, len ) != 0)
+         break;
+      name += len;
+      end   = strchr( name, '/' );
+      clen  = (end != NULL) ? (size_t)(end - name) : strlen( name );
+
+      /* Subdirectory that was already listed. */
+      if ((child != NULL) && (clen == plen) && (strncmp( child, name, clen ) == 0))
+         continue;
+      free( child );
+      child = malloc( clen+1 );
+      memcpy( child, name, clen );
+      child[clen] = '\0';
+      plen = clen;
+
+      ret = cb( callbackdata, origdir, child );
+      if (ret != PHYSFS_ENUM_OK)
+         break;
+   }
+   free( child );
+   free( prefix );
+
+   if (ret == PHYSFS_ENUM_ERROR)
+      PHYSFS_setErrorCode( PHYSFS_ERR_APP_CALLBACK );
+   return ret;
+}
+
+
+/**
+ * @brief Opens a file of a pack.
+ */
+static PHYSFS_Io* npak_openRead( void *opaque, const char *fnm )
+{
+   NPak *pak = opaque;
+   const NPakEntry *entry;
+
+   entry = npak_find( pak, fnm );
+   if (entry == NULL) {
+      PHYSFS_setErrorCode( npak_isDir( pak, fnm ) ? PHYSFS_ERR_NOT_A_FILE : PHYSFS_ERR_NOT_FOUND );
+      return NULL;
+   }
+   return npak_fileIo( pak, entry );
+}
+
+
+/**
+ * @brief Packs are read only.
+ */
+static PHYSFS_Io* npak_openWrite( void *opaque, const char *filename )
+{
+   (void) opaque;
+   (void) filename;
+   PHYSFS_setErrorCode( PHYSFS_ERR_READ_ONLY );
+   return NULL;
+}
+
+
+/**
+ * @brief Packs are read only.
+ */
+static int npak_remove( void *opaque, const char *filename )
+{
+   (void) opaque;
+   (void) filename;
+   PHYSFS_setErrorCode( PHYSFS_ERR_READ_ONLY );
+   return 0;
+}
+
+
+/**
+ * @brief Gets information on a path of a pack.
+ */
+static int npak_stat( void *opaque, const char *fn, PHYSFS_Stat *stat )
+{
+   NPak *pak = opaque;
+   const NPakEntry *entry;
+
+   memset( stat, 0, sizeof(PHYSFS_Stat) );
+   stat->modtime    = -1;
+   stat->createtime = -1;
+   stat->accesstime = -1;
+   stat->readonly   = 1;
+
+   entry = npak_find( pak, fn );
+   if (entry != NULL) {
+      stat->filetype = PHYSFS_FILETYPE_REGULAR;
+      stat->filesize = entry->size;
+      return 1;
+   }
+   if (npak_isDir( pak, fn )) {
+      stat->filetype = PHYSFS_FILETYPE_DIRECTORY;
+      stat->filesize = 0;
+      return 1;
+   }
+
+   PHYSFS_setErrorCode( PHYSFS_ERR_NOT_FOUND );
+   return 0;
+}
+
+
+/**
+ * @brief Closes a pack.
+ */
+static void npak_closeArchive( void *opaque )
+{
+   NPak *pak = opaque;
+#if HAS_POSIX
+   if (pak->map != NULL)
+      munmap( (void*)pak->map, pak->maplen );
+#endif /* HAS_POSIX */
+   pak->io->destroy( pak->io );
+   free( pak->names );
+   free( pak->entries );
+   free( pak );
+}
@@ -0,0 +1,16 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+
+
+#ifndef NPAK_H
+#  define NPAK_H
+
+
+#define NPAK_EXTENSION  "npk" /**< Extension of Naev data packs. */
+
+
+int npak_register (void);
+
+
+#endif /* NPAK_H */
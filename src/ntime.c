@@ -47,7 +47,6 @@
 
 
 #define NT_SECONDS_DIV   (1000)      /* Divider for extracting seconds. */
-#define NT_SECONDS_DT    (30)        /* Update rate, how many seconds are in a real second. */
 #define NT_CYCLE_SECONDS   ((ntime_t)NT_CYCLE_PERIODS*(ntime_t)NT_PERIOD_SECONDS) /* Seconds in a cycle */
 #define NT_PERIODS_DIV   ((ntime_t)NT_PERIOD_SECONDS*(ntime_t)NT_SECONDS_DIV) /* Divider for extracting periods. */
 #define NT_CYCLES_DIV   ((ntime_t)NT_CYCLE_SECONDS*(ntime_t)NT_SECONDS_DIV) /* Divider for extracting cycles. */
@@ -14,6 +14,7 @@
 
 #define NT_CYCLE_PERIODS   (5000)      /**< periods in a cycle */
 #define NT_PERIOD_SECONDS   (10000)     /**< seconds in a period */
+#define NT_SECONDS_DT       (30)        /**< Update rate, how many seconds are in a real second. */
 
 
 typedef int64_t ntime_t;         /**< Core time type. */
@@ -10,6 +10,9 @@
 
 
 /** @cond */
+#include "libxml/xmlreader.h"
+#include "physfs.h"
+
 #include "naev.h"
 /** @endcond */
 
@@ -17,6 +20,26 @@
 
 #include "ndata.h"
 #include "nstring.h"
+#include "threadpool.h"
+
+
+#define XML_PARSE_CHUNK    8 /**< Files parsed per job by xml_parsePhysFSList. */
+
+
+/**
+ * @brief File being parsed by xml_parsePhysFSList.
+ */
+typedef struct XmlParseFile_ {
+   char *buf; /**< Contents of the file. */
+   size_t bufsize; /**< Size of the contents. */
+   xmlDocPtr doc; /**< Parsed document. */
+} XmlParseFile;
+
+
+/*
+ * Prototypes.
+ */
+static void xml_parseJob( void *data, int start, int end );
 
 
 /**
@@ -95,6 +118,173 @@ xmlDocPtr xml_parsePhysFS( const char* filename )
    return doc;
 }
 
+/**
+ * @brief Reads from a PhysFS file for libxml2.
+ */
+static int xml_streamRead( void *ctx, char *buf, int len )
+{
+   PHYSFS_sint64 n = PHYSFS_readBytes( ctx, buf, len );
+   return (n < 0) ? -1 : (int)n;
+}
+
+
+/**
+ * @brief Closes a PhysFS file for libxml2.
+ */
+static int xml_streamClose( void *ctx )
+{
+   return PHYSFS_close( ctx ) ? 0 : -1;
+}
+
+
+/**
+ * @brief Parses a PhysFS file one top level element at a time.
+ *
+ * Unlike xml_parsePhysFS(), the file is neither read into memory in one go
+ *  nor turned into a single tree. Each child of the root element is built
+ *  and passed to the callback, and freed once the callback returns, so only
+ *  one element is ever in memory.
+ *
+ *    @param filename PhysFS file name.
+ *    @param root Name the root element must have.
+ *    @param func Called with each child element of the root, parsing stops if
+ *                it returns nonzero.
+ *    @param data Passed to func.
+ *    @return 0 on success, 1 if stopped by the callback, negative on failure
+ *            (will warn user).
+ */
+int xml_streamPhysFS( const char *filename, const char *root,
+      int (*func)( xmlNodePtr node, void *data ), void *data )
+{
+   PHYSFS_file *file;
+   xmlTextReaderPtr reader;
+   xmlNodePtr node;
+   int ret;
+
+   file = PHYSFS_openRead( filename );
+   if (file == NULL) {
+      WARN( _("Unable to read data from '%s'"), filename );
+      return -1;
+   }
+   /* The reader closes the file from now on. */
+   reader = xmlReaderForIO( xml_streamRead, xml_streamClose, file, filename, NULL, 0 );
+   if (reader == NULL) {
+      WARN( _("Unable to parse document '%s'"), filename );
+      return -1;
+   }
+
+   /* Find the root. */
+   do {
+      ret = xmlTextReaderRead( reader );
+   } while ((ret == 1) && (xmlTextReaderNodeType( reader ) != XML_READER_TYPE_ELEMENT));
+   if ((ret != 1) || (strcmp( (const char*)xmlTextReaderConstName( reader ), root ) != 0)) {
+      WARN(_("Malformed %s file: missing root element '%s'"), filename, root);
+      xmlFreeTextReader( reader );
+      return -1;
+   }
+   if (xmlTextReaderIsEmptyElement( reader )) {
+      xmlFreeTextReader( reader );
+      return 0;
+   }
+
+   /* Go over the children, skipping over their subtrees. */
+   ret = xmlTextReaderRead( reader );
+   while ((ret == 1) && (xmlTextReaderDepth( reader ) > 0)) {
+      if (xmlTextReaderNodeType( reader ) != XML_READER_TYPE_ELEMENT) {
+         ret = xmlTextReaderRead( reader );
+         continue;
+      }
+      node = xmlTextReaderExpand( reader );
+      if (node == NULL) {
+         ret = -1;
+         break;
+      }
+      if (func( node, data )) {
+         xmlFreeTextReader( reader );
+         return 1;
+      }
+      ret = xmlTextReaderNext( reader );
+   }
+   xmlFreeTextReader( reader );
+
+   if (ret < 0) {
+      WARN( _("Unable to parse document '%s'"), filename );
+      return -1;
+   }
+   return 0;
+}
+
+
+/**
+ * @brief Parses a range of files, runs on worker threads so can't log.
+ */
+static void xml_parseJob( void *data, int start, int end )
+{
+   int i;
+   XmlParseFile *files = data;
+
+   for (i=start; i<end; i++)
+      if (files[i].buf != NULL)
+         files[i].doc = xmlParseMemory( files[i].buf, files[i].bufsize );
+}
+
+
+/**
+ * @brief Parses many PhysFS files at once, using the threadpool.
+ *
+ * Files are read in the background and parsed on worker threads. The
+ *  results are in the same order as the file names, so processing them is
+ *  deterministic.
+ *
+ *    @param filenames File names to parse, NULL entries are skipped.
+ *    @param n Number of file names.
+ *    @return Array (malloc) of n documents (must xmlFreeDoc each), with NULL
+ *            where the file was skipped or failed to load (will warn user).
+ */
+xmlDocPtr* xml_parsePhysFSList( char **filenames, int n )
+{
+   int i;
+   XmlParseFile *files;
+   NDataAsync **reads;
+   xmlDocPtr *docs;
+
+   docs = calloc( MAX(n,1), sizeof(xmlDocPtr) );
+   if (n <= 0)
+      return docs;
+
+   /* Start all the reads so they overlap, then collect them in order. */
+   files = calloc( n, sizeof(XmlParseFile) );
+   reads = calloc( n, sizeof(NDataAsync*) );
+   for (i=0; i<n; i++)
+      if (filenames[i] != NULL)
+         reads[i] = ndata_readAsync( filenames[i], 0 );
+   for (i=0; i<n; i++) {
+      if (reads[i] == NULL)
+         continue;
+      files[i].buf = ndata_readWait( reads[i], &files[i].bufsize );
+      if (files[i].buf == NULL)
+         WARN( _("Unable to read data from '%s'"), filenames[i] );
+   }
+   free( reads );
+
+   /* Parse in parallel. */
+   vpool_parallelFor( n, XML_PARSE_CHUNK, xml_parseJob, files );
+
+   /* Gather results. */
+   for (i=0; i<n; i++) {
+      if (files[i].buf == NULL)
+         continue;
+      docs[i] = files[i].doc;
+      if (docs[i] == NULL)
+         WARN( _("Unable to parse document '%s'"), filenames[i] );
+      free( files[i].buf );
+   }
+   free( files );
+
+   return docs;
+}
+
+
 int xmlw_saveTime( xmlTextWriterPtr writer, const char *name, time_t t )
 {
    xmlw_elem( writer, name, "%lu", t );
@@ -152,6 +152,9 @@ do {if (xmlTextWriterEndDocument(w) < 0) { \
  * Functions for generic complex reading.
  */
 xmlDocPtr xml_parsePhysFS( const char* filename );
+xmlDocPtr* xml_parsePhysFSList( char **filenames, int n );
+int xml_streamPhysFS( const char *filename, const char *root,
+      int (*func)( xmlNodePtr node, void *data ), void *data );
 glTexture* xml_parseTexture( xmlNodePtr node,
       const char *path, int defsx, int defsy,
       const unsigned int flags );
@@ -479,6 +479,66 @@ int nxml_unpersistLua( nlua_env env, xmlNodePtr parent )
 }
 
 
+/**
+ * @brief Persists all the nxml Lua data into a document of its own.
+ *
+ * The root of the document is the "lua" element the saves have, so it can be
+ *  unpersisted with nxml_unpersistLua() or written to a save with
+ *  nxml_writeLuaDoc() as if it came from the environment.
+ *
+ *    @param env Lua environment to persist.
+ *    @return The document or NULL on error.
+ */
+xmlDocPtr nxml_persistLuaDoc( nlua_env env )
+{
+   xmlDocPtr doc;
+   xmlTextWriterPtr writer;
+   int ret;
+
+   writer = xmlNewTextWriterDoc( &doc, 0 );
+   if (writer == NULL) {
+      WARN(_("Unable to create the XML writer to persist Lua data!"));
+      return NULL;
+   }
+
+   ret = (xmlTextWriterStartDocument( writer, NULL, "UTF-8", NULL ) < 0)
+         || (xmlTextWriterStartElement( writer, (xmlChar*)"lua" ) < 0)
+         || (nxml_persistLua( env, writer ) != 0)
+         || (xmlTextWriterEndElement( writer ) < 0)
+         || (xmlTextWriterEndDocument( writer ) < 0);
+   xmlFreeTextWriter( writer );
+
+   if (ret) {
+      xmlFreeDoc( doc );
+      return NULL;
+   }
+   return doc;
+}
+
+
+/**
+ * @brief Writes the data of a document from nxml_persistLuaDoc().
+ *
+ *    @param doc Document with the data.
+ *    @param writer XML Writer to use, positioned where nxml_persistLua() would write.
+ *    @return 0 on success.
+ */
+int nxml_writeLuaDoc( xmlDocPtr doc, xmlTextWriterPtr writer )
+{
+   xmlBufferPtr buf;
+   xmlNodePtr node;
+   int ret;
+
+   buf = xmlBufferCreate();
+   for (node=xmlDocGetRootElement(doc)->xmlChildrenNode; node!=NULL; node=node->next)
+      xmlNodeDump( buf, doc, node, 0, 0 );
+   ret = (xmlTextWriterWriteRawLen( writer, xmlBufferContent(buf), xmlBufferLength(buf) ) < 0) ? -1 : 0;
+   xmlBufferFree( buf );
+
+   return ret;
+}
+
+
 /**
  * @brief Checks whether saving the given string (from lua_tolstring)
  *        can be saved into an XML document without blowing up.
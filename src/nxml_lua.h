@@ -13,6 +13,8 @@
 
 int nxml_persistLua( nlua_env env, xmlTextWriterPtr writer );
 int nxml_unpersistLua( nlua_env env, xmlNodePtr parent );
+xmlDocPtr nxml_persistLuaDoc( nlua_env env );
+int nxml_writeLuaDoc( xmlDocPtr doc, xmlTextWriterPtr writer );
 
 
 #endif /* NXML_LUA_H */
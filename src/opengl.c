@@ -31,6 +31,7 @@
 
 
 /** @cond */
+#include <string.h>
 #include "physfsrwops.h"
 #include "SDL.h"
 #include "SDL_error.h"
@@ -41,9 +42,11 @@
 
 #include "opengl.h"
 
+#include "array.h"
 #include "conf.h"
 #include "log.h"
 #include "render.h"
+#include "threadpool.h"
 
 
 /*
@@ -56,7 +59,19 @@ glInfo gl_screen; /**< Gives data of current opengl settings. */
 static int gl_activated = 0; /**< Whether or not a window is activated. */
 
 
-static unsigned int colorblind_pp = 0; /**< Colorblind post-process shader id. */
+/**
+ * @brief Screenshot being read back or saved.
+ */
+typedef struct glScreenshot_ {
+   char *filename;   /**< File to save to. */
+   GLuint pbo;       /**< Pixel buffer being read into. */
+   int w;            /**< Width in pixels. */
+   int h;            /**< Height in pixels. */
+   int age;          /**< Frames since the read back was issued. */
+   GLubyte *pixels;  /**< Pixels copied out of the buffer, bottom row first. */
+} glScreenshot;
+static glScreenshot *gl_shots = NULL; /**< Screenshots being read back (array.h). */
+static SDL_atomic_t gl_shotsSaving; /**< Screenshots being saved on the threadpool. */
 
 
 /*
@@ -69,6 +84,17 @@ static int gl_view_h = 0; /* Viewport height. */
 gl_Matrix4 gl_view_matrix = {0};
 
 
+/*
+ * State cache, everything has to go through it to stay in sync.
+ */
+#define OPENGL_STATE_UNITS          16 /**< Texture units tracked by the state cache. */
+glStats gl_stats; /**< Counters since the last gl_statsReset(). */
+static GLuint gl_stateProgram = 0; /**< Program in use, 0 if not known. */
+static GLenum gl_stateUnit = GL_TEXTURE0; /**< Active texture unit. */
+static GLuint gl_stateTex[OPENGL_STATE_UNITS]; /**< 2D texture bound to each unit. */
+static GLenum gl_stateBlend[4]; /**< Blend function factors. */
+
+
 /*
  * prototypes
  */
@@ -90,41 +116,117 @@ static int gl_hint (void);
 /**
  * @brief Takes a screenshot.
  *
+ * Only starts reading back the screen, the file gets written by
+ *  gl_screenshotUpdate() a frame later.
+ *
  *    @param filename PhysicsFS path (e.g., "screenshots/screenshot042.png") of the file to save screenshot as.
  */
 void gl_screenshot( const char *filename )
 {
-   GLubyte *screenbuf;
+   glScreenshot *shot;
+
+   if (gl_shots == NULL)
+      gl_shots = array_create( glScreenshot );
+   shot           = &array_grow( &gl_shots );
+   shot->filename = strdup( filename );
+   shot->w        = gl_screen.rw;
+   shot->h        = gl_screen.rh;
+   shot->age      = 0;
+   shot->pixels   = NULL;
+
+   /* Read into a pixel buffer, which doesn't wait for the GPU. */
+   glGenBuffers( 1, &shot->pbo );
+   glBindBuffer( GL_PIXEL_PACK_BUFFER, shot->pbo );
+   glBufferData( GL_PIXEL_PACK_BUFFER, 3 * shot->w*shot->h, NULL, GL_STREAM_READ );
+   glPixelStorei(GL_PACK_ALIGNMENT, 1); /* Force them to pack the bytes. */
+   glReadPixels( 0, 0, shot->w, shot->h, GL_RGB, GL_UNSIGNED_BYTE, 0 );
+   glBindBuffer( GL_PIXEL_PACK_BUFFER, 0 );
+
+   /* Check to see if an error occurred. */
+   gl_checkErr();
+}
+
+
+/**
+ * @brief Flips and saves a screenshot as PNG on the threadpool.
+ */
+static int gl_screenshotJob( void *data )
+{
+   glScreenshot *shot = data;
    SDL_RWops *rw;
    SDL_Surface *surface;
    int i, w, h;
 
-   /* Allocate data. */
-   w           = gl_screen.rw;
-   h           = gl_screen.rh;
-   screenbuf   = malloc( sizeof(GLubyte) * 3 * w*h );
-   surface     = SDL_CreateRGBSurface( 0, w, h, 24, RGBAMASK );
-
-   /* Read pixels from buffer -- SLOW. */
-   glPixelStorei(GL_PACK_ALIGNMENT, 1); /* Force them to pack the bytes. */
-   glReadPixels( 0, 0, w, h, GL_RGB, GL_UNSIGNED_BYTE, screenbuf );
-
    /* Convert data. */
+   w        = shot->w;
+   h        = shot->h;
+   surface  = SDL_CreateRGBSurface( 0, w, h, 24, RGBAMASK );
    for (i=0; i<h; i++)
-      memcpy( (GLubyte*)surface->pixels + i * (3*w), &screenbuf[ (h - i - 1) * (3*w) ], 3*w );
-   free( screenbuf );
+      memcpy( (GLubyte*)surface->pixels + i * surface->pitch, &shot->pixels[ (h - i - 1) * (3*w) ], 3*w );
 
    /* Save PNG. */
-   if (!(rw = PHYSFSRWOPS_openWrite( filename )))
+   if (!(rw = PHYSFSRWOPS_openWrite( shot->filename )))
       WARN( _("Aborting screenshot") );
    else
       IMG_SavePNG_RW( surface, rw, 1 );
 
-   /* Check to see if an error occurred. */
-   gl_checkErr();
-
    /* Free memory. */
    SDL_FreeSurface( surface );
+   free( shot->pixels );
+   free( shot->filename );
+   free( shot );
+   SDL_AtomicDecRef( &gl_shotsSaving );
+   return 0;
+}
+
+
+/**
+ * @brief Copies out the pixels of the screenshots read back at least a frame
+ *        ago and hands them to the threadpool to be saved.
+ *
+ *    @param wait Whether to finish all the screenshots and wait for them to be saved.
+ */
+void gl_screenshotUpdate( int wait )
+{
+   int i;
+   glScreenshot *shot;
+   const GLubyte *map;
+   size_t size;
+
+   for (i=array_size(gl_shots)-1; i>=0; i--) {
+      /* By the next frame the GPU is done with it and mapping doesn't stall. */
+      if ((gl_shots[i].age++ < 1) && !wait)
+         continue;
+
+      shot  = malloc( sizeof(glScreenshot) );
+      *shot = gl_shots[i];
+      size  = 3 * shot->w*shot->h;
+      glBindBuffer( GL_PIXEL_PACK_BUFFER, shot->pbo );
+      map = glMapBufferRange( GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT );
+      if (map != NULL) {
+         shot->pixels = malloc( size );
+         memcpy( shot->pixels, map, size );
+         glUnmapBuffer( GL_PIXEL_PACK_BUFFER );
+      }
+      glBindBuffer( GL_PIXEL_PACK_BUFFER, 0 );
+      glDeleteBuffers( 1, &shot->pbo );
+      array_erase( &gl_shots, &gl_shots[i], &gl_shots[i+1] );
+      gl_checkErr();
+
+      if (shot->pixels == NULL) {
+         WARN(_("Unable to read back screenshot '%s'!"), shot->filename);
+         free( shot->filename );
+         free( shot );
+         continue;
+      }
+      SDL_AtomicIncRef( &gl_shotsSaving );
+      if (threadpool_newJob( gl_screenshotJob, shot ) != 0)
+         gl_screenshotJob( shot );
+   }
+
+   if (wait)
+      while (SDL_AtomicGet( &gl_shotsSaving ) > 0)
+         SDL_Delay( 1 );
 }
 
 
@@ -148,6 +250,28 @@ GLboolean gl_hasVersion( int major, int minor )
 }
 
 
+/**
+ * @brief Checks to see if the OpenGL context exposes an extension.
+ *
+ *    @param ext Name of the extension to check.
+ *    @return 1 if the extension is available.
+ */
+int gl_hasExtension( const char *ext )
+{
+   GLint i, n;
+   const char *s;
+
+   n = 0;
+   glGetIntegerv( GL_NUM_EXTENSIONS, &n );
+   for (i=0; i<n; i++) {
+      s = (const char*) glGetStringi( GL_EXTENSIONS, i );
+      if ((s != NULL) && (strcmp( s, ext ) == 0))
+         return 1;
+   }
+   return 0;
+}
+
+
 #ifdef DEBUGGING
 /**
  * @brief Checks and reports if there's been an error.
@@ -271,7 +395,8 @@ static int gl_createWindow( unsigned int flags )
    /* Create the window. */
    gl_screen.window = SDL_CreateWindow( APPNAME,
          SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
-         conf.width, conf.height, flags | SDL_WINDOW_SHOWN | SDL_WINDOW_RESIZABLE
+         conf.width, conf.height, flags | SDL_WINDOW_RESIZABLE
+                                   | (conf.headless ? SDL_WINDOW_HIDDEN : SDL_WINDOW_SHOWN)
                                    | SDL_WINDOW_ALLOW_HIGHDPI );
    if (gl_screen.window == NULL)
       ERR(_("Unable to create window! %s"), SDL_GetError());
@@ -292,7 +417,10 @@ static int gl_createWindow( unsigned int flags )
 
    /* Set Vsync. */
    if (conf.vsync) {
-      ret = SDL_GL_SetSwapInterval( 1 );
+      /* Prefer adaptive vsync, which doesn't stall frames that are late. */
+      ret = SDL_GL_SetSwapInterval( -1 );
+      if (ret != 0)
+         ret = SDL_GL_SetSwapInterval( 1 );
       if (ret == 0)
          gl_screen.flags |= OPENGL_VSYNC;
    } else {
@@ -305,6 +433,10 @@ static int gl_createWindow( unsigned int flags )
    gl_screen.fbo_tex[0] = GL_INVALID_VALUE;
    gl_screen.fbo[1] = GL_INVALID_VALUE;
    gl_screen.fbo_tex[1] = GL_INVALID_VALUE;
+   gl_screen.fbo_half = GL_INVALID_VALUE;
+   gl_screen.fbo_half_tex = GL_INVALID_VALUE;
+   gl_screen.fbo_game = GL_INVALID_VALUE;
+   gl_screen.fbo_game_tex = GL_INVALID_VALUE;
    SDL_GL_GetAttribute( SDL_GL_DEPTH_SIZE, &gl_screen.depth );
    gl_activated = 1; /* Opengl is now activated. */
 
@@ -374,12 +506,202 @@ static int gl_defState (void)
    glEnable(  GL_BLEND ); /* alpha blending ftw */
 
    /* Set the blending/shading model to use. */
-   glBlendFunc( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA ); /* good blend model */
+   gl_stateReset();
 
    return 0;
 }
 
 
+/**
+ * @brief Puts the state tracked by the state cache in a known state.
+ *
+ * Binds no program or textures and sets the default blending.
+ */
+void gl_stateReset (void)
+{
+   int i;
+
+   glUseProgram( 0 );
+   gl_stateProgram = 0;
+   for (i=0; i<OPENGL_STATE_UNITS; i++) {
+      glActiveTexture( GL_TEXTURE0 + i );
+      glBindTexture( GL_TEXTURE_2D, 0 );
+      gl_stateTex[i] = 0;
+   }
+   glActiveTexture( GL_TEXTURE0 );
+   gl_stateUnit = GL_TEXTURE0;
+   glBlendFuncSeparate( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA,
+         GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA ); /* good blend model */
+   gl_stateBlend[0] = GL_SRC_ALPHA;
+   gl_stateBlend[1] = GL_ONE_MINUS_SRC_ALPHA;
+   gl_stateBlend[2] = GL_SRC_ALPHA;
+   gl_stateBlend[3] = GL_ONE_MINUS_SRC_ALPHA;
+}
+
+
+/**
+ * @brief Gets the counters of the GL calls and starts counting again.
+ *
+ *    @param[out] last Where to store the counters, can be NULL.
+ */
+void gl_statsReset( glStats *last )
+{
+   if (last != NULL)
+      *last = gl_stats;
+   memset( &gl_stats, 0, sizeof(glStats) );
+}
+
+
+/**
+ * @brief Uses a program unless it is already in use.
+ *
+ * Nothing is drawn without a program, so unbinding one (program 0) is left
+ *  for the next program change instead of being done.
+ *
+ *    @param program Program to use.
+ */
+void gl_useProgram( GLuint program )
+{
+   if (program == 0)
+      return;
+   if (program == gl_stateProgram) {
+      gl_stats.skipped++;
+      return;
+   }
+   glUseProgram( program );
+   gl_stateProgram = program;
+   gl_stats.programs++;
+}
+
+
+/**
+ * @brief Deletes a program, making sure it's no longer in use.
+ *
+ *    @param program Program to delete.
+ */
+void gl_deleteProgram( GLuint program )
+{
+   if (program == gl_stateProgram) {
+      glUseProgram( 0 );
+      gl_stateProgram = 0;
+   }
+   glDeleteProgram( program );
+}
+
+
+/**
+ * @brief Sets the active texture unit unless it is already active.
+ *
+ *    @param unit Texture unit (GL_TEXTURE0 + n).
+ */
+void gl_activeTexture( GLenum unit )
+{
+   if (unit == gl_stateUnit) {
+      gl_stats.skipped++;
+      return;
+   }
+   glActiveTexture( unit );
+   gl_stateUnit = unit;
+   gl_stats.textures++;
+}
+
+
+/**
+ * @brief Binds a texture to the active unit unless it is already bound.
+ *
+ * Only 2D textures are tracked, other targets are always bound.
+ *
+ *    @param target Texture target.
+ *    @param texture Texture to bind.
+ */
+void gl_bindTexture( GLenum target, GLuint texture )
+{
+   GLenum unit = gl_stateUnit - GL_TEXTURE0;
+
+   if ((target == GL_TEXTURE_2D) && (unit < OPENGL_STATE_UNITS)) {
+      if (gl_stateTex[unit] == texture) {
+         gl_stats.skipped++;
+         return;
+      }
+      gl_stateTex[unit] = texture;
+   }
+   glBindTexture( target, texture );
+   gl_stats.textures++;
+}
+
+
+/**
+ * @brief Deletes textures, forgetting them if they are bound.
+ *
+ * Deleted names get reused, so a new texture could otherwise be taken for
+ *  one that is still bound.
+ *
+ *    @param n Number of textures.
+ *    @param textures Textures to delete.
+ */
+void gl_deleteTextures( GLsizei n, const GLuint *textures )
+{
+   int i, j;
+
+   /* Deleting unbinds them, which is the same as binding 0. */
+   for (i=0; i<n; i++)
+      for (j=0; j<OPENGL_STATE_UNITS; j++)
+         if (gl_stateTex[j] == textures[i])
+            gl_stateTex[j] = 0;
+   glDeleteTextures( n, textures );
+}
+
+
+/**
+ * @brief Sets the blend function for colour and alpha.
+ *
+ *    @param sfactor Source factor.
+ *    @param dfactor Destination factor.
+ */
+void gl_blendFunc( GLenum sfactor, GLenum dfactor )
+{
+   gl_blendFuncSeparate( sfactor, dfactor, sfactor, dfactor );
+}
+
+
+/**
+ * @brief Sets the blend function unless it is already set.
+ *
+ *    @param srcRGB Source colour factor.
+ *    @param dstRGB Destination colour factor.
+ *    @param srcA Source alpha factor.
+ *    @param dstA Destination alpha factor.
+ */
+void gl_blendFuncSeparate( GLenum srcRGB, GLenum dstRGB, GLenum srcA, GLenum dstA )
+{
+   if ((gl_stateBlend[0] == srcRGB) && (gl_stateBlend[1] == dstRGB) &&
+         (gl_stateBlend[2] == srcA) && (gl_stateBlend[3] == dstA)) {
+      gl_stats.skipped++;
+      return;
+   }
+   glBlendFuncSeparate( srcRGB, dstRGB, srcA, dstA );
+   gl_stateBlend[0] = srcRGB;
+   gl_stateBlend[1] = dstRGB;
+   gl_stateBlend[2] = srcA;
+   gl_stateBlend[3] = dstA;
+   gl_stats.blends++;
+}
+
+
+/**
+ * @brief Draws arrays, counting the draw call.
+ *
+ *    @param mode Primitive to draw.
+ *    @param first First vertex.
+ *    @param count Number of vertices.
+ */
+void gl_drawArrays( GLenum mode, GLint first, GLsizei count )
+{
+   glDrawArrays( mode, first, count );
+   gl_stats.draws++;
+}
+
+
 /**
  * @brief Sets up dimensions in gl_screen, including scaling as needed.
  *
@@ -507,6 +829,7 @@ int gl_init (void)
    glGenVertexArrays(1, &VaoId);
    glBindVertexArray(VaoId);
 
+   gl_initGlobals();
    shaders_load();
 
    /* Set colorblind shader if necessary. */
@@ -534,10 +857,22 @@ void gl_resize (void)
    for (i=0; i<2; i++) {
       if (gl_screen.fbo[i] != GL_INVALID_VALUE) {
          glDeleteFramebuffers( 1, &gl_screen.fbo[i] );
-         glDeleteTextures( 1, &gl_screen.fbo_tex[i] );
+         gl_deleteTextures( 1, &gl_screen.fbo_tex[i] );
       }
       gl_fboCreate( &gl_screen.fbo[i], &gl_screen.fbo_tex[i], gl_screen.rw, gl_screen.rh );
    }
+   if (gl_screen.fbo_half != GL_INVALID_VALUE) {
+      glDeleteFramebuffers( 1, &gl_screen.fbo_half );
+      gl_deleteTextures( 1, &gl_screen.fbo_half_tex );
+   }
+   gl_fboCreate( &gl_screen.fbo_half, &gl_screen.fbo_half_tex,
+         MAX( 1, gl_screen.rw/2 ), MAX( 1, gl_screen.rh/2 ) );
+   /* Full size so the scale can change without reallocating. */
+   if (gl_screen.fbo_game != GL_INVALID_VALUE) {
+      glDeleteFramebuffers( 1, &gl_screen.fbo_game );
+      gl_deleteTextures( 1, &gl_screen.fbo_game_tex );
+   }
+   gl_fboCreate( &gl_screen.fbo_game, &gl_screen.fbo_game_tex, gl_screen.rw, gl_screen.rh );
 
    gl_checkErr();
 }
@@ -661,21 +996,8 @@ GLint gl_stringToClamp( const char *s )
  */
 void gl_colorblind( int enable )
 {
-   LuaShader_t shader;
-   if (enable) {
-      if (colorblind_pp != 0)
-         return;
-      memset( &shader, 0, sizeof(LuaShader_t) );
-      shader.program    = shaders.colorblind.program;
-      shader.VertexPosition = shaders.colorblind.VertexPosition;
-      shader.ClipSpaceFromLocal = shaders.colorblind.ClipSpaceFromLocal;
-      shader.MainTex    = shaders.colorblind.MainTex;
-      colorblind_pp = render_postprocessAdd( &shader, PP_LAYER_FINAL, 99 );
-   } else {
-      if (colorblind_pp != 0)
-         render_postprocessRm( colorblind_pp );
-      colorblind_pp = 0;
-   }
+   /* Shares a pass with the gamma correction. */
+   render_setColorblind( enable );
 }
 
 
@@ -685,14 +1007,32 @@ void gl_colorblind( int enable )
 void gl_exit (void)
 {
    int i;
+
+   /* Finish saving screenshots. */
+   gl_screenshotUpdate( 1 );
+   array_free( gl_shots );
+   gl_shots = NULL;
+
    for (i=0; i<2; i++) {
       if (gl_screen.fbo[i] != GL_INVALID_VALUE) {
          glDeleteFramebuffers( 1, &gl_screen.fbo[i] );
-         glDeleteTextures( 1, &gl_screen.fbo_tex[i] );
+         gl_deleteTextures( 1, &gl_screen.fbo_tex[i] );
          gl_screen.fbo[i] = GL_INVALID_VALUE;
          gl_screen.fbo_tex[i] = GL_INVALID_VALUE;
       }
    }
+   if (gl_screen.fbo_half != GL_INVALID_VALUE) {
+      glDeleteFramebuffers( 1, &gl_screen.fbo_half );
+      gl_deleteTextures( 1, &gl_screen.fbo_half_tex );
+      gl_screen.fbo_half = GL_INVALID_VALUE;
+      gl_screen.fbo_half_tex = GL_INVALID_VALUE;
+   }
+   if (gl_screen.fbo_game != GL_INVALID_VALUE) {
+      glDeleteFramebuffers( 1, &gl_screen.fbo_game );
+      gl_deleteTextures( 1, &gl_screen.fbo_game_tex );
+      gl_screen.fbo_game = GL_INVALID_VALUE;
+      gl_screen.fbo_game_tex = GL_INVALID_VALUE;
+   }
 
    /* Exit the OpenGL subsystems. */
    gl_exitRender();
@@ -701,6 +1041,7 @@ void gl_exit (void)
    gl_exitMatrix();
 
    shaders_unload();
+   gl_exitGlobals();
 
    /* Shut down the subsystem */
    SDL_QuitSubSystem(SDL_INIT_VIDEO);
@@ -69,6 +69,10 @@ typedef struct glInfo_ {
    GLuint current_fbo; /**< Current framebuffer. */
    GLuint fbo[2]; /**< Framebuffers. */
    GLuint fbo_tex[2]; /**< Texture for framebuffers. */
+   GLuint fbo_half; /**< Half resolution framebuffer for post-processing. */
+   GLuint fbo_half_tex; /**< Texture for the half resolution framebuffer. */
+   GLuint fbo_game; /**< Framebuffer the game layer is drawn to at dynamic resolution. */
+   GLuint fbo_game_tex; /**< Texture for the dynamic resolution framebuffer. */
 } glInfo;
 extern glInfo gl_screen; /* local structure set with gl_init and co */
 
@@ -99,6 +103,7 @@ void gl_resize (void);
  * Extensions and version.
  */
 GLboolean gl_hasVersion( int major, int minor );
+int gl_hasExtension( const char *ext );
 
 
 /*
@@ -112,6 +117,32 @@ void gl_setDefViewport( int x, int y, int w, int h );
 int gl_setupFullscreen (void);
 
 
+/*
+ * State cache.
+ */
+/**
+ * @brief Counters of the GL calls made through the state cache.
+ */
+typedef struct glStats_ {
+   unsigned int draws; /**< Draw calls. */
+   unsigned int programs; /**< Program changes. */
+   unsigned int textures; /**< Texture unit and binding changes. */
+   unsigned int blends; /**< Blend function changes. */
+   unsigned int skipped; /**< Redundant state changes that were skipped. */
+} glStats;
+extern glStats gl_stats; /**< Counters since the last gl_statsReset(). */
+void gl_stateReset (void);
+void gl_statsReset( glStats *last );
+void gl_useProgram( GLuint program );
+void gl_deleteProgram( GLuint program );
+void gl_activeTexture( GLenum unit );
+void gl_bindTexture( GLenum target, GLuint texture );
+void gl_deleteTextures( GLsizei n, const GLuint *textures );
+void gl_blendFunc( GLenum sfactor, GLenum dfactor );
+void gl_blendFuncSeparate( GLenum srcRGB, GLenum dstRGB, GLenum srcA, GLenum dstA );
+void gl_drawArrays( GLenum mode, GLint first, GLsizei count );
+
+
 /*
  * misc
  */
@@ -119,6 +150,7 @@ void gl_colorblind( int enable );
 GLint gl_stringToFilter( const char *s );
 GLint gl_stringToClamp( const char *s );
 void gl_screenshot( const char *filename );
+void gl_screenshotUpdate( int wait );
 #ifdef DEBUGGING
 #define gl_checkErr()   gl_checkHandleError( __func__, __LINE__ )
 void gl_checkHandleError( const char *func, int line );
@@ -27,6 +27,9 @@
 
 
 /** @cond */
+#include <math.h>
+#include <stdlib.h>
+
 #include "naev.h"
 /** @endcond */
 
@@ -34,6 +37,7 @@
 
 #include "camera.h"
 #include "conf.h"
+#include "font.h"
 #include "gui.h"
 #include "log.h"
 #include "ndata.h"
@@ -42,6 +46,8 @@
 
 
 #define OPENGL_RENDER_VBO_SIZE      256 /**< Size of VBO. */
+#define OPENGL_BATCH_QUADS          1024 /**< Maximum quads per batch draw call. */
+#define OPENGL_BATCH_FLOATS         (2+2+2+4+1) /**< Floats per batch vertex (pos, tex, tex2, colour, inter). */
 
 
 static gl_vbo *gl_renderVBO = 0; /**< VBO for rendering stuff. */
@@ -54,13 +60,238 @@ static gl_vbo *gl_triangleVBO = 0;
 static int gl_renderVBOtexOffset = 0; /**< VBO texture offset. */
 static int gl_renderVBOcolOffset = 0; /**< VBO colour offset. */
 
+/* Sprite batching. */
+static gl_vbo *gl_batchVBO = NULL; /**< Streaming VBO for batched quads. */
+static GLfloat *gl_batchData = NULL; /**< Vertex data of the current batch. */
+static int gl_batchActive = 0; /**< Whether or not textures are being batched. */
+static int gl_batchCount = 0; /**< Quads in the current batch. */
+static GLuint gl_batchTexA = 0; /**< Main texture of the current batch. */
+static GLuint gl_batchTexB = 0; /**< Interpolation texture of the current batch. */
+
+/* Clipping. */
+static int gl_clipX = 0; /**< Real X position of the framebuffer being rendered to. */
+static int gl_clipY = 0; /**< Real Y position of the framebuffer being rendered to. */
+
 /*
  * prototypes
  */
+static void gl_batchQuad( const glTexture* ta, const glTexture* tb, double inter,
+      double x, double y, double w, double h,
+      double tx, double ty, double tw, double th,
+      const glColour *c, double angle );
+static void gl_batchTexCoord( const glTexture* t, double s, double u, GLfloat *d );
+static gl_Matrix4 gl_texMatrix( const glTexture* t,
+      double tx, double ty, double tw, double th );
+
+
+/**
+ * @brief Starts batching texture blits.
+ *
+ * Until gl_batchEnd() is called, gl_blitTexture() and
+ * gl_blitTextureInterpolate() queue quads that get drawn together in as few
+ * draw calls as possible. Anything else rendered in between must call
+ * gl_batchFlush() first so that ordering is kept.
+ */
+void gl_batchStart (void)
+{
+   gl_batchActive = 1;
+}
+
+
+/**
+ * @brief Draws all the queued quads.
+ */
+void gl_batchFlush (void)
+{
+   GLsizei stride;
+   GLuint offset;
+   gl_vbo *vbo;
+
+   if (gl_batchCount == 0)
+      return;
+
+   stride = sizeof(GLfloat) * OPENGL_BATCH_FLOATS;
+   vbo    = gl_vboStream( gl_batchVBO, stride * 6 * gl_batchCount, gl_batchData, &offset );
+
+   gl_useProgram(shaders.texture_batch.program);
+
+   /* Bind the textures. */
+   gl_activeTexture( GL_TEXTURE0 );
+   gl_bindTexture( GL_TEXTURE_2D, gl_batchTexA );
+   gl_activeTexture( GL_TEXTURE1 );
+   gl_bindTexture( GL_TEXTURE_2D, gl_batchTexB );
+   gl_activeTexture( GL_TEXTURE0 );
+
+   /* Set the vertex data. */
+   glEnableVertexAttribArray( shaders.texture_batch.vertex );
+   glEnableVertexAttribArray( shaders.texture_batch.tex_coord );
+   glEnableVertexAttribArray( shaders.texture_batch.tex_coord2 );
+   glEnableVertexAttribArray( shaders.texture_batch.vertex_color );
+   glEnableVertexAttribArray( shaders.texture_batch.vertex_inter );
+   gl_vboActivateAttribOffset( vbo, shaders.texture_batch.vertex,
+         offset, 2, GL_FLOAT, stride );
+   gl_vboActivateAttribOffset( vbo, shaders.texture_batch.tex_coord,
+         offset + sizeof(GLfloat) * 2, 2, GL_FLOAT, stride );
+   gl_vboActivateAttribOffset( vbo, shaders.texture_batch.tex_coord2,
+         offset + sizeof(GLfloat) * 4, 2, GL_FLOAT, stride );
+   gl_vboActivateAttribOffset( vbo, shaders.texture_batch.vertex_color,
+         offset + sizeof(GLfloat) * 6, 4, GL_FLOAT, stride );
+   gl_vboActivateAttribOffset( vbo, shaders.texture_batch.vertex_inter,
+         offset + sizeof(GLfloat) * 10, 1, GL_FLOAT, stride );
+
+   /* Set shader uniforms. */
+   glUniform1i(shaders.texture_batch.sampler1, 0);
+   glUniform1i(shaders.texture_batch.sampler2, 1);
+   gl_globalsUse();
+
+   /* Draw. */
+   gl_drawArrays( GL_TRIANGLES, 0, 6 * gl_batchCount );
+
+   /* Clear state. */
+   glDisableVertexAttribArray( shaders.texture_batch.vertex );
+   glDisableVertexAttribArray( shaders.texture_batch.tex_coord );
+   glDisableVertexAttribArray( shaders.texture_batch.tex_coord2 );
+   glDisableVertexAttribArray( shaders.texture_batch.vertex_color );
+   glDisableVertexAttribArray( shaders.texture_batch.vertex_inter );
+
+   /* anything failed? */
+   gl_checkErr();
+
+   gl_useProgram(0);
+
+   gl_batchCount = 0;
+}
+
+
+/**
+ * @brief Draws the queued quads and stops batching.
+ */
+void gl_batchEnd (void)
+{
+   gl_batchFlush();
+   gl_batchActive = 0;
+}
+
+
+/**
+ * @brief Queues a textured quad in the current batch.
+ *
+ * Parameters are the same as gl_blitTextureInterpolate(), with the rotation
+ *  of gl_blitTexture().
+ */
+static void gl_batchQuad( const glTexture* ta, const glTexture* tb, double inter,
+      double x, double y, double w, double h,
+      double tx, double ty, double tw, double th,
+      const glColour *c, double angle )
+{
+   /* Two triangles covering the unit square. */
+   static const double qx[6] = { 0., 1., 0., 0., 1., 1. };
+   static const double qy[6] = { 0., 0., 1., 1., 0., 1. };
+   int i;
+   double hw, hh, ca, sa, u, v, s, t;
+   GLfloat *d;
+
+   /* Evicted textures are skipped until they are reloaded. */
+   if (!gl_texUse( ta ) || !gl_texUse( tb ))
+      return;
+
+   /* Queued text goes below the sprites. */
+   gl_printBatchFlush();
+
+   /* Batches can only have one pair of textures. */
+   if ((gl_batchCount > 0) &&
+         ((gl_batchTexA != ta->texture) || (gl_batchTexB != tb->texture)))
+      gl_batchFlush();
+   else if (gl_batchCount >= OPENGL_BATCH_QUADS)
+      gl_batchFlush();
+   gl_batchTexA = ta->texture;
+   gl_batchTexB = tb->texture;
+
+   /* Must have colour for now. */
+   if (c == NULL)
+      c = &cWhite;
+
+   hw = w/2.;
+   hh = h/2.;
+   ca = cos(angle);
+   sa = sin(angle);
+   d  = &gl_batchData[ gl_batchCount * 6 * OPENGL_BATCH_FLOATS ];
+   for (i=0; i<6; i++) {
+      /* Rotate around the center. */
+      u = qx[i]*w - hw;
+      v = qy[i]*h - hh;
+      d[0] = x + hw + ca*u - sa*v;
+      d[1] = y + hh + sa*u + ca*v;
+
+      /* Texture coordinates, which differ if the textures are packed. */
+      s = tx + qx[i]*tw;
+      t = ty + qy[i]*th;
+      gl_batchTexCoord( ta, s, t, &d[2] );
+      gl_batchTexCoord( tb, s, t, &d[4] );
+
+      d[6] = c->r;
+      d[7] = c->g;
+      d[8] = c->b;
+      d[9] = c->a;
+      d[10] = inter;
+      d += OPENGL_BATCH_FLOATS;
+   }
+   gl_batchCount++;
+}
+
+
+/**
+ * @brief Gets the coordinates in the opengl texture of a texture position.
+ *
+ *    @param t Texture to get coordinates of.
+ *    @param s X position within the texture. [0:1]
+ *    @param u Y position within the texture. [0:1]
+ *    @param[out] d Where to store the two coordinates.
+ */
+static void gl_batchTexCoord( const glTexture* t, double s, double u, GLfloat *d )
+{
+   if (t->flags & OPENGL_TEX_VFLIP)
+      u = 1. - u;
+   d[0] = t->ox + s*t->ow;
+   d[1] = t->oy + u*t->oh;
+}
+
+
+/**
+ * @brief Gets the texture matrix to render part of a texture.
+ *
+ * Takes into account flipping and the position in the atlas if packed.
+ *
+ *    @param t Texture to render.
+ *    @param tx X position within the texture. [0:1]
+ *    @param ty Y position within the texture. [0:1]
+ *    @param tw Texture width. [0:1]
+ *    @param th Texture height. [0:1]
+ *    @return The texture matrix.
+ */
+static gl_Matrix4 gl_texMatrix( const glTexture* t,
+      double tx, double ty, double tw, double th )
+{
+   gl_Matrix4 tex_mat;
+
+   tex_mat = gl_Matrix4_Identity();
+   tex_mat = gl_Matrix4_Translate(tex_mat, t->ox, t->oy, 0);
+   tex_mat = gl_Matrix4_Scale(tex_mat, t->ow, t->oh, 1);
+   if (t->flags & OPENGL_TEX_VFLIP) {
+      tex_mat = gl_Matrix4_Translate(tex_mat, 0, 1, 0);
+      tex_mat = gl_Matrix4_Scale(tex_mat, 1, -1, 1);
+   }
+   tex_mat = gl_Matrix4_Translate(tex_mat, tx, ty, 0);
+   tex_mat = gl_Matrix4_Scale(tex_mat, tw, th, 1);
+   return tex_mat;
+}
+
 
 void gl_beginSolidProgram(gl_Matrix4 projection, const glColour *c)
 {
-   glUseProgram(shaders.solid.program);
+   gl_batchFlush();
+   gl_printBatchFlush();
+   gl_useProgram(shaders.solid.program);
    glEnableVertexAttribArray(shaders.solid.vertex);
    gl_uniformColor(shaders.solid.color, c);
    gl_Matrix4_Uniform(shaders.solid.projection, projection);
@@ -69,14 +300,16 @@ void gl_beginSolidProgram(gl_Matrix4 projection, const glColour *c)
 void gl_endSolidProgram (void)
 {
    glDisableVertexAttribArray(shaders.solid.vertex);
-   glUseProgram(0);
+   gl_useProgram(0);
    gl_checkErr();
 }
 
 
 void gl_beginSmoothProgram(gl_Matrix4 projection)
 {
-   glUseProgram(shaders.smooth.program);
+   gl_batchFlush();
+   gl_printBatchFlush();
+   gl_useProgram(shaders.smooth.program);
    glEnableVertexAttribArray(shaders.smooth.vertex);
    glEnableVertexAttribArray(shaders.smooth.vertex_color);
    gl_Matrix4_Uniform(shaders.smooth.projection, projection);
@@ -85,7 +318,7 @@ void gl_beginSmoothProgram(gl_Matrix4 projection)
 void gl_endSmoothProgram() {
    glDisableVertexAttribArray(shaders.smooth.vertex);
    glDisableVertexAttribArray(shaders.smooth.vertex_color);
-   glUseProgram(0);
+   gl_useProgram(0);
    gl_checkErr();
 }
 
@@ -145,11 +378,11 @@ void gl_renderRectH( const gl_Matrix4 *H, const glColour *c, int filled )
    gl_beginSolidProgram(*H, c);
    if (filled) {
       gl_vboActivateAttribOffset( gl_squareVBO, shaders.solid.vertex, 0, 2, GL_FLOAT, 0 );
-      glDrawArrays( GL_TRIANGLE_STRIP, 0, 4 );
+      gl_drawArrays( GL_TRIANGLE_STRIP, 0, 4 );
    }
    else {
       gl_vboActivateAttribOffset( gl_squareEmptyVBO, shaders.solid.vertex, 0, 2, GL_FLOAT, 0 );
-      glDrawArrays( GL_LINE_STRIP, 0, 5 );
+      gl_drawArrays( GL_LINE_STRIP, 0, 5 );
    }
    gl_endSolidProgram();
 }
@@ -172,7 +405,7 @@ void gl_renderCross( double x, double y, double r, const glColour *c )
 
    gl_beginSolidProgram(projection, c);
    gl_vboActivateAttribOffset( gl_crossVBO, shaders.solid.vertex, 0, 2, GL_FLOAT, 0 );
-   glDrawArrays( GL_LINES, 0, 4 );
+   gl_drawArrays( GL_LINES, 0, 4 );
    gl_endSolidProgram();
 }
 
@@ -198,7 +431,7 @@ void gl_renderTriangleEmpty( double x, double y, double a, double s, double leng
 
    gl_beginSolidProgram(projection, c);
    gl_vboActivateAttribOffset( gl_triangleVBO, shaders.solid.vertex, 0, 2, GL_FLOAT, 0 );
-   glDrawArrays( GL_LINE_STRIP, 0, 4 );
+   gl_drawArrays( GL_LINE_STRIP, 0, 4 );
    gl_endSolidProgram();
 }
 
@@ -228,10 +461,20 @@ void gl_blitTexture(  const glTexture* texture,
    double hw, hh;
    gl_Matrix4 projection, tex_mat;
 
-   glUseProgram(shaders.texture.program);
+   if (gl_batchActive) {
+      gl_batchQuad( texture, texture, 1., x, y, w, h, tx, ty, tw, th, c, angle );
+      return;
+   }
+
+   /* Evicted textures are skipped until they are reloaded. */
+   if (!gl_texUse( texture ))
+      return;
+
+   gl_printBatchFlush();
+   gl_useProgram(shaders.texture.program);
 
    /* Bind the texture. */
-   glBindTexture( GL_TEXTURE_2D, texture->texture);
+   gl_bindTexture( GL_TEXTURE_2D, texture->texture);
 
    /* Must have colour for now. */
    if (c == NULL)
@@ -256,9 +499,7 @@ void gl_blitTexture(  const glTexture* texture,
          0, 2, GL_FLOAT, 0 );
 
    /* Set the texture. */
-   tex_mat = (texture->flags & OPENGL_TEX_VFLIP) ? gl_Matrix4_Ortho(-1, 1, 2, 0, 1, -1) : gl_Matrix4_Identity();
-   tex_mat = gl_Matrix4_Translate(tex_mat, tx, ty, 0);
-   tex_mat = gl_Matrix4_Scale(tex_mat, tw, th, 1);
+   tex_mat = gl_texMatrix( texture, tx, ty, tw, th );
 
    /* Set shader uniforms. */
    gl_uniformColor(shaders.texture.color, c);
@@ -266,7 +507,7 @@ void gl_blitTexture(  const glTexture* texture,
    gl_Matrix4_Uniform(shaders.texture.tex_mat, tex_mat);
 
    /* Draw. */
-   glDrawArrays( GL_TRIANGLE_STRIP, 0, 4 );
+   gl_drawArrays( GL_TRIANGLE_STRIP, 0, 4 );
 
    /* Clear state. */
    glDisableVertexAttribArray( shaders.texture.vertex );
@@ -274,7 +515,7 @@ void gl_blitTexture(  const glTexture* texture,
    /* anything failed? */
    gl_checkErr();
 
-   glUseProgram(0);
+   gl_useProgram(0);
 }
 
 
@@ -321,13 +562,31 @@ void gl_blitTextureInterpolate(  const glTexture* ta,
 
    gl_Matrix4 projection, tex_mat;
 
-   glUseProgram(shaders.texture_interpolate.program);
+   if (gl_batchActive) {
+      gl_batchQuad( ta, tb, inter, x, y, w, h, tx, ty, tw, th, c, 0. );
+      return;
+   }
+
+   /* Packed textures can need different coordinates, which only the batch supports. */
+   if ((ta->flags | tb->flags) & OPENGL_TEX_ATLAS) {
+      gl_batchStart();
+      gl_batchQuad( ta, tb, inter, x, y, w, h, tx, ty, tw, th, c, 0. );
+      gl_batchEnd();
+      return;
+   }
+
+   /* Evicted textures are skipped until they are reloaded. */
+   if (!gl_texUse( ta ) || !gl_texUse( tb ))
+      return;
+
+   gl_printBatchFlush();
+   gl_useProgram(shaders.texture_interpolate.program);
 
    /* Bind the textures. */
-   glActiveTexture( GL_TEXTURE0 );
-   glBindTexture( GL_TEXTURE_2D, ta->texture);
-   glActiveTexture( GL_TEXTURE1 );
-   glBindTexture( GL_TEXTURE_2D, tb->texture);
+   gl_activeTexture( GL_TEXTURE0 );
+   gl_bindTexture( GL_TEXTURE_2D, ta->texture);
+   gl_activeTexture( GL_TEXTURE1 );
+   gl_bindTexture( GL_TEXTURE_2D, tb->texture);
 
    /* Must have colour for now. */
    if (c == NULL)
@@ -341,9 +600,7 @@ void gl_blitTextureInterpolate(  const glTexture* ta,
    gl_vboActivateAttribOffset( gl_squareVBO, shaders.texture_interpolate.vertex, 0, 2, GL_FLOAT, 0 );
 
    /* Set the texture. */
-   tex_mat = (ta->flags & OPENGL_TEX_VFLIP) ? gl_Matrix4_Ortho(-1, 1, 2, 0, 1, -1) : gl_Matrix4_Identity();
-   tex_mat = gl_Matrix4_Translate(tex_mat, tx, ty, 0);
-   tex_mat = gl_Matrix4_Scale(tex_mat, tw, th, 1);
+   tex_mat = gl_texMatrix( ta, tx, ty, tw, th );
 
    /* Set shader uniforms. */
    glUniform1i(shaders.texture_interpolate.sampler1, 0);
@@ -354,16 +611,16 @@ void gl_blitTextureInterpolate(  const glTexture* ta,
    gl_Matrix4_Uniform(shaders.texture_interpolate.tex_mat, tex_mat);
 
    /* Draw. */
-   glDrawArrays( GL_TRIANGLE_STRIP, 0, 4 );
+   gl_drawArrays( GL_TRIANGLE_STRIP, 0, 4 );
 
    /* Clear state. */
    glDisableVertexAttribArray( shaders.texture_interpolate.vertex );
-   glActiveTexture( GL_TEXTURE0 );
+   gl_activeTexture( GL_TEXTURE0 );
 
    /* anything failed? */
    gl_checkErr();
 
-   glUseProgram(0);
+   gl_useProgram(0);
 }
 
 
@@ -674,8 +931,11 @@ void gl_drawCircleH( const gl_Matrix4 *H, const glColour *c, int filled )
    // TODO handle shearing and different x/y scaling
    GLfloat r = H->m[0][0] / gl_view_matrix.m[0][0];
 
+   gl_batchFlush();
+   gl_printBatchFlush();
+
    if (filled) {
-      glUseProgram( shaders.circle_filled.program );
+      gl_useProgram( shaders.circle_filled.program );
 
       glEnableVertexAttribArray( shaders.circle_filled.vertex );
       gl_vboActivateAttribOffset( gl_circleVBO, shaders.circle_filled.vertex,
@@ -687,13 +947,13 @@ void gl_drawCircleH( const gl_Matrix4 *H, const glColour *c, int filled )
       glUniform1f( shaders.circle_filled.radius, r );
 
       /* Draw. */
-      glDrawArrays( GL_TRIANGLE_STRIP, 0, 4 );
+      gl_drawArrays( GL_TRIANGLE_STRIP, 0, 4 );
 
       /* Clear state. */
       glDisableVertexAttribArray( shaders.circle_filled.vertex );
    }
    else {
-      glUseProgram( shaders.circle.program );
+      gl_useProgram( shaders.circle.program );
 
       glEnableVertexAttribArray( shaders.circle.vertex );
       gl_vboActivateAttribOffset( gl_circleVBO, shaders.circle.vertex,
@@ -705,12 +965,12 @@ void gl_drawCircleH( const gl_Matrix4 *H, const glColour *c, int filled )
       glUniform1f( shaders.circle.radius, r );
 
       /* Draw. */
-      glDrawArrays( GL_TRIANGLE_STRIP, 0, 4 );
+      gl_drawArrays( GL_TRIANGLE_STRIP, 0, 4 );
 
       /* Clear state. */
       glDisableVertexAttribArray( shaders.circle.vertex );
    }
-   glUseProgram(0);
+   gl_useProgram(0);
 
    /* Check errors. */
    gl_checkErr();
@@ -743,7 +1003,7 @@ void gl_drawLine( const double x1, const double y1,
 
    gl_beginSolidProgram(projection, c);
    gl_vboActivateAttribOffset( gl_lineVBO, shaders.solid.vertex, 0, 2, GL_FLOAT, 0 );
-   glDrawArrays( GL_LINES, 0, 2 );
+   gl_drawArrays( GL_LINES, 0, 2 );
    gl_endSolidProgram();
 }
 
@@ -759,20 +1019,41 @@ void gl_drawLine( const double x1, const double y1,
 void gl_clipRect( int x, int y, int w, int h )
 {
    double rx, ry, rw, rh;
-   rx = (x + gl_screen.x) / gl_screen.mxscale;
-   ry = (y + gl_screen.y) / gl_screen.myscale;
+   rx = (x + gl_screen.x) / gl_screen.mxscale - gl_clipX;
+   ry = (y + gl_screen.y) / gl_screen.myscale - gl_clipY;
    rw = w / gl_screen.mxscale;
    rh = h / gl_screen.myscale;
+   gl_batchFlush();
+   gl_printBatchFlush();
    glScissor( rx, ry, rw, rh );
    glEnable( GL_SCISSOR_TEST );
 }
 
 
+/**
+ * @brief Sets where the framebuffer being rendered to is on the screen.
+ *
+ * Needed when rendering screen coordinates to a framebuffer smaller than the
+ *  screen through an offset viewport, since clipping is done in framebuffer
+ *  pixels.
+ *
+ *    @param x Real X position of the framebuffer on the screen.
+ *    @param y Real Y position of the framebuffer on the screen.
+ */
+void gl_clipOffset( int x, int y )
+{
+   gl_clipX = x;
+   gl_clipY = y;
+}
+
+
 /**
  * @brief Clears the 2d clipping planes.
  */
 void gl_unclipRect (void)
 {
+   gl_batchFlush();
+   gl_printBatchFlush();
    glDisable( GL_SCISSOR_TEST );
    glScissor( 0, 0, gl_screen.rw, gl_screen.rh );
 }
@@ -851,6 +1132,10 @@ int gl_initRender (void)
    vertex[7] = vertex[1];
    gl_triangleVBO = gl_vboCreateStatic( sizeof(GLfloat) * 8, vertex );
 
+   /* Sprite batching. */
+   gl_batchData = malloc( sizeof(GLfloat) * 6 * OPENGL_BATCH_FLOATS * OPENGL_BATCH_QUADS );
+   gl_batchVBO = gl_vboCreateStream( sizeof(GLfloat) * 6 * OPENGL_BATCH_FLOATS * OPENGL_BATCH_QUADS, NULL );
+
    gl_checkErr();
 
    return 0;
@@ -870,5 +1155,9 @@ void gl_exitRender (void)
    gl_vboDestroy( gl_crossVBO );
    gl_vboDestroy( gl_lineVBO );
    gl_vboDestroy( gl_triangleVBO );
+   gl_vboDestroy( gl_batchVBO );
    gl_renderVBO = NULL;
+   gl_batchVBO = NULL;
+   free( gl_batchData );
+   gl_batchData = NULL;
 }
@@ -19,6 +19,14 @@ int gl_initRender (void);
 void gl_exitRender (void);
 
 
+/*
+ * Batching.
+ */
+void gl_batchStart (void);
+void gl_batchFlush (void);
+void gl_batchEnd (void);
+
+
 /*
  * Coordinate translation.
  */
@@ -102,6 +110,7 @@ void gl_renderTriangleEmpty( double x, double y, double a, double s, double leng
 /* Clipping. */
 void gl_clipRect( int x, int y, int w, int h );
 void gl_unclipRect (void);
+void gl_clipOffset( int x, int y );
 
 
 #endif /* OPENGL_RENDER_H */
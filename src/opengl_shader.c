@@ -8,7 +8,9 @@
 
 #include "conf.h"
 #include "log.h"
+#include "md5.h"
 #include "ndata.h"
+#include "nfile.h"
 #include "nstring.h"
 #include "opengl.h"
 
@@ -16,6 +18,46 @@
 #define GLSL_VERSION    "#version 140\n\n" /**< Version to use for all shaders. */
 #define GLSL_SUBROUTINE "#define HAS_GL_ARB_shader_subroutine 1\n" /**< Has subroutines. */
 
+#define SHADER_CACHE_VERSION  1 /**< Bump to invalidate all cached program binaries. */
+
+/* GL_ARB_get_program_binary (core in OpenGL 4.1), not part of our loader. */
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT   0x8257
+#endif
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH             0x8741
+#endif
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#define GL_NUM_PROGRAM_BINARY_FORMATS        0x87FE
+#endif
+typedef void (APIENTRYP glGetProgramBinaryFunc)( GLuint program, GLsizei bufSize, GLsizei *length, GLenum *binaryFormat, void *binary );
+typedef void (APIENTRYP glProgramBinaryFunc)( GLuint program, GLenum binaryFormat, const void *binary, GLsizei length );
+typedef void (APIENTRYP glProgramParameteriFunc)( GLuint program, GLenum pname, GLint value );
+
+
+/*
+ * Program binary cache.
+ */
+static int gl_binarySupport = -1; /**< Whether program binaries can be used, -1 if not checked yet. */
+static glGetProgramBinaryFunc gl_getProgramBinary = NULL; /**< glGetProgramBinary. */
+static glProgramBinaryFunc gl_programBinary       = NULL; /**< glProgramBinary. */
+static glProgramParameteriFunc gl_programParameteri = NULL; /**< glProgramParameteri. */
+
+
+/**
+ * @brief Layout of the globals uniform block, matches std140 in lib/globals.glsl.
+ */
+typedef struct glGlobals_ {
+   GLfloat view[16];    /**< Current view matrix. */
+   GLfloat screen[4];   /**< Screen width, height and their inverses. */
+   GLfloat time;        /**< Real time in seconds. */
+   GLfloat pad[3];      /**< std140 padding. */
+} glGlobals;
+static GLuint gl_globalsUBO = 0; /**< Buffer holding the globals block. */
+static glGlobals gl_globals; /**< What was last uploaded to gl_globalsUBO. */
+static int gl_globalsDirty = 1; /**< Whether gl_globals has to be uploaded. */
+static double gl_globalsTime = 0.; /**< Real time elapsed. */
+
 
 /*
  * Prototypes.
@@ -26,7 +68,15 @@ static char* gl_shader_loadfile( const char *filename, size_t *size, const char
 static GLuint gl_shader_compile( GLuint type, const char *buf,
       GLint length, const char *filename);
 static int gl_program_link( GLuint program );
+static void gl_program_globals( GLuint program );
 static GLuint gl_program_make( GLuint vertex_shader, GLuint fragment_shader );
+static GLuint gl_program_cached( const char *vert, size_t vert_size, const char *frag, size_t frag_size,
+      const char *vertfile, const char *fragfile );
+/* Program binary cache. */
+static int gl_binaryHas (void);
+static char* gl_binaryPath( const char *vert, size_t vert_size, const char *frag, size_t frag_size );
+static GLuint gl_binaryLoad( const char *cachefile );
+static void gl_binarySave( GLuint program, const char *cachefile );
 
 
 /**
@@ -235,7 +285,7 @@ GLuint gl_program_vert_frag( const char *vertfile, const char *fragfile )
 {
    char *vert_str, *frag_str, prepend[STRMAX];
    size_t vert_size, frag_size;
-   GLuint vertex_shader, fragment_shader, program;
+   GLuint program;
 
    strncpy( prepend, GLSL_VERSION, sizeof(prepend)-1 );
    if (gl_has( OPENGL_SUBROUTINES ))
@@ -244,13 +294,11 @@ GLuint gl_program_vert_frag( const char *vertfile, const char *fragfile )
    vert_str = gl_shader_loadfile( vertfile, &vert_size, prepend );
    frag_str = gl_shader_loadfile( fragfile, &frag_size, prepend );
 
-   vertex_shader     = gl_shader_compile( GL_VERTEX_SHADER, vert_str, vert_size, vertfile );
-   fragment_shader   = gl_shader_compile( GL_FRAGMENT_SHADER, frag_str, frag_size, fragfile );
+   program = gl_program_cached( vert_str, vert_size, frag_str, frag_size, vertfile, fragfile );
 
    free( vert_str );
    free( frag_str );
 
-   program = gl_program_make( vertex_shader, fragment_shader );
    if (program==0)
       WARN(_("Failed to link vertex shader '%s' and fragment shader '%s'!"), vertfile, fragfile);
 
@@ -269,23 +317,150 @@ GLuint gl_program_vert_frag( const char *vertfile, const char *fragfile )
  */
 GLuint gl_program_vert_frag_string( const char *vert, size_t vert_size, const char *frag, size_t frag_size )
 {
-   GLuint vertex_shader, fragment_shader;
+   GLuint program;
    char *vbuf, *fbuf;
    size_t vlen, flen;
 
    vbuf = gl_shader_preprocess( &vlen, vert, vert_size, NULL, NULL );
    fbuf = gl_shader_preprocess( &flen, frag, frag_size, NULL, NULL );
 
-   /* Compile the shaders. */
-   vertex_shader     = gl_shader_compile( GL_VERTEX_SHADER, vbuf, vlen, NULL );
-   fragment_shader   = gl_shader_compile( GL_FRAGMENT_SHADER, fbuf, flen, NULL );
+   /* Compile and link, or load from the cache. */
+   program = gl_program_cached( vbuf, vlen, fbuf, flen, NULL, NULL );
 
    /* Clean up. */
    free( vbuf );
    free( fbuf );
 
-   /* Link. */
-   return gl_program_make( vertex_shader, fragment_shader );
+   return program;
+}
+
+
+/**
+ * @brief Gets a program from preprocessed sources, using the binary cache when possible.
+ *
+ *    @param vert Preprocessed vertex shader.
+ *    @param vert_size Size of the vertex shader.
+ *    @param frag Preprocessed fragment shader.
+ *    @param frag_size Size of the fragment shader.
+ *    @param vertfile Name of the vertex shader for errors or NULL.
+ *    @param fragfile Name of the fragment shader for errors or NULL.
+ *    @return The shader program or 0 on failure.
+ */
+static GLuint gl_program_cached( const char *vert, size_t vert_size, const char *frag, size_t frag_size,
+      const char *vertfile, const char *fragfile )
+{
+   char *cachefile;
+   GLuint vertex_shader, fragment_shader, program;
+
+   cachefile = NULL;
+   if (gl_binaryHas()) {
+      cachefile = gl_binaryPath( vert, vert_size, frag, frag_size );
+      program   = gl_binaryLoad( cachefile );
+      if (program != 0) {
+         free( cachefile );
+         gl_program_globals( program );
+         return program;
+      }
+   }
+
+   /* Cache miss, compile from source. */
+   vertex_shader     = gl_shader_compile( GL_VERTEX_SHADER, vert, vert_size, vertfile );
+   fragment_shader   = gl_shader_compile( GL_FRAGMENT_SHADER, frag, frag_size, fragfile );
+   program = gl_program_make( vertex_shader, fragment_shader );
+
+   if ((program != 0) && (cachefile != NULL))
+      gl_binarySave( program, cachefile );
+   free( cachefile );
+
+   if (program != 0)
+      gl_program_globals( program );
+
+   return program;
+}
+
+
+/**
+ * @brief Binds the globals block of a program, if it uses it.
+ *
+ *    @param program Linked program.
+ */
+static void gl_program_globals( GLuint program )
+{
+   GLuint block;
+
+   block = glGetUniformBlockIndex( program, "Globals" );
+   if (block != GL_INVALID_INDEX)
+      glUniformBlockBinding( program, block, GL_GLOBALS_BINDING );
+   gl_checkErr();
+}
+
+
+/**
+ * @brief Initializes the buffer holding the shared shader state.
+ *
+ *    @return 0 on success.
+ */
+int gl_initGlobals (void)
+{
+   glGenBuffers( 1, &gl_globalsUBO );
+   glBindBuffer( GL_UNIFORM_BUFFER, gl_globalsUBO );
+   glBufferData( GL_UNIFORM_BUFFER, sizeof(glGlobals), NULL, GL_DYNAMIC_DRAW );
+   glBindBuffer( GL_UNIFORM_BUFFER, 0 );
+
+   /* The buffer stays bound for all programs. */
+   glBindBufferBase( GL_UNIFORM_BUFFER, GL_GLOBALS_BINDING, gl_globalsUBO );
+   gl_globalsDirty = 1;
+
+   gl_checkErr();
+   return 0;
+}
+
+
+/**
+ * @brief Cleans up the shared shader state.
+ */
+void gl_exitGlobals (void)
+{
+   glDeleteBuffers( 1, &gl_globalsUBO );
+   gl_globalsUBO = 0;
+}
+
+
+/**
+ * @brief Updates the per-frame part of the shared shader state.
+ *
+ *    @param dt Real time elapsed since the last frame.
+ */
+void gl_globalsFrame( double dt )
+{
+   gl_globalsTime += dt;
+   gl_globals.time      = gl_globalsTime;
+   gl_globals.screen[0] = gl_screen.w;
+   gl_globals.screen[1] = gl_screen.h;
+   gl_globals.screen[2] = 1. / gl_screen.w;
+   gl_globals.screen[3] = 1. / gl_screen.h;
+   gl_globalsDirty = 1;
+}
+
+
+/**
+ * @brief Makes sure the shared shader state is up to date before drawing.
+ *
+ * Only uploads when something changed, which is once per frame unless the
+ * view matrix is modified while rendering.
+ */
+void gl_globalsUse (void)
+{
+   if (!gl_globalsDirty &&
+         (memcmp( gl_globals.view, gl_view_matrix.m, sizeof(gl_globals.view) ) == 0))
+      return;
+
+   memcpy( gl_globals.view, gl_view_matrix.m, sizeof(gl_globals.view) );
+   glBindBuffer( GL_UNIFORM_BUFFER, gl_globalsUBO );
+   glBufferSubData( GL_UNIFORM_BUFFER, 0, sizeof(glGlobals), &gl_globals );
+   glBindBuffer( GL_UNIFORM_BUFFER, 0 );
+   gl_globalsDirty = 0;
+   gl_checkErr();
 }
 
 
@@ -303,6 +478,8 @@ static GLuint gl_program_make( GLuint vertex_shader, GLuint fragment_shader )
       program = glCreateProgram();
       glAttachShader(program, vertex_shader);
       glAttachShader(program, fragment_shader);
+      if (gl_binaryHas())
+         gl_programParameteri( program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE );
       if (gl_program_link(program) == -1) {
          /* Spec specifies 0 as failure value for glCreateProgram() */
          program = 0;
@@ -317,6 +494,162 @@ static GLuint gl_program_make( GLuint vertex_shader, GLuint fragment_shader )
    return program;
 }
 
+/**
+ * @brief Checks to see if linked programs can be stored and loaded as binaries.
+ *
+ *    @return 1 if program binaries are supported.
+ */
+static int gl_binaryHas (void)
+{
+   GLint nformats;
+
+   if (gl_binarySupport >= 0)
+      return gl_binarySupport;
+
+   gl_binarySupport = 0;
+   if (!gl_hasVersion( 4, 1 ) && !gl_hasExtension( "GL_ARB_get_program_binary" ))
+      return 0;
+
+   gl_getProgramBinary  = (glGetProgramBinaryFunc) SDL_GL_GetProcAddress( "glGetProgramBinary" );
+   gl_programBinary     = (glProgramBinaryFunc) SDL_GL_GetProcAddress( "glProgramBinary" );
+   gl_programParameteri = (glProgramParameteriFunc) SDL_GL_GetProcAddress( "glProgramParameteri" );
+   if ((gl_getProgramBinary == NULL) || (gl_programBinary == NULL) || (gl_programParameteri == NULL))
+      return 0;
+
+   /* Some drivers expose the extension without any formats to store. */
+   nformats = 0;
+   glGetIntegerv( GL_NUM_PROGRAM_BINARY_FORMATS, &nformats );
+   if (nformats <= 0)
+      return 0;
+
+   DEBUG(_("Caching shader program binaries"));
+   gl_binarySupport = 1;
+   return 1;
+}
+
+
+/**
+ * @brief Gets the cache path of a program.
+ *
+ * The key includes the driver strings as binaries are only valid for the
+ * driver and GPU that created them.
+ *
+ *    @param vert Preprocessed vertex shader.
+ *    @param vert_size Size of the vertex shader.
+ *    @param frag Preprocessed fragment shader.
+ *    @param frag_size Size of the fragment shader.
+ *    @return Newly allocated path of the cached binary.
+ */
+static char* gl_binaryPath( const char *vert, size_t vert_size, const char *frag, size_t frag_size )
+{
+   int i;
+   char *cachefile, digest[33];
+   const char *s;
+   md5_state_t md5;
+   md5_byte_t md5val[16];
+   const GLenum driver[] = { GL_VENDOR, GL_RENDERER, GL_VERSION, GL_SHADING_LANGUAGE_VERSION };
+   const int version = SHADER_CACHE_VERSION;
+
+   md5_init( &md5 );
+   md5_append( &md5, (const md5_byte_t*)&version, sizeof(version) );
+   for (i=0; i<(int)(sizeof(driver)/sizeof(driver[0])); i++) {
+      s = (const char*) glGetString( driver[i] );
+      if (s != NULL)
+         md5_append( &md5, (const md5_byte_t*)s, strlen(s)+1 );
+   }
+   md5_append( &md5, (const md5_byte_t*)&vert_size, sizeof(vert_size) );
+   md5_append( &md5, (const md5_byte_t*)vert, vert_size );
+   md5_append( &md5, (const md5_byte_t*)&frag_size, sizeof(frag_size) );
+   md5_append( &md5, (const md5_byte_t*)frag, frag_size );
+   md5_finish( &md5, md5val );
+
+   for (i=0; i<16; i++)
+      snprintf( &digest[i * 2], 3, "%02x", md5val[i] );
+
+   asprintf( &cachefile, "%sshaders/%s", nfile_cachePath(), digest );
+   return cachefile;
+}
+
+
+/**
+ * @brief Loads a program from a cached binary.
+ *
+ *    @param cachefile Path of the cached binary.
+ *    @return The linked program or 0 if it's not cached or the driver rejects it.
+ */
+static GLuint gl_binaryLoad( const char *cachefile )
+{
+   char *buf;
+   size_t size;
+   uint32_t format;
+   GLint status;
+   GLuint program;
+
+   if ((cachefile == NULL) || !nfile_fileExists( cachefile ))
+      return 0;
+
+   buf = nfile_readFile( &size, cachefile );
+   if (buf == NULL)
+      return 0;
+   if (size <= sizeof(format)) {
+      free( buf );
+      return 0;
+   }
+   memcpy( &format, buf, sizeof(format) );
+
+   program = glCreateProgram();
+   gl_programBinary( program, format, &buf[sizeof(format)], size-sizeof(format) );
+   free( buf );
+
+   /* Drivers reject binaries after updates, in which case we just recompile. */
+   status = GL_FALSE;
+   glGetProgramiv( program, GL_LINK_STATUS, &status );
+   if (status != GL_TRUE) {
+      glDeleteProgram( program );
+      glGetError(); /* Clear the error from unknown formats. */
+      return 0;
+   }
+
+   return program;
+}
+
+
+/**
+ * @brief Stores the binary of a linked program in the cache.
+ *
+ *    @param program Program to store.
+ *    @param cachefile Path of the cached binary.
+ */
+static void gl_binarySave( GLuint program, const char *cachefile )
+{
+   GLint length;
+   GLsizei written;
+   GLenum format;
+   uint32_t f;
+   char *buf;
+   char dirpath[PATH_MAX];
+
+   length = 0;
+   glGetProgramiv( program, GL_PROGRAM_BINARY_LENGTH, &length );
+   if (length <= 0)
+      return;
+
+   buf = malloc( sizeof(f) + length );
+   written = 0;
+   gl_getProgramBinary( program, length, &written, &format, &buf[sizeof(f)] );
+   if (written > 0) {
+      f = format;
+      memcpy( buf, &f, sizeof(f) );
+      snprintf( dirpath, sizeof(dirpath), "%s%s", nfile_cachePath(), "shaders/" );
+      nfile_dirMakeExist( dirpath );
+      if (nfile_writeFile( buf, sizeof(f) + written, cachefile ))
+         WARN(_("Unable to write shader cache '%s'"), cachefile);
+   }
+   free( buf );
+   gl_checkErr();
+}
+
+
 void gl_uniformColor(GLint location, const glColour *c) {
    glUniform4f(location, c->r, c->g, c->b, c->a);
 }
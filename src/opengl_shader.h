@@ -8,6 +8,15 @@
 
 #include "opengl.h"
 
+/*
+ * Shared per-frame state, see dat/glsl/lib/globals.glsl.
+ */
+#define GL_GLOBALS_BINDING 0 /**< Uniform buffer binding point of the globals block. */
+int gl_initGlobals (void);
+void gl_exitGlobals (void);
+void gl_globalsFrame( double dt );
+void gl_globalsUse (void);
+
 GLuint gl_program_vert_frag( const char *vert, const char *frag );
 GLuint gl_program_vert_frag_string( const char *vert, size_t vert_size, const char *frag, size_t frag_size );
 void gl_uniformColor( GLint location, const glColour *c );
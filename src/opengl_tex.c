@@ -12,6 +12,7 @@
 /** @cond */
 #include <stdio.h>
 #include <stdlib.h>
+#include "physfs.h"
 #include "physfsrwops.h"
 #include "SDL_image.h"
 
@@ -23,20 +24,26 @@
 #include "gui.h"
 #include "log.h"
 #include "md5.h"
+#include "ndata.h"
 #include "nfile.h"
 #include "nstring.h"
 #include "opengl.h"
+#include "threadpool.h"
 
 
 /*
- * graphic list
+ * graphic cache
  */
+#define OPENGL_TEX_CACHEFLAGS (OPENGL_TEX_MAPTRANS | OPENGL_TEX_MIPMAPS | OPENGL_TEX_ATLAS) /**< Flags that make different textures from the same image. */
+#define OPENGL_TEX_BUCKETS    256 /**< Initial number of buckets of the texture cache. */
 /**
- * @brief Represents a node in the texture list.
+ * @brief Represents a node in the texture cache.
  */
 typedef struct glTexList_ {
-   struct glTexList_ *next; /**< Next in linked list */
+   struct glTexList_ *next; /**< Next in the hash bucket */
    glTexture *tex; /**< associated texture */
+   unsigned int hash; /**< Hash of the name of the texture. */
+   unsigned int flags; /**< Cache flags the texture was requested with. */
    int used; /**< counts how many times texture is being used */
    /* TODO We currently treat images with different number of sprites as
     * different images, i.e., they get reloaded and use more memory. However,
@@ -45,7 +52,109 @@ typedef struct glTexList_ {
    int sx; /**< X sprites */
    int sy; /**< Y sprites */
 } glTexList;
-static glTexList* texture_list = NULL; /**< Texture list. */
+static glTexList** texture_buckets = NULL; /**< Hash buckets of the texture cache. */
+static unsigned int texture_nbuckets = 0; /**< Number of buckets (power of two). */
+static unsigned int texture_count = 0; /**< Number of textures in the cache. */
+static unsigned int texture_hits = 0; /**< Loads served from the cache. */
+static unsigned int texture_misses = 0; /**< Loads that had to create a texture. */
+
+
+/*
+ * texture atlases
+ */
+#define OPENGL_ATLAS_SIZE  2048 /**< Width and height of an atlas page. */
+#define OPENGL_ATLAS_MAX   512 /**< Largest image dimension that gets packed into an atlas. */
+#define OPENGL_ATLAS_PAD   2 /**< Transparent gap between packed images so filtering doesn't bleed. */
+/**
+ * @brief Shared texture that small images get packed into.
+ *
+ * Images are packed in shelves: rows that are filled from left to right and
+ *  are as tall as their tallest image. Space is not reclaimed when images are
+ *  freed, the page is just deleted once it is no longer used.
+ */
+typedef struct glAtlas_ {
+   GLuint texture; /**< OpenGL texture of the page. */
+   unsigned int flags; /**< Texture flags affecting the filtering of the page. */
+   int shelf_x; /**< Start of the free space on the current shelf. */
+   int shelf_y; /**< Bottom of the current shelf. */
+   int shelf_h; /**< Height of the current shelf. */
+   int used; /**< Number of images packed in the page. */
+} glAtlas;
+static glAtlas *gl_atlases = NULL; /**< Atlas pages (array.h). */
+
+
+/*
+ * prefetching
+ */
+/**
+ * @brief Image being decoded in the background.
+ */
+typedef struct glTexPrefetch_ {
+   char *path; /**< Path of the image. */
+   unsigned int flags; /**< Flags the image will be loaded with. */
+   SDL_Surface *surface; /**< Decoded image, NULL if decoding failed. */
+   int done; /**< Decoding has finished. */
+   int abandoned; /**< Nobody wants the image anymore, worker frees it. */
+} glTexPrefetch;
+static glTexPrefetch **gl_prefetch = NULL; /**< Pending prefetches (array.h). */
+static SDL_mutex *gl_prefetchLock = NULL; /**< Protects the prefetches. */
+static SDL_cond *gl_prefetchCond = NULL; /**< Signalled when a prefetch is done. */
+
+
+/*
+ * precompressed textures
+ */
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT  0x83F3
+#endif /* GL_COMPRESSED_RGBA_S3TC_DXT5_EXT */
+#ifndef GL_COMPRESSED_RGBA_BPTC_UNORM
+#define GL_COMPRESSED_RGBA_BPTC_UNORM     0x8E8C
+#endif /* GL_COMPRESSED_RGBA_BPTC_UNORM */
+#ifndef GL_COMPRESSED_RGBA8_ETC2_EAC
+#define GL_COMPRESSED_RGBA8_ETC2_EAC      0x9278
+#endif /* GL_COMPRESSED_RGBA8_ETC2_EAC */
+#ifndef GL_COMPRESSED_RGBA_ASTC_4x4_KHR
+#define GL_COMPRESSED_RGBA_ASTC_4x4_KHR   0x93B0
+#endif /* GL_COMPRESSED_RGBA_ASTC_4x4_KHR */
+#define KTX2_EXTENSION     "ktx2" /**< Extension of precompressed textures. */
+#define KTX2_HEADER_SIZE   80 /**< Size of the identifier, header and index of a KTX2 file. */
+#define KTX2_LEVEL_SIZE    24 /**< Size of an entry of the KTX2 level index. */
+#define KTX2_BLOCK_SIZE    16 /**< Bytes per 4x4 block, the same for all the supported formats. */
+static const uint8_t ktx2_identifier[12] = {
+   0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' }; /**< Start of every KTX2 file. */
+/**
+ * @brief Precompressed format that textures can be stored in.
+ *
+ * The precompressed version of "gfx/foo.png" is "gfx/foo.<name>.ktx2", and
+ *  the first format in the list the GPU supports is used. Files are plain KTX2
+ *  without supercompression, with the top row first like the images they
+ *  replace and with all their mipmaps.
+ */
+typedef struct glTexFormat_ {
+   const char *name; /**< Name of the format in file names. */
+   uint32_t vkformat; /**< Vulkan format ID as stored in KTX2 files. */
+   GLenum glformat; /**< OpenGL internal format. */
+   const char *ext; /**< OpenGL extension providing the format. */
+   int major; /**< OpenGL major version that has the format in core, 0 if none. */
+   int minor; /**< OpenGL minor version that has the format in core. */
+   int supported; /**< Whether the GPU can use the format, see gl_initTextures(). */
+} glTexFormat;
+static glTexFormat gl_texFormats[] = {
+   { "bc7",  145, GL_COMPRESSED_RGBA_BPTC_UNORM, "GL_ARB_texture_compression_bptc", 4, 2, 0 },
+   { "bc3",  137, GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, "GL_EXT_texture_compression_s3tc", 0, 0, 0 },
+   { "astc", 157, GL_COMPRESSED_RGBA_ASTC_4x4_KHR, "GL_KHR_texture_compression_astc_ldr", 0, 0, 0 },
+   { "etc2", 151, GL_COMPRESSED_RGBA8_ETC2_EAC, "GL_ARB_ES3_compatibility", 4, 3, 0 },
+}; /**< Supported precompressed formats, in order of preference. */
+static int gl_texFormatsAny = 0; /**< Whether any of the formats is supported. */
+
+
+/*
+ * residency
+ */
+#define OPENGL_TEX_RECENT  60 /**< Frames after being drawn that a texture can't be evicted. */
+#define OPENGL_TEX_CHECK   30 /**< Frames between checks of the VRAM budget. */
+static size_t gl_texResident = 0; /**< Estimated GPU memory used by the loaded evictable textures. */
+static unsigned int gl_texFrame = 1; /**< Frames drawn so far. */
 
 
 /*
@@ -55,14 +164,43 @@ static glTexList* texture_list = NULL; /**< Texture list. */
 static int SDL_IsTrans( SDL_Surface* s, int x, int y );
 static uint8_t* SDL_MapTrans( SDL_Surface* s, int w, int h );
 static size_t gl_transSize( const int w, const int h );
+static glTexMask* gl_transMask( const uint8_t *trans, int w, int h, int sx, int sy );
+static void gl_transMaskFree( glTexMask *mask );
 /* glTexture */
 static GLuint gl_texParameters( unsigned int flags );
+static void gl_texDefaults( unsigned int flags );
 static GLuint gl_loadSurface( SDL_Surface* surface, unsigned int flags, int freesur );
+static const glTexFormat* gl_compressedFind( const char *path, char *buf, size_t len );
+static uint32_t gl_ktx2U32( const uint8_t *data );
+static uint64_t gl_ktx2U64( const uint8_t *data );
+static GLuint gl_loadCompressed( const char *path, unsigned int flags, int *w, int *h );
+static glTexture* gl_texCreateCompressed( const char *name, unsigned int flags );
+static glTexture* gl_texCreate( const char *name, SDL_Surface* surface,
+      unsigned int flags, int w, int h, int sx, int sy, int freesur );
 static glTexture* gl_loadNewImage( const char* path, unsigned int flags );
 static glTexture* gl_loadNewImageRWops( const char *path, SDL_RWops *rw, unsigned int flags );
 /* List. */
-static glTexture* gl_texExists( const char* path, int sx, int sy );
-static int gl_texAdd( glTexture *tex, int sx, int sy );
+static glTexture* gl_texExists( const char* path, int sx, int sy, unsigned int flags );
+static glTexList* gl_texLookup( const char* path, int sx, int sy, unsigned int flags );
+static unsigned int gl_texHash( const char* path );
+static glTexList* gl_texFind( const glTexture* tex );
+static int gl_texAdd( glTexture *tex, int sx, int sy, unsigned int flags );
+static void gl_texDelete( glTexture *texture );
+/* Prefetching. */
+static int gl_prefetchJob( void *data );
+static void gl_prefetchFree( glTexPrefetch *p );
+static SDL_Surface* gl_prefetchTake( const char *path, unsigned int flags );
+static int gl_prefetchPoll( const char *path, unsigned int flags, SDL_Surface **surface );
+static void gl_prefetchStart( const char *path, unsigned int flags );
+/* Residency. */
+static void gl_texManage( glTexture *texture );
+static void gl_texReload( glTexture *texture, int wait );
+static void gl_texEvict( glTexture *texture );
+static int gl_texCmpDrawn( const void *p1, const void *p2 );
+/* Atlas. */
+static int gl_atlasFit( glAtlas *a, int w, int h, int *x, int *y );
+static int gl_atlasPack( SDL_Surface* surface, unsigned int flags, glTexture *texture );
+static void gl_atlasRelease( GLuint texture );
 
 
 /**
@@ -166,6 +304,82 @@ static size_t gl_transSize( const int w, const int h )
 }
 
 
+/**
+ * @brief Packs a transparency map into a collision mask.
+ *
+ *    @param trans Transparency map of the sheet.
+ *    @param w Width of the sheet.
+ *    @param h Height of the sheet.
+ *    @param sx X sprites.
+ *    @param sy Y sprites.
+ *    @return The collision mask or NULL on error.
+ */
+static glTexMask* gl_transMask( const uint8_t *trans, int w, int h, int sx, int sy )
+{
+   glTexMask *mask;
+   int sw, sh, fx, fy, x, y, i;
+   int x0, y0, x1, y1;
+   uint64_t *row;
+   int16_t *box;
+
+   if (trans == NULL)
+      return NULL;
+
+   sw = w / sx;
+   sh = h / sy;
+   mask        = calloc( 1, sizeof(glTexMask) );
+   mask->words = (sw+63) / 64;
+   mask->bits  = calloc( (size_t)sx*sy*sh*mask->words, sizeof(uint64_t) );
+   mask->box   = malloc( (size_t)sx*sy*4*sizeof(int16_t) );
+   if ((mask->bits == NULL) || (mask->box == NULL)) {
+      WARN(_("Out of Memory"));
+      gl_transMaskFree( mask );
+      return NULL;
+   }
+
+   for (fy=0; fy<sy; fy++) {
+      for (fx=0; fx<sx; fx++) {
+         x0 = sw;
+         y0 = sh;
+         x1 = y1 = -1;
+         for (y=0; y<sh; y++) {
+            row = &mask->bits[ ((fy*sx + fx)*sh + y) * mask->words ];
+            for (x=0; x<sw; x++) {
+               i = (fy*sh + y)*w + fx*sw + x;
+               if (!(trans[ i/8 ] & (1 << (i%8))))
+                  continue;
+               row[ x/64 ] |= (uint64_t)1 << (x%64);
+               x0 = MIN( x0, x );
+               x1 = MAX( x1, x );
+               y0 = MIN( y0, y );
+               y1 = MAX( y1, y );
+            }
+         }
+         box    = &mask->box[ (fy*sx + fx)*4 ];
+         box[0] = x0;
+         box[1] = y0;
+         box[2] = x1;
+         box[3] = y1;
+      }
+   }
+
+   return mask;
+}
+
+
+/**
+ * @brief Frees a collision mask.
+ */
+static void gl_transMaskFree( glTexMask *mask )
+{
+   if (mask == NULL)
+      return;
+   free( mask->bits );
+   free( mask->box );
+   free( mask );
+}
+
+
 /**
  * @brief Sets default texture parameters.
  */
@@ -175,8 +389,20 @@ static GLuint gl_texParameters( unsigned int flags )
 
    /* opengl texture binding */
    glGenTextures( 1, &texture ); /* Creates the texture */
-   glBindTexture( GL_TEXTURE_2D, texture ); /* Loads the texture */
+   gl_bindTexture( GL_TEXTURE_2D, texture ); /* Loads the texture */
+   gl_texDefaults( flags );
 
+   return texture;
+}
+
+
+/**
+ * @brief Sets the default sampling parameters of the bound texture.
+ *
+ *    @param flags Texture flags.
+ */
+static void gl_texDefaults( unsigned int flags )
+{
    /* Filtering, LINEAR is better for scaling, nearest looks nicer, LINEAR
     * also seems to create a bit of artifacts around the edges */
    if ((gl_screen.scale != 1.) || (flags & OPENGL_TEX_MIPMAPS)) {
@@ -194,8 +420,21 @@ static GLuint gl_texParameters( unsigned int flags )
 
    /* Check errors. */
    gl_checkErr();
+}
 
-   return texture;
+
+/**
+ * @brief Puts back the default sampling parameters of a texture.
+ *
+ * Used when reusing textures that may have been modified.
+ *
+ *    @param texture Texture to reset.
+ */
+void gl_texResetParameters( const glTexture *texture )
+{
+   gl_bindTexture( GL_TEXTURE_2D, texture->texture );
+   gl_texDefaults( texture->flags );
+   gl_bindTexture( GL_TEXTURE_2D, 0 );
 }
 
 /**
@@ -224,13 +463,13 @@ int gl_fboCreate( GLuint *fbo, GLuint *tex, GLsizei width, GLsizei height )
 
    /* Create the render buffer. */
    glGenTextures(1, tex);
-   glBindTexture(GL_TEXTURE_2D, *tex);
+   gl_bindTexture(GL_TEXTURE_2D, *tex);
    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-   glBindTexture(GL_TEXTURE_2D, 0);
+   gl_bindTexture(GL_TEXTURE_2D, 0);
 
    /* Create the frame buffer. */
    glGenFramebuffers( 1, fbo );
@@ -264,13 +503,15 @@ glTexture* gl_loadImageData( float *data, int w, int h, int sx, int sy, const ch
    texture->h     = (double) h;
    texture->sx    = (double) sx;
    texture->sy    = (double) sy;
+   texture->ow    = 1.;
+   texture->oh    = 1.;
 
    /* Set up texture. */
    texture->texture = gl_texParameters( 0 );
 
    /* Copy over. */
    glTexImage2D( GL_TEXTURE_2D, 0, GL_RGBA, w, h, 0, GL_RGBA, GL_FLOAT, data );
-   glBindTexture( GL_TEXTURE_2D, 0 );
+   gl_bindTexture( GL_TEXTURE_2D, 0 );
 
    /* Check errors. */
    gl_checkErr();
@@ -284,7 +525,7 @@ glTexture* gl_loadImageData( float *data, int w, int h, int sx, int sy, const ch
    /* Add to list. */
    if (name != NULL) {
       texture->name = strdup(name);
-      gl_texAdd( texture, sx, sy );
+      gl_texAdd( texture, sx, sy, 0 );
    }
 
    return texture;
@@ -344,6 +585,309 @@ static GLuint gl_loadSurface( SDL_Surface* surface, unsigned int flags, int free
 }
 
 
+/**
+ * @brief Finds the precompressed version of an image.
+ *
+ *    @param path Path of the image.
+ *    @param[out] buf Gets the path of the precompressed version.
+ *    @param len Size of buf.
+ *    @return The format of the precompressed version, NULL if there is none
+ *            the GPU can use.
+ */
+static const glTexFormat* gl_compressedFind( const char *path, char *buf, size_t len )
+{
+   size_t i;
+   int n;
+   const char *ext, *dir;
+
+   if ((path == NULL) || !gl_texFormatsAny)
+      return NULL;
+
+   /* Replace the extension, if any. */
+   ext = strrchr( path, '.' );
+   dir = strrchr( path, '/' );
+   if ((ext == NULL) || ((dir != NULL) && (ext < dir)))
+      n = strlen( path );
+   else
+      n = ext - path;
+
+   for (i=0; i<sizeof(gl_texFormats)/sizeof(gl_texFormats[0]); i++) {
+      if (!gl_texFormats[i].supported)
+         continue;
+      snprintf( buf, len, "%.*s.%s."KTX2_EXTENSION, n, path, gl_texFormats[i].name );
+      if (PHYSFS_exists( buf ))
+         return &gl_texFormats[i];
+   }
+   return NULL;
+}
+
+
+/**
+ * @brief Reads a little endian 32 bit integer from a KTX2 file.
+ */
+static uint32_t gl_ktx2U32( const uint8_t *data )
+{
+   return (uint32_t)data[0] | ((uint32_t)data[1] << 8) |
+         ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+
+/**
+ * @brief Reads a little endian 64 bit integer from a KTX2 file.
+ */
+static uint64_t gl_ktx2U64( const uint8_t *data )
+{
+   return (uint64_t)gl_ktx2U32( data ) | ((uint64_t)gl_ktx2U32( &data[4] ) << 32);
+}
+
+
+/**
+ * @brief Loads the precompressed version of an image into an opengl texture.
+ *
+ * The compressed data and mipmaps are uploaded as they are, so there is no
+ *  decoding, compressing by the driver nor mipmap generation.
+ *
+ *    @param path Path of the image.
+ *    @param flags Flags to use.
+ *    @param[in,out] w Width the texture must have, or 0 to accept any. Gets the
+ *                     width of the texture.
+ *    @param[in,out] h Height the texture must have, or 0 to accept any. Gets
+ *                     the height of the texture.
+ *    @return The opengl texture id, or 0 if there is no usable precompressed
+ *            version.
+ */
+static GLuint gl_loadCompressed( const char *path, unsigned int flags, int *w, int *h )
+{
+   char file[PATH_MAX];
+   const glTexFormat *fmt;
+   uint8_t *data;
+   const uint8_t *lvl;
+   size_t size;
+   uint64_t offset, length;
+   uint32_t width, height, levels;
+   GLuint texture;
+   GLfloat param;
+   GLsizei lw, lh;
+   unsigned int l;
+
+   fmt = gl_compressedFind( path, file, sizeof(file) );
+   if (fmt == NULL)
+      return 0;
+
+   data = ndata_read( file, &size );
+   if (data == NULL)
+      return 0;
+
+   /* Only plain 2D textures of the format the name says. */
+   if ((size < KTX2_HEADER_SIZE) || (memcmp( data, ktx2_identifier, sizeof(ktx2_identifier) ) != 0)) {
+      WARN(_("'%s' is not a KTX2 file!"), file);
+      free( data );
+      return 0;
+   }
+   width  = gl_ktx2U32( &data[20] );
+   height = gl_ktx2U32( &data[24] );
+   levels = MAX( gl_ktx2U32( &data[40] ), 1 );
+   if ((gl_ktx2U32( &data[12] ) != fmt->vkformat) || (width == 0) || (height == 0) ||
+         (gl_ktx2U32( &data[28] ) > 1) || (gl_ktx2U32( &data[32] ) > 1) ||
+         (gl_ktx2U32( &data[36] ) != 1) || (gl_ktx2U32( &data[44] ) != 0) ||
+         (size < KTX2_HEADER_SIZE + (size_t)levels*KTX2_LEVEL_SIZE)) {
+      WARN(_("KTX2 file '%s' is not a '%s' 2D texture without supercompression!"),
+            file, fmt->name);
+      free( data );
+      return 0;
+   }
+   if (((*w > 0) && ((uint32_t)*w != width)) || ((*h > 0) && ((uint32_t)*h != height))) {
+      WARN(_("KTX2 file '%s' is %ux%u but the image is %dx%d!"),
+            file, width, height, *w, *h);
+      free( data );
+      return 0;
+   }
+   /* Compressed textures can't have mipmaps generated. */
+   if ((flags & OPENGL_TEX_MIPMAPS) && (levels == 1)) {
+      WARN(_("KTX2 file '%s' has no mipmaps!"), file);
+      free( data );
+      return 0;
+   }
+   if (!(flags & OPENGL_TEX_MIPMAPS))
+      levels = 1;
+
+   /* Check all the levels before touching OpenGL. */
+   for (l=0; l<levels; l++) {
+      lvl    = &data[ KTX2_HEADER_SIZE + l*KTX2_LEVEL_SIZE ];
+      offset = gl_ktx2U64( &lvl[0] );
+      length = gl_ktx2U64( &lvl[8] );
+      lw     = MAX( width >> l, 1 );
+      lh     = MAX( height >> l, 1 );
+      if ((offset > size) || (length > size - offset) ||
+            (length != (uint64_t)((lw+3)/4) * ((lh+3)/4) * KTX2_BLOCK_SIZE)) {
+         WARN(_("KTX2 file '%s' has an invalid mipmap level %u!"), file, l);
+         free( data );
+         return 0;
+      }
+   }
+
+   texture = gl_texParameters( flags );
+   for (l=0; l<levels; l++) {
+      lvl    = &data[ KTX2_HEADER_SIZE + l*KTX2_LEVEL_SIZE ];
+      offset = gl_ktx2U64( &lvl[0] );
+      length = gl_ktx2U64( &lvl[8] );
+      glCompressedTexImage2D( GL_TEXTURE_2D, l, fmt->glformat,
+            MAX( width >> l, 1 ), MAX( height >> l, 1 ), 0,
+            (GLsizei)length, &data[offset] );
+   }
+   if (flags & OPENGL_TEX_MIPMAPS) {
+      if (GLAD_GL_ARB_texture_filter_anisotropic) {
+         glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY, &param);
+         glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY, param);
+      }
+   }
+   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels-1);
+   free( data );
+   gl_checkErr();
+
+   *w = width;
+   *h = height;
+   return texture;
+}
+
+
+/**
+ * @brief Finds space for an image on the current shelf of an atlas page.
+ *
+ *    @param a Atlas page to allocate in.
+ *    @param w Width to allocate (including padding).
+ *    @param h Height to allocate (including padding).
+ *    @param[out] x X position of the allocated space.
+ *    @param[out] y Y position of the allocated space.
+ *    @return 0 on success, -1 if the page is full.
+ */
+static int gl_atlasFit( glAtlas *a, int w, int h, int *x, int *y )
+{
+   int sx, sy, sh;
+
+   sx = a->shelf_x;
+   sy = a->shelf_y;
+   sh = a->shelf_h;
+
+   /* Start a new shelf if it doesn't fit on the current one. */
+   if (sx + w > OPENGL_ATLAS_SIZE) {
+      sy += sh;
+      sx  = 0;
+      sh  = 0;
+   }
+   if (sy + MAX( sh, h ) > OPENGL_ATLAS_SIZE)
+      return -1;
+
+   *x = sx;
+   *y = sy;
+   a->shelf_x = sx + w;
+   a->shelf_y = sy;
+   a->shelf_h = MAX( sh, h );
+   return 0;
+}
+
+
+/**
+ * @brief Packs a surface into an atlas page.
+ *
+ * Mipmaps are not generated for atlas pages as the minification filter never
+ *  samples them.
+ *
+ *    @param surface Surface to pack.
+ *    @param flags Flags being used to load the texture.
+ *    @param texture Texture to set the atlas texture and coordinates of.
+ *    @return 0 on success, -1 if the surface should be loaded on its own.
+ */
+static int gl_atlasPack( SDL_Surface* surface, unsigned int flags, glTexture *texture )
+{
+   int i, x, y, w, h;
+   unsigned int pflags;
+   glAtlas *a;
+   uint8_t *clear;
+
+   if ((surface->w > OPENGL_ATLAS_MAX) || (surface->h > OPENGL_ATLAS_MAX))
+      return -1;
+
+   w = surface->w + OPENGL_ATLAS_PAD;
+   h = surface->h + OPENGL_ATLAS_PAD;
+   pflags = flags & OPENGL_TEX_MIPMAPS;
+
+   if (gl_atlases == NULL)
+      gl_atlases = array_create( glAtlas );
+
+   /* Try to fit in an existing page with the same filtering. */
+   a = NULL;
+   for (i=0; i<array_size(gl_atlases); i++) {
+      if (gl_atlases[i].flags != pflags)
+         continue;
+      if (gl_atlasFit( &gl_atlases[i], w, h, &x, &y ) == 0) {
+         a = &gl_atlases[i];
+         break;
+      }
+   }
+
+   /* Create a new page, cleared so the padding is transparent. */
+   if (a == NULL) {
+      a = &array_grow( &gl_atlases );
+      memset( a, 0, sizeof(glAtlas) );
+      a->flags   = pflags;
+      a->texture = gl_texParameters( pflags );
+      clear = calloc( OPENGL_ATLAS_SIZE * OPENGL_ATLAS_SIZE, 4 );
+      glPixelStorei( GL_UNPACK_ALIGNMENT, 4 );
+      glTexImage2D( GL_TEXTURE_2D, 0, GL_RGBA, OPENGL_ATLAS_SIZE, OPENGL_ATLAS_SIZE,
+            0, GL_RGBA, GL_UNSIGNED_BYTE, clear );
+      free( clear );
+      gl_atlasFit( a, w, h, &x, &y );
+   }
+   else
+      gl_bindTexture( GL_TEXTURE_2D, a->texture );
+
+   /* Upload the image. */
+   SDL_LockSurface( surface );
+   glPixelStorei( GL_UNPACK_ALIGNMENT, MIN( surface->pitch&-surface->pitch, 8 ) );
+   glTexSubImage2D( GL_TEXTURE_2D, 0, x, y, surface->w, surface->h,
+         surface->format->Amask ? GL_RGBA : GL_RGB, GL_UNSIGNED_BYTE, surface->pixels );
+   SDL_UnlockSurface( surface );
+   gl_bindTexture( GL_TEXTURE_2D, 0 );
+   a->used++;
+
+   texture->texture = a->texture;
+   texture->ox = (double)x / (double)OPENGL_ATLAS_SIZE;
+   texture->oy = (double)y / (double)OPENGL_ATLAS_SIZE;
+   texture->ow = (double)surface->w / (double)OPENGL_ATLAS_SIZE;
+   texture->oh = (double)surface->h / (double)OPENGL_ATLAS_SIZE;
+
+   gl_checkErr();
+
+   return 0;
+}
+
+
+/**
+ * @brief Releases an image from an atlas page, deleting the page if unused.
+ *
+ *    @param texture OpenGL texture of the page.
+ */
+static void gl_atlasRelease( GLuint texture )
+{
+   int i;
+
+   for (i=0; i<array_size(gl_atlases); i++) {
+      if (gl_atlases[i].texture != texture)
+         continue;
+      gl_atlases[i].used--;
+      if (gl_atlases[i].used <= 0) {
+         gl_deleteTextures( 1, &gl_atlases[i].texture );
+         array_erase( &gl_atlases, &gl_atlases[i], &gl_atlases[i+1] );
+      }
+      return;
+   }
+
+   WARN(_("Attempting to release atlas texture %u not found!"), texture);
+}
+
+
 /**
  * @brief Wrapper for gl_loadImagePad that includes transparency mapping.
  *
@@ -371,7 +915,7 @@ glTexture* gl_loadImagePadTrans( const char *name, SDL_Surface* surface, SDL_RWo
    md5_byte_t *md5val;
 
    if (name != NULL) {
-      texture = gl_texExists( name, sx, sy );
+      texture = gl_texExists( name, sx, sy, flags );
       if (texture != NULL) {
          if (freesur)
             SDL_FreeSurface( surface );
@@ -379,9 +923,6 @@ glTexture* gl_loadImagePadTrans( const char *name, SDL_Surface* surface, SDL_RWo
       }
    }
 
-   if (flags & OPENGL_TEX_MAPTRANS)
-      flags ^= OPENGL_TEX_MAPTRANS;
-
    /* Appropriate size for the transparency map, see SDL_MapTrans */
    cachesize = gl_transSize(w, h);
 
@@ -450,8 +991,9 @@ glTexture* gl_loadImagePadTrans( const char *name, SDL_Surface* surface, SDL_RWo
       }
    }
 
-   texture = gl_loadImagePad( name, surface, flags, w, h, sx, sy, freesur );
+   texture = gl_texCreate( name, surface, flags, w, h, sx, sy, freesur );
    texture->trans = trans;
+   texture->mask  = gl_transMask( trans, w, h, sx, sy );
    return texture;
 }
 
@@ -476,7 +1018,7 @@ glTexture* gl_loadImagePad( const char *name, SDL_Surface* surface,
 
    /* Make sure doesn't already exist. */
    if (name != NULL) {
-      texture = gl_texExists( name, sx, sy );
+      texture = gl_texExists( name, sx, sy, flags );
       if (texture != NULL)
          return texture;
    }
@@ -485,6 +1027,34 @@ glTexture* gl_loadImagePad( const char *name, SDL_Surface* surface,
       return gl_loadImagePadTrans( name, surface, NULL, flags, w, h,
             sx, sy, freesur );
 
+   return gl_texCreate( name, surface, flags, w, h, sx, sy, freesur );
+}
+
+
+/**
+ * @brief Creates a glTexture from a surface and adds it to the cache.
+ *
+ *    @param name Name to load with.
+ *    @param surface Surface to load.
+ *    @param flags Flags to use.
+ *    @param w Non-padded width.
+ *    @param h Non-padded height.
+ *    @param sx X sprites.
+ *    @param sy Y sprites.
+ *    @param freesur Whether or not to free the surface.
+ *    @return The glTexture for surface.
+ */
+static glTexture* gl_texCreate( const char *name, SDL_Surface* surface,
+      unsigned int flags, int w, int h, int sx, int sy, int freesur )
+{
+   glTexture *texture;
+   unsigned int cflags;
+   int cw, ch;
+
+   /* The transparency map is handled by gl_loadImagePadTrans. */
+   cflags = flags & OPENGL_TEX_CACHEFLAGS;
+   flags &= ~OPENGL_TEX_MAPTRANS;
+
    /* set up the texture defaults */
    texture = calloc( 1, sizeof(glTexture) );
 
@@ -492,8 +1062,27 @@ glTexture* gl_loadImagePad( const char *name, SDL_Surface* surface,
    texture->h     = (double) h;
    texture->sx    = (double) sx;
    texture->sy    = (double) sy;
+   texture->ow    = 1.;
+   texture->oh    = 1.;
 
-   texture->texture = gl_loadSurface( surface, flags, freesur );
+   /* Only keep the atlas flag if it actually got packed. */
+   if ((flags & OPENGL_TEX_ATLAS) && (gl_atlasPack( surface, flags, texture ) == 0)) {
+      if (freesur)
+         SDL_FreeSurface( surface );
+   }
+   else {
+      flags &= ~OPENGL_TEX_ATLAS;
+      /* Use the precompressed version if there is one. */
+      cw = surface->w;
+      ch = surface->h;
+      texture->texture = gl_loadCompressed( name, flags, &cw, &ch );
+      if (texture->texture != 0) {
+         if (freesur)
+            SDL_FreeSurface( surface );
+      }
+      else
+         texture->texture = gl_loadSurface( surface, flags, freesur );
+   }
 
    texture->sw    = texture->w / texture->sx;
    texture->sh    = texture->h / texture->sy;
@@ -503,7 +1092,7 @@ glTexture* gl_loadImagePad( const char *name, SDL_Surface* surface,
 
    if (name != NULL) {
       texture->name = strdup(name);
-      gl_texAdd( texture, sx, sy );
+      gl_texAdd( texture, sx, sy, cflags );
    }
    else
       texture->name = NULL;
@@ -512,6 +1101,48 @@ glTexture* gl_loadImagePad( const char *name, SDL_Surface* surface,
 }
 
 
+/**
+ * @brief Creates a glTexture from the precompressed version of an image and
+ *        adds it to the cache.
+ *
+ * The image itself is never decoded, so it can't be used for textures that
+ *  need a transparency map.
+ *
+ *    @param name Path of the image.
+ *    @param flags Flags to use.
+ *    @return The glTexture or NULL if there is no usable precompressed version.
+ */
+static glTexture* gl_texCreateCompressed( const char *name, unsigned int flags )
+{
+   glTexture *texture;
+   GLuint tex;
+   int w, h;
+
+   w   = 0;
+   h   = 0;
+   tex = gl_loadCompressed( name, flags, &w, &h );
+   if (tex == 0)
+      return NULL;
+
+   texture = calloc( 1, sizeof(glTexture) );
+   texture->texture = tex;
+   texture->w     = (double) w;
+   texture->h     = (double) h;
+   texture->sx    = 1.;
+   texture->sy    = 1.;
+   texture->ow    = 1.;
+   texture->oh    = 1.;
+   texture->sw    = texture->w;
+   texture->sh    = texture->h;
+   texture->srw   = 1.;
+   texture->srh   = 1.;
+   texture->flags = (flags | OPENGL_TEX_VFLIP) & ~OPENGL_TEX_ATLAS;
+   texture->name  = strdup(name);
+   gl_texAdd( texture, 1, 1, flags & OPENGL_TEX_CACHEFLAGS );
+   return texture;
+}
+
+
 /**
  * @brief Loads the SDL_Surface to a glTexture.
  *
@@ -525,65 +1156,165 @@ glTexture* gl_loadImage( SDL_Surface* surface, unsigned int flags )
 }
 
 
+/**
+ * @brief Hashes the name of a texture (FNV-1a).
+ *
+ *    @param path Name to hash.
+ *    @return The hash of the name.
+ */
+static unsigned int gl_texHash( const char* path )
+{
+   unsigned int h;
+
+   h = 2166136261u;
+   for (; *path != '\0'; path++) {
+      h ^= (unsigned char) *path;
+      h *= 16777619u;
+   }
+   return h;
+}
+
+
 /**
  * @brief Check to see if a texture matching a path already exists.
  *
  *    @param path Path to the texture.
  *    @param sx X sprites.
  *    @param sy Y sprites.
+ *    @param flags Flags the texture is being loaded with.
  *    @return The texture, or NULL if none was found.
  */
-static glTexture* gl_texExists( const char* path, int sx, int sy )
+static glTexture* gl_texExists( const char* path, int sx, int sy, unsigned int flags )
 {
    glTexList *cur;
 
+   cur = gl_texLookup( path, sx, sy, flags );
+   if (cur == NULL)
+      return NULL;
+
+   cur->used += 1;
+   texture_hits++;
+   return cur->tex;
+}
+
+
+/**
+ * @brief Looks up the cache node of a texture without referencing it.
+ *
+ *    @param path Path to the texture.
+ *    @param sx X sprites.
+ *    @param sy Y sprites.
+ *    @param flags Flags the texture is being loaded with.
+ *    @return The node of the texture, or NULL if none was found.
+ */
+static glTexList* gl_texLookup( const char* path, int sx, int sy, unsigned int flags )
+{
+   glTexList *cur;
+   unsigned int h;
+
    /* Null does never exist. */
-   if (path==NULL)
+   if ((path==NULL) || (texture_buckets==NULL))
       return NULL;
 
    /* check to see if it already exists */
-   if (texture_list != NULL) {
-      for (cur=texture_list; cur!=NULL; cur=cur->next) {
-         if ((strcmp(path,cur->tex->name)==0) &&
-               (cur->sx==sx) && (cur->sy==sy)) {
-            cur->used += 1;
-            return cur->tex;
-         }
-      }
-   }
+   h     = gl_texHash( path );
+   flags &= OPENGL_TEX_CACHEFLAGS;
+   for (cur=texture_buckets[ h & (texture_nbuckets-1) ]; cur!=NULL; cur=cur->next)
+      if ((cur->hash==h) && (cur->flags==flags) &&
+            (cur->sx==sx) && (cur->sy==sy) &&
+            (strcmp(path,cur->tex->name)==0))
+         return cur;
 
    return NULL;
 }
 
 
 /**
- * @brief Adds a texture to the list under the name of path.
+ * @brief Finds the cache node of a texture.
+ *
+ *    @param tex Texture to find.
+ *    @return The node of the texture, or NULL if it isn't in the cache.
  */
-static int gl_texAdd( glTexture *tex, int sx, int sy )
+static glTexList* gl_texFind( const glTexture* tex )
 {
-   glTexList *new, *last = texture_list;
+   glTexList *cur;
 
-   /* Create the new node */
-   new = malloc( sizeof(glTexList) );
-   new->next = NULL;
-   new->used = 1;
-   new->tex  = tex;
-   new->sx   = sx;
-   new->sy   = sy;
-
-   if (texture_list == NULL) /* special condition - creating new list */
-      texture_list = new;
-   else {
-      while (last->next != NULL)
-         last = last->next;
+   /* Textures without names aren't cached. */
+   if ((tex->name==NULL) || (texture_buckets==NULL))
+      return NULL;
+
+   cur = texture_buckets[ gl_texHash( tex->name ) & (texture_nbuckets-1) ];
+   for (; cur!=NULL; cur=cur->next)
+      if (cur->tex == tex)
+         return cur;
 
-      last->next = new;
+   return NULL;
+}
+
+
+/**
+ * @brief Adds a texture to the cache under the name of path.
+ *
+ *    @param tex Texture to add, must have a name.
+ *    @param sx X sprites.
+ *    @param sy Y sprites.
+ *    @param flags Flags the texture was requested with.
+ *    @return 0 on success.
+ */
+static int gl_texAdd( glTexture *tex, int sx, int sy, unsigned int flags )
+{
+   glTexList *new, *cur, *next, **buckets;
+   unsigned int i, nb, b;
+
+   /* Grow the buckets to keep the chains short. */
+   if (texture_count >= texture_nbuckets) {
+      nb = MAX( OPENGL_TEX_BUCKETS, 2*texture_nbuckets );
+      buckets = calloc( nb, sizeof(glTexList*) );
+      for (i=0; i<texture_nbuckets; i++) {
+         for (cur=texture_buckets[i]; cur!=NULL; cur=next) {
+            next = cur->next;
+            b = cur->hash & (nb-1);
+            cur->next  = buckets[b];
+            buckets[b] = cur;
+         }
+      }
+      free( texture_buckets );
+      texture_buckets  = buckets;
+      texture_nbuckets = nb;
    }
 
+   /* Create the new node */
+   new = malloc( sizeof(glTexList) );
+   new->used  = 1;
+   new->tex   = tex;
+   new->hash  = gl_texHash( tex->name );
+   new->flags = flags & OPENGL_TEX_CACHEFLAGS;
+   new->sx    = sx;
+   new->sy    = sy;
+
+   b = new->hash & (texture_nbuckets-1);
+   new->next = texture_buckets[b];
+   texture_buckets[b] = new;
+   texture_count++;
+   texture_misses++;
+
    return 0;
 }
 
 
+/**
+ * @brief Gets the statistics of the texture cache.
+ *
+ *    @param[out] hits Number of loads that used an already loaded texture.
+ *    @param[out] misses Number of loads that created a new texture.
+ */
+void gl_texCacheStats( unsigned int *hits, unsigned int *misses )
+{
+   *hits   = texture_hits;
+   *misses = texture_misses;
+}
+
+
 /**
  * @brief Loads an image as a texture.
  *
@@ -596,14 +1327,458 @@ static int gl_texAdd( glTexture *tex, int sx, int sy )
 glTexture* gl_newImage( const char* path, const unsigned int flags )
 {
    glTexture *t;
+   SDL_Surface *surface;
 
    /* Check if it already exists. */
-   t = gl_texExists( path, 1, 1 );
+   t = gl_texExists( path, 1, 1, flags );
    if (t != NULL)
       return t;
 
+   /* Precompressed, doesn't need to be decoded at all. */
+   t = NULL;
+   if (!(flags & OPENGL_TEX_MAPTRANS))
+      t = gl_texCreateCompressed( path, flags );
+
+   /* Already decoded in the background, only has to be uploaded. */
+   if (t == NULL) {
+      surface = gl_prefetchTake( path, flags );
+      if (surface != NULL)
+         t = gl_loadImagePad( path, surface, flags | OPENGL_TEX_VFLIP,
+               surface->w, surface->h, 1, 1, 1 );
+   }
+
    /* Load the image */
-   return gl_loadNewImage( path, flags );
+   if (t == NULL)
+      t = gl_loadNewImage( path, flags );
+
+   /* Can be reloaded from the path, so it may be evicted. */
+   gl_texManage( t );
+   return t;
+}
+
+
+/**
+ * @brief Decodes a prefetched image, runs on the threadpool so can't log.
+ */
+static int gl_prefetchJob( void *data )
+{
+   glTexPrefetch *p = data;
+   SDL_RWops *rw;
+   SDL_Surface *surface;
+
+   surface = NULL;
+   rw = PHYSFSRWOPS_openRead( p->path );
+   if (rw != NULL) {
+      surface = IMG_Load_RW( rw, 0 );
+      SDL_RWclose( rw );
+   }
+
+   SDL_LockMutex( gl_prefetchLock );
+   p->surface = surface;
+   p->done    = 1;
+   if (p->abandoned)
+      gl_prefetchFree( p );
+   SDL_CondBroadcast( gl_prefetchCond );
+   SDL_UnlockMutex( gl_prefetchLock );
+   return 0;
+}
+
+
+/**
+ * @brief Frees a finished prefetch.
+ */
+static void gl_prefetchFree( glTexPrefetch *p )
+{
+   if (p->surface != NULL)
+      SDL_FreeSurface( p->surface );
+   free( p->path );
+   free( p );
+}
+
+
+/**
+ * @brief Takes the decoded image of a prefetch if it is done.
+ *
+ *    @param path Path of the image.
+ *    @param flags Flags the image is being loaded with.
+ *    @param[out] surface Decoded image, NULL if decoding failed.
+ *    @return 1 if done, 0 if still decoding, -1 if the image isn't being
+ *            prefetched.
+ */
+static int gl_prefetchPoll( const char *path, unsigned int flags, SDL_Surface **surface )
+{
+   int i;
+   glTexPrefetch *p;
+
+   *surface = NULL;
+   if (gl_prefetchLock == NULL)
+      return -1;
+
+   SDL_LockMutex( gl_prefetchLock );
+   for (i=0; i<array_size(gl_prefetch); i++) {
+      p = gl_prefetch[i];
+      if ((p->flags != flags) || (strcmp( p->path, path ) != 0))
+         continue;
+
+      if (!p->done) {
+         SDL_UnlockMutex( gl_prefetchLock );
+         return 0;
+      }
+
+      *surface   = p->surface;
+      p->surface = NULL;
+      array_erase( &gl_prefetch, &gl_prefetch[i], &gl_prefetch[i+1] );
+      gl_prefetchFree( p );
+      SDL_UnlockMutex( gl_prefetchLock );
+      return 1;
+   }
+   SDL_UnlockMutex( gl_prefetchLock );
+   return -1;
+}
+
+
+/**
+ * @brief Takes the decoded image of a prefetch, waiting for it if needed.
+ *
+ *    @param path Path of the image.
+ *    @param flags Flags the image is being loaded with.
+ *    @return The decoded image or NULL if it wasn't prefetched or failed.
+ */
+static SDL_Surface* gl_prefetchTake( const char *path, unsigned int flags )
+{
+   int i;
+   glTexPrefetch *p;
+   SDL_Surface *surface;
+
+   if ((path == NULL) || (gl_prefetchLock == NULL))
+      return NULL;
+
+   SDL_LockMutex( gl_prefetchLock );
+   for (i=0; i<array_size(gl_prefetch); i++) {
+      p = gl_prefetch[i];
+      if ((p->flags != flags) || (strcmp( p->path, path ) != 0))
+         continue;
+
+      /* Still decoding, block until it's done. */
+      while (!p->done)
+         SDL_CondWait( gl_prefetchCond, gl_prefetchLock );
+
+      surface    = p->surface;
+      p->surface = NULL;
+      array_erase( &gl_prefetch, &gl_prefetch[i], &gl_prefetch[i+1] );
+      gl_prefetchFree( p );
+      SDL_UnlockMutex( gl_prefetchLock );
+      return surface;
+   }
+   SDL_UnlockMutex( gl_prefetchLock );
+   return NULL;
+}
+
+
+/**
+ * @brief Starts decoding an image in the background.
+ *
+ * A later gl_newImage() with the same path and flags then only has to upload
+ *  the image to the GPU instead of also reading and decoding it. Does nothing
+ *  if the texture is already loaded or being prefetched. Images that need a
+ *  transparency map or that have a precompressed version are not prefetched.
+ *
+ *    @param path Path of the image.
+ *    @param flags Flags the image will be loaded with.
+ */
+void gl_texPrefetch( const char *path, unsigned int flags )
+{
+   char buf[PATH_MAX];
+
+   if ((path == NULL) || (flags & OPENGL_TEX_MAPTRANS) || (gl_prefetchLock == NULL))
+      return;
+
+   /* Loaded without decoding. */
+   if (gl_compressedFind( path, buf, sizeof(buf) ) != NULL)
+      return;
+
+   /* Already loaded. */
+   if (gl_texLookup( path, 1, 1, flags ) != NULL)
+      return;
+
+   gl_prefetchStart( path, flags );
+}
+
+
+/**
+ * @brief Starts decoding an image in the background unless it already is.
+ *
+ *    @param path Path of the image.
+ *    @param flags Flags the image will be loaded with.
+ */
+static void gl_prefetchStart( const char *path, unsigned int flags )
+{
+   int i;
+   glTexPrefetch *p;
+
+   SDL_LockMutex( gl_prefetchLock );
+   for (i=0; i<array_size(gl_prefetch); i++) {
+      if ((gl_prefetch[i]->flags == flags) && (strcmp( gl_prefetch[i]->path, path ) == 0)) {
+         SDL_UnlockMutex( gl_prefetchLock );
+         return;
+      }
+   }
+   p = calloc( 1, sizeof(glTexPrefetch) );
+   p->path  = strdup( path );
+   p->flags = flags;
+   array_push_back( &gl_prefetch, p );
+   SDL_UnlockMutex( gl_prefetchLock );
+
+   threadpool_newJob( gl_prefetchJob, p );
+}
+
+
+/**
+ * @brief Drops all the prefetched images that weren't used.
+ */
+void gl_texPrefetchClear (void)
+{
+   int i;
+
+   if (gl_prefetchLock == NULL)
+      return;
+
+   SDL_LockMutex( gl_prefetchLock );
+   for (i=0; i<array_size(gl_prefetch); i++) {
+      if (gl_prefetch[i]->done)
+         gl_prefetchFree( gl_prefetch[i] );
+      else
+         gl_prefetch[i]->abandoned = 1;
+   }
+   array_resize( &gl_prefetch, 0 );
+   SDL_UnlockMutex( gl_prefetchLock );
+}
+
+
+/**
+ * @brief Makes a texture loaded from a file evictable.
+ *
+ * Textures that are packed in an atlas or have a transparency map are kept,
+ *  as they can't be reloaded on their own.
+ *
+ *    @param texture Texture that was just created from its path.
+ */
+static void gl_texManage( glTexture *texture )
+{
+   GLint compressed, size;
+
+   if ((texture == NULL) || (texture->name == NULL) || (texture->texture == 0) ||
+         (texture->flags & OPENGL_TEX_ATLAS) || (texture->trans != NULL))
+      return;
+
+   /* Ask the driver, as it may have compressed the texture. */
+   gl_bindTexture( GL_TEXTURE_2D, texture->texture );
+   compressed = 0;
+   glGetTexLevelParameteriv( GL_TEXTURE_2D, 0, GL_TEXTURE_COMPRESSED, &compressed );
+   if (compressed)
+      glGetTexLevelParameteriv( GL_TEXTURE_2D, 0, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &size );
+   else
+      size = (GLint)texture->w * (GLint)texture->h * 4;
+   gl_checkErr();
+
+   texture->vram = size;
+   if (texture->flags & OPENGL_TEX_MIPMAPS)
+      texture->vram += texture->vram / 3;
+   texture->evictable = 1;
+   texture->drawn     = gl_texFrame;
+   gl_texResident    += texture->vram;
+}
+
+
+/**
+ * @brief Loads an evicted texture again.
+ *
+ * Precompressed textures are loaded right away, otherwise the image is
+ *  decoded in the background and uploaded on a later call.
+ *
+ *    @param texture Evicted texture to reload.
+ *    @param wait Whether to wait for the image to be decoded.
+ */
+static void gl_texReload( glTexture *texture, int wait )
+{
+   SDL_Surface *surface;
+   SDL_RWops *rw;
+   unsigned int flags;
+   int w, h, ret;
+
+   flags = texture->flags & OPENGL_TEX_MIPMAPS;
+   w     = (int)texture->w;
+   h     = (int)texture->h;
+   texture->texture = gl_loadCompressed( texture->name, flags, &w, &h );
+   if (texture->texture == 0) {
+      ret = gl_prefetchPoll( texture->name, flags, &surface );
+      if (ret < 0) {
+         if (!wait) {
+            gl_prefetchStart( texture->name, flags );
+            return;
+         }
+         rw = PHYSFSRWOPS_openRead( texture->name );
+         surface = (rw != NULL) ? IMG_Load_RW( rw, 1 ) : NULL;
+      }
+      else if (ret == 0) {
+         if (!wait)
+            return;
+         surface = gl_prefetchTake( texture->name, flags );
+      }
+
+      /* Stop trying if it's gone or changed. */
+      if ((surface == NULL) || (surface->w != w) || (surface->h != h)) {
+         WARN(_("Unable to reload texture '%s'!"), texture->name);
+         if (surface != NULL)
+            SDL_FreeSurface( surface );
+         texture->evictable = 0;
+         return;
+      }
+      texture->texture = gl_loadSurface( surface, texture->flags, 1 );
+   }
+   gl_texResident += texture->vram;
+}
+
+
+/**
+ * @brief Unloads a texture from the GPU, it is reloaded when drawn.
+ *
+ *    @param texture Texture to evict.
+ */
+static void gl_texEvict( glTexture *texture )
+{
+   gl_deleteTextures( 1, &texture->texture );
+   texture->texture = 0;
+   gl_texResident  -= texture->vram;
+}
+
+
+/**
+ * @brief Compares textures by when they were last drawn, oldest first.
+ */
+static int gl_texCmpDrawn( const void *p1, const void *p2 )
+{
+   const glTexture *t1 = *(const glTexture**) p1;
+   const glTexture *t2 = *(const glTexture**) p2;
+   if (t1->drawn < t2->drawn)
+      return -1;
+   else if (t1->drawn > t2->drawn)
+      return +1;
+   return 0;
+}
+
+
+/**
+ * @brief Marks a texture as drawn, reloading it if it was evicted.
+ *
+ *    @param texture Texture being drawn.
+ *    @return 1 if the texture can be drawn, 0 if it is still being reloaded.
+ */
+int gl_texUse( const glTexture *texture )
+{
+   /* Only the residency changes, what is drawn stays the same. */
+   glTexture *t = (glTexture*) texture;
+
+   t->drawn = gl_texFrame;
+   if ((t->texture == 0) && t->evictable)
+      gl_texReload( t, 0 );
+   return (t->texture != 0);
+}
+
+
+/**
+ * @brief Makes sure a texture is loaded and is never evicted.
+ *
+ * Needed when something else holds on to the opengl texture or changes its
+ *  state, which would be lost when reloading.
+ *
+ *    @param texture Texture to pin.
+ */
+void gl_texPin( glTexture *texture )
+{
+   if ((texture == NULL) || !texture->evictable)
+      return;
+   if (texture->texture == 0)
+      gl_texReload( texture, 1 );
+   if (texture->evictable && (texture->texture != 0))
+      gl_texResident -= texture->vram;
+   texture->evictable = 0;
+}
+
+
+/**
+ * @brief Keeps the evictable textures within the VRAM budget, run once per
+ *        frame.
+ *
+ * Textures loaded from a file, such as planets, portraits and backgrounds,
+ *  are evicted starting with the ones drawn longest ago until they fit in
+ *  conf.vram_budget again.
+ */
+void gl_texUpdateResidency (void)
+{
+   glTexture **cand;
+   glTexList *tex;
+   unsigned int i;
+   size_t budget;
+   int j;
+
+   gl_texFrame++;
+   if ((conf.vram_budget <= 0) || (gl_texFrame % OPENGL_TEX_CHECK != 0))
+      return;
+   budget = (size_t)conf.vram_budget << 20;
+   if (gl_texResident <= budget)
+      return;
+
+   cand = array_create( glTexture* );
+   for (i=0; i<texture_nbuckets; i++)
+      for (tex=texture_buckets[i]; tex!=NULL; tex=tex->next)
+         if (tex->tex->evictable && (tex->tex->texture != 0) &&
+               (gl_texFrame - tex->tex->drawn > OPENGL_TEX_RECENT))
+            array_push_back( &cand, tex->tex );
+   qsort( cand, array_size(cand), sizeof(glTexture*), gl_texCmpDrawn );
+   for (j=0; (j<array_size(cand)) && (gl_texResident > budget); j++)
+      gl_texEvict( cand[j] );
+   array_free( cand );
+}
+
+
+/**
+ * @brief Estimates the GPU memory used by the cached textures.
+ *
+ * Counts the textures currently loaded at 4 bytes per pixel (or their
+ *  compressed size when managed) and the atlas pages. Render targets and
+ *  textures created outside of the cache are not included.
+ *
+ *    @return Estimated memory in bytes.
+ */
+size_t gl_texMemory (void)
+{
+   glTexList *tex;
+   const glTexture *t;
+   unsigned int i;
+   size_t size, total;
+   int j;
+
+   total = 0;
+   for (i=0; i<texture_nbuckets; i++) {
+      for (tex=texture_buckets[i]; tex!=NULL; tex=tex->next) {
+         t = tex->tex;
+         if ((t->texture == 0) || (t->flags & OPENGL_TEX_ATLAS))
+            continue;
+         if (t->evictable)
+            size = t->vram;
+         else {
+            size = (size_t)t->w * (size_t)t->h * 4;
+            if (t->flags & OPENGL_TEX_MIPMAPS)
+               size += size / 3;
+         }
+         total += size;
+      }
+   }
+   for (j=0; j<array_size(gl_atlases); j++)
+      if (gl_atlases[j].texture != 0)
+         total += (size_t)OPENGL_ATLAS_SIZE * OPENGL_ATLAS_SIZE * 4;
+   return total;
 }
 
 
@@ -624,7 +1799,7 @@ glTexture* gl_newImageRWops( const char* path, SDL_RWops *rw, const unsigned int
    glTexture *t;
 
    /* Check if it already exists. */
-   t = gl_texExists( path, 1, 1 );
+   t = gl_texExists( path, 1, 1, flags );
    if (t != NULL)
       return t;
 
@@ -768,37 +1943,32 @@ glTexture* gl_newSpriteRWops( const char* path, SDL_RWops *rw,
  */
 void gl_freeTexture( glTexture* texture )
 {
-   glTexList *cur, *last;
+   glTexList *cur, **prev;
 
    if (texture == NULL)
       return;
 
-   /* see if we can find it in stack */
-   last = NULL;
-   for (cur=texture_list; cur!=NULL; cur=cur->next) {
-      if (cur->tex == texture) { /* found it */
-         cur->used--;
-         if (cur->used <= 0) { /* not used anymore */
-            /* free the texture */
-            glDeleteTextures( 1, &texture->texture );
-            free(texture->trans);
-            free(texture->name);
-            free(texture);
-
-            /* free the list node */
-            if (last == NULL) { /* case there's no texture before it */
-               if (cur->next != NULL)
-                  texture_list = cur->next;
-               else /* case it's the last texture */
-                  texture_list = NULL;
-            }
-            else
-               last->next = cur->next;
-            free(cur);
-         }
-         return; /* we already found it so we can exit */
+   /* see if we can find it in the cache */
+   cur = gl_texFind( texture );
+   if (cur != NULL) {
+      cur->used--;
+      if (cur->used <= 0) { /* not used anymore */
+         /* unlink the node, has to be done before freeing the name */
+         prev = &texture_buckets[ cur->hash & (texture_nbuckets-1) ];
+         while (*prev != cur)
+            prev = &(*prev)->next;
+         *prev = cur->next;
+         free(cur);
+         texture_count--;
+
+         /* free the texture */
+         gl_texDelete( texture );
+         free(texture->trans);
+         gl_transMaskFree(texture->mask);
+         free(texture->name);
+         free(texture);
       }
-      last = cur;
+      return; /* we already found it so we can exit */
    }
 
    /* Not found */
@@ -806,8 +1976,9 @@ void gl_freeTexture( glTexture* texture )
       WARN(_("Attempting to free texture '%s' not found in stack!"), texture->name);
 
    /* Free anyways */
-   glDeleteTextures( 1, &texture->texture );
+   gl_texDelete( texture );
    free(texture->trans);
+   gl_transMaskFree(texture->mask);
    free(texture->name);
    free(texture);
 
@@ -815,6 +1986,23 @@ void gl_freeTexture( glTexture* texture )
 }
 
 
+/**
+ * @brief Deletes the opengl texture of a texture.
+ *
+ *    @param texture Texture to delete opengl texture of.
+ */
+static void gl_texDelete( glTexture *texture )
+{
+   if (texture->flags & OPENGL_TEX_ATLAS)
+      gl_atlasRelease( texture->texture );
+   else if (texture->texture != 0) {
+      if (texture->evictable)
+         gl_texResident -= texture->vram;
+      gl_deleteTextures( 1, &texture->texture );
+   }
+}
+
+
 /**
  * @brief Duplicates a texture.
  *
@@ -830,13 +2018,10 @@ glTexture* gl_dupTexture( glTexture *texture )
       return NULL;
 
    /* check to see if it already exists */
-   if (texture_list != NULL) {
-      for (cur=texture_list; cur!=NULL; cur=cur->next) {
-         if (texture == cur->tex) {
-            cur->used += 1;
-            return cur->tex;
-         }
-      }
+   cur = gl_texFind( texture );
+   if (cur != NULL) {
+      cur->used += 1;
+      return cur->tex;
    }
 
    /* Invalid texture. */
@@ -845,6 +2030,21 @@ glTexture* gl_dupTexture( glTexture *texture )
 }
 
 
+/**
+ * @brief Gets how many references to a texture are held.
+ *
+ *    @param texture Texture to check.
+ *    @return Number of references, 0 if the texture isn't in the list.
+ */
+int gl_texRefs( const glTexture *texture )
+{
+   glTexList *cur;
+
+   cur = gl_texFind( texture );
+   return (cur != NULL) ? cur->used : 0;
+}
+
+
 /**
  * @brief Checks to see if a pixel is transparent in a texture.
  *
@@ -935,6 +2135,27 @@ glTexture** gl_copyTexArray( glTexture **tex, int *n )
  */
 int gl_initTextures (void)
 {
+   size_t i;
+   glTexFormat *fmt;
+
+   /* See what precompressed formats can be used. */
+   gl_texFormatsAny = 0;
+   for (i=0; i<sizeof(gl_texFormats)/sizeof(gl_texFormats[0]); i++) {
+      fmt = &gl_texFormats[i];
+      fmt->supported = ((fmt->major > 0) && gl_hasVersion( fmt->major, fmt->minor )) ||
+            gl_hasExtension( fmt->ext );
+      if (fmt->supported) {
+         DEBUG(_("Using precompressed '%s' textures"), fmt->name);
+         gl_texFormatsAny = 1;
+      }
+   }
+
+   if (gl_prefetch == NULL)
+      gl_prefetch = array_create( glTexPrefetch* );
+   if (gl_prefetchLock == NULL) {
+      gl_prefetchLock = SDL_CreateMutex();
+      gl_prefetchCond = SDL_CreateCond();
+   }
    return 0;
 }
 
@@ -945,13 +2166,28 @@ int gl_initTextures (void)
 void gl_exitTextures (void)
 {
    glTexList *tex;
+   unsigned int i;
 
    /* Make sure there's no texture leak */
-   if (texture_list != NULL) {
+   if (texture_count > 0) {
       DEBUG(_("Texture leak detected!"));
-      for (tex=texture_list; tex!=NULL; tex=tex->next)
-         DEBUG( n_( "   '%s' opened %d time", "   '%s' opened %d times", tex->used ), tex->tex->name, tex->used );
+      for (i=0; i<texture_nbuckets; i++)
+         for (tex=texture_buckets[i]; tex!=NULL; tex=tex->next)
+            DEBUG( n_( "   '%s' opened %d time", "   '%s' opened %d times", tex->used ), tex->tex->name, tex->used );
    }
+   else {
+      free( texture_buckets );
+      texture_buckets  = NULL;
+      texture_nbuckets = 0;
+   }
+
+   /* Workers still decoding free their own abandoned prefetches, so the
+    * lock is kept around for them. */
+   gl_texPrefetchClear();
+
+   /* Atlas pages are freed along with their last texture. */
+   array_free( gl_atlases );
+   gl_atlases = NULL;
 }
 
 
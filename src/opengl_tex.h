@@ -30,6 +30,20 @@
 #define OPENGL_TEX_MAPTRANS   (1<<0) /**< Create a transparency map. */
 #define OPENGL_TEX_MIPMAPS    (1<<1) /**< Creates mipmaps. */
 #define OPENGL_TEX_VFLIP      (1<<2) /**< Assume loaded from an image (where positive y means down). */
+#define OPENGL_TEX_ATLAS      (1<<3) /**< Pack into a shared atlas texture if small enough. Only for textures drawn with gl_blit*. */
+
+/**
+ * @brief Collision mask of the sprites of a sheet.
+ *
+ * Each row of a sprite is packed in 64 bit words, so overlaps can be tested
+ *  a word at a time instead of pixel by pixel. Sprites are in the same order
+ *  as in the sheet, rows from the top of the image.
+ */
+typedef struct glTexMask_ {
+   int words; /**< Number of words per row. */
+   uint64_t *bits; /**< Rows of all the sprites, bit n of word i is pixel 64*i+n. */
+   int16_t *box; /**< Bounding box of the opaque pixels of each sprite as x0, y0, x1, y1, with x1 < x0 if empty. */
+} glTexMask;
 
 /**
  * @brief Abstraction for rendering sprite sheets.
@@ -51,12 +65,24 @@ typedef struct glTexture_ {
    double srw; /**< Sprite render width - equivalent to sw/w. */
    double srh; /**< Sprite render height - equivalent to sh/h. */
 
+   /* atlas */
+   double ox; /**< X offset of the image in the opengl texture [0:1]. */
+   double oy; /**< Y offset of the image in the opengl texture [0:1]. */
+   double ow; /**< Width of the image in the opengl texture [0:1]. */
+   double oh; /**< Height of the image in the opengl texture [0:1]. */
+
    /* data */
    GLuint texture; /**< the opengl texture itself */
    uint8_t* trans; /**< maps the transparency */
+   glTexMask* mask; /**< Collision mask built from trans. */
 
    /* properties */
    uint8_t flags; /**< flags used for texture properties */
+
+   /* residency, see gl_texUpdateResidency() */
+   uint8_t evictable; /**< Can be unloaded from the GPU and reloaded from name. */
+   size_t vram; /**< Estimated GPU memory used by the texture when loaded. */
+   unsigned int drawn; /**< Frame the texture was last drawn in. */
 } glTexture;
 
 
@@ -82,6 +108,19 @@ glTexture* gl_newSprite( const char* path, const int sx, const int sy,
 glTexture* gl_newSpriteRWops( const char* path, SDL_RWops *rw,
    const int sx, const int sy, const unsigned int flags );
 glTexture* gl_dupTexture( glTexture *texture );
+int gl_texRefs( const glTexture *texture );
+void gl_texResetParameters( const glTexture *texture );
+void gl_texCacheStats( unsigned int *hits, unsigned int *misses );
+void gl_texPrefetch( const char *path, unsigned int flags );
+void gl_texPrefetchClear (void);
+
+/*
+ * Residency.
+ */
+int gl_texUse( const glTexture *texture );
+void gl_texPin( glTexture *texture );
+void gl_texUpdateResidency (void);
+size_t gl_texMemory (void);
 
 /*
  * Clean up.
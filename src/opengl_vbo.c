@@ -10,6 +10,8 @@
 
 
 /** @cond */
+#include <string.h>
+
 #include "naev.h"
 /** @endcond */
 
@@ -19,6 +21,35 @@
 
 #define BUFFER_OFFSET(i) ((char *)(sizeof(char) * (i))) /**< Taken from OpengL spec. */
 
+#define VBO_RING_SIZE      (4*1024*1024) /**< Size of the streaming ring buffer (bytes). */
+#define VBO_RING_SECTIONS  4 /**< Sections of the ring, each guarded by a fence. */
+#define VBO_RING_ALIGN     16 /**< Alignment of the streamed data (bytes). */
+
+/* GL_ARB_buffer_storage (core in OpenGL 4.4) and GL_ARB_sync (core in
+ * OpenGL 3.2), not part of our loader. */
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT          0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT            0x0080
+#endif
+#ifndef GL_SYNC_GPU_COMMANDS_COMPLETE
+#define GL_SYNC_GPU_COMMANDS_COMPLETE  0x9117
+#endif
+#ifndef GL_SYNC_FLUSH_COMMANDS_BIT
+#define GL_SYNC_FLUSH_COMMANDS_BIT     0x00000001
+#endif
+#ifndef GL_TIMEOUT_EXPIRED
+#define GL_TIMEOUT_EXPIRED             0x911B
+#endif
+#ifndef GL_WAIT_FAILED
+#define GL_WAIT_FAILED                 0x911D
+#endif
+typedef void (APIENTRYP glBufferStorageFunc)( GLenum target, GLsizeiptr size, const void *data, GLbitfield flags );
+typedef GLsync (APIENTRYP glFenceSyncFunc)( GLenum condition, GLbitfield flags );
+typedef GLenum (APIENTRYP glClientWaitSyncFunc)( GLsync sync, GLbitfield flags, GLuint64 timeout );
+typedef void (APIENTRYP glDeleteSyncFunc)( GLsync sync );
+
 
 /**
  * @brief VBO types.
@@ -42,10 +73,25 @@ struct gl_vbo_s {
 };
 
 
+/*
+ * Streaming ring buffer.
+ */
+static gl_vbo *vbo_ring = NULL; /**< Persistently mapped ring, NULL if not supported. */
+static char *vbo_ringMap = NULL; /**< Mapping of vbo_ring. */
+static GLsizei vbo_ringPos = 0; /**< Next free byte of vbo_ring. */
+static int vbo_ringSection = 0; /**< Section vbo_ringPos is in. */
+static GLsync vbo_ringFence[VBO_RING_SECTIONS]; /**< Fences of the sections in use by the GPU. */
+static glFenceSyncFunc gl_fenceSync = NULL; /**< glFenceSync. */
+static glClientWaitSyncFunc gl_clientWaitSync = NULL; /**< glClientWaitSync. */
+static glDeleteSyncFunc gl_deleteSync = NULL; /**< glDeleteSync. */
+
+
 /**
  * Prototypes.
  */
 static gl_vbo* gl_vboCreate( GLenum target, GLsizei size, void* data, GLenum usage );
+static void gl_vboRingInit (void);
+static void gl_vboRingWait( int section );
 
 
 /**
@@ -55,6 +101,7 @@ static gl_vbo* gl_vboCreate( GLenum target, GLsizei size, void* data, GLenum usa
  */
 int gl_initVBO (void)
 {
+   gl_vboRingInit();
    return 0;
 }
 
@@ -64,6 +111,138 @@ int gl_initVBO (void)
  */
 void gl_exitVBO (void)
 {
+   int i;
+
+   if (vbo_ring == NULL)
+      return;
+
+   for (i=0; i<VBO_RING_SECTIONS; i++) {
+      if (vbo_ringFence[i] != NULL)
+         gl_deleteSync( vbo_ringFence[i] );
+      vbo_ringFence[i] = NULL;
+   }
+   glBindBuffer( GL_ARRAY_BUFFER, vbo_ring->id );
+   glUnmapBuffer( GL_ARRAY_BUFFER );
+   glBindBuffer( GL_ARRAY_BUFFER, 0 );
+   gl_vboDestroy( vbo_ring );
+   vbo_ring    = NULL;
+   vbo_ringMap = NULL;
+   vbo_ringPos = 0;
+   vbo_ringSection = 0;
+}
+
+
+/**
+ * @brief Sets up the persistently mapped streaming ring buffer if supported.
+ *
+ * Streamed data is written straight into the mapping. The ring is split in
+ *  sections and a fence is placed when a section is left, so that it is only
+ *  written again once the GPU is done with it instead of having the driver
+ *  sync or reallocate on every upload.
+ */
+static void gl_vboRingInit (void)
+{
+   glBufferStorageFunc gl_bufferStorage;
+   GLbitfield flags;
+
+   if (!gl_hasVersion( 4, 4 ) && !gl_hasExtension( "GL_ARB_buffer_storage" ))
+      return;
+   if (!gl_hasVersion( 3, 2 ) && !gl_hasExtension( "GL_ARB_sync" ))
+      return;
+
+   gl_bufferStorage  = (glBufferStorageFunc) SDL_GL_GetProcAddress( "glBufferStorage" );
+   gl_fenceSync      = (glFenceSyncFunc) SDL_GL_GetProcAddress( "glFenceSync" );
+   gl_clientWaitSync = (glClientWaitSyncFunc) SDL_GL_GetProcAddress( "glClientWaitSync" );
+   gl_deleteSync     = (glDeleteSyncFunc) SDL_GL_GetProcAddress( "glDeleteSync" );
+   if ((gl_bufferStorage == NULL) || (gl_fenceSync == NULL) ||
+         (gl_clientWaitSync == NULL) || (gl_deleteSync == NULL))
+      return;
+
+   vbo_ring       = calloc( 1, sizeof(gl_vbo) );
+   vbo_ring->size = VBO_RING_SIZE;
+   vbo_ring->type = NGL_VBO_STREAM;
+   flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+   glGenBuffers( 1, &vbo_ring->id );
+   glBindBuffer( GL_ARRAY_BUFFER, vbo_ring->id );
+   gl_bufferStorage( GL_ARRAY_BUFFER, VBO_RING_SIZE, NULL, flags );
+   vbo_ringMap = glMapBufferRange( GL_ARRAY_BUFFER, 0, VBO_RING_SIZE, flags );
+   glBindBuffer( GL_ARRAY_BUFFER, 0 );
+
+   if (vbo_ringMap == NULL) {
+      WARN(_("Unable to map the streaming buffer, falling back to orphaning."));
+      gl_vboDestroy( vbo_ring );
+      vbo_ring = NULL;
+      glGetError(); /* Don't leave the error around. */
+      return;
+   }
+   memset( vbo_ringFence, 0, sizeof(vbo_ringFence) );
+   vbo_ringPos = 0;
+   vbo_ringSection = 0;
+
+   DEBUG(_("Streaming vertex data through a persistently mapped buffer"));
+}
+
+
+/**
+ * @brief Waits until the GPU is done with a section of the ring.
+ *
+ *    @param section Section to wait for.
+ */
+static void gl_vboRingWait( int section )
+{
+   GLenum ret;
+
+   if (vbo_ringFence[section] == NULL)
+      return;
+
+   do {
+      ret = gl_clientWaitSync( vbo_ringFence[section], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000 );
+   } while (ret == GL_TIMEOUT_EXPIRED);
+   if (ret == GL_WAIT_FAILED)
+      WARN(_("Failed to wait on streaming buffer fence."));
+
+   gl_deleteSync( vbo_ringFence[section] );
+   vbo_ringFence[section] = NULL;
+}
+
+
+/**
+ * @brief Streams data to be drawn right away.
+ *
+ * The data goes to the persistently mapped ring buffer when possible, else it
+ *  gets uploaded to the fallback VBO like gl_vboData() does. The data may only
+ *  be used by draws issued before the next call that streams data.
+ *
+ *    @param fallback Stream VBO to use if the ring can't be used.
+ *    @param size Size of the data (in bytes).
+ *    @param data Data to stream.
+ *    @param[out] offset Offset of the data in the returned VBO (in bytes).
+ *    @return The VBO holding the data.
+ */
+gl_vbo* gl_vboStream( gl_vbo *fallback, GLsizei size, const void *data, GLuint *offset )
+{
+   GLsizei sectsize, pos;
+
+   sectsize = VBO_RING_SIZE / VBO_RING_SECTIONS;
+   if ((vbo_ring == NULL) || (size > sectsize)) {
+      gl_vboData( fallback, size, (void*) data );
+      *offset = 0;
+      return fallback;
+   }
+
+   /* Data doesn't cross a section, so move on to the next one when full. */
+   pos = (vbo_ringPos + VBO_RING_ALIGN-1) & ~(VBO_RING_ALIGN-1);
+   if (pos + size > (vbo_ringSection+1) * sectsize) {
+      vbo_ringFence[ vbo_ringSection ] = gl_fenceSync( GL_SYNC_GPU_COMMANDS_COMPLETE, 0 );
+      vbo_ringSection = (vbo_ringSection+1) % VBO_RING_SECTIONS;
+      gl_vboRingWait( vbo_ringSection );
+      pos = vbo_ringSection * sectsize;
+   }
+
+   memcpy( &vbo_ringMap[pos], data, size );
+   vbo_ringPos = pos + size;
+   *offset     = pos;
+   return vbo_ring;
 }
 
 
@@ -34,6 +34,7 @@ gl_vbo* gl_vboCreateStatic( GLsizei size, void* data );
  */
 void gl_vboData( gl_vbo *vbo, GLsizei size, void* data );
 void gl_vboSubData( gl_vbo *vbo, GLint offset, GLsizei size, void* data );
+gl_vbo* gl_vboStream( gl_vbo *fallback, GLsizei size, const void *data, GLuint *offset );
 void* gl_vboMap( gl_vbo *vbo );
 void gl_vboUnmap( gl_vbo *vbo );
 void gl_vboActivate( gl_vbo *vbo, GLuint class, GLint size, GLenum type, GLsizei stride );
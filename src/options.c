@@ -26,7 +26,9 @@
 #include "music.h"
 #include "ndata.h"
 #include "nstring.h"
+#include "outfit.h"
 #include "player.h"
+#include "ship.h"
 #include "sound.h"
 #include "toolkit.h"
 
@@ -414,6 +416,8 @@ static int opt_gameplaySave( unsigned int wid, char *str )
       conf.language = (s==NULL) ? NULL : strdup( s );
       /* Apply setting going forward; advise restart to regen other text. */
       gettext_setLanguage( conf.language );
+      outfit_descFlush();
+      ships_descFlush();
       opt_needRestart();
    }
 
@@ -40,6 +40,7 @@
 #include "ship.h"
 #include "slots.h"
 #include "spfx.h"
+#include "strindex.h"
 #include "unistd.h"
 
 
@@ -48,12 +49,15 @@
 #define XML_OUTFIT_TAG     "outfit"    /**< XML section identifier. */
 
 #define OUTFIT_SHORTDESC_MAX  1024 /**< Max length of the short description of the outfit. */
+#define OUTFIT_DESC_CACHE     128 /**< Short descriptions to keep generated. */
 
 
 /*
  * the stack
  */
 static Outfit* outfit_stack = NULL; /**< Stack of outfits. */
+static StrIndex outfit_index; /**< Outfits by name. */
+static Outfit** outfit_descCache = NULL; /**< Array (array.h): Outfits with a short description, least recently used first. */
 
 
 /*
@@ -62,11 +66,11 @@ static Outfit* outfit_stack = NULL; /**< Stack of outfits. */
 /* misc */
 static OutfitType outfit_strToOutfitType( char *buf );
 static int outfit_setDefaultSize( Outfit *o );
-static void outfit_launcherDesc( Outfit* o );
+static void outfit_genDesc( const Outfit* o, char *buf, int n );
 /* parsing */
 static int outfit_loadDir( char *dir );
 static int outfit_parseDamage( Damage *dmg, xmlNodePtr node );
-static int outfit_parse( Outfit* temp, const char* file );
+static int outfit_parse( Outfit* temp, xmlDocPtr doc );
 static void outfit_parseSBolt( Outfit* temp, const xmlNodePtr parent );
 static void outfit_parseSBeam( Outfit* temp, const xmlNodePtr parent );
 static void outfit_parseSLauncher( Outfit* temp, const xmlNodePtr parent );
@@ -92,9 +96,9 @@ Outfit* outfit_get( const char* name )
 {
    int i;
 
-   for (i=0; i<array_size(outfit_stack); i++)
-      if (strcmp(name,outfit_stack[i].name)==0)
-         return &outfit_stack[i];
+   i = strindex_get( &outfit_index, name );
+   if (i >= 0)
+      return &outfit_stack[i];
 
    WARN(_("Outfit '%s' not found in stack."), name);
    return NULL;
@@ -109,10 +113,9 @@ Outfit* outfit_get( const char* name )
  */
 Outfit* outfit_getW( const char* name )
 {
-   int i;
-   for (i=0; i<array_size(outfit_stack); i++)
-      if (strcmp(name,outfit_stack[i].name)==0)
-         return &outfit_stack[i];
+   int i = strindex_get( &outfit_index, name );
+   if (i >= 0)
+      return &outfit_stack[i];
    return NULL;
 }
 
@@ -131,10 +134,9 @@ const Outfit* outfit_getAll (void)
  */
 const char *outfit_existsCase( const char* name )
 {
-   int i;
-   for (i=0; i<array_size(outfit_stack); i++)
-      if (strcasecmp(name,outfit_stack[i].name)==0)
-         return outfit_stack[i].name;
+   int i = strindex_getCase( &outfit_index, name );
+   if (i >= 0)
+      return outfit_stack[i].name;
    return NULL;
 }
 
@@ -1078,9 +1080,6 @@ static int outfit_parseDamage( Damage *dmg, xmlNodePtr node )
 static int outfit_loadPLG( Outfit *temp, char *buf, unsigned int bolt )
 {
    char *file;
-   CollPoly *polygon;
-   xmlDocPtr doc;
-   xmlNodePtr node, cur;
 
    asprintf( &file, "%s%s.xml", OUTFIT_POLYGON_PATH, buf );
 
@@ -1093,54 +1092,13 @@ that can be found in Naev's artwork repo."), file);
       return 0;
    }
 
-   /* Load the XML. */
-   doc  = xml_parsePhysFS( file );
-
-   if (doc == NULL) {
-      free(file);
-      return 0;
-   }
-
-   node = doc->xmlChildrenNode; /* First polygon node */
-   if (node == NULL) {
-      xmlFreeDoc(doc);
-      WARN(_("Malformed %s file: does not contain elements"), file);
-      free(file);
-      return 0;
-   }
+   /* Load the polygon data, bolts and ammo store it separately. */
+   if (bolt)
+      temp->u.blt.polygon = LoadPolygonFile( file, 36 );
+   else
+      temp->u.amm.polygon = LoadPolygonFile( file, 36 );
 
    free(file);
-
-   if (bolt) {
-      do { /* load the polygon data */
-         if (xml_isNode(node,"polygons")) {
-            cur = node->children;
-            temp->u.blt.polygon = array_create_size( CollPoly, 36 );
-            do {
-               if (xml_isNode(cur,"polygon")) {
-                  polygon = &array_grow( &temp->u.blt.polygon );
-                  LoadPolygon( polygon, cur );
-               }
-            } while (xml_nextNode(cur));
-         }
-      } while (xml_nextNode(node));
-   }
-   else {
-      do { /* Second case: outfit is an ammo */
-         if (xml_isNode(node,"polygons")) {
-            cur = node->children;
-            temp->u.amm.polygon = array_create_size( CollPoly, 36 );
-            do {
-               if (xml_isNode(cur,"polygon")) {
-                  polygon = &array_grow( &temp->u.amm.polygon );
-                  LoadPolygon( polygon, cur );
-               }
-            } while (xml_nextNode(cur));
-         }
-      } while (xml_nextNode(node));
-   }
-
-   xmlFreeDoc(doc);
    return 0;
 }
 
@@ -1157,7 +1115,6 @@ static void outfit_parseSBolt( Outfit* temp, const xmlNodePtr parent )
    xmlNodePtr node;
    char *buf;
    double C, area;
-   int l;
 
    /* Defaults */
    temp->u.blt.spfx_armour    = -1;
@@ -1198,7 +1155,7 @@ static void outfit_parseSBolt( Outfit* temp, const xmlNodePtr parent )
       if (xml_isNode(node,"gfx")) {
          temp->u.blt.gfx_space = xml_parseTexture( node,
                OUTFIT_GFX_PATH"space/%s", 6, 6,
-               OPENGL_TEX_MAPTRANS | OPENGL_TEX_MIPMAPS );
+               OPENGL_TEX_MAPTRANS | OPENGL_TEX_MIPMAPS | OPENGL_TEX_ATLAS );
          xmlr_attr_strd(node, "spin", buf);
          if (buf != NULL) {
             outfit_setProp( temp, OUTFIT_PROP_WEAP_SPIN );
@@ -1220,7 +1177,7 @@ static void outfit_parseSBolt( Outfit* temp, const xmlNodePtr parent )
       if (xml_isNode(node,"gfx_end")) {
          temp->u.blt.gfx_end = xml_parseTexture( node,
                OUTFIT_GFX_PATH"space/%s", 6, 6,
-               OPENGL_TEX_MAPTRANS | OPENGL_TEX_MIPMAPS );
+               OPENGL_TEX_MAPTRANS | OPENGL_TEX_MIPMAPS | OPENGL_TEX_ATLAS );
          continue;
       }
 
@@ -1281,38 +1238,6 @@ static void outfit_parseSBolt( Outfit* temp, const xmlNodePtr parent )
    if (temp->slot.size == OUTFIT_SLOT_SIZE_NA)
       outfit_setDefaultSize( temp );
 
-   /* Set short description. */
-   temp->desc_short = malloc( OUTFIT_SHORTDESC_MAX );
-   l = scnprintf( temp->desc_short, OUTFIT_SHORTDESC_MAX,
-         _("%s [%s]\n"
-         "%.0f CPU\n"
-         "%.0f%% Penetration\n"
-         "%.2f DPS [%.0f Damage]\n"),
-         _(outfit_getType(temp)), _(dtype_damageTypeToStr(temp->u.blt.dmg.type)),
-         temp->cpu,
-         temp->u.blt.dmg.penetration*100.,
-         1./temp->u.blt.delay * temp->u.blt.dmg.damage, temp->u.blt.dmg.damage );
-   if (temp->u.blt.dmg.disable > 0.) {
-      l += scnprintf( &temp->desc_short[l], OUTFIT_SHORTDESC_MAX-l,
-         _("%.2f Disable/s [%.0f Disable]\n"),
-         1./temp->u.blt.delay * temp->u.blt.dmg.disable, temp->u.blt.dmg.disable );
-   }
-   l += scnprintf( &temp->desc_short[l], OUTFIT_SHORTDESC_MAX-l,
-         _("%.1f Shots Per Second\n"
-         "%.1f EPS [%.0f Energy]\n"
-         "%.0f Range\n"
-         "%.1f second heat up"),
-         1./temp->u.blt.delay,
-         1./temp->u.blt.delay * temp->u.blt.energy, temp->u.blt.energy,
-         temp->u.blt.range,
-         temp->u.blt.heatup);
-   if (!outfit_isTurret(temp)) {
-      l += scnprintf( &temp->desc_short[l], OUTFIT_SHORTDESC_MAX-l,
-         _("\n%.1f degree swivel"),
-         temp->u.blt.swivel*180./M_PI );
-   }
-   (void)l;
-
 
 #define MELEMENT(o,s) \
 if (o) WARN(_("Outfit '%s' missing/invalid '%s' element"), temp->name, s) /**< Define to help check for data errors. */
@@ -1343,7 +1268,6 @@ if (o) WARN(_("Outfit '%s' missing/invalid '%s' element"), temp->name, s) /**< D
 static void outfit_parseSBeam( Outfit* temp, const xmlNodePtr parent )
 {
    ShipStatList *ll;
-   int l;
    xmlNodePtr node;
    double C, area;
    char *shader;
@@ -1436,33 +1360,6 @@ static void outfit_parseSBeam( Outfit* temp, const xmlNodePtr parent )
    if (temp->slot.size == OUTFIT_SLOT_SIZE_NA)
       outfit_setDefaultSize( temp );
 
-   /* Set short description. */
-   temp->desc_short = malloc( OUTFIT_SHORTDESC_MAX );
-   l = scnprintf( temp->desc_short, OUTFIT_SHORTDESC_MAX,
-         _("%s\n"
-         "%.0f CPU\n"
-         "%.0f%% Penetration\n"
-         "%.2f DPS [%s]\n"),
-         _(outfit_getType(temp)),
-         temp->cpu,
-         temp->u.bem.dmg.penetration*100.,
-         temp->u.bem.dmg.damage, _(dtype_damageTypeToStr(temp->u.bem.dmg.type) ) );
-   if (temp->u.blt.dmg.disable > 0.) {
-      l += scnprintf( &temp->desc_short[l], OUTFIT_SHORTDESC_MAX-l,
-         _("%.0f Disable/s\n"),
-         temp->u.bem.dmg.disable );
-   }
-   l += scnprintf( &temp->desc_short[l], OUTFIT_SHORTDESC_MAX-l,
-         _("%.1f EPS\n"
-         "%.1f Duration %.1f Cooldown\n"
-         "%.0f Range\n"
-         "%.1f second heat up"),
-         temp->u.bem.energy,
-         temp->u.bem.duration, temp->u.bem.delay,
-         temp->u.bem.range,
-         temp->u.bem.heatup);
-   (void)l;
-
 #define MELEMENT(o,s) \
 if (o) WARN( _("Outfit '%s' missing/invalid '%s' element"), temp->name, s) /**< Define to help check for data errors. */
    MELEMENT(temp->u.bem.width==0.,"shader width");
@@ -1586,7 +1483,7 @@ static void outfit_parseSAmmo( Outfit* temp, const xmlNodePtr parent )
       if (xml_isNode(node,"gfx")) {
          temp->u.amm.gfx_space = xml_parseTexture( node,
                OUTFIT_GFX_PATH"space/%s", 6, 6,
-               OPENGL_TEX_MAPTRANS | OPENGL_TEX_MIPMAPS );
+               OPENGL_TEX_MAPTRANS | OPENGL_TEX_MIPMAPS | OPENGL_TEX_ATLAS );
          xmlr_attr_float(node, "spin", temp->u.amm.spin);
          if (temp->u.amm.spin != 0)
             outfit_setProp( temp, OUTFIT_PROP_WEAP_SPIN );
@@ -1650,10 +1547,6 @@ static void outfit_parseSAmmo( Outfit* temp, const xmlNodePtr parent )
    /* Post-processing */
    temp->u.amm.turn *= M_PI/180.; /* Convert to rad/s. */
 
-   /* Set short description. */
-   temp->desc_short = malloc( OUTFIT_SHORTDESC_MAX );
-   temp->desc_short[0]='\0';
-
 #define MELEMENT(o,s) \
 if (o) WARN(_("Outfit '%s' missing/invalid '%s' element"), temp->name, s) /**< Define to help check for data errors. */
    MELEMENT(temp->mass==0.,"mass");
@@ -1683,7 +1576,6 @@ if (o) WARN(_("Outfit '%s' missing/invalid '%s' element"), temp->name, s) /**< D
  */
 static void outfit_parseSMod( Outfit* temp, const xmlNodePtr parent )
 {
-   int i;
    xmlNodePtr node;
    ShipStatList *ll;
    node = parent->children;
@@ -1692,6 +1584,8 @@ static void outfit_parseSMod( Outfit* temp, const xmlNodePtr parent )
    temp->u.mod.lua_env = LUA_NOREF;
    temp->u.mod.lua_init = LUA_NOREF;
    temp->u.mod.lua_update = LUA_NOREF;
+   temp->u.mod.lua_update_batch = LUA_NOREF;
+   temp->u.mod.lua_update_dt = 0.;
    temp->u.mod.lua_ontoggle = LUA_NOREF;
    temp->u.mod.lua_onhit = LUA_NOREF;
    temp->u.mod.lua_outofenergy = LUA_NOREF;
@@ -1754,6 +1648,11 @@ static void outfit_parseSMod( Outfit* temp, const xmlNodePtr parent )
          /* Check functions as necessary. */
          temp->u.mod.lua_init = nlua_refenv( env, "init" );
          temp->u.mod.lua_update = nlua_refenv( env, "update" );
+         temp->u.mod.lua_update_batch = nlua_refenv( env, "update_batch" );
+         nlua_getenv( env, "update_dt" );
+         if (lua_isnumber( naevL, -1 ))
+            temp->u.mod.lua_update_dt = MAX( 0., lua_tonumber( naevL, -1 ) );
+         lua_pop( naevL, 1 );
          temp->u.mod.lua_ontoggle = nlua_refenv( env, "ontoggle" );
          temp->u.mod.lua_onhit = nlua_refenv( env, "onhit" );
          temp->u.mod.lua_outofenergy = nlua_refenv( env, "outofenergy" );
@@ -1775,37 +1674,6 @@ static void outfit_parseSMod( Outfit* temp, const xmlNodePtr parent )
    if (temp->slot.size == OUTFIT_SLOT_SIZE_NA)
       outfit_setDefaultSize( temp );
 
-   /* Set short description. */
-   temp->desc_short = malloc( OUTFIT_SHORTDESC_MAX );
-   i = scnprintf( temp->desc_short, OUTFIT_SHORTDESC_MAX,
-         "%s"
-         "%s",
-         _(outfit_getType(temp)),
-         (temp->u.mod.active) ? _("\n#rActivated Outfit#0") : "" );
-
-#define DESC_ADD(x, s) \
-if ((x) != 0) \
-   do { \
-      i += scnprintf( &temp->desc_short[i], OUTFIT_SHORTDESC_MAX-i, "\n#%c", ((x)>0)?'g':'r' ); \
-      i += scnprintf( &temp->desc_short[i], OUTFIT_SHORTDESC_MAX-i, s, x ); \
-      i += scnprintf( &temp->desc_short[i], OUTFIT_SHORTDESC_MAX-i, "#0" ); \
-   } while(0)
-   DESC_ADD( temp->cpu,                _("%+.0f CPU") );
-   DESC_ADD( temp->u.mod.thrust,       _("%+.0f Thrust") );
-   DESC_ADD( temp->u.mod.turn,         _("%+.0f Turn Rate") );
-   DESC_ADD( temp->u.mod.speed,        _("%+.0f Maximum Speed") );
-   DESC_ADD( temp->u.mod.armour,       _("%+.0f Armour") );
-   DESC_ADD( temp->u.mod.shield,       _("%+.0f Shield") );
-   DESC_ADD( temp->u.mod.energy,       _("%+.0f Energy") );
-   DESC_ADD( temp->u.mod.fuel,         _("%+.d Fuel") );
-   DESC_ADD( temp->u.mod.armour_regen, _("%+.1f Armour Per Second") );
-   DESC_ADD( temp->u.mod.shield_regen, _("%+.1f Shield Per Second") );
-   DESC_ADD( temp->u.mod.energy_regen, _("%+.1f Energy Per Second") );
-   DESC_ADD(-temp->u.mod.energy_loss,  _("%+.1f Energy Per Second") ); /* Bypasses RC stuff. The same as energy_regen but always negative. */
-   DESC_ADD( temp->u.mod.absorb,       _("%+.0f Absorption") );
-   DESC_ADD( temp->u.mod.cargo,        _("%+.0f Cargo") );
-#undef DESC_ADD
-
    /* More processing. */
    temp->u.mod.turn       *= M_PI / 180.;
    temp->u.mod.absorb     /= 100.;
@@ -1872,26 +1740,6 @@ static void outfit_parseSAfterburner( Outfit* temp, const xmlNodePtr parent )
       WARN(_("Outfit '%s' has unknown node '%s'"),temp->name, node->name);
    } while (xml_nextNode(node));
 
-   /* Set short description. */
-   temp->desc_short = malloc( OUTFIT_SHORTDESC_MAX );
-   snprintf( temp->desc_short, OUTFIT_SHORTDESC_MAX,
-         _("%s\n"
-         "#rActivated Outfit#0\n"
-         "%.0f CPU\n"
-         "Only one can be equipped\n"
-         "%.0f Maximum Effective Mass\n"
-         "%.0f%% Thrust\n"
-         "%.0f%% Maximum Speed\n"
-         "%.1f EPS\n"
-         "%.1f Rumble"),
-         _(outfit_getType(temp)),
-         temp->cpu,
-         temp->u.afb.mass_limit,
-         temp->u.afb.thrust + 100.,
-         temp->u.afb.speed + 100.,
-         temp->u.afb.energy,
-         temp->u.afb.rumble );
-
    /* Post processing. */
    temp->u.afb.thrust /= 100.;
    temp->u.afb.speed  /= 100.;
@@ -1949,18 +1797,6 @@ static void outfit_parseSFighterBay( Outfit *temp, const xmlNodePtr parent )
    if (temp->slot.size == OUTFIT_SLOT_SIZE_NA)
       outfit_setDefaultSize( temp );
 
-   /* Set short description. */
-   temp->desc_short = malloc( OUTFIT_SHORTDESC_MAX );
-   snprintf( temp->desc_short, OUTFIT_SHORTDESC_MAX,
-         _("%s\n"
-         "%.0f CPU\n"
-         "%.1f Seconds Per Launch\n"
-         "Holds %d %s"),
-         _(outfit_getType(temp)),
-         temp->cpu,
-         temp->u.bay.delay,
-         temp->u.bay.amount, _(temp->u.bay.ammo_name) );
-
 #define MELEMENT(o,s) \
 if (o) WARN(_("Outfit '%s' missing/invalid '%s' element"), temp->name, s) /**< Define to help check for data errors. */
    MELEMENT(temp->u.bay.delay==0,"delay");
@@ -1991,12 +1827,6 @@ static void outfit_parseSFighter( Outfit *temp, const xmlNodePtr parent )
       WARN(_("Outfit '%s' has unknown node '%s'"),temp->name, node->name);
    } while (xml_nextNode(node));
 
-   /* Set short description. */
-   temp->desc_short = malloc( OUTFIT_SHORTDESC_MAX );
-   snprintf( temp->desc_short, OUTFIT_SHORTDESC_MAX,
-         "%s",
-         _(outfit_getType(temp)) );
-
 #define MELEMENT(o,s) \
 if (o) WARN(_("Outfit '%s' missing/invalid '%s' element"), temp->name, s)
 /**< Define to help check for data errors. */
@@ -2069,8 +1899,8 @@ static void outfit_parseSMap( Outfit *temp, const xmlNodePtr parent )
          }
       }
       else if (xml_isNode(node,"short_desc")) {
-         temp->desc_short = malloc( OUTFIT_SHORTDESC_MAX );
-         snprintf( temp->desc_short, OUTFIT_SHORTDESC_MAX, "%s", xml_get(node) );
+         free( temp->desc_custom );
+         temp->desc_custom = xml_getStrd( node );
       }
       else if (xml_isNode(node,"all")) { /* Add everything to the map */
          system_stack = system_getAll();
@@ -2090,13 +1920,6 @@ static void outfit_parseSMap( Outfit *temp, const xmlNodePtr parent )
    array_shrink( &temp->u.map->assets  );
    array_shrink( &temp->u.map->jumps   );
 
-   if (temp->desc_short == NULL) {
-      /* Set short description based on type. */
-      temp->desc_short = malloc( OUTFIT_SHORTDESC_MAX );
-      snprintf( temp->desc_short, OUTFIT_SHORTDESC_MAX,
-            "%s", _(outfit_getType(temp)) );
-   }
-
 
 #define MELEMENT(o,s) \
 if (o) WARN(_("Outfit '%s' missing/invalid '%s' element"), temp->name, s)
@@ -2131,12 +1954,6 @@ static void outfit_parseSLocalMap( Outfit *temp, const xmlNodePtr parent )
    temp->u.lmap.asset_detect = pow2( temp->u.lmap.asset_detect );
    temp->u.lmap.jump_detect  = pow2( temp->u.lmap.jump_detect );
 
-   /* Set short description. */
-   temp->desc_short = malloc( OUTFIT_SHORTDESC_MAX );
-   snprintf( temp->desc_short, OUTFIT_SHORTDESC_MAX,
-         "%s",
-         _(outfit_getType(temp)) );
-
 #define MELEMENT(o,s) \
 if (o) WARN(_("Outfit '%s' missing/invalid '%s' element"), temp->name, s)
 /**< Define to help check for data errors. */
@@ -2167,11 +1984,6 @@ static void outfit_parseSGUI( Outfit *temp, const xmlNodePtr parent )
       WARN(_("Outfit '%s' has unknown node '%s'"),temp->name, node->name);
    } while (xml_nextNode(node));
 
-   /* Set short description. */
-   temp->desc_short = malloc( OUTFIT_SHORTDESC_MAX );
-   snprintf( temp->desc_short, OUTFIT_SHORTDESC_MAX,
-         _("GUI (Graphical User Interface)") );
-
 #define MELEMENT(o,s) \
 if (o) WARN(_("Outfit '%s' missing/invalid '%s' element"), temp->name, s)
 /**< Define to help check for data errors. */
@@ -2201,12 +2013,6 @@ static void outfit_parseSLicense( Outfit *temp, const xmlNodePtr parent )
       WARN(_("Outfit '%s' has unknown node '%s'"),temp->name, node->name);
    } while (xml_nextNode(node));
 
-   /* Set short description. */
-   temp->desc_short = malloc( OUTFIT_SHORTDESC_MAX );
-   snprintf( temp->desc_short, OUTFIT_SHORTDESC_MAX,
-         "%s",
-         _(outfit_getType(temp)) );
-
 #define MELEMENT(o,s) \
 if (o) WARN(_("Outfit '%s' missing/invalid '%s' element"), temp->name, s)
 /**< Define to help check for data errors. */
@@ -2220,18 +2026,17 @@ if (o) WARN(_("Outfit '%s' missing/invalid '%s' element"), temp->name, s)
  * @brief Parses and returns Outfit from parent node.
 
  *    @param temp Outfit to load into.
- *    @param file Path to the XML file (relative to base directory).
+ *    @param doc Parsed XML file of the outfit, gets freed.
  *    @return 0 on success.
  */
-static int outfit_parse( Outfit* temp, const char* file )
+static int outfit_parse( Outfit* temp, xmlDocPtr doc )
 {
    xmlNodePtr cur, ccur, node, parent;
    char *prop, *desc_extra;
    const char *cprop;
-   int group, l;
+   int group;
    ShipStatList *ll;
 
-   xmlDocPtr doc = xml_parsePhysFS( file );
    if (doc == NULL)
       return -1;
 
@@ -2396,18 +2201,9 @@ static int outfit_parse( Outfit* temp, const char* file )
          else if (outfit_isLicense(temp))
             outfit_parseSLicense( temp, node );
 
-         /* We add the ship stats to the description here. */
-         if (temp->desc_short) {
-            l = strlen(temp->desc_short);
-            ss_statsListDesc( temp->stats, &temp->desc_short[l], OUTFIT_SHORTDESC_MAX-l, 1 );
-            /* Add extra description task if available. */
-            if (desc_extra != NULL) {
-               l = strlen(temp->desc_short);
-               snprintf( &temp->desc_short[l], OUTFIT_SHORTDESC_MAX-l, "\n%s", desc_extra );
-               free( desc_extra );
-               desc_extra = NULL;
-            }
-         }
+         /* Extra description goes after the ship stats. */
+         temp->desc_extra = desc_extra;
+         desc_extra = NULL;
 
          continue;
       }
@@ -2442,13 +2238,24 @@ static int outfit_loadDir( char *dir )
 {
    int i, n, ret;
    char **outfit_files;
+   xmlDocPtr *docs;
 
    outfit_files = ndata_listRecursive( dir );
+
+   /* Parse all the files in parallel, skipping non xml. */
+   for ( i = 0; i < array_size( outfit_files ); i++ ) {
+      if (!ndata_matchExt( outfit_files[i], "xml" )) {
+         free( outfit_files[i] );
+         outfit_files[i] = NULL;
+      }
+   }
+   docs = xml_parsePhysFSList( outfit_files, array_size( outfit_files ) );
+
    for ( i = 0; i < array_size( outfit_files ); i++ ) {
-      if (!ndata_matchExt( outfit_files[i], "xml" ))
+      if (outfit_files[i] == NULL)
          continue;
 
-      ret = outfit_parse( &array_grow(&outfit_stack), outfit_files[i] );
+      ret = outfit_parse( &array_grow(&outfit_stack), docs[i] );
       if (ret < 0) {
          n = array_size(outfit_stack);
          array_erase( &outfit_stack, &outfit_stack[n-1], &outfit_stack[n] );
@@ -2456,6 +2263,7 @@ static int outfit_loadDir( char *dir )
       free( outfit_files[i] );
    }
    array_free( outfit_files );
+   free( docs );
 
    /* Reduce size. */
    array_shrink( &outfit_stack );
@@ -2479,6 +2287,11 @@ int outfit_load (void)
    array_shrink(&outfit_stack);
    noutfits = array_size(outfit_stack);
 
+   /* Index by name for lookups. */
+   strindex_clear( &outfit_index );
+   for (i=0; i<noutfits; i++)
+      strindex_add( &outfit_index, outfit_stack[i].name, i );
+
    /* Second pass, sets up ammunition relationships. */
    for (i=0; i<noutfits; i++) {
       o = &outfit_stack[i];
@@ -2493,8 +2306,6 @@ int outfit_load (void)
             if (!outfit_isTurret(o) && (o->u.lau.arc == 0.))
                WARN(_("Outfit '%s' missing/invalid 'arc' element"), o->name);
          }
-
-         outfit_launcherDesc(o);
       }
       else if (outfit_isFighterBay(&outfit_stack[i]))
          o->u.bay.ammo = outfit_get( o->u.bay.ammo_name );
@@ -2593,62 +2404,265 @@ int outfit_mapParse (void)
 
 
 /**
- * @brief Generates short descs for launchers, including ammo info.
+ * @brief Generates the short description of an outfit.
  *
- *    @param o Launcher.
+ *    @param o Outfit to generate the short description of.
+ *    @param buf Buffer to write to.
+ *    @param n Size of the buffer.
  */
-static void outfit_launcherDesc( Outfit* o )
+static void outfit_genDesc( const Outfit* o, char *buf, int n )
 {
    int l;
-   Outfit *a; /* Launcher's ammo. */
+   const Outfit *a; /* Launcher's ammo. */
+
+   l = 0;
+   buf[0] = '\0';
+   if (o->desc_custom != NULL)
+      l = scnprintf( buf, n, "%s", o->desc_custom );
+   else if (outfit_isBolt(o)) {
+      l = scnprintf( buf, n,
+            _("%s [%s]\n"
+            "%.0f CPU\n"
+            "%.0f%% Penetration\n"
+            "%.2f DPS [%.0f Damage]\n"),
+            _(outfit_getType(o)), _(dtype_damageTypeToStr(o->u.blt.dmg.type)),
+            o->cpu,
+            o->u.blt.dmg.penetration*100.,
+            1./o->u.blt.delay * o->u.blt.dmg.damage, o->u.blt.dmg.damage );
+      if (o->u.blt.dmg.disable > 0.) {
+         l += scnprintf( &buf[l], n-l,
+            _("%.2f Disable/s [%.0f Disable]\n"),
+            1./o->u.blt.delay * o->u.blt.dmg.disable, o->u.blt.dmg.disable );
+      }
+      l += scnprintf( &buf[l], n-l,
+            _("%.1f Shots Per Second\n"
+            "%.1f EPS [%.0f Energy]\n"
+            "%.0f Range\n"
+            "%.1f second heat up"),
+            1./o->u.blt.delay,
+            1./o->u.blt.delay * o->u.blt.energy, o->u.blt.energy,
+            o->u.blt.range,
+            o->u.blt.heatup);
+      if (!outfit_isTurret(o)) {
+         l += scnprintf( &buf[l], n-l,
+            _("\n%.1f degree swivel"),
+            o->u.blt.swivel*180./M_PI );
+      }
+   }
+   else if (outfit_isBeam(o)) {
+      l = scnprintf( buf, n,
+            _("%s\n"
+            "%.0f CPU\n"
+            "%.0f%% Penetration\n"
+            "%.2f DPS [%s]\n"),
+            _(outfit_getType(o)),
+            o->cpu,
+            o->u.bem.dmg.penetration*100.,
+            o->u.bem.dmg.damage, _(dtype_damageTypeToStr(o->u.bem.dmg.type) ) );
+      if (o->u.blt.dmg.disable > 0.) {
+         l += scnprintf( &buf[l], n-l,
+            _("%.0f Disable/s\n"),
+            o->u.bem.dmg.disable );
+      }
+      l += scnprintf( &buf[l], n-l,
+            _("%.1f EPS\n"
+            "%.1f Duration %.1f Cooldown\n"
+            "%.0f Range\n"
+            "%.1f second heat up"),
+            o->u.bem.energy,
+            o->u.bem.duration, o->u.bem.delay,
+            o->u.bem.range,
+            o->u.bem.heatup);
+   }
+   else if (outfit_isLauncher(o)) {
+      /* Launchers only describe themselves and their ammo. */
+      a = o->u.lau.ammo;
+      l = scnprintf( buf, n,
+            _("%s [%s]\n"
+            "%.0f CPU\n"),
+            _(outfit_getType(o)), _(dtype_damageTypeToStr(a->u.amm.dmg.type)),
+            o->cpu );
+
+      if (outfit_isSeeker(o))
+         l += scnprintf( &buf[l], n-l,
+               _("%.1f Second Lock-on\n"),
+               o->u.lau.lockon );
+      else
+         l += scnprintf( &buf[l], n-l,
+               _("No Tracking\n") );
+
+      l += scnprintf( &buf[l], n-l,
+            _("Holds %d %s:\n"
+            "%.0f%% Penetration\n"
+            "%.2f DPS [%.0f Damage]\n"),
+            o->u.lau.amount, _(o->u.lau.ammo_name),
+            a->u.amm.dmg.penetration * 100.,
+            1. / o->u.lau.delay * a->u.amm.dmg.damage, a->u.amm.dmg.damage );
+
+      if (a->u.amm.dmg.disable > 0.)
+         l += scnprintf( &buf[l], n-l,
+               _("%.1f Disable/s [%.0f Disable]\n"),
+               1. / o->u.lau.delay * a->u.amm.dmg.disable, a->u.amm.dmg.disable );
+
+      scnprintf( &buf[l], n-l,
+            _("%.1f Shots Per Second\n"
+            "%.1f EPS [%.0f Energy]\n"
+            "%.0f Range [%.1f duration]\n"
+            "%.0f Maximum Speed\n"
+            "%.1f%% Jam Resistance"),
+            1. / o->u.lau.delay,
+            o->u.lau.delay * a->u.amm.energy, a->u.amm.energy,
+            outfit_range(a), a->u.amm.duration,
+            a->u.amm.speed,
+            (a->u.amm.resist <= 0 ? 0. : (1. - 0.5 / a->u.amm.resist) * 100.) );
+      return;
+   }
+   else if (outfit_isAmmo(o))
+      l = 0;
+   else if (outfit_isMod(o)) {
+      l = scnprintf( buf, n,
+            "%s"
+            "%s",
+            _(outfit_getType(o)),
+            (o->u.mod.active) ? _("\n#rActivated Outfit#0") : "" );
+
+      /* Values are shown as they were before being converted when parsed. */
+#define DESC_ADD(x, s) \
+if ((x) != 0) \
+   do { \
+      l += scnprintf( &buf[l], n-l, "\n#%c", ((x)>0)?'g':'r' ); \
+      l += scnprintf( &buf[l], n-l, s, x ); \
+      l += scnprintf( &buf[l], n-l, "#0" ); \
+   } while(0)
+      DESC_ADD( o->cpu,                _("%+.0f CPU") );
+      DESC_ADD( o->u.mod.thrust,       _("%+.0f Thrust") );
+      DESC_ADD( o->u.mod.turn*180./M_PI, _("%+.0f Turn Rate") );
+      DESC_ADD( o->u.mod.speed,        _("%+.0f Maximum Speed") );
+      DESC_ADD( o->u.mod.armour,       _("%+.0f Armour") );
+      DESC_ADD( o->u.mod.shield,       _("%+.0f Shield") );
+      DESC_ADD( o->u.mod.energy,       _("%+.0f Energy") );
+      DESC_ADD( o->u.mod.fuel,         _("%+.d Fuel") );
+      DESC_ADD( o->u.mod.armour_regen, _("%+.1f Armour Per Second") );
+      DESC_ADD( o->u.mod.shield_regen, _("%+.1f Shield Per Second") );
+      DESC_ADD( o->u.mod.energy_regen, _("%+.1f Energy Per Second") );
+      DESC_ADD(-o->u.mod.energy_loss,  _("%+.1f Energy Per Second") ); /* Bypasses RC stuff. The same as energy_regen but always negative. */
+      DESC_ADD( o->u.mod.absorb*100.,  _("%+.0f Absorption") );
+      DESC_ADD( o->u.mod.cargo,        _("%+.0f Cargo") );
+#undef DESC_ADD
+   }
+   else if (outfit_isAfterburner(o))
+      l = scnprintf( buf, n,
+            _("%s\n"
+            "#rActivated Outfit#0\n"
+            "%.0f CPU\n"
+            "Only one can be equipped\n"
+            "%.0f Maximum Effective Mass\n"
+            "%.0f%% Thrust\n"
+            "%.0f%% Maximum Speed\n"
+            "%.1f EPS\n"
+            "%.1f Rumble"),
+            _(outfit_getType(o)),
+            o->cpu,
+            o->u.afb.mass_limit,
+            o->u.afb.thrust*100. + 100.,
+            o->u.afb.speed*100. + 100.,
+            o->u.afb.energy,
+            o->u.afb.rumble );
+   else if (outfit_isFighterBay(o))
+      l = scnprintf( buf, n,
+            _("%s\n"
+            "%.0f CPU\n"
+            "%.1f Seconds Per Launch\n"
+            "Holds %d %s"),
+            _(outfit_getType(o)),
+            o->cpu,
+            o->u.bay.delay,
+            o->u.bay.amount, _(o->u.bay.ammo_name) );
+   else if (outfit_isGUI(o))
+      l = scnprintf( buf, n,
+            _("GUI (Graphical User Interface)") );
+   else
+      l = scnprintf( buf, n,
+            "%s",
+            _(outfit_getType(o)) );
+
+   /* Ship stats and the extra description go at the end. */
+   l = strlen(buf);
+   ss_statsListDesc( o->stats, &buf[l], n-l, 1 );
+   if (o->desc_extra != NULL) {
+      l = strlen(buf);
+      snprintf( &buf[l], n-l, "\n%s", o->desc_extra );
+   }
+}
+
+
+/**
+ * @brief Gets the short description of an outfit.
+ *
+ * Short descriptions are generated when first needed. Only the
+ *  OUTFIT_DESC_CACHE most recently used ones are kept around, so the
+ *  description can be freed once that many others have been requested.
+ *
+ *    @param o Outfit to get the short description of.
+ *    @return The short description of the outfit or NULL if it has none.
+ */
+const char* outfit_descShort( const Outfit* o )
+{
+   int i, n;
+   Outfit *out;
+
+   if (o->type == OUTFIT_TYPE_NULL)
+      return NULL;
+
+   if (outfit_descCache == NULL)
+      outfit_descCache = array_create_size( Outfit*, OUTFIT_DESC_CACHE );
+   n = array_size(outfit_descCache);
 
+   /* Cached, mark as most recently used. */
    if (o->desc_short != NULL) {
-      WARN(_("Outfit '%s' already has a short description"), o->name);
-      return;
+      for (i=n-1; i>=0; i--)
+         if (outfit_descCache[i] == o)
+            break;
+      if ((i >= 0) && (i < n-1)) {
+         out = outfit_descCache[i];
+         memmove( &outfit_descCache[i], &outfit_descCache[i+1], sizeof(Outfit*) * (n-i-1) );
+         outfit_descCache[n-1] = out;
+      }
+      return o->desc_short;
    }
 
-   a = o->u.lau.ammo;
+   /* Make room by dropping the least recently used one. */
+   if (n >= OUTFIT_DESC_CACHE) {
+      free( outfit_descCache[0]->desc_short );
+      outfit_descCache[0]->desc_short = NULL;
+      array_erase( &outfit_descCache, &outfit_descCache[0], &outfit_descCache[1] );
+   }
 
-   o->desc_short = malloc( OUTFIT_SHORTDESC_MAX );
-   l = scnprintf( o->desc_short, OUTFIT_SHORTDESC_MAX,
-         _("%s [%s]\n"
-         "%.0f CPU\n"),
-         _(outfit_getType(o)), _(dtype_damageTypeToStr(a->u.amm.dmg.type)),
-         o->cpu );
+   /* The description is a cache, so it's fine to fill in on const outfits. */
+   out = (Outfit*) o;
+   out->desc_short = malloc( OUTFIT_SHORTDESC_MAX );
+   outfit_genDesc( out, out->desc_short, OUTFIT_SHORTDESC_MAX );
+   array_push_back( &outfit_descCache, out );
+   return out->desc_short;
+}
 
-   if (outfit_isSeeker(o))
-      l += scnprintf( &o->desc_short[l], OUTFIT_SHORTDESC_MAX - l,
-            _("%.1f Second Lock-on\n"),
-            o->u.lau.lockon );
-   else
-      l += scnprintf( &o->desc_short[l], OUTFIT_SHORTDESC_MAX - l,
-            _("No Tracking\n") );
-
-   l += scnprintf( &o->desc_short[l], OUTFIT_SHORTDESC_MAX - l,
-         _("Holds %d %s:\n"
-         "%.0f%% Penetration\n"
-         "%.2f DPS [%.0f Damage]\n"),
-         o->u.lau.amount, _(o->u.lau.ammo_name),
-         a->u.amm.dmg.penetration * 100.,
-         1. / o->u.lau.delay * a->u.amm.dmg.damage, a->u.amm.dmg.damage );
-
-   if (a->u.amm.dmg.disable > 0.)
-      l += scnprintf( &o->desc_short[l], OUTFIT_SHORTDESC_MAX - l,
-            _("%.1f Disable/s [%.0f Disable]\n"),
-            1. / o->u.lau.delay * a->u.amm.dmg.disable, a->u.amm.dmg.disable );
-
-   l += scnprintf( &o->desc_short[l], OUTFIT_SHORTDESC_MAX - l,
-         _("%.1f Shots Per Second\n"
-         "%.1f EPS [%.0f Energy]\n"
-         "%.0f Range [%.1f duration]\n"
-         "%.0f Maximum Speed\n"
-         "%.1f%% Jam Resistance"),
-         1. / o->u.lau.delay,
-         o->u.lau.delay * a->u.amm.energy, a->u.amm.energy,
-         outfit_range(a), a->u.amm.duration,
-         a->u.amm.speed,
-         (a->u.amm.resist <= 0 ? 0. : (1. - 0.5 / a->u.amm.resist) * 100.) );
-   (void)l;
+
+/**
+ * @brief Frees all the generated short descriptions.
+ *
+ * They are generated again when needed, so this is used when the language
+ *  changes.
+ */
+void outfit_descFlush (void)
+{
+   int i;
+
+   for (i=0; i<array_size(outfit_descCache); i++) {
+      free( outfit_descCache[i]->desc_short );
+      outfit_descCache[i]->desc_short = NULL;
+   }
+   array_free( outfit_descCache );
+   outfit_descCache = NULL;
 }
 
 
@@ -2725,7 +2739,8 @@ void outfit_free (void)
       free(o->typename);
       free(o->description);
       free(o->limit);
-      free(o->desc_short);
+      free(o->desc_custom);
+      free(o->desc_extra);
       free(o->license);
       free(o->name);
       gl_freeTexture(o->gfx_store);
@@ -2734,6 +2749,8 @@ void outfit_free (void)
       array_free(o->gfx_overlays);
    }
 
+   outfit_descFlush();
    array_free(outfit_stack);
+   strindex_free( &outfit_index );
 }
 
@@ -273,6 +273,8 @@ typedef struct OutfitModificationData_ {
    nlua_env lua_env; /**< Lua environment. Shared for each outfit to allow globals. */
    int lua_init;     /**< Run when player enters a system. */
    int lua_update;   /**< Run periodically. */
+   int lua_update_batch; /**< Run periodically once for all the pilots using the outfit. */
+   double lua_update_dt; /**< Interval of lua_update_batch in seconds, 0 for the default. */
    int lua_ontoggle; /**< Run when toggled. */
    int lua_onhit;    /**< Run when pilot takes damage. */
    int lua_outofenergy; /**< Run when the pilot runs out of energy. */
@@ -353,7 +355,9 @@ typedef struct Outfit_ {
    /* Store stuff */
    credits_t price;  /**< Base sell price. */
    char *description; /**< Store description. */
-   char *desc_short; /**< Short outfit description. */
+   char *desc_short; /**< Short outfit description, use outfit_descShort(). */
+   char *desc_custom; /**< Short description given by the data instead of a generated one. */
+   char *desc_extra; /**< Extra text appended to the generated short description. */
    int priority;     /**< Sort priority, highest first. */
 
    glTexture* gfx_store; /**< Store graphic. */
@@ -409,6 +413,8 @@ int outfit_isGUI( const Outfit* o );
 int outfit_isLicense( const Outfit* o );
 int outfit_isSecondary( const Outfit* o );
 const char* outfit_getType( const Outfit* o );
+const char* outfit_descShort( const Outfit* o );
+void outfit_descFlush (void);
 const char* outfit_getTypeBroad( const Outfit* o );
 const char* outfit_getAmmoAI( const Outfit *o );
 
@@ -81,6 +81,20 @@ typedef struct Solid_ {
 } Solid;
 
 
+/**
+ * @brief Solids using the Euler update moved together, see solid_batchUpdate().
+ */
+typedef struct SolidBatch_ {
+   Solid **solids; /**< Solids to move (array.h). */
+   double *px; /**< Packed X positions (array.h). */
+   double *py; /**< Packed Y positions (array.h). */
+   double *vx; /**< Packed X velocities (array.h). */
+   double *vy; /**< Packed Y velocities (array.h). */
+   double *ax; /**< Packed X accelerations (array.h). */
+   double *ay; /**< Packed Y accelerations (array.h). */
+} SolidBatch;
+
+
 /*
  * solid manipulation
  */
@@ -91,6 +105,13 @@ Solid* solid_create( const double mass, const double dir,
       const Vector2d* pos, const Vector2d* vel, int update );
 void solid_free( Solid* src );
 
+/*
+ * batches
+ */
+int solid_batchAdd( SolidBatch *batch, Solid *s );
+void solid_batchUpdate( SolidBatch *batch, const double dt );
+void solid_batchFree( SolidBatch *batch );
+
 
 #endif /* PHYSICS_H */
 
@@ -24,6 +24,7 @@
 #include "array.h"
 #include "board.h"
 #include "camera.h"
+#include "conf.h"
 #include "damagetype.h"
 #include "debris.h"
 #include "escort.h"
@@ -36,20 +37,27 @@
 #include "land_outfits.h"
 #include "land_shipyard.h"
 #include "log.h"
+#include "memtrack.h"
 #include "map.h"
-#include "music.h"
 #include "ndata.h"
+#include "nlua_pilot.h"
 #include "nstring.h"
 #include "ntime.h"
 #include "nxml.h"
 #include "pause.h"
 #include "player.h"
 #include "player_autonav.h"
+#include "profile.h"
 #include "rng.h"
+#include "spatial.h"
+#include "threadpool.h"
 #include "weapon.h"
 
 
 #define PILOT_SIZE_MIN 128 /**< Minimum chunks to increment pilot_stack by */
+#define PILOT_GRID_CELLSIZE 512. /**< Cell size of the collision grid, about a large ship. */
+#define PILOT_SENSE_CHUNK    16 /**< Pilots handled by each job of the sensing pass. */
+#define PILOT_QUERY_STEPS     5 /**< Times a nearest query grows before checking everything. */
 
 /* ID Generators. */
 static unsigned int pilot_id = PLAYER_ID; /**< Stack of pilot ids to assure uniqueness */
@@ -58,6 +66,65 @@ static unsigned int pilot_id = PLAYER_ID; /**< Stack of pilot ids to assure uniq
 /* stack of pilots */
 static Pilot** pilot_stack = NULL; /**< All the pilots in space. (Player may have other Pilot objects, e.g. backup ships.) */
 
+/* recycled pilots */
+#define PILOT_POOL_MAX  128 /**< Maximum number of freed pilots kept for reuse. */
+static Pilot** pilot_pool = NULL; /**< Freed pilots, which keep their solid and slot arrays for reuse (array.h). */
+
+/* drawing ahead of the simulation */
+static Vector2d* pilot_aheadPos = NULL; /**< Simulated and drawn position of each pilot while drawing ahead (array.h). */
+static Pilot** pilot_drawList = NULL; /**< Pilots on screen in drawing order (array.h). */
+
+/* id look up */
+#define PILOT_TABLE_MIN 256 /**< Minimum size of the id look up table, must be a power of two. */
+static Pilot** pilot_table = NULL; /**< Pilots of the stack indexed by the low bits of their id. */
+static int pilot_tableSize = 0; /**< Size of pilot_table, a power of two. */
+
+/* reduced rate updates */
+#define PILOT_COARSE_DT (1./20.) /**< Minimum time between updates of far away pilots. */
+
+/* collision broadphase */
+static SpatialGrid pilot_grid; /**< Grid of the pilot_stack positions for collision queries. */
+static int pilot_gridDirty = 1; /**< The pilot_stack changed since pilot_grid was built. */
+static double pilot_gridMaxSize = 0.; /**< Width of the biggest sprite in pilot_grid. */
+static int *pilot_explodeIds = NULL; /**< Candidates of pilot_explode() (array.h). */
+static int *pilot_distressIds = NULL; /**< Candidates of pilot_distress() (array.h). */
+static unsigned int *pilot_distressRecv = NULL; /**< Receivers of pilot_distress() (array.h). */
+static int *pilot_gridVisible = NULL; /**< Stack positions of the pilots visible from anywhere (array.h). */
+static double pilot_gridMinHide = 0.; /**< Lowest ew_hide of the pilots in pilot_grid. */
+
+/* distress signals */
+#define PILOT_DISTRESS_COOLDOWN 1. /**< Time during which repeated distress signals about the same attacker are dropped. */
+
+/**
+ * @brief Range of the pilot stack handled by a job of the sensing pass.
+ */
+typedef struct PilotSenseJob_ {
+   int start; /**< First stack position. */
+   int end; /**< One past the last stack position. */
+} PilotSenseJob;
+static PilotSenseJob *pilot_senseJobs = NULL; /**< Jobs of the sensing pass (array.h). */
+
+/**
+ * @brief Cached results of the nearest queries of a pilot.
+ *
+ * Entries are only valid if their generation matches pilot_queryGen.
+ */
+typedef struct PilotQueryCache_ {
+   unsigned int gen_enemy; /**< Generation the nearest enemy was found in. */
+   unsigned int enemy;     /**< Nearest enemy, 0 if none. */
+   unsigned int gen_pilot; /**< Generation the nearest pilot was found in. */
+   unsigned int pilot;     /**< Nearest pilot. */
+} PilotQueryCache;
+static PilotQueryCache *pilot_queryCache = NULL; /**< Cache for each stack position (array.h). */
+static unsigned int pilot_queryGen = 1; /**< Current cache generation, 0 is never valid. */
+static unsigned int pilot_queryRelations = 0; /**< Faction relations the cache is valid for. */
+static int *pilot_queryIds = NULL; /**< Candidates of the nearest queries (array.h). */
+
+/**
+ * @brief Filter used by the nearest queries.
+ */
+typedef int (*PilotQueryFilter)( const Pilot *p, const Pilot *target, const void *data );
+
 
 /* misc */
 static const double pilot_commTimeout  = 15.; /**< Time for text above pilot to time out. */
@@ -69,6 +136,10 @@ static const double pilot_commFade     = 5.; /**< Time for text above pilot to f
  * Prototypes
  */
 /* Create. */
+static Pilot* pilot_alloc (void);
+static double pilot_aimAngleCompute( const Pilot *p, const Pilot *target, double dist, double speed );
+static void pilot_release( Pilot *p );
+static void pilot_poolFree (void);
 static void pilot_init( Pilot* dest, Ship* ship, const char* name, int faction, const char *ai,
       const double dir, const Vector2d* pos, const Vector2d* vel,
       const PilotFlags flags, unsigned int dockpilot, int dockslot );
@@ -79,11 +150,30 @@ static void pilot_refuel( Pilot *p, double dt );
 static void pilot_dead( Pilot* p, unsigned int killer );
 /* Targeting. */
 static int pilot_validEnemy( const Pilot* p, const Pilot* target );
+static int pilot_filterEnemy( const Pilot *p, const Pilot *target, const void *data );
+static int pilot_filterEnemySize( const Pilot *p, const Pilot *target, const void *data );
+static int pilot_filterNearest( const Pilot *p, const Pilot *target, const void *data );
+/* Nearest queries. */
+static void pilot_queryInvalidate (void);
+static PilotQueryCache* pilot_queryGetCache( const Pilot *p );
+static int pilot_queryNearest( const Pilot *p, double x, double y,
+      PilotQueryFilter filter, const void *data,
+      unsigned int *ids, double *dist2, int k );
 /* Misc. */
 static void pilot_setCommMsg( Pilot *p, const char *s );
 static int pilot_getStackPos( const unsigned int id );
+static void pilot_tableAdd( Pilot *p );
+static void pilot_tableRemove( const Pilot *p );
+static void pilot_tableRebuild (void);
 static void pilot_init_trails( Pilot* p );
 static int pilot_trail_generated( Pilot* p, int generator );
+static void pilots_buildGrid (void);
+static int pilot_senseJob( void *data );
+static void pilots_sense (void);
+static int pilot_updateCoarse( const Pilot *p );
+static int pilot_cmpDraw( const void *ptr1, const void *ptr2 );
+static int pilot_cmpStackPos( const void *ptr1, const void *ptr2 );
+static void pilot_signalQuery( const Pilot *p, int **ids );
 
 
 /**
@@ -95,6 +185,210 @@ Pilot*const* pilot_getAll (void)
 }
 
 
+/**
+ * @brief Gets the pilots that may be colliding with a box.
+ *
+ * Uses the collision grid built at the end of pilots_update(), so it may be
+ * off by the movement done since then.
+ *
+ *    @param[out] ids Array (array.h) of positions in the stack returned by
+ *                pilot_getAll() of possibly colliding pilots. It is created
+ *                if NULL.
+ *    @param x1 Left bound of the box.
+ *    @param y1 Bottom bound of the box.
+ *    @param x2 Right bound of the box.
+ *    @param y2 Top bound of the box.
+ */
+void pilot_collideQuery( int **ids, double x1, double y1, double x2, double y2 )
+{
+   /* Stack positions are no longer valid. */
+   if (pilot_gridDirty)
+      pilots_buildGrid();
+
+   spatial_query( &pilot_grid, ids, x1, y1, x2, y2 );
+}
+
+
+/**
+ * @brief Gets the pilots that may be colliding with a segment.
+ *
+ * Like pilot_collideQuery() but only looks at the grid cells along the
+ * segment, which is much tighter for long diagonal segments like beams.
+ *
+ *    @param[out] ids Array (array.h) of positions in the stack returned by
+ *                pilot_getAll() of possibly colliding pilots. It is created
+ *                if NULL.
+ *    @param x1 X position of the start of the segment.
+ *    @param y1 Y position of the start of the segment.
+ *    @param x2 X position of the end of the segment.
+ *    @param y2 Y position of the end of the segment.
+ */
+void pilot_collideQuerySegment( int **ids, double x1, double y1, double x2, double y2 )
+{
+   /* Stack positions are no longer valid. */
+   if (pilot_gridDirty)
+      pilots_buildGrid();
+
+   spatial_querySegment( &pilot_grid, ids, x1, y1, x2, y2, 1. );
+}
+
+
+/**
+ * @brief Rebuilds the pilot collision grid from the current pilot_stack.
+ */
+static void pilots_buildGrid (void)
+{
+   int i;
+   double hw, hh;
+   Pilot *p;
+
+   spatial_clear( &pilot_grid );
+   pilot_gridMaxSize = 0.;
+   pilot_gridMinHide = HUGE_VAL;
+   if (pilot_gridVisible == NULL)
+      pilot_gridVisible = array_create( int );
+   array_resize( &pilot_gridVisible, 0 );
+   for (i=0; i<array_size(pilot_stack); i++) {
+      p = pilot_stack[i];
+      if (pilot_isFlag(p, PILOT_DELETE))
+         continue;
+      pilot_gridMaxSize = MAX( pilot_gridMaxSize, p->ship->gfx_space->sw );
+
+      /* How far pilots can be seen from, for the sensor range queries. */
+      pilot_gridMinHide = MIN( pilot_gridMinHide, p->ew_hide );
+      if (pilot_isFlag(p, PILOT_VISIBLE))
+         array_push_back( &pilot_gridVisible, i );
+
+      /* Sprite collisions are done with the bounding box of the sprite, pad for rounding. */
+      hw = p->ship->gfx_space->sw / 2. + 1.;
+      hh = p->ship->gfx_space->sh / 2. + 1.;
+      spatial_insertBox( &pilot_grid, i,
+            p->solid->pos.x - hw, p->solid->pos.y - hh,
+            p->solid->pos.x + hw, p->solid->pos.y + hh );
+   }
+   spatial_build( &pilot_grid );
+   pilot_gridDirty = 0;
+
+   /* Positions or stack changed. */
+   pilot_queryInvalidate();
+}
+
+
+/**
+ * @brief Invalidates all the cached nearest queries.
+ */
+static void pilot_queryInvalidate (void)
+{
+   pilot_queryGen++;
+   if (pilot_queryGen == 0)
+      pilot_queryGen = 1;
+}
+
+
+/**
+ * @brief Gets the nearest query cache of a pilot.
+ *
+ *    @param p Pilot to get cache of.
+ *    @return The cache of the pilot or NULL if not in the stack.
+ */
+static PilotQueryCache* pilot_queryGetCache( const Pilot *p )
+{
+   int i, n;
+
+   /* Make sure stack positions are up to date. */
+   if (pilot_gridDirty)
+      pilots_buildGrid();
+
+   /* Hostility may have changed. */
+   if (faction_relationsVersion() != pilot_queryRelations) {
+      pilot_queryRelations = faction_relationsVersion();
+      pilot_queryInvalidate();
+   }
+
+   i = pilot_getStackPos( p->id );
+   if (i < 0)
+      return NULL;
+
+   n = array_size(pilot_queryCache);
+   if (n < array_size(pilot_stack)) {
+      array_resize( &pilot_queryCache, array_size(pilot_stack) );
+      memset( &pilot_queryCache[n], 0, (array_size(pilot_stack)-n) * sizeof(PilotQueryCache) );
+   }
+   return &pilot_queryCache[i];
+}
+
+
+/**
+ * @brief Finds the nearest pilots to a position that pass a filter.
+ *
+ * Looks in growing boxes on the collision grid, so it only checks the pilots
+ * that are nearby unless there are none that pass the filter.
+ *
+ *    @param p Pilot doing the query, passed to the filter.
+ *    @param x X position to find nearest pilots to.
+ *    @param y Y position to find nearest pilots to.
+ *    @param filter Filter pilots have to pass.
+ *    @param data Data to pass to the filter.
+ *    @param[out] ids IDs of the nearest pilots, nearest first.
+ *    @param[out] dist2 Squared distances of the nearest pilots.
+ *    @param k Maximum number of pilots to find.
+ *    @return Number of pilots found.
+ */
+static int pilot_queryNearest( const Pilot *p, double x, double y,
+      PilotQueryFilter filter, const void *data,
+      unsigned int *ids, double *dist2, int k )
+{
+   int i, j, n, step;
+   double r, td;
+   const Pilot *t;
+
+   n = 0;
+   r = PILOT_GRID_CELLSIZE;
+   for (step=0; step<PILOT_QUERY_STEPS; step++) {
+      /* Last step just checks everything. */
+      if (step == PILOT_QUERY_STEPS-1) {
+         array_resize( &pilot_queryIds, array_size(pilot_stack) );
+         for (i=0; i<array_size(pilot_stack); i++)
+            pilot_queryIds[i] = i;
+      }
+      else
+         pilot_collideQuery( &pilot_queryIds, x-r, y-r, x+r, y+r );
+
+      n = 0;
+      for (i=0; i<array_size(pilot_queryIds); i++) {
+         t = pilot_stack[ pilot_queryIds[i] ];
+         if (!filter( p, t, data ))
+            continue;
+
+         td = pow2(x-t->solid->pos.x) + pow2(y-t->solid->pos.y);
+         if ((n == k) && (td >= dist2[n-1]))
+            continue;
+
+         /* Insert sorted. */
+         for (j=MIN(n,k-1); (j>0) && (dist2[j-1] > td); j--) {
+            dist2[j] = dist2[j-1];
+            ids[j]   = ids[j-1];
+         }
+         dist2[j] = td;
+         ids[j]   = t->id;
+         if (n < k)
+            n++;
+      }
+
+      /* Pilots outside of the box are farther than r. */
+      if ((n == k) && (dist2[n-1] <= r*r))
+         break;
+
+      /* Box already covered everything. */
+      if (array_size(pilot_queryIds) >= array_size(pilot_grid.objects))
+         break;
+
+      r *= 8.;
+   }
+   return n;
+}
+
+
 /**
  * @brief Compare id (for use with bsearch)
  */
@@ -120,6 +414,81 @@ static int pilot_getStackPos( const unsigned int id )
 }
 
 
+/**
+ * @brief Adds a pilot of the stack to the id look up table.
+ *
+ * Ids are handed out sequentially, so the low bits of the ids of the pilots
+ *  in the stack rarely collide. Pilots that do collide are simply left out
+ *  and found by pilot_getStackPos() instead.
+ *
+ *    @param p Pilot to add.
+ */
+static void pilot_tableAdd( Pilot *p )
+{
+   Pilot **slot;
+
+   /* The player is special cased. */
+   if (p->id == PLAYER_ID)
+      return;
+
+   /* Keep the table at most half full. */
+   if (2*array_size(pilot_stack) > pilot_tableSize) {
+      pilot_tableRebuild();
+      return;
+   }
+
+   slot = &pilot_table[ p->id & (pilot_tableSize-1) ];
+   if (*slot == NULL)
+      *slot = p;
+}
+
+
+/**
+ * @brief Removes a pilot from the id look up table.
+ *
+ *    @param p Pilot to remove.
+ */
+static void pilot_tableRemove( const Pilot *p )
+{
+   Pilot **slot;
+
+   if (pilot_table == NULL)
+      return;
+
+   slot = &pilot_table[ p->id & (pilot_tableSize-1) ];
+   if (*slot == p)
+      *slot = NULL;
+}
+
+
+/**
+ * @brief Rebuilds the id look up table from the stack, growing it if needed.
+ */
+static void pilot_tableRebuild (void)
+{
+   int i, n;
+   Pilot **slot;
+
+   n = MAX( PILOT_TABLE_MIN, pilot_tableSize );
+   while (n < 2*array_size(pilot_stack))
+      n *= 2;
+   if (n != pilot_tableSize) {
+      free( pilot_table );
+      pilot_table = malloc( n * sizeof(Pilot*) );
+      pilot_tableSize = n;
+   }
+   memset( pilot_table, 0, pilot_tableSize * sizeof(Pilot*) );
+
+   for (i=0; i<array_size(pilot_stack); i++) {
+      if (pilot_stack[i]->id == PLAYER_ID)
+         continue;
+      slot = &pilot_table[ pilot_stack[i]->id & (pilot_tableSize-1) ];
+      if (*slot == NULL)
+         *slot = pilot_stack[i];
+   }
+}
+
+
 /**
  * @brief Gets the next pilot based on id.
  *
@@ -286,6 +655,55 @@ static int pilot_validEnemy( const Pilot* p, const Pilot* target )
 }
 
 
+/**
+ * @brief Nearest query filter for enemies.
+ */
+static int pilot_filterEnemy( const Pilot *p, const Pilot *target, const void *data )
+{
+   (void) data;
+   return pilot_validEnemy( p, target );
+}
+
+
+/**
+ * @brief Nearest query filter for enemies with a mass in the range given by data.
+ */
+static int pilot_filterEnemySize( const Pilot *p, const Pilot *target, const void *data )
+{
+   const double *bounds = data;
+
+   if ((target->solid->mass < bounds[0]) || (target->solid->mass > bounds[1]))
+      return 0;
+
+   return pilot_validEnemy( p, target );
+}
+
+
+/**
+ * @brief Nearest query filter for pilot_getNearestPos(), data is whether to allow disabled.
+ */
+static int pilot_filterNearest( const Pilot *p, const Pilot *target, const void *data )
+{
+   int disabled = *(const int*)data;
+
+   /* Must not be self. */
+   if (target == p)
+      return 0;
+
+   /* Player doesn't select escorts (unless disabled is active). */
+   if (!disabled && (p->faction == FACTION_PLAYER) &&
+         (target->faction == FACTION_PLAYER))
+      return 0;
+
+   /* Shouldn't be disabled. */
+   if (!disabled && pilot_isDisabled(target))
+      return 0;
+
+   /* Must be a valid target. */
+   return pilot_validTarget( p, target );
+}
+
+
 /**
  * @brief Gets the nearest enemy to the pilot.
  *
@@ -295,26 +713,57 @@ static int pilot_validEnemy( const Pilot* p, const Pilot* target )
 unsigned int pilot_getNearestEnemy( const Pilot* p )
 {
    unsigned int tp;
-   int i;
-   double d, td;
+   double d;
+   Pilot *target;
+   PilotQueryCache *c;
+
+   /* Use the sensing pass if the enemy is still valid. */
+   if (p->sense.valid) {
+      if (p->sense.enemy == 0)
+         return 0;
+      target = pilot_get( p->sense.enemy );
+      if ((target != NULL) && pilot_validEnemy( p, target ))
+         return p->sense.enemy;
+   }
 
-   tp = 0;
-   d  = 0.;
-   for (i=0; i<array_size(pilot_stack); i++) {
+   /* See if it was already found this frame. */
+   c = pilot_queryGetCache( p );
+   if ((c != NULL) && (c->gen_enemy == pilot_queryGen)) {
+      if (c->enemy == 0)
+         return 0;
+      target = pilot_get( c->enemy );
+      if ((target != NULL) && pilot_validEnemy( p, target ))
+         return c->enemy;
+   }
 
-      if (!pilot_validEnemy( p, pilot_stack[i] ))
-         continue;
+   if (pilot_getNearestEnemies( p, &tp, &d, 1 ) == 0)
+      tp = 0;
 
-      /* Check distance. */
-      td = vect_dist2(&pilot_stack[i]->solid->pos, &p->solid->pos);
-      if (!tp || (td < d)) {
-         d  = td;
-         tp = pilot_stack[i]->id;
-      }
+   if (c != NULL) {
+      c->gen_enemy = pilot_queryGen;
+      c->enemy     = tp;
    }
    return tp;
 }
 
+
+/**
+ * @brief Gets the k nearest enemies to the pilot.
+ *
+ *    @param p Pilot to get the nearest enemies of.
+ *    @param[out] ids IDs of the nearest enemies, nearest first.
+ *    @param[out] dist2 Squared distances to the nearest enemies.
+ *    @param k Maximum number of enemies to get.
+ *    @return Number of enemies found.
+ */
+int pilot_getNearestEnemies( const Pilot* p, unsigned int *ids, double *dist2, int k )
+{
+   if (k <= 0)
+      return 0;
+   return pilot_queryNearest( p, p->solid->pos.x, p->solid->pos.y,
+         pilot_filterEnemy, NULL, ids, dist2, k );
+}
+
 /**
  * @brief Gets the nearest enemy to the pilot closest to the pilot whose mass is between LB and UB.
  *
@@ -326,26 +775,13 @@ unsigned int pilot_getNearestEnemy( const Pilot* p )
 unsigned int pilot_getNearestEnemy_size( const Pilot* p, double target_mass_LB, double target_mass_UB )
 {
    unsigned int tp;
-   int i;
-   double d, td;
-
-   tp = 0;
-   d  = 0.;
-   for (i=0; i<array_size(pilot_stack); i++) {
-
-      if (!pilot_validEnemy( p, pilot_stack[i] ))
-         continue;
-
-      if (pilot_stack[i]->solid->mass < target_mass_LB || pilot_stack[i]->solid->mass > target_mass_UB)
-         continue;
+   double d, bounds[2];
 
-      /* Check distance. */
-      td = vect_dist2(&pilot_stack[i]->solid->pos, &p->solid->pos);
-      if (!tp || (td < d)) {
-         d = td;
-         tp = pilot_stack[i]->id;
-      }
-   }
+   bounds[0] = target_mass_LB;
+   bounds[1] = target_mass_UB;
+   if (pilot_queryNearest( p, p->solid->pos.x, p->solid->pos.y,
+            pilot_filterEnemySize, bounds, &tp, &d, 1 ) == 0)
+      return 0;
 
    return tp;
 }
@@ -403,7 +839,19 @@ unsigned int pilot_getNearestEnemy_heuristic( const Pilot* p,
 unsigned int pilot_getNearestPilot( const Pilot* p )
 {
    unsigned int t;
+   PilotQueryCache *c;
+
+   /* See if it was already found this frame. */
+   c = pilot_queryGetCache( p );
+   if ((c != NULL) && (c->gen_pilot == pilot_queryGen))
+      return c->pilot;
+
    pilot_getNearestPos( p, &t, p->solid->pos.x, p->solid->pos.y, 0 );
+
+   if (c != NULL) {
+      c->gen_pilot = pilot_queryGen;
+      c->pilot     = t;
+   }
    return t;
 }
 
@@ -488,36 +936,11 @@ unsigned int pilot_getBoss( const Pilot* p )
  */
 double pilot_getNearestPos( const Pilot *p, unsigned int *tp, double x, double y, int disabled )
 {
-   int i;
-   double d, td;
-
-   *tp = PLAYER_ID;
-   d  = 0;
-   for (i=0; i<array_size(pilot_stack); i++) {
-
-      /* Must not be self. */
-      if (pilot_stack[i] == p)
-         continue;
-
-      /* Player doesn't select escorts (unless disabled is active). */
-      if (!disabled && (p->faction == FACTION_PLAYER) &&
-            (pilot_stack[i]->faction == FACTION_PLAYER))
-         continue;
-
-      /* Shouldn't be disabled. */
-      if (!disabled && pilot_isDisabled(pilot_stack[i]))
-         continue;
-
-      /* Must be a valid target. */
-      if (!pilot_validTarget( p, pilot_stack[i] ))
-         continue;
+   double d;
 
-      /* Minimum distance. */
-      td = pow2(x-pilot_stack[i]->solid->pos.x) + pow2(y-pilot_stack[i]->solid->pos.y);
-      if (((*tp==PLAYER_ID) || (td < d))) {
-         d = td;
-         *tp = pilot_stack[i]->id;
-      }
+   if (pilot_queryNearest( p, x, y, pilot_filterNearest, &disabled, tp, &d, 1 ) == 0) {
+      *tp = PLAYER_ID;
+      return 0.;
    }
    return d;
 }
@@ -591,10 +1014,18 @@ double pilot_getNearestAng( const Pilot *p, unsigned int *tp, double ang, int di
 Pilot* pilot_get( const unsigned int id )
 {
    int m;
+   Pilot *p;
 
    if (id==PLAYER_ID)
       return player.p; /* special case player.p */
 
+   /* Direct look up first, the stack is only searched on collisions. */
+   if (pilot_table != NULL) {
+      p = pilot_table[ id & (pilot_tableSize-1) ];
+      if ((p != NULL) && (p->id == id))
+         return pilot_isFlag(p, PILOT_DELETE) ? NULL : p;
+   }
+
    m = pilot_getStackPos(id);
 
    if ((m==-1) || (pilot_isFlag(pilot_stack[m], PILOT_DELETE)))
@@ -807,6 +1238,30 @@ double pilot_brakeDist( Pilot *p, Vector2d *pos )
 }
 
 
+/**
+ * @brief Gets the minimum braking distance of a pilot at its current speed.
+ *
+ * Cheaper and more conservative than pilot_brakeDist(), used by the AI.
+ *
+ *    @param p Pilot to get the braking distance of.
+ *    @return Minimum braking distance.
+ */
+double pilot_minBrakeDist( const Pilot *p )
+{
+   double time, vel;
+
+   /* Get current time to reach target. */
+   time = VMOD(p->solid->vel) / (p->thrust / p->solid->mass);
+
+   /* Get velocity. */
+   vel = MIN(p->speed,VMOD(p->solid->vel));
+
+   /* Get distance to brake. */
+   return vel*(time+1.1*M_PI/p->turn) -
+         0.5*(p->thrust/p->solid->mass)*time*time;
+}
+
+
 /**
  * @brief Attempts to make the pilot pass through a given point.
  *
@@ -963,6 +1418,49 @@ void pilot_cooldownEnd( Pilot *p, const char *reason )
 }
 
 
+/**
+ * @brief Gets the geometry between a pilot and its target.
+ *
+ * Lockons, aiming for the AI and the player's aiming lines all look at the
+ *  same target during a frame, so the results are kept until the pilot or
+ *  its target move.
+ *
+ *    @param p Pilot that aims.
+ *    @param target Pilot that is being aimed at.
+ *    @return The geometry to the target, the aim angle is computed on demand by
+ *            pilot_aimAngle().
+ */
+PilotTargeting* pilot_getTargeting( Pilot *p, const Pilot *target )
+{
+   PilotTargeting *pt;
+   double x, y;
+
+   pt = &p->targeting;
+   if ((pt->target == target->id) &&
+         (pt->pos.x == p->solid->pos.x) && (pt->pos.y == p->solid->pos.y) &&
+         (pt->vel.x == p->solid->vel.x) && (pt->vel.y == p->solid->vel.y) &&
+         (pt->dir == p->solid->dir) &&
+         (pt->tpos.x == target->solid->pos.x) && (pt->tpos.y == target->solid->pos.y) &&
+         (pt->tvel.x == target->solid->vel.x) && (pt->tvel.y == target->solid->vel.y))
+      return pt;
+
+   pt->target = target->id;
+   pt->pos    = p->solid->pos;
+   pt->vel    = p->solid->vel;
+   pt->dir    = p->solid->dir;
+   pt->tpos   = target->solid->pos;
+   pt->tvel   = target->solid->vel;
+
+   x = target->solid->pos.x - p->solid->pos.x;
+   y = target->solid->pos.y - p->solid->pos.y;
+   pt->dist   = MOD( x, y );
+   pt->angle  = ANGLE( x, y );
+   pt->off    = FABS( angle_diff( pt->angle, p->solid->dir ) );
+   pt->aim_valid = 0;
+   return pt;
+}
+
+
 /**
  * @brief Returns the angle for a pilot to aim at an other pilot
  *
@@ -971,20 +1469,39 @@ void pilot_cooldownEnd( Pilot *p, const char *reason )
  */
 double pilot_aimAngle( Pilot *p, Pilot *target )
 {
-   double x,y;
-   double t;
-   Vector2d tv, approach_vector, relative_location, orthoradial_vector;
-   double dist;
+   PilotTargeting *pt;
    double speed;
-   double radial_speed;
-   double orthoradial_speed;
-
-   /* Get the distance */
-   dist = vect_dist( &p->solid->pos, &target->solid->pos );
 
    /* Check if should recalculate weapon speed with secondary weapon. */
    speed = pilot_weapSetSpeed( p, p->active_set, -1 );
 
+   pt = pilot_getTargeting( p, target );
+   if (!pt->aim_valid || (pt->aim_speed != speed)) {
+      pt->aim       = pilot_aimAngleCompute( p, target, pt->dist, speed );
+      pt->aim_speed = speed;
+      pt->aim_valid = 1;
+   }
+   return pt->aim;
+}
+
+
+/**
+ * @brief Computes the angle for a pilot to aim at an other pilot.
+ *
+ *    @param p Pilot that aims.
+ *    @param target Pilot that is being aimed at.
+ *    @param dist Distance to the target.
+ *    @param speed Speed of the weapons.
+ */
+static double pilot_aimAngleCompute( const Pilot *p, const Pilot *target, double dist, double speed )
+{
+   double x,y;
+   double t;
+   Vector2d approach_vector, relative_location, orthoradial_vector;
+   double radial_speed;
+   double orthoradial_speed;
+   double a2;
+
    /* determine the radial, or approach speed */
    /*
     *approach_vector (denote Va) is the relative velocites of the pilot and target
@@ -995,29 +1512,30 @@ double pilot_aimAngle( Pilot *p, Pilot *target )
     *
     *Va dot Vr + ShotSpeed is the net closing velocity for the shot, and is used to compute the time of flight for the shot.
     */
-   vect_cset(&approach_vector, VX(p->solid->vel) - VX(target->solid->vel), VY(p->solid->vel) - VY(target->solid->vel) );
-   vect_cset(&relative_location, VX(target->solid->pos) -  VX(p->solid->pos),  VY(target->solid->pos) - VY(p->solid->pos) );
-   vect_cset(&orthoradial_vector, VY(p->solid->pos) - VY(target->solid->pos), VX(target->solid->pos) -  VX(p->solid->pos) );
+   vect_csetmin(&approach_vector, VX(p->solid->vel) - VX(target->solid->vel), VY(p->solid->vel) - VY(target->solid->vel) );
+   vect_csetmin(&relative_location, VX(target->solid->pos) -  VX(p->solid->pos),  VY(target->solid->pos) - VY(p->solid->pos) );
+   vect_csetmin(&orthoradial_vector, VY(p->solid->pos) - VY(target->solid->pos), VX(target->solid->pos) -  VX(p->solid->pos) );
 
    radial_speed = vect_dot(&approach_vector, &relative_location);
-   radial_speed = radial_speed / VMOD(relative_location);
+   radial_speed = radial_speed / dist;
 
    orthoradial_speed = vect_dot(&approach_vector, &orthoradial_vector);
-   orthoradial_speed = orthoradial_speed / VMOD(relative_location);
+   orthoradial_speed = orthoradial_speed / dist;
+   a2 = vect_dot(&approach_vector, &approach_vector);
 
    /* Time for shots to reach that distance */
    /* t is the real positive solution of a 2nd order equation*/
    /* if the target is not hittable (i.e., fleeing faster than our shots can fly, determinant <= 0), just face the target */
-   if ( ((speed*speed - VMOD(approach_vector)*VMOD(approach_vector)) != 0) && (speed*speed - orthoradial_speed*orthoradial_speed) > 0)
+   if ( ((speed*speed - a2) != 0) && (speed*speed - orthoradial_speed*orthoradial_speed) > 0)
       t = dist * (sqrt( speed*speed - orthoradial_speed*orthoradial_speed ) - radial_speed) /
-            (speed*speed - VMOD(approach_vector)*VMOD(approach_vector));
+            (speed*speed - a2);
    else
       t = 0;
 
    /* if t < 0, try the other solution*/
    if (t < 0)
       t = - dist * (sqrt( speed*speed - orthoradial_speed*orthoradial_speed ) + radial_speed) /
-            (speed*speed - VMOD(approach_vector)*VMOD(approach_vector));
+            (speed*speed - a2);
 
    /* if t still < 0, no solution*/
    if (t < 0)
@@ -1028,9 +1546,7 @@ double pilot_aimAngle( Pilot *p, Pilot *target )
       - (p->solid->pos.x + p->solid->vel.x*t);
    y = target->solid->pos.y + target->solid->vel.y*t
       - (p->solid->pos.y + p->solid->vel.y*t);
-   vect_cset( &tv, x, y );
-
-   return VANGLE(tv);
+   return ANGLE(x, y);
 }
 
 /**
@@ -1042,11 +1558,9 @@ void pilot_setHostile( Pilot* p )
 {
    if ( pilot_isFriendly( p ) || pilot_isFlag( p, PILOT_BRIBED )
          || !pilot_isFlag( p, PILOT_HOSTILE ) ) {
-      /* Time to play combat music. */
-      music_choose("combat");
-
       player.enemies++;
       pilot_setFlag( p, PILOT_HOSTILE );
+      pilot_queryInvalidate();
    }
    pilot_rmFriendly( p );
    pilot_rmFlag( p, PILOT_BRIBED );
@@ -1146,10 +1660,70 @@ void pilot_broadcast( Pilot *p, const char *msg, int ignore_int )
 }
 
 
+/**
+ * @brief Gets the pilots that may be in range of a pilot's signals.
+ *
+ * A pilot is in range if it is within sensor range of the sender, or the
+ *  sender detects it, which can't happen further away than the sensor range
+ *  divided by the lowest hide value. Only the collision grid around that
+ *  range is looked at, plus the pilots seen from anywhere and the escorts.
+ *
+ *    @param p Pilot sending the signal.
+ *    @param[out] ids Array (array.h) of sorted unique stack positions, gets
+ *                cleared first and created if NULL.
+ */
+static void pilot_signalQuery( const Pilot *p, int **ids )
+{
+   int i, j, n;
+   double r2, r;
+
+   if (pilot_gridDirty)
+      pilots_buildGrid();
+
+   /* Nothing is hidden enough to bound the range, look at everyone. */
+   r2 = pilot_sensorRange();
+   if (pilot_gridMinHide > 0.)
+      r2 = MAX( r2, pilot_sensorRange() * p->ew_detect / pilot_gridMinHide );
+   if (pilot_gridMinHide <= 0.) {
+      if (*ids == NULL)
+         *ids = array_create( int );
+      array_resize( ids, array_size(pilot_stack) );
+      for (i=0; i<array_size(pilot_stack); i++)
+         (*ids)[i] = i;
+      return;
+   }
+
+   /* Pilots move during the frame after the grid is built. */
+   r = sqrt(r2) + pilot_gridMaxSize;
+   spatial_query( &pilot_grid, ids,
+         p->solid->pos.x - r, p->solid->pos.y - r,
+         p->solid->pos.x + r, p->solid->pos.y + r );
+
+   /* These are in range no matter the distance. */
+   for (i=0; i<array_size(pilot_gridVisible); i++)
+      array_push_back( ids, pilot_gridVisible[i] );
+   for (i=0; i<array_size(p->escorts); i++) {
+      j = pilot_getStackPos( p->escorts[i].id );
+      if (j >= 0)
+         array_push_back( ids, j );
+   }
+
+   /* Keep the stack order and drop duplicates. */
+   qsort( *ids, array_size(*ids), sizeof(int), pilot_cmpStackPos );
+   n = 0;
+   for (i=0; i<array_size(*ids); i++)
+      if ((n == 0) || ((*ids)[i] != (*ids)[n-1]))
+         (*ids)[n++] = (*ids)[i];
+   array_resize( ids, n );
+}
+
+
 /**
  * @brief Has the pilot broadcast a distress signal.
  *
- * Can do a faction hit on the player.
+ * Can do a faction hit on the player. Pilots in trouble keep calling for
+ *  help, so repeated signals about the same attacker are dropped for a
+ *  moment.
  *
  *    @param p Pilot sending the distress signal.
  *    @param attacker Attacking pilot.
@@ -1158,17 +1732,25 @@ void pilot_broadcast( Pilot *p, const char *msg, int ignore_int )
  */
 void pilot_distress( Pilot *p, Pilot *attacker, const char *msg, int ignore_int )
 {
-   int i, r;
+   int i, j, r;
    double d;
-
-   /* Broadcast the message. */
-   if (msg[0] != '\0')
-      pilot_broadcast( p, msg, ignore_int );
+   Pilot *t;
 
    /* Use the victim's target if the attacker is unknown. */
    if (attacker == NULL)
       attacker = pilot_get( p->target );
 
+   /* Already called for help about this attacker. */
+   if ((p->distress_timer > 0.) &&
+         (p->distress_attacker == ((attacker != NULL) ? attacker->id : 0)))
+      return;
+   p->distress_timer    = PILOT_DISTRESS_COOLDOWN;
+   p->distress_attacker = (attacker != NULL) ? attacker->id : 0;
+
+   /* Broadcast the message. */
+   if (msg[0] != '\0')
+      pilot_broadcast( p, msg, ignore_int );
+
    /* Now proceed to see if player.p should incur faction loss because
     * of the broadcast signal. */
 
@@ -1188,30 +1770,44 @@ void pilot_distress( Pilot *p, Pilot *attacker, const char *msg, int ignore_int
    }
 
    /* Now we must check to see if a pilot is in range. */
-   for (i=0; i<array_size(pilot_stack); i++) {
-      /* Skip if unsuitable. */
-      if ((pilot_stack[i]->ai == NULL) || (pilot_stack[i]->id == p->id) ||
-            (pilot_isFlag(pilot_stack[i], PILOT_DEAD)) ||
-            (pilot_isFlag(pilot_stack[i], PILOT_DELETE)))
-         continue;
-
-      if (!ignore_int) {
-         if (!pilot_inRangePilot(p, pilot_stack[i], NULL)) {
+   if (!ignore_int) {
+      if (pilot_distressRecv == NULL)
+         pilot_distressRecv = array_create( unsigned int );
+      array_resize( &pilot_distressRecv, 0 );
+      pilot_signalQuery( p, &pilot_distressIds );
+      for (j=0; j<array_size(pilot_distressIds); j++) {
+         t = pilot_stack[ pilot_distressIds[j] ];
+
+         /* Skip if unsuitable. */
+         if ((t->ai == NULL) || (t->id == p->id) ||
+               (pilot_isFlag(t, PILOT_DEAD)) ||
+               (pilot_isFlag(t, PILOT_DELETE)))
+            continue;
+
+         if (!pilot_inRangePilot(p, t, NULL)) {
             /*
              * If the pilots are within sensor range of each other, send the
              * distress signal, regardless of electronic warfare hide values.
              */
-            d = vect_dist2( &p->solid->pos, &pilot_stack[i]->solid->pos );
+            d = vect_dist2( &p->solid->pos, &t->solid->pos );
             if (d > pilot_sensorRange())
                continue;
          }
+         array_push_back( &pilot_distressRecv, t->id );
+      }
+
+      /* The AI can add and remove pilots, so go by ID. */
+      for (j=0; j<array_size(pilot_distressRecv); j++) {
+         t = pilot_get( pilot_distressRecv[j] );
+         if (t == NULL)
+            continue;
 
          /* Send AI the distress signal. */
-         ai_getDistress( pilot_stack[i], p, attacker );
+         ai_getDistress( t, p, attacker );
 
          /* Check if should take faction hit. */
          if ((attacker == player.p) && !pilot_isFlag(p, PILOT_DISTRESSED) &&
-               !areEnemies(p->faction, pilot_stack[i]->faction))
+               !areEnemies(p->faction, t->faction))
             r = 1;
       }
    }
@@ -1221,7 +1817,7 @@ void pilot_distress( Pilot *p, Pilot *attacker, const char *msg, int ignore_int
 
       /* Modify faction, about 1 for a llama, 4.2 for a hawking */
       if ((attacker != NULL) && (attacker->faction == FACTION_PLAYER) && r)
-         faction_modPlayer( p->faction, -(pow(p->base_mass, 0.2) - 1.), "distress" );
+         faction_modPlayerQueue( p->faction, -(pow(p->base_mass, 0.2) - 1.), "distress" );
 
       /* Set flag to avoid a second faction hit. */
       pilot_setFlag(p, PILOT_DISTRESSED);
@@ -1242,12 +1838,8 @@ void pilot_rmHostile( Pilot* p )
          if (pilot_isDisabled(p))
             player.disabled_enemies--;
 
-         /* Change music back to ambient if no more enemies. */
-         if (player.enemies <= player.disabled_enemies) {
-            music_choose("ambient");
-         }
-
          pilot_rmFlag(p, PILOT_HOSTILE);
+         pilot_queryInvalidate();
       }
 
       /* Set "bribed" flag if faction has poor reputation */
@@ -1481,7 +2073,7 @@ double pilot_hit( Pilot* p, const Solid* w, const unsigned int shooter,
             mod = 2 * (pow(p->base_mass, 0.4) - 1.);
 
             /* Modify faction for him and friends. */
-            faction_modPlayer( p->faction, -mod, "kill" );
+            faction_modPlayerQueue( p->faction, -mod, "kill" );
 
             /* Note that player destroyed the ship. */
             player.ships_destroyed[p->ship->class]++;
@@ -1590,11 +2182,8 @@ void pilot_updateDisable( Pilot* p, const unsigned int shooter )
       pilot_rmFlag( p, PILOT_BOARDING ); /* Can get boarded again. */
 
       /* If hostile, must remove counter. */
-      if (pilot_isHostile(p)) {
+      if (pilot_isHostile(p))
          player.disabled_enemies--;
-         /* Time to play combat music. */
-         music_choose("combat");
-      }
 
       /* Reset the accumulated disable time. */
       p->dtimer_accum = 0.;
@@ -1667,7 +2256,7 @@ static void pilot_dead( Pilot* p, unsigned int killer )
 void pilot_explode( double x, double y, double radius, const Damage *dmg, const Pilot *parent )
 {
    int i;
-   double rx, ry;
+   double rx, ry, r;
    double dist, rad2;
    Pilot *p;
    Solid s; /* Only need to manipulate mass and vel. */
@@ -1676,8 +2265,18 @@ void pilot_explode( double x, double y, double radius, const Damage *dmg, const
    rad2 = radius*radius;
    ddmg = *dmg;
 
-   for (i=0; i<array_size(pilot_stack); i++) {
-      p = pilot_stack[i];
+   /* Only look at the pilots near the explosion. Bigger ships get hit from
+    * further away, so pad by the biggest one. */
+   if (pilot_gridDirty)
+      pilots_buildGrid();
+   r = radius + pilot_gridMaxSize;
+   pilot_collideQuery( &pilot_explodeIds, x-r, y-r, x+r, y+r );
+
+   for (i=0; i<array_size(pilot_explodeIds); i++) {
+      /* Stack can grow while hitting. */
+      if (pilot_explodeIds[i] >= array_size(pilot_stack))
+         continue;
+      p = pilot_stack[ pilot_explodeIds[i] ];
 
       /* Calculate a bit. */
       rx = p->solid->pos.x - x;
@@ -1787,6 +2386,8 @@ void pilot_renderOverlay( Pilot* p, const double dt )
       p->comm_msgTimer -= dt;
       if (p->comm_msgTimer < 0.) {
          free(p->comm_msg);
+   free(p->collpoly.x);
+   free(p->collpoly.y);
          p->comm_msg = NULL;
       }
       else {
@@ -1803,7 +2404,8 @@ void pilot_renderOverlay( Pilot* p, const double dt )
          dx = x - p->comm_msgWidth/2.;
          dy = y + PILOT_SIZE_APROX*p->ship->gfx_space->sh/2.;
 
-         /* Background. */
+         /* Background, queued sprites must go below it. */
+         gl_batchFlush();
          gl_renderRect( dx-2., dy-2., p->comm_msgWidth+4., gl_defFont.h+4., &cBlackHilight );
 
          /* Display text. */
@@ -1853,6 +2455,8 @@ void pilot_update( Pilot* pilot, double dt )
     */
    pilot->ptimer   -= dt;
    pilot->tcontrol -= dt;
+   if (pilot->distress_timer > 0.)
+      pilot->distress_timer -= dt;
    if (cooling) {
       pilot->ctimer   -= dt;
       if (pilot->ctimer < 0.) {
@@ -1867,7 +2471,6 @@ void pilot_update( Pilot* pilot, double dt )
       if (pilot->timer[i] > 0.)
          pilot->timer[i] -= dt;
    /* Update heat. */
-   a = -1.;
    Q = 0.;
    nchg = 0; /* Number of outfits that change state, processed at the end. */
    for (i=0; i<array_size(pilot->outfits); i++) {
@@ -1942,7 +2545,7 @@ void pilot_update( Pilot* pilot, double dt )
          Q  += pilot_heatUpdateSlot( pilot, o, dt );
 
       /* Handle lockons. */
-      pilot_lockUpdateSlot( pilot, o, target, &a, dt );
+      pilot_lockUpdateSlot( pilot, o, target, dt );
    }
 
    /* Global heat. */
@@ -1995,7 +2598,7 @@ void pilot_update( Pilot* pilot, double dt )
             (pilot->ptimer < 0.050)) {
 
          /* Play random explosion sound. */
-         snprintf(buf, sizeof(buf), "explosion%d", RNG(0,2));
+         snprintf(buf, sizeof(buf), "explosion%d", RNG_COSMETIC(0,2));
          sound_playPos( sound_get(buf), pilot->solid->pos.x, pilot->solid->pos.y,
                pilot->solid->vel.x, pilot->solid->vel.y );
 
@@ -2034,15 +2637,15 @@ void pilot_update( Pilot* pilot, double dt )
                pilot->ptimer;
 
          /* random position on ship */
-         a = RNGF()*2.*M_PI;
-         px = VX(pilot->solid->pos) +  cos(a)*RNGF()*pilot->ship->gfx_space->sw/2.;
-         py = VY(pilot->solid->pos) +  sin(a)*RNGF()*pilot->ship->gfx_space->sh/2.;
+         a = RNGF_COSMETIC()*2.*M_PI;
+         px = VX(pilot->solid->pos) +  cos(a)*RNGF_COSMETIC()*pilot->ship->gfx_space->sw/2.;
+         py = VY(pilot->solid->pos) +  sin(a)*RNGF_COSMETIC()*pilot->ship->gfx_space->sh/2.;
          vx = VX(pilot->solid->vel);
          vy = VY(pilot->solid->vel);
 
          /* set explosions */
          l = (pilot->id==PLAYER_ID) ? SPFX_LAYER_FRONT : SPFX_LAYER_MIDDLE;
-         if (RNGF() > 0.8)
+         if (RNGF_COSMETIC() > 0.8)
             spfx_add( spfx_get("ExpM"), px, py, vx, vy, l );
          else
             spfx_add( spfx_get("ExpS"), px, py, vx, vy, l );
@@ -2653,18 +3256,27 @@ static void pilot_init( Pilot* pilot, Ship* ship, const char* name, int faction,
       const double dir, const Vector2d* pos, const Vector2d* vel,
       const PilotFlags flags, unsigned int dockpilot, int dockslot )
 {
-   int i, j;
+   int i, j, n;
    PilotOutfitSlot *dslot, *slot;
    PilotOutfitSlot **pilot_list_ptr[] = { &pilot->outfit_structure, &pilot->outfit_utility, &pilot->outfit_weapon };
    ShipOutfitSlot *ship_list[] = { ship->outfit_structure, ship->outfit_utility, ship->outfit_weapon };
-
-   /* Clear memory. */
+   PilotOutfitSlot *lists[3];
+   PilotOutfitSlot **outfits;
+   Solid *solid;
+
+   /* Clear memory, but keep the storage of a recycled pilot. */
+   outfits  = pilot->outfits;
+   lists[0] = pilot->outfit_structure;
+   lists[1] = pilot->outfit_utility;
+   lists[2] = pilot->outfit_weapon;
+   solid    = pilot->solid;
    memset(pilot, 0, sizeof(Pilot));
 
    if (pilot_isFlagRaw(flags, PILOT_PLAYER)) /* Set player ID. TODO should probably be fixed to something better someday. */
       pilot->id = PLAYER_ID;
    else
       pilot->id = ++pilot_id; /* new unique pilot id based on pilot_id, can't be 0 */
+   rngs_seed( &pilot->rng, RNG_STREAM_PILOT + pilot->id );
 
    /* Defaults. */
    pilot->autoweap = 1;
@@ -2675,13 +3287,19 @@ static void pilot_init( Pilot* pilot, Ship* ship, const char* name, int faction,
 
    /* Basic information. */
    pilot->ship = ship;
+   ship_gfxRef( ship );
    pilot->name = strdup( (name==NULL) ? ship->name : name );
 
    /* faction */
    pilot->faction = faction;
 
    /* solid */
-   pilot->solid = solid_create(ship->mass, dir, pos, vel, SOLID_UPDATE_RK4);
+   if (solid != NULL) {
+      pilot->solid = solid;
+      solid_init( pilot->solid, ship->mass, dir, pos, vel, SOLID_UPDATE_RK4 );
+   }
+   else
+      pilot->solid = solid_create(ship->mass, dir, pos, vel, SOLID_UPDATE_RK4);
 
    /* First pass to make sure requirements make sense. */
    pilot->armour = pilot->armour_max = 1.; /* hack to have full armour */
@@ -2691,11 +3309,27 @@ static void pilot_init( Pilot* pilot, Ship* ship, const char* name, int faction,
    pilot_calcStats(pilot);
    pilot->stress = 0.; /* No stress. */
 
-   /* Allocate outfit memory. */
-   pilot->outfits  = array_create( PilotOutfitSlot* );
+   /* Allocate outfit memory. The slot arrays must not be reallocated while
+    * filling them as pilot->outfits points into them, so reserve up front. */
+   n = 0;
+   for (i=0; i<3; i++)
+      n += array_size(ship_list[i]);
+   if (outfits == NULL)
+      outfits = array_create_size( PilotOutfitSlot*, n );
+   else {
+      array_resize( &outfits, n );
+      array_resize( &outfits, 0 );
+   }
+   pilot->outfits = outfits;
    /* First pass copy data. */
    for (i=0; i<3; i++) {
-      *pilot_list_ptr[i] = array_create_size( PilotOutfitSlot, array_size(ship_list[i]) );
+      if (lists[i] == NULL)
+         lists[i] = array_create_size( PilotOutfitSlot, array_size(ship_list[i]) );
+      else {
+         array_resize( &lists[i], array_size(ship_list[i]) );
+         array_resize( &lists[i], 0 );
+      }
+      *pilot_list_ptr[i] = lists[i];
       for (j=0; j<array_size(ship_list[i]); j++) {
          slot = &array_grow( pilot_list_ptr[i] );
          memset( slot, 0, sizeof(PilotOutfitSlot) );
@@ -2708,7 +3342,6 @@ static void pilot_init( Pilot* pilot, Ship* ship, const char* name, int faction,
             pilot_addOutfitRaw( pilot, slot->sslot->data, slot );
       }
    }
-   array_shrink( &pilot->outfits );
 
    /* cargo - must be set before calcStats */
    pilot->cargo_free = pilot->ship->cap_cargo; /* should get redone with calcCargo */
@@ -2823,7 +3456,7 @@ unsigned int pilot_create( Ship* ship, const char* name, int faction, const char
    Pilot *dyn, **p;
 
    /* Allocate pilot memory. */
-   dyn = malloc(sizeof(Pilot));
+   dyn = pilot_alloc();
    if (dyn == NULL) {
       WARN(_("Unable to allocate memory"));
       return 0;
@@ -2832,9 +3465,11 @@ unsigned int pilot_create( Ship* ship, const char* name, int faction, const char
    /* Set the pilot in the stack -- must be there before initializing */
    p = &array_grow( &pilot_stack );
    *p = dyn;
+   pilot_gridDirty = 1;
 
    /* Initialize the pilot. */
    pilot_init( dyn, ship, name, faction, ai, dir, pos, vel, flags, dockpilot, dockslot );
+   pilot_tableAdd( dyn );
 
    /* Animated trail. */
    pilot_init_trails( dyn );
@@ -2860,7 +3495,7 @@ Pilot* pilot_createEmpty( Ship* ship, const char* name,
       int faction, const char *ai, PilotFlags flags )
 {
    Pilot* dyn;
-   dyn = malloc(sizeof(Pilot));
+   dyn = pilot_alloc();
    if (dyn == NULL) {
       WARN(_("Unable to allocate memory"));
       return 0;
@@ -2883,6 +3518,7 @@ Pilot* pilot_replacePlayer( Pilot* after )
       spfx_trail_remove( pilot_stack[i]->trail[j] );
    array_erase( &pilot_stack[i]->trail, array_begin(pilot_stack[i]->trail), array_end(pilot_stack[i]->trail) );
    pilot_stack[i] = after;
+   pilot_gridDirty = 1;
    pilot_init_trails( after );
    /* Run Lua stuff. */
    pilot_outfitLInitAll( after );
@@ -2982,6 +3618,9 @@ void pilot_free( Pilot* p )
 {
    int i;
 
+   /* No longer look up-able. */
+   pilot_tableRemove(p);
+
    /* Clear up pilot hooks. */
    pilot_clearHooks(p);
 
@@ -2990,11 +3629,6 @@ void pilot_free( Pilot* p )
 
    pilot_weapSetFree(p);
 
-   array_free(p->outfits);
-   array_free(p->outfit_structure);
-   array_free(p->outfit_utility);
-   array_free(p->outfit_weapon);
-
    pilot_cargoRmAll( p, 1 );
 
    /* Clean up data. */
@@ -3002,10 +3636,10 @@ void pilot_free( Pilot* p )
       ai_destroy(p); /* Must be destroyed first if applicable. */
 
    free(p->name);
+   ship_gfxUnref( p->ship );
    /* Case if pilot is the player. */
    if (player.p==p)
       player.p = NULL;
-   solid_free(p->solid);
    free(p->mounted);
 
    escort_freeList(p);
@@ -3015,16 +3649,103 @@ void pilot_free( Pilot* p )
    /* Free messages. */
    luaL_unref(naevL, p->messages, LUA_REGISTRYINDEX);
 
+   /* Scripts holding on to it keep their userdata, but it's no longer reused. */
+   nlua_internRemove( naevL, PILOT_INTERN, p->id );
+
    /* Free animated trail. */
    for (i=0; i<array_size(p->trail); i++)
       spfx_trail_remove( p->trail[i] );
    array_free(p->trail);
 
+   /* The solid and slot arrays are kept for reuse. */
+   pilot_release(p);
+}
+
+
+/**
+ * @brief Gets memory for a new pilot, reusing a freed one if possible.
+ *
+ * Recycled pilots keep their solid and slot arrays which pilot_init reuses,
+ *  so spawning a fleet doesn't have to go through the allocator for each of
+ *  them.
+ *
+ *    @return Memory for the pilot, to be initialized with pilot_init.
+ */
+static Pilot* pilot_alloc (void)
+{
+   Pilot *p;
+   int n;
+
+   n = array_size(pilot_pool);
+   if (n > 0) {
+      p = pilot_pool[n-1];
+      array_resize( &pilot_pool, n-1 );
+      return p;
+   }
+
+   /* pilot_init expects the storage pointers to be NULL if not recycled. */
+   memtrack_alloc( MEMTRACK_PILOTS, sizeof(Pilot) );
+   return calloc( 1, sizeof(Pilot) );
+}
+
+
+/**
+ * @brief Releases the memory of a pilot that has been cleaned up.
+ *
+ *    @param p Pilot to release.
+ */
+static void pilot_release( Pilot *p )
+{
+   PilotOutfitSlot **outfits;
+   PilotOutfitSlot *lists[3];
+   Solid *solid;
+
+   /* Pool is full or gone, just free it all. */
+   if ((pilot_pool == NULL) || (array_size(pilot_pool) >= PILOT_POOL_MAX)) {
+      array_free(p->outfits);
+      array_free(p->outfit_structure);
+      array_free(p->outfit_utility);
+      array_free(p->outfit_weapon);
+      solid_free(p->solid);
+      free(p);
+      memtrack_free( MEMTRACK_PILOTS, sizeof(Pilot) );
+      return;
+   }
+
+   /* Only keep the storage. */
+   outfits  = p->outfits;
+   lists[0] = p->outfit_structure;
+   lists[1] = p->outfit_utility;
+   lists[2] = p->outfit_weapon;
+   solid    = p->solid;
 #ifdef DEBUGGING
    memset( p, 0, sizeof(Pilot) );
 #endif /* DEBUGGING */
+   array_resize( &outfits, 0 );
+   p->outfits           = outfits;
+   p->outfit_structure  = lists[0];
+   p->outfit_utility    = lists[1];
+   p->outfit_weapon     = lists[2];
+   p->solid             = solid;
+
+   array_push_back( &pilot_pool, p );
+}
+
 
-   free(p);
+/**
+ * @brief Frees the pilots kept for reuse.
+ */
+static void pilot_poolFree (void)
+{
+   int i;
+   Pilot **pool;
+
+   /* Releasing must not go back into the pool. */
+   pool = pilot_pool;
+   pilot_pool = NULL;
+   for (i=0; i<array_size(pool); i++)
+      pilot_release( pool[i] );
+   array_free( pool );
 }
 
 
@@ -3058,6 +3779,7 @@ void pilot_destroy(Pilot* p)
    /* pilot is eliminated */
    pilot_free(p);
    array_erase( &pilot_stack, &pilot_stack[i], &pilot_stack[i+1] );
+   pilot_gridDirty = 1;
 }
 
 
@@ -3067,6 +3789,13 @@ void pilot_destroy(Pilot* p)
 void pilots_init (void)
 {
    pilot_stack = array_create_size( Pilot*, PILOT_SIZE_MIN );
+   pilot_pool = array_create_size( Pilot*, PILOT_POOL_MAX );
+   pilot_tableRebuild();
+   spatial_init( &pilot_grid, PILOT_GRID_CELLSIZE );
+   pilot_gridDirty = 1;
+   pilot_senseJobs = array_create( PilotSenseJob );
+   pilot_queryCache = array_create( PilotQueryCache );
+   pilot_queryIds = array_create( int );
 }
 
 
@@ -3078,13 +3807,37 @@ void pilots_free (void)
    int i;
 
    pilot_freeGlobalHooks();
+   pilot_outfitLBatchFree();
 
    /* Free pilots. */
    for (i=0; i < array_size(pilot_stack); i++)
       pilot_free(pilot_stack[i]);
    array_free(pilot_stack);
    pilot_stack = NULL;
+   pilot_poolFree();
+   free( pilot_table );
+   pilot_table = NULL;
+   pilot_tableSize = 0;
    player.p = NULL;
+   spatial_free( &pilot_grid );
+   array_free( pilot_senseJobs );
+   pilot_senseJobs = NULL;
+   array_free( pilot_queryCache );
+   pilot_queryCache = NULL;
+   array_free( pilot_queryIds );
+   pilot_queryIds = NULL;
+   array_free( pilot_explodeIds );
+   pilot_explodeIds = NULL;
+   array_free( pilot_distressIds );
+   pilot_distressIds = NULL;
+   array_free( pilot_distressRecv );
+   pilot_distressRecv = NULL;
+   array_free( pilot_gridVisible );
+   pilot_gridVisible = NULL;
+   array_free( pilot_aheadPos );
+   pilot_aheadPos = NULL;
+   array_free( pilot_drawList );
+   pilot_drawList = NULL;
 }
 
 
@@ -3121,6 +3874,7 @@ void pilots_clean (int persist)
          pilot_free(pilot_stack[i]);
    }
    array_erase( &pilot_stack, &pilot_stack[persist_count], array_end(pilot_stack) );
+   pilot_gridDirty = 1;
 
    /* Clear global hooks. */
    pilots_clearGlobalHooks();
@@ -3162,6 +3916,114 @@ void pilots_cleanAll (void)
       player.p = NULL;
    }
    array_erase( &pilot_stack, array_begin(pilot_stack), array_end(pilot_stack) );
+   pilot_gridDirty = 1;
+}
+
+
+/**
+ * @brief Senses the environment for a range of the pilot stack.
+ *
+ * Run from the threadpool, so it must not modify anything but the sensing
+ * results of the pilots in its range.
+ *
+ *    @param data Range of the stack to sense (PilotSenseJob).
+ */
+static int pilot_senseJob( void *data )
+{
+   int i, j;
+   unsigned int tp;
+   double d, td;
+   const PilotSenseJob *job;
+   Pilot *p, *target;
+
+   job = (const PilotSenseJob*) data;
+   for (i=job->start; i<job->end; i++) {
+      p = pilot_stack[i];
+
+      /* Only pilots that will think. */
+      if ((p->ai == NULL) || pilot_isDisabled(p) ||
+            pilot_isFlag(p, PILOT_DELETE) ||
+            pilot_isFlag(p, PILOT_HIDE) ||
+            pilot_isFlag(p, PILOT_DEAD))
+         continue;
+
+      /* Nearest enemy, same as pilot_getNearestEnemy(). */
+      tp = 0;
+      d  = 0.;
+      for (j=0; j<array_size(pilot_stack); j++) {
+         target = pilot_stack[j];
+         if (!pilot_validEnemy( p, target ))
+            continue;
+         td = vect_dist2( &target->solid->pos, &p->solid->pos );
+         if (!tp || (td < d)) {
+            d  = td;
+            tp = target->id;
+         }
+      }
+
+      p->sense.enemy     = tp;
+      p->sense.brakedist = pilot_minBrakeDist( p );
+      p->sense.valid     = 1;
+   }
+
+   return 0;
+}
+
+
+/**
+ * @brief Precomputes what the AI needs to know on multiple threads.
+ *
+ * Pilots don't move while thinking, so the results stay valid for the whole
+ * think phase of pilots_update().
+ */
+static void pilots_sense (void)
+{
+   int i, n;
+   ThreadQueue *queue;
+   PilotSenseJob *job;
+
+   /* Faction relations are cached, so checking them doesn't touch Lua. */
+   for (i=0; i<array_size(pilot_stack); i++)
+      pilot_stack[i]->sense.valid = 0;
+
+   /* Split the stack into jobs, they have to be in place before enqueueing. */
+   n = array_size(pilot_stack);
+   array_resize( &pilot_senseJobs, 0 );
+   for (i=0; i<n; i+=PILOT_SENSE_CHUNK) {
+      job = &array_grow( &pilot_senseJobs );
+      job->start = i;
+      job->end   = MIN( i+PILOT_SENSE_CHUNK, n );
+   }
+
+   queue = vpool_create();
+   for (i=0; i<array_size(pilot_senseJobs); i++)
+      vpool_enqueue( queue, pilot_senseJob, &pilot_senseJobs[i] );
+   vpool_wait( queue );
+}
+
+
+/**
+ * @brief Checks whether a pilot can be updated at a reduced rate.
+ *
+ * Pilots far from the player that are just flying around don't need the
+ *  precision, while anything with timing the player could notice keeps being
+ *  updated every frame. They go back to full rate as soon as they approach.
+ *
+ *    @param p Pilot to check.
+ *    @return 1 if the pilot can be updated at a reduced rate.
+ */
+static int pilot_updateCoarse( const Pilot *p )
+{
+   if (!conf.ai_lod || (p->ai_lod < AI_LOD_FAR))
+      return 0;
+   if (pilot_isFlag(p, PILOT_PLAYER) || pilot_isFlag(p, PILOT_COMBAT) ||
+         pilot_isFlag(p, PILOT_DEAD) || pilot_isFlag(p, PILOT_HYPERSPACE) ||
+         pilot_isFlag(p, PILOT_HYP_PREP) || pilot_isFlag(p, PILOT_HYP_BEGIN) ||
+         pilot_isFlag(p, PILOT_HYP_END) || pilot_isFlag(p, PILOT_LANDING) ||
+         pilot_isFlag(p, PILOT_TAKEOFF) || pilot_isFlag(p, PILOT_BOARDING) ||
+         pilot_isFlag(p, PILOT_REFUELBOARDING) || pilot_isFlag(p, PILOT_BRAKING))
+      return 0;
+   return 1;
 }
 
 
@@ -3173,9 +4035,19 @@ void pilots_cleanAll (void)
 void pilots_update( double dt )
 {
    int i;
+   double udt;
    Pilot *p;
 
+   /* New frame for the AI scheduler. */
+   ai_lodFrame();
+   pilot_ewFrame();
+
+   /* Precompute what the AI needs in parallel. */
+   if (conf.ai_threaded)
+      pilots_sense();
+
    /* Now update all the pilots. */
+   PROFILE_BEGIN( PROFILE_AI );
    for (i=0; i<array_size(pilot_stack); i++) {
       p = pilot_stack[i];
 
@@ -3218,11 +4090,15 @@ void pilots_update( double dt )
             !pilot_isFlag(p, PILOT_TAKEOFF))
          p->think(p, dt);
    }
+   PROFILE_END( PROFILE_AI );
 
    /* Now update all the pilots. */
    for (i=0; i<array_size(pilot_stack); i++) {
       p = pilot_stack[i];
 
+      /* Sensing is no longer valid once pilots move. */
+      p->sense.valid = 0;
+
       /* Ignore. */
       if (pilot_isFlag(p, PILOT_DELETE))
          continue;
@@ -3231,10 +4107,28 @@ void pilots_update( double dt )
       if (pilot_isFlag(p, PILOT_HIDE))
          continue;
 
+      /* Far away pilots are updated less often, with all the time held back. */
+      if (pilot_updateCoarse( p )) {
+         p->update_dt += dt;
+         if (p->update_dt < PILOT_COARSE_DT)
+            continue;
+      }
+      else
+         p->update_dt += dt;
+      udt          = p->update_dt;
+      p->update_dt = 0.;
+
       /* Just update the pilot. */
       if (p->update) /* update */
-         p->update( p, dt );
+         p->update( p, udt );
    }
+
+   /* Lua outfits updating all their pilots at once. */
+   pilot_outfitLUpdateBatch( dt );
+
+   /* Positions are final for this frame, rebuild the collision grid. */
+   pilots_buildGrid();
+   pilot_ewFrame();
 }
 
 
@@ -3246,15 +4140,134 @@ void pilots_update( double dt )
 void pilots_render( double dt )
 {
    int i;
+   double x1, y1, x2, y2, r;
+   Pilot *p;
+   const glTexture *gfx;
+
+   /* Only pilots on screen are drawn. */
+   cam_getBounds( &x1, &y1, &x2, &y2 );
+   if (pilot_drawList == NULL)
+      pilot_drawList = array_create( Pilot* );
+   array_resize( &pilot_drawList, 0 );
    for (i=0; i<array_size(pilot_stack); i++) {
+      p = pilot_stack[i];
 
       /* Invisible, not doing anything. */
-      if (pilot_isFlag(pilot_stack[i], PILOT_HIDE))
+      if (pilot_isFlag(p, PILOT_HIDE) || (p->render == NULL))
+         continue;
+
+      gfx = p->ship->gfx_space;
+      r   = (gfx != NULL) ? MAX( gfx->sw, gfx->sh ) / 2. : 0.;
+      if ((p->solid->pos.x + r < x1) || (p->solid->pos.x - r > x2) ||
+            (p->solid->pos.y + r < y1) || (p->solid->pos.y - r > y2))
          continue;
 
-      if (pilot_stack[i]->render != NULL) /* render */
-         pilot_stack[i]->render(pilot_stack[i], dt);
+      array_push_back( &pilot_drawList, p );
+   }
+
+   /* Grouped by graphic so they end up in few draws. */
+   qsort( pilot_drawList, array_size(pilot_drawList), sizeof(Pilot*), pilot_cmpDraw );
+
+   gl_batchStart();
+   for (i=0; i<array_size(pilot_drawList); i++)
+      pilot_drawList[i]->render( pilot_drawList[i], dt );
+   gl_batchEnd();
+}
+
+
+/**
+ * @brief Compares pilots by the textures they are drawn with.
+ *
+ * Pilots with the same textures are kept in stack order, so drawing order
+ *  only changes between different ships.
+ */
+static int pilot_cmpDraw( const void *ptr1, const void *ptr2 )
+{
+   const Pilot *p1, *p2;
+   GLuint t1, t2;
+
+   p1 = *(const Pilot**) ptr1;
+   p2 = *(const Pilot**) ptr2;
+
+   t1 = (p1->ship->gfx_space != NULL) ? p1->ship->gfx_space->texture : 0;
+   t2 = (p2->ship->gfx_space != NULL) ? p2->ship->gfx_space->texture : 0;
+   if (t1 != t2)
+      return (t1 < t2) ? -1 : 1;
+   t1 = (p1->ship->gfx_engine != NULL) ? p1->ship->gfx_engine->texture : 0;
+   t2 = (p2->ship->gfx_engine != NULL) ? p2->ship->gfx_engine->texture : 0;
+   if (t1 != t2)
+      return (t1 < t2) ? -1 : 1;
+   if (p1->id != p2->id)
+      return (p1->id < p2->id) ? -1 : 1;
+   return 0;
+}
+
+
+/**
+ * @brief Compares stack positions.
+ */
+static int pilot_cmpStackPos( const void *ptr1, const void *ptr2 )
+{
+   int i1, i2;
+   i1 = *(const int*) ptr1;
+   i2 = *(const int*) ptr2;
+   return (i1 > i2) - (i1 < i2);
+}
+
+
+/**
+ * @brief Moves the pilots to where they will be when drawing ahead of the
+ *        simulation.
+ *
+ * With a fixed simulation rate frames fall in between updates, so pilots are
+ *  drawn moved along their velocity by the time that hasn't been simulated
+ *  yet. Has to be undone with pilots_renderAheadEnd() once drawn.
+ *
+ *    @param t Game time to draw ahead by.
+ */
+void pilots_renderAhead( double t )
+{
+   int i, n;
+   Solid *s;
+
+   if (t == 0.) {
+      array_resize( &pilot_aheadPos, 0 );
+      return;
+   }
+
+   n = array_size(pilot_stack);
+   if (pilot_aheadPos == NULL)
+      pilot_aheadPos = array_create_size( Vector2d, 2*n );
+   array_resize( &pilot_aheadPos, 2*n );
+   for (i=0; i<n; i++) {
+      s = pilot_stack[i]->solid;
+      pilot_aheadPos[2*i] = s->pos;
+      s->pos.x += s->vel.x * t;
+      s->pos.y += s->vel.y * t;
+      pilot_aheadPos[2*i+1] = s->pos;
+   }
+}
+
+
+/**
+ * @brief Puts the pilots back at their simulated position after drawing.
+ *
+ * Pilots moved while drawing, e.g. from a render hook, are left where they
+ *  were moved to.
+ */
+void pilots_renderAheadEnd (void)
+{
+   int i, n;
+   Solid *s;
+
+   n = MIN( array_size(pilot_aheadPos)/2, array_size(pilot_stack) );
+   for (i=0; i<n; i++) {
+      s = pilot_stack[i]->solid;
+      if ((s->pos.x == pilot_aheadPos[2*i+1].x) &&
+            (s->pos.y == pilot_aheadPos[2*i+1].y))
+         s->pos = pilot_aheadPos[2*i];
    }
+   array_resize( &pilot_aheadPos, 0 );
 }
 
 
@@ -3266,6 +4279,9 @@ void pilots_render( double dt )
 void pilots_renderOverlay( double dt )
 {
    int i;
+
+   /* The hail icons all share a sprite sheet. */
+   gl_batchStart();
    for (i=0; i<array_size(pilot_stack); i++) {
 
       /* Invisible, not doing anything. */
@@ -3275,6 +4291,7 @@ void pilots_renderOverlay( double dt )
       if (pilot_stack[i]->render_overlay != NULL) /* render */
          pilot_stack[i]->render_overlay(pilot_stack[i], dt);
    }
+   gl_batchEnd();
 }
 
 
@@ -3416,6 +4433,45 @@ credits_t pilot_worth( const Pilot *p )
 }
 
 
+/**
+ * @brief Gets the collision polygon of a pilot for its current sprite.
+ *
+ * Ships that only keep keyframes have the closest one rotated into a polygon
+ *  of the pilot, which is kept until the sprite changes.
+ *
+ *    @param p Pilot to get the collision polygon of.
+ *    @return The collision polygon or NULL if the ship has none.
+ */
+const CollPoly* pilot_collPoly( Pilot *p )
+{
+   const Ship *s;
+   int k, j, d, step;
+
+   s = p->ship;
+   if (array_size(s->polygon) == 0)
+      return NULL;
+
+   k = s->gfx_sx * p->tsy + p->tsx;
+   step = s->polygon_step;
+   if (step <= 1)
+      return &s->polygon[k];
+
+   if ((p->collpoly.npt > 0) && (p->collpoly_k == k))
+      return &p->collpoly;
+
+   /* Closest keyframe, wrapping around. */
+   j = (k + step/2) / step;
+   d = k - j*step;
+   if (j >= array_size(s->polygon)) {
+      j = 0;
+      d = k - s->gfx_sx * s->gfx_sy;
+   }
+   RotatePolygon( &p->collpoly, &s->polygon[j], d * s->mangle );
+   p->collpoly_k = k;
+   return &p->collpoly;
+}
+
+
 /**
  * @brief Sends a message
  *
@@ -3447,3 +4503,24 @@ void pilot_msg(Pilot *p, Pilot *receiver, const char *type, unsigned int idx)
    lua_rawseti(naevL, -2, lua_objlen(naevL, -2)+1); /* data, msg, messages */
    lua_pop(naevL, 3); /*  */
 }
+
+
+/**
+ * @brief Gives an order to all the pilots led by a pilot.
+ *
+ * The order is only stored in the leader, the AI of the escorts picks it up
+ *  with ai.order().
+ *
+ *    @param p Pilot giving the order.
+ *    @param type Type of order.
+ *    @param target Pilot the order is about or 0.
+ *    @param jump Destination system ID of a jump order or -1.
+ */
+void pilot_order( Pilot *p, const char *type, unsigned int target, int jump )
+{
+   p->order.serial++;
+   strncpy( p->order.type, type, sizeof(p->order.type)-1 );
+   p->order.type[ sizeof(p->order.type)-1 ] = '\0';
+   p->order.target = target;
+   p->order.jump   = jump;
+}
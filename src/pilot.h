@@ -14,6 +14,7 @@
 #include "ntime.h"
 #include "outfit.h"
 #include "physics.h"
+#include "rng.h"
 #include "ship.h"
 #include "sound.h"
 #include "space.h"
@@ -45,6 +46,7 @@
 #define PILOT_SIZE_APROX         0.8   /**< approximation for pilot size */
 #define PILOT_WEAPON_SETS        10    /**< Number of weapon sets the pilot has. */
 #define PILOT_WEAPSET_MAX_LEVELS 2     /**< Maximum amount of weapon levels. */
+#define PILOT_FIRE_SOLUTIONS     8     /**< Fire control solutions cached per pilot. */
 #define PILOT_REVERSE_THRUST     0.4   /**< Ratio of normal thrust to apply when reversing. */
 
 
@@ -62,8 +64,10 @@ enum {
    PILOT_HOOK_ATTACKED,  /**< Pilot is in manual override and is being attacked. */
    PILOT_HOOK_IDLE,      /**< Pilot is in manual override and has just become idle. */
    PILOT_HOOK_EXPLODED,  /**< Pilot died and exploded (about to be removed). */
-   PILOT_HOOK_LOCKON     /**< Pilot had a launcher lockon. */
+   PILOT_HOOK_LOCKON,    /**< Pilot had a launcher lockon. */
+   PILOT_HOOK_ATTACKED_BATCH /**< Pilot was attacked this frame, once per attacker. */
 };
+#define PILOT_HOOK_BIT(t)  (1U << (t)) /**< Bit of a hook type in the hook masks. */
 
 
 /* damage */
@@ -166,6 +170,58 @@ typedef struct PilotWeaponSet_ {
 } PilotWeaponSet;
 
 
+/**
+ * @brief Cached intercept solution of a pilot, see pilot_weapFlyTime().
+ *
+ * The flight time only depends on the projectile speed and whether it uses
+ *  absolute velocity, so every weapon of the same speed class shares it.
+ */
+typedef struct PilotFireSolution_ {
+   Vector2d pos;     /**< Target position the solution is for. */
+   Vector2d vel;     /**< Target velocity the solution is for. */
+   double speed;     /**< Projectile speed. */
+   int absolute;     /**< Whether the projectile uses absolute velocity. */
+   double time;      /**< Expected flight time, INFINITY if it can't hit. */
+} PilotFireSolution;
+
+
+/**
+ * @brief Fire control cache of a pilot.
+ *
+ * Solutions are only valid while the pilot's position and velocity don't
+ *  change, which in practice means during a single frame.
+ */
+typedef struct PilotFireControl_ {
+   Vector2d pos;     /**< Pilot position the solutions are for. */
+   Vector2d vel;     /**< Pilot velocity the solutions are for. */
+   int n;            /**< Number of cached solutions. */
+   int next;         /**< Next solution to replace when full. */
+   PilotFireSolution sol[PILOT_FIRE_SOLUTIONS]; /**< Cached solutions. */
+} PilotFireControl;
+
+
+/**
+ * @brief Geometry from a pilot to its target.
+ *
+ * Computed once and shared by lockons, AI aiming and the player's aiming
+ *  lines, it is only valid while neither pilot moves.
+ */
+typedef struct PilotTargeting_ {
+   unsigned int target; /**< Target the geometry is for. */
+   Vector2d pos;     /**< Pilot position the geometry is for. */
+   Vector2d vel;     /**< Pilot velocity the geometry is for. */
+   double dir;       /**< Pilot direction the geometry is for. */
+   Vector2d tpos;    /**< Target position the geometry is for. */
+   Vector2d tvel;    /**< Target velocity the geometry is for. */
+   double dist;      /**< Distance to the target. */
+   double angle;     /**< Angle to the target. */
+   double off;       /**< Absolute angle between the pilot's heading and the target. */
+   int aim_valid;    /**< Whether the aim angle is valid. */
+   double aim_speed; /**< Weapon speed the aim angle is for. */
+   double aim;       /**< Angle to aim at to hit the target. */
+} PilotTargeting;
+
+
 /**
  * @brief Stores a pilot commodity.
  */
@@ -208,6 +264,87 @@ typedef struct Escort_s {
 } Escort_t;
 
 
+#define PILOT_ORDER_MAX 32 /**< Maximum length of the type of an order. */
+
+
+/**
+ * @brief Order given by a leader to all the pilots it leads.
+ *
+ * Stored once in the leader and read by the AIs of its escorts, instead of
+ *  sending a message to each of them.
+ */
+typedef struct PilotOrder_ {
+   unsigned int serial; /**< Increases with every order given, 0 if none given. */
+   char type[PILOT_ORDER_MAX]; /**< Type of order, same as the message it replaces. */
+   unsigned int target; /**< Pilot the order is about or 0. */
+   int jump;            /**< Destination system ID of a jump order or -1. */
+} PilotOrder;
+
+
+/**
+ * @brief How the angle of a position in formation is measured.
+ */
+typedef enum PilotFormMethod_ {
+   PILOT_FORM_VELOCITY, /**< From the direction the leader is moving in. */
+   PILOT_FORM_ABSOLUTE, /**< From the x axis. */
+   PILOT_FORM_KEEPANGLE /**< Keeps the current angle to the leader. */
+} PilotFormMethod;
+
+
+/**
+ * @brief Position of a pilot in the formation of its leader.
+ *
+ * Set by the formation scripts and followed by ai.follow_fleet().
+ */
+typedef struct PilotFormation_ {
+   int set;             /**< Whether the pilot has a position in formation. */
+   double angle;        /**< Angle to the leader in degrees. */
+   double radius;       /**< Distance to the leader. */
+   PilotFormMethod method; /**< How the angle is measured. */
+   int app;             /**< Approach stage: 2 far, 1 correcting, 0 in position. */
+} PilotFormation;
+
+
+/**
+ * @brief Results of the sensing pass done before the AI thinks.
+ *
+ * Only valid during the think phase of pilots_update() when threaded AI is
+ * enabled.
+ */
+typedef struct PilotSense_ {
+   int valid;           /**< Whether the results are valid for this frame. */
+   unsigned int enemy;  /**< Nearest enemy, 0 if none. */
+   double brakedist;    /**< Minimum braking distance. */
+} PilotSense;
+
+
+/**
+ * @brief Pilot values with the outfits whose effect doesn't depend on their
+ *  state, cached by pilot_calcStats() until the outfits change.
+ */
+typedef struct PilotOutfitStats_ {
+   int valid; /**< Whether or not the cache is up to date. */
+   ShipStats stats; /**< Ship stats with the outfits. */
+   ShipStats amount; /**< Number of outfits increasing each stat. */
+   double base_mass; /**< Ship mass plus core outfit mass. */
+   double mass_outfit; /**< Outfit mass without ammo. */
+   int cpu; /**< CPU used. */
+   double thrust_base; /**< Base thrust. */
+   double turn_base; /**< Base turn. */
+   double speed_base; /**< Base speed. */
+   double dmg_absorb; /**< Damage absorption. */
+   double armour_max; /**< Maximum armour. */
+   double armour_regen; /**< Armour regeneration. */
+   double shield_max; /**< Maximum shield. */
+   double shield_regen; /**< Shield regeneration. */
+   double energy_max; /**< Maximum energy. */
+   double energy_regen; /**< Energy regeneration. */
+   double energy_loss; /**< Energy loss. */
+   int fuel_max; /**< Maximum fuel. */
+   double cap_cargo; /**< Cargo capacity. */
+} PilotOutfitStats;
+
+
 /**
  * @brief The representation of an in-game pilot.
  */
@@ -215,6 +352,7 @@ typedef struct Pilot_ {
 
    unsigned int id;  /**< pilot's id, used for many functions */
    char* name;       /**< pilot's name (if unique) */
+   RNGStream rng;    /**< Pilot's own random numbers, used by the AI. */
 
    /* Fleet/faction management. */
    int faction;      /**< Pilot's faction. */
@@ -275,6 +413,8 @@ typedef struct Pilot_ {
    double ew_evasion; /**< Dynamic evasion factor. */
    double ew_detect; /**< Static detection factor. */
    double ew_jump_detect; /** Static jump detection factor */
+   int ew_player;    /**< Cached result of the player's pilot_inRangePilot() on this pilot. */
+   unsigned int ew_player_frame; /**< Sensor frame ew_player was computed in, see pilot_ewFrame(). */
 
    /* Heat. */
    double heat_T;    /**< Ship temperature. [K] */
@@ -289,6 +429,8 @@ typedef struct Pilot_ {
    /* Ship statistics. */
    ShipStats intrinsic_stats; /**< Intrinsic statistics to the ship create on the fly. */
    ShipStats stats;  /**< Pilot's copy of ship statistics. */
+   PilotOutfitStats outfit_stats; /**< Cached part of the stats, see pilot_calcStats(). */
+   PilotOutfitStats toggle_stats; /**< outfit_stats with the toggled outfits as of the last pilot_calcStats(). */
 
    /* Associated functions */
    void (*think)(struct Pilot_*, const double); /**< AI thinking for the pilot */
@@ -313,6 +455,8 @@ typedef struct Pilot_ {
 
    /* Weapon sets. */
    PilotWeaponSet weapon_sets[PILOT_WEAPON_SETS]; /**< All the weapon sets the pilot has. */
+   PilotFireControl firectl; /**< Cached intercept solutions. */
+   PilotTargeting targeting; /**< Cached geometry to the target. */
    int active_set;   /**< Index of the currently active weapon set. */
    int autoweap;     /**< Automatically update weapon sets. */
    int aimLines;     /**< Activate aiming helper lines. */
@@ -323,11 +467,14 @@ typedef struct Pilot_ {
    int cargo_free;   /**< Free commodity space. */
 
    /* Hook attached to the pilot */
-   PilotHook *hooks; /**< Array (array.h): Pilot hooks. */
+   PilotHook *hooks; /**< Array (array.h): Pilot hooks, sorted by type. */
+   unsigned int hookmask; /**< Types of hooks the pilot has (PILOT_HOOK_BIT). */
 
    /* Escort stuff. */
    unsigned int parent; /**< Pilot's parent. */
    Escort_t *escorts; /**< Array (array.h): Pilot's escorts. */
+   PilotOrder order; /**< Last order given to the escorts. */
+   PilotFormation formation; /**< Position in the formation of the parent. */
    unsigned int dockpilot; /**< Pilot's dock pilot (the pilot it originates from). This is
                           separate from parent because it needs to be set in sync with
                           dockslot (below). Used to unset dockslot when the dock pilot
@@ -347,8 +494,14 @@ typedef struct Pilot_ {
    double timer[MAX_AI_TIMERS]; /**< timers for AI */
    Task* task;       /**< current action */
    unsigned int shoot_indicator; /**< Indicator to inform the AI if a seeker has been shot recently. */
+   PilotSense sense; /**< Precomputed sensing for the AI. */
+   int ai_lod;       /**< AI level of detail, set by the scheduler in ai_think(). */
+   int ai_lodwait;   /**< Frames since the AI last ran under reduced detail. */
+   double update_dt; /**< Update time held back while far away pilots are updated at a reduced rate. */
 
    /* Misc */
+   double distress_timer; /**< Time before another distress signal about the same attacker is sent. */
+   unsigned int distress_attacker; /**< Attacker of the last distress signal. */
    double comm_msgTimer; /**< Message timer for the comm. */
    double comm_msgWidth; /**< Width of the message. */
    char *comm_msg;   /**< Comm message to display overhead. */
@@ -369,6 +522,8 @@ typedef struct Pilot_ {
    double player_damage; /**< Accumulates damage done by player for hostileness.
                               In per one of max shield + armour. */
    double engine_glow; /**< Amount of engine glow to display. */
+   CollPoly collpoly; /**< Collision polygon rotated from a keyframe, see pilot_collPoly(). */
+   int collpoly_k;   /**< Sprite collpoly was rotated for. */
    int messages;       /**< Queued messages (Lua ref). */
 } Pilot;
 
@@ -385,10 +540,13 @@ typedef struct Pilot_ {
  * getting pilot stuff
  */
 Pilot*const* pilot_getAll (void);
+void pilot_collideQuery( int **ids, double x1, double y1, double x2, double y2 );
+void pilot_collideQuerySegment( int **ids, double x1, double y1, double x2, double y2 );
 Pilot* pilot_get( const unsigned int id );
 unsigned int pilot_getNextID( const unsigned int id, int mode );
 unsigned int pilot_getPrevID( const unsigned int id, int mode );
 unsigned int pilot_getNearestEnemy( const Pilot* p );
+int pilot_getNearestEnemies( const Pilot* p, unsigned int *ids, double *dist2, int k );
 unsigned int pilot_getNearestEnemy_size( const Pilot* p, double target_mass_LB, double target_mass_UB );
 unsigned int pilot_getNearestEnemy_heuristic(const Pilot* p, double mass_factor, double health_factor, double damage_factor, double range_factor);
 unsigned int pilot_getNearestHostile (void); /* only for the player */
@@ -416,10 +574,12 @@ void pilot_explode( double x, double y, double radius, const Damage *dmg, const
 double pilot_face( Pilot* p, const double dir );
 int pilot_brake( Pilot* p );
 double pilot_brakeDist( Pilot *p, Vector2d *pos );
+double pilot_minBrakeDist( const Pilot *p );
 int pilot_interceptPos( Pilot *p, double x, double y );
 void pilot_cooldown( Pilot *p );
 void pilot_cooldownEnd( Pilot *p, const char *reason );
 double pilot_aimAngle( Pilot *p, Pilot *target );
+PilotTargeting* pilot_getTargeting( Pilot *p, const Pilot *target );
 
 
 /* Outfits */
@@ -477,6 +637,8 @@ void pilot_setTurn( Pilot *p, double turn );
 void pilot_update( Pilot* pilot, double dt );
 void pilots_update( double dt );
 void pilots_render( double dt );
+void pilots_renderAhead( double t );
+void pilots_renderAheadEnd (void);
 void pilots_renderOverlay( double dt );
 void pilot_render( Pilot* pilot, const double dt );
 void pilot_renderOverlay( Pilot* p, const double dt );
@@ -507,7 +669,9 @@ char pilot_getFactionColourChar( const Pilot *p );
  * Misc details.
  */
 credits_t pilot_worth( const Pilot *p );
+const CollPoly* pilot_collPoly( Pilot *p );
 void pilot_msg(Pilot *p, Pilot *receiver, const char *type, unsigned int index);
+void pilot_order( Pilot *p, const char *type, unsigned int target, int jump );
 void pilot_sample_trails( Pilot* p, int none );
 
 
@@ -24,6 +24,8 @@
 
 static double sensor_curRange    = 0.; /**< Current base sensor range, used to calculate
                                          what is in range and what isn't. */
+static unsigned int ew_frame     = 1; /**< Current sensor frame, cached results from
+                                         other frames are stale. */
 
 #define EVASION_SCALE        1.3225 /**< 1.15 squared. Ensures that ships have higher evasion than hide. */
 #define SENSOR_DEFAULT_RANGE 7500   /**< The default sensor range for all ships. */
@@ -134,6 +136,19 @@ void pilot_updateSensorRange (void)
 }
 
 
+/**
+ * @brief Starts a new sensor frame, invalidating the cached player sensor results.
+ *
+ * Should be called whenever pilots have moved.
+ */
+void pilot_ewFrame (void)
+{
+   ew_frame++;
+   if (ew_frame == 0) /* Zero is never valid so cleared pilots don't match. */
+      ew_frame = 1;
+}
+
+
 /**
  * @brief Returns the default sensor range for the current system.
  *
@@ -179,6 +194,14 @@ int pilot_inRange( const Pilot *p, double x, double y )
 int pilot_inRangePilot( const Pilot *p, const Pilot *target, double *dist2)
 {
    double d, sense;
+   int ret, cache;
+   Pilot *t;
+
+   /* The player's view of the other pilots gets queried by the radar, the
+    * GUI, targeting and the AI many times per frame, so it is cached. */
+   cache = pilot_isPlayer(p) && (dist2 == NULL);
+   if (cache && (target->ew_player_frame == ew_frame))
+      return target->ew_player;
 
    /* Get distance if needed. */
    if (dist2 != NULL) {
@@ -190,19 +213,29 @@ int pilot_inRangePilot( const Pilot *p, const Pilot *target, double *dist2)
    if ((pilot_isPlayer(p) && pilot_isFlag(target, PILOT_VISPLAYER)) ||
          pilot_isFlag(target, PILOT_VISIBLE) ||
          target->parent == p->id)
-      return 1;
-
-   /* Get distance if still needed */
-   if (dist2 == NULL)
-      d = vect_dist2( &p->solid->pos, &target->solid->pos );
+      ret = 1;
+   else {
+      /* Get distance if still needed */
+      if (dist2 == NULL)
+         d = vect_dist2( &p->solid->pos, &target->solid->pos );
+
+      sense = sensor_curRange * p->ew_detect;
+      if (d * target->ew_evasion < sense)
+         ret = 1;
+      else if  (d * target->ew_hide < sense)
+         ret = -1;
+      else
+         ret = 0;
+   }
 
-   sense = sensor_curRange * p->ew_detect;
-   if (d * target->ew_evasion < sense)
-      return 1;
-   else if  (d * target->ew_hide < sense)
-      return -1;
+   /* Only the cache gets modified, the pilot is otherwise untouched. */
+   if (cache) {
+      t = (Pilot*) target;
+      t->ew_player       = ret;
+      t->ew_player_frame = ew_frame;
+   }
 
-   return 0;
+   return ret;
 }
 
 
@@ -22,6 +22,9 @@
 #include "log.h"
 
 
+#define HEAT_SETTLE  1e-3 /**< Temperature difference under which bodies are considered in equilibrium. [K] */
+
+
 /**
  * @brief Calculates the heat parameters for a pilot.
  *
@@ -169,6 +172,10 @@ void pilot_heatAddSlotTime( Pilot *p, PilotOutfitSlot *o, double dt )
  *
  * Slots are connected only with the chassis.
  *
+ * Once the slot is close enough to the chassis temperature the remaining heat
+ *  is moved in one go so they settle at exactly the same temperature, after
+ *  which there is nothing left to compute.
+ *
  *    @param p Pilot to update.
  *    @param o Outfit slot to update.
  *    @param dt Delta tick.
@@ -176,10 +183,22 @@ void pilot_heatAddSlotTime( Pilot *p, PilotOutfitSlot *o, double dt )
  */
 double pilot_heatUpdateSlot( Pilot *p, PilotOutfitSlot *o, double dt )
 {
-   double Q;
+   double Q, dT;
+
+   /* In equilibrium or not in contact with the chassis. */
+   dT = o->heat_T - p->heat_T;
+   if ((dT == 0.) || (o->heat_area <= 0.))
+      return 0.;
+
+   /* Settle. */
+   if (FABS(dT) < HEAT_SETTLE) {
+      Q           = -dT * o->heat_C;
+      o->heat_T   = p->heat_T;
+      return Q;
+   }
 
    /* Calculate energy leaving/entering ship chassis. */
-   Q           = -p->heat_cond * (o->heat_T - p->heat_T) * o->heat_area * dt;
+   Q           = -p->heat_cond * dT * o->heat_area * dt;
 
    /* Update current temperature. */
    o->heat_T  += Q / o->heat_C;
@@ -206,6 +225,9 @@ double pilot_heatUpdateSlot( Pilot *p, PilotOutfitSlot *o, double dt )
  *  T being body temperature
  *  To being "space temperature"
  *
+ * Like the slots, the ship settles at exactly the star temperature once close
+ *  enough and nothing is being conducted.
+ *
  *    @param p Pilot to update.
  *    @param Q_cond Heat energy moved from slots.
  *    @param dt Delta tick.
@@ -214,9 +236,19 @@ void pilot_heatUpdateShip( Pilot *p, double Q_cond, double dt )
 {
    double Q, Q_rad;
 
+   /* In equilibrium. */
+   if (Q_cond == 0.) {
+      if (p->heat_T == CONST_SPACE_STAR_TEMP)
+         return;
+      if (FABS(p->heat_T - CONST_SPACE_STAR_TEMP) < HEAT_SETTLE) {
+         p->heat_T = CONST_SPACE_STAR_TEMP;
+         return;
+      }
+   }
+
    /* Calculate radiation. */
    Q_rad       = CONST_STEFAN_BOLTZMANN * p->heat_area * p->heat_emis *
-         (CONST_SPACE_STAR_TEMP_4 - pow(p->heat_T,4.)) * dt;
+         (CONST_SPACE_STAR_TEMP_4 - pow2(pow2(p->heat_T))) * dt;
 
    /* Total heat movement. */
    Q           = Q_rad - Q_cond;
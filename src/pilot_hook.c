@@ -27,10 +27,112 @@
 #include "nxml.h"
 
 
-static PilotHook *pilot_globalHooks = NULL; /**< Global hooks that affect all pilots. */
+static PilotHook *pilot_globalHooks = NULL; /**< Global hooks that affect all pilots, sorted by type. */
+static unsigned int pilot_globalHookMask = 0; /**< Types of global hooks there are. */
 static int pilot_hookCleanup = 0; /**< Are hooks being removed from a pilot? */
 
 
+/*
+ * Prototypes.
+ */
+static void pilot_hookInsert( PilotHook **hooks, int type, unsigned int hook );
+static int pilot_hookFirst( const PilotHook *hooks, int type );
+static unsigned int pilot_hookMask( const PilotHook *hooks );
+static int pilot_hookRunList( Pilot *p, PilotHook *const*hooks, int hook_type,
+      HookParam *hparam );
+
+
+/**
+ * @brief Adds a hook to a list, keeping the hooks of the same type together.
+ *
+ *    @param hooks List to add to (array.h).
+ *    @param type Type of the hook.
+ *    @param hook ID of the hook.
+ */
+static void pilot_hookInsert( PilotHook **hooks, int type, unsigned int hook )
+{
+   int i, n;
+
+   if (*hooks == NULL)
+      *hooks = array_create( PilotHook );
+
+   /* Goes after the hooks of the same type, so they run in creation order. */
+   n = array_size(*hooks);
+   for (i=n; i>0; i--)
+      if ((*hooks)[i-1].type <= type)
+         break;
+   array_grow( hooks );
+   memmove( &(*hooks)[i+1], &(*hooks)[i], sizeof(PilotHook) * (n-i) );
+   (*hooks)[i].type = type;
+   (*hooks)[i].id   = hook;
+}
+
+
+/**
+ * @brief Finds the first hook of a type in a list.
+ *
+ *    @param hooks List of hooks (array.h), sorted by type.
+ *    @param type Type to look for.
+ *    @return Index of the first hook of the type or of the next type.
+ */
+static int pilot_hookFirst( const PilotHook *hooks, int type )
+{
+   int l, h, m;
+
+   l = 0;
+   h = array_size(hooks);
+   while (l < h) {
+      m = (l+h) / 2;
+      if (hooks[m].type < type)
+         l = m+1;
+      else
+         h = m;
+   }
+   return l;
+}
+
+
+/**
+ * @brief Gets the mask of the types of hooks in a list.
+ */
+static unsigned int pilot_hookMask( const PilotHook *hooks )
+{
+   int i;
+   unsigned int mask = 0;
+   for (i=0; i<array_size(hooks); i++)
+      mask |= PILOT_HOOK_BIT( hooks[i].type );
+   return mask;
+}
+
+
+/**
+ * @brief Runs the hooks of a type in a list.
+ *
+ * The hooks can add or remove hooks, so the list is read again each time.
+ *
+ *    @param p Pilot running the hooks.
+ *    @param hooks List of hooks (array.h), sorted by type.
+ *    @param hook_type Type of hook to run.
+ *    @param hparam Parameters to pass.
+ *    @return The number of hooks run.
+ */
+static int pilot_hookRunList( Pilot *p, PilotHook *const*hooks, int hook_type,
+      HookParam *hparam )
+{
+   int i, run;
+
+   run = 0;
+   for (i=pilot_hookFirst( *hooks, hook_type );
+         (i<array_size(*hooks)) && ((*hooks)[i].type == hook_type); i++) {
+      if (hook_runIDparam( (*hooks)[i].id, hparam ))
+         WARN(_("Pilot '%s' failed to run hook type %d"), p->name, hook_type);
+      else
+         run++;
+   }
+   return run;
+}
+
+
 /**
  * @brief Tries to run a pilot hook if he has it.
  *
@@ -42,9 +144,13 @@ static int pilot_hookCleanup = 0; /**< Are hooks being removed from a pilot? */
  */
 int pilot_runHookParam( Pilot* p, int hook_type, HookParam* param, int nparam )
 {
-   int n, i, run, ret;
+   int n, run;
    HookParam hstaparam[5], *hdynparam, *hparam;
 
+   /* Most of the time there is no hook at all. */
+   if (!((p->hookmask | pilot_globalHookMask) & PILOT_HOOK_BIT(hook_type)))
+      return 0;
+
    /* Set up hook parameters. */
    if (nparam <= 3) {
       hstaparam[0].type       = HOOK_PARAM_PILOT;
@@ -68,28 +174,12 @@ int pilot_runHookParam( Pilot* p, int hook_type, HookParam* param, int nparam )
 
    /* Run pilot specific hooks. */
    run = 0;
-   for (i=0; i<array_size(p->hooks); i++) {
-      if (p->hooks[i].type != hook_type)
-         continue;
-
-      ret = hook_runIDparam( p->hooks[i].id, hparam );
-      if (ret)
-         WARN(_("Pilot '%s' failed to run hook type %d"), p->name, hook_type);
-      else
-         run++;
-   }
+   if (p->hookmask & PILOT_HOOK_BIT(hook_type))
+      run += pilot_hookRunList( p, &p->hooks, hook_type, hparam );
 
    /* Run global hooks. */
-   for (i=0; i<array_size(pilot_globalHooks); i++) {
-      if (pilot_globalHooks[i].type != hook_type)
-         continue;
-
-      ret = hook_runIDparam( pilot_globalHooks[i].id, hparam );
-      if (ret)
-         WARN(_("Pilot '%s' failed to run hook type %d"), p->name, hook_type);
-      else
-         run++;
-   }
+   if (pilot_globalHookMask & PILOT_HOOK_BIT(hook_type))
+      run += pilot_hookRunList( p, &pilot_globalHooks, hook_type, hparam );
 
    /* Clean up. */
    free( hdynparam );
@@ -123,16 +213,8 @@ int pilot_runHook( Pilot* p, int hook_type )
  */
 void pilot_addHook( Pilot *pilot, int type, unsigned int hook )
 {
-   PilotHook *phook;
-
-   /* Allocate memory. */
-   if (pilot->hooks == NULL)
-      pilot->hooks = array_create( PilotHook );
-
-   /* Create the new hook. */
-   phook        = &array_grow( &pilot->hooks );
-   phook->type  = type;
-   phook->id    = hook;
+   pilot_hookInsert( &pilot->hooks, type, hook );
+   pilot->hookmask |= PILOT_HOOK_BIT(type);
 }
 
 
@@ -141,16 +223,8 @@ void pilot_addHook( Pilot *pilot, int type, unsigned int hook )
  */
 void pilots_addGlobalHook( int type, unsigned int hook )
 {
-   PilotHook *phook;
-
-   /* Allocate memory. */
-   if (pilot_globalHooks == NULL)
-      pilot_globalHooks = array_create( PilotHook );
-
-   /* Create the new hook. */
-   phook       = &array_grow( &pilot_globalHooks );
-   phook->type = type;
-   phook->id   = hook;
+   pilot_hookInsert( &pilot_globalHooks, type, hook );
+   pilot_globalHookMask |= PILOT_HOOK_BIT(type);
 }
 
 
@@ -164,6 +238,7 @@ void pilots_rmGlobalHook( unsigned int hook )
    for (i=0; i<array_size(pilot_globalHooks); i++) {
       if (pilot_globalHooks[i].id == hook) {
          array_erase( &pilot_globalHooks, &pilot_globalHooks[i], &pilot_globalHooks[i+1] );
+         pilot_globalHookMask = pilot_hookMask( pilot_globalHooks );
          return;
       }
    }
@@ -176,6 +251,7 @@ void pilots_rmGlobalHook( unsigned int hook )
 void pilots_clearGlobalHooks (void)
 {
    array_erase( &pilot_globalHooks, array_begin(pilot_globalHooks), array_end(pilot_globalHooks) );
+   pilot_globalHookMask = 0;
 }
 
 
@@ -199,6 +275,8 @@ void pilots_rmHook( unsigned int hook )
    plist = pilot_getAll();
    for (i=0; i<array_size(plist); i++) {
       p = plist[i];
+      if (p->hookmask == 0)
+         continue;
 
       for (j=0; j<array_size(p->hooks); j++) {
          /* Hook not found. */
@@ -208,6 +286,7 @@ void pilots_rmHook( unsigned int hook )
          array_erase( &p->hooks, &p->hooks[j], &p->hooks[j+1] );
          j--; /* Dun like it but we have to keep iterator safe. */
       }
+      p->hookmask = pilot_hookMask( p->hooks );
    }
 }
 
@@ -229,6 +308,7 @@ void pilot_clearHooks( Pilot *p )
 
    array_free(p->hooks);
    p->hooks  = NULL;
+   p->hookmask = 0;
 }
 
 
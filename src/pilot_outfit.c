@@ -32,10 +32,35 @@
 #include "nlua_pilotoutfit.h"
 
 
+static unsigned int pilot_outfitsGen = 0; /**< Bumped whenever equipped outfits change. */
+
+
+/**
+ * @brief Outfit whose Lua update runs once for all the pilots using it.
+ */
+typedef struct OutfitLuaBatch_ {
+   const Outfit *o;           /**< Outfit with an update_batch function. */
+   double interval;           /**< Time between updates. */
+   double timer;              /**< Time until the next update. */
+   int due;                   /**< Whether it gets updated this frame. */
+   unsigned int *pilots;      /**< IDs of the pilots of the instances (array.h). */
+   PilotOutfitSlot **slots;   /**< Instances of the outfit (array.h). */
+} OutfitLuaBatch;
+static OutfitLuaBatch *pilot_outfitBatch = NULL; /**< Batched outfits (array.h). */
+
+
 /*
  * Prototypes.
  */
 static int pilot_hasOutfitLimit( Pilot *p, const char *limit );
+static int pilot_outfitToggles( const PilotOutfitSlot *slot );
+static void pilot_calcOutfitStats( Pilot* pilot );
+static void pilot_calcToggleStats( Pilot* pilot );
+static void pilot_applyStats( Pilot* pilot );
+static void pilot_outfitLRecalc( Pilot *pilot );
+static void pilot_outfitLmem( PilotOutfitSlot *po );
+static void pilot_outfitLBatchInit (void);
+static OutfitLuaBatch *pilot_outfitLBatchGet( const Outfit *o );
 
 
 /**
@@ -44,13 +69,12 @@ static int pilot_hasOutfitLimit( Pilot *p, const char *limit );
  *    @param p Pilot being updated.
  *    @param o Slot being updated.
  *    @param t Pilot that is currently the target of p (or NULL if not applicable).
- *    @param a Angle to update if necessary. Should be initialized to -1 before the loop.
  *    @param dt Current delta tick.
  */
-void pilot_lockUpdateSlot( Pilot *p, PilotOutfitSlot *o, Pilot *t, double *a, double dt )
+void pilot_lockUpdateSlot( Pilot *p, PilotOutfitSlot *o, Pilot *t, double dt )
 {
    double max, old;
-   double x,y, ang, arc;
+   double arc;
    int locked;
 
    /* No target. */
@@ -65,16 +89,8 @@ void pilot_lockUpdateSlot( Pilot *p, PilotOutfitSlot *o, Pilot *t, double *a, do
    arc = o->outfit->u.lau.arc;
    if (arc > 0.) {
 
-      /* We use an external variable to set and update the angle if necessary. */
-      if (*a < 0.) {
-         x     = t->solid->pos.x - p->solid->pos.x;
-         y     = t->solid->pos.y - p->solid->pos.y;
-         ang   = ANGLE( x, y );
-         *a    = FABS( angle_diff( ang, p->solid->dir ) );
-      }
-
-      /* Decay if not in arc. */
-      if (*a > arc) {
+      /* Decay if not in arc, the geometry is shared by all the slots. */
+      if (pilot_getTargeting( p, t )->off > arc) {
          /* Limit decay to the lockon time for this launcher. */
          max = o->outfit->u.lau.lockon;
 
@@ -296,6 +312,7 @@ int pilot_addOutfitRaw( Pilot* pilot, Outfit* outfit, PilotOutfitSlot *s )
 
    /* Set the outfit. */
    s->outfit   = outfit;
+   pilot_outfitsChanged( pilot );
 
    /* Set some default parameters. */
    s->timer    = 0.;
@@ -428,6 +445,7 @@ int pilot_rmOutfitRaw( Pilot* pilot, PilotOutfitSlot *s )
    /* Remove the outfit. */
    ret         = (s->outfit==NULL);
    s->outfit   = NULL;
+   pilot_outfitsChanged( pilot );
 
    /* Remove secondary and such if necessary. */
    if (pilot->afterburner == s)
@@ -916,60 +934,52 @@ char* pilot_getOutfits( const Pilot* pilot )
 
 
 /**
- * @brief Recalculates the pilot's stats based on his outfits.
+ * @brief Checks to see if the effect of an outfit depends on its state.
+ */
+static int pilot_outfitToggles( const PilotOutfitSlot *slot )
+{
+   const Outfit *o = slot->outfit;
+   if (outfit_isAfterburner(o))
+      return 1;
+   return (slot->active && outfit_isMod(o));
+}
+
+
+/**
+ * @brief Computes the stats cache of a pilot from the outfits that don't
+ *  toggle.
  *
- *    @param pilot Pilot to recalculate his stats.
+ *    @param pilot Pilot to compute the cache of.
  */
-void pilot_calcStats( Pilot* pilot )
+static void pilot_calcOutfitStats( Pilot* pilot )
 {
    int i;
    Outfit* o;
    PilotOutfitSlot *slot;
-   double ac, sc, ec; /* temporary health coefficients to set */
-   ShipStats amount, *s, *default_s;
-
-   /*
-    * set up the basic stuff
-    */
-   /* mass */
-   pilot->solid->mass   = pilot->ship->mass;
-   pilot->base_mass     = pilot->solid->mass;
-   /* cpu */
-   pilot->cpu           = 0.;
-   /* movement */
-   pilot->thrust_base   = pilot->ship->thrust;
-   pilot->turn_base     = pilot->ship->turn;
-   pilot->speed_base    = pilot->ship->speed;
-   /* crew */
-   pilot->crew          = pilot->ship->crew;
-   /* cargo */
-   pilot->cap_cargo     = pilot->ship->cap_cargo;
-   /* fuel_consumption. */
-   pilot->fuel_consumption = pilot->ship->fuel_consumption;
-   /* health */
-   ac = (pilot->armour_max > 0.) ? pilot->armour / pilot->armour_max : 0.;
-   sc = (pilot->shield_max > 0.) ? pilot->shield / pilot->shield_max : 0.;
-   ec = (pilot->energy_max > 0.) ? pilot->energy / pilot->energy_max : 0.;
-   pilot->armour_max    = pilot->ship->armour;
-   pilot->shield_max    = pilot->ship->shield;
-   pilot->fuel_max      = pilot->ship->fuel;
-   pilot->armour_regen  = pilot->ship->armour_regen;
-   pilot->shield_regen  = pilot->ship->shield_regen;
-   /* Absorption. */
-   pilot->dmg_absorb    = pilot->ship->dmg_absorb;
-   /* Energy. */
-   pilot->energy_max    = pilot->ship->energy;
-   pilot->energy_regen  = pilot->ship->energy_regen;
-   pilot->energy_loss   = 0.; /* Initially no net loss. */
-   /* Stats. */
-   s = &pilot->stats;
-   *s = pilot->ship->stats_array;
-   memset( &amount, 0, sizeof(ShipStats) );
+   PilotOutfitStats *c;
+
+   c = &pilot->outfit_stats;
+
+   /* Start from the ship. */
+   c->base_mass      = pilot->ship->mass;
+   c->mass_outfit    = 0.;
+   c->cpu            = 0;
+   c->thrust_base    = pilot->ship->thrust;
+   c->turn_base      = pilot->ship->turn;
+   c->speed_base     = pilot->ship->speed;
+   c->cap_cargo      = pilot->ship->cap_cargo;
+   c->armour_max     = pilot->ship->armour;
+   c->shield_max     = pilot->ship->shield;
+   c->fuel_max       = pilot->ship->fuel;
+   c->armour_regen   = pilot->ship->armour_regen;
+   c->shield_regen   = pilot->ship->shield_regen;
+   c->dmg_absorb     = pilot->ship->dmg_absorb;
+   c->energy_max     = pilot->ship->energy;
+   c->energy_regen   = pilot->ship->energy_regen;
+   c->energy_loss    = 0.; /* Initially no net loss. */
+   c->stats          = pilot->ship->stats_array;
+   memset( &c->amount, 0, sizeof(ShipStats) );
 
-   /*
-    * Now add outfit changes
-    */
-   pilot->mass_outfit   = 0.;
    for (i=0; i<array_size(pilot->outfits); i++) {
       slot = pilot->outfits[i];
       o    = slot->outfit;
@@ -979,69 +989,248 @@ void pilot_calcStats( Pilot* pilot )
          continue;
 
       /* Modify CPU. */
-      pilot->cpu           += outfit_cpu(o);
+      c->cpu         += outfit_cpu(o);
 
       /* Add mass. */
-      pilot->mass_outfit   += o->mass;
+      c->mass_outfit += o->mass;
 
       /* Keep a separate counter for required (core) outfits. */
       if (sp_required( o->slot.spid ))
-         pilot->base_mass += o->mass;
+         c->base_mass += o->mass;
+
+      /* Outfits that toggle are added each time. */
+      if (pilot_outfitToggles( slot ))
+         continue;
+
+      /* TODO these mods should probably be all moved into shipstats. */
+      if (outfit_isMod(o)) { /* Modification */
+         /* Add stats. */
+         ss_statsModFromList( &c->stats, o->stats, &c->amount );
+         /* Movement. */
+         c->thrust_base    += o->u.mod.thrust;
+         c->turn_base      += o->u.mod.turn;
+         c->speed_base     += o->u.mod.speed;
+         /* Health. */
+         c->dmg_absorb     += o->u.mod.absorb;
+         c->armour_max     += o->u.mod.armour;
+         c->armour_regen   += o->u.mod.armour_regen;
+         c->shield_max     += o->u.mod.shield;
+         c->shield_regen   += o->u.mod.shield_regen;
+         c->energy_max     += o->u.mod.energy;
+         c->energy_regen   += o->u.mod.energy_regen;
+         c->energy_loss    += o->u.mod.energy_loss;
+         /* Fuel. */
+         c->fuel_max       += o->u.mod.fuel;
+         /* Misc. */
+         c->cap_cargo      += o->u.mod.cargo;
+      }
+      else {
+         /* Always add stats for non mod/afterburners. */
+         ss_statsModFromList( &c->stats, o->stats, &c->amount );
+      }
+   }
+
+   c->valid = 1;
+}
+
+
+/**
+ * @brief Marks the outfits of a pilot as changed for pilot_calcStats().
+ *
+ * Only needed when changing which outfits are equipped, toggling outfits,
+ *  ammo, cargo and Lua stats are always taken into account.
+ *
+ *    @param pilot Pilot whose outfits changed.
+ */
+void pilot_outfitsChanged( Pilot* pilot )
+{
+   pilot->outfit_stats.valid = 0;
+   pilot->toggle_stats.valid = 0;
+   pilot_outfitsGen++;
+}
+
+
+/**
+ * @brief Gets a counter that changes whenever any pilot's equipped outfits change.
+ *
+ * Lets caches of equipped outfits tell when they have to be rebuilt.
+ *
+ *    @return The current outfit generation.
+ */
+unsigned int pilot_outfitsGeneration (void)
+{
+   return pilot_outfitsGen;
+}
+
+
+/**
+ * @brief Adds the toggled outfits to the cached outfit stats.
+ *
+ * The result is kept in toggle_stats so pilot_calcLuaStats() can skip it.
+ *
+ *    @param pilot Pilot to calculate the toggled outfit stats of.
+ */
+static void pilot_calcToggleStats( Pilot* pilot )
+{
+   int i;
+   Outfit* o;
+   PilotOutfitSlot *slot;
+   PilotOutfitStats *t;
+
+   if (!pilot->outfit_stats.valid)
+      pilot_calcOutfitStats( pilot );
+   t  = &pilot->toggle_stats;
+   *t = pilot->outfit_stats;
+
+   for (i=0; i<array_size(pilot->outfits); i++) {
+      slot = pilot->outfits[i];
+      o    = slot->outfit;
+
+      /* Outfit must exist. */
+      if (o==NULL)
+         continue;
 
       /* Add ammo mass. */
       if (outfit_ammo(o) != NULL)
          if (slot->u.ammo.outfit != NULL)
-            pilot->mass_outfit += slot->u.ammo.quantity * slot->u.ammo.outfit->mass;
+            t->mass_outfit += slot->u.ammo.quantity * slot->u.ammo.outfit->mass;
 
       if (outfit_isAfterburner(o)) /* Afterburner */
          pilot->afterburner = pilot->outfits[i]; /* Set afterburner */
 
-      /* Lua mods apply their stats. */
-      if (slot->lua_mem != LUA_NOREF)
-         ss_statsMerge( &pilot->stats, &slot->lua_stats );
+      /* The rest is cached. */
+      if (!pilot_outfitToggles( slot ))
+         continue;
 
+      /* Active outfits must be on to affect stuff. */
+      if (slot->active && !(slot->state==PILOT_OUTFIT_ON))
+         continue;
 
-      /* TODO these mods should probably be all moved into shipstats. */
       if (outfit_isMod(o)) { /* Modification */
-         /* Active outfits must be on to affect stuff. */
-         if (slot->active && !(slot->state==PILOT_OUTFIT_ON))
-            continue;
          /* Add stats. */
-         ss_statsModFromList( s, o->stats, &amount );
+         ss_statsModFromList( &t->stats, o->stats, &t->amount );
          /* Movement. */
-         pilot->thrust_base   += o->u.mod.thrust;
-         pilot->turn_base     += o->u.mod.turn;
-         pilot->speed_base    += o->u.mod.speed;
+         t->thrust_base    += o->u.mod.thrust;
+         t->turn_base      += o->u.mod.turn;
+         t->speed_base     += o->u.mod.speed;
          /* Health. */
-         pilot->dmg_absorb    += o->u.mod.absorb;
-         pilot->armour_max    += o->u.mod.armour;
-         pilot->armour_regen  += o->u.mod.armour_regen;
-         pilot->shield_max    += o->u.mod.shield;
-         pilot->shield_regen  += o->u.mod.shield_regen;
-         pilot->energy_max    += o->u.mod.energy;
-         pilot->energy_regen  += o->u.mod.energy_regen;
-         pilot->energy_loss   += o->u.mod.energy_loss;
+         t->dmg_absorb     += o->u.mod.absorb;
+         t->armour_max     += o->u.mod.armour;
+         t->armour_regen   += o->u.mod.armour_regen;
+         t->shield_max     += o->u.mod.shield;
+         t->shield_regen   += o->u.mod.shield_regen;
+         t->energy_max     += o->u.mod.energy;
+         t->energy_regen   += o->u.mod.energy_regen;
+         t->energy_loss    += o->u.mod.energy_loss;
          /* Fuel. */
-         pilot->fuel_max      += o->u.mod.fuel;
+         t->fuel_max       += o->u.mod.fuel;
          /* Misc. */
-         pilot->cap_cargo     += o->u.mod.cargo;
-
+         t->cap_cargo      += o->u.mod.cargo;
       }
-      else if (outfit_isAfterburner(o)) { /* Afterburner */
-         /* Active outfits must be on to affect stuff. */
-         if (slot->active && !(slot->state==PILOT_OUTFIT_ON))
-            continue;
+      else { /* Afterburner */
          /* Add stats. */
-         ss_statsModFromList( s, o->stats, &amount );
+         ss_statsModFromList( &t->stats, o->stats, &t->amount );
          pilot_setFlag( pilot, PILOT_AFTERBURNER ); /* We use old school flags for this still... */
-         pilot->energy_loss += pilot->afterburner->outfit->u.afb.energy; /* energy loss */
-      }
-      else {
-         /* Always add stats for non mod/afterburners. */
-         ss_statsModFromList( s, o->stats, &amount );
+         t->energy_loss += pilot->afterburner->outfit->u.afb.energy; /* energy loss */
       }
    }
 
+   t->valid = 1;
+}
+
+
+/**
+ * @brief Recalculates the pilot's stats based on his outfits.
+ *
+ * The outfits that don't toggle are summed once and cached until
+ *  pilot_outfitsChanged() is called, so toggling outfits only goes over the
+ *  ones that do.
+ *
+ *    @param pilot Pilot to recalculate his stats.
+ */
+void pilot_calcStats( Pilot* pilot )
+{
+   pilot_calcToggleStats( pilot );
+   pilot_applyStats( pilot );
+}
+
+
+/**
+ * @brief Recalculates the pilot's stats when only the Lua stats changed.
+ *
+ * Reuses the outfit stats of the last pilot_calcStats() and only applies the
+ *  Lua stats and what depends on them again.
+ *
+ *    @param pilot Pilot to recalculate his stats.
+ */
+void pilot_calcLuaStats( Pilot* pilot )
+{
+   if (!pilot->toggle_stats.valid)
+      pilot_calcToggleStats( pilot );
+   pilot_applyStats( pilot );
+}
+
+
+/**
+ * @brief Applies the outfit stats to the pilot, along with the Lua and intrinsic stats.
+ *
+ *    @param pilot Pilot to apply the stats to.
+ */
+static void pilot_applyStats( Pilot* pilot )
+{
+   int i;
+   PilotOutfitSlot *slot;
+   double ac, sc, ec; /* temporary health coefficients to set */
+   ShipStats amount, *s, *default_s;
+   const PilotOutfitStats *c;
+
+   /*
+    * set up the basic stuff
+    */
+   c = &pilot->toggle_stats;
+   /* mass */
+   pilot->solid->mass   = pilot->ship->mass;
+   pilot->base_mass     = c->base_mass;
+   pilot->mass_outfit   = c->mass_outfit;
+   /* cpu */
+   pilot->cpu           = c->cpu;
+   /* movement */
+   pilot->thrust_base   = c->thrust_base;
+   pilot->turn_base     = c->turn_base;
+   pilot->speed_base    = c->speed_base;
+   /* crew */
+   pilot->crew          = pilot->ship->crew;
+   /* cargo */
+   pilot->cap_cargo     = c->cap_cargo;
+   /* fuel_consumption. */
+   pilot->fuel_consumption = pilot->ship->fuel_consumption;
+   /* health */
+   ac = (pilot->armour_max > 0.) ? pilot->armour / pilot->armour_max : 0.;
+   sc = (pilot->shield_max > 0.) ? pilot->shield / pilot->shield_max : 0.;
+   ec = (pilot->energy_max > 0.) ? pilot->energy / pilot->energy_max : 0.;
+   pilot->armour_max    = c->armour_max;
+   pilot->shield_max    = c->shield_max;
+   pilot->fuel_max      = c->fuel_max;
+   pilot->armour_regen  = c->armour_regen;
+   pilot->shield_regen  = c->shield_regen;
+   /* Absorption. */
+   pilot->dmg_absorb    = c->dmg_absorb;
+   /* Energy. */
+   pilot->energy_max    = c->energy_max;
+   pilot->energy_regen  = c->energy_regen;
+   pilot->energy_loss   = c->energy_loss;
+   /* Stats. */
+   s = &pilot->stats;
+   *s = c->stats;
+   amount = c->amount;
+
+   /* Lua mods apply their stats. */
+   for (i=0; i<array_size(pilot->outfits); i++) {
+      slot = pilot->outfits[i];
+      if ((slot->outfit != NULL) && (slot->lua_mem != LUA_NOREF))
+         ss_statsMerge( &pilot->stats, &slot->lua_stats );
+   }
+
    if (!pilot_isFlag( pilot, PILOT_AFTERBURNER ))
       pilot->solid->speed_max = pilot->speed;
 
@@ -1239,8 +1428,39 @@ void pilot_outfitLInitAll( Pilot *pilot )
    for (i=0; i<array_size(pilot->outfits); i++)
       pilot_outfitLInit( pilot, pilot->outfits[i] );
    /* Recalculate if anything changed. */
-   if (pilotoutfit_modified)
+   pilot_outfitLRecalc( pilot );
+}
+
+
+/**
+ * @brief Recalculates the stats of a pilot after running Lua outfit scripts.
+ *
+ * Outfit state changes need the full pilot_calcStats(), while changes to the
+ *  Lua stats only have to apply those again.
+ *
+ *    @param pilot Pilot whose outfits were run.
+ */
+static void pilot_outfitLRecalc( Pilot *pilot )
+{
+   if (pilotoutfit_modified & PILOTOUTFIT_MODIFIED_STATE)
       pilot_calcStats( pilot );
+   else if (pilotoutfit_modified & PILOTOUTFIT_MODIFIED_STATS)
+      pilot_calcLuaStats( pilot );
+}
+
+
+/**
+ * @brief Creates the Lua memory of a pilot outfit if necessary, initializing its stats.
+ *
+ *    @param po Pilot outfit to create memory for.
+ */
+static void pilot_outfitLmem( PilotOutfitSlot *po )
+{
+   if (po->lua_mem != LUA_NOREF)
+      return;
+   ss_statsInit( &po->lua_stats );
+   lua_newtable(naevL); /* mem */
+   po->lua_mem = luaL_ref(naevL,LUA_REGISTRYINDEX); /* */
 }
 
 
@@ -1259,11 +1479,7 @@ int pilot_outfitLInit( Pilot *pilot, PilotOutfitSlot *po )
       return 0;
 
    /* Create the memory if necessary and initialize stats. */
-   if (po->lua_mem == LUA_NOREF) {
-      ss_statsInit( &po->lua_stats );
-      lua_newtable(naevL); /* mem */
-      po->lua_mem = luaL_ref(naevL,LUA_REGISTRYINDEX); /* */
-   }
+   pilot_outfitLmem( po );
    /* Set the memory. */
    lua_rawgeti(naevL, LUA_REGISTRYINDEX, po->lua_mem); /* mem */
    nlua_setenv(po->outfit->u.mod.lua_env, "mem"); /* */
@@ -1298,6 +1514,9 @@ void pilot_outfitLUpdate( Pilot *pilot, double dt )
          continue;
       if (po->outfit->u.mod.lua_update == LUA_NOREF)
          continue;
+      /* Updated by pilot_outfitLUpdateBatch() instead. */
+      if (po->outfit->u.mod.lua_update_batch != LUA_NOREF)
+         continue;
 
       nlua_env env = po->outfit->u.mod.lua_env;
 
@@ -1316,8 +1535,172 @@ void pilot_outfitLUpdate( Pilot *pilot, double dt )
       }
    }
    /* Recalculate if anything changed. */
-   if (pilotoutfit_modified)
-      pilot_calcStats( pilot );
+   pilot_outfitLRecalc( pilot );
+}
+
+
+/**
+ * @brief Finds the outfits with batched Lua updates.
+ */
+static void pilot_outfitLBatchInit (void)
+{
+   int i;
+   const Outfit *outfits;
+   OutfitLuaBatch *b;
+
+   pilot_outfitBatch = array_create( OutfitLuaBatch );
+   outfits = outfit_getAll();
+   for (i=0; i<array_size(outfits); i++) {
+      if (!outfit_isMod(&outfits[i]) ||
+            (outfits[i].u.mod.lua_update_batch == LUA_NOREF))
+         continue;
+      b = &array_grow( &pilot_outfitBatch );
+      b->o        = &outfits[i];
+      b->interval = (b->o->u.mod.lua_update_dt > 0.) ?
+            b->o->u.mod.lua_update_dt : PILOT_OUTFIT_LUA_UPDATE_DT;
+      b->timer    = 0.;
+      b->due      = 0;
+      b->pilots   = array_create( unsigned int );
+      b->slots    = array_create( PilotOutfitSlot* );
+   }
+}
+
+
+/**
+ * @brief Gets the batch of an outfit.
+ *
+ *    @param o Outfit to get the batch of.
+ *    @return The batch of the outfit or NULL if it isn't batched.
+ */
+static OutfitLuaBatch *pilot_outfitLBatchGet( const Outfit *o )
+{
+   int i;
+   /* Only a handful of outfits are batched. */
+   for (i=0; i<array_size(pilot_outfitBatch); i++)
+      if (pilot_outfitBatch[i].o == o)
+         return &pilot_outfitBatch[i];
+   return NULL;
+}
+
+
+/**
+ * @brief Runs the batched Lua outfit update scripts.
+ *
+ * Outfits defining update_batch( plts, pos, mems, dt ) get a single call with
+ *  all the pilots, pilot outfits and memories of their instances instead of
+ *  calling update( p, po, dt ) for each of them. This saves switching
+ *  environments and calling into Lua for every pilot. They are run every
+ *  update_dt seconds if the outfit defines it, otherwise every
+ *  PILOT_OUTFIT_LUA_UPDATE_DT seconds, and dt is the time between runs.
+ *
+ *    @param dt Current delta tick.
+ */
+void pilot_outfitLUpdateBatch( double dt )
+{
+   int i, j, k, n, due;
+   Pilot *const *pilots, *p;
+   PilotOutfitSlot *po;
+   OutfitLuaBatch *b;
+   nlua_env env;
+   unsigned int last;
+
+   if (pilot_outfitBatch == NULL)
+      pilot_outfitLBatchInit();
+
+   /* Advance the timers, nothing to do if no batch is due. */
+   due = 0;
+   for (i=0; i<array_size(pilot_outfitBatch); i++) {
+      b = &pilot_outfitBatch[i];
+      b->timer -= dt;
+      b->due    = (b->timer <= 0.);
+      if (b->due) {
+         b->timer = MAX( b->timer + b->interval, 0. );
+         due = 1;
+      }
+      array_resize( &b->pilots, 0 );
+      array_resize( &b->slots, 0 );
+   }
+   if (!due)
+      return;
+
+   /* Gather the instances. */
+   pilots = pilot_getAll();
+   for (i=0; i<array_size(pilots); i++) {
+      p = pilots[i];
+      if (pilot_isFlag(p, PILOT_DELETE) || pilot_isFlag(p, PILOT_HIDE) ||
+            pilot_isFlag(p, PILOT_DEAD))
+         continue;
+      for (j=0; j<array_size(p->outfits); j++) {
+         po = p->outfits[j];
+         if (po->outfit==NULL || !outfit_isMod(po->outfit))
+            continue;
+         if (po->outfit->u.mod.lua_update_batch == LUA_NOREF)
+            continue;
+         b = pilot_outfitLBatchGet( po->outfit );
+         if ((b == NULL) || !b->due)
+            continue;
+         array_push_back( &b->pilots, p->id );
+         array_push_back( &b->slots, po );
+      }
+   }
+
+   for (i=0; i<array_size(pilot_outfitBatch); i++) {
+      b = &pilot_outfitBatch[i];
+      n = array_size(b->slots);
+      if (n == 0)
+         continue;
+      env = b->o->u.mod.lua_env;
+
+      /* Set up the function: update_batch( plts, pos, mems, dt ) */
+      lua_rawgeti(naevL, LUA_REGISTRYINDEX, b->o->u.mod.lua_update_batch); /* f */
+      lua_createtable(naevL, n, 0); /* f, plts */
+      lua_createtable(naevL, n, 0); /* f, plts, pos */
+      lua_createtable(naevL, n, 0); /* f, plts, pos, mems */
+      for (k=0; k<n; k++) {
+         po = b->slots[k];
+         pilot_outfitLmem( po );
+         lua_pushpilot(naevL, b->pilots[k]); /* f, plts, pos, mems, p */
+         lua_rawseti(naevL, -4, k+1); /* f, plts, pos, mems */
+         lua_pushpilotoutfit(naevL, po); /* f, plts, pos, mems, po */
+         lua_rawseti(naevL, -3, k+1); /* f, plts, pos, mems */
+         lua_rawgeti(naevL, LUA_REGISTRYINDEX, po->lua_mem); /* f, plts, pos, mems, mem */
+         lua_rawseti(naevL, -2, k+1); /* f, plts, pos, mems */
+      }
+      lua_pushnumber(naevL, MAX( dt, b->interval )); /* f, plts, pos, mems, dt */
+      pilotoutfit_modified = 0;
+      if (nlua_pcall( env, 4, 0 )) { /* */
+         WARN( _("Outfit '%s' -> 'update_batch':\n%s"), b->o->name, lua_tostring(naevL,-1));
+         lua_pop(naevL, 1);
+      }
+
+      /* Recalculate the pilots if anything changed, instances of a pilot are together. */
+      if (!pilotoutfit_modified)
+         continue;
+      last = 0;
+      for (k=0; k<n; k++) {
+         if (b->pilots[k] == last)
+            continue;
+         last = b->pilots[k];
+         p = pilot_get( last );
+         if (p != NULL)
+            pilot_outfitLRecalc( p );
+      }
+   }
+}
+
+
+/**
+ * @brief Frees the batched Lua outfit updates.
+ */
+void pilot_outfitLBatchFree (void)
+{
+   int i;
+   for (i=0; i<array_size(pilot_outfitBatch); i++) {
+      array_free( pilot_outfitBatch[i].pilots );
+      array_free( pilot_outfitBatch[i].slots );
+   }
+   array_free( pilot_outfitBatch );
+   pilot_outfitBatch = NULL;
 }
 
 
@@ -1354,8 +1737,7 @@ void pilot_outfitLOutfofenergy( Pilot *pilot )
       }
    }
    /* Recalculate if anything changed. */
-   if (pilotoutfit_modified)
-      pilot_calcStats( pilot );
+   pilot_outfitLRecalc( pilot );
 }
 
 
@@ -1398,8 +1780,7 @@ void pilot_outfitLOnhit( Pilot *pilot, double armour, double shield, unsigned in
       }
    }
    /* Recalculate if anything changed. */
-   if (pilotoutfit_modified)
-      pilot_calcStats( pilot );
+   pilot_outfitLRecalc( pilot );
 }
 
 
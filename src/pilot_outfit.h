@@ -38,12 +38,15 @@ int pilot_reportSpaceworthy( Pilot *p, char buf[], int buffSize );
 const char* pilot_canEquip( Pilot *p, PilotOutfitSlot *s, Outfit *o );
 
 /* Lock-ons. */
-void pilot_lockUpdateSlot( Pilot *p, PilotOutfitSlot *o, Pilot *t, double *a, double dt );
+void pilot_lockUpdateSlot( Pilot *p, PilotOutfitSlot *o, Pilot *t, double dt );
 void pilot_lockClear( Pilot *p );
 
 /* Other. */
 char* pilot_getOutfits( const Pilot *pilot );
+void pilot_outfitsChanged( Pilot *pilot );
+unsigned int pilot_outfitsGeneration (void);
 void pilot_calcStats( Pilot *pilot );
+void pilot_calcLuaStats( Pilot *pilot );
 void pilot_updateMass( Pilot *pilot );
 void pilot_healLanded( Pilot *pilot );
 
@@ -55,6 +58,8 @@ int pilot_slotIsActive( const PilotOutfitSlot *o );
 void pilot_outfitLInitAll( Pilot *pilot );
 int pilot_outfitLInit( Pilot *pilot, PilotOutfitSlot *po );
 void pilot_outfitLUpdate( Pilot *pilot, double dt );
+void pilot_outfitLUpdateBatch( double dt );
+void pilot_outfitLBatchFree (void);
 void pilot_outfitLOutfofenergy( Pilot *pilot );
 void pilot_outfitLOnhit( Pilot *pilot, double armour, double shield, unsigned int attacker );
 int pilot_outfitLOntoggle( Pilot *pilot, PilotOutfitSlot *po, int on );
@@ -50,6 +50,8 @@ static int pilot_weapSetFire( Pilot *p, PilotWeaponSet *ws, int level );
 static int pilot_shootWeaponSetOutfit( Pilot* p, PilotWeaponSet *ws, Outfit *o, int level, double time );
 static int pilot_shootWeapon( Pilot* p, PilotOutfitSlot* w, double time );
 static void pilot_weapSetUpdateRange( PilotWeaponSet *ws );
+static double pilot_weapInterceptTime( const Pilot *parent, const Vector2d *pos,
+      const Vector2d *vel, double speed, int absolute );
 
 
 /**
@@ -81,6 +83,16 @@ static int pilot_weapSetFire( Pilot *p, PilotWeaponSet *ws, int level )
    double time;
    Outfit *o;
 
+   /* Targets are the same for every outfit in the set. */
+   pt = NULL;
+   if (p->target != p->id)
+      pt = pilot_get( p->target );
+   ast = NULL;
+   if (p->nav_asteroid != -1) {
+      field = &cur_system->asteroids[p->nav_anchor];
+      ast = &field->asteroids[p->nav_asteroid];
+   }
+
    ret = 0;
    for (i=0; i<array_size(ws->slots); i++) {
       o = ws->slots[i].slot->outfit;
@@ -117,17 +129,11 @@ static int pilot_weapSetFire( Pilot *p, PilotWeaponSet *ws, int level )
       time = INFINITY;  /* With no target we just set time to infinity. */
 
       /* Calculate time to target if it is there. */
-      if (p->target != p->id) {
-         pt = pilot_get( p->target );
-         if (pt != NULL)
-            time = pilot_weapFlyTime( o, p, &pt->solid->pos, &pt->solid->vel);
-      }
+      if (pt != NULL)
+         time = pilot_weapFlyTime( o, p, &pt->solid->pos, &pt->solid->vel);
       /* Looking for a closer targeted asteroid */
-      if (p->nav_asteroid != -1) {
-         field = &cur_system->asteroids[p->nav_anchor];
-         ast = &field->asteroids[p->nav_asteroid];
+      if (ast != NULL)
          time = MIN( time, pilot_weapFlyTime( o, p, &ast->pos, &ast->vel) );
-      }
 
       /* Only "inrange" outfits. */
       if (ws->inrange && outfit_duration(o) < time)
@@ -821,64 +827,55 @@ void pilot_stopBeam( Pilot *p, PilotOutfitSlot *w )
 
 
 /**
- * @brief Computes an estimation of ammo flying time
+ * @brief Solves the flight time of a projectile to a target.
  *
- *    @param o the weapon to shoot.
- *    @param parent Parent of the weapon.
- *    @param pos Target of the weapon.
- *    @param vel Target's velocity.
+ *    @param parent Shooter.
+ *    @param pos Target position.
+ *    @param vel Target velocity.
+ *    @param speed Projectile speed.
+ *    @param absolute Whether the projectile uses absolute velocity.
+ *    @return Flight time, INFINITY if it can't hit.
  */
-double pilot_weapFlyTime( Outfit *o, Pilot *parent, Vector2d *pos, Vector2d *vel)
+static double pilot_weapInterceptTime( const Pilot *parent, const Vector2d *pos,
+      const Vector2d *vel, double speed, int absolute )
 {
    Vector2d approach_vector, relative_location, orthoradial_vector;
-   double speed, radial_speed, orthoradial_speed, dist, t;
+   double radial_speed, orthoradial_speed, dist, t, d, s2, a2;
 
    dist = vect_dist( &parent->solid->pos, pos );
 
-   /* Beam weapons */
-   if (outfit_isBeam(o)) {
-      if (dist > o->u.bem.range)
-         return INFINITY;
-      return 0.;
-   }
-
-   /* A bay doesn't have range issues */
-   if (outfit_isFighterBay(o))
-      return 0.;
-
+   /* Only the components are used, skip computing the polar form. */
    /* Missiles use absolute velocity while bolts and unguided rockets use relative vel */
-   if (outfit_isLauncher(o) && o->u.lau.ammo->u.amm.ai != AMMO_AI_UNGUIDED)
-         vect_cset( &approach_vector, - vel->x, - vel->y );
+   if (absolute)
+         vect_csetmin( &approach_vector, - vel->x, - vel->y );
    else
-         vect_cset( &approach_vector, VX(parent->solid->vel) - vel->x,
+         vect_csetmin( &approach_vector, VX(parent->solid->vel) - vel->x,
                VY(parent->solid->vel) - vel->y );
 
-   speed = outfit_speed(o);
-
    /* Get the vector : shooter -> target */
-   vect_cset( &relative_location, pos->x - VX(parent->solid->pos),
+   vect_csetmin( &relative_location, pos->x - VX(parent->solid->pos),
          pos->y - VY(parent->solid->pos) );
 
    /* Get the orthogonal vector */
-   vect_cset(&orthoradial_vector, VY(parent->solid->pos) - pos->y,
+   vect_csetmin(&orthoradial_vector, VY(parent->solid->pos) - pos->y,
          pos->x -  VX(parent->solid->pos) );
 
    radial_speed = vect_dot( &approach_vector, &relative_location );
-   radial_speed = radial_speed / VMOD(relative_location);
+   radial_speed = radial_speed / dist;
 
    orthoradial_speed = vect_dot(&approach_vector, &orthoradial_vector);
-   orthoradial_speed = orthoradial_speed / VMOD(relative_location);
+   orthoradial_speed = orthoradial_speed / dist;
 
-   if ( ((speed*speed - VMOD(approach_vector)*VMOD(approach_vector)) != 0) && (speed*speed - orthoradial_speed*orthoradial_speed) > 0)
-      t = dist * (sqrt( speed*speed - orthoradial_speed*orthoradial_speed ) - radial_speed) /
-            (speed*speed - VMOD(approach_vector)*VMOD(approach_vector));
-   else
+   s2 = speed*speed;
+   a2 = vect_dot( &approach_vector, &approach_vector );
+   if (((s2 - a2) == 0) || (s2 - orthoradial_speed*orthoradial_speed) <= 0)
       return INFINITY;
+   d = sqrt( s2 - orthoradial_speed*orthoradial_speed );
+   t = dist * (d - radial_speed) / (s2 - a2);
 
    /* if t < 0, try the other solution */
    if (t < 0)
-      t = - dist * (sqrt( speed*speed - orthoradial_speed*orthoradial_speed ) + radial_speed) /
-            (speed*speed - VMOD(approach_vector)*VMOD(approach_vector));
+      t = - dist * (d + radial_speed) / (s2 - a2);
 
    /* if t still < 0, no solution */
    if (t < 0)
@@ -888,6 +885,72 @@ double pilot_weapFlyTime( Outfit *o, Pilot *parent, Vector2d *pos, Vector2d *vel
 }
 
 
+/**
+ * @brief Computes an estimation of ammo flying time
+ *
+ * Solutions are cached in the pilot's fire control, so all the weapons of
+ *  the same speed class firing at the same target solve it only once.
+ *
+ *    @param o the weapon to shoot.
+ *    @param parent Parent of the weapon.
+ *    @param pos Target of the weapon.
+ *    @param vel Target's velocity.
+ */
+double pilot_weapFlyTime( Outfit *o, Pilot *parent, Vector2d *pos, Vector2d *vel)
+{
+   int i, absolute;
+   double speed;
+   PilotFireControl *fc;
+   PilotFireSolution *sol;
+
+   /* Beam weapons */
+   if (outfit_isBeam(o)) {
+      if (vect_dist2( &parent->solid->pos, pos ) > pow2(o->u.bem.range))
+         return INFINITY;
+      return 0.;
+   }
+
+   /* A bay doesn't have range issues */
+   if (outfit_isFighterBay(o))
+      return 0.;
+
+   speed    = outfit_speed(o);
+   absolute = (outfit_isLauncher(o) && o->u.lau.ammo->u.amm.ai != AMMO_AI_UNGUIDED);
+
+   /* The pilot moved, solutions are stale. */
+   fc = &parent->firectl;
+   if ((fc->pos.x != parent->solid->pos.x) || (fc->pos.y != parent->solid->pos.y) ||
+         (fc->vel.x != parent->solid->vel.x) || (fc->vel.y != parent->solid->vel.y)) {
+      fc->pos  = parent->solid->pos;
+      fc->vel  = parent->solid->vel;
+      fc->n    = 0;
+      fc->next = 0;
+   }
+
+   for (i=0; i<fc->n; i++) {
+      sol = &fc->sol[i];
+      if ((sol->speed == speed) && (sol->absolute == absolute) &&
+            (sol->pos.x == pos->x) && (sol->pos.y == pos->y) &&
+            (sol->vel.x == vel->x) && (sol->vel.y == vel->y))
+         return sol->time;
+   }
+
+   /* Not cached, replace the oldest solution when full. */
+   if (fc->n < PILOT_FIRE_SOLUTIONS)
+      sol = &fc->sol[ fc->n++ ];
+   else {
+      sol = &fc->sol[ fc->next ];
+      fc->next = (fc->next+1) % PILOT_FIRE_SOLUTIONS;
+   }
+   sol->pos      = *pos;
+   sol->vel      = *vel;
+   sol->speed    = speed;
+   sol->absolute = absolute;
+   sol->time     = pilot_weapInterceptTime( parent, pos, vel, speed, absolute );
+   return sol->time;
+}
+
+
 /**
  * @brief Calculates and shoots the appropriate weapons in a weapon set matching an outfit.
  */
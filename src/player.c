@@ -10,6 +10,7 @@
 
 
 /** @cond */
+#include <stdint.h>
 #include <stdlib.h>
 #include "physfs.h"
 
@@ -110,6 +111,10 @@ static PlayerShip_t* player_stack   = NULL;  /**< Stack of ships player has. */
  * player outfit stack - outfits he has
  */
 static PlayerOutfit_t *player_outfits  = NULL;  /**< Outfits player has. */
+static int *player_outfitsPos = NULL; /**< Array (array.h): Position+1 in player_outfits of each outfit, 0 if not owned. */
+static int *player_equipped = NULL; /**< Array (array.h): Amount of each outfit equipped on the player's ships. */
+static unsigned int player_equippedGen = 0; /**< Outfit generation player_equipped was built at. */
+static int player_equippedValid = 0; /**< Whether player_equipped may be used. */
 
 
 /*
@@ -126,13 +131,13 @@ static double player_timer = 0.; /**< For death and such. */
 /*
  * unique mission stack.
  */
-static int* missions_done  = NULL; /**< Array (array.h): Saves position of completed missions. */
+static uint32_t* missions_done  = NULL; /**< Array (array.h): Bitset of completed missions, indexed by ID. */
 
 
 /*
  * unique event stack.
  */
-static int* events_done  = NULL; /**< Array (array.h): Saves position of completed events. */
+static uint32_t* events_done  = NULL; /**< Array (array.h): Bitset of completed events, indexed by ID. */
 
 
 /*
@@ -166,6 +171,11 @@ static void player_addOutfitToPilot( Pilot* pilot, Outfit* outfit, PilotOutfitSl
 static int player_filterSuitablePlanet( Planet *p );
 static void player_planetOutOfRangeMsg (void);
 static int player_outfitCompare( const void *arg1, const void *arg2 );
+static int player_outfitIndex( const Outfit *o );
+static void player_outfitsReindex (void);
+static void player_equippedUpdate (void);
+static void player_doneSet( uint32_t **done, int id );
+static int player_doneHas( const uint32_t *done, int id );
 static int player_thinkMouseFly(void);
 static int preemption = 0; /* Hyperspace target/untarget preemption. */
 /*
@@ -629,6 +639,7 @@ void player_rmShip( const char *shipname )
       pilot_free(player_stack[i].p);
 
       array_erase( &player_stack, &player_stack[i], &player_stack[i+1] );
+      player_equippedValid = 0;
    }
 
    /* Update ship list if landed. */
@@ -697,6 +708,11 @@ void player_cleanup (void)
 
    array_free(player_outfits);
    player_outfits  = NULL;
+   array_free(player_outfitsPos);
+   player_outfitsPos = NULL;
+   array_free(player_equipped);
+   player_equipped = NULL;
+   player_equippedValid = 0;
 
    array_free(missions_done);
    missions_done = NULL;
@@ -1744,6 +1760,9 @@ int player_jump (void)
       /* Order escorts to jump; just for aesthetics (for now) */
       escorts_jump( player.p, &cur_system->jumps[player.p->nav_hyperspace] );
 
+      /* Decode the destination's graphics while the jump sequence plays. */
+      space_gfxPrefetch( cur_system->jumps[player.p->nav_hyperspace].target );
+
       return 1;
    }
    return 0;
@@ -1781,7 +1800,7 @@ void player_brokeHyperspace (void)
 
    /* enter the new system */
    jp = &cur_system->jumps[player.p->nav_hyperspace];
-   space_init( jp->target->name );
+   space_initJump( jp->target->name );
 
    /* set position, the pilot_update will handle lowering vel */
    space_calcJumpInPos( cur_system, sys, &player.p->solid->pos, &player.p->solid->vel, &player.p->solid->dir );
@@ -1880,11 +1899,17 @@ void player_accelOver (void)
 void player_targetSet( unsigned int id )
 {
    unsigned int old;
+   Pilot *p;
    old = player.p->target;
    pilot_setTarget( player.p, id );
    if ((old != id) && (player.p->target != PLAYER_ID)) {
       gui_forceBlink();
       player_soundPlayGUI( snd_target, 1 );
+
+      /* Targeted pilots tend to get hailed, have their portrait ready. */
+      p = pilot_get( player.p->target );
+      if (p != NULL)
+         ship_prefetchCommGFX( p->ship );
    }
    gui_setTarget();
 
@@ -2077,6 +2102,8 @@ void player_screenshot (void)
    /* now proceed to take the screenshot */
    DEBUG( _("Taking screenshot [%03d]..."), screenshot_cur );
    gl_screenshot(filename);
+   /* The file is only written later, don't pick it again meanwhile. */
+   screenshot_cur++;
 }
 
 
@@ -2452,7 +2479,7 @@ Pilot *player_getShip( const char *shipname )
  */
 int player_outfitOwned( const Outfit* o )
 {
-   int i;
+   int i, pos;
 
    /* Special case map. */
    if ((outfit_isMap(o) && map_isUseless(o)) ||
@@ -2469,12 +2496,11 @@ int player_outfitOwned( const Outfit* o )
          player_guiCheck(o->u.gui.gui))
       return 1;
 
-   /* Try to find it. */
-   for (i=0; i<array_size(player_outfits); i++)
-      if (player_outfits[i].o == o)
-         return player_outfits[i].q;
-
-   return 0;
+   i = player_outfitIndex( o );
+   if ((i < 0) || (i >= array_size(player_outfitsPos)))
+      return 0;
+   pos = player_outfitsPos[i];
+   return (pos > 0) ? player_outfits[pos-1].q : 0;
 }
 
 
@@ -2487,14 +2513,74 @@ int player_outfitOwnedTotal( const Outfit* o )
 
    q  = player_outfitOwned(o);
 
-   q += pilot_numOutfit( player.p, o );
-   for (i=0; i<array_size(player_stack); i++)
-      q += pilot_numOutfit( player_stack[i].p, o );
+   player_equippedUpdate();
+   i = player_outfitIndex( o );
+   if ((i >= 0) && (i < array_size(player_equipped)))
+      q += player_equipped[i];
 
    return q;
 }
 
 
+/**
+ * @brief Gets the index of an outfit in the outfit stack.
+ *
+ *    @param o Outfit to get index of.
+ *    @return Index of the outfit.
+ */
+static int player_outfitIndex( const Outfit *o )
+{
+   return o - outfit_getAll();
+}
+
+
+/**
+ * @brief Rebuilds the positions of the outfits in player_outfits.
+ */
+static void player_outfitsReindex (void)
+{
+   int i, n;
+
+   n = array_size( outfit_getAll() );
+   if (player_outfitsPos == NULL)
+      player_outfitsPos = array_create_size( int, n );
+   array_resize( &player_outfitsPos, n );
+   memset( player_outfitsPos, 0, sizeof(int) * n );
+   for (i=0; i<array_size(player_outfits); i++)
+      player_outfitsPos[ player_outfitIndex( player_outfits[i].o ) ] = i+1;
+}
+
+
+/**
+ * @brief Recounts the outfits equipped on the player's ships if they changed.
+ */
+static void player_equippedUpdate (void)
+{
+   int i, j, n;
+   const Pilot *p;
+
+   if (player_equippedValid && (player_equippedGen == pilot_outfitsGeneration()))
+      return;
+
+   n = array_size( outfit_getAll() );
+   if (player_equipped == NULL)
+      player_equipped = array_create_size( int, n );
+   array_resize( &player_equipped, n );
+   memset( player_equipped, 0, sizeof(int) * n );
+   for (i=-1; i<array_size(player_stack); i++) {
+      p = (i < 0) ? player.p : player_stack[i].p;
+      if (p == NULL)
+         continue;
+      for (j=0; j<array_size(p->outfits); j++)
+         if (p->outfits[j]->outfit != NULL)
+            player_equipped[ player_outfitIndex( p->outfits[j]->outfit ) ]++;
+   }
+
+   player_equippedGen   = pilot_outfitsGeneration();
+   player_equippedValid = 1;
+}
+
+
 /**
  * @brief qsort() compare function for PlayerOutfit_t sorting.
  */
@@ -2539,6 +2625,7 @@ int player_getOutfitsFiltered( Outfit **outfits,
    /* We'll sort. */
    qsort( player_outfits, array_size(player_outfits),
          sizeof(PlayerOutfit_t), player_outfitCompare );
+   player_outfitsReindex();
 
    for (i=0; i<array_size(player_outfits); i++)
       outfits[i] = (Outfit*)player_outfits[i].o;
@@ -2599,11 +2686,12 @@ int player_addOutfit( const Outfit *o, int quantity )
    }
 
    /* Try to find it. */
-   for (i=0; i<array_size(player_outfits); i++) {
-      if (player_outfits[i].o == o) {
-         player_outfits[i].q  += quantity;
-         return quantity;
-      }
+   if (array_size(player_outfitsPos) != array_size( outfit_getAll() ))
+      player_outfitsReindex();
+   i = player_outfitIndex( o );
+   if (player_outfitsPos[i] > 0) {
+      player_outfits[ player_outfitsPos[i]-1 ].q += quantity;
+      return quantity;
    }
 
    /* Allocate if needed. */
@@ -2612,6 +2700,7 @@ int player_addOutfit( const Outfit *o, int quantity )
    /* Add the outfit. */
    po->o = o;
    po->q = quantity;
+   player_outfitsPos[i] = array_size(player_outfits);
    return quantity;
 }
 
@@ -2625,26 +2714,31 @@ int player_addOutfit( const Outfit *o, int quantity )
  */
 int player_rmOutfit( const Outfit *o, int quantity )
 {
-   int i, q;
+   int i, q, pos, last;
 
    /* Try to find it. */
-   for (i=0; i<array_size(player_outfits); i++) {
-      if (player_outfits[i].o == o) {
-         /* See how many to remove. */
-         q = MIN( player_outfits[i].q, quantity );
-         player_outfits[i].q -= q;
-
-         /* See if must remove element. */
-         if (player_outfits[i].q <= 0)
-            array_erase( &player_outfits, &player_outfits[i], &player_outfits[i+1] );
-
-         /* Return removed outfits. */
-         return q;
+   i = player_outfitIndex( o );
+   if ((i < 0) || (i >= array_size(player_outfitsPos)) || (player_outfitsPos[i] <= 0))
+      return 0; /* Nothing removed. */
+   pos = player_outfitsPos[i]-1;
+
+   /* See how many to remove. */
+   q = MIN( player_outfits[pos].q, quantity );
+   player_outfits[pos].q -= q;
+
+   /* See if must remove element, the last one takes its place. */
+   if (player_outfits[pos].q <= 0) {
+      last = array_size(player_outfits)-1;
+      if (pos != last) {
+         player_outfits[pos] = player_outfits[last];
+         player_outfitsPos[ player_outfitIndex( player_outfits[pos].o ) ] = pos+1;
       }
+      array_erase( &player_outfits, &player_outfits[last], &player_outfits[last+1] );
+      player_outfitsPos[i] = 0;
    }
 
-   /* Nothing removed. */
-   return 0;
+   /* Return removed outfits. */
+   return q;
 }
 
 
@@ -2655,14 +2749,7 @@ int player_rmOutfit( const Outfit *o, int quantity )
  */
 void player_missionFinished( int id )
 {
-   /* Make sure not already marked. */
-   if (player_missionAlreadyDone(id))
-      return;
-
-   /* Mark as done. */
-   if (missions_done == NULL)
-      missions_done = array_create( int );
-   array_push_back( &missions_done, id );
+   player_doneSet( &missions_done, id );
 }
 
 
@@ -2674,11 +2761,7 @@ void player_missionFinished( int id )
  */
 int player_missionAlreadyDone( int id )
 {
-   int i;
-   for (i=0; i<array_size(missions_done); i++)
-      if (missions_done[i] == id)
-         return 1;
-   return 0;
+   return player_doneHas( missions_done, id );
 }
 
 
@@ -2689,14 +2772,7 @@ int player_missionAlreadyDone( int id )
  */
 void player_eventFinished( int id )
 {
-   /* Make sure not already done. */
-   if (player_eventAlreadyDone(id))
-      return;
-
-   /* Mark as done. */
-   if (events_done == NULL)
-      events_done = array_create( int );
-   array_push_back( &events_done, id );
+   player_doneSet( &events_done, id );
 }
 
 
@@ -2708,11 +2784,44 @@ void player_eventFinished( int id )
  */
 int player_eventAlreadyDone( int id )
 {
-   int i;
-   for (i=0; i<array_size(events_done); i++)
-      if (events_done[i] == id)
-         return 1;
-   return 0;
+   return player_doneHas( events_done, id );
+}
+
+
+/**
+ * @brief Marks an ID as done in a bitset.
+ *
+ *    @param done Bitset to mark in, grows as needed.
+ *    @param id ID to mark.
+ */
+static void player_doneSet( uint32_t **done, int id )
+{
+   int i, n;
+
+   if (id < 0)
+      return;
+
+   if (*done == NULL)
+      *done = array_create( uint32_t );
+   n = id/32 + 1;
+   for (i=array_size(*done); i<n; i++)
+      array_push_back( done, 0 );
+   (*done)[id/32] |= UINT32_C(1) << (id%32);
+}
+
+
+/**
+ * @brief Checks to see if an ID is marked as done in a bitset.
+ *
+ *    @param done Bitset to check.
+ *    @param id ID to check.
+ *    @return 1 if it's marked, 0 otherwise.
+ */
+static int player_doneHas( const uint32_t *done, int id )
+{
+   if ((id < 0) || (id/32 >= array_size(done)))
+      return 0;
+   return !!(done[id/32] & (UINT32_C(1) << (id%32)));
 }
 
 
@@ -2963,8 +3072,10 @@ int player_save( xmlTextWriterPtr writer )
 
    /* Mission the player has done. */
    xmlw_startElem(writer,"missions_done");
-   for (i=0; i<array_size(missions_done); i++) {
-      m = mission_get(missions_done[i]);
+   for (i=0; i<32*array_size(missions_done); i++) {
+      if (!player_doneHas( missions_done, i ))
+         continue;
+      m = mission_get(i);
       if (m != NULL) /* In case mission name changes between versions */
          xmlw_elem(writer, "done", "%s", m->name);
    }
@@ -2972,8 +3083,10 @@ int player_save( xmlTextWriterPtr writer )
 
    /* Events the player has done. */
    xmlw_startElem(writer, "events_done");
-   for (i=0; i<array_size(events_done); i++) {
-      ev = event_dataName(events_done[i]);
+   for (i=0; i<32*array_size(events_done); i++) {
+      if (!player_doneHas( events_done, i ))
+         continue;
+      ev = event_dataName(i);
       if (ev != NULL) /* In case mission name changes between versions */
          xmlw_elem(writer, "done", "%s", ev);
    }
@@ -46,6 +46,7 @@ static void player_autonav (void);
 static int player_autonavApproach( const Vector2d *pos, double *dist2, int count_target );
 static void player_autonavFollow( const Vector2d *pos, const Vector2d *vel, const int follow );
 static int player_autonavBrake (void);
+static int player_autonavHostiles (void);
 
 
 /**
@@ -520,6 +521,47 @@ static int player_autonavBrake (void)
    return ret;
 }
 
+/**
+ * @brief Checks whether there are hostiles in range of the player.
+ *
+ *    @return 1 if a hostile that isn't disabled is in range.
+ */
+static int player_autonavHostiles (void)
+{
+   int i;
+   Pilot *const*pstk;
+
+   pstk = pilot_getAll();
+   for (i=0; i<array_size(pstk); i++) {
+      if ( ( pstk[i]->id != PLAYER_ID ) && pilot_isHostile( pstk[i] )
+            && pilot_inRangePilot( player.p, pstk[i], NULL ) == 1
+            && !pilot_isDisabled( pstk[i] ) )
+         return 1;
+   }
+   return 0;
+}
+
+
+/**
+ * @brief Checks whether autonav can be simulated with coarse steps.
+ *
+ * Only when flying towards the target at full time compression, with nothing
+ *  hostile around, so there is nothing to react to quickly.
+ *
+ *    @return 1 if coarse steps can be used.
+ */
+int player_autonavCoarse (void)
+{
+   if (!player_isFlag(PLAYER_AUTONAV) || tc_rampdown || (player.autonav_timer > 0.))
+      return 0;
+   if ((player.autonav != AUTONAV_JUMP_APPROACH) &&
+         (player.autonav != AUTONAV_POS_APPROACH) &&
+         (player.autonav != AUTONAV_PNT_APPROACH))
+      return 0;
+   return !player_autonavHostiles();
+}
+
+
 /**
  * @brief Checks whether the speed should be reset due to damage or missile locks.
  *
@@ -528,30 +570,18 @@ static int player_autonavBrake (void)
 int player_autonavShouldResetSpeed (void)
 {
    double failpc, shield, armour;
-   int i;
-   Pilot *const*pstk;
    int hostiles, will_reset;
 
    if (!player_isFlag(PLAYER_AUTONAV))
       return 0;
 
-   hostiles   = 0;
    will_reset = 0;
 
    failpc = conf.autonav_reset_speed;
    shield = player.p->shield / player.p->shield_max;
    armour = player.p->armour / player.p->armour_max;
 
-   pstk = pilot_getAll();
-   for (i=0; i<array_size(pstk); i++) {
-      if ( ( pstk[i]->id != PLAYER_ID ) && pilot_isHostile( pstk[i] )
-            && pilot_inRangePilot( player.p, pstk[i], NULL ) == 1
-            && !pilot_isDisabled( pstk[i] ) ) {
-         hostiles = 1;
-         break;
-      }
-   }
-
+   hostiles = player_autonavHostiles();
    if (hostiles) {
       if (failpc > .995) {
          will_reset = 1;
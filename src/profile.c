@@ -0,0 +1,548 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+
+/**
+ * @file profile.c
+ *
+ * @brief Frame profiler, only compiled in with the profiler build option.
+ *
+ * CPU zones are timed with the performance counter and accumulate over the
+ *  frame, so a zone can be entered several times. GPU zones are timed with
+ *  timer queries, which are read back a few frames later to avoid stalling.
+ *
+ * Every frame is appended to profile/frames.csv, and the first frames are also
+ *  written as a Chrome trace (chrome://tracing) to profile/trace.json, both in
+ *  the write directory. The zones are displayed under the FPS counter.
+ */
+
+
+/** @cond */
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include "physfs.h"
+#include "SDL.h"
+
+#include "naev.h"
+/** @endcond */
+
+#include "profile.h"
+
+#ifdef PROFILING
+
+#include "colour.h"
+#include "font.h"
+#include "log.h"
+#include "memtrack.h"
+#include "nstring.h"
+#include "opengl.h"
+#include "scratch.h"
+
+
+#ifndef GL_TIME_ELAPSED
+#define GL_TIME_ELAPSED       0x88BF /**< From ARB_timer_query, not in our GL headers. */
+#endif /* GL_TIME_ELAPSED */
+
+#define PROFILE_GPU_FRAMES    4 /**< Frames to wait before reading GPU timings. */
+#define PROFILE_TRACE_FRAMES  10000 /**< Frames to write to the trace. */
+#define PROFILE_SMOOTH        0.05 /**< Smoothing of the displayed averages. */
+#define PROFILE_BUFSIZE       65536 /**< Size of the file write buffers. */
+
+
+/**
+ * @brief Names of the CPU zones, prefixed by their nesting.
+ */
+static const char *profile_names[PROFILE_ZONES] = {
+   "space",
+   "weapons",
+   "spfx",
+   "pilots",
+   "  ai",
+   "camera",
+   "hooks",
+   "render",
+   "lua gc"
+};
+
+/**
+ * @brief Names of the GPU zones.
+ */
+static const char *profile_gpuNames[PROFILE_GPU_ZONES] = {
+   "gpu nebula",
+   "gpu background",
+   "gpu trails",
+   "gpu game",
+   "gpu pp game",
+   "gpu gui",
+   "gpu pp gui",
+   "gpu overlay",
+   "gpu pp final"
+};
+
+
+/**
+ * @brief Timings of a zone.
+ */
+typedef struct ProfileTiming_ {
+   double cur; /**< Time accumulated in the current frame (ms). */
+   double last; /**< Time of the last complete frame (ms). */
+   double avg; /**< Smoothed time (ms). */
+   double peak; /**< Highest time over the last second (ms). */
+   double peak_next; /**< Highest time so far this second (ms). */
+   double total; /**< Time accumulated over all the frames (ms). */
+} ProfileTiming;
+
+
+static int profile_ready = 0; /**< Profiler is initialized. */
+static double profile_freq = 1.; /**< Ticks of the performance counter per ms. */
+static Uint64 profile_epoch = 0; /**< Counter when the profiler started. */
+static Uint64 profile_frameStart = 0; /**< Counter when the current frame started. */
+static unsigned int profile_frames = 0; /**< Frames profiled so far. */
+static double profile_peakTimer = 0.; /**< Time until the peaks are updated (ms). */
+
+/* CPU zones. */
+static ProfileTiming profile_cpu[PROFILE_ZONES]; /**< Timings of the CPU zones. */
+static Uint64 profile_start[PROFILE_ZONES]; /**< Counter when the zones were entered. */
+
+/* GPU zones. */
+static int profile_gpuOK = 0; /**< Timer queries are supported. */
+static GLuint profile_queries[PROFILE_GPU_FRAMES][PROFILE_GPU_ZONES]; /**< Timer queries. */
+static int profile_queryUsed[PROFILE_GPU_FRAMES][PROFILE_GPU_ZONES]; /**< Queries issued in the frame. */
+static Uint64 profile_queryFrame[PROFILE_GPU_FRAMES]; /**< Start of the frame the queries belong to. */
+static int profile_gpuSlot = 0; /**< Queries being issued this frame. */
+static ProfileTiming profile_gpu[PROFILE_GPU_ZONES]; /**< Timings of the GPU zones. */
+
+/* GL calls. */
+static glStats profile_gl; /**< GL call counters of the last frame. */
+
+/* Output. */
+static PHYSFS_File *profile_csv = NULL; /**< Per frame timings. */
+static PHYSFS_File *profile_trace = NULL; /**< Chrome trace. */
+static int profile_traceEvents = 0; /**< Events written to the trace. */
+
+
+/*
+ * Prototypes.
+ */
+static double profile_ms( Uint64 t );
+static void profile_update( ProfileTiming *t, double ms, int newpeak );
+PRINTF_FORMAT( 2, 3 ) static void profile_write( PHYSFS_File *f, const char *fmt, ... );
+static void profile_traceEvent( const char *name, int tid, double ts, double dur );
+static void profile_gpuRead( int slot );
+
+
+/**
+ * @brief Converts a counter value to ms since the profiler started.
+ */
+static double profile_ms( Uint64 t )
+{
+   return (double)(t - profile_epoch) / profile_freq;
+}
+
+
+/**
+ * @brief Stores the time of a zone for the frame.
+ */
+static void profile_update( ProfileTiming *t, double ms, int newpeak )
+{
+   t->last      = ms;
+   t->total    += ms;
+   t->avg      += PROFILE_SMOOTH * (ms - t->avg);
+   t->peak_next = MAX( t->peak_next, ms );
+   if (newpeak) {
+      t->peak      = t->peak_next;
+      t->peak_next = 0.;
+   }
+}
+
+
+/**
+ * @brief Writes formatted text to an output file.
+ */
+static void profile_write( PHYSFS_File *f, const char *fmt, ... )
+{
+   char buf[STRMAX_SHORT];
+   va_list ap;
+   int n;
+
+   if (f == NULL)
+      return;
+
+   va_start( ap, fmt );
+   n = vsnprintf( buf, sizeof(buf), fmt, ap );
+   va_end( ap );
+   PHYSFS_writeBytes( f, buf, MIN( n, (int)sizeof(buf)-1 ) );
+}
+
+
+/**
+ * @brief Writes a complete event to the trace.
+ *
+ *    @param name Name of the zone.
+ *    @param tid Track to put it on (1 for CPU, 2 for GPU).
+ *    @param ts Start of the event (ms).
+ *    @param dur Duration of the event (ms).
+ */
+static void profile_traceEvent( const char *name, int tid, double ts, double dur )
+{
+   if ((profile_trace == NULL) || (profile_frames > PROFILE_TRACE_FRAMES))
+      return;
+   profile_write( profile_trace,
+         "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.1f,\"dur\":%.1f}",
+         (profile_traceEvents > 0) ? "," : "", name, tid, ts*1000., dur*1000. );
+   profile_traceEvents++;
+}
+
+
+/**
+ * @brief Initializes the profiler, must be called after OpenGL.
+ */
+void profile_init (void)
+{
+   int i;
+
+   profile_freq       = (double)SDL_GetPerformanceFrequency() / 1000.;
+   profile_epoch      = SDL_GetPerformanceCounter();
+   profile_frameStart = profile_epoch;
+
+   /* Timer queries are core since 3.3. */
+   profile_gpuOK = ((GLVersion.major > 3) ||
+         ((GLVersion.major == 3) && (GLVersion.minor >= 3)) ||
+         SDL_GL_ExtensionSupported( "GL_ARB_timer_query" ));
+   if (profile_gpuOK)
+      glGenQueries( PROFILE_GPU_FRAMES*PROFILE_GPU_ZONES, &profile_queries[0][0] );
+   else
+      WARN(_("Timer queries not supported, GPU zones will not be profiled."));
+
+   /* Output files. */
+   PHYSFS_mkdir( "profile" );
+   profile_csv = PHYSFS_openWrite( "profile/frames.csv" );
+   profile_trace = PHYSFS_openWrite( "profile/trace.json" );
+   if ((profile_csv == NULL) || (profile_trace == NULL))
+      WARN(_("Unable to open profiler output: %s"),
+            PHYSFS_getErrorByCode( PHYSFS_getLastErrorCode() ) );
+   if (profile_csv != NULL) {
+      PHYSFS_setBuffer( profile_csv, PROFILE_BUFSIZE );
+      profile_write( profile_csv, "frame,time,dt" );
+      for (i=0; i<PROFILE_ZONES; i++)
+         profile_write( profile_csv, ",%s", profile_names[i] + strspn( profile_names[i], " " ) );
+      for (i=0; i<PROFILE_GPU_ZONES; i++)
+         profile_write( profile_csv, ",%s", profile_gpuNames[i] );
+      profile_write( profile_csv, ",draws,programs,textures,blends,skipped\n" );
+   }
+   if (profile_trace != NULL) {
+      PHYSFS_setBuffer( profile_trace, PROFILE_BUFSIZE );
+      profile_write( profile_trace, "{\"traceEvents\":[" );
+   }
+
+   profile_ready = 1;
+   DEBUG(_("Frame profiler enabled."));
+}
+
+
+/**
+ * @brief Cleans up the profiler and closes the output.
+ */
+void profile_exit (void)
+{
+   if (!profile_ready)
+      return;
+
+   if (profile_gpuOK)
+      glDeleteQueries( PROFILE_GPU_FRAMES*PROFILE_GPU_ZONES, &profile_queries[0][0] );
+
+   if (profile_csv != NULL)
+      PHYSFS_close( profile_csv );
+   if (profile_trace != NULL) {
+      profile_write( profile_trace, "\n]}\n" );
+      PHYSFS_close( profile_trace );
+   }
+   profile_csv   = NULL;
+   profile_trace = NULL;
+   profile_ready = 0;
+}
+
+
+/**
+ * @brief Reads back the GPU timings of a frame if they are available.
+ */
+static void profile_gpuRead( int slot )
+{
+   int i;
+   GLuint ready, ns;
+   double ts, ms;
+
+   ts = profile_ms( profile_queryFrame[slot] );
+   for (i=0; i<PROFILE_GPU_ZONES; i++) {
+      if (!profile_queryUsed[slot][i])
+         continue;
+      profile_queryUsed[slot][i] = 0;
+
+      /* Skip rather than stall if the GPU is that far behind. */
+      glGetQueryObjectuiv( profile_queries[slot][i], GL_QUERY_RESULT_AVAILABLE, &ready );
+      if (!ready)
+         continue;
+      glGetQueryObjectuiv( profile_queries[slot][i], GL_QUERY_RESULT, &ns );
+      ms = (double)ns / 1e6;
+      profile_gpu[i].cur = ms;
+
+      /* The GPU doesn't give start times, so just lay them out in order. */
+      profile_traceEvent( profile_gpuNames[i], 2, ts, ms );
+      ts += ms;
+   }
+}
+
+
+/**
+ * @brief Ends the current frame and starts a new one.
+ *
+ * Should be called once at the start of every frame.
+ */
+void profile_frame (void)
+{
+   int i, newpeak;
+   Uint64 now;
+   double dt;
+
+   if (!profile_ready)
+      return;
+
+   now = SDL_GetPerformanceCounter();
+   dt  = (double)(now - profile_frameStart) / profile_freq;
+
+   /* Peaks are over a second. */
+   profile_peakTimer -= dt;
+   newpeak = (profile_peakTimer <= 0.);
+   if (newpeak)
+      profile_peakTimer = 1000.;
+
+   /* Get the GPU timings of the queries about to be reused. */
+   profile_gpuSlot = (profile_gpuSlot+1) % PROFILE_GPU_FRAMES;
+   if (profile_gpuOK)
+      profile_gpuRead( profile_gpuSlot );
+   profile_queryFrame[ profile_gpuSlot ] = now;
+
+   /* Store the frame. */
+   profile_write( profile_csv, "%u,%.3f,%.3f", profile_frames,
+         profile_ms( profile_frameStart ), dt );
+   for (i=0; i<PROFILE_ZONES; i++) {
+      profile_update( &profile_cpu[i], profile_cpu[i].cur, newpeak );
+      profile_write( profile_csv, ",%.3f", profile_cpu[i].cur );
+      profile_cpu[i].cur = 0.;
+   }
+   /* GPU timings are the ones read this frame, a few frames late. */
+   for (i=0; i<PROFILE_GPU_ZONES; i++) {
+      profile_update( &profile_gpu[i], profile_gpu[i].cur, newpeak );
+      profile_write( profile_csv, ",%.3f", profile_gpu[i].cur );
+      profile_gpu[i].cur = 0.;
+   }
+   gl_statsReset( &profile_gl );
+   profile_write( profile_csv, ",%u,%u,%u,%u,%u\n", profile_gl.draws,
+         profile_gl.programs, profile_gl.textures, profile_gl.blends,
+         profile_gl.skipped );
+
+   profile_frames++;
+   profile_frameStart = now;
+}
+
+
+/**
+ * @brief Starts timing a CPU zone.
+ *
+ *    @param zone Zone to start timing.
+ */
+void profile_begin( ProfileZone zone )
+{
+   profile_start[zone] = SDL_GetPerformanceCounter();
+}
+
+
+/**
+ * @brief Stops timing a CPU zone, adding the time to the frame.
+ *
+ *    @param zone Zone to stop timing.
+ */
+void profile_end( ProfileZone zone )
+{
+   double dur;
+
+   if (!profile_ready)
+      return;
+
+   dur = (double)(SDL_GetPerformanceCounter() - profile_start[zone]) / profile_freq;
+   profile_cpu[zone].cur += dur;
+   profile_traceEvent( profile_names[zone] + strspn( profile_names[zone], " " ), 1,
+         profile_ms( profile_start[zone] ), dur );
+}
+
+
+/**
+ * @brief Starts timing a GPU zone, only one can be active at once.
+ *
+ *    @param zone Zone to start timing.
+ */
+void profile_gpuBegin( ProfileGPUZone zone )
+{
+   if (!profile_ready || !profile_gpuOK)
+      return;
+   glBeginQuery( GL_TIME_ELAPSED, profile_queries[profile_gpuSlot][zone] );
+   profile_queryUsed[profile_gpuSlot][zone] = 1;
+}
+
+
+/**
+ * @brief Stops timing the current GPU zone.
+ */
+void profile_gpuEnd (void)
+{
+   if (!profile_ready || !profile_gpuOK)
+      return;
+   glEndQuery( GL_TIME_ELAPSED );
+}
+
+
+/**
+ * @brief Displays the zone timings.
+ *
+ *    @param x X position to display at.
+ *    @param y Y position of the first line.
+ *    @return Y position after the last line.
+ */
+double profile_render( double x, double y )
+{
+   int i;
+   double h;
+   const char *name;
+   size_t used, peak;
+
+   if (!profile_ready)
+      return y;
+
+   h = gl_defFontMono.h + 2.;
+   gl_print( &gl_defFontMono, x, y, &cFontGrey, "%-14s %6s %6s", "zone", "ms", "peak" );
+   y -= h;
+   for (i=0; i<PROFILE_ZONES; i++) {
+      gl_print( &gl_defFontMono, x, y, NULL, "%-14s %6.2f %6.2f",
+            profile_names[i], profile_cpu[i].avg, profile_cpu[i].peak );
+      y -= h;
+   }
+   if (profile_gpuOK) {
+      for (i=0; i<PROFILE_GPU_ZONES; i++) {
+         gl_print( &gl_defFontMono, x, y, NULL, "%-14s %6.2f %6.2f",
+               profile_gpuNames[i], profile_gpu[i].avg, profile_gpu[i].peak );
+         y -= h;
+      }
+   }
+   gl_print( &gl_defFontMono, x, y, &cFontGrey, "%u draws, %u programs, %u textures",
+         profile_gl.draws, profile_gl.programs, profile_gl.textures );
+   y -= h;
+   gl_print( &gl_defFontMono, x, y, &cFontGrey, "%u blends, %u skipped",
+         profile_gl.blends, profile_gl.skipped );
+   y -= h;
+   gl_print( &gl_defFontMono, x, y, &cFontGrey, "scratch %.1f KiB, peak %.1f KiB",
+         scratch_last() / 1024., scratch_peak() / 1024. );
+   y -= h;
+   gl_print( &gl_defFontMono, x, y, &cFontGrey, "%-14s %6s %6s", "memory", "MiB", "peak" );
+   y -= h;
+   for (i=0; memtrack_get( i, &name, &used, &peak )==0; i++) {
+      gl_print( &gl_defFontMono, x, y, NULL, "%-14s %6.1f %6.1f",
+            name, used / 1048576., peak / 1048576. );
+      y -= h;
+   }
+   return y;
+}
+
+
+/**
+ * @brief Logs the total and average time of the CPU zones so far.
+ */
+void profile_report (void)
+{
+   int i;
+   unsigned int n;
+
+   if (!profile_ready)
+      return;
+
+   n = MAX( 1, profile_frames );
+   LOG(_("Profiled %u frames:"), profile_frames);
+   LOG("   %-14s %10s %8s", "zone", "total ms", "avg ms");
+   for (i=0; i<PROFILE_ZONES; i++)
+      LOG("   %-14s %10.2f %8.3f", profile_names[i],
+            profile_cpu[i].total, profile_cpu[i].total / n);
+   if (profile_gpuOK)
+      for (i=0; i<PROFILE_GPU_ZONES; i++)
+         LOG("   %-14s %10.2f %8.3f", profile_gpuNames[i],
+               profile_gpu[i].total, profile_gpu[i].total / n);
+}
+
+
+/**
+ * @brief Gets the time of a CPU zone in the current frame so far.
+ *
+ *    @param i Index of the zone.
+ *    @param[out] name Name of the zone.
+ *    @param[out] ms Time of the zone this frame (ms).
+ *    @return 0 on success, -1 if there is no such zone.
+ */
+int profile_getFrame( int i, const char **name, double *ms )
+{
+   if (!profile_ready || (i < 0) || (i >= PROFILE_ZONES))
+      return -1;
+   *name = profile_names[i] + strspn( profile_names[i], " " );
+   *ms   = profile_cpu[i].cur;
+   return 0;
+}
+
+
+/**
+ * @brief Gets the GPU time of the game layer, up to its post-processing.
+ *
+ *    @param[out] ms Time of the last frame read back (ms).
+ *    @return 0 on success, -1 if GPU zones aren't being timed.
+ */
+int profile_gpuGame( double *ms )
+{
+   int i;
+   if (!profile_ready || !profile_gpuOK)
+      return -1;
+   *ms = 0.;
+   for (i=0; i<=PROFILE_GPU_PP_GAME; i++)
+      *ms += profile_gpu[i].last;
+   return 0;
+}
+
+
+/**
+ * @brief Gets the timings of a zone, CPU zones come first and then GPU zones.
+ *
+ *    @param i Index of the zone.
+ *    @param[out] name Name of the zone.
+ *    @param[out] avg Smoothed time of the zone (ms).
+ *    @param[out] peak Highest time over the last second (ms).
+ *    @return 0 on success, -1 if there is no such zone.
+ */
+int profile_getTiming( int i, const char **name, double *avg, double *peak )
+{
+   const ProfileTiming *t;
+
+   if (!profile_ready || (i < 0))
+      return -1;
+   if (i < PROFILE_ZONES) {
+      *name = profile_names[i] + strspn( profile_names[i], " " );
+      t     = &profile_cpu[i];
+   }
+   else if (profile_gpuOK && (i < PROFILE_ZONES+PROFILE_GPU_ZONES)) {
+      *name = profile_gpuNames[i-PROFILE_ZONES];
+      t     = &profile_gpu[i-PROFILE_ZONES];
+   }
+   else
+      return -1;
+
+   *avg  = t->avg;
+   *peak = t->peak;
+   return 0;
+}
+
+#endif /* PROFILING */
@@ -0,0 +1,76 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+
+
+
+#ifndef PROFILE_H
+#  define PROFILE_H
+
+
+/**
+ * @brief CPU zones of the frame profiler.
+ */
+typedef enum ProfileZone_ {
+   PROFILE_SPACE, /**< Updating the system. */
+   PROFILE_WEAPONS, /**< Updating the weapons. */
+   PROFILE_SPFX, /**< Updating the special effects. */
+   PROFILE_PILOTS, /**< Updating the pilots. */
+   PROFILE_AI, /**< Pilots thinking, part of PROFILE_PILOTS. */
+   PROFILE_CAMERA, /**< Updating the camera. */
+   PROFILE_HOOKS, /**< Running the update and safe hooks. */
+   PROFILE_RENDER, /**< Issuing the rendering commands. */
+   PROFILE_GC, /**< Paced Lua garbage collection. */
+   PROFILE_ZONES /**< Number of zones, not a zone. */
+} ProfileZone;
+
+
+/**
+ * @brief GPU zones of the frame profiler, they can't overlap.
+ */
+typedef enum ProfileGPUZone_ {
+   PROFILE_GPU_NEBULA, /**< Nebula and stars. */
+   PROFILE_GPU_BACKGROUND, /**< Background hooks and planets. */
+   PROFILE_GPU_TRAILS, /**< Trails and back effects. */
+   PROFILE_GPU_GAME, /**< Pilots, weapons and the rest of the game. */
+   PROFILE_GPU_PP_GAME, /**< Post-processing of the game layer. */
+   PROFILE_GPU_GUI, /**< Player GUI. */
+   PROFILE_GPU_PP_GUI, /**< Post-processing of the GUI layer. */
+   PROFILE_GPU_OVERLAY, /**< Overlay and toolkit. */
+   PROFILE_GPU_PP_FINAL, /**< Final post-processing. */
+   PROFILE_GPU_ZONES /**< Number of zones, not a zone. */
+} ProfileGPUZone;
+
+
+#ifdef PROFILING
+#define PROFILE_BEGIN(z)      profile_begin(z) /**< Starts timing a CPU zone. */
+#define PROFILE_END(z)        profile_end(z) /**< Stops timing a CPU zone. */
+#define PROFILE_GPU_BEGIN(z)  profile_gpuBegin(z) /**< Starts timing a GPU zone. */
+#define PROFILE_GPU_END()     profile_gpuEnd() /**< Stops timing the current GPU zone. */
+
+/* Set up. */
+void profile_init (void);
+void profile_exit (void);
+
+/* Timing. */
+void profile_frame (void);
+void profile_begin( ProfileZone zone );
+void profile_end( ProfileZone zone );
+void profile_gpuBegin( ProfileGPUZone zone );
+void profile_gpuEnd (void);
+
+/* Display. */
+double profile_render( double x, double y );
+void profile_report (void);
+int profile_getTiming( int i, const char **name, double *avg, double *peak );
+int profile_getFrame( int i, const char **name, double *ms );
+int profile_gpuGame( double *ms );
+#else /* PROFILING */
+#define PROFILE_BEGIN(z)      do {} while (0) /**< Starts timing a CPU zone. */
+#define PROFILE_END(z)        do {} while (0) /**< Stops timing a CPU zone. */
+#define PROFILE_GPU_BEGIN(z)  do {} while (0) /**< Starts timing a GPU zone. */
+#define PROFILE_GPU_END()     do {} while (0) /**< Stops timing the current GPU zone. */
+#endif /* PROFILING */
+
+
+#endif /* PROFILE_H */
@@ -3,6 +3,10 @@
  */
 
 
+/** @cond */
+#include "SDL.h"
+/** @endcond */
+
 #include "render.h"
 
 #include "array.h"
@@ -15,6 +19,7 @@
 #include "opengl.h"
 #include "pause.h"
 #include "player.h"
+#include "profile.h"
 #include "space.h"
 #include "spfx.h"
 #include "toolkit.h"
@@ -31,6 +36,7 @@
 typedef struct PPShader_s {
    unsigned int id; /*< Global id (greater than 0). */
    int priority; /**< Used when sorting, lower is more important. */
+   unsigned int flags; /**< Flags like PP_SHADER_HALF. */
    double dt; /**< Used when computing u_time. */
    GLuint program; /**< Main shader program. */
    /* Shared uniforms. */
@@ -51,21 +57,71 @@ static unsigned int pp_shaders_id = 0;
 static PPShader *pp_shaders_list[PP_LAYER_MAX]; /**< Post-processing shaders for game layer. */
 
 
-static LuaShader_t gamma_correction_shader;
-static int pp_gamma_correction = 0; /**< Gamma correction shader. */
+/*
+ * Dynamic resolution of the game layer.
+ */
+#ifndef GL_TIME_ELAPSED
+#define GL_TIME_ELAPSED       0x88BF /**< From ARB_timer_query, not in our GL headers. */
+#endif /* GL_TIME_ELAPSED */
+#define DYNRES_FRAMES   4 /**< Frames to wait before reading a GPU timing. */
+#define DYNRES_ADJUST   15 /**< Frames between changes of scale. */
+#define DYNRES_STEP     0.05 /**< Change of scale at a time. */
+#define DYNRES_BUDGET   0.6 /**< Part of the frame the game layer may take on the GPU. */
+#define DYNRES_SMOOTH   0.1 /**< Smoothing of the GPU time. */
+static int dynres_queriesOK = 0; /**< Timer queries are supported. */
+static GLuint dynres_queries[DYNRES_FRAMES]; /**< Timer queries of the game layer. */
+static int dynres_used[DYNRES_FRAMES]; /**< Queries issued. */
+static int dynres_slot     = 0; /**< Query being issued this frame. */
+static int dynres_timing   = 0; /**< Own query running this frame. */
+static double dynres_scale = 1.; /**< Current scale of the game layer. */
+static double dynres_ms    = 0.; /**< Smoothed GPU time of the game layer (ms). */
+static int dynres_frames   = 0; /**< Frames since the scale changed. */
+
+
+static double pp_gamma = 1.; /**< Gamma correction, 1 is none. */
+static int pp_colorblind = 0; /**< Whether the colorblind simulation is enabled. */
+static unsigned int pp_colour = 0; /**< Shader doing the gamma and colorblind pass. */
+
+
+/*
+ * Prototypes.
+ */
+static void render_fbo( double dt, GLuint fbo, GLuint tex, PPShader *shader );
+static void render_fbo_list( double dt, PPShader *list, int *current, int done );
+static int ppshader_compare( const void *a, const void *b );
+static void render_updateColour (void);
+static int render_dynresBegin( int *sw, int *sh );
+static void render_dynresEnd( int scaled, int sw, int sh );
+static void render_dynresUpdate( double ms );
 
 
 /**
  * @brief Renders an FBO.
+ *
+ * Shaders flagged with PP_SHADER_HALF are rendered to the half resolution
+ *  framebuffer, which is then scaled up into the target.
  */
 static void render_fbo( double dt, GLuint fbo, GLuint tex, PPShader *shader )
 {
+   int half, hw, hh;
+
+   /* Multisampled screens can't be blitted into. */
+   half = (shader->flags & PP_SHADER_HALF) && ((fbo != 0) || (gl_screen.fsaa <= 1));
+   hw   = MAX( 1, gl_screen.rw/2 );
+   hh   = MAX( 1, gl_screen.rh/2 );
+
    /* Have to consider alpha premultiply. */
-   glBlendFuncSeparate( GL_ONE, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA );
+   gl_blendFuncSeparate( GL_ONE, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA );
 
-   glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+   if (half) {
+      glBindFramebuffer(GL_FRAMEBUFFER, gl_screen.fbo_half);
+      glViewport( 0, 0, hw, hh );
+      glClear( GL_COLOR_BUFFER_BIT );
+   }
+   else
+      glBindFramebuffer(GL_FRAMEBUFFER, fbo);
 
-   glUseProgram( shader->program );
+   gl_useProgram( shader->program );
 
    /* Screen size. */
    if (shader->love_ScreenSize >= 0)
@@ -87,30 +143,40 @@ static void render_fbo( double dt, GLuint fbo, GLuint tex, PPShader *shader )
    }
 
    /* Set the texture(s). */
-   glBindTexture( GL_TEXTURE_2D, tex );
+   gl_bindTexture( GL_TEXTURE_2D, tex );
    glUniform1i( shader->MainTex, 0 );
    for (int i=0; i<array_size(shader->tex); i++) {
       LuaTexture_t *t = &shader->tex[i];
-      glActiveTexture( t->active );
-      glBindTexture( GL_TEXTURE_2D, t->texid );
+      gl_activeTexture( t->active );
+      gl_bindTexture( GL_TEXTURE_2D, t->texid );
       glUniform1i( t->uniform, t->value );
    }
-   glActiveTexture( GL_TEXTURE0 );
+   gl_activeTexture( GL_TEXTURE0 );
 
    /* Set shader uniforms. */
    gl_Matrix4_Uniform(shader->ClipSpaceFromLocal, gl_Matrix4_Ortho(0, 1, 1, 0, 1, -1));
 
    /* Draw. */
-   glDrawArrays( GL_TRIANGLE_STRIP, 0, 4 );
+   gl_drawArrays( GL_TRIANGLE_STRIP, 0, 4 );
 
    /* Clear state. */
    glDisableVertexAttribArray( shader->VertexPosition );
    if (shader->VertexTexCoord >= 0)
       glDisableVertexAttribArray( shader->VertexTexCoord );
-   glUseProgram( 0 );
+   gl_useProgram( 0 );
+
+   /* Scale up into the target, blitting ignores blending. */
+   if (half) {
+      glViewport( 0, 0, gl_screen.rw, gl_screen.rh );
+      glBindFramebuffer( GL_READ_FRAMEBUFFER, gl_screen.fbo_half );
+      glBindFramebuffer( GL_DRAW_FRAMEBUFFER, fbo );
+      glBlitFramebuffer( 0, 0, hw, hh, 0, 0, gl_screen.rw, gl_screen.rh,
+            GL_COLOR_BUFFER_BIT, GL_LINEAR );
+      glBindFramebuffer( GL_FRAMEBUFFER, fbo );
+   }
 
    /* Restore the normal mode. */
-   glBlendFuncSeparate( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA );
+   gl_blendFuncSeparate( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA );
 }
 
 
@@ -157,6 +223,119 @@ static void render_fbo_list( double dt, PPShader *list, int *current, int done )
 }
 
 
+/**
+ * @brief Adjusts the scale of the game layer to the GPU time it takes.
+ *
+ * The cost is taken as proportional to the number of pixels, so the scale is
+ *  only raised when the predicted time is well under budget.
+ *
+ *    @param ms GPU time of the game layer a few frames back (ms).
+ */
+static void render_dynresUpdate( double ms )
+{
+   double budget, s, next;
+
+   dynres_ms += DYNRES_SMOOTH * (ms - dynres_ms);
+   if (++dynres_frames < DYNRES_ADJUST)
+      return;
+
+   /* Budget is a share of the frame at the capped rate, 60 fps if none. */
+   budget = DYNRES_BUDGET * 1000. / ((!conf.vsync && (conf.fps_max > 0)) ? conf.fps_max : 60.);
+   s      = dynres_scale;
+   if (dynres_ms > budget)
+      s -= DYNRES_STEP;
+   else {
+      next = MIN( 1., s + DYNRES_STEP );
+      if (dynres_ms * pow2( next / s ) < 0.8 * budget)
+         s = next;
+   }
+   s = CLAMP( CLAMP( 0.25, 1., conf.dynres_min ), 1., s );
+
+   if (s != dynres_scale) {
+      dynres_scale  = s;
+      dynres_frames = 0;
+   }
+   else /* Check again soon. */
+      dynres_frames = DYNRES_ADJUST/2;
+}
+
+
+/**
+ * @brief Starts rendering the game layer, at a lower resolution if needed.
+ *
+ *    @param[out] sw Width drawn to.
+ *    @param[out] sh Height drawn to.
+ *    @return 1 if drawing to the scaled framebuffer.
+ */
+static int render_dynresBegin( int *sw, int *sh )
+{
+   GLuint ready, ns;
+   double ms;
+
+   dynres_timing = 0;
+   if (!conf.dynres) {
+      dynres_scale = 1.;
+      return 0;
+   }
+
+#ifdef PROFILING
+   /* Queries can't nest, so use the profiler's if it's timing the GPU. */
+   if (profile_gpuGame( &ms ) == 0)
+      render_dynresUpdate( ms );
+   else
+#endif /* PROFILING */
+   if (dynres_queriesOK) {
+      /* Read the query about to be reused, skip it rather than stall. */
+      dynres_slot = (dynres_slot+1) % DYNRES_FRAMES;
+      if (dynres_used[dynres_slot]) {
+         glGetQueryObjectuiv( dynres_queries[dynres_slot], GL_QUERY_RESULT_AVAILABLE, &ready );
+         if (ready) {
+            glGetQueryObjectuiv( dynres_queries[dynres_slot], GL_QUERY_RESULT, &ns );
+            ms = (double)ns / 1e6;
+            render_dynresUpdate( ms );
+         }
+      }
+      glBeginQuery( GL_TIME_ELAPSED, dynres_queries[dynres_slot] );
+      dynres_used[dynres_slot] = 1;
+      dynres_timing = 1;
+   }
+
+   /* Multisampled screens can't be blitted into. */
+   if ((dynres_scale >= 1.) || (gl_screen.fbo_game == GL_INVALID_VALUE) ||
+         ((gl_screen.current_fbo == 0) && (gl_screen.fsaa > 1)))
+      return 0;
+
+   *sw = MAX( 1, (int)round( gl_screen.rw * dynres_scale ) );
+   *sh = MAX( 1, (int)round( gl_screen.rh * dynres_scale ) );
+   glBindFramebuffer( GL_FRAMEBUFFER, gl_screen.fbo_game );
+   glViewport( 0, 0, *sw, *sh );
+   glClear( GL_COLOR_BUFFER_BIT );
+   return 1;
+}
+
+
+/**
+ * @brief Finishes rendering the game layer, scaling it up if needed.
+ *
+ *    @param scaled Whether the scaled framebuffer was drawn to.
+ *    @param sw Width drawn to.
+ *    @param sh Height drawn to.
+ */
+static void render_dynresEnd( int scaled, int sw, int sh )
+{
+   if (scaled) {
+      glViewport( 0, 0, gl_screen.rw, gl_screen.rh );
+      glBindFramebuffer( GL_READ_FRAMEBUFFER, gl_screen.fbo_game );
+      glBindFramebuffer( GL_DRAW_FRAMEBUFFER, gl_screen.current_fbo );
+      glBlitFramebuffer( 0, 0, sw, sh, 0, 0, gl_screen.rw, gl_screen.rh,
+            GL_COLOR_BUFFER_BIT, GL_LINEAR );
+      glBindFramebuffer( GL_FRAMEBUFFER, gl_screen.current_fbo );
+   }
+   if (dynres_timing)
+      glEndQuery( GL_TIME_ELAPSED );
+}
+
+
 /**
  * @brief Renders the game itself (player flying around and friends).
  *
@@ -180,6 +359,8 @@ void render_all( double game_dt, double real_dt )
    double dt;
    int pp_final, pp_gui, pp_game;
    int cur = 0;
+   int scaled, sw, sh;
+   GLuint target;
 
    /* See what post-processing is up. */
    pp_game  = (array_size(pp_shaders_list[PP_LAYER_GAME]) > 0);
@@ -208,11 +389,31 @@ void render_all( double game_dt, double real_dt )
 
    dt = (paused) ? 0. : game_dt;
 
+   PROFILE_BEGIN( PROFILE_RENDER );
+
+   /* Shared shader state. */
+   gl_globalsFrame( real_dt );
+
+   /* The game layer may be drawn at a lower resolution and scaled up. */
+   target = gl_screen.current_fbo;
+   sw     = gl_screen.rw;
+   sh     = gl_screen.rh;
+   scaled = render_dynresBegin( &sw, &sh );
+   if (scaled)
+      gl_screen.current_fbo = gl_screen.fbo_game;
+
    /* Background stuff */
+   PROFILE_GPU_BEGIN( PROFILE_GPU_NEBULA );
    space_render( real_dt ); /* Nebula looks really weird otherwise. */
+   PROFILE_GPU_END();
+   PROFILE_GPU_BEGIN( PROFILE_GPU_BACKGROUND );
    hooks_run( "renderbg" );
    planets_render();
+   PROFILE_GPU_END();
+   PROFILE_GPU_BEGIN( PROFILE_GPU_TRAILS );
    spfx_render(SPFX_LAYER_BACK);
+   PROFILE_GPU_END();
+   PROFILE_GPU_BEGIN( PROFILE_GPU_GAME );
    weapons_render(WEAPON_LAYER_BG, dt);
    /* Middle stuff */
    pilots_render(dt);
@@ -225,25 +426,44 @@ void render_all( double game_dt, double real_dt )
    gui_renderReticles(dt);
    pilots_renderOverlay(dt);
    hooks_run( "renderfg" );
+   PROFILE_GPU_END();
+
+   gl_screen.current_fbo = target;
+   render_dynresEnd( scaled, sw, sh );
 
    /* Process game stuff only. */
-   if (pp_game)
+   if (pp_game) {
+      PROFILE_GPU_BEGIN( PROFILE_GPU_PP_GAME );
       render_fbo_list( dt, pp_shaders_list[PP_LAYER_GAME], &cur, !(pp_final || pp_gui) );
+      PROFILE_GPU_END();
+   }
 
    /* GUi stuff. */
+   PROFILE_GPU_BEGIN( PROFILE_GPU_GUI );
    gui_render(dt);
+   PROFILE_GPU_END();
 
-   if (pp_gui)
+   if (pp_gui) {
+      PROFILE_GPU_BEGIN( PROFILE_GPU_PP_GUI );
       render_fbo_list( dt, pp_shaders_list[PP_LAYER_GUI], &cur, !pp_final );
+      PROFILE_GPU_END();
+   }
 
    /* Top stuff. */
+   PROFILE_GPU_BEGIN( PROFILE_GPU_OVERLAY );
    ovr_render(dt);
    display_fps( real_dt ); /* Exception using real_dt. */
    toolkit_render();
+   PROFILE_GPU_END();
 
    /* Final post-processing. */
-   if (pp_final)
+   if (pp_final) {
+      PROFILE_GPU_BEGIN( PROFILE_GPU_PP_FINAL );
       render_fbo_list( dt, pp_shaders_list[PP_LAYER_FINAL], &cur, 1 );
+      PROFILE_GPU_END();
+   }
+
+   PROFILE_END( PROFILE_RENDER );
 
    /* check error every loop */
    gl_checkErr();
@@ -270,10 +490,12 @@ static int ppshader_compare( const void *a, const void *b )
  * @brief Adds a new post-processing shader.
  *
  *    @param shader Shader to add.
+ *    @param layer Layer to add the shader to.
  *    @param priority When it should be run (lower is sooner).
+ *    @param flags Flags like PP_SHADER_HALF.
  *    @return The shader ID.
  */
-unsigned int render_postprocessAdd( LuaShader_t *shader, int layer, int priority )
+unsigned int render_postprocessAdd( LuaShader_t *shader, int layer, int priority, unsigned int flags )
 {
    PPShader *pp, **pp_shaders;
    unsigned int id;
@@ -291,6 +513,7 @@ unsigned int render_postprocessAdd( LuaShader_t *shader, int layer, int priority
    id = ++pp_shaders_id;
    pp->id               = id;
    pp->priority         = priority;
+   pp->flags            = flags;
    pp->program          = shader->program;
    pp->ClipSpaceFromLocal = shader->ClipSpaceFromLocal;
    pp->MainTex          = shader->MainTex;
@@ -354,13 +577,13 @@ int render_postprocessRm( unsigned int id )
  */
 void render_init (void)
 {
-   LuaShader_t *s;
-   s = &gamma_correction_shader;
-   memset( s, 0, sizeof(LuaShader_t) );
-   s->program            = shaders.gamma_correction.program;
-   s->VertexPosition     = shaders.gamma_correction.VertexPosition;
-   s->ClipSpaceFromLocal = shaders.gamma_correction.ClipSpaceFromLocal;
-   s->MainTex            = shaders.gamma_correction.MainTex;
+   /* Timer queries are core since 3.3. */
+   dynres_queriesOK = ((GLVersion.major > 3) ||
+         ((GLVersion.major == 3) && (GLVersion.minor >= 3)) ||
+         SDL_GL_ExtensionSupported( "GL_ARB_timer_query" ));
+   if (dynres_queriesOK)
+      glGenQueries( DYNRES_FRAMES, dynres_queries );
+   memset( dynres_used, 0, sizeof(dynres_used) );
 
    /* Initialize the gamma. */
    render_setGamma( conf.gamma_correction );
@@ -377,26 +600,81 @@ void render_exit (void)
       array_free( pp_shaders_list[i] );
       pp_shaders_list[i] = NULL;
    }
+   if (dynres_queriesOK)
+      glDeleteQueries( DYNRES_FRAMES, dynres_queries );
+   dynres_queriesOK = 0;
 }
 
 
 /**
- * @brief Sets the gamma.
+ * @brief Sets up the pass doing the gamma correction and colorblind simulation.
+ *
+ * Both are per pixel, so when both are enabled they are fused into a single
+ *  shader instead of taking two full screen passes.
  */
-void render_setGamma( double gamma )
+static void render_updateColour (void)
 {
-   if (pp_gamma_correction > 0) {
-      render_postprocessRm( pp_gamma_correction );
-      pp_gamma_correction = 0;
+   LuaShader_t s;
+   int gamma;
+
+   if (pp_colour > 0) {
+      render_postprocessRm( pp_colour );
+      pp_colour = 0;
    }
 
    /* Ignore small gamma. */
-   if (fabs(gamma-1.) < 1e-3)
-      return;
+   gamma = (fabs(pp_gamma-1.) >= 1e-3);
+
+   memset( &s, 0, sizeof(LuaShader_t) );
+   if (gamma && pp_colorblind) {
+      s.program            = shaders.colorblind_gamma.program;
+      s.VertexPosition     = shaders.colorblind_gamma.VertexPosition;
+      s.ClipSpaceFromLocal = shaders.colorblind_gamma.ClipSpaceFromLocal;
+      s.MainTex            = shaders.colorblind_gamma.MainTex;
+      gl_useProgram( s.program );
+      glUniform1f( shaders.colorblind_gamma.gamma, pp_gamma );
+      gl_useProgram( 0 );
+      pp_colour = render_postprocessAdd( &s, PP_LAYER_FINAL, 99, 0 );
+   }
+   else if (pp_colorblind) {
+      s.program            = shaders.colorblind.program;
+      s.VertexPosition     = shaders.colorblind.VertexPosition;
+      s.ClipSpaceFromLocal = shaders.colorblind.ClipSpaceFromLocal;
+      s.MainTex            = shaders.colorblind.MainTex;
+      pp_colour = render_postprocessAdd( &s, PP_LAYER_FINAL, 99, 0 );
+   }
+   else if (gamma) {
+      s.program            = shaders.gamma_correction.program;
+      s.VertexPosition     = shaders.gamma_correction.VertexPosition;
+      s.ClipSpaceFromLocal = shaders.gamma_correction.ClipSpaceFromLocal;
+      s.MainTex            = shaders.gamma_correction.MainTex;
+      gl_useProgram( s.program );
+      glUniform1f( shaders.gamma_correction.gamma, pp_gamma );
+      gl_useProgram( 0 );
+      pp_colour = render_postprocessAdd( &s, PP_LAYER_FINAL, 98, 0 );
+   }
+}
+
+
+/**
+ * @brief Sets the gamma.
+ *
+ *    @param gamma Gamma to use, 1 is no correction.
+ */
+void render_setGamma( double gamma )
+{
+   pp_gamma = gamma;
+   render_updateColour();
+}
 
-   /* Set gamma and upload. */
-   glUseProgram( shaders.gamma_correction.program );
-   glUniform1f( shaders.gamma_correction.gamma, gamma );
-   glUseProgram( 0 );
-   pp_gamma_correction = render_postprocessAdd( &gamma_correction_shader, PP_LAYER_FINAL, 98 );
+
+/**
+ * @brief Enables or disables the colorblind simulation.
+ *
+ *    @param enable Whether or not to enable it.
+ */
+void render_setColorblind( int enable )
+{
+   pp_colorblind = enable;
+   render_updateColour();
 }
@@ -17,17 +17,20 @@ enum {
    PP_LAYER_MAX,
 };
 
+#define PP_SHADER_HALF     (1<<0) /**< Shader can be run at half resolution, for blurs and such. */
+
 
 void fps_setPos( double x, double y );
 void render_all( double game_dt, double real_dt );
 void render_init (void);
 void render_exit (void);
 
-unsigned int render_postprocessAdd( LuaShader_t *shader, int layer, int priority );
+unsigned int render_postprocessAdd( LuaShader_t *shader, int layer, int priority, unsigned int flags );
 int render_postprocessRm( unsigned int id );
 
 /* Special post-processing shaders. */
 void render_setGamma( double gamma );
+void render_setColorblind( int enable );
 
 
 #endif /* RENDER_H */
@@ -0,0 +1,352 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+
+/**
+ * @file replay.c
+ *
+ * @brief Records sessions and plays them back to reproduce performance issues.
+ *
+ * A replay starts once the main menu is reached. When recording, the random
+ *  numbers are seeded with a fresh seed, and the length of every frame and the
+ *  input events handled by input_handle() are written to a binary stream:
+ *
+ *  - Header: "NRPL", format version and seed (little endian 32 bit).
+ *  - 'F' records: frame length as a double and checksum of the random state.
+ *  - 'E' records: event type followed by the event structure.
+ *
+ * Playing back seeds the random numbers the same way, ignores the live input
+ *  and feeds the recorded events to the game between the same frames as they
+ *  were handled, with the recorded frame lengths. The frame rate cap is
+ *  disabled so the replay runs as fast as the machine allows, and the wall
+ *  time of the frames is reported once it ends. Together with --headless and
+ *  the profiler this gives repeatable profiles of a reported session.
+ *
+ * The replay only matches the recording when started with the same data,
+ *  configuration and saved games. The checksum of the random state is used to
+ *  warn when the playback diverges, which can happen with threaded AI or
+ *  anything depending on the wall clock.
+ */
+
+
+/** @cond */
+#include <stdint.h>
+#include <string.h>
+#include "SDL.h"
+
+#include "naev.h"
+/** @endcond */
+
+#include "replay.h"
+
+#include "conf.h"
+#include "input.h"
+#include "log.h"
+#include "profile.h"
+#include "rng.h"
+
+
+#define REPLAY_MAGIC    "NRPL" /**< Identifies replay files. */
+#define REPLAY_VERSION  1 /**< Version of the replay format. */
+
+#define REPLAY_FRAME    'F' /**< Frame record. */
+#define REPLAY_EVENT    'E' /**< Input event record. */
+
+
+/**
+ * @brief What the replay subsystem is doing.
+ */
+typedef enum ReplayMode_ {
+   REPLAY_NONE, /**< Not active. */
+   REPLAY_RECORD, /**< Recording a session. */
+   REPLAY_PLAY /**< Playing back a session. */
+} ReplayMode;
+
+
+static ReplayMode replay_mode = REPLAY_NONE; /**< Current mode. */
+static SDL_RWops *replay_rw   = NULL; /**< Stream being recorded or played. */
+static int replay_dispatching = 0; /**< Recorded events are being handled. */
+static int replay_desync      = 0; /**< Playback went out of sync. */
+static unsigned int replay_frames = 0; /**< Frames recorded or played. */
+static Uint64 replay_start    = 0; /**< Counter when the playback started. */
+static Uint64 replay_last     = 0; /**< Counter when the last frame started. */
+static Uint64 replay_worst    = 0; /**< Longest frame played back. */
+
+
+/*
+ * Prototypes.
+ */
+static size_t replay_eventSize( Uint32 type );
+static void replay_end (void);
+
+
+/**
+ * @brief Gets the size of the recorded structure of an event type.
+ *
+ *    @param type Type of the event.
+ *    @return Size of the structure or 0 if not recorded.
+ */
+static size_t replay_eventSize( Uint32 type )
+{
+   SDL_Event *e = NULL;
+   switch (type) {
+      case SDL_KEYDOWN:
+      case SDL_KEYUP:
+         return sizeof(e->key);
+      case SDL_TEXTINPUT:
+         return sizeof(e->text);
+      case SDL_MOUSEMOTION:
+         return sizeof(e->motion);
+      case SDL_MOUSEBUTTONDOWN:
+      case SDL_MOUSEBUTTONUP:
+         return sizeof(e->button);
+      case SDL_MOUSEWHEEL:
+         return sizeof(e->wheel);
+      case SDL_JOYAXISMOTION:
+         return sizeof(e->jaxis);
+      case SDL_JOYBUTTONDOWN:
+      case SDL_JOYBUTTONUP:
+         return sizeof(e->jbutton);
+      case SDL_JOYHATMOTION:
+         return sizeof(e->jhat);
+      default:
+         return 0;
+   }
+}
+
+
+/**
+ * @brief Starts recording or playing back as set in the configuration.
+ *
+ * Failing to open a replay for playback quits, as there is nothing to run.
+ *
+ *    @return 0 on success.
+ */
+int replay_init (void)
+{
+   char magic[4];
+   Uint32 version, seed;
+
+   if (conf.replay != NULL) {
+      replay_rw = SDL_RWFromFile( conf.replay, "rb" );
+      if (replay_rw == NULL) {
+         WARN(_("Unable to open replay '%s': %s"), conf.replay, SDL_GetError());
+         naev_quit();
+         return -1;
+      }
+      version = 0;
+      if ((SDL_RWread( replay_rw, magic, sizeof(magic), 1 ) != 1) ||
+            (memcmp( magic, REPLAY_MAGIC, sizeof(magic) ) != 0) ||
+            ((version = SDL_ReadLE32( replay_rw )) != REPLAY_VERSION)) {
+         WARN(_("'%s' is not a replay of version %d (got %u)!"),
+               conf.replay, REPLAY_VERSION, version);
+         SDL_RWclose( replay_rw );
+         replay_rw = NULL;
+         naev_quit();
+         return -1;
+      }
+      seed = SDL_ReadLE32( replay_rw );
+      rng_seed( seed );
+
+      replay_mode    = REPLAY_PLAY;
+      replay_frames  = 0;
+      replay_desync  = 0;
+      replay_worst   = 0;
+      replay_start   = SDL_GetPerformanceCounter();
+      replay_last    = replay_start;
+      LOG(_("Playing back replay '%s' with seed %u."), conf.replay, seed);
+
+      /* Input handled before the first frame. */
+      replay_events();
+   }
+   else if (conf.record != NULL) {
+      replay_rw = SDL_RWFromFile( conf.record, "wb" );
+      if (replay_rw == NULL) {
+         WARN(_("Unable to open replay '%s' for writing: %s"), conf.record, SDL_GetError());
+         return -1;
+      }
+      seed = randint();
+      rng_seed( seed );
+      SDL_RWwrite( replay_rw, REPLAY_MAGIC, 4, 1 );
+      SDL_WriteLE32( replay_rw, REPLAY_VERSION );
+      SDL_WriteLE32( replay_rw, seed );
+
+      replay_mode    = REPLAY_RECORD;
+      replay_frames  = 0;
+      LOG(_("Recording replay '%s' with seed %u."), conf.record, seed);
+   }
+
+   return 0;
+}
+
+
+/**
+ * @brief Stops recording or playing back.
+ */
+void replay_exit (void)
+{
+   if (replay_mode == REPLAY_RECORD)
+      LOG(_("Recorded %u frames to replay '%s'."), replay_frames, conf.record);
+   if (replay_rw != NULL)
+      SDL_RWclose( replay_rw );
+   replay_rw   = NULL;
+   replay_mode = REPLAY_NONE;
+}
+
+
+/**
+ * @brief Checks to see if a session is being recorded.
+ */
+int replay_isRecording (void)
+{
+   return (replay_mode == REPLAY_RECORD);
+}
+
+
+/**
+ * @brief Checks to see if a replay is being played back.
+ */
+int replay_isPlaying (void)
+{
+   return (replay_mode == REPLAY_PLAY);
+}
+
+
+/**
+ * @brief Ends the playback, reporting the timings and quitting.
+ */
+static void replay_end (void)
+{
+   double freq, elapsed, worst;
+
+   freq     = (double)SDL_GetPerformanceFrequency() / 1000.;
+   elapsed  = (double)(SDL_GetPerformanceCounter() - replay_start) / freq;
+   worst    = (double)replay_worst / freq;
+   LOG(_("Replay done: %u frames in %.1f ms, %.3f ms per frame, %.3f ms worst frame."),
+         replay_frames, elapsed, elapsed / MAX( 1, replay_frames ), worst );
+   if (replay_desync)
+      LOG(_("Replay went out of sync, timings may not be representative."));
+#ifdef PROFILING
+   profile_report();
+#endif /* PROFILING */
+
+   replay_exit();
+   naev_quit();
+}
+
+
+/**
+ * @brief Starts a frame.
+ *
+ * When recording the length of the frame is written, when playing back it
+ *  gets replaced with the recorded one.
+ *
+ *    @param[in,out] dt Real length of the frame.
+ */
+void replay_frame( double *dt )
+{
+   Uint64 bits, now;
+   Uint32 check;
+   Uint8 tag;
+   double rdt;
+
+   if (replay_mode == REPLAY_RECORD) {
+      memcpy( &bits, dt, sizeof(bits) );
+      tag = REPLAY_FRAME;
+      SDL_RWwrite( replay_rw, &tag, 1, 1 );
+      SDL_WriteLE64( replay_rw, bits );
+      SDL_WriteLE32( replay_rw, rng_checksum() );
+      replay_frames++;
+      return;
+   }
+   if (replay_mode != REPLAY_PLAY)
+      return;
+
+   /* Out of frames. */
+   if ((SDL_RWread( replay_rw, &tag, 1, 1 ) != 1) || (tag != REPLAY_FRAME)) {
+      replay_end();
+      return;
+   }
+   bits  = SDL_ReadLE64( replay_rw );
+   check = SDL_ReadLE32( replay_rw );
+   memcpy( &rdt, &bits, sizeof(rdt) );
+   *dt   = rdt;
+
+   if (!replay_desync && (check != rng_checksum())) {
+      WARN(_("Replay out of sync at frame %u!"), replay_frames);
+      replay_desync = 1;
+   }
+
+   now = SDL_GetPerformanceCounter();
+   if (replay_frames > 0)
+      replay_worst = MAX( replay_worst, now - replay_last );
+   replay_last = now;
+   replay_frames++;
+}
+
+
+/**
+ * @brief Handles the recorded events up to the next frame.
+ */
+void replay_events (void)
+{
+   SDL_Event event;
+   Uint32 type;
+   size_t size;
+   Uint8 tag;
+
+   if (replay_mode != REPLAY_PLAY)
+      return;
+
+   while (SDL_RWread( replay_rw, &tag, 1, 1 ) == 1) {
+      if (tag != REPLAY_EVENT) {
+         SDL_RWseek( replay_rw, -1, RW_SEEK_CUR );
+         return;
+      }
+      type = SDL_ReadLE32( replay_rw );
+      size = replay_eventSize( type );
+      memset( &event, 0, sizeof(event) );
+      if ((size == 0) || (SDL_RWread( replay_rw, &event, size, 1 ) != 1)) {
+         WARN(_("Replay '%s' is corrupt!"), conf.replay);
+         SDL_RWseek( replay_rw, 0, RW_SEEK_END );
+         return;
+      }
+      event.type = type;
+
+      /* Handling an event can run frames of its own through dialogues. */
+      replay_dispatching = 1;
+      input_handle( &event );
+      replay_dispatching = 0;
+
+      /* A frame may have ended the playback. */
+      if (replay_mode != REPLAY_PLAY)
+         return;
+   }
+}
+
+
+/**
+ * @brief Records an input event or filters out live input when playing back.
+ *
+ *    @param event Event being handled by input_handle().
+ *    @return 1 if the event should be ignored.
+ */
+int replay_input( const SDL_Event *event )
+{
+   size_t size;
+   Uint8 tag;
+
+   if (replay_mode == REPLAY_PLAY)
+      return !replay_dispatching;
+   if (replay_mode != REPLAY_RECORD)
+      return 0;
+
+   size = replay_eventSize( event->type );
+   if (size == 0)
+      return 0;
+   tag = REPLAY_EVENT;
+   SDL_RWwrite( replay_rw, &tag, 1, 1 );
+   SDL_WriteLE32( replay_rw, event->type );
+   SDL_RWwrite( replay_rw, event, size, 1 );
+   return 0;
+}
@@ -0,0 +1,30 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+
+
+
+#ifndef REPLAY_H
+#  define REPLAY_H
+
+
+/** @cond */
+#include "SDL.h"
+/** @endcond */
+
+
+/* Set up. */
+int replay_init (void);
+void replay_exit (void);
+
+/* State. */
+int replay_isRecording (void);
+int replay_isPlaying (void);
+
+/* Frames. */
+void replay_frame( double *dt );
+void replay_events (void);
+int replay_input( const SDL_Event *event );
+
+
+#endif /* REPLAY_H */
@@ -43,6 +43,12 @@ static uint32_t MT[624]; /**< Mersenne twister state. */
 static uint32_t mt_y; /**< Internal mersenne twister variable. */
 static int mt_pos = 0; /**< Current number being used. */
 
+/*
+ * streams
+ */
+RNGStream rng_cosmetic; /**< Stream for draws that don't affect the simulation. */
+static uint64_t rng_streamSeed = 0; /**< Seed all the streams derive from. */
+
 
 /*
  * prototypes
@@ -52,6 +58,8 @@ static uint32_t rng_timeEntropy (void);
 static void mt_initArray( uint32_t seed );
 static void mt_genArray (void);
 static uint32_t mt_getInt (void);
+/* streams */
+static uint64_t rng_mix64( uint64_t z );
 
 
 /**
@@ -86,6 +94,50 @@ void rng_init (void)
       mt_initArray( i );
    for (i=0; i<10; i++) /* generate numbers to get away from poor initial values */
       mt_genArray();
+
+   /* Streams derive from the twister so they are just as random. */
+   rng_streamSeed = ((uint64_t)mt_getInt() << 32) | mt_getInt();
+   rngs_seed( &rng_cosmetic, RNG_STREAM_COSMETIC );
+}
+
+
+/**
+ * @brief Seeds the random subsystem so the numbers can be repeated.
+ *
+ *    @param seed Seed to use.
+ */
+void rng_seed( uint32_t seed )
+{
+   int i;
+   mt_initArray( seed );
+   for (i=0; i<10; i++)
+      mt_genArray();
+
+   rng_streamSeed = seed;
+   rngs_seed( &rng_cosmetic, RNG_STREAM_COSMETIC );
+}
+
+
+/**
+ * @brief Gets a checksum of the random state without advancing it.
+ *
+ * Used to detect replays going out of sync.
+ *
+ *    @return Checksum of the state (FNV-1a).
+ */
+uint32_t rng_checksum (void)
+{
+   int i;
+   uint32_t h;
+
+   h = 2166136261U;
+   for (i=0; i<624; i++) {
+      h ^= MT[i];
+      h *= 16777619U;
+   }
+   h ^= (uint32_t) mt_pos;
+   h *= 16777619U;
+   return h;
 }
 
 
@@ -199,6 +251,57 @@ double randfp (void)
 }
 
 
+/**
+ * @brief Mixes the bits of a number (splitmix64 finaliser).
+ */
+static uint64_t rng_mix64( uint64_t z )
+{
+   z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+   z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+   return z ^ (z >> 31);
+}
+
+
+/**
+ * @brief Seeds a random stream.
+ *
+ * The stream depends on the last seed given to the random subsystem, so
+ *  seeding it with rng_seed() makes all the streams repeatable too.
+ *
+ *    @param s Stream to seed.
+ *    @param stream Number of the stream, different numbers are independent.
+ */
+void rngs_seed( RNGStream *s, uint64_t stream )
+{
+   s->key = rng_mix64( rng_streamSeed ^ rng_mix64( stream + 0x9E3779B97F4A7C15ULL ) );
+   s->ctr = 0;
+}
+
+
+/**
+ * @brief Gets a random integer from a stream.
+ *
+ *    @param s Stream to draw from.
+ *    @return A random 4 byte number.
+ */
+uint32_t rngs_int( RNGStream *s )
+{
+   return (uint32_t)(rng_mix64( s->key + (s->ctr++) * 0x9E3779B97F4A7C15ULL ) >> 32);
+}
+
+
+/**
+ * @brief Gets a random float between 0 and 1 (inclusive) from a stream.
+ *
+ *    @param s Stream to draw from.
+ *    @return A random float between 0 and 1 (inclusive).
+ */
+double rngs_fp( RNGStream *s )
+{
+   return (double)rngs_int( s ) / m_div;
+}
+
+
 /**
  * @fn double Normal( double x )
  *
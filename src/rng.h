@@ -8,6 +8,11 @@
 #  define RNG_H
 
 
+/** @cond */
+#include <stdint.h>
+/** @endcond */
+
+
 /**
  * @brief Gets a random number between L and H (L <= RNG <= H).
  *
@@ -44,13 +49,69 @@
 #define RNG_3SIGMA()       NormalInverse(0.0013498985 + RNGF()*(1.-0.0013498985*2.))
 
 
+/**
+ * @brief Independent random stream.
+ *
+ * Counter-based, so the n-th number only depends on the key and n. Streams
+ *  are cheap to seed and each one can be used from a different thread.
+ */
+typedef struct RNGStream_ {
+   uint64_t key; /**< Key derived from the seed and stream number. */
+   uint64_t ctr; /**< Numbers drawn so far. */
+} RNGStream;
+
+/**
+ * @brief Stream numbers, pilot streams are offset by the pilot id.
+ */
+#define RNG_STREAM_COSMETIC   1 /**< Visual and audio effects. */
+#define RNG_STREAM_PILOT      0x100 /**< First pilot stream. */
+
+extern RNGStream rng_cosmetic; /**< Stream for draws that don't affect the simulation. */
+
+/**
+ * @brief Gets a random number between L and H from stream S (L <= RNG <= H).
+ */
+#define RNGS(S,L,H)  (((L)>(H)) ? RNGS_BASE((S),(H),(L)) : RNGS_BASE((S),(L),(H)))
+/**
+ * @brief Gets a number between L and H from stream S, unspecified if L > H.
+ */
+#define RNGS_BASE(S,L,H) ((int)L + (int)((double)(H-L+1) * rngs_fp(S)))
+/**
+ * @brief Gets a random float between 0 and 1 from stream S.
+ */
+#define RNGSF(S)     (rngs_fp(S))
+/**
+ * @brief Gets a random mu within two-sigma from stream S.
+ */
+#define RNGS_2SIGMA(S)     NormalInverse(0.022750132 + RNGSF(S)*(1.-0.022750132*2.))
+/**
+ * @brief Gets a random number between L and H for cosmetic use.
+ */
+#define RNG_COSMETIC(L,H)  RNGS(&rng_cosmetic,L,H)
+/**
+ * @brief Gets a random float between 0 and 1 for cosmetic use.
+ */
+#define RNGF_COSMETIC()    RNGSF(&rng_cosmetic)
+/**
+ * @brief Gets a random mu within two-sigma for cosmetic use.
+ */
+#define RNG_2SIGMA_COSMETIC() RNGS_2SIGMA(&rng_cosmetic)
+
+
 /* Init */
 void rng_init (void);
+void rng_seed( uint32_t seed );
+uint32_t rng_checksum (void);
 
 /* Random functions */
 unsigned int randint (void);
 double randfp (void);
 
+/* Streams */
+void rngs_seed( RNGStream *s, uint64_t stream );
+uint32_t rngs_int( RNGStream *s );
+double rngs_fp( RNGStream *s );
+
 /* Probability functions */
 double Normal( double x );
 double NormalInverse( double p );
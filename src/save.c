@@ -10,7 +10,10 @@
 
 /** @cond */
 #include <errno.h>
+#include <stdio.h>
+#include <string.h>
 #include "physfs.h"
+#include "SDL_thread.h"
 
 #include "naev.h"
 /** @endcond */
@@ -32,12 +35,31 @@
 #include "nstring.h"
 #include "nxml.h"
 #include "player.h"
+#include "savefile.h"
 #include "shiplog.h"
 #include "start.h"
+#include "threadpool.h"
 #include "unidiff.h"
 
+
+/**
+ * @brief Snapshot of a saved game waiting to be written out.
+ */
+typedef struct SaveJob_ {
+   xmlDocPtr doc; /**< Document built on the main thread. */
+   char *path; /**< Real path of the saved game. */
+   char *tmp; /**< Real path of the file written before renaming. */
+   int compress; /**< Whether or not to compress. */
+   int xml; /**< Write plain XML instead of chunks. */
+} SaveJob;
+
+
 int save_loaded   = 0; /**< Just loaded the saved game. */
 
+static SDL_mutex *save_lock   = NULL; /**< Protects save_pending. */
+static SDL_cond *save_cond    = NULL; /**< Signalled when a save is written. */
+static int save_pending       = 0; /**< Number of saves being written. */
+
 
 /*
  * prototypes
@@ -65,6 +87,7 @@ extern int economy_sysSave( xmlTextWriterPtr writer ); /**< Saves the economy st
 extern int diff_save( xmlTextWriterPtr writer ); /**< Saves the universe diffs. */
 /* static */
 static int save_data( xmlTextWriterPtr writer );
+static int save_write( void *data );
 
 
 /**
@@ -91,9 +114,78 @@ static int save_data( xmlTextWriterPtr writer )
 }
 
 
+/**
+ * @brief Writes a snapshot to disk, run from the threadpool.
+ *
+ * XML documents are written next to the saved game and then renamed over it,
+ *  so a crash while writing never leaves a truncated saved game behind.
+ *  Chunked saves do the same for full snapshots and otherwise only append.
+ *
+ *    @param data Save job to run, freed when done.
+ *    @return 0 on success.
+ */
+static int save_write( void *data )
+{
+   SaveJob *job = data;
+   int ret = 0, err;
+
+   /* Compression of XML was set when creating the document. */
+   if (job->xml)
+      err = (xmlSaveFileEnc(job->tmp, job->doc, "UTF-8") < 0);
+   else
+      err = (savefile_write(job->path, job->tmp, job->doc, job->compress) != 0);
+   if (err) {
+      WARN(_("Failed to write saved game!  You'll most likely have to restore it by copying your backup saved game over your current saved game."));
+      remove(job->tmp);
+      ret = -1;
+   }
+   else if (job->xml) {
+#ifdef _WIN32
+      /* rename() does not replace existing files on Windows. */
+      remove(job->path);
+#endif /* _WIN32 */
+      if (rename(job->tmp, job->path) != 0) {
+         WARN(_("Failed to rename '%s' to '%s': %s"), job->tmp, job->path, strerror(errno));
+         ret = -1;
+      }
+   }
+
+   xmlFreeDoc(job->doc);
+   free(job->path);
+   free(job->tmp);
+   free(job);
+
+   SDL_LockMutex(save_lock);
+   save_pending--;
+   SDL_CondBroadcast(save_cond);
+   SDL_UnlockMutex(save_lock);
+   return ret;
+}
+
+
+/**
+ * @brief Waits until the saves being written are on disk.
+ *
+ * Anything reading the saved games from disk should call this first.
+ */
+void save_sync (void)
+{
+   if (save_lock == NULL)
+      return;
+
+   SDL_LockMutex(save_lock);
+   while (save_pending > 0)
+      SDL_CondWait(save_cond, save_lock);
+   SDL_UnlockMutex(save_lock);
+}
+
+
 /**
  * @brief Saves the current game.
  *
+ * The game is serialized to a document on the main thread, which is then
+ *  written to disk in the background. Use save_sync() to wait for it.
+ *
  *    @return 0 on success.
  */
 int save_all (void)
@@ -101,13 +193,22 @@ int save_all (void)
    char file[PATH_MAX];
    xmlDocPtr doc;
    xmlTextWriterPtr writer;
+   SaveJob *job;
 
    /* Do not save if saving is off. */
    if (player_isFlag(PLAYER_NOSAVE))
       return 0;
 
+   if (save_lock == NULL) {
+      save_lock = SDL_CreateMutex();
+      save_cond = SDL_CreateCond();
+   }
+
+   /* The backup must be of the previous save, not of a partial one. */
+   save_sync();
+
    /* Create the writer. */
-   writer = xmlNewTextWriterDoc(&doc, conf.save_compress);
+   writer = xmlNewTextWriterDoc(&doc, conf.save_xml && conf.save_compress);
    if (writer == NULL) {
       ERR(_("testXmlwriterDoc: Error creating the xml writer"));
       return -1;
@@ -156,21 +257,24 @@ int save_all (void)
    }
    save_loaded = 0;
 
-   /* Critical section, if crashes here player's game gets corrupted.
-    * Luckily we have a copy just in case... */
+   /* Hand the snapshot over to be written in the background. */
    xmlFreeTextWriter(writer);
-   snprintf(file, sizeof(file), "%s/saves/%s.ns", PHYSFS_getWriteDir(), player.name); /* TODO: write via physfs */
-   if (xmlSaveFileEnc(file, doc, "UTF-8") < 0) {
-      WARN(_("Failed to write saved game!  You'll most likely have to restore it by copying your backup saved game over your current saved game."));
-      goto err;
-   }
-   xmlFreeDoc(doc);
+   job      = calloc( 1, sizeof(SaveJob) );
+   job->doc = doc;
+   job->compress = conf.save_compress;
+   job->xml = conf.save_xml;
+   asprintf( &job->path, "%s/saves/%s.ns", PHYSFS_getWriteDir(), player.name ); /* TODO: write via physfs */
+   asprintf( &job->tmp, "%s.tmp", job->path );
+   SDL_LockMutex(save_lock);
+   save_pending++;
+   SDL_UnlockMutex(save_lock);
+   if (threadpool_newJob( save_write, job ) != 0)
+      return save_write( job );
 
    return 0;
 
 err_writer:
    xmlFreeTextWriter(writer);
-err:
    xmlFreeDoc(doc);
    return -1;
 }
@@ -181,6 +285,7 @@ err:
 void save_reload (void)
 {
    char path[PATH_MAX];
+   save_sync();
    snprintf(path, sizeof(path), "saves/%s.ns", player.name);
    load_gameFile( path );
 }
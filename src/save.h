@@ -8,6 +8,7 @@
 
 
 int save_all (void);
+void save_sync (void);
 void save_reload (void);
 
 
@@ -0,0 +1,770 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+
+/**
+ * @file savefile.c
+ *
+ * @brief Chunked saved game format.
+ *
+ * A saved game is a small file header followed by chunks:
+ *
+ *  - "NAEVSAVE" magic and the format version as a little-endian uint32.
+ *  - For each chunk: a name of SAVEFILE_NAMELEN bytes, then the flags, stored
+ *    size and decoded size as little-endian uint32, then the data.
+ *
+ * The first chunk is the header with what the load menu shows, stored as
+ *  key and value strings. Each of the other chunks is one of the top level
+ *  elements of the XML document with the chunk named after it, compressed on
+ *  its own so only the needed sections have to be read and decoded. Saves
+ *  that don't start with the magic are plain XML, which is still loaded and
+ *  written when the save_xml option is set.
+ *
+ * Since version 2 the file is a journal. A full snapshot ends with a commit
+ *  chunk, and later saves of the same game append only the header and the
+ *  sections whose contents changed, followed by another commit chunk. When
+ *  reading, the last committed chunk of each name wins and chunks after the
+ *  last commit are ignored, so a save interrupted while appending falls back
+ *  to the previous one. Version 1 files have no commits and are read whole.
+ *
+ * Which sections changed is found by hashing what they serialize to, the
+ *  sections are still built every save but most of them aren't written. A
+ *  full snapshot is written again after SAVEFILE_DELTAS appends, when the
+ *  journal grows past the snapshot or when the file isn't the one last
+ *  written, which compacts the journal.
+ */
+
+
+/** @cond */
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+#include "physfs.h"
+#include "SDL_endian.h"
+
+#include "naev.h"
+/** @endcond */
+
+#include "savefile.h"
+
+#include "array.h"
+#include "log.h"
+#include "nstring.h"
+
+
+#define SAVEFILE_MAGIC        "NAEVSAVE" /**< Magic at the start of chunked saves. */
+#define SAVEFILE_MAGICLEN     8 /**< Length of the magic. */
+#define SAVEFILE_NAMELEN      32 /**< Length of the chunk names. */
+#define SAVEFILE_HEADER       "@header" /**< Name of the header chunk, not a valid element name. */
+#define SAVEFILE_COMMIT       "@commit" /**< Name of the chunk ending a snapshot or delta. */
+#define SAVEFILE_DELTAS       16 /**< Most deltas appended before writing a full snapshot. */
+
+#define SAVEFILE_COMPRESSED   (1<<0) /**< Chunk data is zlib compressed. */
+
+
+/**
+ * @brief Header of a chunk.
+ */
+typedef struct SaveChunk_ {
+   char name[SAVEFILE_NAMELEN]; /**< Name of the chunk, NUL padded. */
+   uint32_t flags; /**< Chunk flags. */
+   uint32_t size; /**< Size of the stored data. */
+   uint32_t rawsize; /**< Size of the decoded data. */
+} SaveChunk;
+
+
+/**
+ * @brief Where the current version of a chunk is in the file.
+ */
+typedef struct SaveIndex_ {
+   SaveChunk chunk; /**< Header of the chunk. */
+   PHYSFS_sint64 offset; /**< Offset of the chunk data. */
+   int pending; /**< Not committed yet. */
+} SaveIndex;
+
+
+/**
+ * @brief Hash of a section as last written.
+ */
+typedef struct SaveSection_ {
+   char name[SAVEFILE_NAMELEN]; /**< Name of the section. */
+   uint64_t hash; /**< Hash of the serialized section. */
+} SaveSection;
+
+
+/*
+ * State of the file last written, only touched by the writer which doesn't
+ * run concurrently with itself (see save_sync()).
+ */
+static char *savefile_last          = NULL; /**< Real path of the file last written. */
+static long savefile_size           = 0; /**< Size of the file when last written. */
+static long savefile_snapshot       = 0; /**< Size of the last full snapshot. */
+static int savefile_deltas          = 0; /**< Deltas appended since the snapshot. */
+static SaveSection *savefile_sections = NULL; /**< Sections as last written (array.h). */
+
+
+/*
+ * Prototypes.
+ */
+/* Writing. */
+static int savefile_writeU32( FILE *f, uint32_t n );
+static int savefile_writeChunk( FILE *f, const char *name,
+      const void *data, size_t len, int compress );
+static int savefile_writeHeader( FILE *f, xmlNodePtr root, int compress );
+static uint64_t savefile_hash( const void *data, size_t len );
+static SaveSection* savefile_section( const char *name );
+static int savefile_writeFull( const char *file, const char *tmp, xmlDocPtr doc, int compress );
+static int savefile_writeDelta( const char *file, xmlDocPtr doc, int compress );
+/* Reading. */
+static PHYSFS_File* savefile_open( const char *path );
+static int savefile_nextChunk( PHYSFS_File *f, SaveChunk *chunk );
+static char* savefile_readChunk( PHYSFS_File *f, const SaveChunk *chunk );
+static SaveIndex* savefile_index( PHYSFS_File *f );
+
+
+/**
+ * @brief Writes a little-endian uint32.
+ */
+static int savefile_writeU32( FILE *f, uint32_t n )
+{
+   n = SDL_SwapLE32( n );
+   return (fwrite( &n, sizeof(n), 1, f ) == 1) ? 0 : -1;
+}
+
+
+/**
+ * @brief Writes a chunk.
+ *
+ *    @param f File to write to.
+ *    @param name Name of the chunk.
+ *    @param data Data of the chunk.
+ *    @param len Length of the data.
+ *    @param compress Whether or not to compress the data.
+ *    @return 0 on success.
+ */
+static int savefile_writeChunk( FILE *f, const char *name,
+      const void *data, size_t len, int compress )
+{
+   char cname[SAVEFILE_NAMELEN];
+   Bytef *buf;
+   uLongf size;
+   uint32_t flags;
+   int ret;
+
+   buf   = NULL;
+   size  = len;
+   flags = 0;
+   if (compress) {
+      size = compressBound( len );
+      buf  = malloc( size );
+      if (compress2( buf, &size, data, len, Z_DEFAULT_COMPRESSION ) == Z_OK) {
+         data   = buf;
+         flags |= SAVEFILE_COMPRESSED;
+      }
+      else
+         size = len;
+   }
+
+   memset( cname, 0, sizeof(cname) );
+   strncpy( cname, name, sizeof(cname)-1 );
+   ret = 0;
+   if ((fwrite( cname, sizeof(cname), 1, f ) != 1)
+         || savefile_writeU32( f, flags )
+         || savefile_writeU32( f, size )
+         || savefile_writeU32( f, len )
+         || ((size > 0) && (fwrite( data, size, 1, f ) != 1)))
+      ret = -1;
+
+   free( buf );
+   return ret;
+}
+
+
+/**
+ * @brief Writes the header chunk from the document.
+ */
+static int savefile_writeHeader( FILE *f, xmlNodePtr root, int compress )
+{
+   nsave_t ns;
+   char *buf;
+   int len, ret;
+
+   if (load_header( &ns, root ) != 0)
+      return -1;
+
+   /* Pairs of NUL terminated strings, the %c puts the NULs in. */
+   len = asprintf( &buf,
+         "name%c%s%cversion%c%s%cdata%c%s%cplanet%c%s%c"
+         "credits%c%"PRIu64"%cdate%c%"PRId64"%c"
+         "shipname%c%s%cshipmodel%c%s%c",
+         0, (ns.name!=NULL) ? ns.name : "", 0,
+         0, (ns.version!=NULL) ? ns.version : "", 0,
+         0, (ns.data!=NULL) ? ns.data : "", 0,
+         0, (ns.planet!=NULL) ? ns.planet : "", 0,
+         0, ns.credits, 0,
+         0, ns.date, 0,
+         0, (ns.shipname!=NULL) ? ns.shipname : "", 0,
+         0, (ns.shipmodel!=NULL) ? ns.shipmodel : "", 0 );
+   ret = savefile_writeChunk( f, SAVEFILE_HEADER, buf, len, compress );
+
+   free( buf );
+   free( ns.name );
+   free( ns.version );
+   free( ns.data );
+   free( ns.planet );
+   free( ns.shipname );
+   free( ns.shipmodel );
+   return ret;
+}
+
+
+/**
+ * @brief Hashes data (FNV-1a).
+ */
+static uint64_t savefile_hash( const void *data, size_t len )
+{
+   size_t i;
+   uint64_t h = 14695981039346656037ULL;
+   const unsigned char *c = data;
+   for (i=0; i<len; i++) {
+      h ^= c[i];
+      h *= 1099511628211ULL;
+   }
+   return h;
+}
+
+
+/**
+ * @brief Gets the last written state of a section.
+ *
+ *    @return The section or NULL if it wasn't written.
+ */
+static SaveSection* savefile_section( const char *name )
+{
+   int i;
+   for (i=0; i<array_size(savefile_sections); i++)
+      if (strncmp( savefile_sections[i].name, name, SAVEFILE_NAMELEN-1 ) == 0)
+         return &savefile_sections[i];
+   return NULL;
+}
+
+
+/**
+ * @brief Writes a full snapshot next to the saved game and renames it over.
+ *
+ * A crash while writing never leaves a truncated saved game behind.
+ */
+static int savefile_writeFull( const char *file, const char *tmp, xmlDocPtr doc, int compress )
+{
+   FILE *f;
+   xmlNodePtr root, node;
+   xmlBufferPtr buf;
+   SaveSection *sec;
+   int ret;
+
+   root = xmlDocGetRootElement( doc );
+   if (root == NULL)
+      return -1;
+
+   f = fopen( tmp, "wb" );
+   if (f == NULL) {
+      WARN(_("Unable to open '%s' for writing!"), tmp);
+      return -1;
+   }
+
+   ret = 0;
+   if ((fwrite( SAVEFILE_MAGIC, SAVEFILE_MAGICLEN, 1, f ) != 1)
+         || savefile_writeU32( f, SAVEFILE_VERSION )
+         || savefile_writeHeader( f, root, compress ))
+      ret = -1;
+
+   /* A chunk for each section. */
+   array_free( savefile_sections );
+   savefile_sections = array_create( SaveSection );
+   buf = xmlBufferCreate();
+   for (node=root->xmlChildrenNode; (ret==0) && (node!=NULL); node=node->next) {
+      if (node->type != XML_ELEMENT_NODE)
+         continue;
+      xmlBufferEmpty( buf );
+      xmlNodeDump( buf, doc, node, 0, 0 );
+      ret = savefile_writeChunk( f, (const char*)node->name,
+            xmlBufferContent(buf), xmlBufferLength(buf), compress );
+      sec = &array_grow( &savefile_sections );
+      memset( sec->name, 0, sizeof(sec->name) );
+      strncpy( sec->name, (const char*)node->name, sizeof(sec->name)-1 );
+      sec->hash = savefile_hash( xmlBufferContent(buf), xmlBufferLength(buf) );
+   }
+   xmlBufferFree( buf );
+
+   if ((ret == 0) && savefile_writeChunk( f, SAVEFILE_COMMIT, NULL, 0, 0 ))
+      ret = -1;
+   savefile_size = ftell( f );
+   if (fclose( f ) != 0)
+      ret = -1;
+   if (ret != 0) {
+      WARN(_("Error writing saved game '%s'!"), tmp);
+      remove( tmp );
+      savefile_forget();
+      return -1;
+   }
+
+#ifdef _WIN32
+   /* rename() does not replace existing files on Windows. */
+   remove( file );
+#endif /* _WIN32 */
+   if (rename( tmp, file ) != 0) {
+      WARN(_("Failed to rename '%s' to '%s': %s"), tmp, file, strerror(errno));
+      savefile_forget();
+      return -1;
+   }
+
+   free( savefile_last );
+   savefile_last     = strdup( file );
+   savefile_snapshot = savefile_size;
+   savefile_deltas   = 0;
+   return 0;
+}
+
+
+/**
+ * @brief Appends the header and the changed sections to the saved game.
+ *
+ * What was appended before an error is never committed, so the file is still
+ *  good and a full snapshot is written over it instead.
+ *
+ *    @return 0 on success, 1 if a full snapshot is needed instead, -1 on error.
+ */
+static int savefile_writeDelta( const char *file, xmlDocPtr doc, int compress )
+{
+   FILE *f;
+   xmlNodePtr root, node;
+   xmlBufferPtr buf;
+   SaveSection *sec;
+   uint64_t *hashes;
+   int i, n, ret;
+
+   root = xmlDocGetRootElement( doc );
+   if (root == NULL)
+      return -1;
+
+   /* Hash the sections first, a new section needs a snapshot. */
+   hashes = array_create( uint64_t );
+   buf    = xmlBufferCreate();
+   ret    = 0;
+   for (node=root->xmlChildrenNode; node!=NULL; node=node->next) {
+      if (node->type != XML_ELEMENT_NODE)
+         continue;
+      if (savefile_section( (const char*)node->name ) == NULL) {
+         ret = 1;
+         break;
+      }
+      xmlBufferEmpty( buf );
+      xmlNodeDump( buf, doc, node, 0, 0 );
+      array_push_back( &hashes, savefile_hash( xmlBufferContent(buf), xmlBufferLength(buf) ) );
+   }
+   /* As does a section that went away. */
+   if ((ret == 0) && (array_size(hashes) != array_size(savefile_sections)))
+      ret = 1;
+   if (ret != 0) {
+      xmlBufferFree( buf );
+      array_free( hashes );
+      return ret;
+   }
+
+   f = fopen( file, "ab" );
+   if (f == NULL) {
+      xmlBufferFree( buf );
+      array_free( hashes );
+      return 1;
+   }
+
+   ret = savefile_writeHeader( f, root, compress );
+   i   = 0;
+   n   = 0;
+   for (node=root->xmlChildrenNode; (ret==0) && (node!=NULL); node=node->next) {
+      if (node->type != XML_ELEMENT_NODE)
+         continue;
+      sec = savefile_section( (const char*)node->name );
+      if (sec->hash != hashes[i]) {
+         xmlBufferEmpty( buf );
+         xmlNodeDump( buf, doc, node, 0, 0 );
+         ret = savefile_writeChunk( f, (const char*)node->name,
+               xmlBufferContent(buf), xmlBufferLength(buf), compress );
+         sec->hash = hashes[i];
+         n++;
+      }
+      i++;
+   }
+   xmlBufferFree( buf );
+   array_free( hashes );
+
+   /* Only now does the delta count. */
+   if ((ret == 0) && savefile_writeChunk( f, SAVEFILE_COMMIT, NULL, 0, 0 ))
+      ret = -1;
+   savefile_size = ftell( f );
+   if (fclose( f ) != 0)
+      ret = -1;
+   if (ret != 0) {
+      WARN(_("Error appending to saved game '%s'!"), file);
+      return 1;
+   }
+
+   savefile_deltas++;
+   DEBUG(_("Appended %d changed sections to saved game '%s'."), n, file);
+   return 0;
+}
+
+
+/**
+ * @brief Writes a document as a chunked saved game.
+ *
+ * Appends a delta to the file when it was the last one written and the
+ *  journal is still short, otherwise writes a full snapshot to tmp and renames
+ *  it over the file. Doesn't touch any game state so it can be run from any
+ *  thread.
+ *
+ *    @param file Real path of the saved game.
+ *    @param tmp Real path to write full snapshots to before renaming.
+ *    @param doc Document to write, its root must be "naev_save".
+ *    @param compress Whether or not to compress the chunks.
+ *    @return 0 on success.
+ */
+int savefile_write( const char *file, const char *tmp, xmlDocPtr doc, int compress )
+{
+   FILE *f;
+   long size;
+   int ret;
+
+   /* Make sure nobody else touched the file since. */
+   size = -1;
+   if ((savefile_last != NULL) && (strcmp( savefile_last, file ) == 0)
+         && (savefile_deltas < SAVEFILE_DELTAS)
+         && (savefile_size - savefile_snapshot < savefile_snapshot)) {
+      f = fopen( file, "rb" );
+      if ((f != NULL) && (fseek( f, 0, SEEK_END ) == 0))
+         size = ftell( f );
+      if (f != NULL)
+         fclose( f );
+   }
+
+   if (size == savefile_size) {
+      ret = savefile_writeDelta( file, doc, compress );
+      if (ret <= 0)
+         return ret;
+   }
+   return savefile_writeFull( file, tmp, doc, compress );
+}
+
+
+/**
+ * @brief Forgets about the file last written, so the next save is a full snapshot.
+ */
+void savefile_forget (void)
+{
+   free( savefile_last );
+   savefile_last = NULL;
+   array_free( savefile_sections );
+   savefile_sections = NULL;
+   savefile_deltas = 0;
+}
+
+
+/**
+ * @brief Opens a chunked saved game and checks its file header.
+ *
+ *    @param path PhysicsFS path of the save.
+ *    @return The file positioned at the first chunk or NULL if not chunked.
+ */
+static PHYSFS_File* savefile_open( const char *path )
+{
+   PHYSFS_File *f;
+   char magic[SAVEFILE_MAGICLEN];
+   PHYSFS_uint32 version;
+
+   f = PHYSFS_openRead( path );
+   if (f == NULL)
+      return NULL;
+
+   if ((PHYSFS_readBytes( f, magic, sizeof(magic) ) != sizeof(magic))
+         || (memcmp( magic, SAVEFILE_MAGIC, sizeof(magic) ) != 0)
+         || !PHYSFS_readULE32( f, &version )) {
+      PHYSFS_close( f );
+      return NULL;
+   }
+
+   if (version > SAVEFILE_VERSION) {
+      WARN(_("Saved game '%s' has format version %u, newer than the supported %d!"),
+            path, version, SAVEFILE_VERSION);
+      PHYSFS_close( f );
+      return NULL;
+   }
+   return f;
+}
+
+
+/**
+ * @brief Reads the header of the next chunk.
+ *
+ *    @return 0 on success, -1 at the end of the file or on error.
+ */
+static int savefile_nextChunk( PHYSFS_File *f, SaveChunk *chunk )
+{
+   if ((PHYSFS_readBytes( f, chunk->name, SAVEFILE_NAMELEN ) != SAVEFILE_NAMELEN)
+         || !PHYSFS_readULE32( f, &chunk->flags )
+         || !PHYSFS_readULE32( f, &chunk->size )
+         || !PHYSFS_readULE32( f, &chunk->rawsize ))
+      return -1;
+   chunk->name[SAVEFILE_NAMELEN-1] = '\0';
+   return 0;
+}
+
+
+/**
+ * @brief Reads and decodes the data of a chunk.
+ *
+ *    @return Decoded data, NUL terminated, or NULL on error.
+ */
+static char* savefile_readChunk( PHYSFS_File *f, const SaveChunk *chunk )
+{
+   char *buf, *raw;
+   uLongf rawsize;
+
+   buf = malloc( chunk->size+1 );
+   if (PHYSFS_readBytes( f, buf, chunk->size ) != (PHYSFS_sint64)chunk->size) {
+      free( buf );
+      return NULL;
+   }
+   buf[chunk->size] = '\0';
+   if (!(chunk->flags & SAVEFILE_COMPRESSED))
+      return buf;
+
+   rawsize = chunk->rawsize;
+   raw     = malloc( rawsize+1 );
+   if ((uncompress( (Bytef*)raw, &rawsize, (Bytef*)buf, chunk->size ) != Z_OK)
+         || (rawsize != chunk->rawsize)) {
+      free( raw );
+      free( buf );
+      return NULL;
+   }
+   raw[rawsize] = '\0';
+   free( buf );
+   return raw;
+}
+
+
+/**
+ * @brief Finds the current version of every chunk of a saved game.
+ *
+ *    @param f File positioned at the first chunk.
+ *    @return Chunks in the order they first appeared (array.h), NULL on error.
+ */
+static SaveIndex* savefile_index( PHYSFS_File *f )
+{
+   int i, committed;
+   SaveChunk chunk;
+   SaveIndex *index, *e;
+   PHYSFS_sint64 offset;
+
+   index     = array_create( SaveIndex );
+   committed = 0;
+   while (savefile_nextChunk( f, &chunk ) == 0) {
+      offset = PHYSFS_tell( f );
+      if ((offset < 0) || !PHYSFS_seek( f, offset + chunk.size )) {
+         array_free( index );
+         return NULL;
+      }
+
+      /* Everything read so far is current. */
+      if (strcmp( chunk.name, SAVEFILE_COMMIT ) == 0) {
+         for (i=0; i<array_size(index); i++)
+            index[i].pending = 0;
+         committed = 1;
+         continue;
+      }
+
+      /* A new version of a chunk waits for the commit. */
+      e = &array_grow( &index );
+      e->chunk   = chunk;
+      e->offset  = offset;
+      e->pending = 1;
+   }
+
+   /* Version 1 files have no commits, delta leftovers are dropped. */
+   for (i=array_size(index)-1; i>=0; i--) {
+      if (index[i].pending && committed)
+         array_erase( &index, &index[i], &index[i+1] );
+      else
+         index[i].pending = 0;
+   }
+
+   /* Keep only the last version of each, where the first one was. */
+   for (i=0; i<array_size(index); i++) {
+      int j;
+      for (j=array_size(index)-1; j>i; j--) {
+         if (strcmp( index[i].chunk.name, index[j].chunk.name ) != 0)
+            continue;
+         index[i] = index[j];
+         array_erase( &index, &index[j], &index[j+1] );
+      }
+   }
+   return index;
+}
+
+
+/**
+ * @brief Checks to see if a saved game is in the chunked format.
+ *
+ *    @param path PhysicsFS path of the save.
+ *    @return 1 if it is chunked, 0 if it isn't.
+ */
+int savefile_isChunked( const char *path )
+{
+   PHYSFS_File *f = savefile_open( path );
+   if (f == NULL)
+      return 0;
+   PHYSFS_close( f );
+   return 1;
+}
+
+
+/**
+ * @brief Reads only the header of a chunked saved game.
+ *
+ *    @param[out] save Save to fill, the path is not set.
+ *    @param path PhysicsFS path of the save.
+ *    @return 0 on success.
+ */
+int savefile_readHeader( nsave_t *save, const char *path )
+{
+   PHYSFS_File *f;
+   SaveChunk chunk;
+   SaveIndex *index;
+   char *buf, *key, *val, *end;
+   int i;
+
+   memset( save, 0, sizeof(nsave_t) );
+   f = savefile_open( path );
+   if (f == NULL)
+      return -1;
+
+   /* Appended deltas have newer headers. */
+   buf   = NULL;
+   index = savefile_index( f );
+   for (i=0; i<array_size(index); i++) {
+      if (strcmp( index[i].chunk.name, SAVEFILE_HEADER ) != 0)
+         continue;
+      chunk = index[i].chunk;
+      if (PHYSFS_seek( f, index[i].offset ))
+         buf = savefile_readChunk( f, &chunk );
+      break;
+   }
+   array_free( index );
+   PHYSFS_close( f );
+   if (buf == NULL) {
+      WARN(_("Saved game '%s' has no valid header!"), path);
+      return -1;
+   }
+
+   key = buf;
+   end = buf + chunk.rawsize;
+   while (key < end) {
+      val = key + strlen(key) + 1;
+      if (val >= end)
+         break;
+      if (strcmp(key,"name")==0)
+         save->name = strdup( val );
+      else if (strcmp(key,"version")==0)
+         save->version = strdup( val );
+      else if (strcmp(key,"data")==0)
+         save->data = strdup( val );
+      else if (strcmp(key,"planet")==0)
+         save->planet = strdup( val );
+      else if (strcmp(key,"credits")==0)
+         save->credits = strtoull( val, NULL, 10 );
+      else if (strcmp(key,"date")==0)
+         save->date = strtoll( val, NULL, 10 );
+      else if (strcmp(key,"shipname")==0)
+         save->shipname = strdup( val );
+      else if (strcmp(key,"shipmodel")==0)
+         save->shipmodel = strdup( val );
+      key = val + strlen(val) + 1;
+   }
+
+   free( buf );
+   return 0;
+}
+
+
+/**
+ * @brief Reads a chunked saved game into a document.
+ *
+ * Each section is parsed straight into the document, and sections that are
+ *  not wanted or were replaced by a later delta are skipped without being
+ *  read.
+ *
+ *    @param path PhysicsFS path of the save.
+ *    @param section Only section to read or NULL to read them all.
+ *    @return Document with a "naev_save" root or NULL on error.
+ */
+xmlDocPtr savefile_readDoc( const char *path, const char *section )
+{
+   PHYSFS_File *f;
+   SaveChunk chunk;
+   SaveIndex *index;
+   xmlDocPtr doc;
+   xmlNodePtr root, list;
+   char *buf;
+   int i, ret;
+
+   f = savefile_open( path );
+   if (f == NULL)
+      return NULL;
+   index = savefile_index( f );
+   if (index == NULL) {
+      WARN(_("Saved game '%s' is corrupt!"), path);
+      PHYSFS_close( f );
+      return NULL;
+   }
+
+   doc  = xmlNewDoc( (const xmlChar*)"1.0" );
+   root = xmlNewNode( NULL, (const xmlChar*)"naev_save" );
+   xmlDocSetRootElement( doc, root );
+
+   ret = 0;
+   memset( &chunk, 0, sizeof(chunk) );
+   for (i=0; (ret==0) && (i<array_size(index)); i++) {
+      chunk = index[i].chunk;
+      /* Skip what isn't wanted. */
+      if ((strcmp( chunk.name, SAVEFILE_HEADER ) == 0)
+            || ((section != NULL) && (strcmp( chunk.name, section ) != 0)))
+         continue;
+
+      if (!PHYSFS_seek( f, index[i].offset )) {
+         ret = -1;
+         break;
+      }
+      buf = savefile_readChunk( f, &chunk );
+      if (buf == NULL) {
+         ret = -1;
+         break;
+      }
+      list = NULL;
+      if (xmlParseInNodeContext( root, buf, chunk.rawsize, 0, &list ) != XML_ERR_OK)
+         ret = -1;
+      else
+         xmlAddChildList( root, list );
+      free( buf );
+   }
+   array_free( index );
+   PHYSFS_close( f );
+
+   if (ret != 0) {
+      WARN(_("Saved game '%s' is corrupt at section '%s'!"), path, chunk.name);
+      xmlFreeDoc( doc );
+      return NULL;
+   }
+   return doc;
+}
@@ -0,0 +1,27 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+
+
+#ifndef SAVEFILE_H
+#  define SAVEFILE_H
+
+
+#include "load.h"
+#include "nxml.h"
+
+
+#define SAVEFILE_VERSION      2 /**< Version of the chunked saved game format. */
+
+
+/* Writing. */
+int savefile_write( const char *file, const char *tmp, xmlDocPtr doc, int compress );
+void savefile_forget (void);
+
+/* Reading. */
+int savefile_isChunked( const char *path );
+int savefile_readHeader( nsave_t *save, const char *path );
+xmlDocPtr savefile_readDoc( const char *path, const char *section );
+
+
+#endif /* SAVEFILE_H */
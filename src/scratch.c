@@ -0,0 +1,172 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+
+/**
+ * @file scratch.c
+ *
+ * @brief Linear allocator for memory that only lives for a frame.
+ *
+ * Allocations are a pointer bump and are all released together at the start
+ *  of the next frame by scratch_reset(), so there is nothing to free. Memory
+ *  comes from blocks that are kept between frames; if a frame needs more than
+ *  one block, they get replaced by a single larger one at the next reset, so
+ *  the steady state is a single block and no system allocations.
+ *
+ * @note Only to be used from the main thread, and the memory must not be held
+ *       across anything that can run the main loop (such as dialogues).
+ */
+
+
+/** @cond */
+#include <stdalign.h>
+#include <stdlib.h>
+
+#include "naev.h"
+/** @endcond */
+
+#include "scratch.h"
+
+#include "array.h"
+
+
+#define SCRATCH_BLOCK_MIN  (64*1024) /**< Smallest block to allocate. */
+#define SCRATCH_ALIGN      alignof(max_align_t) /**< Alignment of the allocations. */
+
+
+/**
+ * @brief Block of scratch memory.
+ */
+typedef struct ScratchBlock_ {
+   char *data; /**< Memory of the block. */
+   size_t size; /**< Size of the block. */
+} ScratchBlock;
+
+
+static ScratchBlock *scratch_blocks = NULL; /**< Blocks in use this frame. */
+static int scratch_cur      = 0; /**< Block being allocated from. */
+static size_t scratch_off   = 0; /**< Offset in the current block. */
+static size_t scratch_used  = 0; /**< Bytes used this frame, in earlier blocks too. */
+static size_t scratch_lastUsed = 0; /**< Bytes used last frame. */
+static size_t scratch_peakUsed = 0; /**< Most bytes used in a frame. */
+
+
+/*
+ * Prototypes.
+ */
+static void scratch_addBlock( size_t size );
+
+
+/**
+ * @brief Adds a block to allocate from.
+ */
+static void scratch_addBlock( size_t size )
+{
+   ScratchBlock *b;
+
+   b = &array_grow( &scratch_blocks );
+   b->size = MAX( size, SCRATCH_BLOCK_MIN );
+   b->data = malloc( b->size );
+   if (b->data == NULL)
+      ERR(_("Out of Memory"));
+}
+
+
+/**
+ * @brief Allocates memory that is valid until the start of the next frame.
+ *
+ *    @param size Size to allocate.
+ *    @return Memory aligned for any type, never NULL.
+ */
+void* scratch_alloc( size_t size )
+{
+   void *ptr;
+   size_t aligned;
+   ScratchBlock *b;
+
+   if (scratch_blocks == NULL) {
+      scratch_blocks = array_create( ScratchBlock );
+      scratch_addBlock( SCRATCH_BLOCK_MIN );
+   }
+
+   aligned = (size + SCRATCH_ALIGN-1) & ~(SCRATCH_ALIGN-1);
+   b = &scratch_blocks[ scratch_cur ];
+   if (scratch_off + aligned > b->size) {
+      /* Doesn't fit, move on to a new block at least twice as big. */
+      scratch_addBlock( MAX( aligned, 2*b->size ) );
+      scratch_cur = array_size(scratch_blocks)-1;
+      scratch_off = 0;
+      b = &scratch_blocks[ scratch_cur ];
+   }
+
+   ptr = &b->data[ scratch_off ];
+   scratch_off  += aligned;
+   scratch_used += aligned;
+   return ptr;
+}
+
+
+/**
+ * @brief Releases all the scratch memory, called at the start of each frame.
+ */
+void scratch_reset (void)
+{
+   int i;
+   size_t total;
+
+   scratch_lastUsed = scratch_used;
+   scratch_peakUsed = MAX( scratch_peakUsed, scratch_used );
+
+   /* Merge the blocks so next time it all fits in one. */
+   if (array_size(scratch_blocks) > 1) {
+      total = 0;
+      for (i=0; i<array_size(scratch_blocks); i++) {
+         total += scratch_blocks[i].size;
+         free( scratch_blocks[i].data );
+      }
+      array_resize( &scratch_blocks, 0 );
+      scratch_addBlock( total );
+   }
+
+   scratch_cur  = 0;
+   scratch_off  = 0;
+   scratch_used = 0;
+}
+
+
+/**
+ * @brief Frees the scratch memory.
+ */
+void scratch_exit (void)
+{
+   int i;
+   for (i=0; i<array_size(scratch_blocks); i++)
+      free( scratch_blocks[i].data );
+   array_free( scratch_blocks );
+   scratch_blocks = NULL;
+   scratch_cur    = 0;
+   scratch_off    = 0;
+   scratch_used   = 0;
+}
+
+
+/**
+ * @brief Gets the scratch memory used in the last frame.
+ *
+ *    @return Bytes used.
+ */
+size_t scratch_last (void)
+{
+   return scratch_lastUsed;
+}
+
+
+/**
+ * @brief Gets the most scratch memory used in a single frame.
+ *
+ *    @return Bytes used.
+ */
+size_t scratch_peak (void)
+{
+   return scratch_peakUsed;
+}
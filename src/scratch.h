@@ -0,0 +1,28 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+
+
+
+#ifndef SCRATCH_H
+#  define SCRATCH_H
+
+
+/** @cond */
+#include <stddef.h>
+/** @endcond */
+
+
+/* Allocation. */
+void* scratch_alloc( size_t size );
+
+/* Frame handling. */
+void scratch_reset (void);
+void scratch_exit (void);
+
+/* Stats. */
+size_t scratch_last (void);
+size_t scratch_peak (void);
+
+
+#endif /* SCRATCH_H */
@@ -33,8 +33,8 @@ SHADERS = [
       name = "trail",
       vs_path = "trail.vert",
       fs_path = "trail.frag",
-      attributes = ["vertex"],
-      uniforms = ["projection", "c1", "c2", "t1", "t2", "dt", "pos1", "pos2", "r", "nebu_col" ],
+      attributes = ["vertex", "vertex_color", "vertex_pos", "vertex_thick", "vertex_trail"],
+      uniforms = ["nebu_col" ],
       subroutines = {
         "trail_func" : [
             "trail_default",
@@ -71,6 +71,14 @@ SHADERS = [
       uniforms = ["projection", "color", "tex_mat", "sampler1", "sampler2", "inter"],
       subroutines = {},
    ),
+   Shader(
+      name = "texture_batch",
+      vs_path = "texture_batch.vert",
+      fs_path = "texture_batch.frag",
+      attributes = ["vertex", "tex_coord", "tex_coord2", "vertex_color", "vertex_inter"],
+      uniforms = ["sampler1", "sampler2"],
+      subroutines = {},
+   ),
    Shader(
       name = "nebula",
       vs_path = "nebula.vert",
@@ -95,6 +103,14 @@ SHADERS = [
       uniforms = ["projection", "hue", "eddy_scale", "time", "globalpos", "alpha"],
       subroutines = {},
    ),
+   Shader(
+      name = "nebula_puff",
+      vs_path = "nebula_puff.vert",
+      fs_path = "nebula_puff.frag",
+      attributes = ["vertex", "corner", "vertex_tex", "height", "vertex_color"],
+      uniforms = ["sampler", "puff_xy", "wh", "puff_buf"],
+      subroutines = {},
+   ),
    Shader(
       name = "stars",
       vs_path = "stars.vert",
@@ -107,8 +123,8 @@ SHADERS = [
       name = "font",
       vs_path = "font.vert",
       fs_path = "font.frag",
-      attributes = ["vertex", "tex_coord"],
-      uniforms = ["projection", "color", "outline_color"],
+      attributes = ["vertex", "tex_coord", "vertex_color", "vertex_outline", "vertex_scale"],
+      uniforms = [],
       subroutines = {},
    ),
    Shader(
@@ -161,6 +177,14 @@ SHADERS = [
       uniforms = ["ClipSpaceFromLocal", "MainTex"],
       subroutines = {},
    ),
+   Shader(
+      name = "colorblind_gamma",
+      vs_path = "postprocess.vert",
+      fs_path = "colorblind_gamma.frag",
+      attributes = ["VertexPosition"],
+      uniforms = ["ClipSpaceFromLocal", "MainTex", "gamma"],
+      subroutines = {},
+   ),
    Shader(
       name = "shake",
       vs_path = "postprocess.vert",
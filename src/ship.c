@@ -29,6 +29,8 @@
 #include "nxml.h"
 #include "shipstats.h"
 #include "slots.h"
+#include "strindex.h"
+#include "threadpool.h"
 #include "toolkit.h"
 #include "unistd.h"
 
@@ -49,13 +51,34 @@
 #define STATS_DESC_MAX 256 /**< Maximum length for statistics description. */
 
 
+/**
+ * @brief Space sprite sheet of a ship being read and decoded in the background.
+ */
+typedef struct ShipGfxPrefetch_ {
+   char *path;          /**< Path of the sprite sheet. */
+   char *data;          /**< Contents of the file, needed for the transparency map. */
+   size_t size;         /**< Size of the contents. */
+   SDL_Surface *surface; /**< Decoded sprite sheet. */
+   int done;            /**< Whether the job is done. */
+   int abandoned;       /**< Whether the job should free itself when done. */
+} ShipGfxPrefetch;
+
+
 static Ship* ship_stack = NULL; /**< Stack of ships available in the game. */
+static StrIndex ship_index; /**< Ships by name. */
+static SDL_mutex *ship_prefetchLock = NULL; /**< Protects the prefetches. */
+static SDL_cond *ship_prefetchCond = NULL; /**< Signalled when a prefetch is done. */
 
 
 /*
  * Prototypes
  */
 static int ship_loadGFX( Ship *temp, const char *buf, int sx, int sy, int engine );
+static int ship_loadSpaceImage( Ship *temp, ShipGfxPrefetch *pre );
+static void ship_gfxFree( Ship *s );
+static int ship_prefetchJob( void *data );
+static void ship_prefetchFree( ShipGfxPrefetch *p );
+static ShipGfxPrefetch* ship_prefetchTake( Ship *s );
 static int ship_loadPLG( Ship *temp, const char *buf, int size_hint );
 static int ship_parse( Ship *temp, xmlNodePtr parent );
 
@@ -68,13 +91,11 @@ static int ship_parse( Ship *temp, xmlNodePtr parent );
  */
 Ship* ship_get( const char* name )
 {
-   Ship *temp;
    int i;
 
-   temp = ship_stack;
-   for (i=0; i < array_size(ship_stack); i++)
-      if (strcmp(temp[i].name, name)==0)
-         return &temp[i];
+   i = strindex_get( &ship_index, name );
+   if (i >= 0)
+      return &ship_stack[i];
 
    WARN(_("Ship %s does not exist"), name);
    return NULL;
@@ -89,13 +110,11 @@ Ship* ship_get( const char* name )
  */
 Ship* ship_getW( const char* name )
 {
-   Ship *temp;
    int i;
 
-   temp = ship_stack;
-   for (i=0; i < array_size(ship_stack); i++)
-      if (strcmp(temp[i].name, name)==0)
-         return &temp[i];
+   i = strindex_get( &ship_index, name );
+   if (i >= 0)
+      return &ship_stack[i];
 
    return NULL;
 }
@@ -106,10 +125,9 @@ Ship* ship_getW( const char* name )
  */
 const char *ship_existsCase( const char* name )
 {
-   int i;
-   for (i=0; i<array_size(ship_stack); i++)
-      if (strcasecmp(name,ship_stack[i].name)==0)
-         return ship_stack[i].name;
+   int i = strindex_getCase( &ship_index, name );
+   if (i >= 0)
+      return ship_stack[i].name;
    return NULL;
 }
 
@@ -165,6 +183,46 @@ const char* ship_class( const Ship* s )
 }
 
 
+/**
+ * @brief Gets the description of the ship's stats, generating it if needed.
+ *
+ *    @param s Ship to get the stats description of.
+ *    @return The stats description or NULL if the ship has none.
+ */
+const char* ship_descStats( const Ship* s )
+{
+   int i;
+   Ship *ship;
+
+   if ((s->desc_stats != NULL) || (s->stats == NULL))
+      return s->desc_stats;
+
+   /* The description is a cache, so it's fine to fill in on const ships. */
+   ship = (Ship*) s;
+   ship->desc_stats = malloc( STATS_DESC_MAX );
+   i = ss_statsListDesc( ship->stats, ship->desc_stats, STATS_DESC_MAX, 0 );
+   if (i <= 0) {
+      free( ship->desc_stats );
+      ship->desc_stats = NULL;
+   }
+   return ship->desc_stats;
+}
+
+
+/**
+ * @brief Frees the generated stats descriptions, used when the language changes.
+ */
+void ships_descFlush (void)
+{
+   int i;
+
+   for (i=0; i<array_size(ship_stack); i++) {
+      free( ship_stack[i].desc_stats );
+      ship_stack[i].desc_stats = NULL;
+   }
+}
+
+
 /**
  * @brief Gets the ship class name in human readable form.
  *
@@ -346,6 +404,18 @@ glTexture* ship_loadCommGFX( Ship* s )
 }
 
 
+/**
+ * @brief Starts decoding the ship's comm graphic in the background.
+ *
+ * A later ship_loadCommGFX() then only has to upload it.
+ */
+void ship_prefetchCommGFX( const Ship* s )
+{
+   if (s->gfx_comm != NULL)
+      gl_texPrefetch( s->gfx_comm, 0 );
+}
+
+
 /**
  * @brief Gets the size of the ship.
  *
@@ -450,26 +520,36 @@ static int ship_genTargetGFX( Ship *temp, SDL_Surface *surface, int sx, int sy )
 
 
 /**
- * @brief Loads the space graphics for a ship from an image.
+ * @brief Loads the space graphics for a ship from its image.
  *
  *    @param temp Ship to load into.
- *    @param str Path of the image to use.
- *    @param sx Number of X sprites in image.
- *    @param sy Number of Y sprites in image.
+ *    @param pre Image already read and decoded in the background or NULL.
  */
-static int ship_loadSpaceImage( Ship *temp, char *str, int sx, int sy )
+static int ship_loadSpaceImage( Ship *temp, ShipGfxPrefetch *pre )
 {
    SDL_RWops *rw;
    SDL_Surface *surface;
-   int ret;
+   const char *str;
+   int ret, sx, sy;
+
+   str = temp->gfx_spacePath;
+   sx  = temp->gfx_sx;
+   sy  = temp->gfx_sy;
 
    /* Load the space sprite. */
-   rw    = PHYSFSRWOPS_openRead( str );
-   if (rw==NULL) {
-      WARN(_("Unable to open '%s' for reading!"), str);
-      return -1;
+   if ((pre != NULL) && (pre->surface != NULL)) {
+      rw      = SDL_RWFromConstMem( pre->data, pre->size );
+      surface = pre->surface;
+      pre->surface = NULL;
+   }
+   else {
+      rw    = PHYSFSRWOPS_openRead( str );
+      if (rw==NULL) {
+         WARN(_("Unable to open '%s' for reading!"), str);
+         return -1;
+      }
+      surface = IMG_Load_RW( rw, 0 );
    }
-   surface = IMG_Load_RW( rw, 0 );
 
    /* Load the texture. */
    temp->gfx_space = gl_loadImagePadTrans( str, surface, rw,
@@ -484,32 +564,16 @@ static int ship_loadSpaceImage( Ship *temp, char *str, int sx, int sy )
    /* Free stuff. */
    SDL_RWclose( rw );
    SDL_FreeSurface( surface );
-
-   /* Calculate mount angle. */
-   temp->mangle  = 2.*M_PI;
-   temp->mangle /= temp->gfx_space->sx * temp->gfx_space->sy;
    return 0;
 }
 
 
-/**
- * @brief Loads the space graphics for a ship from an image.
- *
- *    @param temp Ship to load into.
- *    @param str Path of the image to use.
- *    @param sx Number of X sprites in image.
- *    @param sy Number of Y sprites in image.
- */
-static int ship_loadEngineImage( Ship *temp, char *str, int sx, int sy )
-{
-   temp->gfx_engine = gl_newSprite( str, sx, sy, OPENGL_TEX_MIPMAPS );
-   return (temp->gfx_engine != NULL);
-}
-
-
 /**
  * @brief Loads the graphics for a ship.
  *
+ * Only finds the images, they are loaded by ship_gfxLoad() once the ship is
+ *  needed.
+ *
  *    @param temp Ship to load into.
  *    @param buf Name of the texture to work with.
  *    @param sx Number of X sprites in image.
@@ -530,13 +594,19 @@ static int ship_loadGFX( Ship *temp, const char *buf, int sx, int sy, int engine
       ext = ".png";
       snprintf( str, sizeof(str), SHIP_GFX_PATH"%s/%s%s", base, buf, ext );
    }
-   ship_loadSpaceImage( temp, str, sx, sy );
+   free( temp->gfx_spacePath );
+   temp->gfx_spacePath = strdup( str );
+   temp->gfx_sx = sx;
+   temp->gfx_sy = sy;
 
-   /* Load the engine sprite .*/
+   /* Find the engine sprite .*/
    if (engine && conf.engineglow) {
       snprintf( str, sizeof(str), SHIP_GFX_PATH"%s/%s"SHIP_ENGINE"%s", base, buf, ext );
-      ship_loadEngineImage( temp, str, sx, sy );
-      if (temp->gfx_engine == NULL)
+      if (PHYSFS_exists(str)) {
+         free( temp->gfx_enginePath );
+         temp->gfx_enginePath = strdup( str );
+      }
+      else
          WARN(_("Ship '%s' does not have an engine sprite (%s)."), temp->name, str );
    }
 
@@ -548,6 +618,208 @@ static int ship_loadGFX( Ship *temp, const char *buf, int sx, int sy, int engine
 }
 
 
+/**
+ * @brief Loads the space graphics of a ship if they aren't already.
+ *
+ * Ships only load their sprite sheets when first needed, as most of them
+ *  never show up in a session. If the sheet was prefetched it only has to be
+ *  uploaded.
+ *
+ *    @param s Ship to load the graphics of.
+ *    @return 0 on success.
+ */
+int ship_gfxLoad( Ship *s )
+{
+   ShipGfxPrefetch *pre;
+   int ret;
+
+   if ((s->gfx_space != NULL) || (s->gfx_spacePath == NULL))
+      return 0;
+
+   pre = ship_prefetchTake( s );
+   ret = ship_loadSpaceImage( s, pre );
+   if (pre != NULL)
+      ship_prefetchFree( pre );
+
+   if (s->gfx_enginePath != NULL)
+      s->gfx_engine = gl_newSprite( s->gfx_enginePath, s->gfx_sx, s->gfx_sy, OPENGL_TEX_MIPMAPS );
+
+   return ret;
+}
+
+
+/**
+ * @brief Marks the graphics of a ship as used by a pilot, loading them if needed.
+ *
+ *    @param s Ship used by the pilot.
+ */
+void ship_gfxRef( Ship *s )
+{
+   ship_gfxLoad( s );
+   s->gfx_refs++;
+}
+
+
+/**
+ * @brief Marks the graphics of a ship as no longer used by a pilot.
+ *
+ * They are only freed by ships_gfxPurge(), so pilots dying and spawning don't
+ *  keep reloading them.
+ *
+ *    @param s Ship the pilot used.
+ */
+void ship_gfxUnref( Ship *s )
+{
+   if (s->gfx_refs > 0)
+      s->gfx_refs--;
+}
+
+
+/**
+ * @brief Frees the space graphics of a ship.
+ */
+static void ship_gfxFree( Ship *s )
+{
+   gl_freeTexture( s->gfx_space );
+   gl_freeTexture( s->gfx_engine );
+   gl_freeTexture( s->gfx_target );
+   gl_freeTexture( s->gfx_store );
+   s->gfx_space  = NULL;
+   s->gfx_engine = NULL;
+   s->gfx_target = NULL;
+   s->gfx_store  = NULL;
+}
+
+
+/**
+ * @brief Frees the graphics of the ships no pilot uses.
+ *
+ * Also drops the prefetched graphics that ended up not being used.
+ */
+void ships_gfxPurge (void)
+{
+   int i, n;
+   Ship *s;
+
+   n = 0;
+   for (i=0; i<array_size(ship_stack); i++) {
+      s = &ship_stack[i];
+      if (s->gfx_refs > 0)
+         continue;
+      if (s->gfx_space != NULL)
+         n++;
+      ship_gfxFree( s );
+      if (s->gfx_prefetch != NULL) {
+         SDL_LockMutex( ship_prefetchLock );
+         if (s->gfx_prefetch->done)
+            ship_prefetchFree( s->gfx_prefetch );
+         else
+            s->gfx_prefetch->abandoned = 1;
+         SDL_UnlockMutex( ship_prefetchLock );
+         s->gfx_prefetch = NULL;
+      }
+   }
+   if (n > 0)
+      DEBUG( n_( "Unloaded graphics of %d ship", "Unloaded graphics of %d ships", n ), n );
+}
+
+
+/**
+ * @brief Starts reading and decoding the space graphics of a ship in the background.
+ *
+ * Used for the ships that are expected to show up soon. A later
+ *  ship_gfxLoad() then only has to upload them.
+ *
+ *    @param s Ship to prefetch the graphics of.
+ */
+void ship_gfxPrefetch( Ship *s )
+{
+   ShipGfxPrefetch *p;
+
+   if ((s->gfx_space != NULL) || (s->gfx_prefetch != NULL) ||
+         (s->gfx_spacePath == NULL) || (ship_prefetchLock == NULL))
+      return;
+
+   p = calloc( 1, sizeof(ShipGfxPrefetch) );
+   p->path = strdup( s->gfx_spacePath );
+   s->gfx_prefetch = p;
+   threadpool_newJob( ship_prefetchJob, p );
+
+   /* The engine glow doesn't need a transparency map. */
+   if (s->gfx_enginePath != NULL)
+      gl_texPrefetch( s->gfx_enginePath, OPENGL_TEX_MIPMAPS );
+}
+
+
+/**
+ * @brief Reads and decodes a prefetched sprite sheet, runs on the threadpool so can't log.
+ */
+static int ship_prefetchJob( void *data )
+{
+   ShipGfxPrefetch *p = data;
+   SDL_RWops *rw;
+   SDL_Surface *surface;
+   char *buf;
+   size_t size;
+
+   surface = NULL;
+   size    = 0;
+   buf = ndata_read( p->path, &size );
+   if (buf != NULL) {
+      rw = SDL_RWFromConstMem( buf, size );
+      if (rw != NULL)
+         surface = IMG_Load_RW( rw, 1 );
+   }
+
+   SDL_LockMutex( ship_prefetchLock );
+   p->data    = buf;
+   p->size    = size;
+   p->surface = surface;
+   p->done    = 1;
+   if (p->abandoned)
+      ship_prefetchFree( p );
+   SDL_CondBroadcast( ship_prefetchCond );
+   SDL_UnlockMutex( ship_prefetchLock );
+   return 0;
+}
+
+
+/**
+ * @brief Frees a finished prefetch.
+ */
+static void ship_prefetchFree( ShipGfxPrefetch *p )
+{
+   if (p->surface != NULL)
+      SDL_FreeSurface( p->surface );
+   free( p->data );
+   free( p->path );
+   free( p );
+}
+
+
+/**
+ * @brief Takes the prefetched sprite sheet of a ship, waiting for it if needed.
+ *
+ *    @param s Ship to take the prefetch of.
+ *    @return The prefetch or NULL if there is none.
+ */
+static ShipGfxPrefetch* ship_prefetchTake( Ship *s )
+{
+   ShipGfxPrefetch *p;
+
+   p = s->gfx_prefetch;
+   if (p == NULL)
+      return NULL;
+   s->gfx_prefetch = NULL;
+
+   SDL_LockMutex( ship_prefetchLock );
+   while (!p->done)
+      SDL_CondWait( ship_prefetchCond, ship_prefetchLock );
+   SDL_UnlockMutex( ship_prefetchLock );
+   return p;
+}
+
+
 /**
  * @brief Loads the collision polygon for a ship.
  *
@@ -558,9 +830,6 @@ static int ship_loadGFX( Ship *temp, const char *buf, int sx, int sy, int engine
 static int ship_loadPLG( Ship *temp, const char *buf, int size_hint )
 {
    char *file;
-   CollPoly *polygon;
-   xmlDocPtr doc;
-   xmlNodePtr node, cur;
 
    asprintf( &file, "%s%s.xml", SHIP_POLYGON_PATH, buf );
 
@@ -574,38 +843,10 @@ static int ship_loadPLG( Ship *temp, const char *buf, int size_hint )
       return 0;
    }
 
-   /* Load the XML. */
-   doc  = xml_parsePhysFS( file );
-
-   if (doc == NULL) {
-      free(file);
-      return 0;
-   }
-
-   node = doc->xmlChildrenNode; /* First polygon node */
-   if (node == NULL) {
-      xmlFreeDoc(doc);
-      WARN(_("Malformed %s file: does not contain elements"), file);
-      free(file);
-      return 0;
-   }
+   /* Load the polygon data. */
+   temp->polygon = LoadPolygonFile( file, size_hint );
 
    free(file);
-
-   do { /* load the polygon data */
-      if (xml_isNode(node,"polygons")) {
-         cur = node->children;
-         temp->polygon = array_create_size( CollPoly, size_hint );
-         do {
-            if (xml_isNode(cur,"polygon")) {
-               polygon = &array_grow( &temp->polygon );
-               LoadPolygon( polygon, cur );
-            }
-         } while (xml_nextNode(cur));
-      }
-   } while (xml_nextNode(node));
-
-   xmlFreeDoc(doc);
    return 0;
 }
 
@@ -713,7 +954,6 @@ static int ship_parseSlot( Ship *temp, ShipOutfitSlot *slot, OutfitSlotType type
  */
 static int ship_parse( Ship *temp, xmlNodePtr parent )
 {
-   int i;
    xmlNodePtr cur, node;
    int sx, sy;
    char *buf;
@@ -779,7 +1019,11 @@ static int ship_parse( Ship *temp, xmlNodePtr parent )
             WARN(_("Ship '%s': the number of collision polygons is wrong.\n \
                     npolygon = %i and sx*sy = %i"),
                     temp->name, array_size(temp->polygon), sx*sy);
+            temp->polygon_step = 1;
          }
+         /* Only keep some, the others are rotated from them. */
+         else
+            temp->polygon_step = CompactPolygons( &temp->polygon, conf.polygon_keyframes );
 
          continue;
       }
@@ -798,8 +1042,11 @@ static int ship_parse( Ship *temp, xmlNodePtr parent )
          xmlr_attr_int_def( node, "sx", sx, 8 );
          xmlr_attr_int_def( node, "sy", sy, 8 );
 
-         /* Load the graphics. */
-         ship_loadSpaceImage( temp, str, sx, sy );
+         /* Graphics are loaded when needed. */
+         free( temp->gfx_spacePath );
+         temp->gfx_spacePath = strdup( str );
+         temp->gfx_sx = sx;
+         temp->gfx_sy = sy;
 
          continue;
       }
@@ -814,12 +1061,9 @@ static int ship_parse( Ship *temp, xmlNodePtr parent )
          }
          snprintf( str, sizeof(str), GFX_PATH"%s", buf );
 
-         /* Get sprite size. */
-         xmlr_attr_int_def( node, "sx", sx, 8 );
-         xmlr_attr_int_def( node, "sy", sy, 8 );
-
-         /* Load the graphics. */
-         ship_loadEngineImage( temp, str, sx, sy );
+         /* Graphics are loaded when needed, with the sprite size of the space sheet. */
+         free( temp->gfx_enginePath );
+         temp->gfx_enginePath = strdup( str );
 
          continue;
       }
@@ -966,15 +1210,7 @@ static int ship_parse( Ship *temp, xmlNodePtr parent )
          ss_statsInit( &temp->stats_array );
          ss_statsModFromList( &temp->stats_array, temp->stats, NULL );
 
-         /* Create description. */
-         if (temp->stats != NULL) {
-            temp->desc_stats = malloc( STATS_DESC_MAX );
-            i = ss_statsListDesc( temp->stats, temp->desc_stats, STATS_DESC_MAX, 0 );
-            if (i <= 0) {
-               free( temp->desc_stats );
-               temp->desc_stats = NULL;
-            }
-         }
+         /* Description is created when first needed. */
 
          continue;
       }
@@ -990,11 +1226,15 @@ static int ship_parse( Ship *temp, xmlNodePtr parent )
    temp->dmg_absorb   /= 100.;
    temp->turn         *= M_PI / 180.; /* Convert to rad. */
 
+   /* Calculate mount angle. */
+   if (temp->gfx_sx * temp->gfx_sy > 0)
+      temp->mangle = 2.*M_PI / (temp->gfx_sx * temp->gfx_sy);
+
    /* ship validator */
 #define MELEMENT(o,s)      if (o) WARN( _("Ship '%s' missing '%s' element"), temp->name, s)
    MELEMENT(temp->name==NULL,"name");
    MELEMENT(temp->base_type==NULL,"base_type");
-   MELEMENT((temp->gfx_space==NULL) || (temp->gfx_comm==NULL),"GFX");
+   MELEMENT((temp->gfx_spacePath==NULL) || (temp->gfx_comm==NULL),"GFX");
    MELEMENT(temp->gui==NULL,"GUI");
    MELEMENT(temp->class==SHIP_CLASS_NULL,"class");
    MELEMENT(temp->price==0,"price");
@@ -1029,10 +1269,10 @@ static int ship_parse( Ship *temp, xmlNodePtr parent )
 int ships_load (void)
 {
    size_t nfiles;
-   char **ship_files, *file;
+   char **ship_files, **files;
    int i;
    xmlNodePtr node;
-   xmlDocPtr doc;
+   xmlDocPtr doc, *docs;
 
    /* Validity. */
    ss_check();
@@ -1043,31 +1283,34 @@ int ships_load (void)
    /* Initialize stack if needed. */
    if (ship_stack == NULL)
       ship_stack = array_create_size(Ship, nfiles);
+   if (ship_prefetchLock == NULL) {
+      ship_prefetchLock = SDL_CreateMutex();
+      ship_prefetchCond = SDL_CreateCond();
+   }
 
-   for (i=0; ship_files[i]!=NULL; i++) {
-      if (!ndata_matchExt( ship_files[i], "xml" ))
-         continue;
-
-      /* Get the file name .*/
-      asprintf( &file, "%s%s", SHIP_DATA_PATH, ship_files[i] );
-
-      /* Load the XML. */
-      doc  = xml_parsePhysFS( file );
+   /* Get the file names and parse them all in parallel. */
+   files = calloc( MAX(nfiles,1), sizeof(char*) );
+   for (i=0; ship_files[i]!=NULL; i++)
+      if (ndata_matchExt( ship_files[i], "xml" ))
+         asprintf( &files[i], "%s%s", SHIP_DATA_PATH, ship_files[i] );
+   docs = xml_parsePhysFSList( files, nfiles );
 
+   for (i=0; ship_files[i]!=NULL; i++) {
+      doc = docs[i];
       if (doc == NULL) {
-         free(file);
+         free(files[i]);
          continue;
       }
 
       node = doc->xmlChildrenNode; /* First ship node */
       if (node == NULL) {
          xmlFreeDoc(doc);
-         WARN(_("Malformed %s file: does not contain elements"), file);
-         free(file);
+         WARN(_("Malformed %s file: does not contain elements"), files[i]);
+         free(files[i]);
          continue;
       }
 
-      free(file);
+      free(files[i]);
 
       if (xml_isNode(node, XML_SHIP))
          /* Load the ship. */
@@ -1079,10 +1322,17 @@ int ships_load (void)
 
    /* Shrink stack. */
    array_shrink(&ship_stack);
+
+   /* Index by name for lookups. */
+   strindex_clear( &ship_index );
+   for (i=0; i<array_size(ship_stack); i++)
+      strindex_add( &ship_index, ship_stack[i].name, i );
    DEBUG( n_( "Loaded %d Ship", "Loaded %d Ships", array_size(ship_stack) ), array_size(ship_stack) );
 
    /* Clean up. */
    PHYSFS_freeList( ship_files );
+   free( files );
+   free( docs );
 
    return 0;
 }
@@ -1121,10 +1371,11 @@ void ships_free (void)
       ss_free( s->stats );
 
       /* Free graphics. */
-      gl_freeTexture(s->gfx_space);
-      gl_freeTexture(s->gfx_engine);
-      gl_freeTexture(s->gfx_target);
-      gl_freeTexture(s->gfx_store);
+      ship_gfxFree( s );
+      if (s->gfx_prefetch != NULL)
+         ship_prefetchFree( ship_prefetchTake( s ) );
+      free(s->gfx_spacePath);
+      free(s->gfx_enginePath);
       free(s->gfx_comm);
       for (j=0; j<array_size(s->gfx_overlays); j++)
          gl_freeTexture(s->gfx_overlays[j]);
@@ -1142,4 +1393,10 @@ void ships_free (void)
 
    array_free(ship_stack);
    ship_stack = NULL;
+   strindex_free( &ship_index );
+
+   SDL_DestroyCond( ship_prefetchCond );
+   SDL_DestroyMutex( ship_prefetchLock );
+   ship_prefetchCond = NULL;
+   ship_prefetchLock = NULL;
 }
@@ -131,16 +131,23 @@ typedef struct Ship_ {
    double dmg_absorb; /**< Damage absorption in per one [0:1] with 1 being 100% absorption. */
 
    /* graphics */
-   glTexture *gfx_space; /**< Space sprite sheet. */
-   glTexture *gfx_engine; /**< Space engine glow sprite sheet. */
-   glTexture *gfx_target; /**< Targeting window graphic. */
-   glTexture *gfx_store; /**< Store graphic. */
+   glTexture *gfx_space; /**< Space sprite sheet, loaded by ship_gfxLoad(). */
+   glTexture *gfx_engine; /**< Space engine glow sprite sheet, loaded by ship_gfxLoad(). */
+   glTexture *gfx_target; /**< Targeting window graphic, loaded by ship_gfxLoad(). */
+   glTexture *gfx_store; /**< Store graphic, loaded by ship_gfxLoad(). */
+   char *gfx_spacePath; /**< Path of the space sprite sheet. */
+   char *gfx_enginePath; /**< Path of the engine glow sprite sheet or NULL. */
+   int gfx_sx;       /**< Number of X sprites in the sheets. */
+   int gfx_sy;       /**< Number of Y sprites in the sheets. */
+   int gfx_refs;     /**< Number of pilots using the space graphics. */
+   struct ShipGfxPrefetch_ *gfx_prefetch; /**< Space sheet being decoded in the background. */
    char* gfx_comm;   /**< Name of graphic for communication. */
    glTexture** gfx_overlays; /**< Array (array.h): Store overlay graphics. */
    ShipTrailEmitter* trail_emitters; /**< Trail emitters. */
 
    /* collision polygon */
    CollPoly *polygon; /**< Array (array.h): Collision polygons. */
+   int polygon_step; /**< Sprites per collision polygon, more than 1 if only keyframes are kept. */
 
    /* GUI interface */
    char* gui;        /**< Name of the GUI the ship uses by default. */
@@ -157,7 +164,7 @@ typedef struct Ship_ {
    double mangle;    /**< Mount angle to simplify mount calculations. */
 
    /* Statistics. */
-   char *desc_stats; /**< Ship statistics information. */
+   char *desc_stats; /**< Ship statistics information, use ship_descStats(). */
    ShipStatList *stats; /**< Ship statistics properties. */
    ShipStats stats_array; /**< Laid out stats for referencing purposes. */
 } Ship;
@@ -177,11 +184,19 @@ Ship* ship_getW( const char* name );
 const char *ship_existsCase( const char* name );
 const Ship* ship_getAll (void);
 const char* ship_class( const Ship* s );
+const char* ship_descStats( const Ship* s );
+void ships_descFlush (void);
 const char *ship_classToString( ShipClass class );
 ShipClass ship_classFromString( const char* str );
 credits_t ship_basePrice( const Ship* s );
 credits_t ship_buyPrice( const Ship* s );
 glTexture* ship_loadCommGFX( Ship* s );
+void ship_prefetchCommGFX( const Ship* s );
+int ship_gfxLoad( Ship *s );
+void ship_gfxRef( Ship *s );
+void ship_gfxUnref( Ship *s );
+void ship_gfxPrefetch( Ship *s );
+void ships_gfxPurge (void);
 int ship_size( const Ship *s );
 
 
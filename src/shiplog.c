@@ -8,11 +8,102 @@
  * @brief Handles a log/journal of the player's playthrough.
  */
 
+/** @cond */
+#include "naev.h"
+/** @endcond */
+
 #include "shiplog.h"
 /* Limit the journey log to 6 entries */
 
 static ShipLog *shipLog=NULL;
 ShipLogEntry *shiplog_removeEntry(ShipLogEntry *e);
+static int shiplog_grow( void );
+static int shiplog_indexOf( int logid );
+static void shiplog_removeLogEntries( int idx );
+static void shiplog_linkEntry( ShipLogEntry *e, int newest );
+
+/**
+ * @brief Adds a log to the lists, leaving it to be filled in.
+ *
+ * @return Index of the new log.
+ */
+static int shiplog_grow( void )
+{
+   int indx = shipLog->nlogs;
+   shipLog->nlogs++;
+   shipLog->idList = realloc(shipLog->idList, sizeof(int) * shipLog->nlogs);
+   shipLog->nameList = realloc(shipLog->nameList, sizeof(char*) * shipLog->nlogs);
+   shipLog->typeList = realloc(shipLog->typeList, sizeof(char*) * shipLog->nlogs);
+   shipLog->removeAfter = realloc(shipLog->removeAfter, sizeof(ntime_t) * shipLog->nlogs);
+   shipLog->idstrList = realloc(shipLog->idstrList, sizeof(char*) * shipLog->nlogs);
+   shipLog->maxLen = realloc(shipLog->maxLen, sizeof(int) * shipLog->nlogs);
+   shipLog->logHead = realloc(shipLog->logHead, sizeof(ShipLogEntry*) * shipLog->nlogs);
+   shipLog->logTail = realloc(shipLog->logTail, sizeof(ShipLogEntry*) * shipLog->nlogs);
+   shipLog->logCount = realloc(shipLog->logCount, sizeof(int) * shipLog->nlogs);
+   shipLog->logHead[indx] = NULL;
+   shipLog->logTail[indx] = NULL;
+   shipLog->logCount[indx] = 0;
+   return indx;
+}
+
+/**
+ * @brief Gets the index of a log in the lists.
+ *
+ * @param logid ID of the log.
+ * @return Index of the log or -1 if not found.
+ */
+static int shiplog_indexOf( int logid )
+{
+   int i;
+   if ( logid < 0 )
+      return -1;
+   for ( i=0; i<shipLog->nlogs; i++ )
+      if ( shipLog->idList[i] == logid )
+         return i;
+   return -1;
+}
+
+/**
+ * @brief Removes all the entries of a log.
+ *
+ * @param idx Index of the log.
+ */
+static void shiplog_removeLogEntries( int idx )
+{
+   while ( shipLog->logHead[idx] != NULL )
+      shiplog_removeEntry( shipLog->logHead[idx] );
+}
+
+/**
+ * @brief Links an entry into the entries of its log (e->idx).
+ *
+ * @param e Entry to link.
+ * @param newest Whether it is the newest entry of the log (or the oldest).
+ */
+static void shiplog_linkEntry( ShipLogEntry *e, int newest )
+{
+   int idx = e->idx;
+   e->lognext = NULL;
+   e->logprev = NULL;
+   if ( idx < 0 )
+      return;
+   if ( newest ) {
+      e->lognext = shipLog->logHead[idx];
+      if ( shipLog->logHead[idx] != NULL )
+         shipLog->logHead[idx]->logprev = e;
+      else
+         shipLog->logTail[idx] = e;
+      shipLog->logHead[idx] = e;
+   } else {
+      e->logprev = shipLog->logTail[idx];
+      if ( shipLog->logTail[idx] != NULL )
+         shipLog->logTail[idx]->lognext = e;
+      else
+         shipLog->logHead[idx] = e;
+      shipLog->logTail[idx] = e;
+   }
+   shipLog->logCount[idx]++;
+}
 
 /**
  * @brief Creates a new log with given title of given type.
@@ -27,7 +118,6 @@ ShipLogEntry *shiplog_removeEntry(ShipLogEntry *e);
 
 int shiplog_create(const char *idstr, const char *logname, const char *type, const int overwrite, const int maxLen)
 {
-   ShipLogEntry *e;
    int i, id, indx;
    if ( shipLog == NULL ) {
       shipLog = calloc( sizeof(ShipLog), 1);
@@ -59,15 +149,7 @@ int shiplog_create(const char *idstr, const char *logname, const char *type, con
          }
       }
       if ( i < shipLog->nlogs ) { /* prev id found - so remove all log entries of this type. */
-         e = shipLog->head;
-         while ( e != NULL ) {
-            if ( e->id == id ) {
-               /* remove this entry */
-               e = shiplog_removeEntry( e );
-            } else {
-               e = (ShipLogEntry*)e->next;
-            }
-         }
+         shiplog_removeLogEntries( i );
          shipLog->maxLen[i] = maxLen;
       }
    } else if ( overwrite == 2 ) {
@@ -79,14 +161,7 @@ int shiplog_create(const char *idstr, const char *logname, const char *type, con
                   && ( strcmp(idstr, shipLog->idstrList[i]) == 0 ) )
                || ( ( idstr == NULL )
                   && ( strcmp(type, shipLog->typeList[i]) == 0 ) ) ) {
-            e = shipLog->head;
-            while ( e != NULL ) {
-               if ( e->id == shipLog->idList[i] ) {
-                  e = shiplog_removeEntry( e );
-               } else {
-                  e = e->next;
-               }
-            }
+            shiplog_removeLogEntries( i );
             if ( found == 0 ) { /* This is the first entry of this type */
                found = 1;
                id = shipLog->idList[i];
@@ -123,13 +198,7 @@ int shiplog_create(const char *idstr, const char *logname, const char *type, con
             id = shipLog->idList[i];
       }
       id++;
-      shipLog->nlogs++;
-      shipLog->idList = realloc(shipLog->idList, sizeof(int) * shipLog->nlogs);
-      shipLog->nameList = realloc(shipLog->nameList, sizeof(char*) * shipLog->nlogs);
-      shipLog->typeList = realloc(shipLog->typeList, sizeof(char*) * shipLog->nlogs);
-      shipLog->removeAfter = realloc(shipLog->removeAfter, sizeof(ntime_t) * shipLog->nlogs);
-      shipLog->idstrList = realloc(shipLog->idstrList, sizeof(char*) * shipLog->nlogs);
-      shipLog->maxLen = realloc(shipLog->maxLen, sizeof(int) * shipLog->nlogs);
+      indx = shiplog_grow();
       shipLog->removeAfter[indx] = 0;
       shipLog->idList[indx] = id;
       shipLog->nameList[indx] = strdup(logname);
@@ -182,7 +251,7 @@ int shiplog_appendByID(const int logid,const char *msg)
 {
    ShipLogEntry *e;
    ntime_t now = ntime_get();
-   int i,maxLen=0;
+   int idx;
    if (shipLog == NULL)
       shiplog_new();
 
@@ -215,28 +284,14 @@ int shiplog_appendByID(const int logid,const char *msg)
    e->id = logid;
    e->msg = strdup(msg);
    e->time = now;
-   for ( i=0; i<shipLog->nlogs; i++ ) {
-      if ( shipLog->idList[i] == logid ) {
-         maxLen = shipLog->maxLen[i];
-         break;
-      }
-   }
-   if ( maxLen > 0 ) {
-      /* prune log entries if necessary */
-      i=0;
-      e = shipLog->head;
-      while ( e != NULL ) {
-         if ( e->id == logid ) {
-            i++;
-            if ( i > maxLen ) {
-               e = shiplog_removeEntry( e );
-            } else {
-               e = (ShipLogEntry*)e->next;
-            }
-         } else {
-            e = (ShipLogEntry*)e->next;
-         }
-      }
+   idx = shiplog_indexOf( logid );
+   e->idx = idx;
+   shiplog_linkEntry( e, 1 );
+
+   /* prune log entries if necessary, oldest first */
+   if ( ( idx >= 0 ) && ( shipLog->maxLen[idx] > 0 ) ) {
+      while ( shipLog->logCount[idx] > shipLog->maxLen[idx] )
+         shiplog_removeEntry( shipLog->logTail[idx] );
    }
    return 0;
 }
@@ -257,7 +312,12 @@ void shiplog_delete(const int logid)
    if ( logid < 0 && logid != LOG_ID_ALL )
       return;
 
-   e = shipLog->head;
+   /* Only walk the entries of the log when possible. */
+   i = shiplog_indexOf( logid );
+   if ( i >= 0 )
+      shiplog_removeLogEntries( i );
+
+   e = ( i >= 0 ) ? NULL : shipLog->head;
    while ( e != NULL ) {
       if ( logid == LOG_ID_ALL || logid == e->id ) {
          if ( e->prev != NULL )
@@ -279,6 +339,9 @@ void shiplog_delete(const int logid)
 
    for ( i=0; i<shipLog->nlogs; i++) {
       if ( logid == LOG_ID_ALL || logid == shipLog->idList[i] ) {
+         shipLog->logHead[i] = NULL;
+         shipLog->logTail[i] = NULL;
+         shipLog->logCount[i] = 0;
          shipLog->idList[i] = LOG_ID_INVALID;
          free(shipLog->nameList[i]);
          shipLog->nameList[i] = NULL;
@@ -349,6 +412,9 @@ void shiplog_clear(void)
    free( shipLog->idstrList );
    free( shipLog->maxLen );
    free( shipLog->removeAfter );
+   free( shipLog->logHead );
+   free( shipLog->logTail );
+   free( shipLog->logCount );
    memset(shipLog, 0, sizeof(ShipLog));
 }
 
@@ -427,13 +493,7 @@ int shiplog_load( xmlNodePtr parent )
                      break;
                }
                if ( i==shipLog->nlogs ) { /* a new ID */
-                  shipLog->nlogs++;
-                  shipLog->idList = realloc( shipLog->idList, sizeof(int) * shipLog->nlogs);
-                  shipLog->nameList = realloc( shipLog->nameList, sizeof(char*) * shipLog->nlogs);
-                  shipLog->typeList = realloc( shipLog->typeList, sizeof(char*) * shipLog->nlogs);
-                  shipLog->removeAfter = realloc( shipLog->removeAfter, sizeof(ntime_t) * shipLog->nlogs);
-                  shipLog->idstrList = realloc( shipLog->idstrList, sizeof(char*) * shipLog->nlogs);
-                  shipLog->maxLen = realloc( shipLog->maxLen, sizeof(int) * shipLog->nlogs);
+                  shiplog_grow();
                   shipLog->idList[shipLog->nlogs-1] = id;
                   xmlr_attr_strd( cur, "t", shipLog->typeList[shipLog->nlogs-1] );
                   xmlr_attr_long( cur, "r", shipLog->removeAfter[shipLog->nlogs-1] );
@@ -462,6 +522,12 @@ int shiplog_load( xmlNodePtr parent )
          } while (xml_nextNode(cur));
       }
    } while (xml_nextNode(node));
+
+   /* Index the entries by log, they are loaded newest first. */
+   for ( e=shipLog->head; e!=NULL; e=e->next ) {
+      e->idx = shiplog_indexOf( e->id );
+      shiplog_linkEntry( e, 0 );
+   }
    return 0;
 }
 
@@ -573,6 +639,18 @@ int shiplog_getIdOfLogOfType( const char *type, int selectedLog )
 ShipLogEntry *shiplog_removeEntry( ShipLogEntry *e )
 {
    ShipLogEntry *tmp;
+   /* remove this entry from its log */
+   if ( e->idx >= 0 ) {
+      if ( e->logprev != NULL )
+         ((ShipLogEntry*)e->logprev)->lognext = e->lognext;
+      else
+         shipLog->logHead[e->idx] = e->lognext;
+      if ( e->lognext != NULL )
+         ((ShipLogEntry*)e->lognext)->logprev = e->logprev;
+      else
+         shipLog->logTail[e->idx] = e->logprev;
+      shipLog->logCount[e->idx]--;
+   }
    /* remove this entry */
    if ( e->prev != NULL)
       ((ShipLogEntry*)e->prev)->next = e->next;
@@ -595,54 +673,61 @@ ShipLogEntry *shiplog_removeEntry( ShipLogEntry *e )
  */
 void shiplog_listLog( int logid, const char *type,int *nentries, char ***logentries, int incempty )
 {
-   int i,n = 0,all = 0;
+   shiplog_listLogRange( logid, type, 0, -1, nentries, logentries );
+   if ( ( *nentries == 0 ) && ( incempty != 0 ) ) {
+      /*empty list, so add "Empty" */
+      *nentries = 1;
+      *logentries = realloc(*logentries,sizeof(char*));
+      (*logentries)[0] = strdup(_("Empty"));
+   }
+}
+
+/**
+ * @brief Gets a range of the entries shiplog_listLog() would get, newest first.
+ *
+ * Entries of a single log are found through the log, so getting a few of them
+ * doesn't depend on the size of the whole ship log.
+ *
+ * @param logid ID of the log, or LOG_ID_ALL for the entries of all the logs.
+ * @param type Type of the logs, currently unused like in shiplog_listLog().
+ * @param start Number of matching entries to skip.
+ * @param max Maximum number of entries to get, or -1 for all.
+ * @param[out] nentries Number of entries got.
+ * @param[out] logentries Entries got, to be freed along with the list.
+ */
+void shiplog_listLogRange( int logid, const char *type, int start, int max, int *nentries, char ***logentries )
+{
+   int idx, n = 0, m = 0, skip = 0;
    char **entries = NULL;
-   ShipLogEntry *e, *use;
+   ShipLogEntry *e;
    char buf[5000];
    int pos;
-   e = shipLog->head;
+   (void) type;
+
    if ( logid == LOG_ID_ALL ) {
-      all = 1;
+      e = shipLog->head;
+   } else {
+      idx = shiplog_indexOf( logid );
+      e = ( idx >= 0 ) ? shipLog->logHead[idx] : NULL;
    }
-   while ( e != NULL ) {
-      use = NULL;
-      if ( logid == LOG_ID_ALL ) {
-         if ( all ) { /* add the log */
-            if ( e->id >= 0)
-               use=e;
-         } else { /* see if this log is of type */
-            for ( i=0; i<shipLog->nlogs; i++ ) {
-               if ( ( shipLog->idList[i] >= 0 )
-                     && ( e->id == shipLog->idList[i] )
-                     && ( strcmp(shipLog->typeList[i], type) == 0 ) ) {
-                  /* the type matches current messages */
-                  use = e;
-                  break; /* there should only be 1 log of this type and id. */
-               }
+
+   while ( ( e != NULL ) && ( ( max < 0 ) || ( n < max ) ) ) {
+      if ( e->id >= 0 ) {
+         if ( skip < start ) {
+            skip++;
+         } else {
+            n++;
+            if ( n > m ) {
+               m = MAX( 16, 2*m );
+               entries = realloc(entries, sizeof(char*) * m);
             }
+            ntime_prettyBuf(buf, sizeof(buf), e->time, 2);
+            pos = strlen(buf);
+            scnprintf(&buf[pos], sizeof(buf)-pos, ":  %s", e->msg);
+            entries[n-1] = strdup(buf);
          }
-      } else { /* just this particular log*/
-         if ( e->id == logid ) {
-            use = e;
-         }
-      }
-      if ( use != NULL ) {
-         n++;
-         entries = realloc(entries, sizeof(char*) * n);
-         ntime_prettyBuf(buf, sizeof(buf), use->time, 2);
-         pos = strlen(buf);
-         pos += scnprintf(&buf[pos], sizeof(buf)-pos, ":  %s", use->msg);
-         entries[n-1] = strdup(buf);
       }
-
-      e = e -> next;
-   }
-   (void)pos;
-   if ( ( n == 0 ) && ( incempty != 0 ) ) {
-      /*empty list, so add "Empty" */
-      n = 1;
-      entries = realloc(entries,sizeof(char*));
-      entries[0] = strdup(_("Empty"));
+      e = ( logid == LOG_ID_ALL ) ? e->next : e->lognext;
    }
    *logentries = entries;
    *nentries = n;
@@ -40,16 +40,20 @@ void shiplog_listTypes( int *ntypes, char ***logTypes, int includeAll );
 void shiplog_listLogsOfType( const char *type, int *nlogs, char ***logsOut, int **logIDs, int includeAll );
 int shiplog_getIdOfLogOfType ( const char *type, int selectedLog );
 void shiplog_listLog( int logid, const char *type,int *nentries, char ***logentries,int incempty );
+void shiplog_listLogRange( int logid, const char *type, int start, int max, int *nentries, char ***logentries );
 int shiplog_getID( const char *idstr );
 
 
 /*Hold a single log entry - a double linked list*/
 typedef struct {
   int id;
+  int idx; /* Index of the log in the ShipLog lists, -1 if not found. */
   ntime_t time;
   char *msg;
   void *next;
   void *prev;
+  void *lognext; /* Next (older) entry of the same log. */
+  void *logprev; /* Previous (newer) entry of the same log. */
 
 } ShipLogEntry;
 
@@ -62,6 +66,9 @@ typedef struct {
   char **idstrList;
   int *maxLen;
   int nlogs;
+  ShipLogEntry **logHead; /* Newest entry of each log. */
+  ShipLogEntry **logTail; /* Oldest entry of each log. */
+  int *logCount; /* Number of entries of each log. */
   ShipLogEntry *head;/*The head (newest entry)*/
   ShipLogEntry *tail;/*The tail (oldest entry)*/
 } ShipLog;
@@ -162,9 +162,23 @@ static const ShipStatsLookup ss_lookup[] = {
 };
 
 
+/*
+ * Merge tables, the offsets of the stats grouped by how they get merged.
+ */
+static size_t ss_mergeMul[SS_TYPE_SENTINEL]; /**< Relative doubles, multiplied. */
+static size_t ss_mergeAdd[SS_TYPE_SENTINEL]; /**< Absolute doubles, added. */
+static size_t ss_mergeInt[SS_TYPE_SENTINEL]; /**< Integers, added. */
+static size_t ss_mergeBool[SS_TYPE_SENTINEL]; /**< Booleans, or'd. */
+static int ss_nmergeMul  = -1; /**< Number of relative doubles, -1 if not built. */
+static int ss_nmergeAdd  = 0; /**< Number of absolute doubles. */
+static int ss_nmergeInt  = 0; /**< Number of integers. */
+static int ss_nmergeBool = 0; /**< Number of booleans. */
+
+
 /*
  * Prototypes.
  */
+static void ss_mergeInit (void);
 static const char* ss_printD_colour( double d, const ShipStatsLookup *sl );
 static const char* ss_printI_colour( int i, const ShipStatsLookup *sl );
 static int ss_printD( char *buf, int len, int newline, double d, const ShipStatsLookup *sl );
@@ -282,53 +296,68 @@ int ss_statsInit( ShipStats *stats )
 
 
 /**
- * @brief Merges two different ship stats.
- *
- *    @param dest Destination ship stats.
- *    @param src Source to be merged with destination.
+ * @brief Builds the merge tables so merging doesn't go through the look up table.
  */
-int ss_statsMerge( ShipStats *dest, const ShipStats *src )
+static void ss_mergeInit (void)
 {
    int i;
-   int *destint;
-   const int *srcint;
-   double *destdbl;
-   const double *srcdbl;
-   char *destptr;
-   const char *srcptr;
    const ShipStatsLookup *sl;
 
-   destptr = (char*) dest;
-   srcptr = (const char*) src;
+   ss_nmergeMul  = 0;
+   ss_nmergeAdd  = 0;
+   ss_nmergeInt  = 0;
+   ss_nmergeBool = 0;
    for (i=0; i<SS_TYPE_SENTINEL; i++) {
       sl = &ss_lookup[ i ];
 
+      /* Only want valid names. */
+      if (sl->name == NULL)
+         continue;
+
       switch (sl->data) {
          case SS_DATA_TYPE_DOUBLE:
-            destdbl = (double*) &destptr[ sl->offset ];
-            srcdbl = (const double*) &srcptr[ sl->offset ];
-            *destdbl = (*destdbl) * (*srcdbl);
+            ss_mergeMul[ ss_nmergeMul++ ] = sl->offset;
             break;
-
          case SS_DATA_TYPE_DOUBLE_ABSOLUTE:
-            destdbl = (double*) &destptr[ sl->offset ];
-            srcdbl = (const double*) &srcptr[ sl->offset ];
-            *destdbl = (*destdbl) + (*srcdbl);
+            ss_mergeAdd[ ss_nmergeAdd++ ] = sl->offset;
             break;
-
          case SS_DATA_TYPE_INTEGER:
-            destint = (int*) &destptr[ sl->offset ];
-            srcint = (const int*) &srcptr[ sl->offset ];
-            *destint = (*destint) + (*srcint);
+            ss_mergeInt[ ss_nmergeInt++ ] = sl->offset;
             break;
-
          case SS_DATA_TYPE_BOOLEAN:
-            destint = (int*) &destptr[ sl->offset ];
-            srcint = (const int*) &srcptr[ sl->offset ];
-            *destint = !!((*destint) + (*srcint));
+            ss_mergeBool[ ss_nmergeBool++ ] = sl->offset;
             break;
       }
    }
+}
+
+
+/**
+ * @brief Merges two different ship stats.
+ *
+ *    @param dest Destination ship stats.
+ *    @param src Source to be merged with destination.
+ */
+int ss_statsMerge( ShipStats *dest, const ShipStats *src )
+{
+   int i;
+   char *destptr;
+   const char *srcptr;
+
+   if (ss_nmergeMul < 0)
+      ss_mergeInit();
+
+   /* Each table is a tight loop over a single type, no switching per stat. */
+   destptr = (char*) dest;
+   srcptr = (const char*) src;
+   for (i=0; i<ss_nmergeMul; i++)
+      *(double*)&destptr[ ss_mergeMul[i] ] *= *(const double*)&srcptr[ ss_mergeMul[i] ];
+   for (i=0; i<ss_nmergeAdd; i++)
+      *(double*)&destptr[ ss_mergeAdd[i] ] += *(const double*)&srcptr[ ss_mergeAdd[i] ];
+   for (i=0; i<ss_nmergeInt; i++)
+      *(int*)&destptr[ ss_mergeInt[i] ] += *(const int*)&srcptr[ ss_mergeInt[i] ];
+   for (i=0; i<ss_nmergeBool; i++)
+      *(int*)&destptr[ ss_mergeBool[i] ] |= *(const int*)&srcptr[ ss_mergeBool[i] ];
 
    return 0;
 }
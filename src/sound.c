@@ -33,14 +33,41 @@
 #include "physics.h"
 #include "player.h"
 #include "sound_openal.h"
+#include "threadpool.h"
 
 
 #define SOUND_SUFFIX_WAV   ".wav" /**< Suffix of sounds. */
 #define SOUND_SUFFIX_OGG   ".ogg" /**< Suffix of sounds. */
 
+#define SOUND_QUEUE_SIZE   1024 /**< Commands in the voice queue, must be a power of two. */
+#define SOUND_THREAD_DELAY 5 /**< Milliseconds between audio thread updates. */
+#define SOUND_EVICT_DELAY  1000 /**< Milliseconds a played sound is kept loaded at least. */
 
-#define voiceLock()        SDL_LockMutex(voice_mutex)
-#define voiceUnlock()      SDL_UnlockMutex(voice_mutex)
+
+/**
+ * @brief Types of commands sent to the audio thread.
+ */
+typedef enum SoundCmdType_ {
+   SOUND_CMD_PLAY, /**< Play a sound. */
+   SOUND_CMD_PLAYPOS, /**< Play a sound at a position. */
+   SOUND_CMD_MOVE, /**< Update the position of a voice. */
+   SOUND_CMD_STOP, /**< Stop a voice. */
+   SOUND_CMD_STOPALL /**< Stop all the voices. */
+} SoundCmdType;
+
+
+/**
+ * @brief Command sent from the game to the audio thread.
+ */
+typedef struct SoundCmd_ {
+   SoundCmdType type; /**< Type of command. */
+   int id; /**< Voice the command applies to. */
+   alSound snd; /**< Sound to play, only the buffer gets used. */
+   double px; /**< X position. */
+   double py; /**< Y position. */
+   double vx; /**< X velocity. */
+   double vy; /**< Y velocity. */
+} SoundCmd;
 
 
 /*
@@ -54,15 +81,28 @@ static int sound_initialized  = 0; /**< Whether or not sound is initialized. */
  * Sound list.
  */
 static alSound *sound_list    = NULL; /**< List of available sounds. */
+static SDL_mutex *sound_loadLock = NULL; /**< Lock for the loading state of sounds. */
+static SDL_cond *sound_loadCond  = NULL; /**< Signals sounds finished loading. */
+static size_t sound_mem       = 0; /**< Memory used by the loaded sounds. */
 
 
 /*
- * Voices.
+ * Voices, they belong to the audio thread.
  */
 static int voice_genid        = 0; /**< Voice identifier generator. */
 alVoice *voice_active         = NULL; /**< Active voices. */
 static alVoice *voice_pool    = NULL; /**< Pool of free voices. */
-static SDL_mutex *voice_mutex = NULL; /**< Lock for voices. */
+
+
+/*
+ * Single producer single consumer queue of commands from the game to the
+ *  audio thread, which applies them and updates the voices.
+ */
+static SoundCmd sound_queue[SOUND_QUEUE_SIZE]; /**< Command ring. */
+static SDL_atomic_t sound_queueWrite; /**< Commands written, by the game. */
+static SDL_atomic_t sound_queueRead; /**< Commands read, by the audio thread. */
+static SDL_atomic_t sound_threadRun; /**< Whether the audio thread should keep running. */
+static SDL_Thread *sound_thread = NULL; /**< Audio thread. */
 
 
 /*
@@ -79,7 +119,17 @@ static double snd_compression_gain = 0.; /**< Current compression gain. */
 /* General. */
 static int sound_makeList (void);
 static void sound_free( alSound *snd );
+/* Loading. */
+static int sound_loadJob( void *data );
+static int sound_loadFile( alSound *snd, const char *filename, const char *name );
+static alSound* sound_acquire( int sound );
+static void sound_evict( const alSound *keep );
 /* Voices. */
+static int sound_queuePush( const SoundCmd *cmd );
+static void sound_queuePushWait( const SoundCmd *cmd );
+static void sound_queueApply (void);
+static void sound_updateVoices (void);
+static int sound_threadMain( void *unused );
 
 
 /**
@@ -110,10 +160,9 @@ int sound_init (void)
       return ret;
    }
 
-   /* Create voice lock. */
-   voice_mutex = SDL_CreateMutex();
-   if (voice_mutex == NULL)
-      WARN(_("Unable to create voice mutex."));
+   /* Create loading lock. */
+   sound_loadLock = SDL_CreateMutex();
+   sound_loadCond = SDL_CreateCond();
 
    /* Load available sounds. */
    ret = sound_makeList();
@@ -134,6 +183,16 @@ int sound_init (void)
    }
    sound_volume(conf.sound);
 
+   /* Start the audio thread. */
+   if (!sound_disabled) {
+      SDL_AtomicSet( &sound_queueWrite, 0 );
+      SDL_AtomicSet( &sound_queueRead, 0 );
+      SDL_AtomicSet( &sound_threadRun, 1 );
+      sound_thread = SDL_CreateThread( sound_threadMain, "sound_thread", NULL );
+      if (sound_thread == NULL)
+         WARN(_("Unable to create the audio thread, voices will be updated with the game."));
+   }
+
    /* Initialized. */
    sound_initialized = 1;
 
@@ -164,30 +223,42 @@ void sound_exit (void)
    /* Exit music subsystem. */
    music_exit();
 
-   if (voice_mutex != NULL) {
-      voiceLock();
-      /* free the voices. */
-      while (voice_active != NULL) {
-         v = voice_active;
-         voice_active = v->next;
-         free(v);
-      }
-      while (voice_pool != NULL) {
-         v = voice_pool;
-         voice_pool = v->next;
-         free(v);
-      }
-      voiceUnlock();
+   /* Stop the audio thread, the voices are ours afterwards. */
+   if (sound_thread != NULL) {
+      SDL_AtomicSet( &sound_threadRun, 0 );
+      SDL_WaitThread( sound_thread, NULL );
+      sound_thread = NULL;
+   }
 
-      /* Destroy voice lock. */
-      SDL_DestroyMutex(voice_mutex);
-      voice_mutex = NULL;
+   /* free the voices. */
+   while (voice_active != NULL) {
+      v = voice_active;
+      voice_active = v->next;
+      free(v);
    }
+   while (voice_pool != NULL) {
+      v = voice_pool;
+      voice_pool = v->next;
+      free(v);
+   }
+
+   /* Wait for the sounds loading in the background. */
+   SDL_LockMutex( sound_loadLock );
+   for (i=0; i<array_size(sound_list); i++)
+      while (sound_list[i].state == SOUND_LOADING)
+         SDL_CondWait( sound_loadCond, sound_loadLock );
+   SDL_UnlockMutex( sound_loadLock );
 
    /* free the sounds */
    for (i=0; i<array_size(sound_list); i++)
       sound_free( &sound_list[i] );
    array_free( sound_list );
+   sound_list = NULL;
+   sound_mem  = 0;
+   SDL_DestroyMutex( sound_loadLock );
+   SDL_DestroyCond( sound_loadCond );
+   sound_loadLock = NULL;
+   sound_loadCond = NULL;
 
    /* Exit sound subsystem. */
    sound_al_exit();
@@ -205,14 +276,30 @@ void sound_exit (void)
  */
 int sound_get( const char* name )
 {
-   int i;
+   int i, prefetch;
 
    if (sound_disabled)
       return 0;
 
-   for (i=0; i<array_size(sound_list); i++)
-      if (strcmp(name, sound_list[i].name)==0)
-         return i;
+   for (i=0; i<array_size(sound_list); i++) {
+      if (strcmp(name, sound_list[i].name)!=0)
+         continue;
+
+      /* Start decoding it in the background while there is memory for it. */
+      SDL_LockMutex( sound_loadLock );
+      prefetch = (sound_list[i].state == SOUND_UNLOADED) &&
+            ((conf.snd_cache <= 0) || (sound_mem < (size_t)conf.snd_cache * 1024 * 1024));
+      if (prefetch)
+         sound_list[i].state = SOUND_LOADING;
+      SDL_UnlockMutex( sound_loadLock );
+      if (prefetch && (threadpool_newJob( sound_loadJob, (void*)(intptr_t)i ) != 0)) {
+         SDL_LockMutex( sound_loadLock );
+         sound_list[i].state = SOUND_UNLOADED;
+         SDL_CondBroadcast( sound_loadCond );
+         SDL_UnlockMutex( sound_loadLock );
+      }
+      return i;
+   }
 
    WARN(_("Sound '%s' not found in sound list"), name);
    return -1;
@@ -227,10 +314,170 @@ int sound_get( const char* name )
  */
 double sound_getLength( int sound )
 {
+   alSound *s;
+
    if (sound_disabled)
       return 0.;
 
-   return sound_list[sound].length;
+   s = sound_acquire( sound );
+   if (s == NULL)
+      return 0.;
+   return s->length;
+}
+
+
+/**
+ * @brief Loads a sound from a file.
+ *
+ *    @param snd Sound to load into.
+ *    @param filename File to load.
+ *    @param name Name of the sound for errors.
+ *    @return 0 on success.
+ */
+static int sound_loadFile( alSound *snd, const char *filename, const char *name )
+{
+   int ret;
+   SDL_RWops *rw;
+
+   rw = PHYSFSRWOPS_openRead( filename );
+   if (rw == NULL) {
+      WARN(_("Sound '%s' not found."), filename);
+      return -1;
+   }
+   ret = sound_al_load( snd, rw, name );
+   SDL_RWclose( rw );
+   return ret;
+}
+
+
+/**
+ * @brief Loads a sound on the threadpool.
+ *
+ *    @param data Index of the sound, which is in the SOUND_LOADING state.
+ */
+static int sound_loadJob( void *data )
+{
+   int ret;
+   alSound snd, *s;
+   char *filename, *name;
+
+   /* The list can get reallocated while loading. */
+   SDL_LockMutex( sound_loadLock );
+   s = &sound_list[ (intptr_t)data ];
+   filename = strdup( s->filename );
+   name     = strdup( s->name );
+   SDL_UnlockMutex( sound_loadLock );
+
+   memset( &snd, 0, sizeof(alSound) );
+   ret = sound_loadFile( &snd, filename, name );
+
+   SDL_LockMutex( sound_loadLock );
+   s = &sound_list[ (intptr_t)data ];
+   if (ret == 0) {
+      s->buf    = snd.buf;
+      s->length = snd.length;
+      s->size   = snd.size;
+      s->state  = SOUND_LOADED;
+      sound_mem += s->size;
+   }
+   else
+      s->state  = SOUND_FAILED;
+   SDL_CondBroadcast( sound_loadCond );
+   SDL_UnlockMutex( sound_loadLock );
+
+   free( filename );
+   free( name );
+   return 0;
+}
+
+
+/**
+ * @brief Gets a sound ready to play, loading it if needed.
+ *
+ *    @param sound ID of the sound.
+ *    @return The sound or NULL if it failed to load.
+ */
+static alSound* sound_acquire( int sound )
+{
+   alSound *s;
+
+   if ((sound < 0) || (sound >= array_size(sound_list)))
+      return NULL;
+
+   SDL_LockMutex( sound_loadLock );
+   s = &sound_list[sound];
+
+   /* Wait for the background load. */
+   while (s->state == SOUND_LOADING)
+      SDL_CondWait( sound_loadCond, sound_loadLock );
+
+   /* Not loaded yet or unloaded to save memory. */
+   if (s->state == SOUND_UNLOADED) {
+      if ((s->filename != NULL) && (sound_loadFile( s, s->filename, s->name ) == 0)) {
+         s->state   = SOUND_LOADED;
+         sound_mem += s->size;
+      }
+      else
+         s->state = SOUND_FAILED;
+   }
+
+   if (s->state != SOUND_LOADED) {
+      SDL_UnlockMutex( sound_loadLock );
+      return NULL;
+   }
+   s->used = SDL_GetTicks();
+   sound_evict( s );
+   SDL_UnlockMutex( sound_loadLock );
+
+   return s;
+}
+
+
+/**
+ * @brief Unloads the least recently played sounds until under budget.
+ *
+ * Must be called with the loading lock held.
+ *
+ *    @param keep Sound not to unload.
+ */
+static void sound_evict( const alSound *keep )
+{
+   int i, j, tries;
+   size_t budget;
+   unsigned int t;
+   alSound *s;
+
+   if ((conf.snd_cache <= 0) || (sound_mem <= (size_t)conf.snd_cache * 1024 * 1024))
+      return;
+   budget = (size_t)conf.snd_cache * 1024 * 1024;
+   t      = SDL_GetTicks();
+
+   for (tries=0; (sound_mem > budget) && (tries < array_size(sound_list)); tries++) {
+      /* Find the least recently used sound that can be reloaded. */
+      j = -1;
+      for (i=0; i<array_size(sound_list); i++) {
+         s = &sound_list[i];
+         if ((s == keep) || (s->state != SOUND_LOADED) || (s->filename == NULL))
+            continue;
+         /* Its play command may still be in the audio thread's queue. */
+         if (t - s->used < SOUND_EVICT_DELAY)
+            continue;
+         if ((j < 0) || (s->used < sound_list[j].used))
+            j = i;
+      }
+      if (j < 0)
+         break;
+
+      /* Still playing, try it last next time. */
+      s = &sound_list[j];
+      if (sound_al_unload( s )) {
+         s->used = SDL_GetTicks();
+         continue;
+      }
+      sound_mem -= s->size;
+      s->size    = 0;
+      s->state   = SOUND_UNLOADED;
+   }
 }
 
 
@@ -242,31 +489,26 @@ double sound_getLength( int sound )
  */
 int sound_play( int sound )
 {
-   alVoice *v;
+   SoundCmd cmd;
    alSound *s;
 
    if (sound_disabled)
       return 0;
 
-   if ((sound < 0) || (sound >= array_size(sound_list)))
-      return -1;
-
-   /* Gets a new voice. */
-   v = voice_new();
-
    /* Get the sound. */
-   s = &sound_list[sound];
-
-   /* Try to play the sound. */
-   if (sound_al_play( v, s ))
+   s = sound_acquire( sound );
+   if (s == NULL)
       return -1;
 
-   /* Set state and add to list. */
-   v->state = VOICE_PLAYING;
-   v->id = ++voice_genid;
-   voice_add(v);
+   /* Have the audio thread play it. */
+   memset( &cmd, 0, sizeof(SoundCmd) );
+   cmd.type = SOUND_CMD_PLAY;
+   cmd.id   = ++voice_genid;
+   cmd.snd  = *s;
+   if (sound_queuePush( &cmd ))
+      return -1;
 
-   return v->id;
+   return cmd.id;
 }
 
 
@@ -282,7 +524,7 @@ int sound_play( int sound )
  */
 int sound_playPos( int sound, double px, double py, double vx, double vy )
 {
-   alVoice *v;
+   SoundCmd cmd;
    alSound *s;
    Pilot *p;
    double cx, cy, dist;
@@ -310,22 +552,27 @@ int sound_playPos( int sound, double px, double py, double vx, double vy )
          return 0;
    }
 
-   /* Gets a new voice. */
-   v = voice_new();
+   /* Too far to hear, don't bother with a voice. */
+   if (sound_al_attenuation( px, py ) <= 0.)
+      return 0;
 
    /* Get the sound. */
-   s = &sound_list[sound];
-
-   /* Try to play the sound. */
-   if (sound_al_playPos( v, s, px, py, vx, vy ))
+   s = sound_acquire( sound );
+   if (s == NULL)
       return -1;
 
-   /* Actually add the voice to the list. */
-   v->state = VOICE_PLAYING;
-   v->id = ++voice_genid;
-   voice_add(v);
+   /* Have the audio thread play it. */
+   cmd.type = SOUND_CMD_PLAYPOS;
+   cmd.id   = ++voice_genid;
+   cmd.snd  = *s;
+   cmd.px   = px;
+   cmd.py   = py;
+   cmd.vx   = vx;
+   cmd.vy   = vy;
+   if (sound_queuePush( &cmd ))
+      return -1;
 
-   return v->id;
+   return cmd.id;
 }
 
 
@@ -340,20 +587,22 @@ int sound_playPos( int sound, double px, double py, double vx, double vy )
  */
 int sound_updatePos( int voice, double px, double py, double vx, double vy )
 {
-   alVoice *v;
+   SoundCmd cmd;
 
    if (sound_disabled)
       return 0;
 
-   v = voice_get(voice);
-   if (v != NULL) {
-
-      /* Update the voice. */
-      if (sound_al_updatePos( v, px, py, vx, vy))
-         return -1;
-   }
+   if (voice <= 0)
+      return 0;
 
-   return 0;
+   memset( &cmd, 0, sizeof(SoundCmd) );
+   cmd.type = SOUND_CMD_MOVE;
+   cmd.id   = voice;
+   cmd.px   = px;
+   cmd.py   = py;
+   cmd.vx   = vx;
+   cmd.vy   = vy;
+   return sound_queuePush( &cmd );
 }
 
 
@@ -364,8 +613,6 @@ int sound_updatePos( int voice, double px, double py, double vx, double vy )
  */
 int sound_update( double dt )
 {
-   alVoice *v, *tv;
-
    /* Update music if needed. */
    music_update(dt);
 
@@ -375,10 +622,124 @@ int sound_update( double dt )
    /* System update. */
    sound_al_update();
 
-   if (voice_active == NULL)
-      return 0;
+   /* No audio thread, so the game has to do its work. */
+   if (sound_thread == NULL) {
+      sound_queueApply();
+      sound_updateVoices();
+   }
+
+   return 0;
+}
 
-   voiceLock();
+
+/**
+ * @brief Queues a command for the audio thread.
+ *
+ * Only the game thread may call this.
+ *
+ *    @param cmd Command to queue.
+ *    @return 0 on success, -1 if the queue is full.
+ */
+static int sound_queuePush( const SoundCmd *cmd )
+{
+   unsigned int w, r;
+
+   w = (unsigned int) SDL_AtomicGet( &sound_queueWrite );
+   r = (unsigned int) SDL_AtomicGet( &sound_queueRead );
+   if (w - r >= SOUND_QUEUE_SIZE)
+      return -1;
+
+   sound_queue[ w & (SOUND_QUEUE_SIZE-1) ] = *cmd;
+
+   /* Publishes the command, SDL atomics are full barriers. */
+   SDL_AtomicSet( &sound_queueWrite, (int)(w+1) );
+   return 0;
+}
+
+
+/**
+ * @brief Queues a command for the audio thread, waiting for room if needed.
+ *
+ * For commands that can't be dropped.
+ *
+ *    @param cmd Command to queue.
+ */
+static void sound_queuePushWait( const SoundCmd *cmd )
+{
+   while (sound_queuePush( cmd )) {
+      if (sound_thread == NULL)
+         sound_queueApply();
+      else
+         SDL_Delay( 1 );
+   }
+}
+
+
+/**
+ * @brief Applies the queued commands to the voices.
+ *
+ * Only the audio thread may call this.
+ */
+static void sound_queueApply (void)
+{
+   unsigned int w, r;
+   SoundCmd *cmd;
+   alVoice *v;
+   int ret;
+
+   w = (unsigned int) SDL_AtomicGet( &sound_queueWrite );
+   r = (unsigned int) SDL_AtomicGet( &sound_queueRead );
+   for (; r != w; r++) {
+      cmd = &sound_queue[ r & (SOUND_QUEUE_SIZE-1) ];
+      switch (cmd->type) {
+         case SOUND_CMD_PLAY:
+         case SOUND_CMD_PLAYPOS:
+            v = voice_new();
+            if (cmd->type == SOUND_CMD_PLAY)
+               ret = sound_al_play( v, &cmd->snd );
+            else
+               ret = sound_al_playPos( v, &cmd->snd, cmd->px, cmd->py, cmd->vx, cmd->vy );
+            if (ret)
+               break;
+            v->state = VOICE_PLAYING;
+            v->id    = cmd->id;
+            voice_add( v );
+            break;
+
+         case SOUND_CMD_MOVE:
+            v = voice_get( cmd->id );
+            if (v != NULL)
+               sound_al_updatePos( v, cmd->px, cmd->py, cmd->vx, cmd->vy );
+            break;
+
+         case SOUND_CMD_STOP:
+            v = voice_get( cmd->id );
+            if (v != NULL) {
+               sound_al_stop( v );
+               v->state = VOICE_STOPPED;
+            }
+            break;
+
+         case SOUND_CMD_STOPALL:
+            for (v=voice_active; v!=NULL; v=v->next) {
+               sound_al_stop( v );
+               v->state = VOICE_STOPPED;
+            }
+            break;
+      }
+   }
+   SDL_AtomicSet( &sound_queueRead, (int)r );
+}
+
+
+/**
+ * @brief Updates the voices, tossing the finished ones into the pool.
+ *
+ * Only the audio thread may call this.
+ */
+static void sound_updateVoices (void)
+{
+   alVoice *v, *tv;
 
    /* The actual control loop. */
    for (v=voice_active; v!=NULL; v=v->next) {
@@ -415,8 +776,27 @@ int sound_update( double dt )
             break;
       }
    }
+}
+
+
+/**
+ * @brief Audio thread, applies the commands of the game to the voices.
+ *
+ *    @param unused Unused.
+ */
+static int sound_threadMain( void *unused )
+{
+   (void) unused;
+
+   while (SDL_AtomicGet( &sound_threadRun )) {
+      sound_queueApply();
+      sound_updateVoices();
+      SDL_Delay( SOUND_THREAD_DELAY );
+   }
 
-   voiceUnlock();
+   /* Don't leave anything playing. */
+   sound_queueApply();
+   sound_updateVoices();
 
    return 0;
 }
@@ -457,21 +837,14 @@ void sound_resume (void)
  */
 void sound_stopAll (void)
 {
-   alVoice *v;
+   SoundCmd cmd;
 
    if (sound_disabled)
       return;
 
-   /* Make sure there are voices. */
-   if (voice_active==NULL)
-      return;
-
-   voiceLock();
-   for (v=voice_active; v!=NULL; v=v->next) {
-      sound_al_stop( v );
-      v->state = VOICE_STOPPED;
-   }
-   voiceUnlock();
+   memset( &cmd, 0, sizeof(SoundCmd) );
+   cmd.type = SOUND_CMD_STOPALL;
+   sound_queuePushWait( &cmd );
 }
 
 
@@ -482,17 +855,18 @@ void sound_stopAll (void)
  */
 void sound_stop( int voice )
 {
-   alVoice *v;
+   SoundCmd cmd;
 
    if (sound_disabled)
       return;
 
-   v = voice_get(voice);
-   if (v != NULL) {
-      sound_al_stop( v );
-      v->state = VOICE_STOPPED;
-   }
+   if (voice <= 0)
+      return;
 
+   memset( &cmd, 0, sizeof(SoundCmd) );
+   cmd.type = SOUND_CMD_STOP;
+   cmd.id   = voice;
+   sound_queuePushWait( &cmd );
 }
 
 
@@ -566,7 +940,7 @@ static int sound_makeList (void)
    size_t i;
    char path[PATH_MAX];
    int len, suflen, flen;
-   SDL_RWops *rw;
+   alSound *snd;
 
    if (sound_disabled)
       return 0;
@@ -591,19 +965,21 @@ static int sound_makeList (void)
             (strncmp( &files[i][flen - suflen], SOUND_SUFFIX_OGG, suflen)!=0))
          continue;
 
-      /* Load the sound. */
+      /* Sounds get loaded when first needed. */
       snprintf( path, sizeof(path), SOUND_PATH"%s", files[i] );
-      rw = PHYSFSRWOPS_openRead( path );
 
       /* remove the suffix */
       len = flen - suflen;
       files[i][len] = '\0';
 
-      source_newRW( rw, files[i], 0 );
-      SDL_RWclose( rw );
+      snd = &array_grow( &sound_list );
+      memset( snd, 0, sizeof(alSound) );
+      snd->name     = strdup( files[i] );
+      snd->filename = strdup( path );
+      snd->state    = SOUND_UNLOADED;
    }
 
-   DEBUG( n_("Loaded %d Sound", "Loaded %d Sounds", array_size(sound_list)), array_size(sound_list) );
+   DEBUG( n_("Found %d Sound", "Found %d Sounds", array_size(sound_list)), array_size(sound_list) );
 
    /* Clean up. */
    PHYSFS_freeList( files );
@@ -667,7 +1043,8 @@ static void sound_free( alSound *snd )
    free(snd->filename);
 
    /* Free internals. */
-   sound_al_free(snd);
+   if (snd->state == SOUND_LOADED)
+      sound_al_free(snd);
 }
 
 
@@ -696,13 +1073,16 @@ int sound_createGroup( int size )
  */
 int sound_playGroup( int group, int sound, int once )
 {
+   alSound *s;
+
    if (sound_disabled)
       return 0;
 
-   if ((sound < 0) || (sound >= array_size(sound_list)))
+   s = sound_acquire( sound );
+   if (s == NULL)
       return -1;
 
-   return sound_al_playGroup( group, &sound_list[sound], once );
+   return sound_al_playGroup( group, s, once );
 }
 
 
@@ -794,24 +1174,6 @@ int sound_env( SoundEnv_t env, double param )
 }
 
 
-/**
- * @brief Locks the voices.
- */
-void voice_lock (void)
-{
-   voiceLock();
-}
-
-
-/**
- * @brief Unlocks the voices.
- */
-void voice_unlock (void)
-{
-   voiceUnlock();
-}
-
-
 /**
  * @brief Gets a new voice ready to be used.
  *
@@ -858,14 +1220,12 @@ int voice_add( alVoice* v )
    }
 
    /* Insert to the front of active voices. */
-   voiceLock();
    tv = voice_active;
    v->next = tv;
    v->prev = NULL;
    voice_active = v;
    if (tv != NULL)
       tv->prev = v;
-   voiceUnlock();
    return 0;
 }
 
@@ -884,11 +1244,9 @@ alVoice* voice_get( int id )
    if (voice_active==NULL)
       return NULL;
 
-   voiceLock();
    for (v=voice_active; v!=NULL; v=v->next)
       if (v->id == id)
          break;
-   voiceUnlock();
 
    return v;
 }
@@ -910,12 +1268,18 @@ int source_newRW( SDL_RWops *rw, const char *name, unsigned int flags )
    ret = sound_al_load( &snd, rw, name );
    if (ret)
       return -1;
+   snd.state = SOUND_LOADED;
 
+   /* Not reloadable so never unloaded, but counts towards the budget. */
+   SDL_LockMutex( sound_loadLock );
    sndl = &array_grow( &sound_list );
    memcpy( sndl, &snd, sizeof(alSound) );
    sndl->name = strdup( name );
+   sound_mem += sndl->size;
+   ret = sndl-sound_list;
+   SDL_UnlockMutex( sound_loadLock );
 
-   return sndl-sound_list;
+   return ret;
 }
 
 
@@ -18,6 +18,7 @@
 
 #include "conf.h"
 #include "log.h"
+#include "memtrack.h"
 #include "music_openal.h"
 //#include "ndata.h"
 #include "sound.h"
@@ -56,6 +57,10 @@
 
 
 #define SOUND_FADEOUT         100
+#define SOUND_REFERENCE_DISTANCE 500. /**< Distance under which sounds don't get louder. */
+#define SOUND_MAX_DISTANCE    25000. /**< Distance past which sounds don't get quieter. */
+#define SOUND_MAX_INSTANCES   4 /**< Maximum voices playing the same sound at once. */
+#define SOUND_PRIORITY_RELATIVE 2. /**< Priority of non-positional voices, above any positional. */
 
 
 /*
@@ -73,6 +78,7 @@ static ALCdevice *al_device   = NULL; /**< OpenAL device. */
 static ALfloat svolume        = 1.; /**< Sound global volume (logarithmic). */
 static ALfloat svolume_lin    = 1.; /**< Sound global volume (linear). */
 static ALfloat svolume_speed  = 1.; /**< Sound global volume modulator for speed. */
+static double al_listener[2]  = { 0., 0. }; /**< Position of the listener. */
 alInfo_t al_info; /**< OpenAL context info. */
 
 
@@ -131,10 +137,13 @@ static int al_enableEFX (void);
  * General.
  */
 static ALuint sound_al_getSource (void);
+static ALuint sound_al_voiceSource( const alSound *s, double priority );
+static double sound_al_voicePriority( const alVoice *v );
 static int al_playVoice( alVoice *v, alSound *s,
       ALfloat px, ALfloat py, ALfloat vx, ALfloat vy, ALint relative );
 static int sound_al_loadWav( ALuint *buf, SDL_RWops *rw );
 static int sound_al_loadOgg( ALuint *buf, OggVorbis_File *vf );
+static void sound_al_deleteBuffer( ALuint buf );
 /*
  * Pausing.
  */
@@ -301,8 +310,8 @@ int sound_al_init (void)
        *  inverse    2        500      1.000   0.333   0.052   0.026
        *  exponent   2        500      1.000   0.250   0.010   0.003
        */
-      alSourcef( s, AL_REFERENCE_DISTANCE, 500. ); /* Close distance to clamp at (doesn't get louder). */
-      alSourcef( s, AL_MAX_DISTANCE,       25000. ); /* Max distance to clamp at (doesn't get quieter). */
+      alSourcef( s, AL_REFERENCE_DISTANCE, SOUND_REFERENCE_DISTANCE ); /* Close distance to clamp at (doesn't get louder). */
+      alSourcef( s, AL_MAX_DISTANCE,       SOUND_MAX_DISTANCE ); /* Max distance to clamp at (doesn't get quieter). */
       alSourcef( s, AL_ROLLOFF_FACTOR,     1. ); /* Determines how it drops off. */
 
       /* Set the filter. */
@@ -585,6 +594,7 @@ static int sound_al_loadWav( ALuint *buf, SDL_RWops *rw )
    /* Put into the buffer. */
    alBufferData( *buf, format, wav_buffer, wav_length, wav_spec.freq );
    soundUnlock();
+   memtrack_alloc( MEMTRACK_AUDIO, wav_length );
 
    /* Clean up. */
    free( wav_buffer );
@@ -666,6 +676,7 @@ static int sound_al_loadOgg( ALuint *buf, OggVorbis_File *vf )
    alBufferData( *buf, format, data, len, info->rate );
    al_checkErr();
    soundUnlock();
+   memtrack_alloc( MEMTRACK_AUDIO, len );
 
    /* Clean up. */
    free(data);
@@ -742,6 +753,7 @@ int sound_al_load( alSound *snd, SDL_RWops *rw, const char *name )
    alGetBufferi( snd->buf, AL_BITS, &bits );
    alGetBufferi( snd->buf, AL_CHANNELS, &channels );
    alGetBufferi( snd->buf, AL_SIZE, &size );
+   snd->size = size;
    if ((freq==0) || (bits==0) || (channels==0)) {
       WARN(_("Something went wrong when loading sound file '%s'."), name);
       snd->length = 0;
@@ -758,6 +770,24 @@ int sound_al_load( alSound *snd, SDL_RWops *rw, const char *name )
 }
 
 
+/**
+ * @brief Deletes a sound buffer, must be called with the sound lock held.
+ *
+ *    @param buf Buffer to delete.
+ */
+static void sound_al_deleteBuffer( ALuint buf )
+{
+   ALint size;
+
+   if (buf == 0)
+      return;
+   size = 0;
+   alGetBufferi( buf, AL_SIZE, &size );
+   memtrack_free( MEMTRACK_AUDIO, MAX( 0, size ) );
+   alDeleteBuffers( 1, &buf );
+}
+
+
 /**
  * @brief Frees the source.
  */
@@ -766,10 +796,47 @@ void sound_al_free( alSound *snd )
    soundLock();
 
    /* free the stuff */
-   alDeleteBuffers( 1, &snd->buf );
+   sound_al_deleteBuffer( snd->buf );
+   al_checkErr();
+
+   soundUnlock();
+}
+
+
+/**
+ * @brief Frees the buffer of a sound unless it is playing.
+ *
+ * Stopped sources still holding the buffer get it detached.
+ *
+ *    @param snd Sound to unload.
+ *    @return 0 if the buffer was freed.
+ */
+int sound_al_unload( alSound *snd )
+{
+   int i;
+   ALint buf, state;
+
+   soundLock();
+
+   for (i=0; i<source_nall; i++) {
+      alGetSourcei( source_all[i], AL_BUFFER, &buf );
+      if ((ALuint)buf != snd->buf)
+         continue;
+      alGetSourcei( source_all[i], AL_SOURCE_STATE, &state );
+      if ((state == AL_PLAYING) || (state == AL_PAUSED)) {
+         soundUnlock();
+         return -1;
+      }
+      alSourcei( source_all[i], AL_BUFFER, AL_NONE );
+   }
+
+   sound_al_deleteBuffer( snd->buf );
+   snd->buf = 0;
    al_checkErr();
 
    soundUnlock();
+
+   return 0;
 }
 
 
@@ -856,14 +923,118 @@ static ALuint sound_al_getSource (void)
 }
 
 
+/**
+ * @brief Gets how loud a sound at a position would be.
+ *
+ * Matches the clamped inverse distance model of the sources, but goes to 0
+ *  past the maximum distance where the sources keep a constant faint gain.
+ *
+ *    @param px X position of the sound.
+ *    @param py Y position of the sound.
+ *    @return Gain of the sound from 0 to 1.
+ */
+double sound_al_attenuation( double px, double py )
+{
+   double d;
+
+   d = hypot( px - al_listener[0], py - al_listener[1] );
+   if (d > SOUND_MAX_DISTANCE)
+      return 0.;
+   return SOUND_REFERENCE_DISTANCE / MAX( SOUND_REFERENCE_DISTANCE, d );
+}
+
+
+/**
+ * @brief Gets the priority of a voice, voices with lower priorities get stolen first.
+ */
+static double sound_al_voicePriority( const alVoice *v )
+{
+   if (v->flags & VOICE_RELATIVE)
+      return SOUND_PRIORITY_RELATIVE;
+   return sound_al_attenuation( v->pos[0], v->pos[1] );
+}
+
+
+/**
+ * @brief Gets a source for a new voice.
+ *
+ * When there are too many voices of the same sound or no free sources left,
+ *  the voice with the lowest priority gets stopped and its source reused if
+ *  it has a lower priority than the new one.
+ *
+ *    @param s Sound to play.
+ *    @param priority Priority of the new voice.
+ *    @return The source to use or 0 if the voice shouldn't play.
+ */
+static ALuint sound_al_voiceSource( const alSound *s, double priority )
+{
+   int n;
+   double p, pmin, psame;
+   alVoice *v, *vmin, *vsame, *victim;
+   ALuint source;
+
+   /* Find the lowest priority voices, overall and of this sound. */
+   n     = 0;
+   vmin  = NULL;
+   vsame = NULL;
+   pmin  = psame = 0.;
+   for (v=voice_active; v!=NULL; v=v->next) {
+      if ((v->source == 0) || (v->state != VOICE_PLAYING))
+         continue;
+      p = sound_al_voicePriority( v );
+      if ((vmin == NULL) || (p < pmin)) {
+         vmin = v;
+         pmin = p;
+      }
+      if (v->buffer != s->buf)
+         continue;
+      n++;
+      if ((vsame == NULL) || (p < psame)) {
+         vsame = v;
+         psame = p;
+      }
+   }
+
+   /* Pick the voice to replace if any. */
+   victim = NULL;
+   if (n >= SOUND_MAX_INSTANCES)
+      victim = (psame < priority) ? vsame : NULL;
+   else {
+      soundLock();
+      source = sound_al_getSource();
+      soundUnlock();
+      if (source != 0)
+         return source;
+      victim = ((vmin != NULL) && (pmin < priority)) ? vmin : NULL;
+   }
+   if (victim == NULL)
+      return 0;
+
+   /* Steal its source, it'll get cleaned up as a voice without source. */
+   soundLock();
+   source = victim->source;
+   alSourceStop( source );
+   alSourcei( source, AL_BUFFER, AL_NONE );
+   al_checkErr();
+   soundUnlock();
+   victim->source = 0;
+   victim->state  = VOICE_DESTROY;
+
+   return source;
+}
+
+
 /**
  * @brief Plays a voice.
  */
 static int al_playVoice( alVoice *v, alSound *s,
       ALfloat px, ALfloat py, ALfloat vx, ALfloat vy, ALint relative )
 {
-   /* Set up the source and buffer. */
-   v->source = sound_al_getSource();
+   /* Set up the source and buffer, possibly stealing it from a quieter voice. */
+   v->flags  = (relative) ? VOICE_RELATIVE : 0;
+   v->pos[0] = px;
+   v->pos[1] = py;
+   v->source = sound_al_voiceSource( s, sound_al_voicePriority( v ) );
    if (v->source == 0)
       return -1;
    v->buffer = s->buf;
@@ -977,13 +1148,13 @@ void sound_al_updateVoice( alVoice *v )
       /* Check for errors. */
       al_checkErr();
 
-      soundUnlock();
-
-      /* Put source back on the list. */
+      /* Put source back on the list, groups take from it too. */
       source_stack[source_nstack] = v->source;
       source_nstack++;
       v->source = 0;
 
+      soundUnlock();
+
       /* Mark as stopped - erased next iteration. */
       v->state = VOICE_STOPPED;
       return;
@@ -1102,6 +1273,8 @@ int sound_al_updateListener( double dir, double px, double py,
    ori[4] = 0.;
    ori[5] = 1.;
    alListenerfv( AL_ORIENTATION, ori );
+   al_listener[0] = px;
+   al_listener[1] = py;
    pos[0] = px;
    pos[1] = py;
    pos[2] = 0.;
@@ -1214,11 +1387,14 @@ int sound_al_createGroup( int size )
    g->sources  = calloc( size, sizeof(ALuint) );
    g->nsources = size;
 
-   /* Add some sources. */
+   /* Add some sources, the audio thread uses the stack too. */
+   soundLock();
    for (i=0; i<size; i++) {
       /* Make sure there's enough. */
-      if (source_nstack <= 0)
+      if (source_nstack <= 0) {
+         soundUnlock();
          goto group_err;
+      }
 
       /* Pull one off the stack. */
       source_nstack--;
@@ -1241,6 +1417,7 @@ int sound_al_createGroup( int size )
          }
       }
    }
+   soundUnlock();
 
    return id;
 
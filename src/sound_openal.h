@@ -16,19 +16,38 @@
 #include "sound.h"
 
 
+/**
+ * @typedef sound_state_t
+ * @brief Loading state of a sound.
+ * @sa alSound
+ */
+typedef enum sound_state_ {
+   SOUND_UNLOADED, /**< Not loaded, gets loaded when played. */
+   SOUND_LOADING, /**< Being loaded in the background. */
+   SOUND_LOADED, /**< Loaded and ready to play. */
+   SOUND_FAILED /**< Failed to load. */
+} sound_state_t;
+
+
 /**
  * @struct alSound
  *
  * @brief Contains a sound buffer.
  */
 typedef struct alSound_ {
-   char *filename; /**< Name of the file loaded from. */
+   char *filename; /**< Name of the file loaded from, NULL if it can't be reloaded. */
    char *name; /**< Buffer's name. */
    double length; /**< Length of the buffer. */
    ALuint buf; /**< Buffer data. */
+   size_t size; /**< Size of the decoded data in bytes. */
+   sound_state_t state; /**< Loading state of the buffer. */
+   unsigned int used; /**< Last time the sound was played. */
 } alSound;
 
 
+#define VOICE_RELATIVE    (1<<0) /**< Voice is not positional. */
+
+
 /**
  * @typedef voice_state_t
  * @brief The state of a voice.
@@ -72,10 +91,8 @@ extern alVoice *voice_active; /**< Active voices. */
 
 
 /*
- * Voice management.
+ * Voice management, only from the audio thread.
  */
-void voice_lock (void);
-void voice_unlock (void);
 alVoice* voice_new (void);
 int voice_add( alVoice* v );
 alVoice* voice_get( int id );
@@ -116,6 +133,7 @@ void sound_al_exit (void);
 int sound_al_buffer( ALuint *buf, SDL_RWops *rw, const char *name );
 int sound_al_load( alSound *snd, SDL_RWops *rw, const char *name );
 void sound_al_free( alSound *snd );
+int sound_al_unload( alSound *snd );
 
 
 /*
@@ -134,6 +152,7 @@ int sound_al_playPos( alVoice *v, alSound *s,
       double px, double py, double vx, double vy );
 int sound_al_updatePos( alVoice *v,
       double px, double py, double vx, double vy );
+double sound_al_attenuation( double px, double py );
 void sound_al_updateVoice( alVoice *v );
 
 /*
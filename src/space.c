@@ -20,10 +20,12 @@
 #include "space.h"
 
 #include "background.h"
+#include "camera.h"
 #include "conf.h"
 #include "damagetype.h"
 #include "dev_uniedit.h"
 #include "economy.h"
+#include "fleet.h"
 #include "gui.h"
 #include "hook.h"
 #include "land.h"
@@ -52,6 +54,7 @@
 #include "rng.h"
 #include "sound.h"
 #include "spfx.h"
+#include "threadpool.h"
 #include "toolkit.h"
 #include "weapon.h"
 
@@ -72,6 +75,28 @@
 
 #define ASTEROID_EXPLODE_INTERVAL 5. /**< Interval of asteroids randomly exploding */
 #define ASTEROID_EXPLODE_CHANCE   0.1 /**< Chance of asteroid exploding each interval */
+#define ASTEROID_GRID_CELLSIZE    256. /**< Cell size of the spatial index of the asteroids. */
+
+#define SPACE_JOB_SYSTEMS     64 /**< Systems per job when reconstructing the jumps on the threadpool. */
+#define SPACE_PRESENCE_JOBS   8  /**< Jobs to reconstruct the presences with, fixed so the sums don't depend on the threads. */
+
+
+/**
+ * @brief Stages of space_init(), timed separately.
+ */
+typedef enum SpaceInitStage_ {
+   SPACE_INIT_CLEAR, /**< Getting rid of the previous system. */
+   SPACE_INIT_SYSTEM, /**< Nebula or stars of the new system. */
+   SPACE_INIT_PLANETS, /**< Resetting the planets. */
+   SPACE_INIT_ASTEROIDS, /**< Creating the asteroids. */
+   SPACE_INIT_PILOTS, /**< Music, pilots and presences. */
+   SPACE_INIT_GFX, /**< Loading the planet graphics. */
+   SPACE_INIT_SCHEDULER, /**< First run of the spawn scheduler. */
+   SPACE_INIT_SIMULATE, /**< Simulating the system for a while. */
+   SPACE_INIT_GUI, /**< Overlay and GUI. */
+   SPACE_INIT_BACKGROUND, /**< Background script, may be deferred. */
+   SPACE_INIT_STAGES /**< Number of stages, not a stage. */
+} SpaceInitStage;
 
 /*
  * planet <-> system name stack
@@ -94,17 +119,59 @@ static Planet *planet_stack = NULL; /**< Planet stack. */
  * Asteroid types stack.
  */
 static AsteroidType *asteroid_types = NULL; /**< Asteroid types stack. */
+static const AsteroidAnchor *asteroid_drawField = NULL; /**< Field being sorted by asteroid_cmpDraw(). */
 
 /*
  * Misc.
  */
 static int systems_loading = 1; /**< Systems are loading. */
+
+
+/**
+ * @brief Range of systems handled by a job on the threadpool.
+ */
+typedef struct SystemJob_ {
+   int start; /**< First system. */
+   int end; /**< One past the last system. */
+} SystemJob;
+
+
+/**
+ * @brief Presence spilled by the planets of a range of systems.
+ */
+typedef struct PresenceJob_ {
+   int start; /**< First source system. */
+   int end; /**< One past the last source system. */
+   int nfact; /**< Number of factions with presence. */
+   const JumpGraph *graph; /**< Jumps to spill along, built before the jobs run. */
+   double *value; /**< Presence by system and faction. */
+   char *touched; /**< Whether presence was added by system and faction. */
+   int *visited; /**< Stamp of the last spill that visited each system. */
+   int stamp; /**< Stamp of the current spill. */
+   int *q; /**< Systems at the current range. */
+   int *qn; /**< Systems at the next range. */
+} PresenceJob;
 StarSystem *cur_system = NULL; /**< Current star system. */
 glTexture *jumppoint_gfx = NULL; /**< Jump point graphics. */
 static glTexture *jumpbuoy_gfx = NULL; /**< Jump buoy graphics. */
 static nlua_env landing_env = LUA_NOREF; /**< Landing lua env. */
 static int space_fchg = 0; /**< Faction change counter, to avoid unnecessary calls. */
 static int space_simulating = 0; /**< Are we simulating space? */
+static int space_initPending = 0; /**< The last stage of space_init() is left for the next update. */
+static Uint64 space_initCounter = 0; /**< Counter when the current stage of space_init() started. */
+static double space_initTimes[SPACE_INIT_STAGES]; /**< Milliseconds each stage of space_init() took. */
+static const char *space_initNames[SPACE_INIT_STAGES] = {
+   "clear",
+   "system",
+   "planets",
+   "asteroids",
+   "pilots",
+   "gfx",
+   "scheduler",
+   "simulate",
+   "gui",
+   "background"
+}; /**< Names of the stages of space_init(). */
 glTexture **asteroid_gfx = NULL;
 static size_t nasterogfx = 0; /**< Nb of asteroid gfx. */
 static Planet *space_landQueuePlanet = NULL;
@@ -113,6 +180,8 @@ static Planet *space_landQueuePlanet = NULL;
  * fleet spawn rate
  */
 int space_spawn = 1; /**< Spawn enabled by default. */
+unsigned int space_pathGen = 0; /**< Changes whenever jump paths may change, see map_getJumpPath(). */
+static JumpGraph space_graph; /**< Jumps of all the systems, see space_jumpGraph(). */
 
 
 /*
@@ -131,9 +200,22 @@ static int planet_parse( Planet *planet, const xmlNodePtr parent, Commodity **st
 static int space_parseAssets( xmlNodePtr parent, StarSystem* sys );
 /* system load */
 static void system_init( StarSystem *sys );
+static void space_initStart( const char* sysname, int defer );
+static void space_initStageEnd( SpaceInitStage stage );
+static void space_initReport (void);
+static void space_initClear (void);
+static void space_initSystem( const char *sysname );
+static void space_initPlanets (void);
+static void space_initAsteroids (void);
+static void space_initPilots (void);
+static void space_initSimulate (void);
+static void space_initBackground (void);
 static void asteroid_init( Asteroid *ast, AsteroidAnchor *field );
+static int asteroid_inField( const AsteroidAnchor *field, const Vector2d *p );
 static void debris_init( Debris *deb );
 static int systems_load (void);
+static void space_jumpGraphBuild (void);
+static void space_jumpGraphFree (void);
 static int asteroidTypes_load (void);
 static StarSystem* system_parse( StarSystem *system, const xmlNodePtr parent );
 static int system_parseJumpPoint( const xmlNodePtr node, StarSystem *sys );
@@ -144,12 +226,22 @@ static void system_parseJumps( const xmlNodePtr parent );
 static void system_parseAsteroids( const xmlNodePtr parent, StarSystem *sys );
 /* misc */
 static int getPresenceIndex( StarSystem *sys, int faction );
+static void system_reconstructJumpsPos( StarSystem *sys );
+static int systems_reconstructJumpsJob( void *data );
+static void presence_jobAdd( PresenceJob *job, int sys, int faction, double amount );
+static void presence_jobSpill( PresenceJob *job, int sys, int faction, double amount, int range );
+static int presence_job( void *data );
+static int planet_applyPresence( Planet *p, StarSystem *sys );
 static void system_scheduler( double dt, int init );
 static void asteroid_explode ( Asteroid *a, AsteroidAnchor *field, int give_reward );
+static void asteroid_buildGrid( AsteroidAnchor *field );
+static int asteroid_cmpDraw( const void *p1, const void *p2 );
 /* Render. */
 static void space_renderJumpPoint( JumpPoint *jp, int i );
+static void space_renderJumpBuoys( JumpPoint *jp );
 static void space_renderPlanet( Planet *p );
 static void space_renderAsteroid( Asteroid *a );
+static void space_renderAsteroidScan( Asteroid *a );
 static void space_renderDebris( Debris *d, double x, double y );
 /*
  * Externed prototypes.
@@ -273,13 +365,8 @@ const char* planet_getClassName( const char *class )
  */
 credits_t planet_commodityPrice( const Planet *p, const Commodity *c )
 {
-   char *sysname;
-   StarSystem *sys;
-
-   sysname = planet_getSystem( p->name );
-   sys = system_get( sysname );
-
-   return economy_getPrice( c, sys, p );
+   /* The price only depends on the planet, no need to look up the system. */
+   return economy_getPrice( c, NULL, p );
 }
 
 /**
@@ -291,13 +378,8 @@ credits_t planet_commodityPrice( const Planet *p, const Commodity *c )
  */
 credits_t planet_commodityPriceAtTime( const Planet *p, const Commodity *c, ntime_t t )
 {
-   char *sysname;
-   StarSystem *sys;
-
-   sysname = planet_getSystem( p->name );
-   sys = system_get( sysname );
-
-   return economy_getPriceAtTime( c, sys, p, t );
+   /* The price only depends on the planet, no need to look up the system. */
+   return economy_getPriceAtTime( c, NULL, p, t );
 }
 
 /**
@@ -583,10 +665,13 @@ double system_getClosest( const StarSystem *sys, int *pnt, int *jp, int *ast, in
 {
    int i, k;
    double d, td;
+   int l;
+   double r;
    Planet *p;
    JumpPoint *j;
    Asteroid *as;
    AsteroidAnchor *f;
+   static int *ids = NULL;
 
    /* Default output. */
    *pnt = -1;
@@ -612,7 +697,16 @@ double system_getClosest( const StarSystem *sys, int *pnt, int *jp, int *ast, in
    /* Asteroids. */
    for (i=0; i<array_size(sys->asteroids); i++) {
       f = &sys->asteroids[i];
-      for (k=0; k<f->nb; k++) {
+
+      /* Only asteroids in sensor range of the player are candidates. */
+      if ((sys != cur_system) || (player.p == NULL))
+         continue;
+      r = sqrt( pilot_sensorRange() * player.p->ew_detect );
+      spatial_queryCircle( &f->grid, &ids,
+            player.p->solid->pos.x, player.p->solid->pos.y, r );
+
+      for (l=0; l<array_size(ids); l++) {
+         k  = ids[l];
          as = &f->asteroids[k];
 
          /* Skip invisible asteroids */
@@ -787,6 +881,78 @@ int space_sysReachableFromSys( StarSystem *target, StarSystem *sys )
    return 0;
 }
 
+/**
+ * @brief Builds the jump graph from the jumps of the systems.
+ */
+static void space_jumpGraphBuild (void)
+{
+   int i, j, n, e;
+   StarSystem *sys;
+   JumpPoint *jp;
+   JumpGraph *g = &space_graph;
+
+   n = array_size(systems_stack);
+   e = 0;
+   for (i=0; i<n; i++)
+      e += array_size(systems_stack[i].jumps);
+
+   space_jumpGraphFree();
+   g->n      = n;
+   g->start  = malloc( (n+1) * sizeof(int) );
+   g->target = malloc( MAX(1,e) * sizeof(int) );
+   g->flags  = malloc( MAX(1,e) * sizeof(unsigned int) );
+   g->dist   = malloc( MAX(1,e) * sizeof(double) );
+
+   e = 0;
+   for (i=0; i<n; i++) {
+      sys = &systems_stack[i];
+      g->start[i] = e;
+      for (j=0; j<array_size(sys->jumps); j++) {
+         jp = &sys->jumps[j];
+         /* Jumps that haven't been reconstructed yet are left out. */
+         if (jp->target == NULL)
+            continue;
+         g->target[e] = jp->target->id;
+         g->flags[e]  = jp->flags & JP_PATHFLAGS;
+         g->dist[e]   = vect_dist( &sys->pos, &jp->target->pos );
+         e++;
+      }
+   }
+   g->start[n] = e;
+   g->gen      = space_pathGen;
+}
+
+
+/**
+ * @brief Frees the jump graph.
+ */
+static void space_jumpGraphFree (void)
+{
+   free( space_graph.start );
+   free( space_graph.target );
+   free( space_graph.flags );
+   free( space_graph.dist );
+   memset( &space_graph, 0, sizeof(JumpGraph) );
+}
+
+
+/**
+ * @brief Gets the jumps of all the systems as a graph.
+ *
+ * It is rebuilt whenever space_pathGen changes, so the flags are up to date,
+ *  but the pointer is only valid until then.
+ *
+ *    @return The jump graph.
+ */
+const JumpGraph* space_jumpGraph (void)
+{
+   if ((space_graph.start == NULL) || (space_graph.gen != space_pathGen) ||
+         (space_graph.n != array_size(systems_stack)))
+      space_jumpGraphBuild();
+   return &space_graph;
+}
+
+
 /**
  * @brief Gets an array (array.h) of all star systems.
  */
@@ -1288,6 +1454,10 @@ void space_update( const double dt )
    if (cur_system == NULL)
       return;
 
+   /* Finish entering the system. */
+   if (space_initPending && !space_simulating)
+      space_initBackground();
+
    /* If spawning is enabled, call the scheduler. */
    if (space_spawn)
       system_scheduler( dt, 0 );
@@ -1410,6 +1580,14 @@ void space_update( const double dt )
    for (i=0; i<array_size(cur_system->asteroids); i++) {
       ast = &cur_system->asteroids[i];
 
+      /* Move them all first, it's a tight loop with no calls. Invisible
+       * asteroids get placed again before they show up. */
+      for (j=0; j<ast->nb; j++) {
+         a = &ast->asteroids[j];
+         a->pos.x += a->vel.x * dt;
+         a->pos.y += a->vel.y * dt;
+      }
+
       for (j=0; j<ast->nb; j++) {
          a = &ast->asteroids[j];
 
@@ -1417,16 +1595,13 @@ void space_update( const double dt )
          if (a->appearing == ASTEROID_INVISIBLE)
             continue;
 
-         a->pos.x += a->vel.x * dt;
-         a->pos.y += a->vel.y * dt;
-
          if (a->appearing == ASTEROID_VISIBLE) {
             /* Random explosions */
             a->timer += dt;
             if (a->timer >= ASTEROID_EXPLODE_INTERVAL) {
                a->timer = 0.;
                if ( (RNGF() < ASTEROID_EXPLODE_CHANCE) ||
-                     (space_isInField(&a->pos) < 0) ) {
+                     !asteroid_inField( ast, &a->pos ) ) {
                   asteroid_explode( a, ast, 0 );
                }
             }
@@ -1459,6 +1634,9 @@ void space_update( const double dt )
          }
       }
 
+      /* Asteroids moved, so update the index. */
+      asteroid_buildGrid( ast );
+
       x = 0;
       y = 0;
       pplayer = pilot_get( PLAYER_ID );
@@ -1499,20 +1677,47 @@ unsigned int space_isSimulation( void )
 
 
 /**
- * @brief Initializes the system.
+ * @brief Marks the end of a stage of space_init().
  *
- *    @param sysname Name of the system to initialize.
+ *    @param stage Stage that just ended.
  */
-void space_init( const char* sysname )
+static void space_initStageEnd( SpaceInitStage stage )
 {
-   char* nt;
-   int i, j, n, s;
-   Planet *pnt;
-   AsteroidAnchor *ast;
-   Asteroid *a;
-   Debris *d;
+   Uint64 now = SDL_GetPerformanceCounter();
+   space_initTimes[stage] = 1000. * (double)(now - space_initCounter) /
+         (double)SDL_GetPerformanceFrequency();
+   space_initCounter = now;
+}
 
-   /* cleanup some stuff */
+
+/**
+ * @brief Reports how long the stages of the last space_init() took.
+ */
+static void space_initReport (void)
+{
+   int i, l;
+   double total;
+   char buf[STRMAX];
+
+   total = 0.;
+   l = 0;
+   for (i=0; i<SPACE_INIT_STAGES; i++) {
+      total += space_initTimes[i];
+      l += scnprintf( &buf[l], sizeof(buf)-l, " %s %.1f", space_initNames[i], space_initTimes[i] );
+   }
+#ifdef PROFILING
+   LOG(_("Entering %s took %.1f ms:%s"), cur_system->name, total, buf);
+#else /* PROFILING */
+   DEBUG(_("Entering %s took %.1f ms:%s"), cur_system->name, total, buf);
+#endif /* PROFILING */
+}
+
+
+/**
+ * @brief Gets rid of everything belonging to the previous system.
+ */
+static void space_initClear (void)
+{
    player_clear(); /* clears targets */
    ovr_mrkClear(); /* Clear markers when jumping. */
    pilots_clean(1); /* destroy non-persistent pilots */
@@ -1527,51 +1732,79 @@ void space_init( const char* sysname )
       pilot_lockClear( player.p );
       pilot_clearTimers( player.p ); /* Clear timers. */
    }
+}
 
-   if ((sysname==NULL) && (cur_system==NULL))
-      ERR(_("Cannot reinit system if there is no system previously loaded"));
-   else if (sysname!=NULL) {
-      for (i=0; i < array_size(systems_stack); i++)
-         if (strcmp(sysname, systems_stack[i].name)==0)
-            break;
-
-      if (i>=array_size(systems_stack))
-         ERR(_("System %s not found in stack"), sysname);
-      cur_system = &systems_stack[i];
-
-      nt = ntime_pretty(0, 2);
-      player_message(_("#oEntering System %s on %s."), _(sysname), nt);
-      if (cur_system->nebu_volatility > 0.) {
-         player_message(_("#rWARNING - Volatile nebula detected in %s! Taking damage!"), _(sysname));
-      }
-      free(nt);
 
-      /* Handle background */
-      if (cur_system->nebu_density > 0.) {
-         /* Background is Nebula */
-         nebu_prep( cur_system->nebu_density, cur_system->nebu_volatility, cur_system->nebu_hue );
+/**
+ * @brief Sets the new current system along with its nebula or stars.
+ *
+ *    @param sysname Name of the system to enter.
+ */
+static void space_initSystem( const char *sysname )
+{
+   int i;
+   char *nt;
 
-         /* Set up sound. */
-         sound_env( SOUND_ENV_NEBULA, cur_system->nebu_density );
-      }
-      else {
-         /* Background is starry */
-         background_initStars( cur_system->stars );
+   for (i=0; i < array_size(systems_stack); i++)
+      if (strcmp(sysname, systems_stack[i].name)==0)
+         break;
 
-         /* Set up sound. */
-         sound_env( SOUND_ENV_NORMAL, 0. );
-      }
+   if (i>=array_size(systems_stack))
+      ERR(_("System %s not found in stack"), sysname);
+   cur_system = &systems_stack[i];
+
+   nt = ntime_pretty(0, 2);
+   player_message(_("#oEntering System %s on %s."), _(sysname), nt);
+   if (cur_system->nebu_volatility > 0.) {
+      player_message(_("#rWARNING - Volatile nebula detected in %s! Taking damage!"), _(sysname));
    }
+   free(nt);
+
+   /* Handle background */
+   if (cur_system->nebu_density > 0.) {
+      /* Background is Nebula */
+      nebu_prep( cur_system->nebu_density, cur_system->nebu_volatility, cur_system->nebu_hue );
+
+      /* Set up sound. */
+      sound_env( SOUND_ENV_NEBULA, cur_system->nebu_density );
+   }
+   else {
+      /* Background is starry */
+      background_initStars( cur_system->stars );
+
+      /* Set up sound. */
+      sound_env( SOUND_ENV_NORMAL, 0. );
+   }
+}
+
+
+/**
+ * @brief Resets the planets of the current system.
+ */
+static void space_initPlanets (void)
+{
+   int i;
+   Planet *pnt;
 
-   /* Set up planets. */
    for (i=0; i<array_size(cur_system->planets); i++) {
       pnt = cur_system->planets[i];
       pnt->bribed = 0;
       pnt->land_override = 0;
       planet_updateLand( pnt );
    }
+}
+
+
+/**
+ * @brief Creates the asteroids and debris of the current system.
+ */
+static void space_initAsteroids (void)
+{
+   int i, j;
+   AsteroidAnchor *ast;
+   Asteroid *a;
+   Debris *d;
 
-   /* Set up asteroids. */
    for (i=0; i<array_size(cur_system->asteroids); i++) {
       ast = &cur_system->asteroids[i];
       ast->id = i;
@@ -1590,7 +1823,21 @@ void space_init( const char* sysname )
          d = &ast->debris[j];
          debris_init(d);
       }
+
+      /* Index the asteroids. */
+      if (ast->grid.objects == NULL)
+         spatial_init( &ast->grid, ASTEROID_GRID_CELLSIZE );
+      asteroid_buildGrid( ast );
    }
+}
+
+
+/**
+ * @brief Prepares the pilots and presences of the current system.
+ */
+static void space_initPilots (void)
+{
+   int i;
 
    /* Clear interference if you leave system with interference. */
    if (cur_system->interference == 0.)
@@ -1612,17 +1859,16 @@ void space_init( const char* sysname )
       cur_system->presence[i].timer    = 0.;
       cur_system->presence[i].disabled = 0;
    }
+}
 
-   /* Load graphics. */
-   space_gfxLoad( cur_system );
-
-   /* Call the scheduler. */
-   system_scheduler( 0., 1 );
 
-   /* we now know this system */
-   sys_setFlag(cur_system,SYSTEM_KNOWN);
+/**
+ * @brief Runs the current system for a while so it doesn't start empty.
+ */
+static void space_initSimulate (void)
+{
+   int i, n, s;
 
-   /* Simulate system. */
    space_simulating = 1;
    if (player.p != NULL)
       pilot_setFlag( player.p, PILOT_HIDE );
@@ -1639,15 +1885,167 @@ void space_init( const char* sysname )
    if (player.p != NULL)
       pilot_rmFlag( player.p, PILOT_HIDE );
    space_simulating = 0;
+}
+
+
+/**
+ * @brief Loads the background script of the current system.
+ *
+ * This is the last stage of space_init(), and may be run a frame later.
+ */
+static void space_initBackground (void)
+{
+   space_initPending = 0;
+   space_initCounter = SDL_GetPerformanceCounter();
+   background_load( cur_system->background );
+   space_initStageEnd( SPACE_INIT_BACKGROUND );
+   space_initReport();
+}
+
+
+/**
+ * @brief Initializes the system.
+ *
+ *    @param sysname Name of the system to initialize.
+ */
+void space_init( const char* sysname )
+{
+   space_initStart( sysname, 0 );
+}
+
+
+/**
+ * @brief Initializes the system entered by jumping.
+ *
+ * Same as space_init(), except that the background script is only loaded on
+ *  the next update, while the player is still fading in from hyperspace.
+ *
+ *    @param sysname Name of the system to initialize.
+ */
+void space_initJump( const char* sysname )
+{
+   space_initStart( sysname, 1 );
+}
+
+
+/**
+ * @brief Runs the stages of space_init().
+ *
+ *    @param sysname Name of the system to initialize or NULL to reinitialize
+ *           the current one.
+ *    @param defer Whether or not to leave the last stage for the next update.
+ */
+static void space_initStart( const char* sysname, int defer )
+{
+   /* Whatever was left of the previous system is superseded. */
+   space_initPending = 0;
+   memset( space_initTimes, 0, sizeof(space_initTimes) );
+   space_initCounter = SDL_GetPerformanceCounter();
+
+   /* cleanup some stuff */
+   space_initClear();
+   space_initStageEnd( SPACE_INIT_CLEAR );
+
+   if ((sysname==NULL) && (cur_system==NULL))
+      ERR(_("Cannot reinit system if there is no system previously loaded"));
+   else if (sysname!=NULL)
+      space_initSystem( sysname );
+   space_initStageEnd( SPACE_INIT_SYSTEM );
+
+   /* Set up planets. */
+   space_initPlanets();
+   space_initStageEnd( SPACE_INIT_PLANETS );
+
+   /* Set up asteroids. */
+   space_initAsteroids();
+   space_initStageEnd( SPACE_INIT_ASTEROIDS );
+
+   /* Set up pilots. */
+   space_initPilots();
+   space_initStageEnd( SPACE_INIT_PILOTS );
+
+   /* Load graphics, needed for the planet radii. */
+   space_gfxLoad( cur_system );
+   space_initStageEnd( SPACE_INIT_GFX );
+
+   /* Call the scheduler. */
+   system_scheduler( 0., 1 );
+
+   /* Ships of the previous system that didn't show up again aren't needed. */
+   ships_gfxPurge();
+   space_initStageEnd( SPACE_INIT_SCHEDULER );
+
+   /* we now know this system */
+   sys_setFlag(cur_system,SYSTEM_KNOWN);
+
+   /* Simulate system. */
+   space_initSimulate();
+   space_initStageEnd( SPACE_INIT_SIMULATE );
 
    /* Refresh overlay if necessary (player kept it open). */
    ovr_refresh();
 
    /* Update gui. */
    gui_setSystem();
+   space_initStageEnd( SPACE_INIT_GUI );
 
    /* Start background. */
-   background_load( cur_system->background );
+   if (defer)
+      space_initPending = 1;
+   else
+      space_initBackground();
+}
+
+
+/**
+ * @brief Rebuilds the spatial index of the asteroids of a field.
+ *
+ *    @param field Asteroid field to index.
+ */
+static void asteroid_buildGrid( AsteroidAnchor *field )
+{
+   int i;
+   double hw, hh;
+   Asteroid *a;
+   glTexture *gfx;
+
+   spatial_clear( &field->grid );
+   for (i=0; i<field->nb; i++) {
+      a = &field->asteroids[i];
+
+      /* Invisible asteroids can't collide nor be targeted. */
+      if (a->appearing == ASTEROID_INVISIBLE)
+         continue;
+
+      /* Sprite collisions are done with the bounding box of the sprite, pad for rounding. */
+      gfx = asteroid_types[a->type].gfxs[a->gfxID];
+      hw = gfx->sw / 2. + 1.;
+      hh = gfx->sh / 2. + 1.;
+      spatial_insertBox( &field->grid, i,
+            a->pos.x - hw, a->pos.y - hh, a->pos.x + hw, a->pos.y + hh );
+   }
+   spatial_build( &field->grid );
+}
+
+
+/**
+ * @brief Compares asteroids of asteroid_drawField by graphic, then by ID.
+ *
+ * Asteroids sharing a texture end up in the same batch, and the order stays
+ *  the same between frames so overlapping ones don't flicker.
+ */
+static int asteroid_cmpDraw( const void *p1, const void *p2 )
+{
+   const Asteroid *a1, *a2;
+   GLuint t1, t2;
+
+   a1 = &asteroid_drawField->asteroids[ *(const int*)p1 ];
+   a2 = &asteroid_drawField->asteroids[ *(const int*)p2 ];
+   t1 = asteroid_types[a1->type].gfxs[a1->gfxID]->texture;
+   t2 = asteroid_types[a2->type].gfxs[a2->gfxID]->texture;
+   if (t1 != t2)
+      return (t1 < t2) ? -1 : 1;
+   return a1->id - a2->id;
 }
 
 
@@ -1684,13 +2082,14 @@ void asteroid_init( Asteroid *ast, AsteroidAnchor *field )
       /* If this is the first time and it's spawned outside the field,
        * we get rid of it so that density remains roughly consistent. */
       if ( (ast->appearing == ASTEROID_INIT) &&
-            (space_isInField(&ast->pos) < 0) ) {
+            !asteroid_inField( field, &ast->pos ) ) {
          ast->appearing = ASTEROID_INVISIBLE;
+         vectnull( &ast->vel );
          return;
       }
 
       attempts++;
-   } while ( (space_isInField(&ast->pos) < 0) && (attempts < 1000) );
+   } while ( !asteroid_inField( field, &ast->pos ) && (attempts < 1000) );
 
    /* And a random velocity */
    theta = RNGF()*2.*M_PI;
@@ -1759,10 +2158,10 @@ Planet *planet_new (void)
  */
 static int planets_load ( void )
 {
-   size_t bufsize;
-   char *buf, **planet_files, *file;
+   size_t bufsize, nfiles;
+   char *buf, **planet_files, **files;
    xmlNodePtr node;
-   xmlDocPtr doc;
+   xmlDocPtr doc, *docs;
    Planet *p;
    size_t i;
    Commodity **stdList;
@@ -1788,21 +2187,24 @@ static int planets_load ( void )
 
    /* Load XML stuff. */
    planet_files = PHYSFS_enumerateFiles( PLANET_DATA_PATH );
-   for (i=0; planet_files[i]!=NULL; i++) {
-      if (!ndata_matchExt( planet_files[i], "xml" ))
-         continue;
-
-      asprintf( &file, "%s%s", PLANET_DATA_PATH, planet_files[i]);
-      doc = xml_parsePhysFS( file );
+   for (nfiles=0; planet_files[nfiles]!=NULL; nfiles++) {}
+   files = calloc( MAX(nfiles,1), sizeof(char*) );
+   for (i=0; i<nfiles; i++)
+      if (ndata_matchExt( planet_files[i], "xml" ))
+         asprintf( &files[i], "%s%s", PLANET_DATA_PATH, planet_files[i]);
+   docs = xml_parsePhysFSList( files, nfiles );
+
+   for (i=0; i<nfiles; i++) {
+      doc = docs[i];
       if (doc == NULL) {
-         free(file);
+         free(files[i]);
          continue;
       }
 
       node = doc->xmlChildrenNode; /* first planet node */
       if (node == NULL) {
-         WARN(_("Malformed %s file: does not contain elements"),file);
-         free(file);
+         WARN(_("Malformed %s file: does not contain elements"),files[i]);
+         free(files[i]);
          xmlFreeDoc(doc);
          continue;
       }
@@ -1813,12 +2215,14 @@ static int planets_load ( void )
       }
 
       /* Clean up. */
-      free(file);
+      free(files[i]);
       xmlFreeDoc(doc);
    }
 
    /* Clean up. */
    PHYSFS_freeList( planet_files );
+   free( files );
+   free( docs );
    array_free(stdList);
 
    return 0;
@@ -1989,6 +2393,37 @@ void space_gfxLoad( StarSystem *sys )
    int i;
    for (i=0; i<array_size(sys->planets); i++)
       planet_gfxLoad( sys->planets[i] );
+
+   /* Whatever was prefetched and not used by now is stale. */
+   gl_texPrefetchClear();
+}
+
+
+/**
+ * @brief Starts decoding the graphics of a star system in the background.
+ *
+ * Used before jumping so that space_gfxLoad() only has to upload them and
+ *  background_load() finds the background script ready.
+ *
+ *    @param sys System to prefetch graphics for.
+ */
+void space_gfxPrefetch( StarSystem *sys )
+{
+   int i;
+   Planet *planet;
+   for (i=0; i<array_size(sys->planets); i++) {
+      planet = sys->planets[i];
+      if ((planet->real == ASSET_REAL) && (planet->gfx_space == NULL))
+         gl_texPrefetch( planet->gfx_spaceName, OPENGL_TEX_MIPMAPS );
+   }
+
+   /* Ships of the factions that spawn there. */
+   for (i=0; i<array_size(sys->presence); i++)
+      if (sys->presence[i].value > 0.)
+         fleet_prefetch( sys->presence[i].faction );
+
+   /* The background images are by far the biggest. */
+   background_prefetch( sys );
 }
 
 
@@ -2268,7 +2703,7 @@ int system_addPlanet( StarSystem *sys, const char *planetname )
 
    /* Add the presence. */
    if (!systems_loading) {
-      system_addPresence( sys, planet->faction, planet->presenceAmount, planet->presenceRange );
+      planet_applyPresence( planet, sys );
       system_setFaction(sys);
    }
 
@@ -2314,7 +2749,7 @@ int system_rmPlanet( StarSystem *sys, const char *planetname )
    array_erase( &sys->planetsid, &sys->planetsid[i], &sys->planetsid[i+1] );
 
    /* Remove the presence. */
-   system_addPresence( sys, planet->faction, -(planet->presenceAmount), planet->presenceRange );
+   planet_applyPresence( planet, NULL );
 
    /* Remove from the name stack thingy. */
    found = 0;
@@ -2409,6 +2844,7 @@ int system_rmJump( StarSystem *sys, const char *jumpname )
 
    /* Remove jump from system. */
    array_erase( &sys->jumps, &sys->jumps[i], &sys->jumps[i+1] );
+   space_pathGen++;
 
    /* Refresh presence */
    system_setFaction(sys);
@@ -2469,6 +2905,27 @@ StarSystem *system_new (void)
  * @brief Reconstructs the jumps for a single system.
  */
 void system_reconstructJumps (StarSystem *sys)
+{
+   int j;
+   JumpPoint *jp;
+
+   /* Jumps may have been added, paths have to be recomputed. */
+   space_pathGen++;
+
+   system_reconstructJumpsPos( sys );
+   for (j=0; j<array_size(sys->jumps); j++) {
+      jp             = &sys->jumps[j];
+      jp->returnJump = jump_getTarget( sys, jp->target );
+   }
+}
+
+
+/**
+ * @brief Reconstructs the targets and positions of the jumps of a system.
+ *
+ * Only touches the jumps of the system, so it can run on many systems at once.
+ */
+static void system_reconstructJumpsPos( StarSystem *sys )
 {
    double dx, dy;
    int j;
@@ -2479,7 +2936,6 @@ void system_reconstructJumps (StarSystem *sys)
       jp             = &sys->jumps[j];
       jp->from       = sys;
       jp->target     = system_getIndex( jp->targetid );
-      jp->returnJump = jump_getTarget( sys, jp->target );
 
       /* Get heading. */
       dx = jp->target->pos.x - sys->pos.x;
@@ -2502,19 +2958,63 @@ void system_reconstructJumps (StarSystem *sys)
    }
 }
 
+/**
+ * @brief Reconstructs the targets and positions of the jumps of a range of systems.
+ */
+static int systems_reconstructJumpsJob( void *data )
+{
+   int i;
+   SystemJob *job = data;
+   for (i=job->start; i<job->end; i++)
+      system_reconstructJumpsPos( &systems_stack[i] );
+   return 0;
+}
+
+
 /**
  * @brief Reconstructs the jumps.
+ *
+ * The jumps of each system are set up on the threadpool, then the return jumps
+ *  are looked up once all the targets are known.
  */
 void systems_reconstructJumps (void)
 {
+   int i, j, n;
+   SystemJob *jobs, *job;
+   ThreadQueue *queue;
    StarSystem *sys;
-   int i;
+   JumpPoint *jp;
 
-   /* So we need to calculate the shortest jump. */
-   for (i=0; i<array_size(systems_stack); i++) {
+   /* Jumps may have been added, paths have to be recomputed. */
+   space_pathGen++;
+
+   n    = array_size(systems_stack);
+   jobs = array_create_size( SystemJob, n/SPACE_JOB_SYSTEMS+1 );
+   for (i=0; i<n; i+=SPACE_JOB_SYSTEMS) {
+      job        = &array_grow( &jobs );
+      job->start = i;
+      job->end   = MIN( i+SPACE_JOB_SYSTEMS, n );
+   }
+   if (array_size(jobs) > 1) {
+      queue = vpool_create();
+      for (i=0; i<array_size(jobs); i++)
+         vpool_enqueue( queue, systems_reconstructJumpsJob, &jobs[i] );
+      vpool_wait( queue );
+   }
+   else if (array_size(jobs) > 0)
+      systems_reconstructJumpsJob( &jobs[0] );
+   array_free( jobs );
+
+   /* Return jumps depend on the targets of other systems. */
+   for (i=0; i<n; i++) {
       sys = &systems_stack[i];
-      system_reconstructJumps(sys);
+      for (j=0; j<array_size(sys->jumps); j++) {
+         jp             = &sys->jumps[j];
+         jp->returnJump = jump_getTarget( sys, jp->target );
+      }
    }
+
+   space_jumpGraphBuild();
 }
 
 
@@ -3110,19 +3610,14 @@ int space_load (void)
 
    for (i=0; asteroid_files[i]!=NULL; i++) {
       snprintf( file, sizeof(file), "%s%s", PLANET_GFX_SPACE_PATH"asteroid/", asteroid_files[i] );
-      asteroid_gfx[i] = gl_newImage( file, OPENGL_TEX_MIPMAPS );
+      asteroid_gfx[i] = gl_newImage( file, OPENGL_TEX_MIPMAPS | OPENGL_TEX_ATLAS );
    }
 
    /* Done loading. */
    systems_loading = 0;
 
-   /* Apply all the presences. */
-   for (i=0; (int)i<array_size(systems_stack); i++)
-      system_addAllPlanetsPresence(&systems_stack[i]);
-
-   /* Determine dominant faction. */
-   for (i=0; (int)i<array_size(systems_stack); i++)
-      system_setFaction( &systems_stack[i] );
+   /* Apply all the presences and determine the dominant factions. */
+   space_reconstructPresences();
 
    /* Reconstruction. */
    systems_reconstructJumps();
@@ -3192,7 +3687,7 @@ static int asteroidTypes_load (void)
          cur = node->children;
          do {
             if (xml_isNode(cur,"gfx"))
-               array_push_back( &at->gfxs, xml_parseTexture( cur, PLANET_GFX_SPACE_PATH"asteroid/%s", 1, 1,  OPENGL_TEX_MAPTRANS | OPENGL_TEX_MIPMAPS ) );
+               array_push_back( &at->gfxs, xml_parseTexture( cur, PLANET_GFX_SPACE_PATH"asteroid/%s", 1, 1,  OPENGL_TEX_MAPTRANS | OPENGL_TEX_MIPMAPS | OPENGL_TEX_ATLAS ) );
 
             else if (xml_isNode(cur,"id"))
                at->ID = xml_getStrd(cur);
@@ -3249,11 +3744,11 @@ static int asteroidTypes_load (void)
  */
 static int systems_load (void)
 {
-   char **system_files, *file;
+   char **system_files, **files;
    xmlNodePtr node;
-   xmlDocPtr doc;
+   xmlDocPtr *docs;
    StarSystem *sys;
-   size_t i;
+   size_t i, nfiles;
 
    /* Allocate if needed. */
    if (systems_stack == NULL)
@@ -3261,58 +3756,50 @@ static int systems_load (void)
 
    system_files = PHYSFS_enumerateFiles( SYSTEM_DATA_PATH );
 
+   /* Parse all the files in parallel, they are kept for both passes. */
+   for (nfiles=0; system_files[nfiles]!=NULL; nfiles++) {}
+   files = calloc( MAX(nfiles,1), sizeof(char*) );
+   for (i=0; i<nfiles; i++)
+      if (ndata_matchExt( system_files[i], "xml" ))
+         asprintf( &files[i], "%s%s", SYSTEM_DATA_PATH, system_files[i] );
+   docs = xml_parsePhysFSList( files, nfiles );
+
    /*
     * First pass - loads all the star systems_stack.
     */
-   for (i=0; system_files[i]!=NULL; i++) {
-      if (!ndata_matchExt( system_files[i], "xml" ))
-         continue;
-
-      asprintf( &file, "%s%s", SYSTEM_DATA_PATH, system_files[i] );
-      /* Load the file. */
-      doc = xml_parsePhysFS( file );
-      if (doc == NULL)
+   for (i=0; i<nfiles; i++) {
+      if (docs[i] == NULL)
          continue;
 
-      node = doc->xmlChildrenNode; /* first planet node */
+      node = docs[i]->xmlChildrenNode; /* first planet node */
       if (node == NULL) {
-         WARN(_("Malformed %s file: does not contain elements"),file);
-         xmlFreeDoc(doc);
+         WARN(_("Malformed %s file: does not contain elements"),files[i]);
+         xmlFreeDoc(docs[i]);
+         docs[i] = NULL;
          continue;
       }
 
       sys = system_new();
       system_parse( sys, node );
       system_parseAsteroids(node, sys); /* load the asteroids anchors */
-
-      /* Clean up. */
-      xmlFreeDoc(doc);
-      free( file );
    }
 
    /*
     * Second pass - loads all the jump routes.
     */
-   for (i=0; system_files[i]!=NULL; i++) {
-      asprintf( &file, "%s%s", SYSTEM_DATA_PATH, system_files[i] );
-      /* Load the file. */
-      doc = xml_parsePhysFS( file );
-      free( file );
-      file = NULL;
-      if (doc == NULL)
-         continue;
-
-      node = doc->xmlChildrenNode; /* first planet node */
-      if (node == NULL) {
-         xmlFreeDoc(doc);
+   for (i=0; i<nfiles; i++) {
+      free( files[i] );
+      if (docs[i] == NULL)
          continue;
-      }
 
+      node = docs[i]->xmlChildrenNode; /* first planet node */
       system_parseJumps(node); /* will automatically load the jumps into the system */
 
       /* Clean up. */
-      xmlFreeDoc(doc);
+      xmlFreeDoc(docs[i]);
    }
+   free( files );
+   free( docs );
 
    DEBUG( n_( "Loaded %d Star System", "Loaded %d Star Systems", array_size(systems_stack) ), array_size(systems_stack) );
    DEBUG( n_( "       with %d Planet", "       with %d Planets", array_size(planet_stack) ), array_size(planet_stack) );
@@ -3361,6 +3848,7 @@ void space_renderOverlay( const double dt )
    pplayer = pilot_get( PLAYER_ID );
    if (pplayer != NULL) {
       psolid  = pplayer->solid;
+      gl_batchStart();
       for (i=0; i < array_size(cur_system->asteroids); i++) {
          ast = &cur_system->asteroids[i];
          x = psolid->pos.x - SCREEN_W/2;
@@ -3370,6 +3858,7 @@ void space_renderOverlay( const double dt )
               space_renderDebris( &ast->debris[j], x, y );
          }
       }
+      gl_batchEnd();
    }
 
    /* Render overlay if necessary. */
@@ -3387,18 +3876,24 @@ void space_renderOverlay( const double dt )
 void planets_render (void)
 {
    int i, j;
-   double x, y;
+   double x, y, x1, y1, x2, y2;
    AsteroidAnchor *ast;
    Pilot *pplayer;
    Solid *psolid;
+   static int *ids = NULL;
 
    /* Must be a system. */
    if (cur_system==NULL)
       return;
 
+   /* Objects are grouped by graphic so they end up in few draws. */
+   gl_batchStart();
+
    /* Render the jumps. */
    for (i=0; i < array_size(cur_system->jumps); i++)
       space_renderJumpPoint( &cur_system->jumps[i], i );
+   for (i=0; i < array_size(cur_system->jumps); i++)
+      space_renderJumpBuoys( &cur_system->jumps[i] );
 
    /* Render the planets. */
    for (i=0; i < array_size(cur_system->planets); i++)
@@ -3410,11 +3905,20 @@ void planets_render (void)
    if (pplayer != NULL)
       psolid  = pplayer->solid;
 
-   /* Render the asteroids & debris. */
+   /* Render the asteroids & debris. Only the asteroids on screen are looked
+    * at, grouped by graphic in a fixed order so that overlapping ones don't
+    * flicker. What the player scanned goes on top so it doesn't break up
+    * the batches. */
+   cam_getBounds( &x1, &y1, &x2, &y2 );
    for (i=0; i < array_size(cur_system->asteroids); i++) {
       ast = &cur_system->asteroids[i];
-      for (j=0; j < ast->nb; j++)
-        space_renderAsteroid( &ast->asteroids[j] );
+      spatial_query( &ast->grid, &ids, x1, y1, x2, y2 );
+      asteroid_drawField = ast;
+      qsort( ids, array_size(ids), sizeof(int), asteroid_cmpDraw );
+      for (j=0; j < array_size(ids); j++)
+        space_renderAsteroid( &ast->asteroids[ ids[j] ] );
+      for (j=0; j < array_size(ids); j++)
+        space_renderAsteroidScan( &ast->asteroids[ ids[j] ] );
 
       if (pplayer != NULL) {
          x = psolid->pos.x - SCREEN_W/2;
@@ -3429,6 +3933,7 @@ void planets_render (void)
    /* Render gatherable stuff. */
    gatherable_render();
 
+   gl_batchEnd();
 }
 
 
@@ -3451,8 +3956,17 @@ static void space_renderJumpPoint( JumpPoint *jp, int i )
       c = NULL;
 
    gl_blitSprite( jumppoint_gfx, jp->pos.x, jp->pos.y, jp->sx, jp->sy, c );
+}
+
+
+/**
+ * @brief Renders the buoys next to "highway" jump points.
+ */
+static void space_renderJumpBuoys( JumpPoint *jp )
+{
+   if (!jp_isUsable(jp))
+      return;
 
-   /* Draw buoys next to "highway" jump points. */
    if (jp->hide == 0.) {
       gl_blitSprite( jumpbuoy_gfx, jp->pos.x + 200 * jp->sina, jp->pos.y + 200 * jp->cosa, 0, 0, NULL ); /* Left */
       gl_blitSprite( jumpbuoy_gfx, jp->pos.x + -200 * jp->sina, jp->pos.y + -200 * jp->cosa, 0, 0, NULL ); /* Right */
@@ -3474,11 +3988,8 @@ static void space_renderPlanet( Planet *p )
  */
 static void space_renderAsteroid( Asteroid *a )
 {
-   int i;
-   double scale, nx, ny;
+   double scale;
    AsteroidType *at;
-   Commodity *com;
-   char c[20];
 
    /* Skip invisible asteroids */
    if (a->appearing == ASTEROID_INVISIBLE)
@@ -3496,9 +4007,24 @@ static void space_renderAsteroid( Asteroid *a )
 
    gl_blitSpriteInterpolateScale( at->gfxs[a->gfxID], at->gfxs[a->gfxID], 1,
                                   a->pos.x, a->pos.y, scale, scale, 0, 0, NULL );
+}
+
+
+/**
+ * @brief Renders the commodities of an asteroid the player scanned.
+ */
+static void space_renderAsteroidScan( Asteroid *a )
+{
+   int i;
+   double nx, ny;
+   AsteroidType *at;
+   Commodity *com;
+   char c[20];
 
    /* Add the commodities if scanned. */
-   if (!a->scanned) return;
+   if ((a->appearing == ASTEROID_INVISIBLE) || !a->scanned)
+      return;
+   at = &asteroid_types[a->type];
    gl_gameToScreenCoords( &nx, &ny, a->pos.x, a->pos.y );
    for (i=0; i<array_size(at->material); i++) {
       com = at->material[i];
@@ -3515,18 +4041,16 @@ static void space_renderAsteroid( Asteroid *a )
 static void space_renderDebris( Debris *d, double x, double y )
 {
    double scale;
-   Vector2d *testVect;
+   Vector2d testVect;
 
    scale = .5;
 
-   testVect = malloc(sizeof(Vector2d));
-   testVect->x = d->pos.x + x;
-   testVect->y = d->pos.y + y;
+   testVect.x = d->pos.x + x;
+   testVect.y = d->pos.y + y;
 
-   if ( space_isInField( testVect ) == 0 )
+   if ( space_isInField( &testVect ) == 0 )
       gl_blitSpriteInterpolateScale( asteroid_gfx[d->gfxID], asteroid_gfx[d->gfxID], 1,
-                                     testVect->x, testVect->y, scale, scale, 0, 0, &cInert );
-   free(testVect);
+                                     testVect.x, testVect.y, scale, scale, 0, 0, &cInert );
 }
 
 
@@ -3609,6 +4133,8 @@ void space_exit (void)
          free(ast->asteroids);
          free(ast->debris);
          free(ast->type);
+         if (ast->grid.objects != NULL)
+            spatial_free( &ast->grid );
       }
       array_free(sys->asteroids);
       array_free(sys->astexclude);
@@ -3616,6 +4142,7 @@ void space_exit (void)
    }
    array_free(systems_stack);
    systems_stack = NULL;
+   space_jumpGraphFree();
 
    /* Free the asteroid types. */
    for (i=0; i < array_size(asteroid_types); i++) {
@@ -3932,9 +4459,10 @@ static int getPresenceIndex( StarSystem *sys, int faction )
  */
 void system_addPresence( StarSystem *sys, int faction, double amount, int range )
 {
-   int i, x, curSpill;
+   int i, e, x, curSpill;
    Queue q, qn;
-   StarSystem *cur;
+   StarSystem *cur, *tgt;
+   const JumpGraph *g;
 
    /* Check for NULL and display a warning. */
    if (sys == NULL) {
@@ -3965,10 +4493,12 @@ void system_addPresence( StarSystem *sys, int faction, double amount, int range
    qn             = q_create();
 
    /* Create the initial queue consisting of sys adjacencies. */
-   for (i=0; i < array_size(sys->jumps); i++) {
-      if (sys->jumps[i].target->spilled == 0 && !jp_isFlag( &sys->jumps[i], JP_HIDDEN ) && !jp_isFlag( &sys->jumps[i], JP_EXITONLY )) {
-         q_enqueue( q, sys->jumps[i].target );
-         sys->jumps[i].target->spilled = 1;
+   g = space_jumpGraph();
+   for (e=g->start[sys->id]; e<g->start[sys->id+1]; e++) {
+      tgt = &systems_stack[ g->target[e] ];
+      if (tgt->spilled == 0 && !(g->flags[e] & (JP_HIDDEN | JP_EXITONLY))) {
+         q_enqueue( q, tgt );
+         tgt->spilled = 1;
       }
    }
 
@@ -3991,10 +4521,11 @@ void system_addPresence( StarSystem *sys, int faction, double amount, int range
          break;
 
       /* Enqueue all its adjacencies to the next range queue. */
-      for (i=0; i<array_size(cur->jumps); i++) {
-         if (cur->jumps[i].target->spilled == 0 && !jp_isFlag( &cur->jumps[i], JP_HIDDEN ) && !jp_isFlag( &cur->jumps[i], JP_EXITONLY )) {
-            q_enqueue( qn, cur->jumps[i].target );
-            cur->jumps[i].target->spilled = 1;
+      for (e=g->start[cur->id]; e<g->start[cur->id+1]; e++) {
+         tgt = &systems_stack[ g->target[e] ];
+         if (tgt->spilled == 0 && !(g->flags[e] & (JP_HIDDEN | JP_EXITONLY))) {
+            q_enqueue( qn, tgt );
+            tgt->spilled = 1;
          }
       }
 
@@ -4067,7 +4598,38 @@ void system_addAllPlanetsPresence( StarSystem *sys )
    }
 
    for (i=0; i<array_size(sys->planets); i++)
-      system_addPresence(sys, sys->planets[i]->faction, sys->planets[i]->presenceAmount, sys->planets[i]->presenceRange);
+      planet_applyPresence( sys->planets[i], sys );
+}
+
+
+/**
+ * @brief Makes the presence a planet adds match its current state.
+ *
+ * Takes back what the planet added before, if anything changed since.
+ *
+ *    @param p Planet to apply the presence of.
+ *    @param sys System the planet is in, NULL if it's in none.
+ *    @return 1 if the presence changed.
+ */
+static int planet_applyPresence( Planet *p, StarSystem *sys )
+{
+   PlanetPresence *pp;
+
+   pp = &p->presence;
+   if ((pp->sys == sys) && (pp->faction == p->faction) &&
+         (pp->amount == p->presenceAmount) && (pp->range == p->presenceRange))
+      return 0;
+
+   if (pp->sys != NULL)
+      system_addPresence( pp->sys, pp->faction, -pp->amount, pp->range );
+   if (sys != NULL)
+      system_addPresence( sys, p->faction, p->presenceAmount, p->presenceRange );
+
+   pp->sys     = sys;
+   pp->faction = p->faction;
+   pp->amount  = p->presenceAmount;
+   pp->range   = p->presenceRange;
+   return 1;
 }
 
 
@@ -4076,7 +4638,12 @@ void system_addAllPlanetsPresence( StarSystem *sys )
  */
 void space_reconstructPresences( void )
 {
-   int i;
+   int i, j, k, n, f, nfact, chunk, touched;
+   double value;
+   PresenceJob jobs[SPACE_PRESENCE_JOBS];
+   ThreadQueue *queue;
+   StarSystem *sys;
+   Planet *p;
 
    /* Reset the presence in each system. */
    for (i=0; i<array_size(systems_stack); i++) {
@@ -4084,10 +4651,207 @@ void space_reconstructPresences( void )
       systems_stack[i].presence  = array_create( SystemPresence );
       systems_stack[i].ownerpresence = 0.;
    }
+   for (i=0; i<array_size(planet_stack); i++)
+      memset( &planet_stack[i].presence, 0, sizeof(PlanetPresence) );
+
+   /* Record what each planet adds, and see how many factions there are. */
+   n     = array_size(systems_stack);
+   nfact = 0;
+   for (i=0; i<n; i++) {
+      sys = &systems_stack[i];
+      for (j=0; j<array_size(sys->planets); j++) {
+         p = sys->planets[j];
+         p->presence.sys     = sys;
+         p->presence.faction = p->faction;
+         p->presence.amount  = p->presenceAmount;
+         p->presence.range   = p->presenceRange;
+         if (faction_isFaction( p->faction ))
+            nfact = MAX( nfact, p->faction+1 );
+      }
+   }
 
-   /* Re-add presence to each system. */
-   for (i=0; i<array_size(systems_stack); i++)
-      system_addAllPlanetsPresence(&systems_stack[i]);
+   /* Spill the presence of ranges of systems on the threadpool. */
+   if ((n > 0) && (nfact > 0)) {
+      chunk = (n + SPACE_PRESENCE_JOBS - 1) / SPACE_PRESENCE_JOBS;
+      queue = vpool_create();
+      for (k=0; k<SPACE_PRESENCE_JOBS; k++) {
+         memset( &jobs[k], 0, sizeof(PresenceJob) );
+         jobs[k].start = MIN( k*chunk, n );
+         jobs[k].end   = MIN( (k+1)*chunk, n );
+         jobs[k].nfact = nfact;
+         jobs[k].graph = space_jumpGraph();
+         vpool_enqueue( queue, presence_job, &jobs[k] );
+      }
+      vpool_wait( queue );
+
+      /* Add up in job order, so the results are always the same. */
+      for (i=0; i<n; i++) {
+         for (f=0; f<nfact; f++) {
+            value   = 0.;
+            touched = 0;
+            for (k=0; k<SPACE_PRESENCE_JOBS; k++) {
+               if (!jobs[k].touched[ i*nfact+f ])
+                  continue;
+               value  += jobs[k].value[ i*nfact+f ];
+               touched = 1;
+            }
+            if (!touched)
+               continue;
+            j = getPresenceIndex( &systems_stack[i], f );
+            systems_stack[i].presence[j].value = value;
+         }
+      }
+
+      for (k=0; k<SPACE_PRESENCE_JOBS; k++) {
+         free( jobs[k].value );
+         free( jobs[k].touched );
+         free( jobs[k].visited );
+         free( jobs[k].q );
+         free( jobs[k].qn );
+      }
+   }
+
+   /* Determine dominant faction. */
+   for (i=0; i<array_size(systems_stack); i++) {
+      system_setFaction( &systems_stack[i] );
+      systems_stack[i].ownerpresence = system_getPresence( &systems_stack[i], systems_stack[i].faction );
+   }
+}
+
+
+/**
+ * @brief Adds presence to a system in a presence job.
+ */
+static void presence_jobAdd( PresenceJob *job, int sys, int faction, double amount )
+{
+   int k = sys*job->nfact + faction;
+   job->value[k]  += amount;
+   job->touched[k] = 1;
+}
+
+
+/**
+ * @brief Spills presence from a system in a presence job.
+ *
+ * Same as system_addPresence(), but into the job's own buffers.
+ *
+ *    @param job Job to spill in.
+ *    @param sys Index of the system the presence comes from.
+ *    @param faction Faction of the presence.
+ *    @param amount Amount of presence.
+ *    @param range Range of the spill.
+ */
+static void presence_jobSpill( PresenceJob *job, int sys, int faction, double amount, int range )
+{
+   int e, t, cur, nq, nqn, qi, curSpill;
+   int *tmp;
+   const JumpGraph *g = job->graph;
+
+   presence_jobAdd( job, sys, faction, amount );
+   if (range < 1)
+      return;
+
+   /* Create the initial queue consisting of sys adjacencies. */
+   job->stamp++;
+   job->visited[sys] = job->stamp;
+   nq  = 0;
+   for (e=g->start[sys]; e<g->start[sys+1]; e++) {
+      t = g->target[e];
+      if ((job->visited[t] != job->stamp) && !(g->flags[e] & (JP_HIDDEN | JP_EXITONLY))) {
+         job->q[nq++]    = t;
+         job->visited[t] = job->stamp;
+      }
+   }
+
+   curSpill = 0;
+   qi       = 0;
+   nqn      = 0;
+   while ((curSpill < range) && (qi < nq)) {
+      /* Enqueue all its adjacencies to the next range queue. */
+      cur = job->q[qi];
+      for (e=g->start[cur]; e<g->start[cur+1]; e++) {
+         t = g->target[e];
+         if ((job->visited[t] != job->stamp) && !(g->flags[e] & (JP_HIDDEN | JP_EXITONLY))) {
+            job->qn[nqn++]  = t;
+            job->visited[t] = job->stamp;
+         }
+      }
+
+      /* Spill some presence. */
+      presence_jobAdd( job, job->q[qi], faction, amount / (2 + curSpill) );
+      qi++;
+
+      /* Finished this range, go to the next one. */
+      if (qi >= nq) {
+         curSpill++;
+         tmp     = job->q;
+         job->q  = job->qn;
+         job->qn = tmp;
+         nq      = nqn;
+         nqn     = 0;
+         qi      = 0;
+      }
+   }
+}
+
+
+/**
+ * @brief Spills the presence of the planets of a range of systems.
+ */
+static int presence_job( void *data )
+{
+   int i, j, n;
+   PresenceJob *job = data;
+   StarSystem *sys;
+   Planet *p;
+
+   n = array_size(systems_stack);
+   job->value   = calloc( n*job->nfact, sizeof(double) );
+   job->touched = calloc( n*job->nfact, sizeof(char) );
+   job->visited = calloc( n, sizeof(int) );
+   job->q       = malloc( n * sizeof(int) );
+   job->qn      = malloc( n * sizeof(int) );
+
+   for (i=job->start; i<job->end; i++) {
+      sys = &systems_stack[i];
+      for (j=0; j<array_size(sys->planets); j++) {
+         p = sys->planets[j];
+         if (!faction_isFaction( p->faction ) || (p->presenceAmount == 0.))
+            continue;
+         presence_jobSpill( job, i, p->faction, p->presenceAmount, p->presenceRange );
+      }
+   }
+   return 0;
+}
+
+
+/**
+ * @brief Updates the presence of the planets that changed.
+ *
+ * Only the spill of the planets that changed faction, presence or system is
+ *  redone, but it relies on the jumps being the same as when the presence was
+ *  added, otherwise space_reconstructPresences() has to be used.
+ */
+void space_updatePresences( void )
+{
+   int i, j, changed;
+   StarSystem **planet_sys, *sys;
+
+   /* Find the system of each planet. */
+   planet_sys = calloc( MAX( 1, array_size(planet_stack) ), sizeof(StarSystem*) );
+   for (i=0; i<array_size(systems_stack); i++) {
+      sys = &systems_stack[i];
+      for (j=0; j<array_size(sys->planets); j++)
+         planet_sys[ sys->planets[j]->id ] = sys;
+   }
+
+   changed = 0;
+   for (i=0; i<array_size(planet_stack); i++)
+      changed |= planet_applyPresence( &planet_stack[i], planet_sys[i] );
+   free( planet_sys );
+
+   if (!changed)
+      return;
 
    /* Determine dominant faction. */
    for (i=0; i<array_size(systems_stack); i++) {
@@ -4112,14 +4876,14 @@ int space_isInField ( Vector2d *p )
    /* Always return -1 if in an exclusion zone */
    for (i=0; i < array_size(cur_system->astexclude); i++) {
       e = &cur_system->astexclude[i];
-      if (vect_dist( p, &e->pos ) <= e->radius)
+      if (vect_dist2( p, &e->pos ) <= pow2(e->radius))
          return -1;
    }
 
    /* Check if in asteroid field */
    for (i=0; i < array_size(cur_system->asteroids); i++) {
       a = &cur_system->asteroids[i];
-      if (vect_dist( p, &a->pos ) <= a->radius)
+      if (vect_dist2( p, &a->pos ) <= pow2(a->radius))
          return i;
    }
 
@@ -4127,6 +4891,43 @@ int space_isInField ( Vector2d *p )
 }
 
 
+/**
+ * @brief See if the position of an asteroid is in an asteroid field.
+ *
+ * Same as space_isInField() but starts with the asteroid's own field, which
+ *  it is nearly always in.
+ *
+ *    @param field Field of the asteroid.
+ *    @param p Position of the asteroid.
+ *    @return 1 if in a field, 0 otherwise.
+ */
+static int asteroid_inField( const AsteroidAnchor *field, const Vector2d *p )
+{
+   int i;
+   const AsteroidAnchor *a;
+   const AsteroidExclusion *e;
+
+   /* Never in a field if in an exclusion zone */
+   for (i=0; i < array_size(cur_system->astexclude); i++) {
+      e = &cur_system->astexclude[i];
+      if (vect_dist2( p, &e->pos ) <= pow2(e->radius))
+         return 0;
+   }
+
+   if (vect_dist2( p, &field->pos ) <= pow2(field->radius))
+      return 1;
+
+   /* Fields can overlap. */
+   for (i=0; i < array_size(cur_system->asteroids); i++) {
+      a = &cur_system->asteroids[i];
+      if ((a != field) && (vect_dist2( p, &a->pos ) <= pow2(a->radius)))
+         return 1;
+   }
+
+   return 0;
+}
+
+
 /**
  * @brief Returns the asteroid type corresponding to an ID
  *
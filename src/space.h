@@ -17,6 +17,7 @@ typedef struct JumpPoint_ JumpPoint;
 #include "mission.h"
 #include "opengl.h"
 #include "pilot.h"
+#include "spatial.h"
 #include "tech.h"
 
 
@@ -83,6 +84,20 @@ typedef struct MapOverlayPos_ {
 } MapOverlayPos;
 
 
+/**
+ * @brief Presence a planet has currently added to the universe.
+ *
+ * Kept so it can be taken back when the planet changes, without rebuilding
+ *  the presence of every system.
+ */
+typedef struct PlanetPresence_ {
+   struct StarSystem_ *sys; /**< System the presence was added in, NULL if none. */
+   int faction; /**< Faction the presence was added for. */
+   double amount; /**< Amount of presence added. */
+   int range; /**< Range of the spill. */
+} PlanetPresence;
+
+
 /**
  * @struct Planet
  *
@@ -103,6 +118,7 @@ typedef struct Planet_ {
    double presenceAmount; /**< The amount of presence this asset exerts. */
    double hide;           /**< The ewarfare hide value for an asset. */
    int presenceRange; /**< The range of presence exertion of this asset. */
+   PlanetPresence presence; /**< Presence currently added by the asset. */
    int real; /**< If the asset is tangible or not. */
 
    /* Landing details. */
@@ -145,11 +161,13 @@ typedef struct Planet_ {
 #define SYSTEM_CLAIMED     (1<<3) /**< System is claimed by a mission. */
 #define SYSTEM_DISCOVERED  (1<<4) /**< System has been discovered. This is a temporary flag used by the map. */
 #define SYSTEM_HIDDEN      (1<<5) /**< System is temporarily hidden from view. */
+#define SYSTEM_PATHFLAGS   (SYSTEM_KNOWN) /**< System flags that affect jump paths. */
 #define sys_isFlag(s,f)    ((s)->flags & (f)) /**< Checks system flag. */
-#define sys_setFlag(s,f)   ((s)->flags |= (f)) /**< Sets a system flag. */
-#define sys_rmFlag(s,f)    ((s)->flags &= ~(f)) /**< Removes a system flag. */
+#define sys_setFlag(s,f)   (space_pathGen += !!((f) & SYSTEM_PATHFLAGS), (s)->flags |= (f)) /**< Sets a system flag. */
+#define sys_rmFlag(s,f)    (space_pathGen += !!((f) & SYSTEM_PATHFLAGS), (s)->flags &= ~(f)) /**< Removes a system flag. */
 #define sys_isKnown(s)     (sys_isFlag((s),SYSTEM_KNOWN)) /**< Checks if system is known. */
 #define sys_isMarked(s)    sys_isFlag((s),SYSTEM_MARKED) /**< Checks if system is marked. */
+extern unsigned int space_pathGen; /**< Changes whenever jump paths may change. */
 
 
 /*
@@ -177,9 +195,10 @@ typedef struct SystemPresence_ {
 #define JP_KNOWN        (1<<1) /**< Jump point is known. */
 #define JP_HIDDEN       (1<<2) /**< Jump point is hidden. */
 #define JP_EXITONLY     (1<<3) /**< Jump point is exit only */
+#define JP_PATHFLAGS      (JP_KNOWN | JP_HIDDEN | JP_EXITONLY) /**< Jump flags that affect jump paths. */
 #define jp_isFlag(j,f)    ((j)->flags & (f)) /**< Checks jump flag. */
-#define jp_setFlag(j,f)   ((j)->flags |= (f)) /**< Sets a jump flag. */
-#define jp_rmFlag(j,f)    ((j)->flags &= ~(f)) /**< Removes a jump flag. */
+#define jp_setFlag(j,f)   (space_pathGen += !!((f) & JP_PATHFLAGS), (j)->flags |= (f)) /**< Sets a jump flag. */
+#define jp_rmFlag(j,f)    (space_pathGen += !!((f) & JP_PATHFLAGS), (j)->flags &= ~(f)) /**< Removes a jump flag. */
 #define jp_isKnown(j)     jp_isFlag(j,JP_KNOWN) /**< Checks if jump is known. */
 #define jp_isUsable(j)    (jp_isKnown(j) && !jp_isFlag(j,JP_EXITONLY))
 
@@ -264,6 +283,7 @@ typedef struct AsteroidAnchor_ {
    double area; /**< Field's area. */
    int *type; /**< Types of asteroids. */
    int ntype; /**< Number of types. */
+   SpatialGrid grid; /**< Spatial index of the asteroids, only kept up to date in the current system. */
 } AsteroidAnchor;
 
 
@@ -337,6 +357,7 @@ extern int space_spawn; /**< 1 if spawning is enabled. */
  * loading/exiting
  */
 void space_init( const char* sysname );
+void space_initJump( const char* sysname );
 int space_load (void);
 void space_exit (void);
 
@@ -406,6 +427,7 @@ void system_addPresence( StarSystem *sys, int faction, double amount, int range
 double system_getPresence( StarSystem *sys, int faction );
 void system_addAllPlanetsPresence( StarSystem *sys );
 void space_reconstructPresences( void );
+void space_updatePresences( void );
 void system_rmCurrentPresence( StarSystem *sys, int faction, double amount );
 
 /*
@@ -418,11 +440,29 @@ unsigned int space_isSimulation( void );
  * Graphics.
  */
 void space_gfxLoad( StarSystem *sys );
+void space_gfxPrefetch( StarSystem *sys );
 void space_gfxUnload( StarSystem *sys );
 
+/**
+ * @brief Jumps of all the systems in compressed sparse row form.
+ *
+ * The jumps of system i are the edges start[i] to start[i+1]-1, in the same
+ *  order as its jumps array, so graph searches walk flat arrays instead of
+ *  chasing the jump and system pointers.
+ */
+typedef struct JumpGraph_ {
+   int n; /**< Number of systems. */
+   int *start; /**< First edge of each system, n+1 entries. */
+   int *target; /**< Target system of each edge. */
+   unsigned int *flags; /**< Path flags (JP_PATHFLAGS) of the jump of each edge. */
+   double *dist; /**< Distance between the two systems of each edge. */
+   unsigned int gen; /**< Value of space_pathGen it was built at. */
+} JumpGraph;
+
 /*
  * Getting stuff.
  */
+const JumpGraph* space_jumpGraph (void);
 StarSystem* system_getAll (void);
 const char *system_existsCase( const char* sysname );
 char **system_searchFuzzyCase( const char* sysname, int *n );
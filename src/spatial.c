@@ -0,0 +1,508 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+
+/**
+ * @file spatial.c
+ *
+ * @brief Uniform grid spatial hash used as a collision broadphase.
+ *
+ * Objects are stored by their axis-aligned bounding box in every cell they
+ * overlap. Cells are hashed into a fixed number of buckets so the grid is
+ * unbounded and only uses memory proportional to the number of objects.
+ *
+ * Queries report each object only once by only reporting an object in the
+ * first cell of the query that it overlaps, so no per-query state is needed
+ * and queries can be done on a const grid.
+ */
+
+
+/** @cond */
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "naev.h"
+/** @endcond */
+
+#include "spatial.h"
+
+#include "array.h"
+
+
+#define SPATIAL_COORD_MAX  1e8 /**< Maximum cell coordinate, to avoid overflows. */
+#define SPATIAL_BUCKETS_MIN 16 /**< Minimum number of buckets. */
+
+
+/*
+ * Prototypes.
+ */
+static int spatial_cell( const SpatialGrid *grid, double v );
+static unsigned int spatial_hash( int cx, int cy );
+static int spatial_overlaps( const SpatialObject *o,
+      double x1, double y1, double x2, double y2 );
+static int spatial_overlapsSegment( const SpatialObject *o,
+      double x1, double y1, double dx, double dy, double r );
+static void spatial_segmentRows( const SpatialGrid *grid, int cx,
+      double x1, double y1, double x2, double y2, double r, int *cy1, int *cy2 );
+static int spatial_compareId( const void *a, const void *b );
+
+
+/**
+ * @brief Gets the cell coordinate of a position on an axis.
+ */
+static int spatial_cell( const SpatialGrid *grid, double v )
+{
+   double c = floor( v * grid->invsize );
+   return (int) CLAMP( -SPATIAL_COORD_MAX, SPATIAL_COORD_MAX, c );
+}
+
+
+/**
+ * @brief Hashes a cell.
+ */
+static unsigned int spatial_hash( int cx, int cy )
+{
+   return ((unsigned int)cx * 73856093u) ^ ((unsigned int)cy * 19349663u);
+}
+
+
+/**
+ * @brief Checks to see if an object overlaps a box.
+ */
+static int spatial_overlaps( const SpatialObject *o,
+      double x1, double y1, double x2, double y2 )
+{
+   return (o->x1 <= x2) && (x1 <= o->x2) && (o->y1 <= y2) && (y1 <= o->y2);
+}
+
+
+/**
+ * @brief Checks to see if an object overlaps a segment thickened by r.
+ *
+ * Clips the segment against the slabs of the object's box grown by r, which
+ *  is slightly conservative at the corners.
+ */
+static int spatial_overlapsSegment( const SpatialObject *o,
+      double x1, double y1, double dx, double dy, double r )
+{
+   int i;
+   double t0, t1, ta, tb, p, d, lo, hi, tmp;
+
+   t0 = 0.;
+   t1 = 1.;
+   for (i=0; i<2; i++) {
+      if (i==0) {
+         p  = x1;
+         d  = dx;
+         lo = o->x1 - r;
+         hi = o->x2 + r;
+      }
+      else {
+         p  = y1;
+         d  = dy;
+         lo = o->y1 - r;
+         hi = o->y2 + r;
+      }
+      /* Parallel to the slab. */
+      if (d == 0.) {
+         if ((p < lo) || (p > hi))
+            return 0;
+         continue;
+      }
+      ta = (lo - p) / d;
+      tb = (hi - p) / d;
+      if (ta > tb) {
+         tmp = ta;
+         ta  = tb;
+         tb  = tmp;
+      }
+      t0 = MAX( t0, ta );
+      t1 = MIN( t1, tb );
+      if (t0 > t1)
+         return 0;
+   }
+   return 1;
+}
+
+
+/**
+ * @brief Gets the rows of a column crossed by a segment thickened by r.
+ */
+static void spatial_segmentRows( const SpatialGrid *grid, int cx,
+      double x1, double y1, double x2, double y2, double r, int *cy1, int *cy2 )
+{
+   double xa, xb, ya, yb, t;
+
+   /* Part of the segment that can reach the column. */
+   xa = MAX( cx * grid->cellsize - r, MIN( x1, x2 ) );
+   xb = MIN( (cx+1) * grid->cellsize + r, MAX( x1, x2 ) );
+   if (x1 == x2) {
+      ya = y1;
+      yb = y2;
+   }
+   else {
+      t  = (y2 - y1) / (x2 - x1);
+      ya = y1 + (xa - x1) * t;
+      yb = y1 + (xb - x1) * t;
+   }
+   *cy1 = spatial_cell( grid, MIN( ya, yb ) - r );
+   *cy2 = spatial_cell( grid, MAX( ya, yb ) + r );
+}
+
+
+/**
+ * @brief Compares object identifiers for sorting.
+ */
+static int spatial_compareId( const void *a, const void *b )
+{
+   return *(const int*)a - *(const int*)b;
+}
+
+
+/**
+ * @brief Initializes a spatial grid.
+ *
+ *    @param grid Grid to initialize.
+ *    @param cellsize Size of the cells, should be around the size of the
+ *           typical object.
+ */
+void spatial_init( SpatialGrid *grid, double cellsize )
+{
+   memset( grid, 0, sizeof(SpatialGrid) );
+   grid->cellsize  = cellsize;
+   grid->invsize   = 1. / cellsize;
+   grid->objects   = array_create( SpatialObject );
+   grid->pending   = array_create( SpatialEntry );
+   grid->entries   = array_create( SpatialEntry );
+   grid->oversized = array_create( int );
+}
+
+
+/**
+ * @brief Frees a spatial grid.
+ *
+ *    @param grid Grid to free.
+ */
+void spatial_free( SpatialGrid *grid )
+{
+   free( grid->buckets );
+   array_free( grid->objects );
+   array_free( grid->pending );
+   array_free( grid->entries );
+   array_free( grid->oversized );
+   memset( grid, 0, sizeof(SpatialGrid) );
+}
+
+
+/**
+ * @brief Removes all the objects from a grid, keeping the memory around.
+ *
+ *    @param grid Grid to clear.
+ */
+void spatial_clear( SpatialGrid *grid )
+{
+   array_resize( &grid->objects, 0 );
+   array_resize( &grid->pending, 0 );
+   array_resize( &grid->entries, 0 );
+   array_resize( &grid->oversized, 0 );
+   if (grid->buckets != NULL)
+      memset( grid->buckets, 0, (grid->nbuckets+1) * sizeof(int) );
+}
+
+
+/**
+ * @brief Adds a circular object to the grid.
+ *
+ * Not visible to queries until spatial_build() is called.
+ *
+ *    @param grid Grid to add object to.
+ *    @param id Identifier to return in queries.
+ *    @param x X position of the object.
+ *    @param y Y position of the object.
+ *    @param r Radius of the object.
+ */
+void spatial_insert( SpatialGrid *grid, int id, double x, double y, double r )
+{
+   spatial_insertBox( grid, id, x-r, y-r, x+r, y+r );
+}
+
+
+/**
+ * @brief Adds an object to the grid by its bounding box.
+ *
+ * Not visible to queries until spatial_build() is called.
+ *
+ *    @param grid Grid to add object to.
+ *    @param id Identifier to return in queries.
+ *    @param x1 Left bound of the object.
+ *    @param y1 Bottom bound of the object.
+ *    @param x2 Right bound of the object.
+ *    @param y2 Top bound of the object.
+ */
+void spatial_insertBox( SpatialGrid *grid, int id,
+      double x1, double y1, double x2, double y2 )
+{
+   int i, j, n, cx1, cy1, cx2, cy2;
+   SpatialObject *o;
+   SpatialEntry *e;
+
+   cx1 = spatial_cell( grid, x1 );
+   cy1 = spatial_cell( grid, y1 );
+   cx2 = spatial_cell( grid, x2 );
+   cy2 = spatial_cell( grid, y2 );
+
+   n  = array_size( grid->objects );
+   o  = &array_grow( &grid->objects );
+   o->id = id;
+   o->x1 = x1;
+   o->y1 = y1;
+   o->x2 = x2;
+   o->y2 = y2;
+   o->cx = cx1;
+   o->cy = cy1;
+   o->oversized = ((double)(cx2-cx1+1) * (double)(cy2-cy1+1) > SPATIAL_CELLS_MAX);
+
+   /* Huge objects just get tested against every query. */
+   if (o->oversized) {
+      array_push_back( &grid->oversized, n );
+      return;
+   }
+
+   for (i=cx1; i<=cx2; i++) {
+      for (j=cy1; j<=cy2; j++) {
+         e = &array_grow( &grid->pending );
+         e->obj = n;
+         e->cx  = i;
+         e->cy  = j;
+      }
+   }
+}
+
+
+/**
+ * @brief Sorts the added objects into the buckets, making them visible to queries.
+ *
+ *    @param grid Grid to build.
+ */
+void spatial_build( SpatialGrid *grid )
+{
+   int i, n;
+   unsigned int b, nb;
+   SpatialEntry *e;
+
+   n = array_size( grid->pending );
+
+   /* Size the buckets to have roughly one entry per bucket. */
+   nb = MAX( SPATIAL_BUCKETS_MIN, grid->nbuckets );
+   while (nb < (unsigned int)n)
+      nb *= 2;
+   if ((nb != grid->nbuckets) || (grid->buckets == NULL)) {
+      free( grid->buckets );
+      grid->buckets = malloc( (nb+1) * sizeof(int) );
+      grid->nbuckets = nb;
+   }
+   memset( grid->buckets, 0, (nb+1) * sizeof(int) );
+
+   /* Counting sort of the entries by bucket. */
+   for (i=0; i<n; i++) {
+      e = &grid->pending[i];
+      e->bucket = spatial_hash( e->cx, e->cy ) & (nb-1);
+      grid->buckets[ e->bucket+1 ]++;
+   }
+   for (b=0; b<nb; b++)
+      grid->buckets[b+1] += grid->buckets[b];
+   array_resize( &grid->entries, n );
+   for (i=0; i<n; i++) {
+      e = &grid->pending[i];
+      grid->entries[ grid->buckets[ e->bucket ]++ ] = *e;
+   }
+   /* Buckets now point to the end, shift them back to point to the start. */
+   memmove( &grid->buckets[1], &grid->buckets[0], nb * sizeof(int) );
+   grid->buckets[0] = 0;
+
+   array_resize( &grid->pending, 0 );
+}
+
+
+/**
+ * @brief Gets all the objects that may overlap a box.
+ *
+ *    @param grid Grid to query.
+ *    @param[out] ids Array (array.h) to store the identifiers of the objects
+ *                overlapping, gets cleared first and created if NULL.
+ *    @param x1 Left bound of the box.
+ *    @param y1 Bottom bound of the box.
+ *    @param x2 Right bound of the box.
+ *    @param y2 Top bound of the box.
+ */
+void spatial_query( const SpatialGrid *grid, int **ids,
+      double x1, double y1, double x2, double y2 )
+{
+   int i, j, k, cx1, cy1, cx2, cy2;
+   unsigned int b;
+   const SpatialEntry *e;
+   const SpatialObject *o;
+
+   if (*ids == NULL)
+      *ids = array_create( int );
+   else
+      array_resize( ids, 0 );
+
+   if (grid->buckets == NULL)
+      return;
+
+   /* Oversized objects are always candidates. */
+   for (i=0; i<array_size(grid->oversized); i++) {
+      o = &grid->objects[ grid->oversized[i] ];
+      if (spatial_overlaps( o, x1, y1, x2, y2 ))
+         array_push_back( ids, o->id );
+   }
+
+   cx1 = spatial_cell( grid, x1 );
+   cy1 = spatial_cell( grid, y1 );
+   cx2 = spatial_cell( grid, x2 );
+   cy2 = spatial_cell( grid, y2 );
+
+   /* Query covers more cells than there are entries, faster to go linearly. */
+   if ((double)(cx2-cx1+1) * (double)(cy2-cy1+1) > (double)array_size(grid->entries)) {
+      for (i=0; i<array_size(grid->objects); i++) {
+         o = &grid->objects[i];
+         /* Oversized have already been added. */
+         if (o->oversized)
+            continue;
+         if (spatial_overlaps( o, x1, y1, x2, y2 ))
+            array_push_back( ids, o->id );
+      }
+      return;
+   }
+
+   for (i=cx1; i<=cx2; i++) {
+      for (j=cy1; j<=cy2; j++) {
+         b = spatial_hash( i, j ) & (grid->nbuckets-1);
+         for (k=grid->buckets[b]; k<grid->buckets[b+1]; k++) {
+            e = &grid->entries[k];
+            /* Hash collision with another cell. */
+            if ((e->cx != i) || (e->cy != j))
+               continue;
+            o = &grid->objects[ e->obj ];
+            /* Only report in the first cell of the query the object is in. */
+            if ((MAX( o->cx, cx1 ) != i) || (MAX( o->cy, cy1 ) != j))
+               continue;
+            if (spatial_overlaps( o, x1, y1, x2, y2 ))
+               array_push_back( ids, o->id );
+         }
+      }
+   }
+}
+
+
+/**
+ * @brief Gets all the objects that may overlap a circle.
+ *
+ *    @param grid Grid to query.
+ *    @param[out] ids Array (array.h) to store the identifiers of the objects
+ *                overlapping, gets cleared first and created if NULL.
+ *    @param x X position of the circle.
+ *    @param y Y position of the circle.
+ *    @param r Radius of the circle.
+ */
+void spatial_queryCircle( const SpatialGrid *grid, int **ids,
+      double x, double y, double r )
+{
+   spatial_query( grid, ids, x-r, y-r, x+r, y+r );
+}
+
+
+/**
+ * @brief Gets all the objects that may overlap a segment.
+ *
+ * Only visits the cells along the segment instead of its whole bounding box,
+ *  which matters for long diagonal segments such as beams.
+ *
+ *    @param grid Grid to query.
+ *    @param[out] ids Array (array.h) to store the identifiers of the objects
+ *                overlapping, gets cleared first and created if NULL.
+ *    @param x1 X position of the start of the segment.
+ *    @param y1 Y position of the start of the segment.
+ *    @param x2 X position of the end of the segment.
+ *    @param y2 Y position of the end of the segment.
+ *    @param r Thickness of the segment on each side.
+ */
+void spatial_querySegment( const SpatialGrid *grid, int **ids,
+      double x1, double y1, double x2, double y2, double r )
+{
+   int i, j, k, n, cx1, cx2, cy1, cy2;
+   unsigned int b;
+   double dx, dy, ncells;
+   const SpatialEntry *e;
+   const SpatialObject *o;
+
+   if (*ids == NULL)
+      *ids = array_create( int );
+   else
+      array_resize( ids, 0 );
+
+   if (grid->buckets == NULL)
+      return;
+
+   dx = x2 - x1;
+   dy = y2 - y1;
+
+   /* Oversized objects are always candidates. */
+   for (i=0; i<array_size(grid->oversized); i++) {
+      o = &grid->objects[ grid->oversized[i] ];
+      if (spatial_overlapsSegment( o, x1, y1, dx, dy, r ))
+         array_push_back( ids, o->id );
+   }
+
+   cx1 = spatial_cell( grid, MIN( x1, x2 ) - r );
+   cx2 = spatial_cell( grid, MAX( x1, x2 ) + r );
+
+   /* Count the cells to see if going linearly is faster. */
+   ncells = 0.;
+   for (i=cx1; i<=cx2; i++) {
+      spatial_segmentRows( grid, i, x1, y1, x2, y2, r, &cy1, &cy2 );
+      ncells += (double)(cy2-cy1+1);
+   }
+   if (ncells > (double)array_size(grid->entries)) {
+      for (i=0; i<array_size(grid->objects); i++) {
+         o = &grid->objects[i];
+         /* Oversized have already been added. */
+         if (o->oversized)
+            continue;
+         if (spatial_overlapsSegment( o, x1, y1, dx, dy, r ))
+            array_push_back( ids, o->id );
+      }
+      return;
+   }
+
+   /* The cells don't form a box, so objects can't be reported only in their
+    * first cell of the query. Duplicates are removed afterwards instead. */
+   n = array_size( *ids );
+   for (i=cx1; i<=cx2; i++) {
+      spatial_segmentRows( grid, i, x1, y1, x2, y2, r, &cy1, &cy2 );
+      for (j=cy1; j<=cy2; j++) {
+         b = spatial_hash( i, j ) & (grid->nbuckets-1);
+         for (k=grid->buckets[b]; k<grid->buckets[b+1]; k++) {
+            e = &grid->entries[k];
+            /* Hash collision with another cell. */
+            if ((e->cx != i) || (e->cy != j))
+               continue;
+            o = &grid->objects[ e->obj ];
+            if (spatial_overlapsSegment( o, x1, y1, dx, dy, r ))
+               array_push_back( ids, o->id );
+         }
+      }
+   }
+
+   /* Remove the objects found in several cells. */
+   if (array_size(*ids) - n > 1) {
+      qsort( &(*ids)[n], array_size(*ids) - n, sizeof(int), spatial_compareId );
+      k = n+1;
+      for (i=n+1; i<array_size(*ids); i++)
+         if ((*ids)[i] != (*ids)[k-1])
+            (*ids)[k++] = (*ids)[i];
+      array_resize( ids, k );
+   }
+}
@@ -0,0 +1,79 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+
+
+
+#ifndef SPATIAL_H
+#  define SPATIAL_H
+
+
+#define SPATIAL_CELLS_MAX  64 /**< Max cells an object can span before it is considered oversized. */
+
+
+/**
+ * @brief Object stored in a spatial grid.
+ */
+typedef struct SpatialObject_ {
+   int id; /**< User identifier (typically an index into a stack). */
+   double x1; /**< Left bound. */
+   double y1; /**< Bottom bound. */
+   double x2; /**< Right bound. */
+   double y2; /**< Top bound. */
+   int cx; /**< First cell on the X axis the object overlaps. */
+   int cy; /**< First cell on the Y axis the object overlaps. */
+   int oversized; /**< Object is too big to be stored in cells. */
+} SpatialObject;
+
+
+/**
+ * @brief Reference to an object from a cell.
+ */
+typedef struct SpatialEntry_ {
+   int obj; /**< Index of the object. */
+   int cx; /**< X coordinate of the cell. */
+   int cy; /**< Y coordinate of the cell. */
+   unsigned int bucket; /**< Hash bucket of the cell. */
+} SpatialEntry;
+
+
+/**
+ * @brief Uniform grid spatial hash for broadphase queries.
+ *
+ * Objects are added with spatial_insert() and made available for queries
+ * with spatial_build(). The grid has to be cleared and rebuilt whenever the
+ * objects move.
+ */
+typedef struct SpatialGrid_ {
+   double cellsize; /**< Size of a cell. */
+   double invsize; /**< Inverse of the cell size. */
+   unsigned int nbuckets; /**< Number of hash buckets (power of two). */
+   int *buckets; /**< Start of each bucket in entries (nbuckets+1 elements). */
+   SpatialObject *objects; /**< Objects in the grid (array.h). */
+   SpatialEntry *pending; /**< Entries waiting to be sorted into buckets (array.h). */
+   SpatialEntry *entries; /**< Entries sorted by bucket (array.h). */
+   int *oversized; /**< Objects too big to be stored in cells (array.h). */
+} SpatialGrid;
+
+
+/* Creation and destruction. */
+void spatial_init( SpatialGrid *grid, double cellsize );
+void spatial_free( SpatialGrid *grid );
+
+/* Filling. */
+void spatial_clear( SpatialGrid *grid );
+void spatial_insert( SpatialGrid *grid, int id, double x, double y, double r );
+void spatial_insertBox( SpatialGrid *grid, int id,
+      double x1, double y1, double x2, double y2 );
+void spatial_build( SpatialGrid *grid );
+
+/* Queries. */
+void spatial_query( const SpatialGrid *grid, int **ids,
+      double x1, double y1, double x2, double y2 );
+void spatial_queryCircle( const SpatialGrid *grid, int **ids,
+      double x, double y, double r );
+void spatial_querySegment( const SpatialGrid *grid, int **ids,
+      double x1, double y1, double x2, double y2, double r );
+
+
+#endif /* SPATIAL_H */
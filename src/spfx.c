@@ -50,8 +50,14 @@
 
 /* Trail stuff. */
 #define TRAIL_UPDATE_DT       0.05
+#define TRAIL_POOL_MAX        256 /**< Maximum number of dead trails kept for reuse. */
 static TrailSpec* trail_spec_stack;
 static Trail_spfx** trail_spfx_stack;
+static Trail_spfx** trail_spfx_pool = NULL; /**< Dead trails that keep their point buffer for reuse (array.h). */
+#define TRAIL_FLOATS          (2+4+3+2+2) /**< Floats per trail vertex (pos, colour, trail pos, thickness, trail r and dt). */
+static gl_vbo *trail_vbo = NULL; /**< Streaming VBO for the segments of all the trails. */
+static GLfloat *trail_vertex = NULL; /**< Array (array.h): Vertex data of the trails being drawn. */
+static int *trail_spec_first = NULL; /**< Array (array.h): First vertex of each trail spec. */
 
 
 /*
@@ -140,13 +146,15 @@ static SPFX *spfx_stack_back = NULL; /**< Back special effect layer. */
 static int spfx_base_parse( SPFX_Base *temp, const xmlNodePtr parent );
 static void spfx_base_free( SPFX_Base *effect );
 static void spfx_update_layer( SPFX *layer, const double dt );
+static void spfx_sort_layer( SPFX *layer );
 /* Haptic. */
 static int spfx_hapticInit (void);
 static void spfx_hapticRumble( double mod );
 /* Trail. */
 static void spfx_update_trails( double dt );
 static void spfx_trail_update( Trail_spfx* trail, double dt );
-static void spfx_trail_draw( const Trail_spfx* trail );
+static void spfx_trail_batch( const Trail_spfx* trail );
+static void spfx_trails_draw (void);
 static void spfx_trail_free( Trail_spfx* trail );
 
 
@@ -174,7 +182,7 @@ static int spfx_base_parse( SPFX_Base *temp, const xmlNodePtr parent )
       xmlr_float(node, "ttl", temp->ttl);
       if (xml_isNode(node,"gfx")) {
          temp->gfx = xml_parseTexture( node,
-               SPFX_GFX_PATH"%s", 6, 5, 0 );
+               SPFX_GFX_PATH"%s", 6, 5, OPENGL_TEX_ATLAS );
          continue;
       }
       WARN(_("SPFX '%s' has unknown node '%s'."), temp->name, node->name);
@@ -338,6 +346,18 @@ void spfx_free (void)
    for (i=0; i<array_size(trail_spfx_stack); i++)
       spfx_trail_free( trail_spfx_stack[i] );
    array_free( trail_spfx_stack );
+   for (i=0; i<array_size(trail_spfx_pool); i++) {
+      free( trail_spfx_pool[i]->point_ringbuf );
+      free( trail_spfx_pool[i] );
+   }
+   array_free( trail_spfx_pool );
+   trail_spfx_pool = NULL;
+   array_free( trail_vertex );
+   trail_vertex = NULL;
+   array_free( trail_spec_first );
+   trail_spec_first = NULL;
+   gl_vboDestroy( trail_vbo );
+   trail_vbo = NULL;
 
    /* Free the trail styles. */
    for (i=0; i<array_size(trail_spec_stack); i++)
@@ -391,7 +411,7 @@ void spfx_add( int effect,
    ttl = spfx_effects[effect].ttl;
    anim = spfx_effects[effect].anim;
    if (ttl != anim)
-      cur_spfx->timer = ttl + RNGF()*anim;
+      cur_spfx->timer = ttl + RNGF_COSMETIC()*anim;
    else
       cur_spfx->timer = ttl;
 }
@@ -453,21 +473,48 @@ void spfx_update( const double dt, const double real_dt )
  */
 static void spfx_update_layer( SPFX *layer, const double dt )
 {
-   int i;
+   int i, n;
 
-   for (i=0; i<array_size(layer); i++) {
+   n = array_size(layer);
+   for (i=0; i<n; i++) {
       layer[i].timer -= dt; /* less time to live */
 
-      /* time to die! */
+      /* time to die! Order doesn't matter, spfx_sort_layer() fixes it. */
       if (layer[i].timer < 0.) {
-         array_erase( &layer, &layer[i], &layer[i+1] );
-         i--;
+         layer[i--] = layer[--n];
          continue;
       }
 
       /* actually update it */
       vect_cadd( &layer[i].pos, dt*VX(layer[i].vel), dt*VY(layer[i].vel) );
    }
+   if (n < array_size(layer))
+      array_resize( &layer, n );
+}
+
+
+/**
+ * @brief Groups the effects of a layer by their base effect.
+ *
+ * This keeps effects with the same texture together in the sprite batch. The
+ *  layer only gets slightly out of order between frames, so insertion sort is
+ *  close to linear.
+ *
+ *    @param layer Layer to sort.
+ */
+static void spfx_sort_layer( SPFX *layer )
+{
+   int i, j;
+   SPFX tmp;
+
+   for (i=1; i<array_size(layer); i++) {
+      if (layer[i-1].effect <= layer[i].effect)
+         continue;
+      tmp = layer[i];
+      for (j=i; (j>0) && (layer[j-1].effect > tmp.effect); j--)
+         layer[j] = layer[j-1];
+      layer[j] = tmp;
+   }
 }
 
 
@@ -504,7 +551,7 @@ static void spfx_updateShake( double dt )
       render_postprocessRm( shake_shader_pp_id );
       shake_shader_pp_id = 0;
       if (fabs(shake_force_ang) > 1e3)
-         shake_force_ang = RNGF();
+         shake_force_ang = RNGF_COSMETIC();
       return;
    }
 
@@ -527,11 +574,11 @@ static void spfx_updateShake( double dt )
    vect_cadd( &shake_pos, shake_vel.x * dt, shake_vel.y * dt );
 
    /* Set the uniform. */
-   glUseProgram( shaders.shake.program );
+   gl_useProgram( shaders.shake.program );
    glUniform2f( shaders.shake.shake_pos, shake_pos.x / SCREEN_W, shake_pos.y / SCREEN_H );
    glUniform2f( shaders.shake.shake_vel, shake_vel.x / SCREEN_W, shake_vel.y / SCREEN_H );
    glUniform1f( shaders.shake.shake_force, shake_force_mean );
-   glUseProgram( 0 );
+   gl_useProgram( 0 );
 
    gl_checkErr();
 }
@@ -553,9 +600,9 @@ static void spfx_updateDamage( double dt )
    }
 
    /* Set the uniform. */
-   glUseProgram( shaders.damage.program );
+   gl_useProgram( shaders.damage.program );
    glUniform1f( shaders.damage.damage_strength, damage_strength );
-   glUseProgram( 0 );
+   gl_useProgram( 0 );
 
    gl_checkErr();
 }
@@ -569,14 +616,24 @@ static void spfx_updateDamage( double dt )
 Trail_spfx* spfx_trail_create( const TrailSpec* spec )
 {
    Trail_spfx *trail;
+   int n;
 
-   trail = calloc( 1, sizeof(Trail_spfx) );
+   /* Reuse a dead trail and its point buffer if possible. */
+   n = array_size( trail_spfx_pool );
+   if (n > 0) {
+      trail = trail_spfx_pool[n-1];
+      array_resize( &trail_spfx_pool, n-1 );
+   }
+   else {
+      trail = calloc( 1, sizeof(Trail_spfx) );
+      trail->capacity = 1;
+      trail->point_ringbuf = calloc( trail->capacity, sizeof(TrailPoint) );
+   }
    trail->spec = spec;
-   trail->capacity = 1;
    trail->iread = trail->iwrite = 0;
-   trail->point_ringbuf = calloc( trail->capacity, sizeof(TrailPoint) );
+   trail->dt = 0.;
    trail->refcount = 1;
-   trail->r = RNGF();
+   trail->r = RNGF_COSMETIC();
 
    if ( trail_spfx_stack == NULL )
       trail_spfx_stack = array_create( Trail_spfx* );
@@ -689,42 +746,44 @@ void spfx_trail_remove( Trail_spfx* trail )
 
 /**
  * @brief Deallocates an unreferenced, expired trail.
+ *
+ * Weapons create and drop trails all the time, so dead trails are kept with
+ *  their point buffer until the pool is full.
  */
 static void spfx_trail_free( Trail_spfx* trail )
 {
    assert(trail->refcount == 0);
+   if ((trail->refcount == 0) && (array_size(trail_spfx_pool) < TRAIL_POOL_MAX)) {
+      if (trail_spfx_pool == NULL)
+         trail_spfx_pool = array_create_size( Trail_spfx*, TRAIL_POOL_MAX );
+      array_push_back( &trail_spfx_pool, trail );
+      return;
+   }
    free(trail->point_ringbuf);
    free(trail);
 }
 
 
 /**
- * @brief Draws a trail on screen.
+ * @brief Adds the segments of a trail to the vertices being drawn.
+ *
+ *    @param trail Trail to add.
  */
-static void spfx_trail_draw( const Trail_spfx* trail )
+static void spfx_trail_batch( const Trail_spfx* trail )
 {
-   double x1, y1, x2, y2, z;
+   double x1, y1, x2, y2, z, s, c, sn, w;
    const TrailPoint *tp, *tpp;
    const TrailStyle *sp, *spp, *styles;
-   size_t i, n;
-   GLfloat len;
-   gl_Matrix4 projection;
-   double s;
+   const glColour *col;
+   size_t i;
+   int j, k, qx, qy;
+   GLfloat len, *v;
+   static const int quad[6][2] = { {0,0}, {1,0}, {0,1}, {1,0}, {1,1}, {0,1} };
 
-   n = trail_size(trail);
-   if (n==0)
+   if (trail_size(trail) == 0)
       return;
    styles = trail->spec->style;
 
-   /* Stuff that doesn't change for the entire trail. */
-   glUseProgram( shaders.trail.program );
-   if (gl_has( OPENGL_SUBROUTINES ))
-      glUniformSubroutinesuiv( GL_FRAGMENT_SHADER, 1, &trail->spec->type );
-   glEnableVertexAttribArray( shaders.trail.vertex );
-   gl_vboActivateAttribOffset( gl_squareVBO, shaders.trail.vertex, 0, 2, GL_FLOAT, 0 );
-   glUniform1f( shaders.trail.dt, trail->dt );
-   glUniform1f( shaders.trail.r, trail->r );
-
    z   = cam_getZoom();
    len = 0.;
    for (i = trail->iread + 1; i < trail->iwrite; i++) {
@@ -741,30 +800,123 @@ static void spfx_trail_draw( const Trail_spfx* trail )
       gl_gameToScreenCoords( &x2, &y2, tpp->x, tpp->y );
 
       s = hypotf( x2-x1, y2-y1 );
-
-      /* Set vertex. */
-      projection = gl_Matrix4_Translate(gl_view_matrix, x1, y1, 0);
-      projection = gl_Matrix4_Rotate2dv(projection, (x2-x1)/s, (y2-y1)/s);
-      projection = gl_Matrix4_Scale(projection, s, z*(sp->thick+spp->thick), 1);
-      projection = gl_Matrix4_Translate(projection, 0., -.5, 0);
-
-      /* Set uniforms. */
-      gl_Matrix4_Uniform(shaders.trail.projection, projection);
-      gl_uniformColor(shaders.trail.c1, &sp->col);
-      gl_uniformColor(shaders.trail.c2, &spp->col);
-      glUniform1f(shaders.trail.t1, tp->t);
-      glUniform1f(shaders.trail.t2, tpp->t);
-      glUniform2f(shaders.trail.pos2, len, sp->thick);
+      if (s <= 0.)
+         continue;
+      c  = (x2-x1) / s;
+      sn = (y2-y1) / s;
+      w  = z*(sp->thick+spp->thick);
+
+      /* Segment quad going from tp to tpp, centered on the line. */
+      k = array_size(trail_vertex);
+      array_resize( &trail_vertex, k + 6*TRAIL_FLOATS );
+      v = &trail_vertex[k];
+      for (j=0; j<6; j++, v+=TRAIL_FLOATS) {
+         qx = quad[j][0];
+         qy = quad[j][1];
+         col = qx ? &spp->col : &sp->col;
+         v[0]  = x1 + qx*s*c  - (qy-.5)*w*sn;
+         v[1]  = y1 + qx*s*sn + (qy-.5)*w*c;
+         v[2]  = col->r;
+         v[3]  = col->g;
+         v[4]  = col->b;
+         v[5]  = col->a;
+         v[6]  = qx ? tpp->t : tp->t;
+         v[7]  = qx ? len : len+s;
+         v[8]  = qy;
+         v[9]  = spp->thick;
+         v[10] = sp->thick;
+         v[11] = trail->r;
+         v[12] = trail->dt;
+      }
       len += s;
-      glUniform2f(shaders.trail.pos1, len, spp->thick);
+   }
+}
+
+
+/**
+ * @brief Draws all the trails.
+ *
+ * Segments of all the trails are streamed in a single VBO, grouped by trail
+ *  spec, so there is a draw call per fragment subroutine instead of per
+ *  segment.
+ */
+static void spfx_trails_draw (void)
+{
+   int i, j, first, last;
+   GLuint type;
+   GLsizei stride;
+   GLuint offset;
+   gl_vbo *vbo;
+
+   if (array_size(trail_spfx_stack) == 0)
+      return;
+
+   /* Gather the segments, the ranges of each spec are kept. */
+   if (trail_vertex == NULL)
+      trail_vertex = array_create( GLfloat );
+   if (trail_spec_first == NULL)
+      trail_spec_first = array_create( int );
+   array_resize( &trail_vertex, 0 );
+   array_resize( &trail_spec_first, array_size(trail_spec_stack)+1 );
+   for (j=0; j<array_size(trail_spec_stack); j++) {
+      trail_spec_first[j] = array_size(trail_vertex) / TRAIL_FLOATS;
+      for (i=0; i<array_size(trail_spfx_stack); i++)
+         if (trail_spfx_stack[i]->spec == &trail_spec_stack[j])
+            spfx_trail_batch( trail_spfx_stack[i] );
+   }
+   trail_spec_first[j] = array_size(trail_vertex) / TRAIL_FLOATS;
+   if (array_size(trail_vertex) == 0)
+      return;
+
+   stride = sizeof(GLfloat) * TRAIL_FLOATS;
+   if (trail_vbo == NULL)
+      trail_vbo = gl_vboCreateStream( 0, NULL );
+   vbo = gl_vboStream( trail_vbo, stride * trail_spec_first[j], trail_vertex, &offset );
 
-      /* Draw. */
-      glDrawArrays( GL_TRIANGLE_STRIP, 0, 4 );
+   gl_useProgram( shaders.trail.program );
+   glEnableVertexAttribArray( shaders.trail.vertex );
+   glEnableVertexAttribArray( shaders.trail.vertex_color );
+   glEnableVertexAttribArray( shaders.trail.vertex_pos );
+   glEnableVertexAttribArray( shaders.trail.vertex_thick );
+   glEnableVertexAttribArray( shaders.trail.vertex_trail );
+   gl_vboActivateAttribOffset( vbo, shaders.trail.vertex,
+         offset, 2, GL_FLOAT, stride );
+   gl_vboActivateAttribOffset( vbo, shaders.trail.vertex_color,
+         offset + sizeof(GLfloat) * 2, 4, GL_FLOAT, stride );
+   gl_vboActivateAttribOffset( vbo, shaders.trail.vertex_pos,
+         offset + sizeof(GLfloat) * 6, 3, GL_FLOAT, stride );
+   gl_vboActivateAttribOffset( vbo, shaders.trail.vertex_thick,
+         offset + sizeof(GLfloat) * 9, 2, GL_FLOAT, stride );
+   gl_vboActivateAttribOffset( vbo, shaders.trail.vertex_trail,
+         offset + sizeof(GLfloat) * 11, 2, GL_FLOAT, stride );
+   gl_globalsUse();
+
+   /* Without subroutines everything uses the default look. */
+   if (!gl_has( OPENGL_SUBROUTINES ))
+      gl_drawArrays( GL_TRIANGLES, 0, trail_spec_first[j] );
+   else {
+      /* Consecutive specs of the same type are drawn together. */
+      first = 0;
+      for (j=0; j<array_size(trail_spec_stack); j++) {
+         type = trail_spec_stack[j].type;
+         last = trail_spec_first[j+1];
+         if ((j+1 < array_size(trail_spec_stack)) && (trail_spec_stack[j+1].type == type))
+            continue;
+         if (last > first) {
+            glUniformSubroutinesuiv( GL_FRAGMENT_SHADER, 1, &type );
+            gl_drawArrays( GL_TRIANGLES, first, last-first );
+         }
+         first = last;
+      }
    }
 
    /* Clear state. */
    glDisableVertexAttribArray( shaders.trail.vertex );
-   glUseProgram(0);
+   glDisableVertexAttribArray( shaders.trail.vertex_color );
+   glDisableVertexAttribArray( shaders.trail.vertex_pos );
+   glDisableVertexAttribArray( shaders.trail.vertex_thick );
+   glDisableVertexAttribArray( shaders.trail.vertex_trail );
+   gl_useProgram(0);
 
    /* Check errors. */
    gl_checkErr();
@@ -788,7 +940,7 @@ void spfx_shake( double mod )
 
    /* Create the shake. */
    if (shake_shader_pp_id==0)
-      shake_shader_pp_id = render_postprocessAdd( &shake_shader, PP_LAYER_GAME, 99 );
+      shake_shader_pp_id = render_postprocessAdd( &shake_shader, PP_LAYER_GAME, 99, 0 );
 }
 
 
@@ -805,7 +957,7 @@ void spfx_damage( double mod )
 
    /* Create the damage. */
    if (damage_shader_pp_id==0)
-      damage_shader_pp_id = render_postprocessAdd( &damage_shader, PP_LAYER_GUI, 98 );
+      damage_shader_pp_id = render_postprocessAdd( &damage_shader, PP_LAYER_GUI, 98, 0 );
 }
 
 
@@ -908,7 +1060,6 @@ void spfx_render( const int layer )
    SPFX_Base *effect;
    int sx, sy;
    double time;
-   Trail_spfx *trail;
 
    /* get the appropriate layer */
    switch (layer) {
@@ -931,12 +1082,11 @@ void spfx_render( const int layer )
 
    /* Trails are special (for now?). */
    if (layer == SPFX_LAYER_BACK)
-      for (i=0; i<array_size(trail_spfx_stack); i++) {
-         trail = trail_spfx_stack[i];
-         spfx_trail_draw( trail );
-      }
+      spfx_trails_draw();
 
    /* Now render the layer */
+   spfx_sort_layer( spfx_stack );
+   gl_batchStart();
    for (i=array_size(spfx_stack)-1; i>=0; i--) {
       effect = &spfx_effects[ spfx_stack[i].effect ];
 
@@ -956,6 +1106,7 @@ void spfx_render( const int layer )
             spfx_stack[i].lastframe / sx,
             NULL );
    }
+   gl_batchEnd();
 }
 
 
@@ -0,0 +1,208 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+
+/**
+ * @file strindex.c
+ *
+ * @brief Hash index for looking up data by name.
+ *
+ * Used to look up the data stacks (outfits, ships, factions...) by name in
+ *  constant time instead of scanning them. The table uses open addressing
+ *  with linear probing and is kept at most half full.
+ */
+
+
+/** @cond */
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "naev.h"
+/** @endcond */
+
+#include "strindex.h"
+
+
+#define STRINDEX_SIZE_MIN  64 /**< Minimum size of the table. */
+
+
+/*
+ * Prototypes.
+ */
+static unsigned int strindex_hash( const char *name );
+static void strindex_insert( StrIndex *idx, const char *name,
+      unsigned int hash, int id );
+static void strindex_grow( StrIndex *idx );
+
+
+/**
+ * @brief Hashes a name case insensitively (FNV-1a).
+ */
+static unsigned int strindex_hash( const char *name )
+{
+   unsigned int h;
+
+   h = 2166136261u;
+   for (; *name != '\0'; name++) {
+      h ^= (unsigned char) tolower( (unsigned char) *name );
+      h *= 16777619u;
+   }
+   return h;
+}
+
+
+/**
+ * @brief Inserts an entry in the table, which must have space for it.
+ */
+static void strindex_insert( StrIndex *idx, const char *name,
+      unsigned int hash, int id )
+{
+   int i, mask;
+
+   mask = idx->size-1;
+   for (i=hash & mask; idx->entries[i].name != NULL; i=(i+1) & mask);
+   idx->entries[i].name = name;
+   idx->entries[i].hash = hash;
+   idx->entries[i].id   = id;
+   idx->n++;
+}
+
+
+/**
+ * @brief Doubles the size of the table.
+ *
+ * Entries are reinserted starting from an empty slot so that entries sharing
+ *  a name stay in the order they were added.
+ */
+static void strindex_grow( StrIndex *idx )
+{
+   int i, j, start, oldsize;
+   StrIndexEntry *old;
+
+   old     = idx->entries;
+   oldsize = idx->size;
+
+   idx->size    = MAX( STRINDEX_SIZE_MIN, 2*oldsize );
+   idx->entries = calloc( idx->size, sizeof(StrIndexEntry) );
+   idx->n       = 0;
+
+   /* The table is never full, so there is always an empty slot. */
+   for (start=0; start<oldsize; start++)
+      if (old[start].name == NULL)
+         break;
+   for (i=0; i<oldsize; i++) {
+      j = (start+i) % oldsize;
+      if (old[j].name != NULL)
+         strindex_insert( idx, old[j].name, old[j].hash, old[j].id );
+   }
+   free( old );
+}
+
+
+/**
+ * @brief Initializes a string index.
+ *
+ *    @param idx Index to initialize.
+ */
+void strindex_init( StrIndex *idx )
+{
+   memset( idx, 0, sizeof(StrIndex) );
+}
+
+
+/**
+ * @brief Frees a string index.
+ *
+ *    @param idx Index to free.
+ */
+void strindex_free( StrIndex *idx )
+{
+   free( idx->entries );
+   memset( idx, 0, sizeof(StrIndex) );
+}
+
+
+/**
+ * @brief Removes all the entries from an index, keeping the memory around.
+ *
+ *    @param idx Index to clear.
+ */
+void strindex_clear( StrIndex *idx )
+{
+   if (idx->entries != NULL)
+      memset( idx->entries, 0, idx->size * sizeof(StrIndexEntry) );
+   idx->n = 0;
+}
+
+
+/**
+ * @brief Adds a name to an index.
+ *
+ *    @param idx Index to add to.
+ *    @param name Name to add, must stay valid while in the index (NULL is ignored).
+ *    @param id Identifier to return when looking up the name.
+ */
+void strindex_add( StrIndex *idx, const char *name, int id )
+{
+   if (name == NULL)
+      return;
+   if (2*(idx->n+1) > idx->size)
+      strindex_grow( idx );
+   strindex_insert( idx, name, strindex_hash( name ), id );
+}
+
+
+/**
+ * @brief Looks up a name in an index.
+ *
+ *    @param idx Index to look up in.
+ *    @param name Name to look up.
+ *    @return The identifier of the name or -1 if not found.
+ */
+int strindex_get( const StrIndex *idx, const char *name )
+{
+   int i, mask;
+   unsigned int hash;
+   const StrIndexEntry *e;
+
+   if ((name == NULL) || (idx->n == 0))
+      return -1;
+
+   hash = strindex_hash( name );
+   mask = idx->size-1;
+   for (i=hash & mask; idx->entries[i].name != NULL; i=(i+1) & mask) {
+      e = &idx->entries[i];
+      if ((e->hash == hash) && (strcmp( e->name, name ) == 0))
+         return e->id;
+   }
+   return -1;
+}
+
+
+/**
+ * @brief Looks up a name in an index ignoring case.
+ *
+ *    @param idx Index to look up in.
+ *    @param name Name to look up.
+ *    @return The identifier of the name or -1 if not found.
+ */
+int strindex_getCase( const StrIndex *idx, const char *name )
+{
+   int i, mask;
+   unsigned int hash;
+   const StrIndexEntry *e;
+
+   if ((name == NULL) || (idx->n == 0))
+      return -1;
+
+   hash = strindex_hash( name );
+   mask = idx->size-1;
+   for (i=hash & mask; idx->entries[i].name != NULL; i=(i+1) & mask) {
+      e = &idx->entries[i];
+      if ((e->hash == hash) && (strcasecmp( e->name, name ) == 0))
+         return e->id;
+   }
+   return -1;
+}
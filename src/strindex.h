@@ -0,0 +1,49 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+
+
+
+#ifndef STRINDEX_H
+#  define STRINDEX_H
+
+
+/**
+ * @brief Entry of a string index.
+ */
+typedef struct StrIndexEntry_ {
+   const char *name; /**< Name of the entry, owned by the caller. */
+   unsigned int hash; /**< Case insensitive hash of the name. */
+   int id; /**< User identifier (typically an index into a stack). */
+} StrIndexEntry;
+
+
+/**
+ * @brief Hash index mapping names to identifiers.
+ *
+ * Names are not copied, so they have to stay valid as long as they are in the
+ *  index. Names are hashed case insensitively so that both exact and case
+ *  insensitive lookups are constant time. If several entries share a name,
+ *  lookups return the first one added.
+ */
+typedef struct StrIndex_ {
+   StrIndexEntry *entries; /**< Open addressing table (size elements). */
+   int size; /**< Size of the table (power of two). */
+   int n; /**< Number of entries in the table. */
+} StrIndex;
+
+
+/* Creation and destruction. */
+void strindex_init( StrIndex *idx );
+void strindex_free( StrIndex *idx );
+
+/* Filling. */
+void strindex_clear( StrIndex *idx );
+void strindex_add( StrIndex *idx, const char *name, int id );
+
+/* Lookups. */
+int strindex_get( const StrIndex *idx, const char *name );
+int strindex_getCase( const StrIndex *idx, const char *name );
+
+
+#endif /* STRINDEX_H */
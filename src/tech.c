@@ -61,9 +61,12 @@ typedef struct tech_item_s {
 /**
  * @brief Group of tech items, basic unit of the tech trees.
  */
+#define TECH_FLAT_TYPES    (TECH_TYPE_COMMODITY+1) /**< Number of item types that get flattened. */
 struct tech_group_s {
    char *name;          /**< Name of the tech group. */
    tech_item_t *items;  /**< Items in the tech group. */
+   void **flat[TECH_FLAT_TYPES]; /**< Sorted items of each type including subgroups (array.h). */
+   unsigned int flat_gen[TECH_FLAT_TYPES]; /**< tech_gen the flat items were made in. */
 };
 
 
@@ -71,6 +74,7 @@ struct tech_group_s {
  * Group list.
  */
 static tech_group_t *tech_groups = NULL;
+static unsigned int tech_gen = 1; /**< Changes whenever any group changes, invalidating flattened items. */
 
 
 /*
@@ -91,6 +95,9 @@ static int tech_addItemGroupPointer( tech_group_t *grp, tech_group_t *ptr );
 static int tech_addItemGroup( tech_group_t *grp, const char* name );
 /* Getting by tech. */
 static void** tech_addGroupItem( void **items, tech_item_type_t type, tech_group_t *tech );
+static void** tech_getFlat( tech_group_t *tech, tech_item_type_t type );
+static void* tech_copyFlat( tech_group_t *tech, tech_item_type_t type );
+static int tech_comparePtr( const void *a, const void *b );
 
 
 /**
@@ -197,8 +204,11 @@ void tech_free (void)
  */
 static void tech_freeGroup( tech_group_t *grp )
 {
+   int i;
    free(grp->name);
    array_free( grp->items );
+   for (i=0; i<TECH_FLAT_TYPES; i++)
+      array_free( grp->flat[i] );
 }
 
 
@@ -387,6 +397,7 @@ static int tech_parseNodeData( tech_group_t *tech, xmlNodePtr parent )
  */
 static tech_item_t *tech_itemGrow( tech_group_t *grp )
 {
+   tech_gen++;
    if (grp->items == NULL)
       grp->items = array_create( tech_item_t );
    return &array_grow( &grp->items );
@@ -530,6 +541,7 @@ int tech_rmItemTech( tech_group_t *tech, const char *value )
       buf = tech_getItemName( &tech->items[i] );
       if (strcmp(buf, value)==0) {
          array_erase( &tech->items, &tech->items[i], &tech->items[i+1] );
+         tech_gen++;
          return 0;
       }
    }
@@ -564,6 +576,7 @@ int tech_rmItem( const char *name, const char *value )
       buf = tech_getItemName( &tech->items[i] );
       if (strcmp(buf, value)==0) {
          array_erase( &tech->items, &tech->items[i], &tech->items[i+1] );
+         tech_gen++;
          return 0;
       }
    }
@@ -653,56 +666,131 @@ static void tech_createMetaGroup( tech_group_t *grp, tech_group_t **tech, int nu
 
 
 /**
- * @brief Recursive function for creating an array of commodities from a tech group.
+ * @brief Compares pointers, for getting rid of duplicates.
+ */
+static int tech_comparePtr( const void *a, const void *b )
+{
+   uintptr_t pa, pb;
+   pa = (uintptr_t) *(void* const*) a;
+   pb = (uintptr_t) *(void* const*) b;
+   if (pa < pb)
+      return -1;
+   else if (pa > pb)
+      return +1;
+   return 0;
+}
+
+
+/**
+ * @brief Adds the items of a tech group and its subgroups to an array.
+ *
+ * Subgroups are added from their flattened items, which may contain
+ *  duplicates of the items already in the array.
  */
 static void** tech_addGroupItem( void **items, tech_item_type_t type, tech_group_t *tech )
 {
-   int i, j, size, f;
+   int i, size;
    tech_item_t *item;
+   tech_group_t *grp;
 
    /* Set up. */
    size  = array_size( tech->items );
+   if (items == NULL)
+      items = array_create( void* );
 
-   /* Load commodities first, then we handle groups. */
    for (i=0; i<size; i++) {
       item = &tech->items[i];
 
-      /* Only handle commodities for now. */
-      if (item->type != type)
+      if (item->type == type) {
+         array_push_back( &items, item->u.ptr );
          continue;
-
-      /* Skip if already in list. */
-      f = 0;
-      for (j=0; j<array_size(items); j++) {
-         if (items[j] == item->u.ptr) {
-            f = 1;
-            break;
-         }
       }
-      if (f == 1)
+
+      /* Other groups. */
+      if (item->type == TECH_TYPE_GROUP)
+         grp = &tech_groups[ item->u.grp ];
+      else if (item->type == TECH_TYPE_GROUP_POINTER)
+         grp = item->u.grpptr;
+      else
          continue;
 
-      /* Add. */
-      if (items == NULL)
-         items = array_create( void* );
-      array_push_back( &items, item->u.ptr );
+      tech_getFlat( grp, type );
+      if (array_size( grp->flat[type] ) > 0) {
+         array_resize( &items, array_size(items) + array_size(grp->flat[type]) );
+         memcpy( &items[ array_size(items) - array_size(grp->flat[type]) ],
+               grp->flat[type], sizeof(void*) * array_size(grp->flat[type]) );
+      }
    }
 
-   /* Now handle other groups. */
-   for (i=0; i<size; i++) {
-      item = &tech->items[i];
+   return items;
+}
 
-      /* Only handle commodities for now. */
-      if (item->type == TECH_TYPE_GROUP)
-         items  = tech_addGroupItem( items, type, &tech_groups[ item->u.grp ] );
-      else if (item->type == TECH_TYPE_GROUP_POINTER)
-         items  = tech_addGroupItem( items, type, item->u.grpptr );
+
+/**
+ * @brief Gets the items of a type of a tech group, including its subgroups.
+ *
+ * The items are cached in the group until any tech group changes.
+ *
+ *    @param tech Tech group to get items of.
+ *    @param type Type of the items.
+ *    @return Array (array.h) of the sorted items, owned by the group.
+ */
+static void** tech_getFlat( tech_group_t *tech, tech_item_type_t type )
+{
+   int i, j, n;
+   void **items;
+   int (*cmp)( const void*, const void* );
+
+   if (tech->flat_gen[type] == tech_gen)
+      return tech->flat[type];
+
+   /* Gather everything and get rid of duplicates. */
+   array_free( tech->flat[type] );
+   tech->flat[type] = NULL;
+   items = tech_addGroupItem( NULL, type, tech );
+   n     = array_size( items );
+   qsort( items, n, sizeof(void*), tech_comparePtr );
+   for (i=j=0; i<n; i++)
+      if ((j == 0) || (items[j-1] != items[i]))
+         items[j++] = items[i];
+   array_resize( &items, j );
+
+   /* Sort for displaying. */
+   switch (type) {
+      case TECH_TYPE_OUTFIT:
+         cmp = outfit_compareTech;
+         break;
+      case TECH_TYPE_SHIP:
+         cmp = ship_compareTech;
+         break;
+      default:
+         cmp = commodity_compareTech;
+         break;
    }
+   qsort( items, j, sizeof(void*), cmp );
 
+   tech->flat[type]     = items;
+   tech->flat_gen[type] = tech_gen;
    return items;
 }
 
 
+/**
+ * @brief Gets a copy of the items of a type of a tech group.
+ *
+ *    @param tech Tech group to get items of.
+ *    @param type Type of the items.
+ *    @return Array (array.h) of the sorted items to be freed, or NULL if none.
+ */
+static void* tech_copyFlat( tech_group_t *tech, tech_item_type_t type )
+{
+   void **items = tech_getFlat( tech, type );
+   if (array_size(items) == 0)
+      return NULL;
+   return array_copy( void*, items );
+}
+
+
 /**
  * @brief Checks whether a given tech group has the specified item.
  *
@@ -795,11 +883,7 @@ Outfit** tech_getOutfit( tech_group_t *tech )
    if (tech==NULL)
       return NULL;
 
-   o  = (Outfit**)tech_addGroupItem( NULL, TECH_TYPE_OUTFIT, tech );
-
-   /* Sort. */
-   if (o != NULL)
-      qsort( o, array_size(o), sizeof(Outfit*), outfit_compareTech );
+   o  = tech_copyFlat( tech, TECH_TYPE_OUTFIT );
 
    return o;
 }
@@ -845,12 +929,8 @@ Ship** tech_getShip( tech_group_t *tech )
    if (tech==NULL)
       return NULL;
 
-   /* Get the outfits. */
-   s  = (Ship**) tech_addGroupItem( NULL, TECH_TYPE_SHIP, tech );
-
-   /* Sort. */
-   if (s != NULL)
-      qsort( s, array_size(s), sizeof(Ship*), ship_compareTech );
+   /* Get the ships. */
+   s  = tech_copyFlat( tech, TECH_TYPE_SHIP );
 
    return s;
 }
@@ -922,11 +1002,7 @@ Commodity** tech_getCommodity( tech_group_t *tech )
       return NULL;
 
    /* Get the commodities. */
-   c  = (Commodity**) tech_addGroupItem( NULL, TECH_TYPE_COMMODITY, tech );
-
-   /* Sort. */
-   if (c != NULL)
-      qsort( c, array_size(c), sizeof(Commodity*), commodity_compareTech );
+   c  = tech_copyFlat( tech, TECH_TYPE_COMMODITY );
 
    return c;
 }
@@ -2,35 +2,31 @@
  * See Licensing and Copyright notice in threadpool.h
  */
 /*
- * @brief A simple threadpool implementation using a single queue.
+ * @brief A work stealing threadpool.
  *
- * The queue is inspired by this paper (look for the queue with two locks):
+ * Every worker thread has its own deque of jobs. Workers push the jobs they
+ *  create at the back of their own deque and take jobs from the back too, so
+ *  related work stays on the same thread, while idle workers steal from the
+ *  front of the others' deques. Jobs submitted from other threads are spread
+ *  over the deques round robin.
  *
- * Maged M. Michael and Michael L. Scott. 1998. Nonblocking algorithms and
- * preemption-safe locking on multiprogrammed shared memory multiprocessors. J.
- * Parallel Distrib. Comput. 51, 1 (May 1998), 1-26. DOI=10.1006/jpdc.1998.1446
- * http://dx.doi.org/10.1006/jpdc.1998.1446
+ * A semaphore counts the jobs that haven't been claimed yet. A thread must
+ *  take a count off it before taking a job, which guarantees there is a job
+ *  for it in one of the deques, and lets idle workers sleep instead of spin.
  *
- * @ARTICLE{Michael98non-blockingalgorithms,
- *    author = {Maged M. Michael and Michael L. Scott},
- *    title = {Non-Blocking Algorithms and Preemption-Safe Locking on Multiprogrammed Shared Memory Multiprocessors},
- *    journal = {Journal of Parallel and Distributed Computing},
- *    year = {1998},
- *    volume = {51},
- *    pages = {1--26},
- * }
- *
- * @note The algorithm/strategy for killing idle workers should be moved into
- *       the threadhandler and it should also be improved (the current strategy
- *       is probably not very good).
+ * Threads waiting on a vpool run queued jobs while they wait instead of
+ *  blocking, so vpools can be waited for from within jobs.
  */
 
 
 /** @cond */
+#include <stdint.h>
 #include <stdlib.h>
 #include "SDL.h"
 #include "SDL_error.h"
 #include "SDL_thread.h"
+
+#include "naev.h"
 /** @endcond */
 
 #include "threadpool.h"
@@ -38,429 +34,226 @@
 #include "log.h"
 
 
-#define THREADPOOL_TIMEOUT (5 * 100) /* The time a worker thread waits in ms. */
-#define THREADSIG_STOP     (1) /* The signal to stop a worker thread */
-#define THREADSIG_RUN      (0) /* The signal to indicate the worker thread is running */
+#define THREADPOOL_DEQUE_MIN  64 /* Initial capacity of the deques, power of two. */
 
 
 /**
- * Threads to use.
+ * @brief A job to run.
  */
-static int MAXTHREADS = 8; /* Bit overkill, but oh well. */
-
+typedef struct ThreadJob_ {
+   int (*function)(void *); /* The function to be called */
+   void *data;              /* And its arguments */
+   ThreadQueue *vpool;      /* The vpool the job belongs to, or NULL */
+} ThreadJob;
 
 /**
- * @brief Node in the thread queue.
+ * @brief Deque of jobs of a worker, a ring buffer.
  */
-typedef struct Node_ {
-   void *data;          /* The element in the list */
-   struct Node_ *next;  /* The next node in the list */
-} Node;
+typedef struct ThreadDeque_ {
+   SDL_mutex *lock;  /* Protects the deque */
+   ThreadJob *jobs;  /* Ring buffer of the jobs */
+   int size;         /* Capacity of the ring buffer (power of two) */
+   int head;         /* Position of the front */
+   int n;            /* Number of jobs */
+} ThreadDeque;
 
 /**
- * @brief Threadqueue itself.
+ * @brief Virtual thread pool, a set of jobs to run and wait for.
  */
 struct ThreadQueue_ {
-   Node *first;         /* The first node */
-   Node *last;          /* The second node */
-   /* A semaphore to ensure reads only happen when the queue is not empty */
-   SDL_sem *semaphore;
-   SDL_mutex *t_lock;   /* Tail lock. Lock when reading/updating tail */
-   SDL_mutex *h_lock;   /* Same as tail lock, except it's head lock */
+   ThreadJob *jobs;        /* Jobs enqueued before waiting */
+   int n;                  /* Number of jobs */
+   int size;               /* Capacity of jobs */
+   SDL_atomic_t remaining; /* Jobs that haven't finished yet */
+   SDL_sem *done;          /* Signalled when the last job finishes */
 };
 
 /**
- * @brief Data for the threadqueue.
+ * @brief Range of a parallel for.
  */
-typedef struct ThreadQueueData_ {
-   int (*function)(void *);  /* The function to be called */
-   void *data;               /* And its arguments */
-} ThreadQueueData;
+typedef struct ThreadRange_ {
+   void (*function)(void *, int, int); /* The function to be called */
+   void *data;                         /* Its arguments */
+   int start;                          /* First index of the range */
+   int end;                            /* Past the last index of the range */
+} ThreadRange;
 
-/**
- * @brief Thread data.
- */
-typedef struct ThreadData_ {
-   int (*function)(void *); /* The function to be called */
-   void *data;             /* Arguments to the above function */
-   int signal;             /* Signals to the thread */
-   SDL_sem *semaphore;     /* The semaphore to signal new jobs or new signal in the
-                              'signal' variable */
-   ThreadQueue *idle;      /* The queue with idle threads */
-   ThreadQueue *stopped;   /* The queue with stopped threads */
-} ThreadData;
-
-/**
- * @brief Virtual thread pool data.
- */
-typedef struct vpoolThreadData_ {
-   SDL_cond *cond;         /* Condition variable for signalling all jobs in the vpool
-                              are done */
-   SDL_mutex *mutex;       /* The mutex to use with the above condition variable */
-   int *count;             /* Variable to count number of finished jobs in the vpool */
-   ThreadQueueData *node;  /* The job to be done */
-} vpoolThreadData;
-
-/* The global threadpool queue */
-static ThreadQueue *global_queue = NULL;
+static int threadpool_nworkers      = 0; /* Number of worker threads */
+static ThreadDeque *threadpool_deques = NULL; /* Deques of the workers */
+static SDL_sem *threadpool_pending  = NULL; /* Counts jobs not claimed yet */
+static SDL_atomic_t threadpool_next; /* Next deque for jobs from outside */
+static SDL_TLSID threadpool_tls     = 0; /* Index+1 of the worker of a thread */
 
 
 /*
  * Prototypes.
  */
-static ThreadQueue* tq_create (void);
-static void tq_enqueue( ThreadQueue *q, void *data );
-static void* tq_dequeue( ThreadQueue *q );
-static void tq_destroy( ThreadQueue *q );
+static int threadpool_self (void);
+static void threadpool_push( const ThreadJob *job );
+static void threadpool_take( ThreadJob *job );
+static void threadpool_run( ThreadJob *job );
 static int threadpool_worker( void *data );
-static int threadpool_handler( void *data );
-static int vpool_worker( void *data );
-
-
-/**
- * @brief Creates a concurrent queue.
- *
- * The basic concept is that we have a separate lock for both head and tail, so
- *  we can operate separately on either head or tail. This lets us enqueue at
- *  tail and dequeue at the head in true FIFO fashion.
- *
- *    @return The ThreadQueue.
- */
-static ThreadQueue* tq_create (void)
-{
-   ThreadQueue *q;
-   Node *n;
+static int threadpool_rangeJob( void *data );
 
-   /* Queue memory allocation. */
-   q        = calloc( 1, sizeof(ThreadQueue) );
-
-   /* Allocate and insert the dummy node */
-   n        = calloc( 1, sizeof(Node) );
-   n->next  = NULL;
-   q->first = n;
-   q->last  = n;
-
-   /* Create locks. */
-   q->t_lock      = SDL_CreateMutex();
-   q->h_lock      = SDL_CreateMutex();
-   q->semaphore   = SDL_CreateSemaphore( 0 );
-
-   return q;
-}
 
 /**
- * @brief Enqueue data to the ThreadQueue q.
+ * @brief Gets the index of the worker the calling thread is.
  *
- *    @param q The queue to be inserted into.
- *    @param data The element to be stored in the queue.
+ *    @return The index of the worker, or -1 if it's not a worker.
  */
-static void tq_enqueue( ThreadQueue *q, void *data )
+static int threadpool_self (void)
 {
-   Node *n;
-
-   /* Allocate new struct. */
-   n        = calloc( 1, sizeof(Node) );
-   n->data  = data;
-   n->next  = NULL;
-
-   /* Lock */
-   SDL_mutexP( q->t_lock );
-
-   /* Enqueue. */
-   q->last->next  = n;
-   q->last        = n;
-
-   /* Signal and unlock. This wil break if someone tries to enqueue 2^32+1
-    * elements or something. */
-   SDL_SemPost( q->semaphore );
-   SDL_mutexV( q->t_lock );
+   return (int)(intptr_t)SDL_TLSGet( threadpool_tls ) - 1;
 }
 
 /**
- * @brief Dequeue from the ThreadQueue q.
- *
- * @attention The callee should ALWAYS have called SDL_SemWait() on the semaphore.
+ * @brief Queues a job and wakes up a worker for it.
  *
- *    @param q The queue to dequeue from.
- *    @return A void pointer to the element from the queue.
+ *    @param job Job to queue, gets copied.
  */
-static void* tq_dequeue( ThreadQueue *q )
+static void threadpool_push( const ThreadJob *job )
 {
-   void *d;
-   Node *newhead, *node;
-
-   /* Lock the head. */
-   SDL_mutexP( q->h_lock );
-
-   /* Start running. */
-   node     = q->first;
-   newhead  = node->next;
-
-   /* Head not consistent. */
-   if (newhead == NULL) {
-      WARN(_("Tried to dequeue while the queue was empty!"));
-      /* Ugly fix :/ */
-      /*
-      SDL_mutexV(q->h_lock);
-      return NULL;
-      */
-      /* We prefer to wait until the cache updates :/ */
-      do {
-         node     = q->first;
-         newhead  = node->next;
-      } while (newhead == NULL);
+   int w, i;
+   ThreadDeque *d;
+   ThreadJob *jobs;
+
+   /* Workers keep their jobs, the others spread them out. */
+   w = threadpool_self();
+   if (w < 0)
+      w = (unsigned int)SDL_AtomicAdd( &threadpool_next, 1 ) % threadpool_nworkers;
+   d = &threadpool_deques[w];
+
+   SDL_LockMutex( d->lock );
+   if (d->n == d->size) {
+      /* Full, double the size keeping the jobs in order. */
+      jobs = malloc( 2 * d->size * sizeof(ThreadJob) );
+      for (i=0; i<d->n; i++)
+         jobs[i] = d->jobs[ (d->head+i) & (d->size-1) ];
+      free( d->jobs );
+      d->jobs  = jobs;
+      d->size *= 2;
+      d->head  = 0;
    }
+   d->jobs[ (d->head + d->n) & (d->size-1) ] = *job;
+   d->n++;
+   SDL_UnlockMutex( d->lock );
 
-   /* Remember the value and assign newhead as the new dummy element. */
-   d        = newhead->data;
-   q->first = newhead;
-
-   /* Unlock */
-   SDL_mutexV( q->h_lock );
-
-   free( node );
-   return d;
+   /* Only posted once the job can be found. */
+   SDL_SemPost( threadpool_pending );
 }
 
 /**
- * @brief Destroys and frees a ThreadQueue.
+ * @brief Takes a job from the deques.
  *
- * Frees all elements too.
+ * @attention The caller must have claimed a job from threadpool_pending, so
+ *            that there is one to take.
  *
- *    @param q The ThreadQueue to free.
+ *    @param[out] job Job that was taken.
  */
-static void tq_destroy( ThreadQueue *q )
+static void threadpool_take( ThreadJob *job )
 {
-   /* Iterate through the list and free the nodes */
-   while (q->first->next != NULL)
-      free( tq_dequeue(q) ); /* Locks q->t_lock, so we must destroy mutex after. */
+   int self, w, i;
+   ThreadDeque *d;
 
-   /* Clean up threading structures. */
-   SDL_DestroySemaphore( q->semaphore );
-   SDL_DestroyMutex( q->h_lock );
-   SDL_DestroyMutex( q->t_lock );
+   self = threadpool_self();
+   while (1) {
+      /* Newest job of our own deque. */
+      if (self >= 0) {
+         d = &threadpool_deques[self];
+         SDL_LockMutex( d->lock );
+         if (d->n > 0) {
+            d->n--;
+            *job = d->jobs[ (d->head + d->n) & (d->size-1) ];
+            SDL_UnlockMutex( d->lock );
+            return;
+         }
+         SDL_UnlockMutex( d->lock );
+      }
 
-   free( q->first );
-   free( q );
+      /* Oldest job of someone else's. */
+      for (i=1; i<=threadpool_nworkers; i++) {
+         w = (MAX(self,0) + i) % threadpool_nworkers;
+         if (w == self)
+            continue;
+         d = &threadpool_deques[w];
+         SDL_LockMutex( d->lock );
+         if (d->n > 0) {
+            *job    = d->jobs[ d->head ];
+            d->head = (d->head+1) & (d->size-1);
+            d->n--;
+            SDL_UnlockMutex( d->lock );
+            return;
+         }
+         SDL_UnlockMutex( d->lock );
+      }
+      /* The claimed job was taken over by someone scanning ahead of us, but
+       * theirs is still in a deque, so try again. */
+   }
 }
 
-
 /**
- * @brief Enqueues a new job for the threadpool.
- *
- * @warning Do NOT enqueue a job that has to wait for another job to be done as
- *          this could lead to a deadlock.
+ * @brief Runs a job and marks it done in its vpool.
  *
- *    @param function The function (job) to be called (executed).
- *    @param data The arguments for the function.
- *    @return Returns 0 on success and -2 if there was no threadpool.
+ *    @param job Job to run.
  */
-int threadpool_newJob( int (*function)(void *), void *data )
+static void threadpool_run( ThreadJob *job )
 {
-   ThreadQueueData *node;
-
-   if (global_queue == NULL) {
-      WARN(_("Threadpool has not been initialized yet!"));
-      return -2;
-   }
-
-   /* Allocate and set parameters. */
-   node           = calloc( 1, sizeof(ThreadQueueData) );
-   node->data     = data;
-   node->function = function;
+   ThreadQueue *q = job->vpool;
 
-   /* Actually enque. */
-   tq_enqueue( global_queue, node );
+   job->function( job->data );
 
-   return 0;
+   /* SDL_AtomicAdd returns the previous value. */
+   if ((q != NULL) && (SDL_AtomicAdd( &q->remaining, -1 ) == 1))
+      SDL_SemPost( q->done );
 }
 
 /**
  * @brief The worker function for the threadpool.
  *
- * It waits for a signal from the handler. If it receives THREADSIG_STOP it
- *  means the worker thread should stop. Else it dequeues a job from the
- *  global_queue and executes it.
+ * Sleeps until there is a job, then runs it.
  *
- *    @param data A pointer to the ThreadData struct used for a lot of stuff.
+ *    @param data Index of the worker.
  */
 static int threadpool_worker( void *data )
 {
-   ThreadData *work;
+   ThreadJob job;
 
-   work = (ThreadData*) data;
+   SDL_TLSSet( threadpool_tls, (void*)((intptr_t)data + 1), NULL );
 
    /* Work loop */
    while (1) {
-      /* Wait for new signal */
-      while (SDL_SemWait( work->semaphore ) == -1) {
-          /* Putting this in a while-loop is probably a really bad idea, but I
-           * don't have any better ideas. */
+      while (SDL_SemWait( threadpool_pending ) == -1)
           WARN(_("SDL_SemWait failed! Error: %s"), SDL_GetError());
-      }
-      /* Break if received signal to stop */
-      if (work->signal == THREADSIG_STOP)
-         break;
-
-      /* Do work :-) */
-      work->function( work->data );
-
-      /* Enqueue itself in the idle worker threads queue */
-      tq_enqueue( work->idle, work );
+      threadpool_take( &job );
+      threadpool_run( &job );
    }
-   /* Enqueue itself in the stopped worker threads queue when stopped */
-   tq_enqueue( work->stopped, work );
 
    return 0;
 }
 
 /**
- * @brief Handles assigning jobs to the workers and killing them if necessary.
- *
- * @note Stopping the threeadpool_handler is not yet implemented.
- *
- * Process is:
+ * @brief Enqueues a new job for the threadpool.
  *
- * 1) Wait for job
- * 2) if Timed out -> kill idle, putting on stopped, go to 1)
- * 3) Have thread run job
- * 3.1) Grab a job from the queue
- * 3.2) If idle thread, grab idle thread
- *      else if stopped threads, reactivate stopped thread
- *      else wait for running thread
- * 4) Go to 1)
+ * @warning Do NOT enqueue a job that has to wait for another job to be done as
+ *          this could lead to a deadlock. Use a vpool for that instead.
  *
- *    @param data Not used. SDL threading requires functions to take a void
- *                pointer as argument.
- *    @return Not really implemented yet.
+ *    @param function The function (job) to be called (executed).
+ *    @param data The arguments for the function.
+ *    @return Returns 0 on success and -2 if there was no threadpool.
  */
-static int threadpool_handler( void *data )
+int threadpool_newJob( int (*function)(void *), void *data )
 {
-   (void) data;
-   int i, nrunning, newthread;
-   ThreadData *threadargs, *threadarg;
-   /* Queues for idle workers and stopped workers */
-   ThreadQueue *idle, *stopped;
-   ThreadQueueData *node;
-
-   /* Initialize the idle and stopped queues. */
-   idle     = tq_create();
-   stopped  = tq_create();
-
-   /* Allocate threadargs to communicate with workers */
-   threadargs = calloc( MAXTHREADS, sizeof(ThreadData) );
-
-   /* Initialize threadargs */
-   for (i=0; i<MAXTHREADS; i++) {
-      threadargs[i].function  = NULL;
-      threadargs[i].data      = NULL;
-      threadargs[i].semaphore = SDL_CreateSemaphore( 0 ); /* Used to give orders. */
-      threadargs[i].idle      = idle;
-      threadargs[i].stopped   = stopped;
-      threadargs[i].signal    = THREADSIG_RUN;
-      /* 'Workers' that do not have a thread are considered stopped */
-      tq_enqueue( stopped, &threadargs[i] );
-   }
-
-   /* Set the number of running threads to 0 */
-   nrunning = 0;
-
-   /*
-    * Thread handler main loop.
-    */
-   while (1) {
-      /*
-       * We must now wait, this shall be done on each active thread. However they will
-       * be put to sleep as time passes. When we receive a command we'll proceed to process
-       * it.
-       */
-      if (nrunning > 0) {
-         /*
-          * Here we'll wait until thread gets work to do. If it doesn't it will
-          * just stop a worker thread and wait until it gets something to do.
-          */
-         if (SDL_SemWaitTimeout( global_queue->semaphore, THREADPOOL_TIMEOUT ) != 0) {
-            /* There weren't any new jobs so we'll start killing threads ;) */
-            if (SDL_SemTryWait( idle->semaphore ) == 0) {
-               threadarg         = tq_dequeue( idle );
-               /* Set signal to stop worker thread */
-               threadarg->signal = THREADSIG_STOP;
-               /* Signal thread and decrement running threads counter */
-               SDL_SemPost( threadarg->semaphore );
-               nrunning -= 1;
-            }
-
-            /* We just go back to waiting on a thread. */
-            continue;
-         }
-
-         /* We got work. Continue to handle work. */
-      }
-      else {
-         /*
-          * Here we wait for a new job. No threads are alive at this point and the
-          * threadpool is just patiently waiting for work to arrive.
-          */
-         if (SDL_SemWait( global_queue->semaphore ) == -1) {
-             WARN(_("SDL_SemWait failed! Error: %s"), SDL_GetError());
-             continue;
-         }
-
-         /* We got work. Continue to handle work. */
-      }
-
-      /*
-       * Get a new job from the queue. This should be safe as we have received
-       * a permission from the global_queue->semaphore.
-       */
-      node        = tq_dequeue( global_queue );
-      newthread   = 0;
-
-      /*
-       * Choose where to get the thread. Either idle, revive stopped or block until
-       * another thread becomes idle.
-       */
-      /* Idle thread available */
-      if (SDL_SemTryWait(idle->semaphore) == 0)
-         threadarg         = tq_dequeue( idle );
-      /* Make a new thread */
-      else if (SDL_SemTryWait(stopped->semaphore) == 0) {
-         threadarg         = tq_dequeue( stopped );
-         threadarg->signal = THREADSIG_RUN;
-         newthread         = 1;
-      }
-      /* Wait for idle thread */
-      else {
-         while (SDL_SemWait(idle->semaphore) == -1) {
-             /* Bad idea */
-             WARN(_("SDL_SemWait failed! Error: %s"), SDL_GetError());
-         }
-         threadarg         = tq_dequeue( idle );
-      }
-
-      /* Assign arguments for the thread */
-      threadarg->function  = node->function;
-      threadarg->data      = node->data;
-      /* Signal the thread that there's a new job */
-      SDL_SemPost( threadarg->semaphore );
-
-      /* Start a new thread and increment the thread counter */
-      if (newthread) {
-         SDL_CreateThread( threadpool_worker,
-               "threadpool_worker",
-               threadarg );
-         nrunning += 1;
-      }
+   ThreadJob job;
 
-      /* Free the now unused job from the global_queue */
-      free(node);
+   if (threadpool_deques == NULL) {
+      WARN(_("Threadpool has not been initialized yet!"));
+      return -2;
    }
-   /** @TODO A way to stop the threadpool. */
 
-   /* Clean up. */
-   tq_destroy( idle );
-   tq_destroy( stopped );
-   free( threadargs );
+   job.function = function;
+   job.data     = data;
+   job.vpool    = NULL;
+   threadpool_push( &job );
 
    return 0;
 }
@@ -472,21 +265,34 @@ static int threadpool_handler( void *data )
  */
 int threadpool_init (void)
 {
-   MAXTHREADS = SDL_GetCPUCount() + 1; /* SDL 1.3 is pretty cool. */
+   int i;
+   ThreadDeque *d;
 
-   /* There's already a queue */
-   if (global_queue != NULL) {
+   /* There's already a threadpool */
+   if (threadpool_deques != NULL) {
       WARN(_("Threadpool has already been initialized!"));
       return -1;
    }
 
-   /* Create the global queue queue */
-   global_queue = tq_create();
+   threadpool_nworkers = MAX( 1, SDL_GetCPUCount() );
+   threadpool_tls      = SDL_TLSCreate();
+   threadpool_pending  = SDL_CreateSemaphore( 0 );
+   SDL_AtomicSet( &threadpool_next, 0 );
+
+   threadpool_deques = calloc( threadpool_nworkers, sizeof(ThreadDeque) );
+   for (i=0; i<threadpool_nworkers; i++) {
+      d       = &threadpool_deques[i];
+      d->lock = SDL_CreateMutex();
+      d->size = THREADPOOL_DEQUE_MIN;
+      d->jobs = malloc( d->size * sizeof(ThreadJob) );
+   }
 
-   /* Initialize the threadpool handler. */
-   if ( SDL_CreateThread( threadpool_handler, "threadpool_handler", NULL ) == NULL ) {
-      ERR( _( "Threadpool init failed: %s" ), SDL_GetError() );
-      return -1;
+   /* Start the workers, they sleep until there are jobs. */
+   for (i=0; i<threadpool_nworkers; i++) {
+      if ( SDL_CreateThread( threadpool_worker, "threadpool_worker", (void*)(intptr_t)i ) == NULL ) {
+         ERR( _( "Threadpool init failed: %s" ), SDL_GetError() );
+         return -1;
+      }
    }
 
    return 0;
@@ -496,19 +302,20 @@ int threadpool_init (void)
  * @brief Creates a new vpool queue.
  *
  * This is just an interface to make running a number of jobs and then wait for
- *  them to finish more pleasant. You should not nest vpools as of now as there
- *  are only a limit number of worker threads and we can't have them wait for a
- *  thread to finish that doesn't exist.
- *
- * If you really want to sort of nest vpools, you should start a new thread
- *  instead of using the threadpool. I might add a vpool_waitInANewThread
- *  function some day.
+ *  them to finish more pleasant. Jobs only start running when vpool_wait() is
+ *  called. Since waiting threads help run the jobs, vpools can be nested.
  *
  *    @return Returns a ThreadQueue to be used.
  */
 ThreadQueue* vpool_create (void)
 {
-   return tq_create();
+   ThreadQueue *q;
+
+   q       = calloc( 1, sizeof(ThreadQueue) );
+   q->size = 16;
+   q->jobs = malloc( q->size * sizeof(ThreadJob) );
+   q->done = SDL_CreateSemaphore( 0 );
+   return q;
 }
 
 /**
@@ -516,101 +323,108 @@ ThreadQueue* vpool_create (void)
  *
  * @warning Do NOT enqueue jobs that wait for another job to be done, as this
  *          could lead to a deadlock.
- *
- * @warning Do NOT enqueue jobs that wait for a vpool, as this could lead to a
- *          deadlock.
  */
 void vpool_enqueue( ThreadQueue *queue, int (*function)(void *), void *data )
 {
-   ThreadQueueData *node;
+   ThreadJob *job;
 
-   /* Allocate and set up data. */
-   node           = calloc( 1, sizeof(ThreadQueueData) );
-   node->data     = data;
-   node->function = function;
-
-   /* Add to vpool. */
-   tq_enqueue( queue, node );
-}
-
-/**
- * @brief A special vpool worker that signals the waiting thread when all jobs
- *        are done.
- *
- * It uses a mutex+condition variable+counter.
- */
-static int vpool_worker( void *data )
-{
-   int cnt;
-   vpoolThreadData *work;
-
-   work = (vpoolThreadData*) data;
-
-   /* Do work */
-   work->node->function( work->node->data );
-
-   /* Decrement the counter and signal vpool_wait if all threads are done */
-   SDL_mutexP( work->mutex );
-   cnt   = *(work->count) - 1;
-   if (cnt <= 0)                    /* All jobs done. */
-      SDL_CondSignal( work->cond );  /* Signal waiting thread */
-   *(work->count) = cnt;
-   SDL_mutexV( work->mutex );
-
-   return 0;
+   if (queue->n == queue->size) {
+      queue->size *= 2;
+      queue->jobs  = realloc( queue->jobs, queue->size * sizeof(ThreadJob) );
+   }
+   job = &queue->jobs[ queue->n++ ];
+   job->function = function;
+   job->data     = data;
+   job->vpool    = queue;
 }
 
 /* @brief Run every job in the vpool queue and block until every job in the
  *        queue is done.
  *
+ * The calling thread runs queued jobs until there are none left, and only
+ *  then sleeps until the last jobs of the vpool finish.
+ *
  * @note It destroys the queue when it's done.
  */
 void vpool_wait( ThreadQueue *queue )
 {
-   int i, cnt;
-   SDL_cond *cond;
-   SDL_mutex *mutex;
-   vpoolThreadData *arg;
-   ThreadQueueData *node;
-
-   /* Create temporary threading structures. */
-   cond  = SDL_CreateCond();
-   mutex = SDL_CreateMutex();
-   /* This might be a little ugly (and inefficient?) */
-   cnt   = SDL_SemValue( queue->semaphore );
-
-   /* Allocate all vpoolThreadData objects */
-   arg = calloc( cnt, sizeof(vpoolThreadData) );
-
-   SDL_mutexP( mutex );
-   /* Initialize the vpoolThreadData */
-   for (i=0; i<cnt; i++) {
-      /* This is needed to keep the invariants of the queue */
-      while (SDL_SemWait( queue->semaphore ) == -1) {
-          /* Again, a really bad idea */
-          WARN(_("SDL_SemWait failed! Error: %s"), SDL_GetError());
-      }
-      node = tq_dequeue( queue );
+   int i;
+   ThreadJob job;
+
+   /* No workers, so just run them here. */
+   if (threadpool_deques == NULL) {
+      for (i=0; i<queue->n; i++)
+         queue->jobs[i].function( queue->jobs[i].data );
+      queue->n = 0;
+   }
 
-      /* Set up arguments. */
-      arg[i].node    = node;
-      arg[i].cond    = cond;
-      arg[i].mutex   = mutex;
-      arg[i].count   = &cnt;
+   SDL_AtomicSet( &queue->remaining, queue->n );
+   for (i=0; i<queue->n; i++)
+      threadpool_push( &queue->jobs[i] );
 
-      /* Launch new job. */
-      threadpool_newJob( vpool_worker, &arg[i] );
+   /* Help out while there are queued jobs. */
+   while ((SDL_AtomicGet( &queue->remaining ) > 0) &&
+         (SDL_SemTryWait( threadpool_pending ) == 0)) {
+      threadpool_take( &job );
+      threadpool_run( &job );
    }
 
-   /* Wait for the threads to finish */
-   SDL_CondWait( cond, mutex );
-   SDL_mutexV( mutex );
+   /* Always wait for the signal, even if it's all done already, as the last
+    * job still uses the queue to send it. */
+   if (queue->n > 0)
+      SDL_SemWait( queue->done );
 
    /* Clean up */
-   SDL_DestroyMutex( mutex );
-   SDL_DestroyCond( cond );
-   tq_destroy( queue );
-   free( arg );
+   SDL_DestroySemaphore( queue->done );
+   free( queue->jobs );
+   free( queue );
 }
 
+/**
+ * @brief Runs a range of a parallel for.
+ */
+static int threadpool_rangeJob( void *data )
+{
+   ThreadRange *r = data;
+   r->function( r->data, r->start, r->end );
+   return 0;
+}
 
+/**
+ * @brief Runs a function over [0, n) in chunks on the threadpool, and waits
+ *        for it to be done.
+ *
+ *    @param n Number of indices.
+ *    @param chunk Indices per job.
+ *    @param function Function to run, gets data and the range [start, end).
+ *    @param data Passed to function.
+ */
+void vpool_parallelFor( int n, int chunk, void (*function)(void *data, int start, int end), void *data )
+{
+   int i, nr;
+   ThreadRange *ranges;
+   ThreadQueue *queue;
+
+   if (n <= 0)
+      return;
+   chunk = MAX( 1, chunk );
+
+   /* A single chunk isn't worth handing off. */
+   if (n <= chunk) {
+      function( data, 0, n );
+      return;
+   }
+
+   nr     = (n + chunk-1) / chunk;
+   ranges = malloc( nr * sizeof(ThreadRange) );
+   queue  = vpool_create();
+   for (i=0; i<nr; i++) {
+      ranges[i].function = function;
+      ranges[i].data     = data;
+      ranges[i].start    = i*chunk;
+      ranges[i].end      = MIN( n, (i+1)*chunk );
+      vpool_enqueue( queue, threadpool_rangeJob, &ranges[i] );
+   }
+   vpool_wait( queue );
+   free( ranges );
+}
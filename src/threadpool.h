@@ -36,9 +36,12 @@ ThreadQueue* vpool_create( void );
 void vpool_enqueue( ThreadQueue* queue, int (*function)(void *), void *data );
 
 /* Run every job in the vpool queue and block until every job in the queue is
- * done. It destroys the queue when it's done. */
+ * done, helping run jobs meanwhile. It destroys the queue when it's done. */
 void vpool_wait( ThreadQueue* queue );
 
+/* Run function over [0,n) in chunks of indices and wait for it to be done. */
+void vpool_parallelFor( int n, int chunk, void (*function)(void *data, int start, int end), void *data );
+
 
 
 #endif
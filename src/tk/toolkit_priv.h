@@ -185,12 +185,22 @@ typedef struct Window_ {
    int focus; /**< Current focused widget. */
    Widget *widgets; /**< Widget storage. */
    void *udata; /**< Custom data of the window. */
+
+   /* Cached rendering. */
+   int dirty; /**< Window has to be rendered again instead of using the cache. */
+   GLuint fbo; /**< Framebuffer holding the last render of the window. */
+   glTexture *fbo_tex; /**< Texture of the framebuffer, premultiplied alpha. */
+   int fbo_x; /**< Real X position of the framebuffer on the screen. */
+   int fbo_y; /**< Real Y position of the framebuffer on the screen. */
+   int fbo_w; /**< Real width of the framebuffer. */
+   int fbo_h; /**< Real height of the framebuffer. */
 } Window;
 
 
 /* Window stuff. */
 Window* toolkit_getActiveWindow (void);
 Window* window_wget( const unsigned int wid );
+Window* window_find( const unsigned int wid );
 void toolkit_setWindowPos( Window *wdw, int x, int y );
 int toolkit_inputWindow( Window *wdw, SDL_Event *event, int purge );
 void window_render( Window* w );
@@ -96,11 +96,15 @@ static void cst_render( Widget* cst, double bx, double by )
             toolkit_colDark, NULL );
    }
 
+   /* Custom rendering can use any shader, so text isn't batched across it,
+    * see toolkit_render(). */
+   gl_printBatchEnd();
    if (cst->dat.cst.clip != 0)
       gl_clipRect( x, y, cst->w, cst->h );
    cst->dat.cst.render ( x, y, cst->w, cst->h, cst->dat.cst.userdata );
    if (cst->dat.cst.clip != 0)
       gl_unclipRect();
+   gl_printBatchStart();
 }
 
 
@@ -114,12 +118,14 @@ static void cst_renderOverlay( Widget* cst, double bx, double by )
    x = bx + cst->x;
    y = by + cst->y;
 
+   gl_printBatchEnd();
    if (cst->dat.cst.clip != 0)
       gl_clipRect( x, y, cst->w, cst->h );
    if (cst->dat.cst.renderOverlay != NULL)
       cst->dat.cst.renderOverlay ( x, y, cst->w, cst->h, cst->dat.cst.userdata );
    if (cst->dat.cst.clip != 0)
       gl_unclipRect();
+   gl_printBatchStart();
 }
 
 
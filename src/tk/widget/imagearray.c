@@ -40,6 +40,7 @@ static Widget *iar_getWidget( const unsigned int wid, const char *name );
 static char* toolkit_getNameById( Widget *wgt, int elem );
 /* Clean up. */
 static void iar_cleanup( Widget* iar );
+static ImageArrayCell* iar_getCell( Widget *iar, int pos );
 
 
 /**
@@ -134,6 +135,24 @@ static void iar_getDim( Widget* iar, double* w, double* h, double* xspace, doubl
 }
 
 
+/**
+ * @brief Gets a cell of an image array, loading it if needed.
+ *
+ *    @param iar Image array widget to get cell of.
+ *    @param pos Position of the cell.
+ *    @return The loaded cell.
+ */
+static ImageArrayCell* iar_getCell( Widget *iar, int pos )
+{
+   ImageArrayCell *cell = &iar->dat.iar.images[pos];
+   if (cell->load != NULL) {
+      cell->load( cell );
+      cell->load = NULL;
+   }
+   return cell;
+}
+
+
 /**
  * @brief Renders an image array.
  *
@@ -151,6 +170,7 @@ static void iar_render( Widget* iar, double bx, double by )
    glColour fontcolour;
    int is_selected;
    double hmax;
+   const ImageArrayCell *cell;
 
    /*
     * Calculations.
@@ -204,10 +224,11 @@ static void iar_render( Widget* iar, double bx, double by )
             break;
 
          is_selected = (iar->dat.iar.selected == pos) ? 1 : 0;
+         cell = iar_getCell( iar, pos );
 
          fontcolour = cFontWhite;
          /* Draw background. */
-         if (iar->dat.iar.images[pos].bg.a > 0.) {
+         if (cell->bg.a > 0.) {
             if (is_selected) {
                toolkit_drawRect( xcurs + 2.,
                      ycurs + 2.,
@@ -215,7 +236,7 @@ static void iar_render( Widget* iar, double bx, double by )
             } else {
                toolkit_drawRect( xcurs + 2.,
                      ycurs + 2.,
-                     w - 5., h - 5., &iar->dat.iar.images[pos].bg, NULL );
+                     w - 5., h - 5., &cell->bg, NULL );
             }
          } else if (is_selected) {
             toolkit_drawRect( xcurs + 2.,
@@ -224,37 +245,37 @@ static void iar_render( Widget* iar, double bx, double by )
          }
 
          /* image */
-         if (iar->dat.iar.images[pos].image != NULL)
-            gl_blitScale( iar->dat.iar.images[pos].image,
+         if (cell->image != NULL)
+            gl_blitScale( cell->image,
                   xcurs + 5., ycurs + gl_smallFont.h + 7.,
                   iar->dat.iar.iw, iar->dat.iar.ih, NULL );
 
          /* layers */
-         for (k=0; k<iar->dat.iar.images[pos].nlayers; k++)
-            if (iar->dat.iar.images[pos].layers[k] != NULL)
-               gl_blitScale( iar->dat.iar.images[pos].layers[k],
+         for (k=0; k<cell->nlayers; k++)
+            if (cell->layers[k] != NULL)
+               gl_blitScale( cell->layers[k],
                      xcurs + 5., ycurs + gl_smallFont.h + 7.,
                      iar->dat.iar.iw, iar->dat.iar.ih, NULL );
 
          /* caption */
-         if (iar->dat.iar.images[pos].caption != NULL)
+         if (cell->caption != NULL)
             gl_printMidRaw( &gl_smallFont, iar->dat.iar.iw, xcurs + 5., ycurs + 5.,
-                     &fontcolour, -1., iar->dat.iar.images[pos].caption );
+                     &fontcolour, -1., cell->caption );
 
          /* quantity. */
-         if (iar->dat.iar.images[pos].quantity > 0) {
+         if (cell->quantity > 0) {
             /* Quantity number. */
             gl_printMax( &gl_smallFont, iar->dat.iar.iw,
                   xcurs + 5., ycurs + iar->dat.iar.ih + 4.,
-                  &fontcolour, "%d", iar->dat.iar.images[pos].quantity );
+                  &fontcolour, "%d", cell->quantity );
          }
 
          /* Slot type. */
-         if (iar->dat.iar.images[pos].slottype != NULL) {
+         if (cell->slottype != NULL) {
             /* Slot size letter. */
             gl_printMaxRaw( &gl_smallFont, iar->dat.iar.iw,
                   xcurs + iar->dat.iar.iw - 10., ycurs + iar->dat.iar.ih + 4.,
-                  &fontcolour, -1., iar->dat.iar.images[pos].slottype );
+                  &fontcolour, -1., cell->slottype );
          }
 
          /* outline */
@@ -299,7 +320,7 @@ static void iar_renderOverlay( Widget* iar, double bx, double by )
       y = by + iar->y + iar->dat.iar.alty;
 
       /* Draw alt text. */
-      alt = iar->dat.iar.images[iar->dat.iar.alt].alt;
+      alt = iar_getCell( iar, iar->dat.iar.alt )->alt;
       if (alt != NULL)
          toolkit_drawAltText( x, y, alt );
    }
@@ -890,6 +911,31 @@ int toolkit_unsetSelection( const unsigned int wid, const char *name )
 }
 
 
+/**
+ * @brief Gets the cells of an Image Array so they can be updated in place.
+ *
+ * Cells still waiting to be loaded have their load function set, setting it
+ *  again (after freeing what was filled in) has the cell reloaded when next
+ *  needed.
+ *
+ *    @param wid Window where image array is.
+ *    @param name Name of the image array.
+ *    @param[out] nelem Number of cells.
+ *    @return The cells of the image array or NULL if not found.
+ */
+ImageArrayCell* toolkit_getImageArrayCells( const unsigned int wid, const char *name, int *nelem )
+{
+   Widget *wgt = iar_getWidget( wid, name );
+   if (wgt == NULL) {
+      *nelem = 0;
+      return NULL;
+   }
+
+   *nelem = wgt->dat.iar.nelements;
+   return wgt->dat.iar.images;
+}
+
+
 /**
  * @brief Sets the accept function of an Image Array.
  *
@@ -22,6 +22,9 @@ typedef struct ImageArrayCell_ {
    /* Additional layers can be set if needed. */
    glTexture** layers; /**< Layers to be added. */
    int nlayers; /**< Total number of layers. */
+   /* Large lists can fill in cells lazily, only the caption is required. */
+   void (*load)( struct ImageArrayCell_ *cell ); /**< Fills in the rest of the cell when first needed, NULL once done. */
+   void *data; /**< Data for the load function. */
 } ImageArrayCell;
 
 
@@ -77,6 +80,7 @@ int toolkit_saveImageArrayData( const unsigned int wid, const char *name,
       iar_data_t *iar_data );
 int toolkit_unsetSelection( const unsigned int wid, const char *name );
 void toolkit_setImageArrayAccept( const unsigned int wid, const char *name, void (*fptr)(unsigned int,char*) );
+ImageArrayCell* toolkit_getImageArrayCells( const unsigned int wid, const char *name, int *nelem );
 int toolkit_getImageArrayVisibleElements( const unsigned int wid, const char *name );
 int toolkit_simImageArrayVisibleElements( int w, int h, int iw, int ih );
 
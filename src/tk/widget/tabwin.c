@@ -372,7 +372,7 @@ static void tab_render( Widget* tab, double bx, double by )
    Window *wdw;
 
    /** Get window. */
-   wdw = window_wget( tab->dat.tab.windows[ tab->dat.tab.active ] );
+   wdw = window_find( tab->dat.tab.windows[ tab->dat.tab.active ] );
    if (wdw == NULL) {
       WARN( _("Active window in widget '%s' not found in stack."), tab->name);
       return;
@@ -429,7 +429,7 @@ static void tab_renderOverlay( Widget* tab, double bx, double by )
    Window *wdw;
 
    /** Get window. */
-   wdw = window_wget( tab->dat.tab.windows[ tab->dat.tab.active ] );
+   wdw = window_find( tab->dat.tab.windows[ tab->dat.tab.active ] );
    if (wdw == NULL) {
       WARN( _("Active window in widget '%s' not found in stack."), tab->name);
       return;
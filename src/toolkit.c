@@ -6,9 +6,17 @@
  * @file toolkit.c
  *
  * @brief Handles windows and widgets.
+ *
+ * Windows are rendered to a framebuffer which is drawn again every frame
+ *  until they get marked dirty, which happens when they get input or are
+ *  accessed through their ID (which all the functions changing windows and
+ *  widgets do). Windows with custom widgets draw whatever they want every
+ *  frame so they are always rendered, as are windows without a border since
+ *  nothing guarantees they are opaque.
  */
 
 /** @cond */
+#include <math.h>
 #include <stdarg.h>
 
 #include "naev.h"
@@ -18,6 +26,7 @@
 
 #include "conf.h"
 #include "dialogue.h"
+#include "font.h"
 #include "input.h"
 #include "log.h"
 #include "opengl.h"
@@ -90,6 +99,15 @@ static Widget* toolkit_getFocus( Window *wdw );
 static void toolkit_expose( Window *wdw, int expose );
 /* render */
 static void window_renderBorder( Window* w );
+static void window_renderWidgets( Window *w );
+static int window_isCacheable( const Window *w );
+static int window_hasCustom( const Window *w );
+static int window_isDirty( const Window *w );
+static void window_clean( Window *w );
+static void window_cacheCreate( Window *w, int width, int height );
+static void window_cacheFree( Window *w );
+static void window_renderCache( Window *w );
+static void window_renderCached( const Window *w );
 /* Death. */
 static void widget_kill( Widget *wgt );
 static void window_kill( Window *wdw );
@@ -315,14 +333,31 @@ Widget* window_newWidget( Window* w, const char *name )
 Window* window_wget( const unsigned int wid )
 {
    Window *w;
-   if (windows == NULL) {
+   w = window_find( wid );
+   if (w == NULL) {
       WARN(_("Window '%u' not found in list!"), wid );
       return NULL;
    }
+   /* Whoever gets the window may change it. */
+   w->dirty = 1;
+   return w;
+}
+
+
+/**
+ * @brief Gets a Window by ID without warning or marking it dirty.
+ *
+ * Meant for rendering, which doesn't change the window.
+ *
+ *    @param wid ID of the window to get.
+ *    @return Window matching wid or NULL if not found.
+ */
+Window* window_find( const unsigned int wid )
+{
+   Window *w;
    for (w = windows; w != NULL; w = w->next)
       if (w->id == wid)
          return w;
-   WARN(_("Window '%u' not found in list!"), wid );
    return NULL;
 }
 
@@ -668,6 +703,7 @@ unsigned int window_createFlags( const char* name, const char *displayname,
    wdw->yrel         = -1.;
    wdw->flags        = flags;
    wdw->exposed      = !window_isFlag(wdw, WINDOW_NOFOCUS);
+   wdw->dirty        = 1;
 
    /* Dimensions. */
    wdw->w            = (w == -1) ? SCREEN_W : (double) w;
@@ -1052,6 +1088,7 @@ static void window_kill( Window *wdw )
       wgt = wgtkill->next;
       widget_kill(wgtkill);
    }
+   window_cacheFree( wdw );
    free(wdw);
 
    /* Clear key repeat, since toolkit could miss the keyup event. */
@@ -1208,7 +1245,7 @@ void toolkit_drawOutlineThick( int x, int y, int w, int h, int b,
    gl_vboActivateAttribOffset( toolkit_vbo, shaders.smooth.vertex, 0, 2, GL_SHORT, 0 );
    gl_vboActivateAttribOffset( toolkit_vbo, shaders.smooth.vertex_color,
          toolkit_vboColourOffset, 4, GL_FLOAT, 0 );
-   glDrawArrays( GL_TRIANGLE_STRIP, 0, 10 );
+   gl_drawArrays( GL_TRIANGLE_STRIP, 0, 10 );
    gl_endSmoothProgram();
 }
 
@@ -1261,7 +1298,7 @@ void toolkit_drawOutline( int x, int y, int w, int h, int b,
    gl_vboActivateAttribOffset( toolkit_vbo, shaders.smooth.vertex, 0, 2, GL_SHORT, 0 );
    gl_vboActivateAttribOffset( toolkit_vbo, shaders.smooth.vertex_color,
          toolkit_vboColourOffset, 4, GL_FLOAT, 0 );
-   glDrawArrays( GL_LINE_LOOP, 0, 4 );
+   gl_drawArrays( GL_LINE_LOOP, 0, 4 );
    gl_endSmoothProgram();
 }
 /**
@@ -1309,7 +1346,7 @@ void toolkit_drawRect( int x, int y, int w, int h,
    gl_vboActivateAttribOffset( toolkit_vbo, shaders.smooth.vertex, 0, 2, GL_SHORT, 0 );
    gl_vboActivateAttribOffset( toolkit_vbo, shaders.smooth.vertex_color,
          toolkit_vboColourOffset, 4, GL_FLOAT, 0 );
-   glDrawArrays( GL_TRIANGLE_STRIP, 0, 4 );
+   gl_drawArrays( GL_TRIANGLE_STRIP, 0, 4 );
    gl_endSmoothProgram();
 }
 
@@ -1352,7 +1389,7 @@ void toolkit_drawTriangle( int x1, int y1, int x2, int y2, int x3, int y3,
    gl_vboActivateAttribOffset( toolkit_vbo, shaders.smooth.vertex, 0, 2, GL_SHORT, 0 );
    gl_vboActivateAttribOffset( toolkit_vbo, shaders.smooth.vertex_color,
          toolkit_vboColourOffset, 4, GL_FLOAT, 0 );
-   glDrawArrays( GL_TRIANGLE_STRIP, 0, 3 );
+   gl_drawArrays( GL_TRIANGLE_STRIP, 0, 3 );
    gl_endSmoothProgram();
 }
 
@@ -1447,13 +1484,33 @@ static void window_renderBorder( Window* w )
  */
 void window_render( Window *w )
 {
-   double x, y, wid, hei;
-   Widget *wgt;
-
    /* Do not render dead windows. */
    if (window_isFlag( w, WINDOW_KILL ))
       return;
 
+   /* Reuse the last render when nothing changed. */
+   if (window_isCacheable( w )) {
+      if (window_isDirty( w ) || (w->fbo_tex == NULL))
+         window_renderCache( w );
+      window_renderCached( w );
+      return;
+   }
+
+   window_renderWidgets( w );
+   w->dirty = 0;
+}
+
+
+/**
+ * @brief Renders the border and widgets of a window.
+ *
+ *    @param w Window to render.
+ */
+static void window_renderWidgets( Window *w )
+{
+   double x, y, wid, hei;
+   Widget *wgt;
+
    /* position */
    x = w->x;
    y = w->y;
@@ -1485,6 +1542,204 @@ void window_render( Window *w )
 }
 
 
+/**
+ * @brief Checks whether a window can be rendered from its cache.
+ *
+ * Custom widgets draw whatever they want, and windows without a border
+ *  aren't necessarily opaque.
+ *
+ *    @param w Window to check.
+ *    @return 1 if the window can be cached.
+ */
+static int window_isCacheable( const Window *w )
+{
+   if (window_isFlag( w, WINDOW_NOBORDER ))
+      return 0;
+   return !window_hasCustom( w );
+}
+
+
+/**
+ * @brief Checks whether a window or the active tabs it renders have custom widgets.
+ *
+ *    @param w Window to check.
+ *    @return 1 if there are custom widgets.
+ */
+static int window_hasCustom( const Window *w )
+{
+   const Widget *wgt;
+   const Window *tw;
+
+   for (wgt=w->widgets; wgt!=NULL; wgt=wgt->next) {
+      if (wgt->type == WIDGET_CUST)
+         return 1;
+      if (wgt->type != WIDGET_TABBEDWINDOW)
+         continue;
+      tw = window_find( wgt->dat.tab.windows[ wgt->dat.tab.active ] );
+      if ((tw != NULL) && window_hasCustom( tw ))
+         return 1;
+   }
+   return 0;
+}
+
+
+/**
+ * @brief Checks whether a window or the active tabs it renders changed.
+ *
+ *    @param w Window to check.
+ *    @return 1 if the window has to be rendered again.
+ */
+static int window_isDirty( const Window *w )
+{
+   const Widget *wgt;
+   const Window *tw;
+
+   if (w->dirty)
+      return 1;
+   for (wgt=w->widgets; wgt!=NULL; wgt=wgt->next) {
+      if (wgt->type != WIDGET_TABBEDWINDOW)
+         continue;
+      tw = window_find( wgt->dat.tab.windows[ wgt->dat.tab.active ] );
+      if ((tw != NULL) && window_isDirty( tw ))
+         return 1;
+   }
+   return 0;
+}
+
+
+/**
+ * @brief Marks a window and the active tabs it renders as up to date.
+ *
+ *    @param w Window to mark.
+ */
+static void window_clean( Window *w )
+{
+   Widget *wgt;
+   Window *tw;
+
+   w->dirty = 0;
+   for (wgt=w->widgets; wgt!=NULL; wgt=wgt->next) {
+      if (wgt->type != WIDGET_TABBEDWINDOW)
+         continue;
+      tw = window_find( wgt->dat.tab.windows[ wgt->dat.tab.active ] );
+      if (tw != NULL)
+         window_clean( tw );
+   }
+}
+
+
+/**
+ * @brief Creates the framebuffer a window gets cached in.
+ *
+ *    @param w Window to create framebuffer of.
+ *    @param width Real width of the framebuffer.
+ *    @param height Real height of the framebuffer.
+ */
+static void window_cacheCreate( Window *w, int width, int height )
+{
+   GLenum status;
+
+   window_cacheFree( w );
+
+   w->fbo_tex = gl_loadImageData( NULL, width, height, 1, 1, NULL );
+   w->fbo_w   = width;
+   w->fbo_h   = height;
+
+   glGenFramebuffers( 1, &w->fbo );
+   glBindFramebuffer( GL_FRAMEBUFFER, w->fbo );
+   glFramebufferTexture2D( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, w->fbo_tex->texture, 0 );
+   status = glCheckFramebufferStatus( GL_FRAMEBUFFER );
+   if (status != GL_FRAMEBUFFER_COMPLETE)
+      WARN(_("Error setting up framebuffer!"));
+   glBindFramebuffer( GL_FRAMEBUFFER, gl_screen.current_fbo );
+
+   gl_checkErr();
+}
+
+
+/**
+ * @brief Frees the framebuffer a window is cached in.
+ *
+ *    @param w Window to free framebuffer of.
+ */
+static void window_cacheFree( Window *w )
+{
+   if (w->fbo_tex == NULL)
+      return;
+   glDeleteFramebuffers( 1, &w->fbo );
+   gl_freeTexture( w->fbo_tex );
+   w->fbo_tex = NULL;
+   gl_checkErr();
+}
+
+
+/**
+ * @brief Renders a window to its cache.
+ *
+ * The window is rendered in screen coordinates as usual, through a viewport
+ *  offset so that only the area it covers ends up on the framebuffer.
+ *
+ *    @param w Window to render.
+ */
+static void window_renderCache( Window *w )
+{
+   int x, y, width, height;
+
+   /* Real pixels covered by the window. */
+   x      = (int)floor( (w->x + gl_screen.x) / gl_screen.mxscale );
+   y      = (int)floor( (w->y + gl_screen.y) / gl_screen.myscale );
+   width  = (int)ceil( (w->x + w->w + gl_screen.x) / gl_screen.mxscale ) - x;
+   height = (int)ceil( (w->y + w->h + gl_screen.y) / gl_screen.myscale ) - y;
+   if ((w->fbo_tex == NULL) || (w->fbo_w != width) || (w->fbo_h != height))
+      window_cacheCreate( w, width, height );
+   w->fbo_x = x;
+   w->fbo_y = y;
+
+   /* Text queued by other windows goes on the screen. */
+   gl_printBatchFlush();
+
+   glBindFramebuffer( GL_FRAMEBUFFER, w->fbo );
+   glViewport( -x, -y, gl_screen.rw, gl_screen.rh );
+   gl_clipOffset( x, y );
+   glClearColor( 0., 0., 0., 0. );
+   glClear( GL_COLOR_BUFFER_BIT );
+   /* Accumulate alpha so the result is premultiplied. */
+   gl_blendFuncSeparate( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA );
+
+   window_renderWidgets( w );
+   gl_printBatchFlush();
+
+   gl_blendFuncSeparate( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA );
+   glClearColor( 0., 0., 0., 1. );
+   gl_clipOffset( 0, 0 );
+   glViewport( 0, 0, gl_screen.rw, gl_screen.rh );
+   glBindFramebuffer( GL_FRAMEBUFFER, gl_screen.current_fbo );
+
+   /* Glyphs still being generated are missing from the render. */
+   window_clean( w );
+   if (gl_fontPending())
+      w->dirty = 1;
+}
+
+
+/**
+ * @brief Draws the cache of a window.
+ *
+ *    @param w Window to draw.
+ */
+static void window_renderCached( const Window *w )
+{
+   gl_printBatchFlush();
+   gl_blendFuncSeparate( GL_ONE, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA );
+   gl_blitTexture( w->fbo_tex,
+         w->fbo_x * gl_screen.mxscale - gl_screen.x,
+         w->fbo_y * gl_screen.myscale - gl_screen.y,
+         w->fbo_w * gl_screen.mxscale, w->fbo_h * gl_screen.myscale,
+         0., 0., 1., 1., NULL, 0. );
+   gl_blendFuncSeparate( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA );
+}
+
+
 /**
  * @brief Renders the window overlays.
  *
@@ -1546,7 +1801,8 @@ void toolkit_render (void)
    if (!toolkit_isOpen())
       return;
 
-   /* Render base. */
+   /* Render base, batching the text of the widgets. */
+   gl_printBatchStart();
    for (w = windows; w!=NULL; w = w->next) {
       if (!window_isFlag(w, WINDOW_NORENDER) &&
             !window_isFlag(w, WINDOW_KILL)) {
@@ -1554,6 +1810,7 @@ void toolkit_render (void)
          window_renderOverlay(w);
       }
    }
+   gl_printBatchEnd();
 }
 
 
@@ -1585,6 +1842,9 @@ int toolkit_inputWindow( Window *wdw, SDL_Event *event, int purge )
    int ret;
    Widget *wgt;
 
+   /* Input can change how anything looks. */
+   wdw->dirty = 1;
+
    /* See if widget needs event. */
    for (wgt=wdw->widgets; wgt!=NULL; wgt=wgt->next) {
       if (wgt_isFlag( wgt, WGT_FLAG_RAWINPUT )) {
@@ -2147,6 +2407,7 @@ static void toolkit_expose( Window *wdw, int expose )
       return;
    else
       wdw->exposed = expose;
+   wdw->dirty = 1;
 
    if (expose)
       toolkit_focusSanitize( wdw );
@@ -2519,6 +2780,8 @@ void toolkit_reposition (void)
    int i, xorig, yorig, xdiff, ydiff;
 
    for (w = windows; w != NULL; w = w->next) {
+      w->dirty = 1;
+
       /* Fullscreen windows must always be full size, though their widgets
        * don't auto-scale. */
       if (window_isFlag( w, WINDOW_FULLSCREEN )) {
@@ -30,6 +30,7 @@
 #include "nstring.h"
 #include "nxml.h"
 #include "space.h"
+#include "strindex.h"
 
 
 /**
@@ -38,8 +39,10 @@
 typedef struct UniDiffData_ {
    char *name; /**< Name of the diff (read from XML). */
    char *filename; /**< Filename of the diff. */
+   xmlDocPtr doc; /**< Parsed diff, kept so applying doesn't have to read it again. */
 } UniDiffData_t;
 static UniDiffData_t *diff_available = NULL; /**< Available diffs. */
+static StrIndex diff_availableIndex; /**< Available diffs by name. */
 
 
 /**
@@ -137,6 +140,15 @@ typedef struct UniDiff_ {
 static UniDiff_t *diff_stack = NULL; /**< Currently applied universe diffs. */
 
 
+/*
+ * Batching of universe updates.
+ */
+static int diff_batch         = 0; /**< Depth of the batches diffs are being applied in. */
+static int diff_batchPresence = 0; /**< Presences have to be rebuilt at the end of the batch. */
+static int diff_batchEconomy  = 0; /**< Economy has to be recomputed at the end of the batch. */
+static int diff_jumpsChanged  = 0; /**< Jumps changed since presences were last rebuilt from scratch. */
+
+
 /*
  * Prototypes.
  */
@@ -151,6 +163,7 @@ static void diff_hunkFailed( UniDiff_t *diff, UniHunk_t *hunk );
 static void diff_hunkSuccess( UniDiff_t *diff, UniHunk_t *hunk );
 static void diff_cleanup( UniDiff_t *diff );
 static void diff_cleanupHunk( UniHunk_t *hunk );
+static void diff_updatePresences (void);
 /* Externed. */
 int diff_save( xmlTextWriterPtr writer ); /**< Used in save.c */
 int diff_load( xmlNodePtr parent ); /**< Used in save.c */
@@ -185,12 +198,19 @@ int diff_loadAvailable (void)
 
       diff = &array_grow(&diff_available);
       diff->filename = diff_files[i];
+      diff->doc      = doc;
       xmlr_attr_strd(node, "name", diff->name);
-      xmlFreeDoc(doc);
    }
    array_free( diff_files );
    array_shrink(&diff_available);
 
+   /* Index by name, the first one found wins like before. */
+   strindex_init( &diff_availableIndex );
+   for (i=0; i<array_size(diff_available); i++)
+      if ((diff_available[i].name != NULL) &&
+            (strindex_get( &diff_availableIndex, diff_available[i].name ) < 0))
+         strindex_add( &diff_availableIndex, diff_available[i].name, i );
+
    DEBUG( n_("Loaded %d UniDiff", "Loaded %d UniDiffs", array_size(diff_available) ), array_size(diff_available) );
 
    return 0;
@@ -235,45 +255,92 @@ static UniDiff_t* diff_get( const char *name )
  */
 int diff_apply( const char *name )
 {
-   xmlNodePtr node;
-   xmlDocPtr doc;
-   char *filename;
    int i;
 
    /* Check if already applied. */
    if (diff_isApplied(name))
       return 0;
 
-   filename = NULL;
-   for (i=0; i<array_size(diff_available); i++) {
-      if (strcmp(diff_available[i].name,name)==0) {
-         filename = diff_available[i].filename;
-         break;
-      }
-   }
-   if (filename == NULL) {
+   i = strindex_get( &diff_availableIndex, name );
+   if (i < 0) {
       WARN(_("UniDiff '%s' not found in %s!"), name, UNIDIFF_DATA_PATH);
       return -1;
    }
 
-   doc = xml_parsePhysFS( filename );
+   /* Apply it, the root was checked when loading. Hunks keep pointing to the
+    * nodes of the document, which is why it is kept around. */
+   diff_patch( diff_available[i].doc->xmlChildrenNode );
 
-   node = doc->xmlChildrenNode;
-   if (strcmp((char*)node->name,"unidiff")) {
-      ERR(_("Malformed unidiff file: missing root element 'unidiff'"));
-      return 0;
+   /* Re-compute the economy. */
+   if (diff_batch)
+      diff_batchEconomy = 1;
+   else {
+      economy_execQueued();
+      economy_initialiseCommodityPrices();
    }
 
-   /* Apply it. */
-   diff_patch( node );
+   return 0;
+}
 
-   xmlFreeDoc(doc);
 
-   /* Re-compute the economy. */
-   economy_execQueued();
-   economy_initialiseCommodityPrices();
+/**
+ * @brief Starts applying diffs in a batch.
+ *
+ * The universe wide updates done after each diff (presences, economy, overlay)
+ *  only depend on the final state of the universe, so they are deferred to
+ *  diff_batchEnd() and done only once for the whole batch. Batches can be
+ *  nested, the updates are done when the outermost one ends.
+ */
+void diff_batchStart (void)
+{
+   if (diff_batch == 0) {
+      diff_batchPresence = 0;
+      diff_batchEconomy  = 0;
+   }
+   diff_batch++;
+}
 
-   return 0;
+
+/**
+ * @brief Finishes applying diffs in a batch, doing the deferred updates.
+ */
+void diff_batchEnd (void)
+{
+   if (diff_batch <= 0) {
+      WARN(_("Ending a unidiff batch that wasn't started!"));
+      return;
+   }
+   diff_batch--;
+   if (diff_batch > 0)
+      return;
+
+   if (diff_batchPresence)
+      diff_updatePresences();
+   if (diff_batchEconomy) {
+      economy_execQueued();
+      economy_initialiseCommodityPrices();
+   }
+   if (diff_batchPresence || diff_batchEconomy)
+      ovr_refresh();
+
+   diff_batchPresence = 0;
+   diff_batchEconomy  = 0;
+}
+
+
+/**
+ * @brief Updates the presences after diffs changed the universe.
+ *
+ * Changes to the assets only redo the presence of the assets involved, but
+ *  the spill depends on the jumps, so changing them rebuilds everything.
+ */
+static void diff_updatePresences (void)
+{
+   if (diff_jumpsChanged)
+      space_reconstructPresences();
+   else
+      space_updatePresences();
+   diff_jumpsChanged = 0;
 }
 
 
@@ -719,9 +786,15 @@ static int diff_patch( xmlNodePtr parent )
       }
    }
 
+   /* Deferred to the end of the batch. */
+   if (diff_batch) {
+      diff_batchPresence |= univ_update;
+      return 0;
+   }
+
    /* Prune presences if necessary. */
    if (univ_update)
-      space_reconstructPresences();
+      diff_updatePresences();
 
    /* Update overlay map just in case. */
    ovr_refresh();
@@ -760,9 +833,11 @@ static int diff_patchHunk( UniHunk_t *hunk )
 
       /* Adding a Jump. */
       case HUNK_TYPE_JUMP_ADD:
+         diff_jumpsChanged = 1;
          return system_addJumpDiff( system_get(hunk->target.u.name), hunk->node );
       /* Removing a jump. */
       case HUNK_TYPE_JUMP_REMOVE:
+         diff_jumpsChanged = 1;
          return system_rmJump( system_get(hunk->target.u.name), hunk->u.name );
 
       /* Adding a tech. */
@@ -910,7 +985,10 @@ void diff_remove( const char *name )
 
    diff_removeDiff(diff);
 
-   economy_execQueued();
+   if (diff_batch)
+      diff_batchEconomy = 1;
+   else
+      economy_execQueued();
 }
 
 
@@ -935,9 +1013,11 @@ void diff_free (void)
    for (int i = 0; i < array_size(diff_available); i++) {
       free(diff_available[i].name);
       free(diff_available[i].filename);
+      xmlFreeDoc(diff_available[i].doc);
    }
    array_free(diff_available);
    diff_available = NULL;
+   strindex_free( &diff_availableIndex );
 }
 
 
@@ -1130,6 +1210,9 @@ int diff_load( xmlNodePtr parent )
 
    diff_clear();
 
+   /* Saves can have many diffs, only update the universe once. */
+   diff_batchStart();
+
    node = parent->xmlChildrenNode;
    do {
       if (xml_isNode(node,"diffs")) {
@@ -1147,6 +1230,8 @@ int diff_load( xmlNodePtr parent )
       }
    } while (xml_nextNode(node));
 
+   diff_batchEnd();
+
    return 0;
 
 }
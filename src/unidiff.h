@@ -16,6 +16,8 @@ NONNULL( 1 ) void diff_remove( const char *name );
 void diff_clear (void);
 void diff_free (void);
 NONNULL( 1 ) int diff_isApplied( const char *name );
+void diff_batchStart (void);
+void diff_batchEnd (void);
 
 
 #endif /* UNIDIFF_H */
@@ -223,19 +223,42 @@ size_t u8_charnum(const char *s, size_t offset)
     return charnum;
 }
 
+/* number of leading ASCII bytes in the first n bytes of s, checked a word
+   at a time */
+size_t u8_asciispan(const char *s, size_t n)
+{
+    size_t i = 0;
+    uint64_t w;
+
+    for (; i+sizeof(w) <= n; i += sizeof(w)) {
+        memcpy(&w, &s[i], sizeof(w));
+        if (w & 0x8080808080808080ULL)
+            break;
+    }
+    while ((i < n) && !(s[i] & 0x80))
+        i++;
+    return i;
+}
+
 /* number of characters in NUL-terminated string */
 size_t u8_strlen(const char *s)
 {
     size_t count = 0;
-    size_t i = 0, lasti;
+    size_t i = 0, n, run;
+
+    n = strlen(s);
+    while (i < n) {
+        /* Runs of ASCII are one character per byte. */
+        run = u8_asciispan(&s[i], n-i);
+        count += run;
+        i += run;
+        if (i >= n)
+            break;
 
-    while (1) {
-        lasti = i;
-        while (s[i] > 0)
+        /* Skip a multi-byte sequence. */
+        i++;
+        while ((i < n) && !isutf(s[i]))
             i++;
-        count += (i-lasti);
-        if (s[i++]==0) break;
-        (void)(isutf(s[++i]) || isutf(s[++i]) || ++i);
         count++;
     }
     return count;
@@ -35,6 +35,9 @@ size_t u8_offset(const char *str, size_t charnum);
 /* byte offset to character number */
 size_t u8_charnum(const char *s, size_t offset);
 
+/* number of leading ASCII bytes in the first n bytes of a string */
+size_t u8_asciispan(const char *s, size_t n);
+
 /* return next character, updating an index variable */
 uint32_t u8_nextchar(const char *s, size_t *i);
 
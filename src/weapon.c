@@ -25,9 +25,11 @@
 #include "ai.h"
 #include "camera.h"
 #include "collision.h"
+#include "conf.h"
 #include "explosion.h"
 #include "gui.h"
 #include "log.h"
+#include "memtrack.h"
 #include "nstring.h"
 #include "opengl.h"
 #include "pilot.h"
@@ -37,12 +39,15 @@
 
 
 #define weapon_isSmart(w)     (w->think != NULL) /**< Checks if the weapon w is smart. */
+#define WEAPON_GUIDE_PHASES   8 /**< Number of phases seeker guidance updates are staggered over. */
 
 /* Weapon status */
 #define WEAPON_STATUS_OK         0 /**< Weapon is fine */
 #define WEAPON_STATUS_JAMMED     1 /**< Got jammed */
 #define WEAPON_STATUS_UNJAMMED   2 /**< Survived jamming */
 
+#define WEAPON_POOL_CHUNK  256 /**< Number of weapons allocated at once. */
+
 
 /**
  * @struct Weapon
@@ -50,7 +55,7 @@
  * @brief In-game representation of a weapon.
  */
 typedef struct Weapon_ {
-   Solid *solid; /**< Actually has its own solid :) */
+   Solid solid; /**< Actually has its own solid :) */
    unsigned int ID; /**< Only used for beam weapons. */
 
    int faction; /**< faction of pilot that shot it */
@@ -80,14 +85,43 @@ typedef struct Weapon_ {
    void (*think)(struct Weapon_*, const double); /**< for the smart missiles */
 
    char status; /**< Weapon status - to check for jamming */
+   int moving; /**< Updated and waiting to be moved with the rest of the layer. */
+   int destroyed; /**< Destroyed and waiting to be removed from its layer. */
+
+   /* Seeker guidance, see think_seeker(). */
+   int guided; /**< Whether a guidance solution has been computed. */
+   double guide_timer; /**< Time left until the next guidance update. */
+   double guide_since; /**< Time since the last guidance update. */
+   double guide_dir; /**< Direction to the target at the last update. */
+   double guide_rate; /**< Rate the direction to the target was changing at. */
+   double guide_max; /**< Maximum turn rate allowed by tracking at the last update. */
 } Weapon;
 
 
+/**
+ * @brief Weapon queued for drawing, see weapons_render().
+ */
+typedef struct WeaponDraw_ {
+   Weapon *w; /**< Weapon to draw. */
+   GLuint tex; /**< Texture it is drawn with, 0 for beams. */
+   int i; /**< Position in the layer, keeps the order between weapons with the same texture. */
+} WeaponDraw;
+
+
 /* behind player layer */
 static Weapon** wbackLayer = NULL; /**< behind pilots */
 /* behind player layer */
 static Weapon** wfrontLayer = NULL; /**< in front of pilots, behind player */
 
+/* Storage. */
+static Weapon** weapon_poolChunks = NULL; /**< Chunks of contiguous weapon storage (array.h). */
+static Weapon** weapon_poolFree = NULL; /**< Free weapons in the chunks, used as a stack (array.h). */
+static unsigned int weapon_guideSeq = 0; /**< Seekers guided so far, used to stagger them. */
+static int weapon_deferRemove = 0; /**< Whether destroyed weapons stay in their layer until the update is done. */
+static int weapon_destroyed = 0; /**< Number of destroyed weapons waiting to be removed. */
+static Vector2d* weapon_aheadPos = NULL; /**< Simulated and drawn position of each weapon while drawing ahead (array.h). */
+static WeaponDraw* weapon_drawList = NULL; /**< Weapons on screen in drawing order (array.h). */
+
 /* Graphics. */
 static gl_vbo  *weapon_vbo     = NULL; /**< Weapon VBO. */
 static GLfloat *weapon_vboData = NULL; /**< Data of weapon VBO. */
@@ -96,12 +130,15 @@ static size_t weapon_vboSize   = 0; /**< Size of the VBO. */
 
 /* Internal stuff. */
 static unsigned int beam_idgen = 0; /**< Beam identifier generator. */
+static int *weapon_candidates = NULL; /**< Pilots that may collide with the weapon being updated. */
+static SolidBatch weapon_batch; /**< Weapons being moved together. */
 
 
 /*
  * Prototypes
  */
 /* Creation. */
+static Weapon* weapon_alloc (void);
 static double weapon_aimTurret( const Outfit *outfit, const Pilot *parent,
       const Pilot *pilot_target, const Vector2d *pos, const Vector2d *vel, double dir,
       double swivel, double time );
@@ -114,9 +151,18 @@ static Weapon* weapon_create( const Outfit* outfit, double T,
       const Pilot *parent, const unsigned int target, double time );
 /* Updating. */
 static void weapon_render( Weapon* w, const double dt );
+static int weapon_cmpDraw( const void *ptr1, const void *ptr2 );
 static void weapons_updateLayer( const double dt, const WeaponLayer layer );
 static void weapon_update( Weapon* w, const double dt, WeaponLayer layer );
+static void weapon_move( Weapon** wlayer, const double dt );
+static void weapon_compactLayer( Weapon*** wlayer );
+static void weapon_renderAheadLayer( Weapon** wlayer, int *n, double t );
+static void weapon_renderAheadEndLayer( Weapon** wlayer, int *n );
 static void weapon_sample_trail( Weapon* w );
+static void weapon_collidePilot( Weapon* w, Pilot* p, glTexture* gfx,
+      CollPoly* polygon, int usePoly, const double dt, WeaponLayer layer, int *hit );
+static int weapon_sweepPilot( Weapon* w, Pilot* p, glTexture* gfx,
+      const double dt, Vector2d* crash );
 /* Destruction. */
 static void weapon_destroy( Weapon* w, WeaponLayer layer );
 static void weapon_free( Weapon* w );
@@ -146,6 +192,8 @@ void weapon_init (void)
 {
    wfrontLayer = array_create(Weapon*);
    wbackLayer  = array_create(Weapon*);
+   weapon_poolChunks = array_create(Weapon*);
+   weapon_poolFree   = array_create_size(Weapon*, WEAPON_POOL_CHUNK);
 }
 
 
@@ -182,12 +230,12 @@ void weapon_minimap( const double res, const double w,
       wp = wbackLayer[i];
 
       /* Make sure is in range. */
-      if (!pilot_inRange( player.p, wp->solid->pos.x, wp->solid->pos.y ))
+      if (!pilot_inRange( player.p, wp->solid.pos.x, wp->solid.pos.y ))
          continue;
 
       /* Get radar position. */
-      x = (wp->solid->pos.x - player.p->solid->pos.x) / res;
-      y = (wp->solid->pos.y - player.p->solid->pos.y) / res;
+      x = (wp->solid.pos.x - player.p->solid->pos.x) / res;
+      y = (wp->solid.pos.y - player.p->solid->pos.y) / res;
 
       /* Make sure in range. */
       if (shape==RADAR_RECT && (ABS(x)>w/2. || ABS(y)>h/2.))
@@ -228,12 +276,12 @@ void weapon_minimap( const double res, const double w,
       wp = wfrontLayer[i];
 
       /* Make sure is in range. */
-      if (!pilot_inRange( player.p, wp->solid->pos.x, wp->solid->pos.y ))
+      if (!pilot_inRange( player.p, wp->solid.pos.x, wp->solid.pos.y ))
          continue;
 
       /* Get radar position. */
-      x = (wp->solid->pos.x - player.p->solid->pos.x) / res;
-      y = (wp->solid->pos.y - player.p->solid->pos.y) / res;
+      x = (wp->solid.pos.x - player.p->solid->pos.x) / res;
+      y = (wp->solid.pos.y - player.p->solid->pos.y) / res;
 
       /* Make sure in range. */
       if (shape==RADAR_RECT && (ABS(x)>w/2. || ABS(y)>h/2.))
@@ -274,7 +322,7 @@ void weapon_minimap( const double res, const double w,
       gl_beginSmoothProgram(gl_view_matrix);
       gl_vboActivateAttribOffset( weapon_vbo, shaders.smooth.vertex, 0, 2, GL_FLOAT, 0 );
       gl_vboActivateAttribOffset( weapon_vbo, shaders.smooth.vertex_color, offset * sizeof(GLfloat), 4, GL_FLOAT, 0 );
-      glDrawArrays( GL_POINTS, 0, p );
+      gl_drawArrays( GL_POINTS, 0, p );
       gl_endSmoothProgram();
    }
 }
@@ -285,7 +333,7 @@ void weapon_minimap( const double res, const double w,
  */
 static void weapon_setThrust( Weapon *w, double thrust )
 {
-   w->solid->thrust = thrust;
+   w->solid.thrust = thrust;
 }
 
 
@@ -294,7 +342,7 @@ static void weapon_setThrust( Weapon *w, double thrust )
  */
 static void weapon_setTurn( Weapon *w, double turn )
 {
-   w->solid->dir_vel = turn;
+   w->solid.dir_vel = turn;
 }
 
 
@@ -306,10 +354,10 @@ static void weapon_setTurn( Weapon *w, double turn )
  */
 static void think_seeker( Weapon* w, const double dt )
 {
-   double diff;
+   double diff, dir, period;
    Pilot *p;
    Vector2d v;
-   double t, turn_max;
+   double t;
    double ewtrack;
 
    if (w->target == w->parent)
@@ -322,8 +370,6 @@ static void think_seeker( Weapon* w, const double dt )
       return;
    }
 
-   ewtrack = pilot_ewWeaponTrack( pilot_get(w->parent), p, w->outfit->u.amm.resist );
-
    /* Handle by status. */
    switch (w->status) {
 
@@ -331,30 +377,51 @@ static void think_seeker( Weapon* w, const double dt )
       /* Purpose fallthrough */
       case WEAPON_STATUS_UNJAMMED: /* Work as expected */
 
-         /* Smart seekers take into account ship velocity. */
-         if (w->outfit->u.amm.ai == AMMO_AI_SMART) {
-
-            /* Calculate time to reach target. */
-            vect_cset( &v, p->solid->pos.x - w->solid->pos.x,
-                  p->solid->pos.y - w->solid->pos.y );
-            t = vect_odist( &v ) / w->outfit->u.amm.speed;
-
-            /* Calculate target's movement. */
-            vect_cset( &v, v.x + t*(p->solid->vel.x - w->solid->vel.x),
-                  v.y + t*(p->solid->vel.y - w->solid->vel.y) );
+         /* The target direction and tracking are only recomputed at the
+          * guidance rate. Missiles are staggered by launch order instead of
+          * randomly so it stays deterministic. */
+         period = (conf.seeker_rate > 0.) ? 1. / conf.seeker_rate : 0.;
+         w->guide_timer -= dt;
+         w->guide_since += dt;
+         if (!w->guided || (w->guide_timer <= 0.)) {
+            ewtrack = pilot_ewWeaponTrack( pilot_get(w->parent), p, w->outfit->u.amm.resist );
+
+            /* Smart seekers take into account ship velocity. */
+            if (w->outfit->u.amm.ai == AMMO_AI_SMART) {
+
+               /* Calculate time to reach target. */
+               vect_csetmin( &v, p->solid->pos.x - w->solid.pos.x,
+                     p->solid->pos.y - w->solid.pos.y );
+               t = vect_odist( &v ) / w->outfit->u.amm.speed;
+
+               /* Get the angle to where the target will be. */
+               dir = ANGLE( v.x + t*(p->solid->vel.x - w->solid.vel.x),
+                     v.y + t*(p->solid->vel.y - w->solid.vel.y) );
+            }
+            /* Other seekers are simplistic. */
+            else
+               dir = vect_angle(&w->solid.pos, &p->solid->pos); /* Get angle to target pos */
 
-            /* Get the angle now. */
-            diff = angle_diff(w->solid->dir, VANGLE(v) );
-         }
-         /* Other seekers are simplistic. */
-         else {
-            diff = angle_diff(w->solid->dir, /* Get angle to target pos */
-                  vect_angle(&w->solid->pos, &p->solid->pos));
+            /* Estimate how fast the direction changes to interpolate it. */
+            if (w->guided && (w->guide_since > 0.))
+               w->guide_rate = angle_diff( w->guide_dir, dir ) / w->guide_since;
+            else {
+               w->guide_rate  = 0.;
+               w->guide_timer = period * (double)(weapon_guideSeq++ % WEAPON_GUIDE_PHASES)
+                     / (double)WEAPON_GUIDE_PHASES;
+            }
+            w->guide_dir   = dir;
+            w->guide_max   = w->outfit->u.amm.turn * ewtrack;
+            w->guide_since = 0.;
+            w->guided      = 1;
+            w->guide_timer += period;
+            if (w->guide_timer <= 0.)
+               w->guide_timer = period;
          }
 
          /* Set turn. */
-         turn_max = w->outfit->u.amm.turn * ewtrack;
-         weapon_setTurn( w, CLAMP( -turn_max, turn_max,
+         diff = angle_diff( w->solid.dir, w->guide_dir + w->guide_rate * w->guide_since );
+         weapon_setTurn( w, CLAMP( -w->guide_max, w->guide_max,
                   10 * diff * w->outfit->u.amm.turn ));
          break;
 
@@ -369,10 +436,10 @@ static void think_seeker( Weapon* w, const double dt )
 
    /* Limit speed here */
    w->real_vel = MIN( w->outfit->u.amm.speed, w->real_vel + w->outfit->u.amm.thrust*dt );
-   vect_pset( &w->solid->vel, /* ewtrack * */ w->real_vel, w->solid->dir );
+   vect_pset( &w->solid.vel, /* ewtrack * */ w->real_vel, w->solid.dir );
 
    /* Modulate max speed. */
-   //w->solid->speed_max = w->outfit->u.amm.speed * ewtrack;
+   //w->solid.speed_max = w->outfit->u.amm.speed * ewtrack;
 }
 
 
@@ -409,13 +476,13 @@ static void think_beam( Weapon* w, const double dt )
 
    /* Use mount position. */
    pilot_getMount( p, w->mount, &v );
-   w->solid->pos.x = p->solid->pos.x + v.x;
-   w->solid->pos.y = p->solid->pos.y + v.y;
+   w->solid.pos.x = p->solid->pos.x + v.x;
+   w->solid.pos.y = p->solid->pos.y + v.y;
 
    /* Handle aiming. */
    switch (w->outfit->type) {
       case OUTFIT_TYPE_BEAM:
-         w->solid->dir = p->solid->dir;
+         w->solid.dir = p->solid->dir;
          break;
 
       case OUTFIT_TYPE_TURRET_BEAM:
@@ -428,15 +495,15 @@ static void think_beam( Weapon* w, const double dt )
                field = &cur_system->asteroids[p->nav_anchor];
                ast = &field->asteroids[p->nav_asteroid];
 
-               diff = angle_diff(w->solid->dir, /* Get angle to target pos */
-                     vect_angle(&w->solid->pos, &ast->pos));
+               diff = angle_diff(w->solid.dir, /* Get angle to target pos */
+                     vect_angle(&w->solid.pos, &ast->pos));
             }
             else
-               diff = angle_diff(w->solid->dir, p->solid->dir);
+               diff = angle_diff(w->solid.dir, p->solid->dir);
          }
          else
-            diff = angle_diff(w->solid->dir, /* Get angle to target pos */
-                  vect_angle(&w->solid->pos, &t->solid->pos));
+            diff = angle_diff(w->solid.dir, /* Get angle to target pos */
+                  vect_angle(&w->solid.pos, &t->solid->pos));
 
          weapon_setTurn( w, CLAMP( -w->outfit->u.bem.turn, w->outfit->u.bem.turn,
                   10 * diff *  w->outfit->u.bem.turn ));
@@ -455,8 +522,43 @@ static void think_beam( Weapon* w, const double dt )
  */
 void weapons_update( const double dt )
 {
+   /* Weapons destroyed while updating are removed all at once at the end,
+    * instead of erasing them from the layer one by one. */
+   weapon_deferRemove = 1;
    weapons_updateLayer(dt,WEAPON_LAYER_BG);
    weapons_updateLayer(dt,WEAPON_LAYER_FG);
+   weapon_deferRemove = 0;
+
+   if (weapon_destroyed > 0) {
+      weapon_compactLayer( &wbackLayer );
+      weapon_compactLayer( &wfrontLayer );
+      weapon_destroyed = 0;
+   }
+}
+
+
+/**
+ * @brief Frees the destroyed weapons of a layer and removes them.
+ *
+ * The order of the remaining weapons is kept so they are drawn the same way.
+ *
+ *    @param wlayer Layer to compact.
+ */
+static void weapon_compactLayer( Weapon*** wlayer )
+{
+   int i, n;
+   Weapon *w;
+
+   n = 0;
+   for (i=0; i<array_size(*wlayer); i++) {
+      w = (*wlayer)[i];
+      if (w->destroyed) {
+         weapon_free(w);
+         continue;
+      }
+      (*wlayer)[n++] = w;
+   }
+   array_resize( wlayer, n );
 }
 
 
@@ -489,10 +591,13 @@ static void weapons_updateLayer( const double dt, const WeaponLayer layer )
          return;
    }
 
-   i = 0;
-   while (i < array_size(wlayer)) {
+   for (i=0; i<array_size(wlayer); i++) {
       w = wlayer[i];
 
+      /* Already destroyed this frame, removed in weapons_update(). */
+      if (w->destroyed)
+         continue;
+
       switch (w->outfit->type) {
 
          /* most missiles behave the same */
@@ -509,17 +614,17 @@ static void weapons_updateLayer( const double dt, const WeaponLayer layer )
                   spfx = outfit_spfxShield(w->outfit);
                /* Add death sprite if needed. */
                if (spfx != -1) {
-                  spfx_add( spfx, w->solid->pos.x, w->solid->pos.y,
-                        w->solid->vel.x, w->solid->vel.y,
+                  spfx_add( spfx, w->solid.pos.x, w->solid.pos.y,
+                        w->solid.vel.x, w->solid.vel.y,
                         SPFX_LAYER_MIDDLE ); /* presume middle. */
                   /* Add sound if explodes and has it. */
                   s = outfit_soundHit(w->outfit);
                   if (s != -1)
                      w->voice = sound_playPos(s,
-                           w->solid->pos.x,
-                           w->solid->pos.y,
-                           w->solid->vel.x,
-                           w->solid->vel.y);
+                           w->solid.pos.x,
+                           w->solid.pos.y,
+                           w->solid.vel.x,
+                           w->solid.vel.y);
                }
                weapon_destroy(w,layer);
                break;
@@ -539,17 +644,17 @@ static void weapons_updateLayer( const double dt, const WeaponLayer layer )
                   spfx = outfit_spfxShield(w->outfit);
                /* Add death sprite if needed. */
                if (spfx != -1) {
-                  spfx_add( spfx, w->solid->pos.x, w->solid->pos.y,
-                        w->solid->vel.x, w->solid->vel.y,
+                  spfx_add( spfx, w->solid.pos.x, w->solid.pos.y,
+                        w->solid.vel.x, w->solid.vel.y,
                         SPFX_LAYER_MIDDLE ); /* presume middle. */
                   /* Add sound if explodes and has it. */
                   s = outfit_soundHit(w->outfit);
                   if (s != -1)
                      w->voice = sound_playPos(s,
-                           w->solid->pos.x,
-                           w->solid->pos.y,
-                           w->solid->vel.x,
-                           w->solid->vel.y);
+                           w->solid.pos.x,
+                           w->solid.pos.y,
+                           w->solid.vel.x,
+                           w->solid.vel.y);
                }
                weapon_destroy(w,layer);
                break;
@@ -585,16 +690,57 @@ static void weapons_updateLayer( const double dt, const WeaponLayer layer )
             break;
       }
 
-      /* Out of bounds, loop is over. */
-      if (i >= array_size(wlayer))
-         break;
+      if (w->destroyed)
+         continue;
 
-      /* Only increment if weapon wasn't deleted. */
-      if (w == wlayer[i]) {
-         weapon_update(w,dt,layer);
-         if ((i < array_size(wlayer)) && (w == wlayer[i]))
-            i++;
-      }
+      weapon_update(w,dt,layer);
+
+      /* New weapons may have reallocated the layer. */
+      wlayer = (layer==WEAPON_LAYER_BG) ? wbackLayer : wfrontLayer;
+   }
+
+   /* Move what's left, the layer may have been reallocated. */
+   weapon_move( (layer==WEAPON_LAYER_BG) ? wbackLayer : wfrontLayer, dt );
+}
+
+
+/**
+ * @brief Moves the weapons of a layer that have been updated.
+ *
+ * Done once the whole layer has been updated so the weapons can be moved
+ *  together with solid_batchUpdate(), as destroyed weapons are gone from the
+ *  layer by then.
+ *
+ *    @param wlayer Layer to move.
+ *    @param dt Current delta tick.
+ */
+static void weapon_move( Weapon** wlayer, const double dt )
+{
+   int i;
+   Weapon *w;
+
+   for (i=0; i<array_size(wlayer); i++) {
+      w = wlayer[i];
+      if (!w->moving)
+         continue;
+      if (solid_batchAdd( &weapon_batch, &w->solid ) != 0)
+         (*w->solid.update)(&w->solid, dt);
+   }
+   solid_batchUpdate( &weapon_batch, dt );
+
+   for (i=0; i<array_size(wlayer); i++) {
+      w = wlayer[i];
+      if (!w->moving)
+         continue;
+      w->moving = 0;
+
+      /* Update the sound. */
+      sound_updatePos(w->voice, w->solid.pos.x, w->solid.pos.y,
+            w->solid.vel.x, w->solid.vel.y);
+
+      /* Update the trail. */
+      if (w->trail != NULL)
+         weapon_sample_trail( w );
    }
 }
 
@@ -608,6 +754,10 @@ static void weapons_updateLayer( const double dt, const WeaponLayer layer )
 void weapons_render( const WeaponLayer layer, const double dt )
 {
    Weapon** wlayer;
+   Weapon *w;
+   WeaponDraw *d;
+   const glTexture *gfx;
+   double x1, y1, x2, y2, r;
    int i;
 
    switch (layer) {
@@ -623,8 +773,144 @@ void weapons_render( const WeaponLayer layer, const double dt )
          return;
    }
 
-   for (i=0; i<array_size(wlayer); i++)
-      weapon_render( wlayer[i], dt );
+   /* Only sprites on screen are drawn, beams span their whole range and are
+    * always drawn. */
+   cam_getBounds( &x1, &y1, &x2, &y2 );
+   if (weapon_drawList == NULL)
+      weapon_drawList = array_create( WeaponDraw );
+   array_resize( &weapon_drawList, 0 );
+   for (i=0; i<array_size(wlayer); i++) {
+      w = wlayer[i];
+      gfx = outfit_isBeam(w->outfit) ? NULL : outfit_gfx(w->outfit);
+      if (gfx != NULL) {
+         r = MAX( gfx->sw, gfx->sh ) / 2.;
+         if ((w->solid.pos.x + r < x1) || (w->solid.pos.x - r > x2) ||
+               (w->solid.pos.y + r < y1) || (w->solid.pos.y - r > y2))
+            continue;
+      }
+      d = &array_grow( &weapon_drawList );
+      d->w   = w;
+      d->tex = (gfx != NULL) ? gfx->texture : 0;
+      d->i   = i;
+   }
+
+   /* Grouped by graphic so they end up in few draws. */
+   qsort( weapon_drawList, array_size(weapon_drawList), sizeof(WeaponDraw), weapon_cmpDraw );
+
+   gl_batchStart();
+   for (i=0; i<array_size(weapon_drawList); i++)
+      weapon_render( weapon_drawList[i].w, dt );
+   gl_batchEnd();
+}
+
+
+/**
+ * @brief Compares weapons by the texture they are drawn with.
+ */
+static int weapon_cmpDraw( const void *ptr1, const void *ptr2 )
+{
+   const WeaponDraw *d1, *d2;
+
+   d1 = (const WeaponDraw*) ptr1;
+   d2 = (const WeaponDraw*) ptr2;
+
+   if (d1->tex != d2->tex)
+      return (d1->tex < d2->tex) ? -1 : 1;
+   return d1->i - d2->i;
+}
+
+
+/**
+ * @brief Moves the weapons to where they will be when drawing ahead of the
+ *        simulation, see pilots_renderAhead().
+ *
+ * Has to be undone with weapons_renderAheadEnd() once drawn.
+ *
+ *    @param t Game time to draw ahead by.
+ */
+void weapons_renderAhead( double t )
+{
+   int n;
+
+   if (t == 0.) {
+      array_resize( &weapon_aheadPos, 0 );
+      return;
+   }
+
+   n = array_size(wbackLayer) + array_size(wfrontLayer);
+   if (weapon_aheadPos == NULL)
+      weapon_aheadPos = array_create_size( Vector2d, 2*n );
+   array_resize( &weapon_aheadPos, 2*n );
+   n = 0;
+   weapon_renderAheadLayer( wbackLayer, &n, t );
+   weapon_renderAheadLayer( wfrontLayer, &n, t );
+}
+
+
+/**
+ * @brief Moves the weapons of a layer ahead.
+ *
+ *    @param wlayer Layer to move.
+ *    @param[in,out] n Weapons moved so far.
+ *    @param t Game time to draw ahead by.
+ */
+static void weapon_renderAheadLayer( Weapon** wlayer, int *n, double t )
+{
+   int i;
+   Weapon *w;
+   Pilot *p;
+   const Vector2d *vel;
+
+   for (i=0; i<array_size(wlayer); i++) {
+      w = wlayer[i];
+      vel = &w->solid.vel;
+      /* Beams stick to their mount, so they move with the parent. */
+      if (outfit_isBeam(w->outfit)) {
+         p = pilot_get( w->parent );
+         if (p != NULL)
+            vel = &p->solid->vel;
+      }
+      weapon_aheadPos[2*(*n)] = w->solid.pos;
+      w->solid.pos.x += vel->x * t;
+      w->solid.pos.y += vel->y * t;
+      weapon_aheadPos[2*(*n)+1] = w->solid.pos;
+      (*n)++;
+   }
+}
+
+
+/**
+ * @brief Puts the weapons back at their simulated position after drawing.
+ */
+void weapons_renderAheadEnd (void)
+{
+   int n;
+
+   n = 0;
+   weapon_renderAheadEndLayer( wbackLayer, &n );
+   weapon_renderAheadEndLayer( wfrontLayer, &n );
+   array_resize( &weapon_aheadPos, 0 );
+}
+
+
+/**
+ * @brief Puts the weapons of a layer back at their simulated position.
+ *
+ *    @param wlayer Layer to move back.
+ *    @param[in,out] n Weapons moved back so far.
+ */
+static void weapon_renderAheadEndLayer( Weapon** wlayer, int *n )
+{
+   int i;
+   Weapon *w;
+
+   for (i=0; (i<array_size(wlayer)) && (2*(*n) < array_size(weapon_aheadPos)); i++) {
+      w = wlayer[i];
+      if ((w->solid.pos.x == weapon_aheadPos[2*(*n)+1].x) &&
+            (w->solid.pos.y == weapon_aheadPos[2*(*n)+1].y))
+         w->solid.pos = weapon_aheadPos[2*(*n)];
+      (*n)++;
+   }
 }
 
 
@@ -635,17 +921,20 @@ static void weapon_renderBeam( Weapon* w, const double dt ) {
    /* Animation. */
    w->anim += dt;
 
+   /* Sprites queued so far have to be drawn first. */
+   gl_batchFlush();
+
    /* Load GLSL program */
-   glUseProgram(shaders.beam.program);
+   gl_useProgram(shaders.beam.program);
 
    /* Zoom. */
    z = cam_getZoom();
 
    /* Position. */
-   gl_gameToScreenCoords( &x, &y, w->solid->pos.x, w->solid->pos.y );
+   gl_gameToScreenCoords( &x, &y, w->solid.pos.x, w->solid.pos.y );
 
    projection = gl_Matrix4_Translate( gl_view_matrix, x, y, 0. );
-   projection = gl_Matrix4_Rotate2d( projection, w->solid->dir );
+   projection = gl_Matrix4_Rotate2d( projection, w->solid.dir );
    projection = gl_Matrix4_Scale( projection, w->outfit->u.bem.range*z,w->outfit->u.bem.width * z, 1 );
    projection = gl_Matrix4_Translate( projection, 0., -0.5, 0. );
 
@@ -666,11 +955,11 @@ static void weapon_renderBeam( Weapon* w, const double dt ) {
       glUniformSubroutinesuiv( GL_FRAGMENT_SHADER, 1, &w->outfit->u.bem.shader );
 
    /* Draw. */
-   glDrawArrays( GL_TRIANGLE_STRIP, 0, 4 );
+   gl_drawArrays( GL_TRIANGLE_STRIP, 0, 4 );
 
    /* Clear state. */
    glDisableVertexAttribArray( shaders.beam.vertex );
-   glUseProgram(0);
+   gl_useProgram(0);
 
    /* anything failed? */
    gl_checkErr();
@@ -715,10 +1004,10 @@ static void weapon_render( Weapon* w, const double dt )
             if (outfit_isBolt(w->outfit) && w->outfit->u.blt.gfx_end)
                gl_blitSpriteInterpolate( gfx, w->outfit->u.blt.gfx_end,
                      w->timer / w->life,
-                     w->solid->pos.x, w->solid->pos.y,
+                     w->solid.pos.x, w->solid.pos.y,
                      w->sprite % (int)gfx->sx, w->sprite / (int)gfx->sx, &c );
             else
-               gl_blitSprite( gfx, w->solid->pos.x, w->solid->pos.y,
+               gl_blitSprite( gfx, w->solid.pos.x, w->solid.pos.y,
                      w->sprite % (int)gfx->sx, w->sprite / (int)gfx->sx, &c );
          }
          /* Outfit faces direction. */
@@ -726,9 +1015,9 @@ static void weapon_render( Weapon* w, const double dt )
             if (outfit_isBolt(w->outfit) && w->outfit->u.blt.gfx_end)
                gl_blitSpriteInterpolate( gfx, w->outfit->u.blt.gfx_end,
                      w->timer / w->life,
-                     w->solid->pos.x, w->solid->pos.y, w->sx, w->sy, &c );
+                     w->solid.pos.x, w->solid.pos.y, w->sx, w->sy, &c );
             else
-               gl_blitSprite( gfx, w->solid->pos.x, w->solid->pos.y, w->sx, w->sy, &c );
+               gl_blitSprite( gfx, w->solid.pos.x, w->solid.pos.y, w->sx, w->sy, &c );
          }
          break;
 
@@ -825,8 +1114,9 @@ static int weapon_checkCanHit( Weapon* w, Pilot *p )
  */
 static void weapon_update( Weapon* w, const double dt, WeaponLayer layer )
 {
-   int i, j, b, psx, psy, k, n;
-   unsigned int coll, usePoly=1;
+   int i, j, b, n, hit;
+   unsigned int usePoly=1;
+   double ex, ey, x1, y1, x2, y2;
    glTexture *gfx;
    CollPoly *plg, *polygon;
    Vector2d crash[2];
@@ -838,13 +1128,13 @@ static void weapon_update( Weapon* w, const double dt, WeaponLayer layer )
 
    gfx = NULL;
    polygon = NULL;
-   pilot_stack = pilot_getAll();
+   hit = 0;
 
    /* Get the sprite direction to speed up calculations. */
    b     = outfit_isBeam(w->outfit);
    if (!b) {
       gfx = outfit_gfx(w->outfit);
-      gl_getSpriteFromDir( &w->sx, &w->sy, gfx, w->solid->dir );
+      gl_getSpriteFromDir( &w->sx, &w->sy, gfx, w->solid.dir );
       n = gfx->sx * w->sy + w->sx;
       plg = outfit_plg(w->outfit);
       polygon = &plg[n];
@@ -860,131 +1150,90 @@ static void weapon_update( Weapon* w, const double dt, WeaponLayer layer )
       }
    }
 
-   for (i=0; i<array_size(pilot_stack); i++) {
-      p = pilot_stack[i];
+   /* Bounding box of the weapon for the broadphase, beams use their segment. */
+   if (b) {
+      x1 = w->solid.pos.x;
+      y1 = w->solid.pos.y;
+      x2 = w->solid.pos.x + w->outfit->u.bem.range * cos(w->solid.dir);
+      y2 = w->solid.pos.y + w->outfit->u.bem.range * sin(w->solid.dir);
+   }
+   else {
+      x1 = w->solid.pos.x - gfx->sw/2. - 1.;
+      y1 = w->solid.pos.y - gfx->sh/2. - 1.;
+      x2 = w->solid.pos.x + gfx->sw/2. + 1.;
+      y2 = w->solid.pos.y + gfx->sh/2. + 1.;
 
-      psx = pilot_stack[i]->tsx;
-      psy = pilot_stack[i]->tsy;
+      /* Bolts are swept along where they move this update. */
+      if (outfit_isBolt(w->outfit)) {
+         ex = w->solid.vel.x * dt;
+         ey = w->solid.vel.y * dt;
+         x1 += MIN( ex, 0. );
+         y1 += MIN( ey, 0. );
+         x2 += MAX( ex, 0. );
+         y2 += MAX( ey, 0. );
+      }
+   }
 
-      if (w->parent == pilot_stack[i]->id) continue; /* pilot is self */
+   /* Smart weapons only collide with their target. */
+   if (!b && weapon_isSmart(w)) {
+      p = pilot_get(w->target);
+      if ((p != NULL) && (w->parent != p->id)) {
+         weapon_collidePilot( w, p, gfx, polygon, usePoly, dt, layer, &hit );
+         if (hit)
+            return; /* Weapon is destroyed. */
+      }
+   }
+   else {
+      /* Only look at the pilots near the weapon. */
+      if (b)
+         pilot_collideQuerySegment( &weapon_candidates, x1, y1, x2, y2 );
+      else
+         pilot_collideQuery( &weapon_candidates, x1, y1, x2, y2 );
 
-      /* See if the ship has a collision polygon. */
-      if (array_size(p->ship->polygon) == 0)
-         usePoly = 0;
+      for (i=0; i<array_size(weapon_candidates); i++) {
+         /* Stack can grow while hitting, so get it again. */
+         pilot_stack = pilot_getAll();
+         if (weapon_candidates[i] >= array_size(pilot_stack))
+            continue;
+         p = pilot_stack[ weapon_candidates[i] ];
 
-      /* Beam weapons have special collisions. */
-      if (b) {
-         /* Check for collision. */
-         if (weapon_checkCanHit(w,p)) {
-            if (usePoly) {
-               k = p->ship->gfx_space->sx * psy + psx;
-               coll = CollideLinePolygon( &w->solid->pos, w->solid->dir,
-                     w->outfit->u.bem.range, &p->ship->polygon[k],
-                     &p->solid->pos, crash);
-            }
-            else {
-               coll = CollideLineSprite( &w->solid->pos, w->solid->dir,
-                     w->outfit->u.bem.range, p->ship->gfx_space, psx, psy,
-                     &p->solid->pos, crash);
-            }
-            if (coll)
-               weapon_hitBeam( w, p, layer, crash, dt );
-               /* No return because beam can still think, it's not
-                * destroyed like the other weapons.*/
-         }
-      }
-      /* smart weapons only collide with their target */
-      else if (weapon_isSmart(w)) {
-
-         if ( (pilot_stack[i]->id == w->target) &&
-               (w->status == WEAPON_STATUS_OK) &&
-               weapon_checkCanHit(w,p) ) {
-            if (usePoly) {
-               k = p->ship->gfx_space->sx * psy + psx;
-               coll = CollidePolygon( &p->ship->polygon[k], &p->solid->pos,
-                        polygon, &w->solid->pos, &crash[0] );
-            }
-            else {
-               coll = CollideSprite( gfx, w->sx, w->sy, &w->solid->pos,
-                        p->ship->gfx_space, psx, psy,
-                        &p->solid->pos, &crash[0] );
-            }
-            if (coll) {
-               weapon_hit( w, p, layer, &crash[0] );
-               return; /* Weapon is destroyed. */
-            }
-         }
-      }
-      /* unguided weapons hit anything not of the same faction */
-      else {
-         if (weapon_checkCanHit(w,p)) {
-            if (usePoly) {
-               k = p->ship->gfx_space->sx * psy + psx;
-               coll = CollidePolygon( &p->ship->polygon[k], &p->solid->pos,
-                        polygon, &w->solid->pos, &crash[0] );
-            }
-            else {
-               coll = CollideSprite( gfx, w->sx, w->sy, &w->solid->pos,
-                        p->ship->gfx_space, psx, psy,
-                        &p->solid->pos, &crash[0] );
-            }
+         if (w->parent == p->id) continue; /* pilot is self */
 
-            if (coll) {
-            weapon_hit( w, p, layer, &crash[0] );
+         weapon_collidePilot( w, p, gfx, polygon, usePoly, dt, layer, &hit );
+         if (hit && !b)
             return; /* Weapon is destroyed. */
-            }
-         }
+         /* No return for beams because they can still think, they're not
+          * destroyed like the other weapons. */
       }
    }
 
    /* Collide with asteroids*/
-   if (outfit_isAmmo(w->outfit)) {
-      for (i=0; i<array_size(cur_system->asteroids); i++) {
-         ast = &cur_system->asteroids[i];
-         for (j=0; j<ast->nb; j++) {
-            a = &ast->asteroids[j];
-            at = space_getType ( a->type );
-            if ( (a->appearing == ASTEROID_VISIBLE) &&
-                  CollideSprite( gfx, w->sx, w->sy, &w->solid->pos,
-                        at->gfxs[a->gfxID], 0, 0, &a->pos,
-                        &crash[0] ) ) {
-               weapon_hitAst( w, a, layer, &crash[0] );
-               return; /* Weapon is destroyed. */
-            }
-         }
-      }
-   }
-   else if (outfit_isBolt(w->outfit)) {
-      for (i=0; i<array_size(cur_system->asteroids); i++) {
-         ast = &cur_system->asteroids[i];
-         for (j=0; j<ast->nb; j++) {
-            a = &ast->asteroids[j];
-            at = space_getType ( a->type );
-            if ( (a->appearing == ASTEROID_VISIBLE) &&
-                  CollideSprite( gfx, w->sx, w->sy, &w->solid->pos,
-                        at->gfxs[a->gfxID], 0, 0, &a->pos,
-                        &crash[0] ) ) {
-               weapon_hitAst( w, a, layer, &crash[0] );
-               return; /* Weapon is destroyed. */
-            }
-         }
-      }
-   }
-   else if (b) { /* Beam */
-      for (i=0; i<array_size(cur_system->asteroids); i++) {
-         ast = &cur_system->asteroids[i];
-         for (j=0; j<ast->nb; j++) {
-            a = &ast->asteroids[j];
-            at = space_getType ( a->type );
-            if ( (a->appearing == ASTEROID_VISIBLE) &&
-                  CollideLineSprite( &w->solid->pos, w->solid->dir,
-                        w->outfit->u.bem.range,
-                        at->gfxs[a->gfxID], 0, 0, &a->pos,
-                        crash ) ) {
+   for (i=0; i<array_size(cur_system->asteroids); i++) {
+      ast = &cur_system->asteroids[i];
+      /* Only look at the asteroids near the weapon. */
+      if (b)
+         spatial_querySegment( &ast->grid, &weapon_candidates, x1, y1, x2, y2, 0. );
+      else
+         spatial_query( &ast->grid, &weapon_candidates, x1, y1, x2, y2 );
+      for (j=0; j<array_size(weapon_candidates); j++) {
+         a = &ast->asteroids[ weapon_candidates[j] ];
+         if (a->appearing != ASTEROID_VISIBLE)
+            continue;
+         at = space_getType ( a->type );
+         if (b) { /* Beam */
+            if (CollideLineSprite( &w->solid.pos, w->solid.dir,
+                     w->outfit->u.bem.range,
+                     at->gfxs[a->gfxID], 0, 0, &a->pos,
+                     crash ))
                weapon_hitAstBeam( w, a, layer, crash, dt );
                /* No return because beam can still think, it's not
                 * destroyed like the other weapons.*/
-            }
+         }
+         else if (CollideSprite( gfx, w->sx, w->sy, &w->solid.pos,
+                  at->gfxs[a->gfxID], 0, 0, &a->pos,
+                  &crash[0] )) {
+            weapon_hitAst( w, a, layer, &crash[0] );
+            return; /* Weapon is destroyed. */
          }
       }
    }
@@ -993,16 +1242,132 @@ static void weapon_update( Weapon* w, const double dt, WeaponLayer layer )
    if (weapon_isSmart(w))
       (*w->think)(w,dt);
 
-   /* Update the solid position. */
-   (*w->solid->update)(w->solid, dt);
+   /* Gets moved with the rest of the layer. */
+   w->moving = 1;
+}
 
-   /* Update the sound. */
-   sound_updatePos(w->voice, w->solid->pos.x, w->solid->pos.y,
-         w->solid->vel.x, w->solid->vel.y);
 
-   /* Update the trail. */
-   if (w->trail != NULL)
-      weapon_sample_trail( w );
+/**
+ * @brief Checks and handles the collision of a weapon with a pilot.
+ *
+ *    @param w Weapon colliding.
+ *    @param p Pilot to check collision against.
+ *    @param gfx Graphic of the weapon (NULL for beams).
+ *    @param polygon Collision polygon of the weapon (NULL for beams).
+ *    @param usePoly Whether or not the weapon has collision polygons.
+ *    @param dt Current delta tick.
+ *    @param layer Layer to which the weapon belongs.
+ *    @param[out] hit Set to 1 if the pilot was hit.
+ */
+static void weapon_collidePilot( Weapon* w, Pilot* p, glTexture* gfx,
+      CollPoly* polygon, int usePoly, const double dt, WeaponLayer layer, int *hit )
+{
+   int psx, psy;
+   unsigned int coll;
+   Vector2d crash[2];
+
+   *hit = 0;
+   psx = p->tsx;
+   psy = p->tsy;
+
+   /* See if the ship has a collision polygon. */
+   if (array_size(p->ship->polygon) == 0)
+      usePoly = 0;
+
+   /* Beam weapons have special collisions. */
+   if (outfit_isBeam(w->outfit)) {
+      /* Check for collision. */
+      if (weapon_checkCanHit(w,p)) {
+         if (usePoly) {
+            coll = CollideLinePolygon( &w->solid.pos, w->solid.dir,
+                  w->outfit->u.bem.range, pilot_collPoly( p ),
+                  &p->solid->pos, crash);
+         }
+         else {
+            coll = CollideLineSprite( &w->solid.pos, w->solid.dir,
+                  w->outfit->u.bem.range, p->ship->gfx_space, psx, psy,
+                  &p->solid->pos, crash);
+         }
+         if (coll) {
+            weapon_hitBeam( w, p, layer, crash, dt );
+            *hit = 1;
+         }
+      }
+      return;
+   }
+
+   /* Smart weapons only collide with their target. */
+   if (weapon_isSmart(w) &&
+         ((p->id != w->target) || (w->status != WEAPON_STATUS_OK)))
+      return;
+
+   /* Unguided weapons hit anything not of the same faction. */
+   if (!weapon_checkCanHit(w,p))
+      return;
+
+   if (usePoly) {
+      coll = CollidePolygon( pilot_collPoly( p ), &p->solid->pos,
+               polygon, &w->solid.pos, &crash[0] );
+   }
+   else {
+      coll = CollideSprite( gfx, w->sx, w->sy, &w->solid.pos,
+               p->ship->gfx_space, psx, psy,
+               &p->solid->pos, &crash[0] );
+   }
+
+   /* Fast bolts could skip past the pilot before the next update. */
+   if (!coll && outfit_isBolt(w->outfit))
+      coll = weapon_sweepPilot( w, p, gfx, dt, &crash[0] );
+
+   if (coll) {
+      weapon_hit( w, p, layer, &crash[0] );
+      *hit = 1;
+   }
+}
+
+
+/**
+ * @brief Checks to see if a bolt hits a pilot while moving during an update.
+ *
+ * The bolt is swept as a segment relative to the pilot, so correctness doesn't
+ *  depend on how long updates are. Only done when the bolt moves further than
+ *  its size, slower bolts are caught by the regular test.
+ *
+ *    @param w Bolt moving.
+ *    @param p Pilot to check against.
+ *    @param gfx Graphic of the bolt.
+ *    @param dt Current delta tick.
+ *    @param[out] crash First position hit.
+ *    @return 1 if the pilot gets hit.
+ */
+static int weapon_sweepPilot( Weapon* w, Pilot* p, glTexture* gfx,
+      const double dt, Vector2d* crash )
+{
+   double vx, vy, len;
+   int coll;
+   Vector2d c[2];
+
+   vx  = (w->solid.vel.x - p->solid->vel.x) * dt;
+   vy  = (w->solid.vel.y - p->solid->vel.y) * dt;
+   len = MOD( vx, vy );
+   if (len <= MAX( gfx->sw, gfx->sh ))
+      return 0;
+
+   if (array_size(p->ship->polygon) > 0) {
+      coll = CollideLinePolygon( &w->solid.pos, ANGLE( vx, vy ), len,
+            pilot_collPoly( p ), &p->solid->pos, c );
+   }
+   else
+      coll = CollideLineSprite( &w->solid.pos, ANGLE( vx, vy ), len,
+            p->ship->gfx_space, p->tsx, p->tsy, &p->solid->pos, c );
+   if (!coll)
+      return 0;
+
+   /* The hit closest to the bolt is where it enters. */
+   if (vect_dist2( &c[1], &w->solid.pos ) < vect_dist2( &c[0], &w->solid.pos ))
+      c[0] = c[1];
+   *crash = c[0];
+   return 1;
 }
 
 
@@ -1015,19 +1380,19 @@ static void weapon_sample_trail( Weapon* w )
    TrailMode mode;
 
    /* Compute the engine offset. */
-   a  = w->solid->dir;
+   a  = w->solid.dir;
    dx = w->outfit->u.amm.trail_x_offset * cos(a);
    dy = w->outfit->u.amm.trail_x_offset * sin(a);
 
    /* Set the colour. */
-   if (w->solid->thrust > 0)
+   if (w->solid.thrust > 0)
       mode = MODE_AFTERBURN;
-   else if (w->solid->dir_vel != 0.)
+   else if (w->solid.dir_vel != 0.)
       mode = MODE_GLOW;
    else
       mode = MODE_IDLE;
 
-   spfx_trail_sample( w->trail, w->solid->pos.x + dx, w->solid->pos.y + dy*M_SQRT1_2, mode, 0 );
+   spfx_trail_sample( w->trail, w->solid.pos.x + dx, w->solid.pos.y + dy*M_SQRT1_2, mode, 0 );
 }
 
 
@@ -1125,13 +1490,13 @@ static void weapon_hit( Weapon* w, Pilot* p, WeaponLayer layer, Vector2d* pos )
    s = outfit_soundHit(w->outfit);
    if (s != -1)
       w->voice = sound_playPos( s,
-            w->solid->pos.x,
-            w->solid->pos.y,
-            w->solid->vel.x,
-            w->solid->vel.y);
+            w->solid.pos.x,
+            w->solid.pos.y,
+            w->solid.vel.x,
+            w->solid.vel.y);
 
    /* Have pilot take damage and get real damage done. */
-   damage = pilot_hit( p, w->solid, w->parent, &dmg, 1 );
+   damage = pilot_hit( p, &w->solid, w->parent, &dmg, 1 );
 
    /* Get the layer. */
    spfx_layer = (p==player.p) ? SPFX_LAYER_FRONT : SPFX_LAYER_MIDDLE;
@@ -1176,10 +1541,10 @@ static void weapon_hitAst( Weapon* w, Asteroid* a, WeaponLayer layer, Vector2d*
    s = outfit_soundHit(w->outfit);
    if (s != -1)
       w->voice = sound_playPos( s,
-            w->solid->pos.x,
-            w->solid->pos.y,
-            w->solid->vel.x,
-            w->solid->vel.y);
+            w->solid.pos.x,
+            w->solid.pos.y,
+            w->solid.vel.x,
+            w->solid.vel.y);
 
    /* Add the spfx */
    spfx = outfit_spfxArmour(w->outfit);
@@ -1219,7 +1584,7 @@ static void weapon_hitBeam( Weapon* w, Pilot* p, WeaponLayer layer,
    dmg.disable       = w->dam_mod * w->strength * odmg->disable * dt;
 
    /* Have pilot take damage and get real damage done. */
-   damage = pilot_hit( p, w->solid, w->parent, &dmg, 1 );
+   damage = pilot_hit( p, &w->solid, w->parent, &dmg, 1 );
 
    /* Add sprite, layer depends on whether player shot or not. */
    if (w->exp_timer == -1.) {
@@ -1305,8 +1670,7 @@ static double weapon_aimTurret( const Outfit *outfit, const Pilot *parent,
    Asteroid *ast;
    Vector2d target_pos;
    Vector2d target_vel;
-   Vector2d relative_location;
-   double rdir, lead_angle;
+   double rdir, lead_angle, rel_angle;
    double x, y, t;
    double off;
 
@@ -1324,10 +1688,6 @@ static double weapon_aimTurret( const Outfit *outfit, const Pilot *parent,
       target_vel = ast->vel;
    }
 
-   /* Get the vector : shooter -> target*/
-   vect_cset( &relative_location, VX(target_pos) - VX(parent->solid->pos),
-         VY(target_pos) - VY(parent->solid->pos) );
-
    /* Try to predict where the enemy will be. */
    t = time;
    if (t == INFINITY)  /*Postprocess (t = INFINITY means target is not hittable)*/
@@ -1345,12 +1705,17 @@ static double weapon_aimTurret( const Outfit *outfit, const Pilot *parent,
       lead_angle = M_PI*pilot_ewWeaponTrack( parent, pilot_target, outfit->u.blt.track );
 
       /*only do this if the lead angle is implemented; save compute cycled on fixed weapons*/
-      if (lead_angle && FABS( angle_diff(ANGLE(x, y), VANGLE(relative_location)) ) > lead_angle) {
-         /* the target is moving too fast for the turret to keep up */
-         if (ANGLE(x, y) < VANGLE(relative_location))
-            rdir = angle_diff(lead_angle, VANGLE(relative_location));
-         else
-            rdir = angle_diff(-1*lead_angle, VANGLE(relative_location));
+      if (lead_angle) {
+         /* Angle of the vector : shooter -> target */
+         rel_angle = ANGLE( VX(target_pos) - VX(parent->solid->pos),
+               VY(target_pos) - VY(parent->solid->pos) );
+         if (FABS( angle_diff(rdir, rel_angle) ) > lead_angle) {
+            /* the target is moving too fast for the turret to keep up */
+            if (rdir < rel_angle)
+               rdir = angle_diff(lead_angle, rel_angle);
+            else
+               rdir = angle_diff(-1*lead_angle, rel_angle);
+         }
       }
    }
 
@@ -1426,16 +1791,16 @@ static void weapon_createBolt( Weapon *w, const Outfit* outfit, double T,
    vect_cadd( &v, outfit->u.blt.speed*cos(rdir), outfit->u.blt.speed*sin(rdir));
    w->timer = outfit->u.blt.range / outfit->u.blt.speed;
    w->falloff = w->timer - outfit->u.blt.falloff / outfit->u.blt.speed;
-   w->solid = solid_create( mass, rdir, pos, &v, SOLID_UPDATE_EULER );
+   solid_init( &w->solid, mass, rdir, pos, &v, SOLID_UPDATE_EULER );
    w->voice = sound_playPos( w->outfit->u.blt.sound,
-         w->solid->pos.x,
-         w->solid->pos.y,
-         w->solid->vel.x,
-         w->solid->vel.y);
+         w->solid.pos.x,
+         w->solid.pos.y,
+         w->solid.vel.x,
+         w->solid.vel.y);
 
    /* Set facing direction. */
    gfx = outfit_gfx( w->outfit );
-   gl_getSpriteFromDir( &w->sx, &w->sy, gfx, w->solid->dir );
+   gl_getSpriteFromDir( &w->sx, &w->sy, gfx, w->solid.dir );
 }
 
 
@@ -1493,10 +1858,10 @@ static void weapon_createAmmo( Weapon *w, const Outfit* launcher, double T,
    /* Set up ammo details. */
    mass        = w->outfit->mass;
    w->timer    = ammo->u.amm.duration * parent->stats.launch_range;
-   w->solid    = solid_create( mass, rdir, pos, &v, SOLID_UPDATE_RK4 );
+   solid_init( &w->solid, mass, rdir, pos, &v, SOLID_UPDATE_RK4 );
    if (w->outfit->u.amm.thrust != 0.) {
       weapon_setThrust( w, w->outfit->u.amm.thrust * mass );
-      w->solid->speed_max = w->outfit->u.amm.speed; /* Limit speed, we only care if it has thrust. */
+      w->solid.speed_max = w->outfit->u.amm.speed; /* Limit speed, we only care if it has thrust. */
    }
 
    /* Handle seekers. */
@@ -1512,14 +1877,14 @@ static void weapon_createAmmo( Weapon *w, const Outfit* launcher, double T,
 
    /* Play sound. */
    w->voice    = sound_playPos(w->outfit->u.amm.sound,
-         w->solid->pos.x,
-         w->solid->pos.y,
-         w->solid->vel.x,
-         w->solid->vel.y);
+         w->solid.pos.x,
+         w->solid.pos.y,
+         w->solid.vel.x,
+         w->solid.vel.y);
 
    /* Set facing direction. */
    gfx = outfit_gfx( w->outfit );
-   gl_getSpriteFromDir( &w->sx, &w->sy, gfx, w->solid->dir );
+   gl_getSpriteFromDir( &w->sx, &w->sy, gfx, w->solid.dir );
 
    /* Set up trails. */
    if (ammo->u.amm.trail_spec != NULL)
@@ -1527,6 +1892,36 @@ static void weapon_createAmmo( Weapon *w, const Outfit* launcher, double T,
 }
 
 
+/**
+ * @brief Gets a cleared weapon from the pool.
+ *
+ * Weapons are stored in large contiguous chunks that are never freed until
+ * weapon_exit(), and the most recently freed weapons are reused first, so
+ * the weapons being updated stay close together in memory.
+ *
+ *    @return A zeroed weapon.
+ */
+static Weapon* weapon_alloc (void)
+{
+   int i;
+   Weapon *chunk, *w;
+
+   /* Out of weapons, so allocate a new chunk. */
+   if (array_size(weapon_poolFree) == 0) {
+      chunk = calloc( WEAPON_POOL_CHUNK, sizeof(Weapon) );
+      memtrack_alloc( MEMTRACK_WEAPONS, WEAPON_POOL_CHUNK * sizeof(Weapon) );
+      array_push_back( &weapon_poolChunks, chunk );
+      for (i=WEAPON_POOL_CHUNK-1; i>=0; i--)
+         array_push_back( &weapon_poolFree, &chunk[i] );
+   }
+
+   w = array_back( weapon_poolFree );
+   array_erase( &weapon_poolFree, array_end(weapon_poolFree)-1, array_end(weapon_poolFree) );
+   memset( w, 0, sizeof(Weapon) );
+   return w;
+}
+
+
 /**
  * @brief Creates a new weapon.
  *
@@ -1552,7 +1947,7 @@ static Weapon* weapon_create( const Outfit* outfit, double T,
    Weapon* w;
 
    /* Create basic features */
-   w           = calloc( 1, sizeof(Weapon) );
+   w           = weapon_alloc();
    w->dam_mod  = 1.; /* Default of 100% damage. */
    w->dam_as_dis_mod = 0.; /* Default of 0% damage to disable. */
    w->faction  = parent->faction; /* non-changeable */
@@ -1599,15 +1994,15 @@ static Weapon* weapon_create( const Outfit* outfit, double T,
          else if (rdir >= 2.*M_PI)
             rdir -= 2.*M_PI;
          mass = 1.; /**< Needs a mass. */
-         w->r     = RNGF(); /* Set unique value. */
-         w->solid = solid_create( mass, rdir, pos, vel, SOLID_UPDATE_EULER );
+         w->r     = RNGF_COSMETIC(); /* Set unique value. */
+         solid_init( &w->solid, mass, rdir, pos, vel, SOLID_UPDATE_EULER );
          w->think = think_beam;
          w->timer = outfit->u.bem.duration;
          w->voice = sound_playPos( w->outfit->u.bem.sound,
-               w->solid->pos.x,
-               w->solid->pos.y,
-               w->solid->vel.x,
-               w->solid->vel.y);
+               w->solid.pos.x,
+               w->solid.pos.y,
+               w->solid.vel.x,
+               w->solid.vel.y);
 
          if (outfit->type == OUTFIT_TYPE_BEAM) {
             w->dam_mod       *= parent->stats.fwd_damage;
@@ -1631,7 +2026,7 @@ static Weapon* weapon_create( const Outfit* outfit, double T,
       default:
          WARN(_("Weapon of type '%s' has no create implemented yet!"),
                w->outfit->name);
-         w->solid = solid_create( 1., dir, pos, vel, SOLID_UPDATE_EULER );
+         solid_init( &w->solid, 1., dir, pos, vel, SOLID_UPDATE_EULER );
          break;
    }
 
@@ -1815,6 +2210,18 @@ static void weapon_destroy( Weapon* w, WeaponLayer layer )
    int i;
    Weapon** wlayer;
 
+   /* Can be destroyed several times in a frame, e.g. beams. */
+   if (w->destroyed)
+      return;
+
+   /* Removed at the end of weapons_update(). */
+   if (weapon_deferRemove) {
+      w->destroyed = 1;
+      w->moving    = 0;
+      weapon_destroyed++;
+      return;
+   }
+
    switch (layer) {
       case WEAPON_LAYER_BG:
          wlayer = wbackLayer;
@@ -1861,15 +2268,12 @@ static void weapon_free( Weapon* w )
    if (outfit_isBeam(w->outfit)) {
       sound_stop( w->voice );
       sound_playPos(w->outfit->u.bem.sound_off,
-            w->solid->pos.x,
-            w->solid->pos.y,
-            w->solid->vel.x,
-            w->solid->vel.y);
+            w->solid.pos.x,
+            w->solid.pos.y,
+            w->solid.vel.x,
+            w->solid.vel.y);
    }
 
-   /* Free the solid. */
-   solid_free(w->solid);
-
    /* Free the trail, if any. */
    spfx_trail_remove(w->trail);
 
@@ -1877,7 +2281,8 @@ static void weapon_free( Weapon* w )
    memset(w, 0, sizeof(Weapon));
 #endif /* DEBUGGING */
 
-   free(w);
+   /* Give back to the pool. */
+   array_push_back( &weapon_poolFree, w );
 }
 
 /**
@@ -1904,6 +2309,8 @@ void weapon_clear (void)
  */
 void weapon_exit (void)
 {
+   int i;
+
    weapon_clear();
 
    /* Destroy front layer. */
@@ -1917,6 +2324,24 @@ void weapon_exit (void)
    weapon_vboData = NULL;
    gl_vboDestroy( weapon_vbo );
    weapon_vbo = NULL;
+
+   /* Destroy collision candidates. */
+   array_free( weapon_candidates );
+   weapon_candidates = NULL;
+   array_free( weapon_aheadPos );
+   weapon_aheadPos = NULL;
+   array_free( weapon_drawList );
+   weapon_drawList = NULL;
+   solid_batchFree( &weapon_batch );
+
+   /* Destroy the weapon storage. */
+   for (i=0; i<array_size(weapon_poolChunks); i++)
+      free( weapon_poolChunks[i] );
+   memtrack_free( MEMTRACK_WEAPONS, array_size(weapon_poolChunks) * WEAPON_POOL_CHUNK * sizeof(Weapon) );
+   array_free( weapon_poolChunks );
+   weapon_poolChunks = NULL;
+   array_free( weapon_poolFree );
+   weapon_poolFree = NULL;
 }
 
 
@@ -1942,8 +2367,8 @@ static void weapon_explodeLayer( WeaponLayer layer,
       const Pilot *parent, int mode )
 {
    (void)parent;
-   int i;
-   Weapon **curLayer;
+   int i, n;
+   Weapon **curLayer, *w;
    double dist, rad2;
 
    /* set the proper layer */
@@ -1962,20 +2387,32 @@ static void weapon_explodeLayer( WeaponLayer layer,
 
    rad2 = radius*radius;
 
-   /* Now try to destroy the weapons affected. */
+   /* Now try to destroy the weapons affected. The layer is compacted in a
+    * single pass instead of erasing each weapon, which is quadratic when a
+    * big explosion takes out a lot of them. */
+   n = 0;
    for (i=0; i<array_size(curLayer); i++) {
-      if (((mode & EXPL_MODE_MISSILE) && outfit_isAmmo(curLayer[i]->outfit)) ||
-            ((mode & EXPL_MODE_BOLT) && outfit_isBolt(curLayer[i]->outfit))) {
+      w = curLayer[i];
+      if (!w->destroyed &&
+            (((mode & EXPL_MODE_MISSILE) && outfit_isAmmo(w->outfit)) ||
+            ((mode & EXPL_MODE_BOLT) && outfit_isBolt(w->outfit)))) {
 
-         dist = pow2(curLayer[i]->solid->pos.x - x) +
-               pow2(curLayer[i]->solid->pos.y - y);
+         dist = pow2(w->solid.pos.x - x) +
+               pow2(w->solid.pos.y - y);
 
          if (dist < rad2) {
-            weapon_destroy(curLayer[i], layer);
-            i--;
+            /* Can't touch the layer while it is being updated. */
+            if (weapon_deferRemove)
+               weapon_destroy( w, layer );
+            else {
+               weapon_free(w);
+               continue;
+            }
          }
       }
+      curLayer[n++] = w;
    }
+   array_resize( &curLayer, n );
 }
 
 
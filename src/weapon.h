@@ -52,6 +52,8 @@ void weapon_explode( double x, double y, double radius,
  */
 void weapons_update( const double dt );
 void weapons_render( const WeaponLayer layer, const double dt );
+void weapons_renderAhead( double t );
+void weapons_renderAheadEnd (void);
 
 
 /*
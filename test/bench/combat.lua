@@ -0,0 +1,31 @@
+--[[
+   Frame time scenario of a large fight, see bench_run() in src/bench.c.
+
+      naev --bench test/bench/combat.lua
+
+   Run as a meson test, it fails if the tick times go over the baseline.
+--]]
+
+bench_system = "Gamma Polaris" -- System to fight in
+bench_ticks  = 1800 -- Thirty seconds of game time
+bench_dt     = 1/60 -- Fixed update length
+bench_seed   = 1 -- Seed of the random numbers
+bench_render = true -- Draw it too
+
+-- Generous so slow CI machines and software rendering pass, regressions
+-- that matter are several times slower.
+bench_baseline = { p50=10, p95=25, p99=40 }
+
+local fleets = {
+   { ship="Empire Lancelot", faction="Empire", n=20, pos=vec2.new( -3000, 0 ) },
+   { ship="Pirate Shark", faction="Pirate", n=30, pos=vec2.new( 3000, 0 ) },
+}
+
+function setup ()
+   for k,f in ipairs(fleets) do
+      for i=1,f.n do
+         local offset = vec2.new( 0, (i - f.n/2) * 100 )
+         pilot.add( f.ship, f.faction, f.pos + offset )
+      end
+   end
+end
@@ -0,0 +1,52 @@
+--[[
+   Frame time scenario of busy traffic that lands and jumps out, see
+   bench_run() in src/bench.c.
+
+      naev --bench test/bench/traffic.lua
+
+   Run as a meson test, it fails if the tick times go over the baseline.
+--]]
+
+bench_system = "Gamma Polaris" -- Busy system with many planets
+bench_ticks  = 1800 -- Thirty seconds of game time
+bench_dt     = 1/60 -- Fixed update length
+bench_seed   = 2 -- Seed of the random numbers
+bench_render = true -- Draw it too
+
+-- Generous so slow CI machines and software rendering pass, regressions
+-- that matter are several times slower.
+bench_baseline = { p50=8, p95=20, p99=30 }
+
+local ships = { "Llama", "Koala", "Mule" }
+local traders = {}
+
+local function spawn( n )
+   for i=1,n do
+      local pos = vec2.newP( rnd.rnd( 2000, 8000 ), rnd.rnd() * 360 )
+      local p = pilot.add( ships[ rnd.rnd( 1, #ships ) ], "Independent", pos )
+      traders[ #traders+1 ] = p
+   end
+end
+
+function setup ()
+   spawn( 40 )
+end
+
+function tick( i )
+   -- Half of them head to land, the others to jump out.
+   if i == 300 then
+      for k,p in ipairs(traders) do
+         if p:exists() then
+            p:control()
+            if k % 2 == 0 then
+               p:land()
+            else
+               p:hyperspace()
+            end
+         end
+      end
+   -- New arrivals while the others leave.
+   elseif i == 900 then
+      spawn( 40 )
+   end
+end
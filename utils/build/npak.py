@@ -0,0 +1,55 @@
+#!/usr/bin/env python3
+# Packs a data directory into a Naev data pack (see src/npak.c).
+#
+# Usage: npak.py <data directory> <output pack>
+
+import argparse
+import os
+import struct
+
+MAGIC   = b'NPAK'
+VERSION = 1
+HEADER  = struct.Struct( '<4sIII' )
+ENTRY   = struct.Struct( '<QQII' )
+
+def collect( root ):
+    files = []
+    for dirpath, dirnames, filenames in os.walk( root ):
+        dirnames[:] = [ d for d in dirnames if not d.startswith('.') ]
+        for f in filenames:
+            if f.startswith('.'):
+                continue
+            path = os.path.join( dirpath, f )
+            name = os.path.relpath( path, root ).replace( os.sep, '/' )
+            files.append( (name.encode('utf-8'), path) )
+    # The game looks up files with a binary search on the bytes of the names.
+    files.sort( key=lambda f: f[0] )
+    return files
+
+def pack( root, output ):
+    files  = collect( root )
+    names  = bytearray()
+    noffs  = []
+    for name, _ in files:
+        noffs.append( len(names) )
+        names += name + b'\0'
+
+    offset = HEADER.size + ENTRY.size * len(files) + len(names)
+    sizes  = [ os.path.getsize(path) for _, path in files ]
+    with open( output, 'wb' ) as out:
+        out.write( HEADER.pack( MAGIC, VERSION, len(files), len(names) ) )
+        for noff, size in zip( noffs, sizes ):
+            out.write( ENTRY.pack( offset, size, noff, 0 ) )
+            offset += size
+        out.write( names )
+        for _, path in files:
+            with open( path, 'rb' ) as f:
+                out.write( f.read() )
+    print( f"Packed {len(files)} files into {output}" )
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser( description='Creates a Naev data pack.' )
+    parser.add_argument( 'datadir', help='Data directory to pack.' )
+    parser.add_argument( 'output', help='Pack to create.' )
+    args = parser.parse_args()
+    pack( args.datadir, args.output )